@@ -16,6 +16,7 @@
  ***************************************************************************/
 
 #include "qgsaspectfilter.h"
+#include <QVector>
 
 QgsAspectFilter::QgsAspectFilter( const QString& inputFile, const QString& outputFile, const QString& outputFormat ) :
     QgsDerivativeFilter( inputFile, outputFile, outputFormat )
@@ -48,3 +49,23 @@ float QgsAspectFilter::processNineCellWindow(
   }
 }
 
+void QgsAspectFilter::processNineCellLine( float* above, float* line, float* below, float* result, int width )
+{
+  QVector<float> derX( width );
+  QVector<float> derY( width );
+  calcFirstDerLine( above, line, below, derX.data(), derY.data(), width );
+
+  for ( int j = 0; j < width; ++j )
+  {
+    if ( derX[j] == mOutputNodataValue ||
+         derY[j] == mOutputNodataValue ||
+         ( derX[j] == 0.0 && derY[j] == 0.0 ) )
+    {
+      result[j] = mOutputNodataValue;
+    }
+    else
+    {
+      result[j] = 180.0 + atan2( derX[j], derY[j] ) * 180.0 / M_PI;
+    }
+  }
+}
@@ -33,6 +33,9 @@ class ANALYSIS_EXPORT QgsAspectFilter: public QgsDerivativeFilter
                                  float* x12, float* x22, float* x32,
                                  float* x13, float* x23, float* x33 );
 
+    /**Calculates the output values of one line from the derivatives of all cells*/
+    void processNineCellLine( float* above, float* line, float* below, float* result, int width );
+
 };
 
 #endif // QGSASPECTFILTER_H
@@ -162,7 +162,26 @@ float QgsDerivativeFilter::calcFirstDerY( float* x11, float* x21, float* x31, fl
   return sum / ( weight * mCellSizeY * mZFactor );
 }
 
+void QgsDerivativeFilter::calcFirstDerLine( float* above, float* line, float* below, float* derX, float* derY, int width )
+{
+  //without nodata values the weight is always 8. No branches here to let the compiler vectorise the loop
+  double divisorX = 8 * mCellSizeX * mZFactor;
+  double divisorY = 8 * mCellSizeY * mZFactor;
+  for ( int j = 0; j < width; ++j )
+  {
+    derX[j] = (( double )( above[j+1] - above[j-1] ) + 2 * ( double )( line[j+1] - line[j-1] ) + ( double )( below[j+1] - below[j-1] ) ) / divisorX;
+    derY[j] = (( double )( above[j-1] - below[j-1] ) + 2 * ( double )( above[j] - below[j] ) + ( double )( above[j+1] - below[j+1] ) ) / divisorY;
+  }
 
-
-
-
+  //cells on the border or next to nodata values
+  for ( int j = 0; j < width; ++j )
+  {
+    if ( above[j-1] == mInputNodataValue || above[j] == mInputNodataValue || above[j+1] == mInputNodataValue
+         || line[j-1] == mInputNodataValue || line[j] == mInputNodataValue || line[j+1] == mInputNodataValue
+         || below[j-1] == mInputNodataValue || below[j] == mInputNodataValue || below[j+1] == mInputNodataValue )
+    {
+      derX[j] = calcFirstDerX( &above[j-1], &above[j], &above[j+1], &line[j-1], &line[j], &line[j+1], &below[j-1], &below[j], &below[j+1] );
+      derY[j] = calcFirstDerY( &above[j-1], &above[j], &above[j+1], &line[j-1], &line[j], &line[j+1], &below[j-1], &below[j], &below[j+1] );
+    }
+  }
+}
@@ -36,6 +36,10 @@ class ANALYSIS_EXPORT QgsDerivativeFilter : public QgsNineCellFilter
     float calcFirstDerX( float* x11, float* x21, float* x31, float* x12, float* x22, float* x32, float* x13, float* x23, float* x33 );
     /**Calculates the first order derivative in y-direction according to Horn (1981)*/
     float calcFirstDerY( float* x11, float* x21, float* x31, float* x12, float* x22, float* x32, float* x13, float* x23, float* x33 );
+    /**Calculates the first order derivatives of all cells of a line (see processNineCellLine). Cells with nine valid values
+      are calculated in a loop without branches, the others with calcFirstDerX / calcFirstDerY
+      @note added in 2.1 */
+    void calcFirstDerLine( float* above, float* line, float* below, float* derX, float* derY, int width );
 };
 
 #endif // QGSDERIVATIVEFILTER_H
@@ -16,6 +16,7 @@
  ***************************************************************************/
 
 #include "qgshillshadefilter.h"
+#include <QVector>
 
 QgsHillshadeFilter::QgsHillshadeFilter( const QString& inputFile, const QString& outputFile, const QString& outputFormat, double lightAzimuth,
                                         double lightAngle )
@@ -55,3 +56,35 @@ float QgsHillshadeFilter::processNineCellWindow( float* x11, float* x21, float*
   }
   return qMax( 0.0, 255.0 * (( cos( zenith_rad ) * cos( slope_rad ) ) + ( sin( zenith_rad ) * sin( slope_rad ) * cos( azimuth_rad - aspect_rad ) ) ) );
 }
+
+void QgsHillshadeFilter::processNineCellLine( float* above, float* line, float* below, float* result, int width )
+{
+  QVector<float> derX( width );
+  QVector<float> derY( width );
+  calcFirstDerLine( above, line, below, derX.data(), derY.data(), width );
+
+  float zenith_rad = mLightAngle * M_PI / 180.0;
+  float azimuth_rad = mLightAzimuth * M_PI / 180.0;
+  double cosZenith = cos( zenith_rad );
+  double sinZenith = sin( zenith_rad );
+  for ( int j = 0; j < width; ++j )
+  {
+    if ( derX[j] == mOutputNodataValue || derY[j] == mOutputNodataValue )
+    {
+      result[j] = mOutputNodataValue;
+      continue;
+    }
+
+    float slope_rad = atan( sqrt( derX[j] * derX[j] + derY[j] * derY[j] ) );
+    float aspect_rad = 0;
+    if ( derX[j] == 0 && derY[j] == 0 ) //aspect undefined, take a neutral value. Better solutions?
+    {
+      aspect_rad = azimuth_rad / 2.0;
+    }
+    else
+    {
+      aspect_rad = M_PI + atan2( derX[j], derY[j] );
+    }
+    result[j] = qMax( 0.0, 255.0 * (( cosZenith * cos( slope_rad ) ) + ( sinZenith * sin( slope_rad ) * cos( azimuth_rad - aspect_rad ) ) ) );
+  }
+}
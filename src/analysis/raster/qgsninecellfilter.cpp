@@ -16,9 +16,13 @@
  ***************************************************************************/
 
 #include "qgsninecellfilter.h"
+#include "qgsrasterblock.h"
 #include "cpl_string.h"
 #include <QProgressDialog>
 #include <QFile>
+#include <QThread>
+#include <QtConcurrentMap>
+#include <algorithm>
 
 #if defined(GDAL_VERSION_NUM) && GDAL_VERSION_NUM >= 1800
 #define TO8F(x) (x).toUtf8().constData()
@@ -28,16 +32,37 @@
 
 QgsNineCellFilter::QgsNineCellFilter( const QString& inputFile, const QString& outputFile, const QString& outputFormat )
     : mInputFile( inputFile ), mOutputFile( outputFile ), mOutputFormat( outputFormat ), mCellSizeX( -1 ), mCellSizeY( -1 ),
-    mInputNodataValue( -1 ), mOutputNodataValue( -1 ), mZFactor( 1.0 )
+    mInputNodataValue( -1 ), mOutputNodataValue( -1 ), mZFactor( 1.0 ), mThreadCount( 0 )
 {
 
 }
 
-QgsNineCellFilter::QgsNineCellFilter()
+QgsNineCellFilter::QgsNineCellFilter(): mThreadCount( 0 )
 {
 
 }
 
+/**Consecutive lines of a strip, processed by one thread*/
+struct QgsNineCellStripJob
+{
+  QgsNineCellFilter* filter;
+  //first line of the strip in the input buffer (lines are padded with one nodata cell on both sides)
+  float* input;
+  float* output;
+  int lineCount;
+  int xSize;
+};
+
+static void processNineCellStrip( QgsNineCellStripJob& job )
+{
+  int stride = job.xSize + 2;
+  for ( int i = 0; i < job.lineCount; ++i )
+  {
+    float* line = job.input + i * stride + 1;
+    job.filter->processNineCellLine( line - stride, line, line + stride, job.output + i * job.xSize, job.xSize );
+  }
+}
+
 QgsNineCellFilter::~QgsNineCellFilter()
 {
 
@@ -96,81 +121,149 @@ int QgsNineCellFilter::processRaster( QProgressDialog* p )
     return 6;
   }
 
-  //keep only three scanlines in memory at a time
-  float* scanLine1 = ( float * ) CPLMalloc( sizeof( float ) * xSize );
-  float* scanLine2 = ( float * ) CPLMalloc( sizeof( float ) * xSize );
-  float* scanLine3 = ( float * ) CPLMalloc( sizeof( float ) * xSize );
+  processStrips( rasterBand, outputRasterBand, 0, xSize, ySize, p );
+
+  GDALClose( inputDataset );
+
+  if ( p && p->wasCanceled() )
+  {
+    //delete the dataset without closing (because it is faster)
+    GDALDeleteDataset( outputDriver, TO8F( mOutputFile ) );
+    return 7;
+  }
+  GDALClose( outputDataset );
+
+  return 0;
+}
+
+QgsRasterBlock* QgsNineCellFilter::processRasterToBlock( QProgressDialog* p )
+{
+  GDALAllRegister();
+
+  int xSize, ySize;
+  GDALDatasetH inputDataset = openInputFile( xSize, ySize );
+  if ( inputDataset == NULL )
+  {
+    return 0;
+  }
+
+  double geotransform[6];
+  GDALRasterBandH rasterBand = GDALGetRasterBand( inputDataset, 1 );
+  if ( rasterBand == NULL || ySize < 3 || !readCellSizes( inputDataset, geotransform ) )
+  {
+    GDALClose( inputDataset );
+    return 0;
+  }
+  mInputNodataValue = GDALGetRasterNoDataValue( rasterBand, NULL );
+  mOutputNodataValue = -9999;
+
+  QgsRasterBlock* outputBlock = new QgsRasterBlock( QGis::Float32, xSize, ySize, mOutputNodataValue );
+  if ( outputBlock->isEmpty() )
+  {
+    delete outputBlock;
+    GDALClose( inputDataset );
+    return 0;
+  }
 
-  float* resultLine = ( float * ) CPLMalloc( sizeof( float ) * xSize );
+  int result = processStrips( rasterBand, 0, outputBlock, xSize, ySize, p );
+  GDALClose( inputDataset );
+  if ( result != 0 )
+  {
+    delete outputBlock;
+    return 0;
+  }
+  return outputBlock;
+}
+
+void QgsNineCellFilter::processNineCellLine( float* above, float* line, float* below, float* result, int width )
+{
+  for ( int j = 0; j < width; ++j )
+  {
+    result[j] = processNineCellWindow( &above[j-1], &above[j], &above[j+1], &line[j-1], &line[j],
+                                       &line[j+1], &below[j-1], &below[j], &below[j+1] );
+  }
+}
+
+int QgsNineCellFilter::processStrips( GDALRasterBandH inputBand, GDALRasterBandH outputBand, QgsRasterBlock* outputBlock, int xSize, int ySize, QProgressDialog* p )
+{
+  int threadCount = mThreadCount > 0 ? mThreadCount : QThread::idealThreadCount();
+  if ( threadCount < 1 )
+  {
+    threadCount = 1;
+  }
+
+  //each batch of lines is read at once and split into one strip per thread. Keep the buffers at about 64 MB
+  int stride = xSize + 2;
+  int batchLines = qBound( threadCount, ( int )( 64 * 1024 * 1024 / ( sizeof( float ) * 2 * stride ) ), 256 * threadCount );
+  batchLines = qMin( batchLines, ySize );
+
+  //input lines of the batch plus the line above and below
+  float* inputLines = ( float * ) CPLMalloc( sizeof( float ) * stride * ( batchLines + 2 ) );
+  float* resultLines = outputBand ? ( float * ) CPLMalloc( sizeof( float ) * xSize * batchLines ) : 0;
 
   if ( p )
   {
     p->setMaximum( ySize );
   }
 
-  //values outside the layer extent (if the 3x3 window is on the border) are sent to the processing method as (input) nodata values
-  for ( int i = 0; i < ySize; ++i )
+  int result = 0;
+  for ( int firstLine = 0; firstLine < ySize; firstLine += batchLines )
   {
     if ( p )
     {
-      p->setValue( i );
+      p->setValue( firstLine );
     }
 
     if ( p && p->wasCanceled() )
     {
+      result = 7;
       break;
     }
 
-    if ( i == 0 )
+    int lineCount = qMin( batchLines, ySize - firstLine );
+
+    //values outside the layer extent (if the 3x3 window is on the border) are sent to the processing method as (input) nodata values
+    for ( int i = 0; i < lineCount + 2; ++i )
     {
-      //fill scanline 1 with (input) nodata for the values above the first row and feed scanline2 with the first row
-      for ( int a = 0; a < xSize; ++a )
-      {
-        scanLine1[a] = mInputNodataValue;
-      }
-      GDALRasterIO( rasterBand, GF_Read, 0, 0, xSize, 1, scanLine2, xSize, 1, GDT_Float32, 0, 0 );
+      inputLines[i * stride] = mInputNodataValue;
+      inputLines[i * stride + xSize + 1] = mInputNodataValue;
     }
-    else
+    int readFirst = firstLine - 1;
+    int readCount = lineCount + 2;
+    float* readBuffer = inputLines + 1;
+    if ( firstLine == 0 )
     {
-      //normally fetch only scanLine3 and release scanline 1 if we move forward one row
-      CPLFree( scanLine1 );
-      scanLine1 = scanLine2;
-      scanLine2 = scanLine3;
-      scanLine3 = ( float * ) CPLMalloc( sizeof( float ) * xSize );
+      std::fill( inputLines, inputLines + stride, mInputNodataValue );
+      readFirst = 0;
+      readCount--;
+      readBuffer += stride;
     }
-
-    if ( i == ySize - 1 ) //fill the row below the bottom with nodata values
+    if ( firstLine + lineCount == ySize )
     {
-      for ( int a = 0; a < xSize; ++a )
-      {
-        scanLine3[a] = mInputNodataValue;
-      }
+      std::fill( inputLines + ( lineCount + 1 ) * stride, inputLines + ( lineCount + 2 ) * stride, mInputNodataValue );
+      readCount--;
     }
-    else
+    GDALRasterIO( inputBand, GF_Read, 0, readFirst, xSize, readCount, readBuffer, xSize, readCount, GDT_Float32, 0, sizeof( float ) * stride );
+
+    float* output = outputBand ? resultLines : ( float * ) outputBlock->bits( firstLine, 0 );
+    int stripLines = ( lineCount + threadCount - 1 ) / threadCount;
+    QList<QgsNineCellStripJob> jobs;
+    for ( int i = 0; i < lineCount; i += stripLines )
     {
-      GDALRasterIO( rasterBand, GF_Read, 0, i + 1, xSize, 1, scanLine3, xSize, 1, GDT_Float32, 0, 0 );
+      QgsNineCellStripJob job;
+      job.filter = this;
+      job.input = inputLines + ( i + 1 ) * stride;
+      job.output = output + i * xSize;
+      job.lineCount = qMin( stripLines, lineCount - i );
+      job.xSize = xSize;
+      jobs << job;
     }
+    QtConcurrent::blockingMap( jobs, processNineCellStrip );
 
-    for ( int j = 0; j < xSize; ++j )
+    if ( outputBand )
     {
-      if ( j == 0 )
-      {
-        resultLine[j] = processNineCellWindow( &mInputNodataValue, &scanLine1[j], &scanLine1[j+1], &mInputNodataValue, &scanLine2[j],
-                                               &scanLine2[j+1], &mInputNodataValue, &scanLine3[j], &scanLine3[j+1] );
-      }
-      else if ( j == xSize - 1 )
-      {
-        resultLine[j] = processNineCellWindow( &scanLine1[j-1], &scanLine1[j], &mInputNodataValue, &scanLine2[j-1], &scanLine2[j],
-                                               &mInputNodataValue, &scanLine3[j-1], &scanLine3[j], &mInputNodataValue );
-      }
-      else
-      {
-        resultLine[j] = processNineCellWindow( &scanLine1[j-1], &scanLine1[j], &scanLine1[j+1], &scanLine2[j-1], &scanLine2[j],
-                                               &scanLine2[j+1], &scanLine3[j-1], &scanLine3[j], &scanLine3[j+1] );
-      }
+      GDALRasterIO( outputBand, GF_Write, 0, firstLine, xSize, lineCount, resultLines, xSize, lineCount, GDT_Float32, 0, 0 );
     }
-
-    GDALRasterIO( outputRasterBand, GF_Write, 0, i, xSize, 1, resultLine, xSize, 1, GDT_Float32, 0, 0 );
   }
 
   if ( p )
@@ -178,22 +271,9 @@ int QgsNineCellFilter::processRaster( QProgressDialog* p )
     p->setValue( ySize );
   }
 
-  CPLFree( resultLine );
-  CPLFree( scanLine1 );
-  CPLFree( scanLine2 );
-  CPLFree( scanLine3 );
-
-  GDALClose( inputDataset );
-
-  if ( p && p->wasCanceled() )
-  {
-    //delete the dataset without closing (because it is faster)
-    GDALDeleteDataset( outputDriver, TO8F( mOutputFile ) );
-    return 7;
-  }
-  GDALClose( outputDataset );
-
-  return 0;
+  CPLFree( resultLines );
+  CPLFree( inputLines );
+  return result;
 }
 
 GDALDatasetH QgsNineCellFilter::openInputFile( int& nCellsX, int& nCellsY )
@@ -255,13 +335,26 @@ GDALDatasetH QgsNineCellFilter::openOutputFile( GDALDatasetH inputDataset, GDALD
 
   //get geotransform from inputDataset
   double geotransform[6];
-  if ( GDALGetGeoTransform( inputDataset, geotransform ) != CE_None )
+  if ( !readCellSizes( inputDataset, geotransform ) )
   {
     GDALClose( outputDataset );
     return NULL;
   }
   GDALSetGeoTransform( outputDataset, geotransform );
 
+  const char* projection = GDALGetProjectionRef( inputDataset );
+  GDALSetProjection( outputDataset, projection );
+
+  return outputDataset;
+}
+
+bool QgsNineCellFilter::readCellSizes( GDALDatasetH inputDataset, double* geotransform )
+{
+  if ( GDALGetGeoTransform( inputDataset, geotransform ) != CE_None )
+  {
+    return false;
+  }
+
   //make sure mCellSizeX and mCellSizeY are always > 0
   mCellSizeX = geotransform[1];
   if ( mCellSizeX < 0 )
@@ -273,10 +366,5 @@ GDALDatasetH QgsNineCellFilter::openOutputFile( GDALDatasetH inputDataset, GDALD
   {
     mCellSizeY = -mCellSizeY;
   }
-
-  const char* projection = GDALGetProjectionRef( inputDataset );
-  GDALSetProjection( outputDataset, projection );
-
-  return outputDataset;
+  return true;
 }
-
@@ -22,6 +22,7 @@
 #include "gdal.h"
 
 class QProgressDialog;
+class QgsRasterBlock;
 
 /**Base class for raster analysis methods that work with a 3x3 cell filter and calculate the value of each cell based on
 the cell value and the eight neighbour cells. Common examples are slope and aspect calculation in DEMs. Subclasses only implement
@@ -38,6 +39,18 @@ class ANALYSIS_EXPORT QgsNineCellFilter
       @return 0 in case of success*/
     int processRaster( QProgressDialog* p );
 
+    /**Starts the calculation, reads from mInputFile and returns the result as Float32 block with the output nodata value (-9999)
+      instead of writing a file
+      @param p progress dialog that receives update and that is checked for abort. 0 if no progress bar is needed.
+      @return the result block (ownership is transferred to the caller) or 0 in case of error or cancel
+      @note added in 2.1 */
+    QgsRasterBlock* processRasterToBlock( QProgressDialog* p );
+
+    /**Number of threads processing the raster strips. 0 means QThread::idealThreadCount()
+      @note added in 2.1 */
+    int threadCount() const { return mThreadCount; }
+    void setThreadCount( int count ) { mThreadCount = count; }
+
     double cellSizeX() const { return mCellSizeX; }
     void setCellSizeX( double size ) { mCellSizeX = size; }
     double cellSizeY() const { return mCellSizeY; }
@@ -57,6 +70,12 @@ class ANALYSIS_EXPORT QgsNineCellFilter
                                          float* x12, float* x22, float* x32,
                                          float* x13, float* x23, float* x33 ) = 0;
 
+    /**Calculates the output values of one line. The lines above, below and the line itself have a valid (input nodata) cell
+      at index -1 and width. The default implementation calls processNineCellWindow for each cell, subclasses may process the
+      line in one pass. Called concurrently from several threads for different lines.
+      @note added in 2.1 */
+    virtual void processNineCellLine( float* above, float* line, float* below, float* result, int width );
+
   private:
     //default constructor forbidden. We need input file, output file and format obligatory
     QgsNineCellFilter();
@@ -69,6 +88,13 @@ class ANALYSIS_EXPORT QgsNineCellFilter
     /**Opens the output file and sets the same geotransform and CRS as the input data
       @return the output dataset or NULL in case of error*/
     GDALDatasetH openOutputFile( GDALDatasetH inputDataset, GDALDriverH outputDriver );
+    /**Sets mCellSizeX and mCellSizeY from the geotransform of the input data
+      @return false if the dataset has no geotransform*/
+    bool readCellSizes( GDALDatasetH inputDataset, double* geotransform );
+    /**Processes the input band in strips (with a one line halo) on several threads and writes the result to outputBand
+      or (if outputBand is 0) to outputBlock
+      @return 0 in case of success and 7 if canceled*/
+    int processStrips( GDALRasterBandH inputBand, GDALRasterBandH outputBand, QgsRasterBlock* outputBlock, int xSize, int ySize, QProgressDialog* p );
 
   protected:
 
@@ -84,6 +110,8 @@ class ANALYSIS_EXPORT QgsNineCellFilter
     float mOutputNodataValue;
     /**Scale factor for z-value if x-/y- units are different to z-units (111120 for degree->meters and 370400 for degree->feet)*/
     double mZFactor;
+    /**Number of processing threads (0: ideal thread count)*/
+    int mThreadCount;
 };
 
 #endif // QGSNINECELLFILTER_H
@@ -0,0 +1,329 @@
+/***************************************************************************
+      qgsrastercalckernel.cpp  -  Fused evaluation of raster calculator trees
+                             -------------------
+    begin                : January 2014
+    copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgsrastercalckernel.h"
+#include "qgsrastercalcnode.h"
+#include <string.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+//number of pixels each instruction processes at once. The registers stay in the first level cache
+static const int sRunLength = 256;
+
+//the operations return false if the result is nodata
+struct QgsCalcPlus { static inline bool apply( double a, double b, double& r ) { r = a + b; return true; } };
+struct QgsCalcMinus { static inline bool apply( double a, double b, double& r ) { r = a - b; return true; } };
+struct QgsCalcMul { static inline bool apply( double a, double b, double& r ) { r = a * b; return true; } };
+struct QgsCalcDiv { static inline bool apply( double a, double b, double& r ) { r = a / b; return b != 0; } };
+struct QgsCalcPow
+{
+  static inline bool apply( double a, double b, double& r )
+  {
+    if (( a == 0 && b < 0 ) || ( b < 0 && ( b - floor( b ) ) > 0 ) )
+    {
+      return false;
+    }
+    r = pow( a, b );
+    return true;
+  }
+};
+struct QgsCalcEQ { static inline bool apply( double a, double b, double& r ) { r = a == b ? 1.0 : 0.0; return true; } };
+struct QgsCalcNE { static inline bool apply( double a, double b, double& r ) { r = a == b ? 0.0 : 1.0; return true; } };
+struct QgsCalcGT { static inline bool apply( double a, double b, double& r ) { r = a > b ? 1.0 : 0.0; return true; } };
+struct QgsCalcLT { static inline bool apply( double a, double b, double& r ) { r = a < b ? 1.0 : 0.0; return true; } };
+struct QgsCalcGE { static inline bool apply( double a, double b, double& r ) { r = a >= b ? 1.0 : 0.0; return true; } };
+struct QgsCalcLE { static inline bool apply( double a, double b, double& r ) { r = a <= b ? 1.0 : 0.0; return true; } };
+struct QgsCalcAnd { static inline bool apply( double a, double b, double& r ) { r = a && b ? 1.0 : 0.0; return true; } };
+struct QgsCalcOr { static inline bool apply( double a, double b, double& r ) { r = a || b ? 1.0 : 0.0; return true; } };
+
+struct QgsCalcSqrt { static inline bool apply( double a, double& r ) { r = sqrt( a ); return a >= 0; } };
+struct QgsCalcSin { static inline bool apply( double a, double& r ) { r = sin( a ); return true; } };
+struct QgsCalcCos { static inline bool apply( double a, double& r ) { r = cos( a ); return true; } };
+struct QgsCalcTan { static inline bool apply( double a, double& r ) { r = tan( a ); return true; } };
+struct QgsCalcAsin { static inline bool apply( double a, double& r ) { r = asin( a ); return true; } };
+struct QgsCalcAcos { static inline bool apply( double a, double& r ) { r = acos( a ); return true; } };
+struct QgsCalcAtan { static inline bool apply( double a, double& r ) { r = atan( a ); return true; } };
+struct QgsCalcSign { static inline bool apply( double a, double& r ) { r = -a; return true; } };
+
+template<class T> static void binaryRun( const float* left, const float* right, float* target, int count,
+    double leftNodata, double rightNodata, double nodata )
+{
+  float nodataValue = static_cast<float>( nodata );
+  double value;
+  for ( int i = 0; i < count; ++i )
+  {
+    if ( left[i] == leftNodata || right[i] == rightNodata || !T::apply( left[i], right[i], value ) )
+    {
+      target[i] = nodataValue;
+    }
+    else
+    {
+      target[i] = static_cast<float>( value );
+    }
+  }
+}
+
+template<class T> static void unaryRun( float* data, int count, double nodata )
+{
+  float nodataValue = static_cast<float>( nodata );
+  double value;
+  for ( int i = 0; i < count; ++i )
+  {
+    if ( data[i] == nodata )
+    {
+      continue;
+    }
+    data[i] = T::apply( data[i], value ) ? static_cast<float>( value ) : nodataValue;
+  }
+}
+
+static bool isBinaryOperator( int op )
+{
+  switch ( op )
+  {
+    case QgsRasterCalcNode::opPLUS:
+    case QgsRasterCalcNode::opMINUS:
+    case QgsRasterCalcNode::opMUL:
+    case QgsRasterCalcNode::opDIV:
+    case QgsRasterCalcNode::opPOW:
+    case QgsRasterCalcNode::opEQ:
+    case QgsRasterCalcNode::opNE:
+    case QgsRasterCalcNode::opGT:
+    case QgsRasterCalcNode::opLT:
+    case QgsRasterCalcNode::opGE:
+    case QgsRasterCalcNode::opLE:
+    case QgsRasterCalcNode::opAND:
+    case QgsRasterCalcNode::opOR:
+      return true;
+    default:
+      return false;
+  }
+}
+
+QgsRasterCalcKernel::QgsRasterCalcKernel( const QgsRasterCalcNode* node, const QStringList& rasterRefs, const QVector<double>& nodataValues )
+    : mRasterRefs( rasterRefs )
+    , mInputNodataValues( nodataValues )
+    , mRegisterCount( 0 )
+    , mNodataValue( -FLT_MAX )
+{
+  bool isNumber;
+  mValid = compile( node, 0, mNodataValue, isNumber );
+  if ( !mValid )
+  {
+    mInstructions.clear();
+  }
+}
+
+bool QgsRasterCalcKernel::compile( const QgsRasterCalcNode* node, int target, double& nodata, bool& isNumber )
+{
+  if ( !node )
+  {
+    return false;
+  }
+
+  mRegisterCount = qMax( mRegisterCount, target + 1 );
+
+  Instruction instruction;
+  instruction.op = 0;
+  instruction.input = -1;
+  instruction.number = 0;
+  instruction.target = target;
+  instruction.left = target;
+  instruction.right = target + 1;
+  instruction.leftNodata = 0;
+  instruction.rightNodata = 0;
+
+  switch ( node->type() )
+  {
+    case QgsRasterCalcNode::tRasterRef:
+      instruction.type = iLoad;
+      instruction.input = mRasterRefs.indexOf( node->rasterName() );
+      if ( instruction.input < 0 || instruction.input >= mInputNodataValues.size() )
+      {
+        return false;
+      }
+      nodata = mInputNodataValues.at( instruction.input );
+      isNumber = false;
+      break;
+
+    case QgsRasterCalcNode::tNumber:
+      instruction.type = iNumber;
+      instruction.number = node->number();
+      nodata = -FLT_MAX;
+      isNumber = true;
+      break;
+
+    case QgsRasterCalcNode::tOperator:
+    {
+      double leftNodata;
+      bool leftIsNumber;
+      if ( !compile( node->left(), target, leftNodata, leftIsNumber ) )
+      {
+        return false;
+      }
+      instruction.op = node->op();
+      instruction.leftNodata = leftNodata;
+
+      if ( node->right() )
+      {
+        double rightNodata;
+        bool rightIsNumber;
+        if ( !isBinaryOperator( instruction.op ) || !compile( node->right(), target + 1, rightNodata, rightIsNumber ) )
+        {
+          return false;
+        }
+        instruction.type = iBinary;
+        instruction.rightNodata = rightNodata;
+        //the result of a number and a raster gets the nodata value of the raster
+        nodata = leftIsNumber ? rightNodata : leftNodata;
+        isNumber = leftIsNumber && rightIsNumber;
+      }
+      else
+      {
+        if ( isBinaryOperator( instruction.op ) )
+        {
+          return false;
+        }
+        instruction.type = iUnary;
+        nodata = leftNodata;
+        isNumber = leftIsNumber;
+      }
+      break;
+    }
+
+    default:
+      return false;
+  }
+
+  instruction.nodata = nodata;
+  mInstructions.append( instruction );
+  return true;
+}
+
+void QgsRasterCalcKernel::calculate( const QVector<const float*>& inputs, float* result, int count, float outputNodataValue ) const
+{
+  if ( !mValid )
+  {
+    std::fill( result, result + count, outputNodataValue );
+    return;
+  }
+
+  QVector<float> registerData( mRegisterCount * sRunLength );
+  float* registers = registerData.data();
+
+  for ( int offset = 0; offset < count; offset += sRunLength )
+  {
+    int n = qMin( sRunLength, count - offset );
+
+    QVector<Instruction>::const_iterator it = mInstructions.constBegin();
+    for ( ; it != mInstructions.constEnd(); ++it )
+    {
+      float* target = registers + it->target * sRunLength;
+      float* left = registers + it->left * sRunLength;
+      float* right = registers + it->right * sRunLength;
+
+      switch ( it->type )
+      {
+        case iLoad:
+          memcpy( target, inputs.at( it->input ) + offset, n * sizeof( float ) );
+          break;
+        case iNumber:
+          std::fill( target, target + n, it->number );
+          break;
+        case iUnary:
+          switch ( it->op )
+          {
+            case QgsRasterCalcNode::opSQRT:
+              unaryRun<QgsCalcSqrt>( target, n, it->nodata );
+              break;
+            case QgsRasterCalcNode::opSIN:
+              unaryRun<QgsCalcSin>( target, n, it->nodata );
+              break;
+            case QgsRasterCalcNode::opCOS:
+              unaryRun<QgsCalcCos>( target, n, it->nodata );
+              break;
+            case QgsRasterCalcNode::opTAN:
+              unaryRun<QgsCalcTan>( target, n, it->nodata );
+              break;
+            case QgsRasterCalcNode::opASIN:
+              unaryRun<QgsCalcAsin>( target, n, it->nodata );
+              break;
+            case QgsRasterCalcNode::opACOS:
+              unaryRun<QgsCalcAcos>( target, n, it->nodata );
+              break;
+            case QgsRasterCalcNode::opATAN:
+              unaryRun<QgsCalcAtan>( target, n, it->nodata );
+              break;
+            case QgsRasterCalcNode::opSIGN:
+              unaryRun<QgsCalcSign>( target, n, it->nodata );
+              break;
+          }
+          break;
+        case iBinary:
+          switch ( it->op )
+          {
+            case QgsRasterCalcNode::opPLUS:
+              binaryRun<QgsCalcPlus>( left, right, target, n, it->leftNodata, it->rightNodata, it->nodata );
+              break;
+            case QgsRasterCalcNode::opMINUS:
+              binaryRun<QgsCalcMinus>( left, right, target, n, it->leftNodata, it->rightNodata, it->nodata );
+              break;
+            case QgsRasterCalcNode::opMUL:
+              binaryRun<QgsCalcMul>( left, right, target, n, it->leftNodata, it->rightNodata, it->nodata );
+              break;
+            case QgsRasterCalcNode::opDIV:
+              binaryRun<QgsCalcDiv>( left, right, target, n, it->leftNodata, it->rightNodata, it->nodata );
+              break;
+            case QgsRasterCalcNode::opPOW:
+              binaryRun<QgsCalcPow>( left, right, target, n, it->leftNodata, it->rightNodata, it->nodata );
+              break;
+            case QgsRasterCalcNode::opEQ:
+              binaryRun<QgsCalcEQ>( left, right, target, n, it->leftNodata, it->rightNodata, it->nodata );
+              break;
+            case QgsRasterCalcNode::opNE:
+              binaryRun<QgsCalcNE>( left, right, target, n, it->leftNodata, it->rightNodata, it->nodata );
+              break;
+            case QgsRasterCalcNode::opGT:
+              binaryRun<QgsCalcGT>( left, right, target, n, it->leftNodata, it->rightNodata, it->nodata );
+              break;
+            case QgsRasterCalcNode::opLT:
+              binaryRun<QgsCalcLT>( left, right, target, n, it->leftNodata, it->rightNodata, it->nodata );
+              break;
+            case QgsRasterCalcNode::opGE:
+              binaryRun<QgsCalcGE>( left, right, target, n, it->leftNodata, it->rightNodata, it->nodata );
+              break;
+            case QgsRasterCalcNode::opLE:
+              binaryRun<QgsCalcLE>( left, right, target, n, it->leftNodata, it->rightNodata, it->nodata );
+              break;
+            case QgsRasterCalcNode::opAND:
+              binaryRun<QgsCalcAnd>( left, right, target, n, it->leftNodata, it->rightNodata, it->nodata );
+              break;
+            case QgsRasterCalcNode::opOR:
+              binaryRun<QgsCalcOr>( left, right, target, n, it->leftNodata, it->rightNodata, it->nodata );
+              break;
+          }
+          break;
+      }
+    }
+
+    //the root result is in the first register. Replace its nodata values with the output nodata value
+    for ( int i = 0; i < n; ++i )
+    {
+      result[offset + i] = registers[i] == mNodataValue ? outputNodataValue : registers[i];
+    }
+  }
+}
@@ -0,0 +1,85 @@
+/***************************************************************************
+      qgsrastercalckernel.h  -  Fused evaluation of raster calculator trees
+                             -------------------
+    begin                : January 2014
+    copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSRASTERCALCKERNEL_H
+#define QGSRASTERCALCKERNEL_H
+
+#include <QStringList>
+#include <QVector>
+
+class QgsRasterCalcNode;
+
+/**A QgsRasterCalcNode tree compiled into a flat list of instructions. The instructions are executed on short runs of
+  pixels held in a few per call registers, so no intermediate matrix is allocated per node and row. Nodata values are
+  propagated like in QgsRasterMatrix: an operation on a nodata value (or a division by zero, an invalid power or
+  the square root of a negative number) results in the nodata value of the left operand (of the right operand if the
+  left one is a number). calculate() only reads the kernel and can be called from several threads at once*/
+class ANALYSIS_EXPORT QgsRasterCalcKernel
+{
+  public:
+    /**Compiles the tree
+      @param node root node of the formula
+      @param rasterRefs raster references in the order of the input buffers passed to calculate
+      @param nodataValues nodata value of each input*/
+    QgsRasterCalcKernel( const QgsRasterCalcNode* node, const QStringList& rasterRefs, const QVector<double>& nodataValues );
+
+    /**False if the tree contains an unknown raster reference or operator*/
+    bool isValid() const { return mValid; }
+
+    /**Calculates count output values
+      @param inputs one buffer of count values for each raster reference
+      @param result receives count values. Pixels with nodata result are set to outputNodataValue*/
+    void calculate( const QVector<const float*>& inputs, float* result, int count, float outputNodataValue ) const;
+
+  private:
+    enum InstructionType
+    {
+      iLoad,
+      iNumber,
+      iUnary,
+      iBinary
+    };
+
+    struct Instruction
+    {
+      InstructionType type;
+      int op;
+      //input index (iLoad)
+      int input;
+      float number;
+      //registers of the result and the operands
+      int target;
+      int left;
+      int right;
+      double leftNodata;
+      double rightNodata;
+      double nodata;
+    };
+
+    /**Appends the instructions of node, which write the result to register target
+      @param nodata receives the nodata value of the node result
+      @param isNumber receives true if the node result does not depend on a raster (a 1x1 matrix in QgsRasterMatrix terms)*/
+    bool compile( const QgsRasterCalcNode* node, int target, double& nodata, bool& isNumber );
+
+    QStringList mRasterRefs;
+    QVector<double> mInputNodataValues;
+    QVector<Instruction> mInstructions;
+    int mRegisterCount;
+    double mNodataValue;
+    bool mValid;
+};
+
+#endif // QGSRASTERCALCKERNEL_H
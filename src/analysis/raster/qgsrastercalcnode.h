@@ -68,6 +68,17 @@ class ANALYSIS_EXPORT QgsRasterCalcNode
 
     Type type() const { return mType; }
 
+    /**Operator of an operator node*/
+    Operator op() const { return mOperator; }
+    /**Operand (of an operator node)*/
+    const QgsRasterCalcNode* left() const { return mLeft; }
+    /**Second operand (of an operator node with two arguments)*/
+    const QgsRasterCalcNode* right() const { return mRight; }
+    /**Value of a number node*/
+    double number() const { return mNumber; }
+    /**Reference of a raster node*/
+    QString rasterName() const { return mRasterName; }
+
     //set left node
     void setLeft( QgsRasterCalcNode* left ) { delete mLeft; mLeft = left; }
     void setRight( QgsRasterCalcNode* right ) { delete mRight; mRight = right; }
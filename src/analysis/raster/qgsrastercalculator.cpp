@@ -17,11 +17,13 @@
 
 #include "qgsrastercalculator.h"
 #include "qgsrastercalcnode.h"
+#include "qgsrastercalckernel.h"
 #include "qgsrasterlayer.h"
-#include "qgsrastermatrix.h"
 #include "cpl_string.h"
 #include <QProgressDialog>
 #include <QFile>
+#include <QThread>
+#include <QtConcurrentMap>
 
 #include "gdalwarper.h"
 #include <ogr_srs_api.h>
@@ -44,6 +46,21 @@ QgsRasterCalculator::~QgsRasterCalculator()
 {
 }
 
+/**Consecutive rows of a block, calculated by one thread*/
+struct QgsRasterCalculatorPart
+{
+  const QgsRasterCalcKernel* kernel;
+  QVector<const float*> inputs;
+  float* result;
+  int count;
+  float outputNodataValue;
+};
+
+static void calculateRasterPart( QgsRasterCalculatorPart& part )
+{
+  part.kernel->calculate( part.inputs, part.result, part.count, part.outputNodataValue );
+}
+
 int QgsRasterCalculator::processCalculation( QProgressDialog* p )
 {
   //prepare search string / tree
@@ -52,14 +69,17 @@ int QgsRasterCalculator::processCalculation( QProgressDialog* p )
   if ( !calcNode )
   {
     //error
+    return 4;
   }
 
   double targetGeoTransform[6];
   outputGeoTransform( targetGeoTransform );
 
   //open all input rasters for reading
-  QMap< QString, GDALRasterBandH > mInputRasterBands; //raster references and corresponding scanline data
-  QMap< QString, QgsRasterMatrix* > inputScanLineData; //stores raster references and corresponding scanline data
+  QStringList rasterRefs; //raster references in the order of the input bands
+  QVector< GDALRasterBandH > mInputRasterBands;
+  QVector< double > inputNodataValues;
+  QVector< QVector<double> > inputGeoTransforms;
   QVector< GDALDatasetH > mInputDatasets; //raster references and corresponding dataset
 
   QVector<QgsRasterCalculatorEntry>::const_iterator it = mRasterEntries.constBegin();
@@ -103,8 +123,27 @@ int QgsRasterCalculator::processCalculation( QProgressDialog* p )
     int nodataSuccess;
     double nodataValue = GDALGetRasterNoDataValue( inputRasterBand, &nodataSuccess );
 
-    mInputRasterBands.insert( it->ref, inputRasterBand );
-    inputScanLineData.insert( it->ref, new QgsRasterMatrix( mNumOutputColumns, 1, new float[mNumOutputColumns], nodataValue ) );
+    QVector<double> sourceTransformation( 6 );
+    GDALGetGeoTransform( inputDataset, sourceTransformation.data() );
+
+    rasterRefs << it->ref;
+    mInputRasterBands << inputRasterBand;
+    inputNodataValues << nodataValue;
+    inputGeoTransforms << sourceTransformation;
+  }
+
+  //the formula is evaluated per pixel without intermediate matrices. It is invalid if it refers to a raster
+  //which is not in the entries
+  QgsRasterCalcKernel kernel( calcNode, rasterRefs, inputNodataValues );
+  if ( !kernel.isValid() )
+  {
+    delete calcNode;
+    QVector< GDALDatasetH >::iterator datasetIt = mInputDatasets.begin();
+    for ( ; datasetIt != mInputDatasets.end(); ++ datasetIt )
+    {
+      GDALClose( *datasetIt );
+    }
+    return 2;
   }
 
   //open output dataset for writing
@@ -143,21 +182,29 @@ int QgsRasterCalculator::processCalculation( QProgressDialog* p )
   float outputNodataValue = -FLT_MAX;
   GDALSetRasterNoDataValue( outputRasterBand, outputNodataValue );
 
-  float* resultScanLine = ( float * ) CPLMalloc( sizeof( float ) * mNumOutputColumns );
+  //read and write blocks of rows, each block is calculated in one part per thread. Keep the buffers at about 64 MB
+  int threadCount = qMax( 1, QThread::idealThreadCount() );
+  qint64 bytesPerRow = ( qint64 )sizeof( float ) * mNumOutputColumns * ( mInputRasterBands.size() + 1 );
+  int blockRows = qBound(( qint64 )1, ( qint64 )64 * 1024 * 1024 / qMax( bytesPerRow, ( qint64 )1 ), ( qint64 )256 * threadCount );
+  blockRows = qMax( 1, qMin( blockRows, mNumOutputRows ) );
+
+  QVector< float* > inputBlocks;
+  for ( int i = 0; i < mInputRasterBands.size(); ++i )
+  {
+    inputBlocks << ( float * ) CPLMalloc( sizeof( float ) * mNumOutputColumns * blockRows );
+  }
+  float* resultBlock = ( float * ) CPLMalloc( sizeof( float ) * mNumOutputColumns * blockRows );
 
   if ( p )
   {
     p->setMaximum( mNumOutputRows );
   }
 
-  QgsRasterMatrix resultMatrix;
-
-  //read / write line by line
-  for ( int i = 0; i < mNumOutputRows; ++i )
+  for ( int firstRow = 0; firstRow < mNumOutputRows; firstRow += blockRows )
   {
     if ( p )
     {
-      p->setValue( i );
+      p->setValue( firstRow );
     }
 
     if ( p && p->wasCanceled() )
@@ -165,56 +212,37 @@ int QgsRasterCalculator::processCalculation( QProgressDialog* p )
       break;
     }
 
+    int nRows = qMin( blockRows, mNumOutputRows - firstRow );
+
     //fill buffers
-    QMap< QString, QgsRasterMatrix* >::iterator bufferIt = inputScanLineData.begin();
-    for ( ; bufferIt != inputScanLineData.end(); ++bufferIt )
+    for ( int i = 0; i < mInputRasterBands.size(); ++i )
     {
-      double sourceTransformation[6];
-      GDALRasterBandH sourceRasterBand = mInputRasterBands[bufferIt.key()];
-      GDALGetGeoTransform( GDALGetBandDataset( sourceRasterBand ), sourceTransformation );
       //the function readRasterPart calls GDALRasterIO (and ev. does some conversion if raster transformations are not the same)
-      readRasterPart( targetGeoTransform, 0, i, mNumOutputColumns, 1, sourceTransformation, sourceRasterBand, bufferIt.value()->data() );
+      readRasterPart( targetGeoTransform, 0, firstRow, mNumOutputColumns, nRows, inputGeoTransforms[i].data(), mInputRasterBands.at( i ), inputBlocks.at( i ) );
     }
 
-    if ( calcNode->calculate( inputScanLineData, resultMatrix ) )
+    int partRows = ( nRows + threadCount - 1 ) / threadCount;
+    QList< QgsRasterCalculatorPart > parts;
+    for ( int row = 0; row < nRows; row += partRows )
     {
-      bool resultIsNumber = resultMatrix.isNumber();
-      float* calcData;
-
-      if ( resultIsNumber ) //scalar result. Insert number for every pixel
-      {
-        calcData = new float[mNumOutputColumns];
-        for ( int j = 0; j < mNumOutputColumns; ++j )
-        {
-          calcData[j] = resultMatrix.number();
-        }
-      }
-      else //result is real matrix
-      {
-        calcData = resultMatrix.data();
-      }
-
-      //replace all matrix nodata values with output nodatas
-      for ( int j = 0; j < mNumOutputColumns; ++j )
-      {
-        if ( calcData[j] == resultMatrix.nodataValue() )
-        {
-          calcData[j] = outputNodataValue;
-        }
-      }
-
-      //write scanline to the dataset
-      if ( GDALRasterIO( outputRasterBand, GF_Write, 0, i, mNumOutputColumns, 1, calcData, mNumOutputColumns, 1, GDT_Float32, 0, 0 ) != CE_None )
+      QgsRasterCalculatorPart part;
+      part.kernel = &kernel;
+      for ( int i = 0; i < inputBlocks.size(); ++i )
       {
-        qWarning( "RasterIO error!" );
-      }
-
-      if ( resultIsNumber )
-      {
-        delete[] calcData;
+        part.inputs << inputBlocks.at( i ) + row * mNumOutputColumns;
       }
+      part.result = resultBlock + row * mNumOutputColumns;
+      part.count = qMin( partRows, nRows - row ) * mNumOutputColumns;
+      part.outputNodataValue = outputNodataValue;
+      parts << part;
     }
+    QtConcurrent::blockingMap( parts, calculateRasterPart );
 
+    //write rows to the dataset
+    if ( GDALRasterIO( outputRasterBand, GF_Write, 0, firstRow, mNumOutputColumns, nRows, resultBlock, mNumOutputColumns, nRows, GDT_Float32, 0, 0 ) != CE_None )
+    {
+      qWarning( "RasterIO error!" );
+    }
   }
 
   if ( p )
@@ -224,12 +252,13 @@ int QgsRasterCalculator::processCalculation( QProgressDialog* p )
 
   //close datasets and release memory
   delete calcNode;
-  QMap< QString, QgsRasterMatrix* >::iterator bufferIt = inputScanLineData.begin();
-  for ( ; bufferIt != inputScanLineData.end(); ++bufferIt )
+  QVector< float* >::iterator bufferIt = inputBlocks.begin();
+  for ( ; bufferIt != inputBlocks.end(); ++bufferIt )
   {
-    delete bufferIt.value();
+    CPLFree( *bufferIt );
   }
-  inputScanLineData.clear();
+  inputBlocks.clear();
+  CPLFree( resultBlock );
 
   QVector< GDALDatasetH >::iterator datasetIt = mInputDatasets.begin();
   for ( ; datasetIt != mInputDatasets.end(); ++ datasetIt )
@@ -244,7 +273,6 @@ int QgsRasterCalculator::processCalculation( QProgressDialog* p )
     return 3;
   }
   GDALClose( outputDataset );
-  CPLFree( resultScanLine );
   return 0;
 }
 
@@ -373,11 +401,11 @@ void QgsRasterCalculator::readRasterPart( double* targetGeotransform, int xOffse
       if ( sourceIndexX >= 0 && sourceIndexX < nSourcePixelsX
            && sourceIndexY >= 0 && sourceIndexY < nSourcePixelsY )
       {
-        rasterBuffer[j + i*nRows] = sourceRaster[ sourceIndexX  + nSourcePixelsX * sourceIndexY ];
+        rasterBuffer[j + i*nCols] = sourceRaster[ sourceIndexX  + nSourcePixelsX * sourceIndexY ];
       }
       else
       {
-        rasterBuffer[j + i*j] = nodataValue;
+        rasterBuffer[j + i*nCols] = nodataValue;
       }
       targetPixelX += targetGeotransform[1];
     }
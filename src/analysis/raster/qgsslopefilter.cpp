@@ -16,6 +16,7 @@
  ***************************************************************************/
 
 #include "qgsslopefilter.h"
+#include <QVector>
 
 QgsSlopeFilter::QgsSlopeFilter( const QString& inputFile, const QString& outputFile, const QString& outputFormat )
     : QgsDerivativeFilter( inputFile, outputFile, outputFormat )
@@ -42,3 +43,19 @@ float QgsSlopeFilter::processNineCellWindow( float* x11, float* x21, float* x31,
   return atan( sqrt( derX * derX + derY * derY ) ) * 180.0 / M_PI;
 }
 
+void QgsSlopeFilter::processNineCellLine( float* above, float* line, float* below, float* result, int width )
+{
+  QVector<float> derX( width );
+  QVector<float> derY( width );
+  calcFirstDerLine( above, line, below, derX.data(), derY.data(), width );
+
+  for ( int j = 0; j < width; ++j )
+  {
+    if ( derX[j] == mOutputNodataValue || derY[j] == mOutputNodataValue )
+    {
+      result[j] = mOutputNodataValue;
+      continue;
+    }
+    result[j] = atan( sqrt( derX[j] * derX[j] + derY[j] * derY[j] ) ) * 180.0 / M_PI;
+  }
+}
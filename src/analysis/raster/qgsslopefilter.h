@@ -32,6 +32,9 @@ class ANALYSIS_EXPORT QgsSlopeFilter: public QgsDerivativeFilter
     float processNineCellWindow( float* x11, float* x21, float* x31,
                                  float* x12, float* x22, float* x32,
                                  float* x13, float* x23, float* x33 );
+
+    /**Calculates the output values of one line from the derivatives of all cells*/
+    void processNineCellLine( float* above, float* line, float* below, float* result, int width );
 };
 
 #endif // QGSSLOPEFILTER_H
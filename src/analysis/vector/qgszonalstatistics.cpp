@@ -23,6 +23,9 @@
 #include "cpl_string.h"
 #include <QProgressDialog>
 #include <QFile>
+#include <QtConcurrentMap>
+#include <cfloat>
+#include <cmath>
 
 #if defined(GDAL_VERSION_NUM) && GDAL_VERSION_NUM >= 1800
 #define TO8F(x) (x).toUtf8().constData()
@@ -30,12 +33,312 @@
 #define TO8F(x) QFile::encodeName( x ).constData()
 #endif
 
-QgsZonalStatistics::QgsZonalStatistics( QgsVectorLayer* polygonLayer, const QString& rasterFile, const QString& attributePrefix, int rasterBand )
+/**Accumulated (and optionally weighted) pixel values of a feature*/
+struct QgsZonalFeatureStats
+{
+  QgsZonalFeatureStats( bool storeValues = false ): storeValues( storeValues ) { reset(); }
+
+  void reset()
+  {
+    sum = 0;
+    sumOfSquares = 0;
+    count = 0;
+    min = FLT_MAX;
+    max = -FLT_MAX;
+    valueCount.clear();
+  }
+
+  void addValue( float value, double weight = 1.0 )
+  {
+    sum += value * weight;
+    sumOfSquares += ( double )value * value * weight;
+    count += weight;
+    min = qMin( min, value );
+    max = qMax( max, value );
+    if ( storeValues )
+    {
+      valueCount[value]++;
+    }
+  }
+
+  double sum;
+  double sumOfSquares;
+  double count;
+  float min;
+  float max;
+  /**Number of pixels per value (only if needed for median, majority or variety)*/
+  QMap<float, int> valueCount;
+  bool storeValues;
+};
+
+/**Polygon edge for the scanline rasterization*/
+struct QgsZonalEdge
+{
+  double top;
+  double bottom;
+  double x;
+  double y;
+  //change of x per y
+  double dxdy;
+};
+
+static bool edgeTopGreaterThan( const QgsZonalEdge& e1, const QgsZonalEdge& e2 )
+{
+  return e1.top > e2.top;
+}
+
+/**A feature and the raster cells of its bounding box*/
+struct QgsZonalStatisticsZone
+{
+  QgsFeatureId fid;
+  QgsGeometry geometry;
+  int offsetX;
+  int offsetY;
+  int nCellsX;
+  int nCellsY;
+  /**Edges of all rings, sorted by the top y coordinate (descending)*/
+  QVector<QgsZonalEdge> edges;
+  /**First edge not yet crossed by a scanline*/
+  int nextEdge;
+  /**Edges crossing the current scanline*/
+  QVector<int> activeEdges;
+  QgsZonalFeatureStats stats;
+};
+
+static bool zoneFirstRowLessThan( const QgsZonalStatisticsZone* z1, const QgsZonalStatisticsZone* z2 )
+{
+  return z1->offsetY < z2->offsetY || ( z1->offsetY == z2->offsetY && z1->offsetX < z2->offsetX );
+}
+
+/**Rows of a raster strip (a block row of the raster) processed for one zone*/
+struct QgsZonalStripJob
+{
+  QgsZonalStatisticsZone* zone;
+  //strip data, starting at firstColumn
+  const float* data;
+  int firstRow;
+  int nRows;
+  int firstColumn;
+  int nColumns;
+  double xMin;
+  double yMax;
+  double cellSizeX;
+  double cellSizeY;
+  float nodataValue;
+};
+
+static void addRingEdges( const QgsPolyline& ring, QVector<QgsZonalEdge>& edges )
+{
+  for ( int i = 1; i < ring.size(); ++i )
+  {
+    const QgsPoint& p1 = ring.at( i - 1 );
+    const QgsPoint& p2 = ring.at( i );
+    if ( p1.y() == p2.y() ) //horizontal edges never cross a scanline
+    {
+      continue;
+    }
+    QgsZonalEdge edge;
+    edge.top = qMax( p1.y(), p2.y() );
+    edge.bottom = qMin( p1.y(), p2.y() );
+    edge.x = p1.x();
+    edge.y = p1.y();
+    edge.dxdy = ( p2.x() - p1.x() ) / ( p2.y() - p1.y() );
+    edges.append( edge );
+  }
+}
+
+static void buildEdges( QgsZonalStatisticsZone* zone )
+{
+  QgsMultiPolygon polygons;
+  if ( zone->geometry.isMultipart() )
+  {
+    polygons = zone->geometry.asMultiPolygon();
+  }
+  else
+  {
+    polygons.append( zone->geometry.asPolygon() );
+  }
+
+  QgsMultiPolygon::const_iterator polyIt = polygons.constBegin();
+  for ( ; polyIt != polygons.constEnd(); ++polyIt )
+  {
+    QgsPolygon::const_iterator ringIt = polyIt->constBegin();
+    for ( ; ringIt != polyIt->constEnd(); ++ringIt )
+    {
+      addRingEdges( *ringIt, zone->edges );
+    }
+  }
+  qSort( zone->edges.begin(), zone->edges.end(), edgeTopGreaterThan );
+  zone->nextEdge = 0;
+}
+
+/**Adds the pixels with the centre inside the polygon (even-odd rule over all rings) for the rows of the strip.
+  Cells exactly on the boundary are handled like the half open intervals of a scanline fill*/
+static void processStripJob( QgsZonalStripJob& job )
+{
+  QgsZonalStatisticsZone* zone = job.zone;
+  int firstRow = qMax( job.firstRow, zone->offsetY );
+  int endRow = qMin( job.firstRow + job.nRows, zone->offsetY + zone->nCellsY );
+  int minColumn = zone->offsetX;
+  int maxColumn = zone->offsetX + zone->nCellsX - 1;
+
+  QVector<double> crossings;
+  for ( int row = firstRow; row < endRow; ++row )
+  {
+    double y = job.yMax - ( row + 0.5 ) * job.cellSizeY;
+
+    //edges become active once the scanline is below their top and inactive once it is below their bottom
+    while ( zone->nextEdge < zone->edges.size() && zone->edges.at( zone->nextEdge ).top > y )
+    {
+      zone->activeEdges.append( zone->nextEdge++ );
+    }
+
+    crossings.clear();
+    for ( int i = 0; i < zone->activeEdges.size(); )
+    {
+      const QgsZonalEdge& edge = zone->edges.at( zone->activeEdges.at( i ) );
+      if ( edge.bottom > y )
+      {
+        zone->activeEdges.remove( i );
+        continue;
+      }
+      crossings.append( edge.x + ( y - edge.y ) * edge.dxdy );
+      ++i;
+    }
+    qSort( crossings );
+
+    const float* line = job.data + ( row - job.firstRow ) * job.nColumns - job.firstColumn;
+    for ( int i = 0; i + 1 < crossings.size(); i += 2 )
+    {
+      //cells with the centre between two crossings
+      double startColumn = floor(( crossings.at( i ) - job.xMin ) / job.cellSizeX - 0.5 ) + 1;
+      double endColumn = ceil(( crossings.at( i + 1 ) - job.xMin ) / job.cellSizeX - 0.5 ) - 1;
+      int start = ( int )qMax( startColumn, ( double )minColumn );
+      int end = ( int )qMin( endColumn, ( double )maxColumn );
+      for ( int col = start; col <= end; ++col )
+      {
+        float value = line[col];
+        if ( value == job.nodataValue || qIsNaN( value ) ) //don't consider nodata values
+        {
+          continue;
+        }
+        zone->stats.addValue( value );
+      }
+    }
+  }
+}
+
+/**Statistics with precise pixel - polygon intersection test (slow, used if the cells are larger than the polygon)*/
+static void statisticsFromPreciseIntersection( GDALRasterBandH band, QgsGeometry* poly, int pixelOffsetX, int pixelOffsetY, int nCellsX, int nCellsY,
+    double cellSizeX, double cellSizeY, const QgsRectangle& rasterBBox, float nodataValue, QgsZonalFeatureStats& stats )
+{
+  stats.reset();
+
+  float* pixelData = ( float * ) CPLMalloc( sizeof( float ) * nCellsX * nCellsY );
+  if ( GDALRasterIO( band, GF_Read, pixelOffsetX, pixelOffsetY, nCellsX, nCellsY, pixelData, nCellsX, nCellsY, GDT_Float32, 0, 0 ) != CE_None )
+  {
+    CPLFree( pixelData );
+    return;
+  }
+
+  double currentY = rasterBBox.yMaximum() - pixelOffsetY * cellSizeY - cellSizeY / 2;
+  double hCellSizeX = cellSizeX / 2.0;
+  double hCellSizeY = cellSizeY / 2.0;
+  double pixelArea = cellSizeX * cellSizeY;
+
+  for ( int row = 0; row < nCellsY; ++row )
+  {
+    double currentX = rasterBBox.xMinimum() + cellSizeX / 2.0 + pixelOffsetX * cellSizeX;
+    for ( int col = 0; col < nCellsX; ++col )
+    {
+      float value = pixelData[row * nCellsX + col];
+      if ( value != nodataValue && !qIsNaN( value ) )
+      {
+        QgsGeometry* pixelRectGeometry = QgsGeometry::fromRect( QgsRectangle( currentX - hCellSizeX, currentY - hCellSizeY, currentX + hCellSizeX, currentY + hCellSizeY ) );
+        if ( pixelRectGeometry )
+        {
+          //intersection
+          QgsGeometry *intersectGeometry = pixelRectGeometry->intersection( poly );
+          if ( intersectGeometry )
+          {
+            double intersectionArea = intersectGeometry->area();
+            if ( intersectionArea > 0.0 )
+            {
+              stats.addValue( value, intersectionArea / pixelArea );
+            }
+            delete intersectGeometry;
+          }
+          delete pixelRectGeometry;
+        }
+      }
+      currentX += cellSizeX;
+    }
+    currentY -= cellSizeY;
+  }
+  CPLFree( pixelData );
+}
+
+static QVariant medianValue( const QMap<float, int>& valueCount )
+{
+  int n = 0;
+  QMap<float, int>::const_iterator it = valueCount.constBegin();
+  for ( ; it != valueCount.constEnd(); ++it )
+  {
+    n += it.value();
+  }
+  if ( n == 0 )
+  {
+    return QVariant( QVariant::Double );
+  }
+
+  //the values at the positions (n - 1) / 2 and n / 2 of the sorted values
+  int lowerPos = ( n - 1 ) / 2;
+  int upperPos = n / 2;
+  double lower = 0;
+  int pos = 0;
+  for ( it = valueCount.constBegin(); it != valueCount.constEnd(); ++it )
+  {
+    if ( pos <= lowerPos && lowerPos < pos + it.value() )
+    {
+      lower = it.key();
+    }
+    if ( pos <= upperPos && upperPos < pos + it.value() )
+    {
+      return QVariant(( lower + it.key() ) / 2.0 );
+    }
+    pos += it.value();
+  }
+  return QVariant( lower );
+}
+
+static QVariant majorityValue( const QMap<float, int>& valueCount )
+{
+  if ( valueCount.isEmpty() )
+  {
+    return QVariant( QVariant::Double );
+  }
+
+  QMap<float, int>::const_iterator majorityIt = valueCount.constBegin();
+  QMap<float, int>::const_iterator it = valueCount.constBegin();
+  for ( ; it != valueCount.constEnd(); ++it )
+  {
+    if ( it.value() > majorityIt.value() )
+    {
+      majorityIt = it;
+    }
+  }
+  return QVariant(( double ) majorityIt.key() );
+}
+
+QgsZonalStatistics::QgsZonalStatistics( QgsVectorLayer* polygonLayer, const QString& rasterFile, const QString& attributePrefix, int rasterBand,
+                                        Statistics stats )
     : mRasterFilePath( rasterFile )
     , mRasterBand( rasterBand )
     , mPolygonLayer( polygonLayer )
     , mAttributePrefix( attributePrefix )
     , mInputNodataValue( -1 )
+    , mStatistics( stats )
+    , mStripRows( 0 )
 {
 
 }
@@ -43,6 +346,8 @@ QgsZonalStatistics::QgsZonalStatistics( QgsVectorLayer* polygonLayer, const QStr
 QgsZonalStatistics::QgsZonalStatistics()
     : mRasterBand( 0 )
     , mPolygonLayer( 0 )
+    , mStatistics( Count | Sum | Mean )
+    , mStripRows( 0 )
 {
 
 }
@@ -109,28 +414,40 @@ int QgsZonalStatistics::calculateStatistics( QProgressDialog* p )
   QgsRectangle rasterBBox( geoTransform[0], geoTransform[3] - ( nCellsYGDAL * cellsizeY ),
                            geoTransform[0] + ( nCellsXGDAL * cellsizeX ), geoTransform[3] );
 
-  //add the new count, sum, mean fields to the provider
+  //add the new statistics fields to the provider
+  const Statistic statistics[] = { Count, Sum, Mean, Median, StDev, Min, Max, Majority, Variety };
+  const char* statisticNames[] = { "count", "sum", "mean", "median", "stdev", "min", "max", "majority", "variety" };
+  const int nStatistics = 9;
+
   QList<QgsField> newFieldList;
-  QString countFieldName = getUniqueFieldName( mAttributePrefix + "count" );
-  QString sumFieldName = getUniqueFieldName( mAttributePrefix + "sum" );
-  QString meanFieldName = getUniqueFieldName( mAttributePrefix + "mean" );
-  QgsField countField( countFieldName, QVariant::Double, "double precision" );
-  QgsField sumField( sumFieldName, QVariant::Double, "double precision" );
-  QgsField meanField( meanFieldName, QVariant::Double, "double precision" );
-  newFieldList.push_back( countField );
-  newFieldList.push_back( sumField );
-  newFieldList.push_back( meanField );
+  QStringList fieldNames;
+  for ( int i = 0; i < nStatistics; ++i )
+  {
+    if ( mStatistics & statistics[i] )
+    {
+      QString fieldName = getUniqueFieldName( mAttributePrefix + statisticNames[i] );
+      fieldNames << fieldName;
+      newFieldList.push_back( QgsField( fieldName, QVariant::Double, "double precision" ) );
+    }
+  }
   vectorProvider->addAttributes( newFieldList );
 
   //index of the new fields
-  int countIndex = vectorProvider->fieldNameIndex( countFieldName );
-  int sumIndex = vectorProvider->fieldNameIndex( sumFieldName );
-  int meanIndex = vectorProvider->fieldNameIndex( meanFieldName );
-
-  if ( countIndex == -1 || sumIndex == -1 || meanIndex == -1 )
+  QMap<Statistic, int> fieldIndexes;
+  for ( int i = 0, j = 0; i < nStatistics; ++i )
   {
-    return 8;
+    if ( mStatistics & statistics[i] )
+    {
+      int index = vectorProvider->fieldNameIndex( fieldNames.at( j++ ) );
+      if ( index == -1 )
+      {
+        GDALClose( inputDataset );
+        return 8;
+      }
+      fieldIndexes.insert( statistics[i], index );
+    }
   }
+  bool storeValues = mStatistics & ( Median | Majority | Variety );
 
   //progress dialog
   long featureCount = vectorProvider->featureCount();
@@ -139,47 +456,29 @@ int QgsZonalStatistics::calculateStatistics( QProgressDialog* p )
     p->setMaximum( featureCount );
   }
 
-
-  //iterate over each polygon
+  //collect the features and the raster cells of their bounding boxes
+  QList<QgsZonalStatisticsZone*> zones;
   QgsFeatureRequest request;
   request.setSubsetOfAttributes( QgsAttributeList() );
   QgsFeatureIterator fi = vectorProvider->getFeatures( request );
   QgsFeature f;
-  double count = 0;
-  double sum = 0;
-  double mean = 0;
-  int featureCounter = 0;
-
   while ( fi.nextFeature( f ) )
   {
-    if ( p )
-    {
-      p->setValue( featureCounter );
-    }
-
-    if ( p && p->wasCanceled() )
-    {
-      break;
-    }
-
     QgsGeometry* featureGeometry = f.geometry();
     if ( !featureGeometry )
     {
-      ++featureCounter;
       continue;
     }
 
     QgsRectangle featureRect = featureGeometry->boundingBox().intersect( &rasterBBox );
     if ( featureRect.isEmpty() )
     {
-      ++featureCounter;
       continue;
     }
 
     int offsetX, offsetY, nCellsX, nCellsY;
     if ( cellInfoForBBox( rasterBBox, featureRect, cellsizeX, cellsizeY, offsetX, offsetY, nCellsX, nCellsY ) != 0 )
     {
-      ++featureCounter;
       continue;
     }
 
@@ -192,39 +491,189 @@ int QgsZonalStatistics::calculateStatistics( QProgressDialog* p )
     {
       nCellsY = nCellsYGDAL - offsetY;
     }
+    if ( nCellsX <= 0 || nCellsY <= 0 )
+    {
+      continue;
+    }
+
+    QgsZonalStatisticsZone* zone = new QgsZonalStatisticsZone;
+    zone->fid = f.id();
+    zone->geometry = *featureGeometry;
+    zone->offsetX = offsetX;
+    zone->offsetY = offsetY;
+    zone->nCellsX = nCellsX;
+    zone->nCellsY = nCellsY;
+    zone->stats = QgsZonalFeatureStats( storeValues );
+    buildEdges( zone );
+    zones.append( zone );
+  }
+
+  //read the raster in strips of block rows, each strip only once for all the zones it overlaps
+  int blockXSize, blockYSize;
+  GDALGetBlockSize( rasterBand, &blockXSize, &blockYSize );
+  blockYSize = qMax( blockYSize, 1 );
+  int stripRows = blockYSize >= 64 ? blockYSize : ( 64 / blockYSize ) * blockYSize;
+  if ( mStripRows > 0 )
+  {
+    stripRows = mStripRows;
+  }
+
+  qSort( zones.begin(), zones.end(), zoneFirstRowLessThan );
+
+  QVector<float> stripData;
+  QList<QgsZonalStatisticsZone*> activeZones;
+  QgsChangedAttributesMap changeMap;
+  int nextZone = 0;
+  int featureCounter = 0;
+  int firstRow = 0;
+  bool canceled = false;
+
+  while ( nextZone < zones.size() || !activeZones.isEmpty() )
+  {
+    if ( p )
+    {
+      p->setValue( featureCounter );
+    }
 
-    statisticsFromMiddlePointTest( rasterBand, featureGeometry, offsetX, offsetY, nCellsX, nCellsY, cellsizeX, cellsizeY,
-                                   rasterBBox, sum, count );
+    if ( p && p->wasCanceled() )
+    {
+      canceled = true;
+      break;
+    }
 
-    if ( count <= 1 )
+    //skip the rows without features
+    if ( activeZones.isEmpty() )
     {
-      //the cell resolution is probably larger than the polygon area. We switch to precise pixel - polygon intersection in this case
-      statisticsFromPreciseIntersection( rasterBand, featureGeometry, offsetX, offsetY, nCellsX, nCellsY, cellsizeX, cellsizeY,
-                                         rasterBBox, sum, count );
+      firstRow = qMax( firstRow, ( zones.at( nextZone )->offsetY / blockYSize ) * blockYSize );
+    }
+    int nRows = qMin( stripRows, nCellsYGDAL - firstRow );
+    while ( nextZone < zones.size() && zones.at( nextZone )->offsetY < firstRow + nRows )
+    {
+      activeZones.append( zones.at( nextZone++ ) );
     }
 
+    //only read the columns covered by the zones
+    int firstColumn = nCellsXGDAL;
+    int endColumn = 0;
+    QList<QgsZonalStatisticsZone*>::const_iterator zoneIt = activeZones.constBegin();
+    for ( ; zoneIt != activeZones.constEnd(); ++zoneIt )
+    {
+      firstColumn = qMin( firstColumn, ( *zoneIt )->offsetX );
+      endColumn = qMax( endColumn, ( *zoneIt )->offsetX + ( *zoneIt )->nCellsX );
+    }
+    int nColumns = endColumn - firstColumn;
 
-    if ( count == 0 )
+    stripData.resize( nColumns * nRows );
+    if ( GDALRasterIO( rasterBand, GF_Read, firstColumn, firstRow, nColumns, nRows, stripData.data(), nColumns, nRows, GDT_Float32, 0, 0 ) != CE_None )
     {
-      mean = 0;
+      stripData.fill( mInputNodataValue );
     }
-    else
+
+    //zones are independent, process them in parallel
+    QList<QgsZonalStripJob> jobs;
+    for ( zoneIt = activeZones.constBegin(); zoneIt != activeZones.constEnd(); ++zoneIt )
     {
-      mean = sum / count;
+      QgsZonalStripJob job;
+      job.zone = *zoneIt;
+      job.data = stripData.constData();
+      job.firstRow = firstRow;
+      job.nRows = nRows;
+      job.firstColumn = firstColumn;
+      job.nColumns = nColumns;
+      job.xMin = rasterBBox.xMinimum();
+      job.yMax = rasterBBox.yMaximum();
+      job.cellSizeX = cellsizeX;
+      job.cellSizeY = cellsizeY;
+      job.nodataValue = mInputNodataValue;
+      jobs.append( job );
     }
+    QtConcurrent::blockingMap( jobs, processStripJob );
 
-    //write the statistics value to the vector data provider
-    QgsChangedAttributesMap changeMap;
-    QgsAttributeMap changeAttributeMap;
-    changeAttributeMap.insert( countIndex, QVariant( count ) );
-    changeAttributeMap.insert( sumIndex, QVariant( sum ) );
-    changeAttributeMap.insert( meanIndex, QVariant( mean ) );
-    changeMap.insert( f.id(), changeAttributeMap );
-    vectorProvider->changeAttributeValues( changeMap );
+    //write the statistics of the zones ending in this strip
+    for ( int i = 0; i < activeZones.size(); )
+    {
+      QgsZonalStatisticsZone* zone = activeZones.at( i );
+      if ( zone->offsetY + zone->nCellsY > firstRow + nRows )
+      {
+        ++i;
+        continue;
+      }
+
+      QgsZonalFeatureStats& stats = zone->stats;
+      if ( stats.count <= 1 )
+      {
+        //the cell resolution is probably larger than the polygon area. We switch to precise pixel - polygon intersection in this case
+        statisticsFromPreciseIntersection( rasterBand, &zone->geometry, zone->offsetX, zone->offsetY, zone->nCellsX, zone->nCellsY,
+                                           cellsizeX, cellsizeY, rasterBBox, mInputNodataValue, stats );
+      }
+
+      bool hasValues = stats.count > 0;
+      double mean = hasValues ? stats.sum / stats.count : 0;
+
+      QgsAttributeMap changeAttributeMap;
+      QMap<Statistic, int>::const_iterator fieldIt = fieldIndexes.constBegin();
+      for ( ; fieldIt != fieldIndexes.constEnd(); ++fieldIt )
+      {
+        QVariant value;
+        switch ( fieldIt.key() )
+        {
+          case Count:
+            value = QVariant( stats.count );
+            break;
+          case Sum:
+            value = QVariant( stats.sum );
+            break;
+          case Mean:
+            value = QVariant( mean );
+            break;
+          case Median:
+            value = medianValue( stats.valueCount );
+            break;
+          case StDev:
+            value = QVariant( hasValues ? sqrt( qMax( 0.0, stats.sumOfSquares / stats.count - mean * mean ) ) : 0.0 );
+            break;
+          case Min:
+            value = hasValues ? QVariant(( double ) stats.min ) : QVariant( QVariant::Double );
+            break;
+          case Max:
+            value = hasValues ? QVariant(( double ) stats.max ) : QVariant( QVariant::Double );
+            break;
+          case Majority:
+            value = majorityValue( stats.valueCount );
+            break;
+          case Variety:
+            value = QVariant(( double ) stats.valueCount.size() );
+            break;
+          default:
+            break;
+        }
+        changeAttributeMap.insert( fieldIt.value(), value );
+      }
+      changeMap.insert( zone->fid, changeAttributeMap );
+
+      delete zone;
+      activeZones.removeAt( i );
+      ++featureCounter;
+    }
+
+    //write the statistics values of a batch to the vector data provider
+    if ( changeMap.size() >= 1000 )
+    {
+      vectorProvider->changeAttributeValues( changeMap );
+      changeMap.clear();
+    }
+
+    firstRow += nRows;
+  }
 
-    ++featureCounter;
+  if ( !changeMap.isEmpty() )
+  {
+    vectorProvider->changeAttributeValues( changeMap );
   }
 
+  qDeleteAll( activeZones );
+  qDeleteAll( zones.mid( nextZone ) );
+
   if ( p )
   {
     p->setValue( featureCount );
@@ -233,7 +682,7 @@ int QgsZonalStatistics::calculateStatistics( QProgressDialog* p )
   GDALClose( inputDataset );
   mPolygonLayer->updateFields();
 
-  if ( p && p->wasCanceled() )
+  if ( canceled )
   {
     return 9;
   }
@@ -265,110 +714,6 @@ int QgsZonalStatistics::cellInfoForBBox( const QgsRectangle& rasterBBox, const Q
   return 0;
 }
 
-void QgsZonalStatistics::statisticsFromMiddlePointTest( void* band, QgsGeometry* poly, int pixelOffsetX,
-    int pixelOffsetY, int nCellsX, int nCellsY, double cellSizeX, double cellSizeY, const QgsRectangle& rasterBBox, double& sum, double& count )
-{
-  double cellCenterX, cellCenterY;
-
-  float* scanLine = ( float * ) CPLMalloc( sizeof( float ) * nCellsX );
-  cellCenterY = rasterBBox.yMaximum() - pixelOffsetY * cellSizeY - cellSizeY / 2;
-  count = 0;
-  sum = 0;
-
-  const GEOSGeometry* polyGeos = poly->asGeos();
-  if ( !polyGeos )
-  {
-    return;
-  }
-
-  const GEOSPreparedGeometry* polyGeosPrepared = GEOSPrepare( poly->asGeos() );
-  if ( !polyGeosPrepared )
-  {
-    return;
-  }
-
-  GEOSCoordSequence* cellCenterCoords = 0;
-  GEOSGeometry* currentCellCenter = 0;
-
-  for ( int i = 0; i < nCellsY; ++i )
-  {
-    if ( GDALRasterIO( band, GF_Read, pixelOffsetX, pixelOffsetY + i, nCellsX, 1, scanLine, nCellsX, 1, GDT_Float32, 0, 0 )
-         != CPLE_None )
-    {
-      continue;
-    }
-    cellCenterX = rasterBBox.xMinimum() + pixelOffsetX * cellSizeX + cellSizeX / 2;
-    for ( int j = 0; j < nCellsX; ++j )
-    {
-      GEOSGeom_destroy( currentCellCenter );
-      cellCenterCoords = GEOSCoordSeq_create( 1, 2 );
-      GEOSCoordSeq_setX( cellCenterCoords, 0, cellCenterX );
-      GEOSCoordSeq_setY( cellCenterCoords, 0, cellCenterY );
-      currentCellCenter = GEOSGeom_createPoint( cellCenterCoords );
-
-      if ( scanLine[j] != mInputNodataValue ) //don't consider nodata values
-      {
-        if ( GEOSPreparedContains( polyGeosPrepared, currentCellCenter ) )
-        {
-          if ( !qIsNaN( scanLine[j] ) )
-          {
-            sum += scanLine[j];
-          }
-          ++count;
-        }
-      }
-      cellCenterX += cellSizeX;
-    }
-    cellCenterY -= cellSizeY;
-  }
-  CPLFree( scanLine );
-  GEOSPreparedGeom_destroy( polyGeosPrepared );
-}
-
-void QgsZonalStatistics::statisticsFromPreciseIntersection( void* band, QgsGeometry* poly, int pixelOffsetX,
-    int pixelOffsetY, int nCellsX, int nCellsY, double cellSizeX, double cellSizeY, const QgsRectangle& rasterBBox, double& sum, double& count )
-{
-  sum = 0;
-  count = 0;
-  double currentY = rasterBBox.yMaximum() - pixelOffsetY * cellSizeY - cellSizeY / 2;
-  float* pixelData = ( float * ) CPLMalloc( sizeof( float ) );
-  QgsGeometry* pixelRectGeometry = 0;
-
-  double hCellSizeX = cellSizeX / 2.0;
-  double hCellSizeY = cellSizeY / 2.0;
-  double pixelArea = cellSizeX * cellSizeY;
-  double weight = 0;
-
-  for ( int row = 0; row < nCellsY; ++row )
-  {
-    double currentX = rasterBBox.xMinimum() + cellSizeX / 2.0 + pixelOffsetX * cellSizeX;
-    for ( int col = 0; col < nCellsX; ++col )
-    {
-      GDALRasterIO( band, GF_Read, pixelOffsetX + col, pixelOffsetY + row, nCellsX, 1, pixelData, 1, 1, GDT_Float32, 0, 0 );
-      pixelRectGeometry = QgsGeometry::fromRect( QgsRectangle( currentX - hCellSizeX, currentY - hCellSizeY, currentX + hCellSizeX, currentY + hCellSizeY ) );
-      if ( pixelRectGeometry )
-      {
-        //intersection
-        QgsGeometry *intersectGeometry = pixelRectGeometry->intersection( poly );
-        if ( intersectGeometry )
-        {
-          double intersectionArea = intersectGeometry->area();
-          if ( intersectionArea >= 0.0 )
-          {
-            weight = intersectionArea / pixelArea;
-            count += weight;
-            sum += *pixelData * weight;
-          }
-          delete intersectGeometry;
-        }
-      }
-      currentX += cellSizeX;
-    }
-    currentY -= cellSizeY;
-  }
-  CPLFree( pixelData );
-}
-
 QString QgsZonalStatistics::getUniqueFieldName( QString fieldName )
 {
   QgsVectorDataProvider* dp = mPolygonLayer->dataProvider();
@@ -25,17 +25,43 @@ class QgsGeometry;
 class QgsVectorLayer;
 class QProgressDialog;
 
-/**A class that calculates raster statistics (count, sum, mean) for a polygon or multipolygon layer and appends the results as attributes*/
+/**A class that calculates raster statistics (count, sum, mean, ...) for a polygon or multipolygon layer and appends the results as attributes*/
 class ANALYSIS_EXPORT QgsZonalStatistics
 {
   public:
-    QgsZonalStatistics( QgsVectorLayer* polygonLayer, const QString& rasterFile, const QString& attributePrefix = "", int rasterBand = 1 );
+
+    /**Statistics to calculate
+      @note added in 2.1 */
+    enum Statistic
+    {
+      Count = 1,  //!< Pixel count
+      Sum = 2,  //!< Sum of pixel values
+      Mean = 4,  //!< Mean of pixel values
+      Median = 8, //!< Median of pixel values
+      StDev = 16, //!< Standard deviation of pixel values
+      Min = 32,  //!< Min of pixel values
+      Max = 64,  //!< Max of pixel values
+      Majority = 128, //!< Most frequent pixel value
+      Variety = 256, //!< Number of distinct pixel values
+      All = Count | Sum | Mean | Median | StDev | Min | Max | Majority | Variety
+    };
+    Q_DECLARE_FLAGS( Statistics, Statistic )
+
+    QgsZonalStatistics( QgsVectorLayer* polygonLayer, const QString& rasterFile, const QString& attributePrefix = "", int rasterBand = 1,
+                        Statistics stats = Statistics( Count | Sum | Mean ) );
     ~QgsZonalStatistics();
 
     /**Starts the calculation
-      @return 0 in case of success*/
+      @return 0 in case of success, 9 if the calculation was canceled in the progress dialog,
+      other values in case of error*/
     int calculateStatistics( QProgressDialog* p );
 
+    /**Sets the number of raster rows read at once. The zones of a strip are processed in parallel
+      @param rows strip height or 0 to use the block height of the raster (at least 64 rows, the default)
+      @note added in 2.1 */
+    void setStripRows( int rows ) { mStripRows = rows; }
+    int stripRows() const { return mStripRows; }
+
   private:
     QgsZonalStatistics();
     /**Analysis what cells need to be considered to cover the bounding box of a feature
@@ -43,17 +69,6 @@ class ANALYSIS_EXPORT QgsZonalStatistics
     int cellInfoForBBox( const QgsRectangle& rasterBBox, const QgsRectangle& featureBBox, double cellSizeX, double cellSizeY,
                          int& offsetX, int& offsetY, int& nCellsX, int& nCellsY ) const;
 
-    /**Returns statistics by considering the pixels where the center point is within the polygon (fast)*/
-    void statisticsFromMiddlePointTest( void* band, QgsGeometry* poly, int pixelOffsetX, int pixelOffsetY, int nCellsX, int nCellsY,
-                                        double cellSizeX, double cellSizeY, const QgsRectangle& rasterBBox, double& sum, double& count );
-
-    void statisticsFromMiddlePointTest_improved( void* band, QgsGeometry* poly, int pixelOffsetX, int pixelOffsetY, int nCellsX, int nCellsY,
-        double cellSizeX, double cellSizeY, const QgsRectangle& rasterBBox, double& sum, double& count );
-
-    /**Returns statistics with precise pixel - polygon intersection test (slow) */
-    void statisticsFromPreciseIntersection( void* band, QgsGeometry* poly, int pixelOffsetX, int pixelOffsetY, int nCellsX, int nCellsY,
-                                            double cellSizeX, double cellSizeY, const QgsRectangle& rasterBBox, double& sum, double& count );
-
     QString getUniqueFieldName( QString fieldName );
 
     QString mRasterFilePath;
@@ -63,6 +78,12 @@ class ANALYSIS_EXPORT QgsZonalStatistics
     QString mAttributePrefix;
     /**The nodata value of the input layer*/
     float mInputNodataValue;
+    /**Statistics written to the attributes*/
+    Statistics mStatistics;
+    /**Raster rows read at once (0: derived from the block height)*/
+    int mStripRows;
 };
 
+Q_DECLARE_OPERATORS_FOR_FLAGS( QgsZonalStatistics::Statistics )
+
 #endif // QGSZONALSTATISTICS_H
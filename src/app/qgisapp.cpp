@@ -6029,6 +6029,8 @@ void QgisApp::refreshMapCanvas()
   QgsMapLayerRegistry::instance()->clearAllLayerCaches();
   //reload cached provider data
   QgsMapLayerRegistry::instance()->reloadAllLayers();
+  //labels may change with the reloaded data
+  mLBL->clearPlacementCache();
   //then refresh
   mMapCanvas->refresh();
 }
@@ -216,6 +216,9 @@ void QgsComposerMap::draw( QPainter *painter, const QgsRectangle& extent, const
 
     // make the renderer respect the composition's useAdvancedEffects flag
     theRendererContext->setUseAdvancedEffects( mComposition->useAdvancedEffects() );
+
+    // layer state set for this print only (e.g. by a WMS GetPrint request)
+    theRendererContext->setLayerOverrides( mMapRenderer->rendererContext()->layerOverrides() );
   }
 
   //force composer map scale for scale dependent visibility
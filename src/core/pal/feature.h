@@ -249,7 +249,7 @@ namespace pal
        * \param bbox_min min values of the map extent
        * \param bbox_max max values of the map extent
        * \param mapShape generate candidates for this spatial entites
-       * \param candidates index for candidates
+       * \param candidates index for candidates, may be NULL (the caller then has to index the returned candidates)
        * \param svgmap svg map file
        * \return the number of candidates in *lPos
        */
@@ -33,7 +33,10 @@
 
 //#define _VERBOSE_
 //#define _EXPORT_MAP_
+#include <QThread>
 #include <QTime>
+#include <QVector>
+#include <QtConcurrentMap>
 
 #define _CRT_SECURE_NO_DEPRECATE
 
@@ -109,6 +112,8 @@ namespace pal
 
     showPartial = true;
 
+    threadCount = QThread::idealThreadCount();
+
     this->map_unit = pal::METER;
 
     std::cout.precision( 12 );
@@ -198,14 +203,25 @@ namespace pal
   }
 
 
+  typedef struct _candidatesJob
+  {
+    FeaturePart *part;
+    double scale;
+    double *bbox_min;
+    double *bbox_max;
+    LabelPosition **lPos;
+    int nblp;
+#ifdef _EXPORT_MAP_
+    std::ofstream *svgmap;
+#endif
+  } CandidatesJob;
+
   typedef struct _featCbackCtx
   {
     Layer *layer;
     double scale;
-    LinkedList<Feats*> *fFeats;
+    QVector<CandidatesJob> *jobs;
     RTree<PointSet*, double, 2, double> *obstacles;
-    RTree<LabelPosition*, double, 2, double> *candidates;
-    double priority;
     double bbox_min[2];
     double bbox_max[2];
 #ifdef _EXPORT_MAP_
@@ -271,35 +287,39 @@ namespace pal
       }
     }
 
-    // generate candidates for the feature part
-    LabelPosition** lPos = NULL;
-    int nblp = ft_ptr->setPosition( context->scale, &lPos, context->bbox_min, context->bbox_max, ft_ptr, context->candidates
+    // candidates for the feature part are generated once all the parts of the layer are extracted
+    CandidatesJob job;
+    job.part = ft_ptr;
+    job.scale = context->scale;
+    job.bbox_min = context->bbox_min;
+    job.bbox_max = context->bbox_max;
+    job.lPos = NULL;
+    job.nblp = 0;
 #ifdef _EXPORT_MAP_
-                                    , *context->svgmap
+    job.svgmap = context->svgmap;
 #endif
-                                  );
-
-    if ( nblp > 0 )
-    {
-      // valid features are added to fFeats
-      Feats *ft = new Feats();
-      ft->feature = ft_ptr;
-      ft->shape = NULL;
-      ft->nblp = nblp;
-      ft->lPos = lPos;
-      ft->priority = context->priority;
-      context->fFeats->push_back( ft );
-    }
-    else
-    {
-      // Others are deleted
-      delete[] lPos;
-    }
+    context->jobs->append( job );
 
     return true;
   }
 
 
+  /*
+   * Generate the candidates of a feature part
+   *
+   * Only reads the feature part and the layer, so the parts
+   * of a layer can be processed in parallel
+   */
+  void generateCandidates( CandidatesJob &job )
+  {
+    job.nblp = job.part->setPosition( job.scale, &job.lPos, job.bbox_min, job.bbox_max, job.part, NULL
+#ifdef _EXPORT_MAP_
+                                      , *job.svgmap
+#endif
+                                    );
+  }
+
+
 
 
   typedef struct _filterContext
@@ -346,6 +366,9 @@ namespace pal
   Problem* Pal::extract( int nbLayers, char **layersName, double *layersFactor, double lambda_min, double phi_min, double lambda_max, double phi_max, double scale, std::ofstream *svgmap )
   {
     Q_UNUSED( svgmap );
+    QTime t;
+    t.start();
+
     // to store obstacles
     RTree<PointSet*, double, 2, double> *obstacles = new RTree<PointSet*, double, 2, double>();
 
@@ -374,11 +397,12 @@ namespace pal
 
     LinkedList<Feats*> *fFeats = new LinkedList<Feats*> ( ptrFeatsCompare );
 
+    QVector<CandidatesJob> jobs;
+
     FeatCallBackCtx *context = new FeatCallBackCtx();
-    context->fFeats = fFeats;
+    context->jobs = &jobs;
     context->scale = scale;
     context->obstacles = obstacles;
-    context->candidates = prob->candidates;
 
     context->bbox_min[0] = amin[0];
     context->bbox_min[1] = amin[1];
@@ -424,8 +448,7 @@ namespace pal
               layer->joinConnectedFeatures();
 
             context->layer = layer;
-            context->priority = layersFactor[i];
-            // lookup for feature (and generates candidates list)
+            // lookup for feature
 
 #ifdef _EXPORT_MAP_
             *svgmap << "<g inkscape:label=\"" << layer->name << "\"" << std::endl
@@ -435,8 +458,44 @@ namespace pal
 
             context->layer->modMutex->lock();
             context->layer->rtree->Search( amin, amax, extractFeatCallback, ( void* ) context );
+
+            // generates candidates list
+            QTime candidatesTime;
+            candidatesTime.start();
+#ifndef _EXPORT_MAP_
+            if ( threadCount > 1 && jobs.size() > 1 )
+              QtConcurrent::blockingMap( jobs, generateCandidates );
+            else
+#endif
+              for ( j = 0; j < jobs.size(); j++ )
+                generateCandidates( jobs[j] );
+            prob->candidatesTime += candidatesTime.elapsed();
+
             context->layer->modMutex->unlock();
 
+            for ( j = 0; j < jobs.size(); j++ )
+            {
+              if ( jobs[j].nblp > 0 )
+              {
+                // valid features are added to fFeats
+                Feats *ft = new Feats();
+                ft->feature = jobs[j].part;
+                ft->shape = NULL;
+                ft->nblp = jobs[j].nblp;
+                ft->lPos = jobs[j].lPos;
+                ft->priority = layersFactor[i];
+                for ( int k = 0; k < ft->nblp; k++ )
+                  ft->lPos[k]->insertIntoIndex( prob->candidates );
+                fFeats->push_back( ft );
+              }
+              else
+              {
+                // Others are deleted
+                delete[] jobs[j].lPos;
+              }
+            }
+            jobs.clear();
+
 #ifdef _EXPORT_MAP_
             *svgmap  << "</g>" << std::endl << std::endl;
 #endif
@@ -448,15 +507,15 @@ namespace pal
             std::cout << "     obstacle:" << layer->isObstacle() << std::endl;
             std::cout << "     toLabel:" << layer->isToLabel() << std::endl;
             std::cout << "     # features: " << layer->getNbFeatures() << std::endl;
-            std::cout << "     # extracted features: " << context->fFeats->size() - oldNbft << std::endl;
+            std::cout << "     # extracted features: " << fFeats->size() - oldNbft << std::endl;
 #endif
-            if ( context->fFeats->size() - oldNbft > 0 )
+            if ( fFeats->size() - oldNbft > 0 )
             {
               char *name = new char[strlen( layer->getName() ) +1];
               strcpy( name, layer->getName() );
               labLayers->push_back( name );
             }
-            oldNbft = context->fFeats->size();
+            oldNbft = fFeats->size();
 
 
             break;
@@ -615,6 +674,7 @@ namespace pal
     nbOverlaps /= 2;
     prob->all_nblp = prob->nblp;
     prob->nbOverlap = nbOverlaps;
+    prob->extractTime = t.elapsed();
 
 
 #ifdef _VERBOSE_
@@ -756,13 +816,9 @@ namespace pal
 #endif
 
     // search a solution
-    if ( searchMethod == FALP )
-      prob->init_sol_falp();
-    else if ( searchMethod == CHAIN )
-      prob->chain_search();
-    else
-      prob->popmusic();
+    prob->solve( threadCount );
 
+    prob->searchTime = t.elapsed();
     std::cout << "PAL SEARCH (" << searchMethod << "): " << t.elapsed() / 1000.0 << " s" << std::endl;
     t.restart();
 
@@ -830,14 +886,13 @@ namespace pal
     if ( prob == NULL )
       return new std::list<LabelPosition*>();
 
+    QTime t;
+    t.start();
+
     prob->reduce();
+    prob->solve( threadCount );
 
-    if ( searchMethod == FALP )
-      prob->init_sol_falp();
-    else if ( searchMethod == CHAIN )
-      prob->chain_search();
-    else
-      prob->popmusic();
+    prob->searchTime = t.elapsed();
 
     return prob->getSolution( displayAll );
   }
@@ -907,6 +962,16 @@ namespace pal
     this->showPartial = show;
   }
 
+  void Pal::setThreadCount( int threadCount )
+  {
+    this->threadCount = threadCount;
+  }
+
+  int Pal::getThreadCount()
+  {
+    return threadCount;
+  }
+
   int Pal::getPointP()
   {
     return point_p;
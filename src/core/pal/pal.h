@@ -172,6 +172,11 @@ namespace pal
        */
       bool showPartial;
 
+      /**
+       * \brief # threads used to generate the candidates and to search the solution
+       */
+      int threadCount;
+
       /**
        * \brief Problem factory
        * Extract features to label and generates candidates for them,
@@ -372,6 +377,23 @@ namespace pal
        */
       bool getShowPartial();
 
+      /**
+       * \brief Set the number of threads used for labeling
+       *
+       * Candidates of the features of a layer are generated in parallel, independent
+       * parts of the problem are solved concurrently. Defaults to the number of cores,
+       * a value below 2 disables threading.
+       * @param threadCount maximum number of threads
+       */
+      void setThreadCount( int threadCount );
+
+      /**
+       * \brief Get the number of threads used for labeling
+       *
+       * @return maximum number of threads
+       */
+      int getThreadCount();
+
       /**
        * \brief set # candidates to generate for points features
        * Higher the value is, longer Pal::labeller will spend time
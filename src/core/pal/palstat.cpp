@@ -45,6 +45,10 @@ namespace pal
     layersName = NULL;
     layersNbObjects = NULL;
     layersNbLabelledObjects = NULL;
+    candidatesTime = 0;
+    extractTime = 0;
+    searchTime = 0;
+    nbComponents = 0;
   }
 
   PalStat::~PalStat()
@@ -102,6 +106,26 @@ namespace pal
       return -1;
   }
 
+  int PalStat::getCandidatesTime()
+  {
+    return candidatesTime;
+  }
+
+  int PalStat::getExtractTime()
+  {
+    return extractTime;
+  }
+
+  int PalStat::getSearchTime()
+  {
+    return searchTime;
+  }
+
+  int PalStat::getNbComponents()
+  {
+    return nbComponents;
+  }
+
 
 } // namespace
 
@@ -57,6 +57,11 @@ namespace pal
       int *layersNbObjects; // [nbLayers]
       int *layersNbLabelledObjects; // [nbLayers]
 
+      int candidatesTime;
+      int extractTime;
+      int searchTime;
+      int nbComponents;
+
       PalStat();
 
     public:
@@ -96,6 +101,26 @@ namespace pal
        * \brief get the number of object in layer 'layerId' which are labelled
        */
       int getLayerNbLabelledObjects( int layerId );
+
+      /**
+       * \brief time spent generating the label candidates, in ms
+       */
+      int getCandidatesTime();
+
+      /**
+       * \brief time spent creating the problem (including candidates generation), in ms
+       */
+      int getExtractTime();
+
+      /**
+       * \brief time spent reducing the problem and searching a solution, in ms
+       */
+      int getSearchTime();
+
+      /**
+       * \brief # independent parts of the problem solved concurrently (0 if the problem was not split)
+       */
+      int getNbComponents();
   };
 
 } // end namespace pal
@@ -45,6 +45,10 @@
 #include <list>
 #include <limits.h> //for INT_MAX
 
+#include <QPair>
+#include <QtAlgorithms>
+#include <QtConcurrentMap>
+
 #include <pal/pal.h>
 #include <pal/palstat.h>
 #include <pal/layer.h>
@@ -73,7 +77,7 @@ namespace pal
     }
   }
 
-  Problem::Problem() : nblp( 0 ), all_nblp( 0 ), nbft( 0 ), displayAll( 0 ), labelpositions( NULL ), featStartId( NULL ), featNbLp( NULL ), inactiveCost( NULL ), sol( NULL )
+  Problem::Problem() : nbLabelledLayers( 0 ), labelledLayersName( NULL ), nblp( 0 ), all_nblp( 0 ), nbft( 0 ), displayAll( 0 ), labelpositions( NULL ), featStartId( NULL ), featNbLp( NULL ), inactiveCost( NULL ), sol( NULL ), candidatesTime( 0 ), extractTime( 0 ), searchTime( 0 ), nbComponents( 0 )
   {
     bbox[0] = 0;
     bbox[1] = 0;
@@ -2937,6 +2941,221 @@ namespace pal
 //#undef _DEBUG_FULL_
 #endif
 
+  void Problem::search()
+  {
+    if ( pal->searchMethod == FALP )
+      init_sol_falp();
+    else if ( pal->searchMethod == CHAIN )
+      chain_search();
+    else
+      popmusic();
+  }
+
+  inline int componentRoot( int *parent, int i )
+  {
+    while ( parent[i] != i )
+    {
+      parent[i] = parent[parent[i]];
+      i = parent[i];
+    }
+    return i;
+  }
+
+  typedef struct
+  {
+    LabelPosition *lp;
+    int *parent;
+  } ComponentContext;
+
+  bool componentCallback( LabelPosition *lp, void *ctx )
+  {
+    ComponentContext *context = ( ComponentContext* ) ctx;
+
+    if ( context->lp->isInConflict( lp ) )
+    {
+      int r1 = componentRoot( context->parent, context->lp->getProblemFeatureId() );
+      int r2 = componentRoot( context->parent, lp->getProblemFeatureId() );
+      if ( r1 != r2 )
+        context->parent[r2] = r1;
+    }
+
+    return true;
+  }
+
+  static void searchSubProblem( Problem *&sub )
+  {
+    sub->search();
+  }
+
+  void Problem::solve( int threadCount )
+  {
+    int i, j;
+
+    nbComponents = 0;
+
+    if ( nbft == 0 || threadCount < 2 )
+    {
+      search();
+      return;
+    }
+
+    // features linked by a conflict between their candidates
+    int *parent = new int[nbft];
+    for ( i = 0; i < nbft; i++ )
+      parent[i] = i;
+
+    double amin[2];
+    double amax[2];
+    ComponentContext context;
+    context.parent = parent;
+
+    for ( i = 0; i < nbft; i++ )
+    {
+      for ( j = 0; j < featNbLp[i]; j++ )
+      {
+        context.lp = labelpositions[featStartId[i] + j];
+        if ( context.lp->getNumOverlaps() == 0 )
+          continue;
+
+        context.lp->getBoundingBox( amin, amax );
+        candidates->Search( amin, amax, componentCallback, ( void* ) &context );
+      }
+    }
+
+    // # candidates of each component, indexed by the root feature
+    int *componentSize = new int[nbft];
+    for ( i = 0; i < nbft; i++ )
+      componentSize[i] = 0;
+
+    for ( i = 0; i < nbft; i++ )
+    {
+      int root = componentRoot( parent, i );
+      if ( componentSize[root] == 0 )
+        nbComponents++;
+      componentSize[root] += featNbLp[i] + 1;
+    }
+
+    if ( nbComponents < 2 )
+    {
+      delete[] componentSize;
+      delete[] parent;
+      search();
+      return;
+    }
+
+    // distribute the components, biggest first, to the least loaded sub problem
+    int nbParts = qMin( threadCount, nbComponents );
+    QVector< QPair<int, int> > components;
+    components.reserve( nbComponents );
+    for ( i = 0; i < nbft; i++ )
+    {
+      if ( componentSize[i] > 0 )
+        components.append( qMakePair( -componentSize[i], i ) );
+    }
+    qSort( components );
+
+    QVector<int> componentPart( nbft, 0 );
+    QVector<int> partLoad( nbParts, 0 );
+    for ( i = 0; i < components.size(); i++ )
+    {
+      int part = 0;
+      for ( j = 1; j < nbParts; j++ )
+      {
+        if ( partLoad[j] < partLoad[part] )
+          part = j;
+      }
+      partLoad[part] -= components[i].first;
+      componentPart[components[i].second] = part;
+    }
+
+    QVector< QVector<int> > partFeatures( nbParts );
+    for ( i = 0; i < nbft; i++ )
+      partFeatures[componentPart[componentRoot( parent, i )]].append( i );
+
+    delete[] componentSize;
+    delete[] parent;
+
+    QList<Problem*> subs;
+    for ( i = 0; i < nbParts; i++ )
+      subs.append( subProblem( partFeatures[i] ) );
+
+    QtConcurrent::blockingMap( subs, searchSubProblem );
+
+    init_sol_empty();
+    sol->cost = 0.0;
+    for ( i = 0; i < nbParts; i++ )
+      releaseSubProblem( subs[i], partFeatures[i] );
+  }
+
+  Problem *Problem::subProblem( const QVector<int> &features )
+  {
+    int i, j;
+
+    Problem *sub = new Problem();
+    sub->displayAll = displayAll;
+    sub->bbox[0] = bbox[0];
+    sub->bbox[1] = bbox[1];
+    sub->bbox[2] = bbox[2];
+    sub->bbox[3] = bbox[3];
+    sub->scale = scale;
+    sub->pal = pal;
+
+    sub->nbft = features.size();
+    sub->featStartId = new int[sub->nbft];
+    sub->featNbLp = new int[sub->nbft];
+    sub->inactiveCost = new double[sub->nbft];
+
+    for ( i = 0; i < sub->nbft; i++ )
+      sub->nblp += featNbLp[features[i]];
+    sub->all_nblp = sub->nblp;
+    sub->labelpositions = new LabelPosition*[sub->nblp];
+
+    int nbOverlaps = 0;
+    int idlp = 0;
+    for ( i = 0; i < sub->nbft; i++ )
+    {
+      int feat = features[i];
+      sub->featStartId[i] = idlp;
+      sub->featNbLp[i] = featNbLp[feat];
+      sub->inactiveCost[i] = inactiveCost[feat];
+
+      for ( j = 0; j < featNbLp[feat]; j++, idlp++ )
+      {
+        LabelPosition *lp = labelpositions[featStartId[feat] + j];
+        lp->setProblemIds( i, idlp );
+        lp->insertIntoIndex( sub->candidates );
+        sub->labelpositions[idlp] = lp;
+        nbOverlaps += lp->getNumOverlaps();
+      }
+    }
+    sub->nbOverlap = nbOverlaps / 2;
+
+    return sub;
+  }
+
+  void Problem::releaseSubProblem( Problem *sub, const QVector<int> &features )
+  {
+    int i, j;
+
+    for ( i = 0; i < sub->nbft; i++ )
+    {
+      int feat = features[i];
+
+      if ( sub->sol->s[i] == -1 )
+        sol->s[feat] = -1;
+      else
+        sol->s[feat] = featStartId[feat] + sub->sol->s[i] - sub->featStartId[i];
+
+      for ( j = 0; j < featNbLp[feat]; j++ )
+        labelpositions[featStartId[feat] + j]->setProblemIds( feat, featStartId[feat] + j );
+    }
+    sol->cost += sub->sol->cost;
+
+    // the candidates belong to this problem
+    sub->all_nblp = 0;
+    delete sub;
+  }
+
   bool Problem::compareLabelArea( pal::LabelPosition* l1, pal::LabelPosition* l2 )
   {
     return l1->getWidth() * l1->getHeight() > l2->getWidth() * l2->getHeight();
@@ -2985,6 +3204,11 @@ namespace pal
     stats->nbObjects = nbft;
     stats->nbLabelledObjects = 0;
 
+    stats->candidatesTime = candidatesTime;
+    stats->extractTime = extractTime;
+    stats->searchTime = searchTime;
+    stats->nbComponents = nbComponents;
+
     stats->nbLayers = nbLabelledLayers;
     stats->layersName = new char*[stats->nbLayers];
     stats->layersNbObjects = new int[stats->nbLayers];
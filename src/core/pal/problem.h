@@ -35,6 +35,7 @@
 #define _PROBLEM_H
 
 #include <list>
+#include <QVector>
 #include <pal/pal.h>
 #include "rtree.hpp"
 
@@ -167,9 +168,45 @@ namespace pal
 
       Pal *pal;
 
+      /**
+       * \brief time spent generating the candidates, in ms
+       */
+      int candidatesTime;
+
+      /**
+       * \brief time spent creating the problem (including candidates generation), in ms
+       */
+      int extractTime;
+
+      /**
+       * \brief time spent reducing the problem and searching a solution, in ms
+       */
+      int searchTime;
+
+      /**
+       * \brief # independent parts (connected components of the conflict graph)
+       */
+      int nbComponents;
+
       void solution_cost();
       void check_solution();
 
+      /**
+       * \brief create a problem with some features of this one
+       *
+       * The candidates of the features are borrowed: their problem ids are
+       * renumbered for the sub problem and restored by releaseSubProblem()
+       * @param features ids of the features to put in the sub problem
+       */
+      Problem *subProblem( const QVector<int> &features );
+
+      /**
+       * \brief copy the solution of a sub problem and delete it
+       * @param sub problem created by subProblem()
+       * @param features same features as passed to subProblem()
+       */
+      void releaseSubProblem( Problem *sub, const QVector<int> &features );
+
     public:
       Problem();
 
@@ -184,11 +221,30 @@ namespace pal
       int getFeatureCandidateCount( int i ) { return featNbLp[i]; }
       // both features and candidates counted 0..n-1
       LabelPosition* getFeatureCandidate( int fi, int ci ) { return labelpositions[ featStartId[fi] + ci]; }
+      int getCandidatesTime() { return candidatesTime; }
+      int getExtractTime() { return extractTime; }
+      int getSearchTime() { return searchTime; }
+      int getNumComponents() { return nbComponents; }
       /////////////////
 
 
       void reduce();
 
+      /**
+       * \brief search a solution with the search method of pal
+       */
+      void search();
+
+      /**
+       * \brief search a solution, solving the independent parts of the problem concurrently
+       *
+       * Features whose candidates are never in conflict with each other do not influence
+       * each other's placement. The connected components of the conflict graph are
+       * distributed among threadCount sub problems which are searched in parallel.
+       * @param threadCount maximum # of sub problems searched at once
+       */
+      void solve( int threadCount );
+
 
       void post_optimization();
 
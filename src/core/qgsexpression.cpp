@@ -22,6 +22,7 @@
 #include <QRegExp>
 #include <QColor>
 #include <QUuid>
+#include <QVector>
 
 #include <math.h>
 #include <limits>
@@ -195,6 +196,16 @@ inline bool isIntervalSafe( const QVariant& v )
 
 inline bool isNull( const QVariant& v ) { return v.isNull(); }
 
+// regular expression of a LIKE pattern
+static QString likeToRegExp( const QString& pattern )
+{
+  QString esc_regexp = QRegExp::escape( pattern );
+  // XXX escape % and _  ???
+  esc_regexp.replace( "%", ".*" );
+  esc_regexp.replace( "_", "." );
+  return esc_regexp;
+}
+
 ///////////////////////////////////////////////
 // evaluation error macros
 
@@ -649,7 +660,7 @@ static QVariant fcnRegexpReplace( const QVariantList& values, const QgsFeature*
   QString regexp = getStringValue( values.at( 1 ), parent );
   QString after = getStringValue( values.at( 2 ), parent );
 
-  QRegExp re( regexp );
+  const QRegExp& re = parent->regExp( regexp );
   if ( !re.isValid() )
   {
     parent->setEvalErrorString( QObject::tr( "Invalid regular expression '%1': %2" ).arg( regexp ).arg( re.errorString() ) );
@@ -663,7 +674,7 @@ static QVariant fcnRegexpMatch( const QVariantList& values, const QgsFeature* ,
   QString str = getStringValue( values.at( 0 ), parent );
   QString regexp = getStringValue( values.at( 1 ), parent );
 
-  QRegExp re( regexp );
+  const QRegExp& re = parent->regExp( regexp );
   if ( !re.isValid() )
   {
     parent->setEvalErrorString( QObject::tr( "Invalid regular expression '%1': %2" ).arg( regexp ).arg( re.errorString() ) );
@@ -677,7 +688,7 @@ static QVariant fcnRegexpSubstr( const QVariantList& values, const QgsFeature* ,
   QString str = getStringValue( values.at( 0 ), parent );
   QString regexp = getStringValue( values.at( 1 ), parent );
 
-  QRegExp re( regexp );
+  const QRegExp& re = parent->regExp( regexp );
   if ( !re.isValid() )
   {
     parent->setEvalErrorString( QObject::tr( "Invalid regular expression '%1': %2" ).arg( regexp ).arg( re.errorString() ) );
@@ -734,7 +745,7 @@ static QVariant fcnConcat( const QVariantList& values, const QgsFeature* , QgsEx
 static QVariant fcnStrpos( const QVariantList& values, const QgsFeature* , QgsExpression *parent )
 {
   QString string = getStringValue( values.at( 0 ), parent );
-  return string.indexOf( QRegExp( getStringValue( values.at( 1 ), parent ) ) );
+  return string.indexOf( parent->regExp( getStringValue( values.at( 1 ), parent ) ) );
 }
 
 static QVariant fcnRight( const QVariantList& values, const QgsFeature* , QgsExpression *parent )
@@ -1615,11 +1626,653 @@ int QgsExpression::functionCount()
 }
 
 
+///////////////////////////////////////////////
+// compiled evaluation
+
+/*
+ * Flat form of a prepared expression tree. The nodes are lowered in evaluation
+ * order to an array of instructions, each of them storing its result in its own
+ * register. Registers keep integers, doubles and strings unboxed, so the common
+ * operators avoid QVariant conversions, and subtrees with literal operands only
+ * are folded to constant registers.
+ *
+ * Operands of other types are passed to the operator implementation of the node.
+ * CASE and functions / IN lists with children that could fail are evaluated by
+ * the tree walker as they evaluate their children lazily. The results and errors
+ * are thus always the same as with Node::eval().
+ */
+class QgsExpression::Program
+{
+  public:
+    Program( QgsExpression* parent ) : mParent( parent ), mResult( -1 ) {}
+
+    //! returns false if there is nothing to gain compared to the tree walker
+    bool compile( Node* root );
+
+    QVariant eval( const QgsFeature* f );
+
+  private:
+    struct Value
+    {
+      enum Type { Null, Int, Double, String, Other };
+
+      Value() : type( Null ), i( 0 ), d( 0 ) {}
+
+      Type type;
+      int i;
+      double d;
+      QString s;
+      QVariant v; // null and other values
+    };
+
+    enum OpCode
+    {
+      opNode,       // evaluated by the tree walker (also column references)
+      opNot,
+      opMinus,
+      opArithmetic, // + - * / %
+      opPow,
+      opAnd,
+      opOr,
+      opCompare,    // = <> <= >= < >
+      opIs,         // IS, IS NOT
+      opBinary,     // other binary operators
+      opIn,
+      opFunction
+    };
+
+    struct Instruction
+    {
+      OpCode op;
+      Node* node;
+      bool mayFail; // may set an evaluation error
+      int dst;
+      QVector<int> src;
+      Function* function;
+      bool coalesce;
+    };
+
+    int compileNode( Node* node, bool& mayFail );
+    int addConstant( const QVariant& value );
+    int addInstruction( OpCode op, Node* node, bool mayFail, const QVector<int>& src = QVector<int>(), Function* function = 0 );
+    void rollback( int instructionCount, int registerCount );
+
+    static bool isConstant( Node* node );
+
+    static void setValue( Value& r, const QVariant& v );
+    static void setNull( Value& r ) { r.type = Value::Null; r.v = QVariant(); }
+    static void setTVL( Value& r, TVL tvl );
+    static QVariant variant( const Value& r );
+    static bool isNumeric( const Value& r ) { return r.type == Value::Int || r.type == Value::Double; }
+    static double number( const Value& r ) { return r.type == Value::Int ? r.i : r.d; }
+    static bool doubleSafe( const Value& r, double& x );
+    static QString string( const Value& r );
+    static bool getTVL( const Value& r, TVL& tvl );
+    static bool equal( const Value& a, const Value& b );
+
+    static bool compare( BinaryOperator op, double diff );
+    static int computeInt( BinaryOperator op, int x, int y );
+    static double computeDouble( BinaryOperator op, double x, double y );
+
+    QgsExpression* mParent;
+    QVector<Instruction> mInstructions;
+    QVector<Value> mRegisters;
+    int mResult;
+};
+
+bool QgsExpression::Program::compile( Node* root )
+{
+  bool mayFail;
+  mResult = compileNode( root, mayFail );
+
+  // a single call of the tree walker would just add overhead
+  return !( mInstructions.count() == 1 && mInstructions[0].op == opNode );
+}
+
+int QgsExpression::Program::compileNode( Node* node, bool& mayFail )
+{
+  mayFail = false;
+
+  if ( node->nodeType() == ntLiteral )
+    return addConstant( static_cast<NodeLiteral*>( node )->value() );
+
+  if ( isConstant( node ) )
+  {
+    QVariant value = node->eval( mParent, 0 );
+    if ( !mParent->hasEvalError() )
+      return addConstant( value );
+
+    // leave the error for evaluation
+    mParent->setEvalErrorString( QString() );
+  }
+
+  switch ( node->nodeType() )
+  {
+    case ntColumnRef:
+      return addInstruction( opNode, node, false );
+
+    case ntUnaryOperator:
+    {
+      NodeUnaryOperator* n = static_cast<NodeUnaryOperator*>( node );
+      QVector<int> src;
+      src << compileNode( n->operand(), mayFail );
+      mayFail = true;
+      return addInstruction( n->op() == uoNot ? opNot : opMinus, node, true, src );
+    }
+
+    case ntBinaryOperator:
+    {
+      NodeBinaryOperator* n = static_cast<NodeBinaryOperator*>( node );
+      bool leftMayFail, rightMayFail;
+      QVector<int> src;
+      src << compileNode( n->opLeft(), leftMayFail );
+      src << compileNode( n->opRight(), rightMayFail );
+
+      OpCode op = opBinary; // regexp, like and concatenation never fail
+      bool opMayFail = false;
+      switch ( n->op() )
+      {
+        case boAnd: op = opAnd; opMayFail = true; break;
+        case boOr: op = opOr; opMayFail = true; break;
+        case boEQ:
+        case boNE:
+        case boLE:
+        case boGE:
+        case boLT:
+        case boGT: op = opCompare; break;
+        case boIs:
+        case boIsNot: op = opIs; break;
+        case boPlus:
+        case boMinus:
+        case boMul:
+        case boDiv:
+        case boMod: op = opArithmetic; opMayFail = true; break;
+        case boPow: op = opPow; opMayFail = true; break;
+        default: break;
+      }
+
+      mayFail = leftMayFail || rightMayFail || opMayFail;
+      return addInstruction( op, node, opMayFail, src );
+    }
+
+    case ntInOperator:
+    {
+      NodeInOperator* n = static_cast<NodeInOperator*>( node );
+      int instructionCount = mInstructions.count(), registerCount = mRegisters.count();
+
+      QVector<int> src;
+      src << compileNode( n->node(), mayFail );
+
+      // the list is evaluated only until the value is found
+      bool lazy = n->list()->count() == 0;
+      foreach ( Node* item, n->list()->list() )
+      {
+        bool itemMayFail;
+        src << compileNode( item, itemMayFail );
+        lazy = lazy || itemMayFail;
+      }
+
+      if ( !lazy )
+        return addInstruction( opIn, node, false, src );
+
+      rollback( instructionCount, registerCount );
+      break;
+    }
+
+    case ntFunction:
+    {
+      NodeFunction* n = static_cast<NodeFunction*>( node );
+      Function* fd = Functions()[n->fnIndex()];
+      bool coalesce = fd->name() == "coalesce";
+      int instructionCount = mInstructions.count(), registerCount = mRegisters.count();
+
+      // the arguments are evaluated only until a NULL one is found
+      QVector<int> src;
+      bool lazy = false;
+      if ( n->args() )
+      {
+        foreach ( Node* arg, n->args()->list() )
+        {
+          bool argMayFail;
+          src << compileNode( arg, argMayFail );
+          lazy = lazy || ( argMayFail && src.count() > 1 && !coalesce );
+        }
+      }
+
+      if ( !lazy )
+      {
+        mayFail = true;
+        int dst = addInstruction( opFunction, node, true, src, fd );
+        mInstructions.last().coalesce = coalesce;
+        return dst;
+      }
+
+      rollback( instructionCount, registerCount );
+      break;
+    }
+
+    default:
+      break;
+  }
+
+  mayFail = true;
+  return addInstruction( opNode, node, true );
+}
+
+int QgsExpression::Program::addConstant( const QVariant& value )
+{
+  mRegisters.append( Value() );
+  setValue( mRegisters.last(), value );
+  return mRegisters.count() - 1;
+}
+
+int QgsExpression::Program::addInstruction( OpCode op, Node* node, bool mayFail, const QVector<int>& src, Function* function )
+{
+  Instruction ins;
+  ins.op = op;
+  ins.node = node;
+  ins.mayFail = mayFail;
+  ins.dst = mRegisters.count();
+  ins.src = src;
+  ins.function = function;
+  ins.coalesce = false;
+  mInstructions.append( ins );
+
+  mRegisters.append( Value() );
+  return ins.dst;
+}
+
+void QgsExpression::Program::rollback( int instructionCount, int registerCount )
+{
+  mInstructions.resize( instructionCount );
+  mRegisters.resize( registerCount );
+}
+
+bool QgsExpression::Program::isConstant( Node* node )
+{
+  switch ( node->nodeType() )
+  {
+    case ntLiteral:
+      return true;
+
+    case ntUnaryOperator:
+      return isConstant( static_cast<NodeUnaryOperator*>( node )->operand() );
+
+    case ntBinaryOperator:
+    {
+      NodeBinaryOperator* n = static_cast<NodeBinaryOperator*>( node );
+      return isConstant( n->opLeft() ) && isConstant( n->opRight() );
+    }
+
+    case ntInOperator:
+    {
+      NodeInOperator* n = static_cast<NodeInOperator*>( node );
+      if ( !isConstant( n->node() ) )
+        return false;
+      foreach ( Node* item, n->list()->list() )
+      {
+        if ( !isConstant( item ) )
+          return false;
+      }
+      return true;
+    }
+
+    default:
+      // functions may depend on the feature or on the state of the expression
+      return false;
+  }
+}
+
+QVariant QgsExpression::Program::eval( const QgsFeature* f )
+{
+  Value* regs = mRegisters.data();
+  const Instruction* instructions = mInstructions.constData();
+
+  for ( int idx = 0; idx < mInstructions.count(); ++idx )
+  {
+    const Instruction& ins = instructions[idx];
+    Value& r = regs[ins.dst];
+
+    switch ( ins.op )
+    {
+      case opNode:
+        setValue( r, ins.node->eval( mParent, f ) );
+        break;
+
+      case opNot:
+      case opMinus:
+      {
+        const Value& a = regs[ins.src.at( 0 )];
+        TVL tvl;
+        if ( ins.op == opNot && getTVL( a, tvl ) )
+          setTVL( r, NOT[tvl] );
+        else if ( ins.op == opMinus && a.type == Value::Int )
+        {
+          r.type = Value::Int;
+          r.i = -a.i;
+        }
+        else if ( ins.op == opMinus && a.type == Value::Double )
+        {
+          r.type = Value::Double;
+          r.d = -a.d;
+        }
+        else
+          setValue( r, static_cast<NodeUnaryOperator*>( ins.node )->evalOperator( mParent, variant( a ) ) );
+        break;
+      }
+
+      case opArithmetic:
+      case opPow:
+      {
+        const Value& a = regs[ins.src.at( 0 )];
+        const Value& b = regs[ins.src.at( 1 )];
+        NodeBinaryOperator* n = static_cast<NodeBinaryOperator*>( ins.node );
+        if ( a.type == Value::Null || b.type == Value::Null )
+          setNull( r );
+        else if ( ins.op == opPow && isNumeric( a ) && isNumeric( b ) )
+        {
+          r.type = Value::Double;
+          r.d = pow( number( a ), number( b ) );
+        }
+        else if ( ins.op == opArithmetic && a.type == Value::Int && b.type == Value::Int )
+        {
+          if ( n->op() == boDiv && b.i == 0 )
+            setNull( r ); // silently handle division by zero and return NULL
+          else
+          {
+            r.type = Value::Int;
+            r.i = computeInt( n->op(), a.i, b.i );
+          }
+        }
+        else if ( ins.op == opArithmetic && isNumeric( a ) && isNumeric( b ) )
+        {
+          if ( n->op() == boDiv && number( b ) == 0 )
+            setNull( r );
+          else
+          {
+            r.type = Value::Double;
+            r.d = computeDouble( n->op(), number( a ), number( b ) );
+          }
+        }
+        else
+          setValue( r, n->evalOperator( mParent, variant( a ), variant( b ) ) );
+        break;
+      }
+
+      case opAnd:
+      case opOr:
+      {
+        const Value& a = regs[ins.src.at( 0 )];
+        const Value& b = regs[ins.src.at( 1 )];
+        TVL tvlL, tvlR;
+        if ( getTVL( a, tvlL ) && getTVL( b, tvlR ) )
+          setTVL( r, ins.op == opAnd ? AND[tvlL][tvlR] : OR[tvlL][tvlR] );
+        else
+          setValue( r, static_cast<NodeBinaryOperator*>( ins.node )->evalOperator( mParent, variant( a ), variant( b ) ) );
+        break;
+      }
+
+      case opCompare:
+      {
+        const Value& a = regs[ins.src.at( 0 )];
+        const Value& b = regs[ins.src.at( 1 )];
+        if ( a.type == Value::Null || b.type == Value::Null )
+        {
+          setNull( r );
+          break;
+        }
+
+        // numeric comparison if both can be converted to numbers, string comparison otherwise
+        double fL, fR, diff;
+        if ( doubleSafe( a, fL ) && doubleSafe( b, fR ) )
+          diff = fL - fR;
+        else
+          diff = QString::compare( string( a ), string( b ) );
+
+        setTVL( r, compare( static_cast<NodeBinaryOperator*>( ins.node )->op(), diff ) ? True : False );
+        break;
+      }
+
+      case opIs:
+      {
+        const Value& a = regs[ins.src.at( 0 )];
+        const Value& b = regs[ins.src.at( 1 )];
+        bool same;
+        if ( a.type == Value::Null || b.type == Value::Null )
+          same = a.type == b.type;
+        else
+          same = equal( a, b );
+
+        bool is = static_cast<NodeBinaryOperator*>( ins.node )->op() == boIs;
+        setTVL( r, same == is ? True : False );
+        break;
+      }
+
+      case opBinary:
+        setValue( r, static_cast<NodeBinaryOperator*>( ins.node )->evalOperator( mParent,
+                  variant( regs[ins.src.at( 0 )] ), variant( regs[ins.src.at( 1 )] ) ) );
+        break;
+
+      case opIn:
+      {
+        const Value& a = regs[ins.src.at( 0 )];
+        if ( a.type == Value::Null )
+        {
+          setNull( r );
+          break;
+        }
+
+        bool found = false, listHasNull = false;
+        for ( int i = 1; i < ins.src.count() && !found; ++i )
+        {
+          const Value& item = regs[ins.src.at( i )];
+          if ( item.type == Value::Null )
+            listHasNull = true;
+          else
+            found = equal( a, item );
+        }
+
+        bool notIn = static_cast<NodeInOperator*>( ins.node )->isNotIn();
+        if ( found )
+          setTVL( r, notIn ? False : True );
+        else if ( listHasNull )
+          setNull( r );
+        else
+          setTVL( r, notIn ? True : False );
+        break;
+      }
+
+      case opFunction:
+      {
+        QVariantList argValues;
+        bool nullArg = false;
+        for ( int i = 0; i < ins.src.count(); ++i )
+        {
+          const Value& arg = regs[ins.src.at( i )];
+          if ( arg.type == Value::Null && !ins.coalesce )
+          {
+            // all "normal" functions return NULL, when any parameter is NULL
+            nullArg = true;
+            break;
+          }
+          argValues.append( variant( arg ) );
+        }
+
+        if ( nullArg )
+          setNull( r );
+        else
+          setValue( r, ins.function->func( argValues, f, mParent ) );
+        break;
+      }
+    }
+
+    if ( ins.mayFail && mParent->hasEvalError() )
+      return QVariant();
+  }
+
+  return variant( regs[mResult] );
+}
+
+void QgsExpression::Program::setValue( Value& r, const QVariant& v )
+{
+  if ( v.isNull() )
+  {
+    r.type = Value::Null;
+    r.v = v;
+    return;
+  }
+
+  switch ( v.type() )
+  {
+    case QVariant::Int:
+      r.type = Value::Int;
+      r.i = v.toInt();
+      break;
+    case QVariant::Double:
+      r.type = Value::Double;
+      r.d = v.toDouble();
+      break;
+    case QVariant::String:
+      r.type = Value::String;
+      r.s = v.toString();
+      break;
+    default:
+      r.type = Value::Other;
+      r.v = v;
+      break;
+  }
+}
+
+void QgsExpression::Program::setTVL( Value& r, TVL tvl )
+{
+  if ( tvl == Unknown )
+  {
+    setNull( r );
+    return;
+  }
+
+  r.type = Value::Int;
+  r.i = tvl == True ? 1 : 0;
+}
+
+QVariant QgsExpression::Program::variant( const Value& r )
+{
+  switch ( r.type )
+  {
+    case Value::Int: return QVariant( r.i );
+    case Value::Double: return QVariant( r.d );
+    case Value::String: return QVariant( r.s );
+    default: return r.v;
+  }
+}
+
+bool QgsExpression::Program::doubleSafe( const Value& r, double& x )
+{
+  bool ok = true;
+  switch ( r.type )
+  {
+    case Value::Int: x = r.i; break;
+    case Value::Double: x = r.d; break;
+    case Value::String: x = r.s.toDouble( &ok ); break;
+    default:
+      ok = isDoubleSafe( r.v );
+      if ( ok )
+        x = r.v.toDouble();
+      break;
+  }
+  return ok;
+}
+
+QString QgsExpression::Program::string( const Value& r )
+{
+  switch ( r.type )
+  {
+    case Value::Int: return QString::number( r.i );
+    case Value::Double: return QVariant( r.d ).toString();
+    case Value::String: return r.s;
+    default: return r.v.toString();
+  }
+}
+
+bool QgsExpression::Program::getTVL( const Value& r, TVL& tvl )
+{
+  switch ( r.type )
+  {
+    case Value::Null: tvl = Unknown; return true;
+    case Value::Int: tvl = r.i != 0 ? True : False; return true;
+    case Value::Double: tvl = r.d != 0 ? True : False; return true;
+    default: return false; // conversion may fail, let getTVLValue() report it
+  }
+}
+
+bool QgsExpression::Program::equal( const Value& a, const Value& b )
+{
+  double fA, fB;
+  if ( doubleSafe( a, fA ) && doubleSafe( b, fB ) )
+    return fA == fB;
+  return QString::compare( string( a ), string( b ) ) == 0;
+}
+
+bool QgsExpression::Program::compare( BinaryOperator op, double diff )
+{
+  switch ( op )
+  {
+    case boEQ: return diff == 0;
+    case boNE: return diff != 0;
+    case boLT: return diff < 0;
+    case boGT: return diff > 0;
+    case boLE: return diff <= 0;
+    case boGE: return diff >= 0;
+    default: Q_ASSERT( false ); return false;
+  }
+}
+
+int QgsExpression::Program::computeInt( BinaryOperator op, int x, int y )
+{
+  switch ( op )
+  {
+    case boPlus: return x+y;
+    case boMinus: return x-y;
+    case boMul: return x*y;
+    case boDiv: return x/y;
+    case boMod: return x%y;
+    default: Q_ASSERT( false ); return 0;
+  }
+}
+
+double QgsExpression::Program::computeDouble( BinaryOperator op, double x, double y )
+{
+  switch ( op )
+  {
+    case boPlus: return x+y;
+    case boMinus: return x-y;
+    case boMul: return x*y;
+    case boDiv: return x/y;
+    case boMod: return fmod( x, y );
+    default: Q_ASSERT( false ); return 0;
+  }
+}
+
+bool QgsExpression::compile()
+{
+  delete mProgram;
+  mProgram = new Program( this );
+  if ( !mProgram->compile( mRootNode ) )
+  {
+    delete mProgram;
+    mProgram = 0;
+    return false;
+  }
+  return true;
+}
+
 QgsExpression::QgsExpression( const QString& expr )
     : mRowNumber( 0 )
     , mScale( 0 )
     , mExp( expr )
     , mCalc( 0 )
+    , mProgram( 0 )
+    , mCompilationEnabled( true )
 {
   mRootNode = ::parseExpression( expr, mParserErrorString );
 
@@ -1629,6 +2282,7 @@ QgsExpression::QgsExpression( const QString& expr )
 
 QgsExpression::~QgsExpression()
 {
+  delete mProgram;
   delete mCalc;
   delete mRootNode;
 }
@@ -1688,7 +2342,58 @@ bool QgsExpression::prepare( const QgsFields& fields )
     return false;
   }
 
-  return mRootNode->prepare( this, fields );
+  mPreparedRegExps.clear();
+  if ( !mRootNode->prepare( this, fields ) )
+    return false;
+
+  // the program refers to the nodes only, so it stays valid for other fields
+  if ( mCompilationEnabled && !mProgram )
+    compile();
+
+  return true;
+}
+
+// number of dynamic patterns kept compiled by one expression
+static const int RegExpCacheSize = 16;
+
+void QgsExpression::prepareRegExp( const QString& pattern, Qt::CaseSensitivity cs )
+{
+  RegExpKey key( pattern, cs );
+  if ( !mPreparedRegExps.contains( key ) )
+    mPreparedRegExps.insert( key, QRegExp( pattern, cs ) );
+}
+
+const QRegExp& QgsExpression::regExp( const QString& pattern, Qt::CaseSensitivity cs )
+{
+  RegExpKey key( pattern, cs );
+
+  QHash<RegExpKey, QRegExp>::iterator it = mPreparedRegExps.find( key );
+  if ( it != mPreparedRegExps.end() )
+    return *it;
+
+  it = mRegExpCache.find( key );
+  if ( it != mRegExpCache.end() )
+  {
+    // keep the most recently used pattern at the end
+    mRegExpCacheOrder.move( mRegExpCacheOrder.indexOf( key ), mRegExpCacheOrder.count() - 1 );
+    return *it;
+  }
+
+  if ( mRegExpCacheOrder.count() >= RegExpCacheSize )
+    mRegExpCache.remove( mRegExpCacheOrder.takeFirst() );
+
+  mRegExpCacheOrder.append( key );
+  return *mRegExpCache.insert( key, QRegExp( pattern, cs ) );
+}
+
+void QgsExpression::setCompilationEnabled( bool enabled )
+{
+  mCompilationEnabled = enabled;
+  if ( !enabled )
+  {
+    delete mProgram;
+    mProgram = 0;
+  }
 }
 
 QVariant QgsExpression::evaluate( const QgsFeature* f )
@@ -1700,6 +2405,9 @@ QVariant QgsExpression::evaluate( const QgsFeature* f )
     return QVariant();
   }
 
+  if ( mProgram )
+    return mProgram->eval( f );
+
   return mRootNode->eval( this, f );
 }
 
@@ -1749,10 +2457,13 @@ QString QgsExpression::replaceExpressionText( const QString &action, const QgsFe
     }
   }
 
+  // compiled once, the copy shares the compiled pattern but keeps its own match state
+  static const QRegExp sExpressionTextRx( "\\[%([^\\]]+)%\\]" );
+  QRegExp rx = sExpressionTextRx;
+
   int index = 0;
   while ( index < action.size() )
   {
-    QRegExp rx = QRegExp( "\\[%([^\\]]+)%\\]" );
 
     int pos = rx.indexIn( action, index );
     if ( pos < 0 )
@@ -1825,6 +2536,11 @@ QVariant QgsExpression::NodeUnaryOperator::eval( QgsExpression* parent, const Qg
   QVariant val = mOperand->eval( parent, f );
   ENSURE_NO_EVAL_ERROR;
 
+  return evalOperator( parent, val );
+}
+
+QVariant QgsExpression::NodeUnaryOperator::evalOperator( QgsExpression* parent, const QVariant& val )
+{
   switch ( mOp )
   {
     case uoNot:
@@ -1867,6 +2583,11 @@ QVariant QgsExpression::NodeBinaryOperator::eval( QgsExpression* parent, const Q
   QVariant vR = mOpRight->eval( parent, f );
   ENSURE_NO_EVAL_ERROR;
 
+  return evalOperator( parent, vL, vR );
+}
+
+QVariant QgsExpression::NodeBinaryOperator::evalOperator( QgsExpression* parent, const QVariant& vL, const QVariant& vR )
+{
   switch ( mOp )
   {
     case boPlus:
@@ -1993,19 +2714,14 @@ QVariant QgsExpression::NodeBinaryOperator::eval( QgsExpression* parent, const Q
       {
         QString str    = getStringValue( vL, parent ); ENSURE_NO_EVAL_ERROR;
         QString regexp = getStringValue( vR, parent ); ENSURE_NO_EVAL_ERROR;
-        // TODO: cache QRegExp in case that regexp is a literal string (i.e. it will stay constant)
         bool matches;
         if ( mOp == boLike || mOp == boILike || mOp == boNotLike || mOp == boNotILike ) // change from LIKE syntax to regexp
         {
-          QString esc_regexp = QRegExp::escape( regexp );
-          // XXX escape % and _  ???
-          esc_regexp.replace( "%", ".*" );
-          esc_regexp.replace( "_", "." );
-          matches = QRegExp( esc_regexp, mOp == boLike || mOp == boNotLike ? Qt::CaseSensitive : Qt::CaseInsensitive ).exactMatch( str );
+          matches = parent->regExp( likeToRegExp( regexp ), mOp == boLike || mOp == boNotLike ? Qt::CaseSensitive : Qt::CaseInsensitive ).exactMatch( str );
         }
         else
         {
-          matches = QRegExp( regexp ).indexIn( str ) != -1;
+          matches = parent->regExp( regexp ).indexIn( str ) != -1;
         }
 
         if ( mOp == boNotLike || mOp == boNotILike )
@@ -2087,6 +2803,19 @@ bool QgsExpression::NodeBinaryOperator::prepare( QgsExpression* parent, const Qg
 {
   bool resL = mOpLeft->prepare( parent, fields );
   bool resR = mOpRight->prepare( parent, fields );
+
+  // compile a literal pattern only once
+  if ( mOpRight->nodeType() == ntLiteral && !static_cast<NodeLiteral*>( mOpRight )->value().isNull() )
+  {
+    QString pattern = static_cast<NodeLiteral*>( mOpRight )->value().toString();
+    if ( mOp == boRegexp )
+      parent->prepareRegExp( pattern, Qt::CaseSensitive );
+    else if ( mOp == boLike || mOp == boNotLike )
+      parent->prepareRegExp( likeToRegExp( pattern ), Qt::CaseSensitive );
+    else if ( mOp == boILike || mOp == boNotILike )
+      parent->prepareRegExp( likeToRegExp( pattern ), Qt::CaseInsensitive );
+  }
+
   return resL && resR;
 }
 
@@ -2195,6 +2924,16 @@ bool QgsExpression::NodeFunction::prepare( QgsExpression* parent, const QgsField
     {
       res = res && n->prepare( parent, fields );
     }
+
+    // compile a literal pattern only once
+    QString name = Functions()[mFnIndex]->name();
+    if ( mArgs->count() > 1 && mArgs->list().at( 1 )->nodeType() == ntLiteral &&
+         ( name == "regexp_match" || name == "regexp_replace" || name == "regexp_substr" || name == "strpos" ) )
+    {
+      QVariant pattern = static_cast<NodeLiteral*>( mArgs->list().at( 1 ) )->value();
+      if ( !pattern.isNull() )
+        parent->prepareRegExp( pattern.toString(), Qt::CaseSensitive );
+    }
   }
   return res;
 }
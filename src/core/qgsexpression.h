@@ -20,6 +20,9 @@
 #include <QStringList>
 #include <QVariant>
 #include <QList>
+#include <QHash>
+#include <QPair>
+#include <QRegExp>
 #include <QDomDocument>
 
 #include "qgsfield.h"
@@ -71,6 +74,8 @@ There is no special (three-value) 'boolean' type: true/false is represented as
 
 For better performance with many evaluations you may first call prepare(fields) function
 to find out indices of columns and then repeatedly call evaluate(feature).
+prepare() also compiles the expression tree to a flat list of instructions working
+with unboxed numbers and strings, which is then used by evaluate().
 
 Type conversion: operators and functions that expect arguments to be of particular
 type automatically convert the arguments to that type, e.g. sin('2.1') will convert
@@ -103,8 +108,18 @@ class CORE_EXPORT QgsExpression
     const Node* rootNode() const { return mRootNode; }
 
     //! Get the expression ready for evaluation - find out column indexes.
+    //! Unless disabled with setCompilationEnabled(), the expression tree is also
+    //! compiled to a flat program that is used by subsequent evaluate() calls.
     bool prepare( const QgsFields& fields );
 
+    //! Enable or disable compilation of the expression in prepare() (enabled by default).
+    //! Disabling it discards the compiled program, evaluation then walks the expression tree.
+    //! @note added in 2.1
+    void setCompilationEnabled( bool enabled );
+    //! Returns true if the expression is compiled for evaluation
+    //! @note added in 2.1
+    bool isCompiled() const { return mProgram != 0; }
+
     //! Get list of columns referenced by the expression
     QStringList referencedColumns();
     //! Returns true if the expression uses feature geometry for some computation
@@ -135,6 +150,12 @@ class CORE_EXPORT QgsExpression
     //! Set evaluation error (used internally by evaluation functions)
     void setEvalErrorString( QString str ) { mEvalErrorString = str; }
 
+    //! Return compiled regular expression for the pattern (used internally by evaluation functions).
+    //! Literal patterns are compiled in prepare(), the recently used other ones are cached.
+    //! @note the reference is valid until the next call
+    //! @note added in 2.1
+    const QRegExp& regExp( const QString& pattern, Qt::CaseSensitivity cs = Qt::CaseSensitive );
+
     //! Set the number for $rownum special column
     void setCurrentRowNumber( int rowNumber ) { mRowNumber = rowNumber; }
     //! Return the number used for $rownum special column
@@ -411,6 +432,9 @@ class CORE_EXPORT QgsExpression
         virtual QVariant eval( QgsExpression* parent, const QgsFeature* f );
         virtual QString dump() const;
 
+        //! apply the operator to an already evaluated operand
+        QVariant evalOperator( QgsExpression* parent, const QVariant& val );
+
         virtual QStringList referencedColumns() const { return mOperand->referencedColumns(); }
         virtual bool needsGeometry() const { return mOperand->needsGeometry(); }
         virtual void accept( Visitor& v ) const { v.visit( *this ); }
@@ -435,6 +459,9 @@ class CORE_EXPORT QgsExpression
         virtual QVariant eval( QgsExpression* parent, const QgsFeature* f );
         virtual QString dump() const;
 
+        //! apply the operator to already evaluated operands
+        QVariant evalOperator( QgsExpression* parent, const QVariant& vL, const QVariant& vR );
+
         virtual QStringList referencedColumns() const { return mOpLeft->referencedColumns() + mOpRight->referencedColumns(); }
         virtual bool needsGeometry() const { return mOpLeft->needsGeometry() || mOpRight->needsGeometry(); }
         virtual void accept( Visitor& v ) const { v.visit( *this ); }
@@ -599,10 +626,16 @@ class CORE_EXPORT QgsExpression
 
   protected:
     // internally used to create an empty expression
-    QgsExpression() : mRootNode( 0 ), mRowNumber( 0 ), mCalc( 0 ) {}
+    QgsExpression() : mRootNode( 0 ), mRowNumber( 0 ), mCalc( 0 ), mProgram( 0 ), mCompilationEnabled( true ) {}
 
     void initGeomCalculator();
 
+    //! lower the prepared expression tree to mProgram
+    bool compile();
+
+    //! compile a regular expression with a pattern that does not change between evaluations
+    void prepareRegExp( const QString& pattern, Qt::CaseSensitivity cs );
+
     Node* mRootNode;
 
     QString mParserErrorString;
@@ -615,6 +648,17 @@ class CORE_EXPORT QgsExpression
     static QMap<QString, QVariant> gmSpecialColumns;
     QgsDistanceArea *mCalc;
 
+    //! flat form of the expression tree used by evaluate() (defined in qgsexpression.cpp)
+    class Program;
+    Program* mProgram;
+    bool mCompilationEnabled;
+
+    typedef QPair<QString, int> RegExpKey;
+    QHash<RegExpKey, QRegExp> mPreparedRegExps;
+    //! least recently used dynamic patterns
+    QHash<RegExpKey, QRegExp> mRegExpCache;
+    QList<RegExpKey> mRegExpCacheOrder;
+
     friend class QgsOgcUtils;
 
     static void initFunctionHelp();
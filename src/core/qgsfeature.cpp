@@ -71,6 +71,13 @@ QgsFeature & QgsFeature::operator=( QgsFeature const & rhs )
   mValid =  rhs.mValid;
   mFields = rhs.mFields;
 
+  // reuse our own geometry (features are often assigned in a loop)
+  if ( mGeometry && mOwnsGeometry && rhs.mGeometry )
+  {
+    *mGeometry = *rhs.mGeometry;
+    return *this;
+  }
+
   // make sure to delete the old geometry (if exists)
   if ( mGeometry && mOwnsGeometry )
     delete mGeometry;
@@ -154,6 +161,12 @@ void QgsFeature::setGeometry( QgsGeometry* geom )
 */
 void QgsFeature::setGeometryAndOwnership( unsigned char *geom, size_t length )
 {
+  if ( mOwnsGeometry && mGeometry )
+  {
+    mGeometry->fromWkb( geom, length );
+    return;
+  }
+
   QgsGeometry *g = new QgsGeometry();
   g->fromWkb( geom, length );
   setGeometry( g );
@@ -15,15 +15,19 @@
 #include "qgsfeatureiterator.h"
 #include "qgslogger.h"
 
+#include "qgsfeaturesorter.h"
 #include "qgsgeometrysimplifier.h"
 #include "qgssimplifymethod.h"
 
 QgsAbstractFeatureIterator::QgsAbstractFeatureIterator( const QgsFeatureRequest& request )
     : mRequest( request )
     , mClosed( false )
+    , mOrderByCompiled( false )
     , refs( 0 )
     , mGeometrySimplifier( NULL )
     , mLocalSimplification( false )
+    , mSorter( 0 )
+    , mFetchedCount( 0 )
 {
 }
 
@@ -31,9 +35,35 @@ QgsAbstractFeatureIterator::~QgsAbstractFeatureIterator()
 {
   delete mGeometrySimplifier;
   mGeometrySimplifier = NULL;
+
+  delete mSorter;
 }
 
 bool QgsAbstractFeatureIterator::nextFeature( QgsFeature& f )
+{
+  if ( mRequest.limit() >= 0 && mFetchedCount >= mRequest.limit() )
+  {
+    close();
+    f.setValid( false );
+    return false;
+  }
+
+  bool dataOk;
+  if ( mRequest.orderBy().isEmpty() || mOrderByCompiled )
+    dataOk = nextFilteredFeature( f );
+  else
+    dataOk = nextOrderedFeature( f );
+
+  if ( dataOk && ++mFetchedCount == mRequest.limit() )
+  {
+    // all the requested features have been returned
+    close();
+  }
+
+  return dataOk;
+}
+
+bool QgsAbstractFeatureIterator::nextFilteredFeature( QgsFeature& f )
 {
   bool dataOk = false;
 
@@ -61,6 +91,58 @@ bool QgsAbstractFeatureIterator::nextFeature( QgsFeature& f )
   return dataOk;
 }
 
+int QgsAbstractFeatureIterator::nextFeatures( QgsFeatureList& features, int maxFeatures )
+{
+  // keep the features for reuse
+  while ( features.count() < maxFeatures )
+    features.append( QgsFeature() );
+
+  int count = 0;
+  if ( mRequest.filterType() == QgsFeatureRequest::FilterExpression ||
+       mRequest.filterType() == QgsFeatureRequest::FilterFids ||
+       ( !mRequest.orderBy().isEmpty() && !mOrderByCompiled ) )
+  {
+    // features are filtered or sorted one by one
+    while ( count < maxFeatures && nextFeature( features[count] ) )
+      count++;
+  }
+  else
+  {
+    int n = maxFeatures;
+    if ( mRequest.limit() >= 0 && mRequest.limit() - mFetchedCount < n )
+      n = mRequest.limit() - mFetchedCount;
+
+    count = n > 0 ? fetchFeatures( features, n ) : 0;
+
+    // simplify the geometries using the simplifier configured
+    if ( mLocalSimplification )
+    {
+      for ( int i = 0; i < count; ++i )
+      {
+        if ( features[i].geometry() )
+          simplify( features[i] );
+      }
+    }
+
+    mFetchedCount += count;
+    if ( mRequest.limit() >= 0 && mFetchedCount >= mRequest.limit() )
+      close();
+  }
+
+  while ( features.count() > count )
+    features.removeLast();
+
+  return count;
+}
+
+int QgsAbstractFeatureIterator::fetchFeatures( QgsFeatureList& features, int n )
+{
+  int count = 0;
+  while ( count < n && fetchFeature( features[count] ) )
+    count++;
+  return count;
+}
+
 bool QgsAbstractFeatureIterator::nextFeatureFilterExpression( QgsFeature& f )
 {
   while ( fetchFeature( f ) )
@@ -81,6 +163,50 @@ bool QgsAbstractFeatureIterator::nextFeatureFilterFids( QgsFeature& f )
   return false;
 }
 
+bool QgsAbstractFeatureIterator::nextOrderedFeature( QgsFeature& f )
+{
+  if ( !mSorter )
+  {
+    // the first call: fetch all the features and sort them
+    mSorter = new QgsFeatureSorter( mRequest.orderBy(), mRequest.limit() >= 0 ? mRequest.limit() - mFetchedCount : -1 );
+
+    QgsFeature feature;
+    while ( nextFilteredFeature( feature ) )
+      mSorter->addFeature( feature );
+
+    mSorter->sort();
+  }
+
+  if ( mSorter->nextFeature( f ) )
+    return true;
+
+  f.setValid( false );
+  return false;
+}
+
+bool QgsAbstractFeatureIterator::orderedFeaturesLeft() const
+{
+  if ( !mSorter || mSorter->atEnd() )
+    return false;
+
+  return mRequest.limit() < 0 || mFetchedCount < mRequest.limit();
+}
+
+void QgsAbstractFeatureIterator::resetOrderByAndLimit()
+{
+  delete mSorter;
+  mSorter = 0;
+  mFetchedCount = 0;
+}
+
+long QgsAbstractFeatureIterator::providerLimit( bool localFiltering ) const
+{
+  if ( localFiltering || ( !mRequest.orderBy().isEmpty() && !mOrderByCompiled ) )
+    return -1;
+
+  return mRequest.limit();
+}
+
 void QgsAbstractFeatureIterator::ref()
 {
   // Prepare if required the simplification of geometries to fetch:
@@ -19,6 +19,7 @@
 #include "qgslogger.h"
 
 class QgsAbstractGeometrySimplifier;
+class QgsFeatureSorter;
 
 /** \ingroup core
  * Internal feature iterator to be implemented within data providers
@@ -35,6 +36,14 @@ class CORE_EXPORT QgsAbstractFeatureIterator
     //! fetch next feature, return true on success
     virtual bool nextFeature( QgsFeature& f );
 
+    /**
+     * Fetch up to maxFeatures next features into the list, reusing the features
+     * already in the list. After the call the list contains just the fetched features.
+     * @return number of fetched features - less than maxFeatures only at the end of iteration
+     * @note added in 2.1
+     */
+    virtual int nextFeatures( QgsFeatureList& features, int maxFeatures );
+
     //! reset the iterator to the starting position
     virtual bool rewind() = 0;
     //! end of iterating: free the resources / lock
@@ -50,6 +59,18 @@ class CORE_EXPORT QgsAbstractFeatureIterator
      */
     virtual bool fetchFeature( QgsFeature& f ) = 0;
 
+    /**
+     * Fetch a batch of features, without any filtering by expression or feature ids.
+     * The default implementation calls fetchFeature() for each of them - implement
+     * it if your provider can fill the features more efficiently at once.
+     *
+     * @param features The list to write to, it contains at least n features to be reused
+     * @param n Maximal number of features to fetch
+     * @return  number of features written to the beginning of the list (less than n only at the end)
+     * @note added in 2.1
+     */
+    virtual int fetchFeatures( QgsFeatureList& features, int n );
+
     /**
      * By default, the iterator will fetch all features and check if the feature
      * matches the expression.
@@ -81,6 +102,22 @@ class CORE_EXPORT QgsAbstractFeatureIterator
     /** Set to true, as soon as the iterator is closed. */
     bool mClosed;
 
+    /**
+     * Set to true by iterators which return the features in the order of the request
+     * (e.g. with ORDER BY in their SQL), otherwise the features are sorted locally.
+     * @note added in 2.1
+     */
+    bool mOrderByCompiled;
+
+    /**
+     * Returns the limit of the request if the provider may apply it (e.g. with LIMIT in its SQL)
+     * or -1 if it must not. It must not if the features are sorted locally or if the provider
+     * still filters some of its features out.
+     * @param localFiltering true if fetched features are still filtered by the iterator
+     * @note added in 2.1
+     */
+    long providerLimit( bool localFiltering ) const;
+
     //! reference counting (to allow seamless copying of QgsFeatureIterator instances)
     int refs;
     void ref(); //!< add reference
@@ -101,6 +138,20 @@ class CORE_EXPORT QgsAbstractFeatureIterator
 
     //! simplify the specified geometry if it was configured
     virtual bool simplify( QgsFeature& feature );
+
+    //! next feature accepted by the filter of the request
+    bool nextFilteredFeature( QgsFeature& f );
+    //! next feature from the locally sorted features
+    bool nextOrderedFeature( QgsFeature& f );
+    //! whether locally sorted features are still to be returned
+    bool orderedFeaturesLeft() const;
+    //! forget the locally sorted features and the number of returned features
+    void resetOrderByAndLimit();
+
+    //! features sorted locally if the provider can't sort them
+    QgsFeatureSorter* mSorter;
+    //! number of features returned so far (to apply the limit)
+    long mFetchedCount;
 };
 
 
@@ -123,6 +174,9 @@ class CORE_EXPORT QgsFeatureIterator
     QgsFeatureIterator& operator=( const QgsFeatureIterator& other );
 
     bool nextFeature( QgsFeature& f );
+    //! fetch up to maxFeatures features into the list (see QgsAbstractFeatureIterator::nextFeatures())
+    //! @note added in 2.1
+    int nextFeatures( QgsFeatureList& features, int maxFeatures = 256 );
     bool rewind();
     bool close();
 
@@ -168,9 +222,22 @@ inline bool QgsFeatureIterator::nextFeature( QgsFeature& f )
   return mIter ? mIter->nextFeature( f ) : false;
 }
 
+inline int QgsFeatureIterator::nextFeatures( QgsFeatureList& features, int maxFeatures )
+{
+  if ( mIter )
+    return mIter->nextFeatures( features, maxFeatures );
+
+  features.clear();
+  return 0;
+}
+
 inline bool QgsFeatureIterator::rewind()
 {
-  return mIter ? mIter->rewind() : false;
+  if ( !mIter )
+    return false;
+
+  mIter->resetOrderByAndLimit();
+  return mIter->rewind();
 }
 
 inline bool QgsFeatureIterator::close()
@@ -180,7 +247,7 @@ inline bool QgsFeatureIterator::close()
 
 inline bool QgsFeatureIterator::isClosed() const
 {
-  return mIter ? mIter->mClosed : true;
+  return mIter ? mIter->mClosed && !mIter->orderedFeaturesLeft() : true;
 }
 
 inline bool operator== ( const QgsFeatureIterator &fi1, const QgsFeatureIterator &fi2 )
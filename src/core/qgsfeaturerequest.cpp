@@ -23,6 +23,7 @@ QgsFeatureRequest::QgsFeatureRequest()
     : mFilter( FilterNone )
     , mFilterExpression( 0 )
     , mFlags( 0 )
+    , mLimit( -1 )
 {
 }
 
@@ -31,6 +32,7 @@ QgsFeatureRequest::QgsFeatureRequest( QgsFeatureId fid )
     , mFilterFid( fid )
     , mFilterExpression( 0 )
     , mFlags( 0 )
+    , mLimit( -1 )
 {
 }
 
@@ -39,6 +41,7 @@ QgsFeatureRequest::QgsFeatureRequest( const QgsRectangle& rect )
     , mFilterRect( rect )
     , mFilterExpression( 0 )
     , mFlags( 0 )
+    , mLimit( -1 )
 {
 }
 
@@ -46,6 +49,7 @@ QgsFeatureRequest::QgsFeatureRequest( const QgsExpression& expr )
     : mFilter( FilterExpression )
     , mFilterExpression( new QgsExpression( expr.expression() ) )
     , mFlags( 0 )
+    , mLimit( -1 )
 {
 }
 
@@ -71,6 +75,9 @@ QgsFeatureRequest& QgsFeatureRequest::operator=( const QgsFeatureRequest & rh )
   }
   mAttrs = rh.mAttrs;
   mSimplifyMethod = rh.mSimplifyMethod;
+  mOrderBy = rh.mOrderBy;
+  mLimit = rh.mLimit;
+  mFilterNativeExpression = rh.mFilterNativeExpression;
   return *this;
 }
 
@@ -141,6 +148,36 @@ QgsFeatureRequest& QgsFeatureRequest::setSimplifyMethod( const QgsSimplifyMethod
   return *this;
 }
 
+QgsFeatureRequest& QgsFeatureRequest::setOrderBy( const QgsFeatureRequest::OrderBy& orderBy )
+{
+  mOrderBy = orderBy;
+  return *this;
+}
+
+QgsFeatureRequest& QgsFeatureRequest::addOrderBy( const QString& expression, bool ascending )
+{
+  mOrderBy.append( OrderByClause( expression, ascending ) );
+  return *this;
+}
+
+QgsFeatureRequest& QgsFeatureRequest::addOrderBy( const QString& expression, bool ascending, bool nullsFirst )
+{
+  mOrderBy.append( OrderByClause( expression, ascending, nullsFirst ) );
+  return *this;
+}
+
+QgsFeatureRequest& QgsFeatureRequest::setLimit( long limit )
+{
+  mLimit = limit;
+  return *this;
+}
+
+QgsFeatureRequest& QgsFeatureRequest::setFilterNativeExpression( const QString& expression )
+{
+  mFilterNativeExpression = expression;
+  return *this;
+}
+
 bool QgsFeatureRequest::acceptFeature( const QgsFeature& feature )
 {
   switch ( mFilter )
@@ -180,3 +217,19 @@ bool QgsFeatureRequest::acceptFeature( const QgsFeature& feature )
 
   return true;
 }
+
+///////
+
+QgsFeatureRequest::OrderByClause::OrderByClause( const QString& expression, bool ascending )
+    : mExpression( expression )
+    , mAscending( ascending )
+    , mNullsFirst( !ascending )
+{
+}
+
+QgsFeatureRequest::OrderByClause::OrderByClause( const QString& expression, bool ascending, bool nullsFirst )
+    : mExpression( expression )
+    , mAscending( ascending )
+    , mNullsFirst( nullsFirst )
+{
+}
@@ -53,6 +53,11 @@ typedef QList<int> QgsAttributeList;
  *     QgsFeatureRequest().setFilterRect(QgsRectangle(0,0,1,1))
  * - fetch only one feature
  *     QgsFeatureRequest().setFilterFid(45)
+ * - fetch the ten features with the largest population
+ *     QgsFeatureRequest().addOrderBy("population", false).setLimit(10)
+ *
+ * Ordering and limit are translated to SQL by the database providers when possible,
+ * otherwise the features are sorted by the feature iterator.
  *
  */
 class CORE_EXPORT QgsFeatureRequest
@@ -76,6 +81,29 @@ class CORE_EXPORT QgsFeatureRequest
       FilterFids        //!< Filter using feature ID's
     };
 
+    /**
+     * One expression of the order of the requested features
+     * @note added in 2.1
+     */
+    class CORE_EXPORT OrderByClause
+    {
+      public:
+        //! NULL values are sorted as if they were larger than any other value (like in PostgreSQL)
+        OrderByClause( const QString& expression, bool ascending = true );
+        OrderByClause( const QString& expression, bool ascending, bool nullsFirst );
+
+        QString expression() const { return mExpression; }
+        bool ascending() const { return mAscending; }
+        bool nullsFirst() const { return mNullsFirst; }
+
+      private:
+        QString mExpression;
+        bool mAscending;
+        bool mNullsFirst;
+    };
+
+    typedef QList<OrderByClause> OrderBy;
+
     //! construct a default request: for all features get attributes and geometries
     QgsFeatureRequest();
     //! construct a request with feature ID filter
@@ -126,6 +154,26 @@ class CORE_EXPORT QgsFeatureRequest
     QgsFeatureRequest& setSimplifyMethod( const QgsSimplifyMethod& simplifyMethod );
     const QgsSimplifyMethod& simplifyMethod() const { return mSimplifyMethod; }
 
+    /**
+     * Set the order of the features. The attributes used by the expressions
+     * need to be fetched (a vector layer adds them to the subset of attributes).
+     * An empty list returns the features in the order of the provider.
+     * @note added in 2.1
+     */
+    QgsFeatureRequest& setOrderBy( const OrderBy& orderBy );
+    const OrderBy& orderBy() const { return mOrderBy; }
+
+    //! Append an expression to the order of the features (see setOrderBy())
+    //! @note added in 2.1
+    QgsFeatureRequest& addOrderBy( const QString& expression, bool ascending = true );
+    //! @note added in 2.1
+    QgsFeatureRequest& addOrderBy( const QString& expression, bool ascending, bool nullsFirst );
+
+    //! Set the maximal number of features to return, -1 for no limit
+    //! @note added in 2.1
+    QgsFeatureRequest& setLimit( long limit );
+    long limit() const { return mLimit; }
+
     /**
      * Check if a feature is accepted by this requests filter
      *
@@ -137,9 +185,17 @@ class CORE_EXPORT QgsFeatureRequest
      */
     bool acceptFeature( const QgsFeature& feature );
 
-    // TODO: in future
-    // void setFilterNativeExpression(con QString& expr);   // using provider's SQL (if supported)
-    // void setLimit(int limit);
+    /**
+     * Set an additional filter in the SQL dialect of the provider (the syntax of its
+     * subset string). It is combined with AND with the other filter and the subset
+     * string, and only applies to providers which support subset strings.
+     * An empty string removes the filter.
+     * @note features added to the edit buffer of a layer are not filtered
+     * @note added in 2.2
+     */
+    QgsFeatureRequest& setFilterNativeExpression( const QString& expression );
+    //! @note added in 2.2
+    const QString& filterNativeExpression() const { return mFilterNativeExpression; }
 
   protected:
     FilterType mFilter;
@@ -150,6 +206,9 @@ class CORE_EXPORT QgsFeatureRequest
     Flags mFlags;
     QgsAttributeList mAttrs;
     QgsSimplifyMethod mSimplifyMethod;
+    OrderBy mOrderBy;
+    long mLimit;
+    QString mFilterNativeExpression;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS( QgsFeatureRequest::Flags )
@@ -0,0 +1,408 @@
+/***************************************************************************
+    qgsfeaturesorter.cpp
+    ---------------------
+    begin                : January 2014
+    copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include "qgsfeaturesorter.h"
+
+#include "qgsexpression.h"
+#include "qgsgeometry.h"
+#include "qgslogger.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QTemporaryFile>
+
+#include <algorithm>
+
+static bool isNumeric( QVariant::Type type )
+{
+  return type == QVariant::Int || type == QVariant::UInt ||
+         type == QVariant::LongLong || type == QVariant::ULongLong ||
+         type == QVariant::Double;
+}
+
+template<class T> static int compareOrdered( const T& a, const T& b )
+{
+  return a < b ? -1 : ( b < a ? 1 : 0 );
+}
+
+QgsFeatureSorter::QgsFeatureSorter( const QgsFeatureRequest::OrderBy& orderBy, long limit, int runSize, int maxOpenRuns )
+    : mOrderBy( orderBy )
+    , mPrepared( false )
+    , mFields( 0 )
+    , mLimit( limit )
+    , mRunSize( qMax( runSize, 1 ) )
+    , mMaxOpenRuns( qMax( maxOpenRuns, 2 ) )
+    , mSeq( 0 )
+    , mNextEntry( 0 )
+{
+  foreach ( const QgsFeatureRequest::OrderByClause& clause, mOrderBy )
+  {
+    mExpressions << new QgsExpression( clause.expression() );
+  }
+}
+
+QgsFeatureSorter::~QgsFeatureSorter()
+{
+  qDeleteAll( mExpressions );
+  qDeleteAll( mEntries );
+
+  for ( int i = 0; i < mRuns.count(); ++i )
+  {
+    deleteRun( mRuns[i] );
+  }
+}
+
+void QgsFeatureSorter::addFeature( const QgsFeature& feature )
+{
+  if ( !mPrepared )
+  {
+    mFields = feature.fields();
+    if ( mFields )
+    {
+      foreach ( QgsExpression* exp, mExpressions )
+        exp->prepare( *mFields );
+    }
+    mPrepared = true;
+  }
+
+  if ( mLimit == 0 )
+    return;
+
+  Entry* entry = new Entry;
+  entry->seq = mSeq++;
+  foreach ( QgsExpression* exp, mExpressions )
+  {
+    QVariant value = exp->evaluate( &feature );
+    entry->keys << ( exp->hasEvalError() ? QVariant() : value );
+  }
+
+  if ( mLimit > 0 )
+  {
+    // keep the first features in a heap with the last of them on top
+    if ( mEntries.count() == mLimit && compare( *entry, *mEntries.first() ) >= 0 )
+    {
+      delete entry;
+      return;
+    }
+
+    entry->feature = feature;
+    mEntries.append( entry );
+    std::push_heap( mEntries.begin(), mEntries.end(), LessThan( this ) );
+
+    if ( mEntries.count() > mLimit )
+    {
+      std::pop_heap( mEntries.begin(), mEntries.end(), LessThan( this ) );
+      delete mEntries.last();
+      mEntries.resize( mEntries.count() - 1 );
+    }
+    return;
+  }
+
+  entry->feature = feature;
+  mEntries.append( entry );
+
+  if ( mEntries.count() >= mRunSize )
+    writeRun();
+}
+
+void QgsFeatureSorter::sort()
+{
+  if ( !mRuns.isEmpty() && !mEntries.isEmpty() )
+    writeRun();
+
+  if ( mRuns.isEmpty() )
+  {
+    std::sort( mEntries.begin(), mEntries.end(), LessThan( this ) );
+    mNextEntry = 0;
+    return;
+  }
+
+  // merge groups of runs until the remaining ones can be open at the same time
+  while ( mRuns.count() > mMaxOpenRuns )
+  {
+    QList<Run> merged;
+    for ( int i = 0; i < mRuns.count(); i += mMaxOpenRuns )
+    {
+      QList<Run> group = mRuns.mid( i, mMaxOpenRuns );
+      Run run;
+      if ( group.count() > 1 && mergeRuns( group, run ) )
+        merged << run;
+      else
+        merged << group;
+    }
+
+    if ( merged.count() == mRuns.count() )
+    {
+      // no temporary file could be written - merge all the runs at once
+      QgsDebugMsg( "could not merge sorted runs" );
+      break;
+    }
+
+    mRuns = merged;
+    QgsDebugMsgLevel( QString( "merged into %1 sorted runs" ).arg( mRuns.count() ), 3 );
+  }
+
+  startMerge( mRuns, mHeap );
+}
+
+bool QgsFeatureSorter::nextFeature( QgsFeature& feature )
+{
+  if ( mRuns.isEmpty() )
+  {
+    if ( mNextEntry >= mEntries.count() )
+      return false;
+
+    // release the features which have been read
+    Entry* entry = mEntries[mNextEntry];
+    mEntries[mNextEntry++] = 0;
+    feature = entry->feature;
+    delete entry;
+    return true;
+  }
+
+  Entry entry;
+  if ( !nextMerged( mRuns, mHeap, entry ) )
+    return false;
+
+  feature = entry.feature;
+  return true;
+}
+
+bool QgsFeatureSorter::atEnd() const
+{
+  if ( mRuns.isEmpty() )
+    return mNextEntry >= mEntries.count();
+
+  return mHeap.isEmpty();
+}
+
+int QgsFeatureSorter::compareValues( const QVariant& a, const QVariant& b )
+{
+  if ( isNumeric( a.type() ) && isNumeric( b.type() ) )
+  {
+    if ( a.type() == QVariant::Double || b.type() == QVariant::Double )
+      return compareOrdered( a.toDouble(), b.toDouble() );
+
+    return compareOrdered( a.toLongLong(), b.toLongLong() );
+  }
+
+  if ( a.type() == b.type() )
+  {
+    switch ( a.type() )
+    {
+      case QVariant::Bool:
+        return compareOrdered( a.toBool(), b.toBool() );
+      case QVariant::Date:
+        return compareOrdered( a.toDate(), b.toDate() );
+      case QVariant::Time:
+        return compareOrdered( a.toTime(), b.toTime() );
+      case QVariant::DateTime:
+        return compareOrdered( a.toDateTime(), b.toDateTime() );
+      default:
+        break;
+    }
+  }
+
+  return QString::localeAwareCompare( a.toString(), b.toString() );
+}
+
+int QgsFeatureSorter::compare( const Entry& a, const Entry& b ) const
+{
+  for ( int i = 0; i < mOrderBy.count(); ++i )
+  {
+    const QVariant& va = a.keys[i];
+    const QVariant& vb = b.keys[i];
+
+    int res;
+    if ( va.isNull() || vb.isNull() )
+    {
+      if ( va.isNull() && vb.isNull() )
+        res = 0;
+      else
+        res = va.isNull() == mOrderBy[i].nullsFirst() ? -1 : 1;
+    }
+    else
+    {
+      res = compareValues( va, vb );
+      if ( !mOrderBy[i].ascending() )
+        res = -res;
+    }
+
+    if ( res != 0 )
+      return res;
+  }
+
+  // keep the original order of equal features
+  return compareOrdered( a.seq, b.seq );
+}
+
+void QgsFeatureSorter::writeRun()
+{
+  Run run;
+  run.file = new QTemporaryFile();
+  if ( !run.file->open() )
+  {
+    // keep the features in memory
+    QgsDebugMsg( "could not create a temporary file for sorting features" );
+    delete run.file;
+    mRunSize *= 2;
+    return;
+  }
+
+  std::sort( mEntries.begin(), mEntries.end(), LessThan( this ) );
+
+  QDataStream stream( run.file );
+  foreach ( Entry* entry, mEntries )
+  {
+    writeEntry( stream, *entry );
+    delete entry;
+  }
+  mEntries.clear();
+
+  // the file is opened again for merging
+  run.file->close();
+  run.stream = 0;
+  run.hasHead = false;
+  mRuns << run;
+
+  QgsDebugMsgLevel( QString( "sorted run %1 written to %2" ).arg( mRuns.count() ).arg( run.file->fileName() ), 3 );
+}
+
+bool QgsFeatureSorter::openRun( Run& run )
+{
+  if ( !run.file->open() )
+  {
+    QgsDebugMsg( "could not open the temporary file of a sorted run " + run.file->fileName() );
+    run.hasHead = false;
+    return false;
+  }
+  run.file->seek( 0 );
+  run.stream = new QDataStream( run.file );
+  return readEntry( run );
+}
+
+void QgsFeatureSorter::deleteRun( Run& run )
+{
+  delete run.stream;
+  run.stream = 0;
+  delete run.file;
+  run.file = 0;
+  run.hasHead = false;
+}
+
+bool QgsFeatureSorter::startMerge( QList<Run>& runs, QVector<int>& heap )
+{
+  heap.clear();
+  for ( int i = 0; i < runs.count(); ++i )
+  {
+    if ( openRun( runs[i] ) )
+      heap << i;
+  }
+  std::make_heap( heap.begin(), heap.end(), RunGreaterThan( this, runs ) );
+  return !heap.isEmpty();
+}
+
+bool QgsFeatureSorter::nextMerged( QList<Run>& runs, QVector<int>& heap, Entry& entry )
+{
+  if ( heap.isEmpty() )
+    return false;
+
+  std::pop_heap( heap.begin(), heap.end(), RunGreaterThan( this, runs ) );
+  Run& run = runs[heap.last()];
+  entry = run.head;
+
+  if ( readEntry( run ) )
+  {
+    std::push_heap( heap.begin(), heap.end(), RunGreaterThan( this, runs ) );
+  }
+  else
+  {
+    // the run is exhausted, release its file descriptor
+    delete run.stream;
+    run.stream = 0;
+    run.file->close();
+    heap.resize( heap.count() - 1 );
+  }
+  return true;
+}
+
+bool QgsFeatureSorter::mergeRuns( QList<Run>& runs, Run& merged )
+{
+  merged.file = new QTemporaryFile();
+  merged.stream = 0;
+  merged.hasHead = false;
+  if ( !merged.file->open() )
+  {
+    delete merged.file;
+    merged.file = 0;
+    return false;
+  }
+
+  QDataStream stream( merged.file );
+  QVector<int> heap;
+  startMerge( runs, heap );
+  Entry entry;
+  while ( nextMerged( runs, heap, entry ) )
+  {
+    writeEntry( stream, entry );
+  }
+  merged.file->close();
+
+  for ( int i = 0; i < runs.count(); ++i )
+  {
+    deleteRun( runs[i] );
+  }
+  return true;
+}
+
+void QgsFeatureSorter::writeEntry( QDataStream& stream, const Entry& entry )
+{
+  const QgsFeature& f = entry.feature;
+  QgsGeometry* geom = f.geometry();
+
+  stream << entry.keys << entry.seq << f.id() << f.isValid() << f.attributes();
+  stream << ( geom ? QByteArray(( const char* ) geom->asWkb(), geom->wkbSize() ) : QByteArray() );
+}
+
+bool QgsFeatureSorter::readEntry( Run& run )
+{
+  run.hasHead = !run.stream->atEnd();
+  if ( !run.hasHead )
+    return false;
+
+  QgsFeatureId fid;
+  bool valid;
+  QgsAttributes attributes;
+  QByteArray wkb;
+
+  *run.stream >> run.head.keys >> run.head.seq >> fid >> valid >> attributes >> wkb;
+
+  QgsFeature& f = run.head.feature;
+  f.setFeatureId( fid );
+  f.setValid( valid );
+  f.setAttributes( attributes );
+  f.setFields( mFields );
+
+  if ( wkb.isEmpty() )
+  {
+    f.setGeometry( 0 );
+  }
+  else
+  {
+    unsigned char* geom = new unsigned char[wkb.size()];
+    memcpy( geom, wkb.constData(), wkb.size() );
+    f.setGeometryAndOwnership( geom, wkb.size() );
+  }
+
+  return true;
+}
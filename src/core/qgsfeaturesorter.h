@@ -0,0 +1,142 @@
+/***************************************************************************
+    qgsfeaturesorter.h
+    ---------------------
+    begin                : January 2014
+    copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#ifndef QGSFEATURESORTER_H
+#define QGSFEATURESORTER_H
+
+#include "qgsfeature.h"
+#include "qgsfeaturerequest.h"
+
+#include <QVector>
+
+class QDataStream;
+class QTemporaryFile;
+
+/** \ingroup core
+ * Sorts features by the order of a feature request, for iterators which cannot
+ * fetch the features in the requested order.
+ *
+ * Features are collected with addFeature(), sorted with sort() and read back
+ * with nextFeature(). If the number of features is larger than the size of
+ * a run, the sorted runs are written to temporary files and merged while reading.
+ * At most maxOpenRuns files are open at once: with more runs, sort() merges groups
+ * of them into larger runs first.
+ * With a limit, only the first features are kept in memory and no files are used.
+ *
+ * NULL values sort according to the nulls first/last setting of each clause,
+ * features with equal keys keep the order in which they were added.
+ *
+ * @note added in 2.1
+ */
+class CORE_EXPORT QgsFeatureSorter
+{
+  public:
+    //! @param orderBy order of the features
+    //! @param limit number of features to keep (-1 to keep all of them)
+    //! @param runSize maximal number of features kept in memory without a limit
+    //! @param maxOpenRuns maximal number of runs merged (and temporary files open) at once
+    QgsFeatureSorter( const QgsFeatureRequest::OrderBy& orderBy, long limit = -1, int runSize = 50000, int maxOpenRuns = 16 );
+    ~QgsFeatureSorter();
+
+    //! add a feature to sort
+    void addFeature( const QgsFeature& feature );
+
+    //! sort the added features - call once before reading them with nextFeature()
+    void sort();
+
+    //! fetch the next feature in the requested order, return false at the end
+    bool nextFeature( QgsFeature& feature );
+
+    //! whether all the sorted features have been read
+    bool atEnd() const;
+
+    //! number of sorted runs in temporary files (after sort(): the runs of the final merge)
+    int runCount() const { return mRuns.count(); }
+
+    //! compare two non-NULL values: numbers numerically, dates and times chronologically, strings locale aware
+    static int compareValues( const QVariant& a, const QVariant& b );
+
+  private:
+    struct Entry
+    {
+      QList<QVariant> keys;
+      qint64 seq;
+      QgsFeature feature;
+    };
+
+    //! a sorted run in a temporary file, the file is only open while the run is merged
+    struct Run
+    {
+      QTemporaryFile* file;
+      QDataStream* stream;
+      Entry head;
+      bool hasHead;
+    };
+
+    //! functor for the heap of runs: true if the head of run a goes after the head of run b
+    class RunGreaterThan
+    {
+      public:
+        RunGreaterThan( const QgsFeatureSorter* sorter, const QList<Run>& runs ) : mSorter( sorter ), mRuns( runs ) {}
+        bool operator()( int a, int b ) const { return mSorter->compare( mRuns[a].head, mRuns[b].head ) > 0; }
+      private:
+        const QgsFeatureSorter* mSorter;
+        const QList<Run>& mRuns;
+    };
+
+    //! functor for the standard algorithms: true if a goes before b
+    class LessThan
+    {
+      public:
+        LessThan( const QgsFeatureSorter* sorter ) : mSorter( sorter ) {}
+        bool operator()( const Entry* a, const Entry* b ) const { return mSorter->compare( *a, *b ) < 0; }
+      private:
+        const QgsFeatureSorter* mSorter;
+    };
+
+    int compare( const Entry& a, const Entry& b ) const;
+    void writeRun();
+    void writeEntry( QDataStream& stream, const Entry& entry );
+    bool readEntry( Run& run );
+
+    //! open the file of the run and read its first feature
+    bool openRun( Run& run );
+    //! close and remove the file of the run
+    void deleteRun( Run& run );
+    //! open the runs and build the heap of their heads
+    bool startMerge( QList<Run>& runs, QVector<int>& heap );
+    //! take the next feature of the merge, false at the end
+    bool nextMerged( QList<Run>& runs, QVector<int>& heap, Entry& entry );
+    //! merge the runs into a new run, false if no temporary file could be written
+    bool mergeRuns( QList<Run>& runs, Run& merged );
+
+    QgsFeatureRequest::OrderBy mOrderBy;
+    QList<QgsExpression*> mExpressions;
+    bool mPrepared;
+    const QgsFields* mFields;
+
+    long mLimit;
+    int mRunSize;
+    int mMaxOpenRuns;
+    qint64 mSeq;
+
+    QVector<Entry*> mEntries;
+    int mNextEntry;
+    QList<Run> mRuns;
+    //! indices of mRuns with a head, the next feature on top
+    QVector<int> mHeap;
+
+    Q_DISABLE_COPY( QgsFeatureSorter )
+};
+
+#endif // QGSFEATURESORTER_H
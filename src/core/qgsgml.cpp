@@ -41,6 +41,7 @@ QgsGml::QgsGml(
     , mTypeName( typeName )
     , mGeometryAttribute( geometryAttribute )
     , mFinished( false )
+    , mStreaming( false )
     , mCurrentFeature( 0 )
     , mFeatureCount( 0 )
     , mCurrentWKBSize( 0 )
@@ -349,10 +350,17 @@ void QgsGml::endElement( const XML_Char* el )
     }
     mCurrentFeature->setValid( true );
 
-    mFeatures.insert( mCurrentFeature->id(), mCurrentFeature );
-    if ( !mCurrentFeatureId.isEmpty() )
+    if ( mStreaming )
     {
-      mIdMap.insert( mCurrentFeature->id(), mCurrentFeatureId );
+      emit featureParsed( mCurrentFeature, mCurrentFeatureId );
+    }
+    else
+    {
+      mFeatures.insert( mCurrentFeature->id(), mCurrentFeature );
+      if ( !mCurrentFeatureId.isEmpty() )
+      {
+        mIdMap.insert( mCurrentFeature->id(), mCurrentFeatureId );
+      }
     }
     mCurrentFeature = 0;
     ++mFeatureCount;
@@ -66,6 +66,14 @@ class CORE_EXPORT QgsGml : public QObject
     /** Get parsed features for given type name */
     QMap<QgsFeatureId, QgsFeature* > featuresMap() const { return mFeatures; }
 
+    /** In streaming mode the features are not collected in featuresMap(), each feature
+     *  is emitted with featureParsed() as soon as it is read, while the download is
+     *  still running. The extent is then not calculated from the features.
+     *  @note added in 2.1
+     */
+    void setStreaming( bool streaming ) { mStreaming = streaming; }
+    bool isStreaming() const { return mStreaming; }
+
     /** Get feature ids map */
     QMap<QgsFeatureId, QString > idsMap() const { return mIdMap; }
 
@@ -82,6 +90,12 @@ class CORE_EXPORT QgsGml : public QObject
     //also emit signal with progress and totalSteps together (this is better for the status message)
     void dataProgressAndSteps( int progress, int totalSteps );
 
+    /** Emitted in streaming mode for each parsed feature, the receiver takes ownership
+     *  of the feature. The feature id is the WFS server id (empty if there is none).
+     *  @note added in 2.1
+     */
+    void featureParsed( QgsFeature* feature, const QString& featureId );
+
   private:
 
     enum ParseMode
@@ -189,6 +203,8 @@ class CORE_EXPORT QgsGml : public QObject
     QGis::WkbType* mWkbType;
     /**True if the request is finished*/
     bool mFinished;
+    /**True if the features are emitted instead of collected*/
+    bool mStreaming;
     /**Keep track about the most important nested elements*/
     QStack<ParseMode> mParseModeStack;
     /**This contains the character data if an important element has been encountered*/
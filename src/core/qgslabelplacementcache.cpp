@@ -0,0 +1,63 @@
+/***************************************************************************
+    qgslabelplacementcache.cpp  -  Labels of the last render for reuse
+                             -------------------
+    begin                : January 2014
+    copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgslabelplacementcache.h"
+#include "qgsvectorlayer.h"
+
+QgsLabelPlacementCache::QgsLabelPlacementCache( QObject* parent ): QObject( parent )
+{
+}
+
+QgsLabelPlacementCache::~QgsLabelPlacementCache()
+{
+}
+
+void QgsLabelPlacementCache::setImage( const QString& key, const QImage& image )
+{
+  if ( key.isEmpty() )
+  {
+    clear();
+    return;
+  }
+  mKey = key;
+  mImage = image;
+}
+
+void QgsLabelPlacementCache::watchLayer( QgsVectorLayer* layer )
+{
+  if ( !layer )
+  {
+    return;
+  }
+
+  //features, symbology or anything else the layer wants to be redrawn for
+  connect( layer, SIGNAL( repaintRequested() ), this, SLOT( clear() ), Qt::UniqueConnection );
+  connect( layer, SIGNAL( dataChanged() ), this, SLOT( clear() ), Qt::UniqueConnection );
+  connect( layer, SIGNAL( layerModified() ), this, SLOT( clear() ), Qt::UniqueConnection );
+  connect( layer, SIGNAL( rendererChanged() ), this, SLOT( clear() ), Qt::UniqueConnection );
+  connect( layer, SIGNAL( updatedFields() ), this, SLOT( clear() ), Qt::UniqueConnection );
+  connect( layer, SIGNAL( layerCrsChanged() ), this, SLOT( clear() ), Qt::UniqueConnection );
+  connect( layer, SIGNAL( editingStarted() ), this, SLOT( clear() ), Qt::UniqueConnection );
+  connect( layer, SIGNAL( editingStopped() ), this, SLOT( clear() ), Qt::UniqueConnection );
+  connect( layer, SIGNAL( layerDeleted() ), this, SLOT( clear() ), Qt::UniqueConnection );
+  connect( layer, SIGNAL( destroyed() ), this, SLOT( clear() ), Qt::UniqueConnection );
+}
+
+void QgsLabelPlacementCache::clear()
+{
+  mKey.clear();
+  mImage = QImage();
+}
@@ -0,0 +1,64 @@
+/***************************************************************************
+    qgslabelplacementcache.h  -  Labels of the last render for reuse
+                             -------------------
+    begin                : January 2014
+    copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSLABELPLACEMENTCACHE_H
+#define QGSLABELPLACEMENTCACHE_H
+
+#include <QImage>
+#include <QObject>
+#include <QString>
+
+class QgsVectorLayer;
+
+/** \ingroup core
+  * The labels placed and drawn by the last render of a QgsPalLabeling engine.
+  * The key describes everything the placement depends on (extent, scale, CRS,
+  * output device, engine and layer settings). Changes which are not part of
+  * the key (features, renderer, fields, edit state) are caught by watching
+  * the signals of the labelled layers, each of them empties the cache.
+  * @note not available in python bindings
+  * @note added in 2.1
+  */
+class CORE_EXPORT QgsLabelPlacementCache : public QObject
+{
+    Q_OBJECT
+
+  public:
+    QgsLabelPlacementCache( QObject* parent = 0 );
+    ~QgsLabelPlacementCache();
+
+    /** True if the labels of a render with this key are cached */
+    bool contains( const QString& key ) const { return !mKey.isEmpty() && mKey == key; }
+
+    /** Image with the cached labels, transparent outside of the labels */
+    const QImage& image() const { return mImage; }
+
+    /** Stores the labels of a render. An empty key empties the cache */
+    void setImage( const QString& key, const QImage& image );
+
+    /** Empties the cache as soon as the layer changes. Layers are only connected once */
+    void watchLayer( QgsVectorLayer* layer );
+
+  public slots:
+    /** Removes the cached labels */
+    void clear();
+
+  private:
+    QString mKey;
+    QImage mImage;
+};
+
+#endif // QGSLABELPLACEMENTCACHE_H
@@ -152,6 +152,12 @@ bool QgsMapLayer::draw( QgsRenderContext& rendererContext )
   return false;
 }
 
+QgsMapLayerRenderer* QgsMapLayer::createMapRenderer( QgsRenderContext& rendererContext )
+{
+  Q_UNUSED( rendererContext );
+  return 0;
+}
+
 void QgsMapLayer::drawLabels( QgsRenderContext& rendererContext )
 {
   Q_UNUSED( rendererContext );
@@ -1258,6 +1264,11 @@ QVariant QgsMapLayer::customProperty( const QString& value, const QVariant& defa
   return mCustomProperties.value( value, defaultValue );
 }
 
+QStringList QgsMapLayer::customPropertyKeys() const
+{
+  return mCustomProperties.keys();
+}
+
 void QgsMapLayer::removeCustomProperty( const QString& key )
 {
   mCustomProperties.remove( key );
@@ -22,6 +22,7 @@
 #include <QObject>
 #include <QUndoStack>
 #include <QVariant>
+#include <QStringList>
 #include <QImage>
 #include <QDomNode>
 #include <QPainter>
@@ -33,6 +34,7 @@
 
 class QgsRenderContext;
 class QgsCoordinateReferenceSystem;
+class QgsMapLayerRenderer;
 
 class QDomDocument;
 class QKeyEvent;
@@ -136,6 +138,15 @@ class CORE_EXPORT QgsMapLayer : public QObject
      */
     virtual bool draw( QgsRenderContext& rendererContext );
 
+    /** Create a renderer that takes a snapshot of the layer's rendering state
+     * so that the layer can be drawn outside of the main thread. The snapshot
+     * is taken immediately in the calling thread, QgsMapLayerRenderer::render()
+     * may then be called from a worker thread. Returns 0 if the layer cannot
+     * be rendered that way - draw() is used instead. Caller takes ownership.
+     * @note added in 2.1
+     */
+    virtual QgsMapLayerRenderer* createMapRenderer( QgsRenderContext& rendererContext );
+
     /** Draw labels
      * @todo to be removed: used only in vector layers
      */
@@ -217,6 +228,9 @@ class CORE_EXPORT QgsMapLayer : public QObject
     /** Read a custom property from layer. Properties are stored in a map and saved in project file.
      *  @note Added in v1.4 */
     QVariant customProperty( const QString& value, const QVariant& defaultValue = QVariant() ) const;
+    /** Keys of all custom properties of the layer, in ascending order
+     *  @note Added in v2.1 */
+    QStringList customPropertyKeys() const;
     /** Remove a custom property from layer. Properties are stored in a map and saved in project file.
      *  @note Added in v1.4 */
     void removeCustomProperty( const QString& key );
@@ -0,0 +1,47 @@
+/***************************************************************************
+    qgsmaplayerrenderer.h
+    ---------------------
+    begin                : January 2014
+    copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#ifndef QGSMAPLAYERRENDERER_H
+#define QGSMAPLAYERRENDERER_H
+
+#include <QString>
+
+/** \ingroup core
+ * Base class for snapshots of a map layer's rendering state.
+ *
+ * An instance is created with QgsMapLayer::createMapRenderer() in the main
+ * thread. The constructor of the implementation copies everything it needs
+ * from the layer (renderer, selection, prepared feature iterator, raster pipe, ...),
+ * so that render() does not access the live layer object anymore and can
+ * be run from a worker thread while other layers are rendered.
+ *
+ * @note added in 2.1
+ */
+class CORE_EXPORT QgsMapLayerRenderer
+{
+  public:
+    QgsMapLayerRenderer( const QString& layerID ) : mLayerID( layerID ) {}
+    virtual ~QgsMapLayerRenderer() {}
+
+    //! Do the rendering into the painter of the render context given at construction.
+    //! Returns false if the rendering failed
+    virtual bool render() = 0;
+
+    //! Get ID of the layer this renderer was created for
+    QString layerID() const { return mLayerID; }
+
+  protected:
+    QString mLayerID;
+};
+
+#endif // QGSMAPLAYERRENDERER_H
@@ -25,9 +25,11 @@
 #include "qgsmaptopixel.h"
 #include "qgsmaplayer.h"
 #include "qgsmaplayerregistry.h"
+#include "qgsmaplayerrenderer.h"
 #include "qgsdistancearea.h"
 #include "qgsproject.h"
 #include "qgsvectorlayer.h"
+#include "qgsvectorlayerrenderer.h"
 
 
 #include <QDomDocument>
@@ -36,6 +38,9 @@
 #include <QPainter>
 #include <QListIterator>
 #include <QSettings>
+#include <QtConcurrentMap>
+#include <QFuture>
+#include <QPointer>
 #include <QTime>
 #include <QCoreApplication>
 
@@ -341,13 +346,27 @@ void QgsMapRenderer::render( QPainter* painter, double* forceWidthScale )
     }
   }
 
+  // render the layers into separate images in worker threads if enabled. This is
+  // not combined with render caching (which keeps its own per layer images) and is
+  // only used for raster paint devices with the same resolution as the map
+  QSettings settings;
+  bool parallelRendering = settings.value( "/qgis/parallel_rendering", false ).toBool()
+                           && !settings.value( "/qgis/enable_render_caching", false ).toBool()
+                           && !mRenderContext.forceVectorOutput()
+                           && ( thePaintDevice->devType() == QInternal::Image || thePaintDevice->devType() == QInternal::Pixmap )
+                           && qAbs( rasterScaleFactor - 1.0 ) < 0.000001;
+  if ( parallelRendering )
+  {
+    renderLayersInParallel();
+  }
+
   // render all layers in the stack, starting at the base
   QListIterator<QString> li( mLayerSet );
   li.toBack();
 
   QgsRectangle r1, r2;
 
-  while ( li.hasPrevious() )
+  while ( !parallelRendering && li.hasPrevious() )
   {
     if ( mRenderContext.renderingStopped() )
     {
@@ -453,7 +472,9 @@ void QgsMapRenderer::render( QPainter* painter, double* forceWidthScale )
 
       QSettings mySettings;
       bool useRenderCaching = false;
-      if ( ! split )//render caching does not yet cater for split extents
+      //render caching does not yet cater for split extents
+      //and the cache image must not contain request specific layer state
+      if ( !split && !mRenderContext.hasLayerOverride( ml->id() ) )
       {
         if ( mySettings.value( "/qgis/enable_render_caching", false ).toBool() )
         {
@@ -549,7 +570,7 @@ void QgsMapRenderer::render( QPainter* painter, double* forceWidthScale )
         mRenderContext.painter()->scale( 1.0 / rasterScaleFactor, 1.0 / rasterScaleFactor );
       }
 
-      if ( !ml->draw( mRenderContext ) )
+      if ( !drawLayer( ml ) )
       {
         emit drawError( ml );
       }
@@ -561,7 +582,7 @@ void QgsMapRenderer::render( QPainter* painter, double* forceWidthScale )
       if ( split )
       {
         mRenderContext.setExtent( r2 );
-        if ( !ml->draw( mRenderContext ) )
+        if ( !drawLayer( ml ) )
         {
           emit drawError( ml );
         }
@@ -694,6 +715,260 @@ void QgsMapRenderer::render( QPainter* painter, double* forceWidthScale )
   mDrawing = false;
 }
 
+/** Layer to be rendered into its own image by QgsMapRenderer::renderLayersInParallel() */
+struct LayerRenderJob
+{
+  //! null once the layer is deleted while events are processed by a layer drawn in the main thread
+  QPointer<QgsMapLayer> layer;
+  QImage* img;
+  QPainter* painter;
+  QgsRenderContext context;
+  //! own copy of the layer's coordinate transform (0 if not needed)
+  QgsCoordinateTransform* ct;
+  //! snapshot of the layer for a worker thread - 0 if the layer is drawn in the main thread
+  QgsMapLayerRenderer* renderer;
+  //! second extent if the view crosses the +/- 180 degree line (drawn in the main thread)
+  bool split;
+  QgsRectangle extent2;
+  bool ok;
+  //! layer state for compositing, taken before any layer is drawn
+  QPainter::CompositionMode blendMode;
+  int transparency;
+};
+
+static void renderLayerJob( LayerRenderJob*& job )
+{
+  job->ok = job->renderer->render();
+}
+
+void QgsMapRenderer::renderLayersInParallel()
+{
+  QPainter* painter = mRenderContext.painter();
+  int deviceWidth = painter->device()->width();
+  int deviceHeight = painter->device()->height();
+
+  QSettings mySettings;
+  bool antialiasing = mySettings.value( "/qgis/enable_anti_aliasing", true ).toBool();
+
+  // 1. prepare the jobs in the main thread, starting at the base
+  QList<LayerRenderJob*> jobs;
+  QList<LayerRenderJob*> parallelJobs;
+
+  QListIterator<QString> li( mLayerSet );
+  li.toBack();
+  while ( li.hasPrevious() )
+  {
+    QString layerId = li.previous();
+    QgsMapLayer *ml = QgsMapLayerRegistry::instance()->mapLayer( layerId );
+
+    if ( !ml )
+    {
+      QgsDebugMsg( "Layer not found in registry!" );
+      continue;
+    }
+
+    if ( ml->hasScaleBasedVisibility() && !( ml->minimumScale() <= mScale && mScale < ml->maximumScale() ) && !mOverview )
+    {
+      QgsDebugMsg( "Layer not rendered because it is not within the defined visibility scale range" );
+      continue;
+    }
+
+    LayerRenderJob* job = new LayerRenderJob;
+    job->layer = ml;
+    job->context = mRenderContext;
+    // stopRendering() sets the flag of mRenderContext, the workers follow it
+    job->context.setRenderingStoppedSource( &mRenderContext );
+    job->ct = 0;
+    job->renderer = 0;
+    job->split = false;
+    job->ok = true;
+    job->blendMode = ml->blendMode();
+    job->transparency = 0;
+
+    if ( hasCrsTransformEnabled() )
+    {
+      QgsRectangle r1 = mExtent;
+      job->split = splitLayersExtent( ml, r1, job->extent2 );
+      if ( !r1.isFinite() || !job->extent2.isFinite() ) //there was a problem transforming the extent. Skip the layer
+      {
+        delete job;
+        continue;
+      }
+      job->context.setExtent( r1 );
+
+      const QgsCoordinateTransform* ct = transformation( ml );
+      if ( ct )
+      {
+        job->ct = new QgsCoordinateTransform( ct->sourceCrs(), ct->destCRS() );
+        job->ct->setSourceDatumTransform( ct->sourceDatumTransform() );
+        job->ct->setDestinationDatumTransform( ct->destinationDatumTransform() );
+        job->ct->initialise();
+      }
+    }
+    else
+    {
+      job->context.setExtent( mExtent );
+    }
+    job->context.setCoordinateTransform( job->ct );
+
+    job->img = new QImage( deviceWidth, deviceHeight, QImage::Format_ARGB32_Premultiplied );
+    if ( job->img->isNull() )
+    {
+      QgsDebugMsg( "insufficient memory for image " + QString::number( deviceWidth ) + "x" + QString::number( deviceHeight ) );
+      emit drawError( ml );
+      delete job->img;
+      delete job->ct;
+      delete job;
+      continue;
+    }
+    job->img->fill( 0 );
+
+    job->painter = new QPainter( job->img );
+    if ( antialiasing )
+    {
+      job->painter->setRenderHint( QPainter::Antialiasing );
+    }
+    job->context.setPainter( job->painter );
+
+    // Per feature blending mode
+    if ( mRenderContext.useAdvancedEffects() && ml->type() == QgsMapLayer::VectorLayer )
+    {
+      QgsVectorLayer* vl = qobject_cast<QgsVectorLayer *>( ml );
+      if ( vl->featureBlendMode() != QPainter::CompositionMode_SourceOver )
+      {
+        job->painter->setCompositionMode( vl->featureBlendMode() );
+      }
+      job->transparency = vl->layerTransparency();
+    }
+
+    if ( !job->split )
+    {
+      job->renderer = ml->createMapRenderer( job->context );
+    }
+
+    jobs.append( job );
+    if ( job->renderer )
+    {
+      parallelJobs.append( job );
+    }
+  }
+
+  // 2. render the snapshots on the global thread pool. No events are processed until
+  // the workers are finished: the snapshots use the layers' providers, which must
+  // not be deleted or used by the main thread meanwhile. The workers follow the
+  // stop flag of mRenderContext themselves
+  if ( !mRenderContext.renderingStopped() && !parallelJobs.isEmpty() )
+  {
+    QgsDebugMsg( QString( "Rendering %1 layers in parallel" ).arg( parallelJobs.count() ) );
+    QFuture<void> future = QtConcurrent::map( parallelJobs, renderLayerJob );
+    future.waitForFinished();
+  }
+
+  // the snapshots may hold feature iterators - release them before any event is processed
+  foreach ( LayerRenderJob* job, parallelJobs )
+  {
+    delete job->renderer;
+    job->renderer = 0;
+  }
+
+  // 3. layers without a snapshot are drawn in the main thread. They may process
+  // events and so remove any layer of the set while drawing
+  QPainter* mypContextPainter = mRenderContext.painter();
+  foreach ( LayerRenderJob* job, jobs )
+  {
+    if ( parallelJobs.contains( job ) )
+      continue;
+
+    if ( mRenderContext.renderingStopped() )
+      break;
+
+    if ( !job->layer )
+      continue;
+
+    connect( job->layer, SIGNAL( drawingProgress( int, int ) ), this, SLOT( onDrawingProgress( int, int ) ) );
+
+    mRenderContext.setPainter( job->painter );
+    mRenderContext.setCoordinateTransform( job->ct );
+    mRenderContext.setExtent( job->context.extent() );
+    job->ok = drawLayer( job->layer );
+    if ( job->split && job->layer )
+    {
+      mRenderContext.setExtent( job->extent2 );
+      job->ok = drawLayer( job->layer ) && job->ok;
+    }
+
+    if ( job->layer )
+    {
+      disconnect( job->layer, SIGNAL( drawingProgress( int, int ) ), this, SLOT( onDrawingProgress( int, int ) ) );
+    }
+  }
+  mRenderContext.setPainter( mypContextPainter );
+  mRenderContext.setCoordinateTransform( 0 );
+  mRenderContext.setExtent( mExtent );
+
+  // 4. composite the images in layer order and clean up
+  foreach ( LayerRenderJob* job, jobs )
+  {
+    delete job->painter;
+
+    if ( !job->ok && job->layer )
+    {
+      emit drawError( job->layer );
+    }
+
+    //apply layer transparency for vector layers
+    if ( mRenderContext.useAdvancedEffects() && job->transparency != 0 )
+    {
+      // combine the image alpha with the layer transparency
+      QPainter p( job->img );
+      p.setCompositionMode( QPainter::CompositionMode_DestinationIn );
+      p.fillRect( 0, 0, deviceWidth, deviceHeight, QColor( 0, 0, 0, 255 - ( 255 * job->transparency / 100 ) ) );
+    }
+
+    if ( !mRenderContext.renderingStopped() )
+    {
+      painter->save();
+      if ( mRenderContext.useAdvancedEffects() )
+      {
+        // Set the QPainter composition mode so that this layer is rendered using
+        // the desired blending mode
+        painter->setCompositionMode( job->blendMode );
+      }
+      painter->drawImage( 0, 0, *job->img );
+      painter->restore();
+    }
+
+    delete job->img;
+    delete job->ct;
+    delete job;
+  }
+
+  QgsDebugMsg( "Done rendering map layers in parallel" );
+}
+
+bool QgsMapRenderer::drawLayer( QgsMapLayer* ml )
+{
+  if ( !mRenderContext.hasLayerOverride( ml->id() ) )
+  {
+    return ml->draw( mRenderContext );
+  }
+
+  // the override is only known to the renderer, the layer itself is not modified
+  QgsVectorLayer* vl = qobject_cast<QgsVectorLayer *>( ml );
+  if ( vl && !vl->isEditable() && vl->hasGeometryType() && vl->rendererV2() )
+  {
+    QgsVectorLayerRenderer renderer( vl, mRenderContext );
+    return renderer.render();
+  }
+
+  QPainter* painter = mRenderContext.painter();
+  painter->save();
+  painter->setOpacity( painter->opacity() * mRenderContext.layerOverride( ml->id() ).opacity );
+  bool ok = ml->draw( mRenderContext );
+  painter->restore();
+  return ok;
+}
+
 void QgsMapRenderer::setMapUnits( QGis::UnitType u )
 {
   mScaleCalculator->setMapUnits( u );
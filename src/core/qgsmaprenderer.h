@@ -348,6 +348,22 @@ class CORE_EXPORT QgsMapRenderer : public QObject
      */
     bool splitLayersExtent( QgsMapLayer* layer, QgsRectangle& extent, QgsRectangle& r2 );
 
+    /** Render each layer of the layer set into its own image and compose them in
+     * layer order using each layer's blend mode. Layers that provide a snapshot with
+     * QgsMapLayer::createMapRenderer() are rendered on the global thread pool while
+     * the calling thread waits without processing events, the others are drawn in
+     * the calling thread afterwards. Labels are left for the final pass in render().
+     * @note added in 2.1
+     */
+    void renderLayersInParallel();
+
+    /** Draw a layer with the current render context in the calling thread. If the
+     * context has an override for the layer, it is applied by the layer renderer
+     * (vector layers) or by the painter opacity (other layers)
+     * @note added in 2.2
+     */
+    bool drawLayer( QgsMapLayer* ml );
+
     //! indicates drawing in progress
     static bool mDrawing;
 
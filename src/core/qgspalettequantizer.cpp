@@ -0,0 +1,495 @@
+/***************************************************************************
+    qgspalettequantizer.cpp
+    ---------------------
+    begin                : January 2014
+    copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgspalettequantizer.h"
+#include "qgslogger.h"
+
+#include <QVector>
+
+#include <climits>
+#include <cstring>
+
+// 3 bits alpha, 5 bits red, green and blue
+static const int HISTOGRAM_SIZE = 1 << 18;
+// all the fully transparent pixels share one cell
+static const int TRANSPARENT_CELL = HISTOGRAM_SIZE;
+
+static inline int histogramCell( QRgb c )
+{
+  int alpha = qAlpha( c );
+  if ( alpha == 0 )
+  {
+    return TRANSPARENT_CELL;
+  }
+  return (( alpha >> 5 ) << 15 ) | (( qRed( c ) >> 3 ) << 10 ) | (( qGreen( c ) >> 3 ) << 5 ) | ( qBlue( c ) >> 3 );
+}
+
+namespace
+{
+  //! occupied cell of the histogram
+  struct HistogramEntry
+  {
+    int cell;
+    quint64 count;
+    //! sums of red, green, blue and alpha
+    quint64 sum[4];
+    //! average red, green, blue and alpha
+    int color[4];
+  };
+
+  //! range of histogram entries to be represented by one palette color
+  struct ColorBox
+  {
+    int begin;
+    int end;
+    quint64 pixels;
+    //! color component with the largest range
+    int component;
+    int range;
+  };
+
+  struct ComponentLessThan
+  {
+    ComponentLessThan( int component ) : mComponent( component ) {}
+    bool operator()( const HistogramEntry& e1, const HistogramEntry& e2 ) const
+    {
+      return e1.color[mComponent] < e2.color[mComponent];
+    }
+    int mComponent;
+  };
+
+  //! nearest color search, the palette is sorted by green to stop early
+  class PaletteSearch
+  {
+    public:
+      PaletteSearch( const QVector<QRgb>& palette )
+      {
+        for ( int i = 0; i < palette.size(); ++i )
+        {
+          Entry e;
+          e.r = qRed( palette[i] );
+          e.g = qGreen( palette[i] );
+          e.b = qBlue( palette[i] );
+          e.a = qAlpha( palette[i] );
+          e.index = i;
+          mEntries.append( e );
+        }
+        qSort( mEntries.begin(), mEntries.end(), greenLessThan );
+      }
+
+      int nearest( int r, int g, int b, int a ) const
+      {
+        int n = mEntries.size();
+        int lo = 0;
+        int hi = n;
+        while ( lo < hi )
+        {
+          int mid = ( lo + hi ) / 2;
+          if ( mEntries[mid].g < g )
+            lo = mid + 1;
+          else
+            hi = mid;
+        }
+
+        int best = 0;
+        int bestDist = INT_MAX;
+        for ( int i = lo; i < n; ++i )
+        {
+          if ( !testEntry( mEntries[i], r, g, b, a, best, bestDist ) )
+            break;
+        }
+        for ( int i = lo - 1; i >= 0; --i )
+        {
+          if ( !testEntry( mEntries[i], r, g, b, a, best, bestDist ) )
+            break;
+        }
+        return best;
+      }
+
+    private:
+      struct Entry
+      {
+        int r, g, b, a;
+        int index;
+      };
+
+      static bool greenLessThan( const Entry& e1, const Entry& e2 ) { return e1.g < e2.g; }
+
+      //! returns false if this and all the following entries are too far away in green
+      static bool testEntry( const Entry& e, int r, int g, int b, int a, int& best, int& bestDist )
+      {
+        int dg = e.g - g;
+        int dist = dg * dg;
+        if ( dist >= bestDist )
+          return false;
+
+        int dr = e.r - r;
+        int db = e.b - b;
+        int da = e.a - a;
+        dist += dr * dr + db * db + da * da;
+        if ( dist < bestDist )
+        {
+          bestDist = dist;
+          best = e.index;
+        }
+        return true;
+      }
+
+      QVector<Entry> mEntries;
+  };
+}
+
+static void computeBoxRange( ColorBox& box, const QVector<HistogramEntry>& entries )
+{
+  int minColor[4] = { INT_MAX, INT_MAX, INT_MAX, INT_MAX };
+  int maxColor[4] = { INT_MIN, INT_MIN, INT_MIN, INT_MIN };
+  box.pixels = 0;
+  for ( int i = box.begin; i < box.end; ++i )
+  {
+    const HistogramEntry& e = entries[i];
+    box.pixels += e.count;
+    for ( int c = 0; c < 4; ++c )
+    {
+      minColor[c] = qMin( minColor[c], e.color[c] );
+      maxColor[c] = qMax( maxColor[c], e.color[c] );
+    }
+  }
+
+  box.component = 0;
+  box.range = maxColor[0] - minColor[0];
+  for ( int c = 1; c < 4; ++c )
+  {
+    if ( maxColor[c] - minColor[c] > box.range )
+    {
+      box.component = c;
+      box.range = maxColor[c] - minColor[c];
+    }
+  }
+}
+
+QgsPaletteQuantizer::QgsPaletteQuantizer()
+    : mMaxColors( 256 )
+    , mDithering( false )
+{
+}
+
+void QgsPaletteQuantizer::setMaxColors( int n )
+{
+  mMaxColors = qBound( 2, n, 256 );
+}
+
+bool QgsPaletteQuantizer::quantizeExact( const QImage& image, QImage& result ) const
+{
+  // open addressing, large enough to stay sparse with 256 colors
+  const int tableSize = 1024;
+  QRgb keys[tableSize];
+  int values[tableSize];
+  for ( int i = 0; i < tableSize; ++i )
+  {
+    values[i] = -1;
+  }
+
+  QVector<QRgb> colorTable;
+  result = QImage( image.size(), QImage::Format_Indexed8 );
+
+  int width = image.width();
+  int height = image.height();
+  for ( int y = 0; y < height; ++y )
+  {
+    const QRgb* srcPixels = ( const QRgb* ) image.constScanLine( y );
+    uchar* destPixels = result.scanLine( y );
+
+    QRgb lastColor = 0;
+    int lastIndex = -1;
+    for ( int x = 0; x < width; ++x )
+    {
+      QRgb color = qAlpha( srcPixels[x] ) == 0 ? 0 : srcPixels[x];
+      if ( color != lastColor || lastIndex < 0 )
+      {
+        int slot = (( quint32 ) color * 2654435761U ) >> 22;
+        while ( values[slot] >= 0 && keys[slot] != color )
+        {
+          slot = ( slot + 1 ) & ( tableSize - 1 );
+        }
+
+        if ( values[slot] < 0 )
+        {
+          if ( colorTable.size() == mMaxColors )
+          {
+            return false; //too many colors
+          }
+          keys[slot] = color;
+          values[slot] = colorTable.size();
+          colorTable.append( color );
+        }
+
+        lastColor = color;
+        lastIndex = values[slot];
+      }
+      destPixels[x] = ( uchar ) lastIndex;
+    }
+  }
+
+  result.setColorTable( colorTable );
+  return true;
+}
+
+QImage QgsPaletteQuantizer::quantize( const QImage& image ) const
+{
+  if ( image.isNull() )
+  {
+    return QImage();
+  }
+
+  // the colors of the palette are not premultiplied
+  QImage src = image.format() == QImage::Format_ARGB32 ? image : image.convertToFormat( QImage::Format_ARGB32 );
+
+  QImage result;
+  if ( quantizeExact( src, result ) )
+  {
+    return result;
+  }
+
+  int width = src.width();
+  int height = src.height();
+
+  // 1. histogram of the occupied cells
+  QVector<int> cellIndex( HISTOGRAM_SIZE + 1, -1 );
+  int* cellIndexData = cellIndex.data();
+  QVector<HistogramEntry> entries;
+  entries.reserve( 4096 );
+  bool hasTransparent = false;
+
+  for ( int y = 0; y < height; ++y )
+  {
+    const QRgb* srcPixels = ( const QRgb* ) src.constScanLine( y );
+    for ( int x = 0; x < width; ++x )
+    {
+      QRgb color = srcPixels[x];
+      int cell = histogramCell( color );
+      if ( cell == TRANSPARENT_CELL )
+      {
+        hasTransparent = true;
+        continue;
+      }
+
+      int index = cellIndexData[cell];
+      if ( index < 0 )
+      {
+        index = entries.size();
+        cellIndexData[cell] = index;
+        HistogramEntry newEntry;
+        newEntry.cell = cell;
+        newEntry.count = 0;
+        newEntry.sum[0] = newEntry.sum[1] = newEntry.sum[2] = newEntry.sum[3] = 0;
+        entries.append( newEntry );
+      }
+
+      HistogramEntry& e = entries[index];
+      ++e.count;
+      e.sum[0] += qRed( color );
+      e.sum[1] += qGreen( color );
+      e.sum[2] += qBlue( color );
+      e.sum[3] += qAlpha( color );
+    }
+  }
+
+  for ( int i = 0; i < entries.size(); ++i )
+  {
+    HistogramEntry& e = entries[i];
+    for ( int c = 0; c < 4; ++c )
+    {
+      e.color[c] = ( int )( e.sum[c] / e.count );
+    }
+  }
+
+  // 2. median cut over the histogram entries, keeping one color for transparent pixels
+  int nColors = hasTransparent ? mMaxColors - 1 : mMaxColors;
+  QVector<ColorBox> boxes;
+  if ( !entries.isEmpty() )
+  {
+    ColorBox firstBox;
+    firstBox.begin = 0;
+    firstBox.end = entries.size();
+    computeBoxRange( firstBox, entries );
+    boxes.append( firstBox );
+  }
+
+  while ( boxes.size() < nColors )
+  {
+    // split the box with the largest extent weighted by its number of pixels
+    int splitIndex = -1;
+    double maxScore = 0;
+    for ( int i = 0; i < boxes.size(); ++i )
+    {
+      const ColorBox& box = boxes[i];
+      double score = ( double ) box.pixels * box.range;
+      if ( box.end - box.begin > 1 && score > maxScore )
+      {
+        splitIndex = i;
+        maxScore = score;
+      }
+    }
+    if ( splitIndex < 0 )
+    {
+      break; //every color has its own box
+    }
+
+    ColorBox box = boxes[splitIndex];
+    qSort( entries.begin() + box.begin, entries.begin() + box.end, ComponentLessThan( box.component ) );
+
+    // median by number of pixels, leaving at least one entry in each half
+    quint64 halfPixels = box.pixels / 2;
+    quint64 currentPixels = 0;
+    int median = box.begin;
+    while ( median < box.end - 1 )
+    {
+      currentPixels += entries[median].count;
+      ++median;
+      if ( currentPixels >= halfPixels )
+      {
+        break;
+      }
+    }
+
+    ColorBox box1 = box;
+    box1.end = median;
+    computeBoxRange( box1, entries );
+    ColorBox box2 = box;
+    box2.begin = median;
+    computeBoxRange( box2, entries );
+    boxes[splitIndex] = box1;
+    boxes.append( box2 );
+  }
+
+  // 3. pixel weighted average of the boxes
+  QVector<QRgb> colorTable;
+  for ( int i = 0; i < boxes.size(); ++i )
+  {
+    quint64 sum[4] = { 0, 0, 0, 0 };
+    for ( int j = boxes[i].begin; j < boxes[i].end; ++j )
+    {
+      for ( int c = 0; c < 4; ++c )
+      {
+        sum[c] += entries[j].sum[c];
+      }
+    }
+    quint64 pixels = qMax( boxes[i].pixels, ( quint64 ) 1 );
+    colorTable.append( qRgba(( int )( sum[0] / pixels ), ( int )( sum[1] / pixels ), ( int )( sum[2] / pixels ), ( int )( sum[3] / pixels ) ) );
+  }
+  if ( hasTransparent )
+  {
+    cellIndexData[TRANSPARENT_CELL] = colorTable.size();
+    colorTable.append( qRgba( 0, 0, 0, 0 ) );
+  }
+
+  // 4. map every occupied cell to its nearest palette color (cellIndex is reused as lookup table)
+  PaletteSearch search( colorTable );
+  for ( int i = 0; i < entries.size(); ++i )
+  {
+    const HistogramEntry& e = entries[i];
+    cellIndexData[e.cell] = search.nearest( e.color[0], e.color[1], e.color[2], e.color[3] );
+  }
+
+  result = QImage( src.size(), QImage::Format_Indexed8 );
+  result.setColorTable( colorTable );
+
+  if ( !mDithering )
+  {
+    for ( int y = 0; y < height; ++y )
+    {
+      const QRgb* srcPixels = ( const QRgb* ) src.constScanLine( y );
+      uchar* destPixels = result.scanLine( y );
+      for ( int x = 0; x < width; ++x )
+      {
+        destPixels[x] = ( uchar ) cellIndexData[histogramCell( srcPixels[x] )];
+      }
+    }
+    return result;
+  }
+
+  // 5. Floyd-Steinberg dithering, errors are kept in 1/16 and padded by one pixel on each side
+  QVector<int> errors1(( width + 2 ) * 4, 0 );
+  QVector<int> errors2(( width + 2 ) * 4, 0 );
+  int* currentErrors = errors1.data();
+  int* nextErrors = errors2.data();
+
+  for ( int y = 0; y < height; ++y )
+  {
+    const QRgb* srcPixels = ( const QRgb* ) src.constScanLine( y );
+    uchar* destPixels = result.scanLine( y );
+    memset( nextErrors, 0, ( width + 2 ) * 4 * sizeof( int ) );
+
+    for ( int x = 0; x < width; ++x )
+    {
+      QRgb color = srcPixels[x];
+      int* error = currentErrors + ( x + 1 ) * 4;
+
+      // transparent areas stay transparent
+      int c[4];
+      c[3] = qAlpha( color );
+      if ( c[3] == 0 )
+      {
+        c[0] = c[1] = c[2] = 0;
+      }
+      else
+      {
+        c[0] = qBound( 0, qRed( color ) + error[0] / 16, 255 );
+        c[1] = qBound( 0, qGreen( color ) + error[1] / 16, 255 );
+        c[2] = qBound( 0, qBlue( color ) + error[2] / 16, 255 );
+        c[3] = qBound( 1, c[3] + error[3] / 16, 255 );
+      }
+
+      int cell = histogramCell( qRgba( c[0], c[1], c[2], c[3] ) );
+      int index = cellIndexData[cell];
+      if ( index < 0 )
+      {
+        // first color of an unoccupied cell
+        index = search.nearest( c[0], c[1], c[2], c[3] );
+        cellIndexData[cell] = index;
+      }
+      destPixels[x] = ( uchar ) index;
+
+      if ( qAlpha( color ) == 0 )
+      {
+        continue;
+      }
+
+      QRgb mapped = colorTable[index];
+      int diff[4] = { c[0] - qRed( mapped ), c[1] - qGreen( mapped ), c[2] - qBlue( mapped ), c[3] - qAlpha( mapped ) };
+      int* nextError = nextErrors + ( x + 1 ) * 4;
+      for ( int i = 0; i < 4; ++i )
+      {
+        error[4 + i] += diff[i] * 7;
+        nextError[-4 + i] += diff[i] * 3;
+        nextError[i] += diff[i] * 5;
+        nextError[4 + i] += diff[i];
+      }
+    }
+
+    qSwap( currentErrors, nextErrors );
+  }
+
+  return result;
+}
+
+int QgsPaletteQuantizer::pngQuality( int compressionLevel )
+{
+  if ( compressionLevel < 0 || compressionLevel > 9 )
+  {
+    return -1;
+  }
+  // the PNG writer sets zlib level ( 100 - quality ) * 9 / 91
+  return 100 - ( compressionLevel * 91 + 8 ) / 9;
+}
@@ -0,0 +1,63 @@
+/***************************************************************************
+    qgspalettequantizer.h
+    ---------------------
+    begin                : January 2014
+    copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSPALETTEQUANTIZER_H
+#define QGSPALETTEQUANTIZER_H
+
+#include <QImage>
+
+/** \ingroup core
+ * Converts 32 bit images to 8 bit images with a color palette (e.g. for 8 bit PNG).
+ *
+ * If the image has no more colors than the palette size, the conversion is lossless.
+ * Otherwise the colors are counted in a histogram with 5 bits per color component
+ * and 3 bits for alpha, and the palette is built with median cut over the occupied
+ * histogram cells. Every cell is mapped once to its nearest palette color, the
+ * pixels are then converted with a table lookup. Fully transparent pixels always
+ * keep a transparent palette entry. Optionally the quantization error is diffused
+ * to the neighbour pixels (Floyd-Steinberg dithering).
+ *
+ * \note not available in Python bindings
+ * \note added in 2.2
+ */
+class CORE_EXPORT QgsPaletteQuantizer
+{
+  public:
+    QgsPaletteQuantizer();
+
+    /**Maximum number of palette colors (2 - 256, default 256)*/
+    void setMaxColors( int n );
+    int maxColors() const { return mMaxColors; }
+
+    /**Enable Floyd-Steinberg dithering (default off)*/
+    void setDithering( bool enabled ) { mDithering = enabled; }
+    bool dithering() const { return mDithering; }
+
+    /**Returns the image converted to QImage::Format_Indexed8*/
+    QImage quantize( const QImage& image ) const;
+
+    /**Returns the QImage::save() quality parameter giving the zlib compression
+      level (0-9) for PNG images. Returns -1 (default compression) if the level is out of range*/
+    static int pngQuality( int compressionLevel );
+
+  private:
+    /**Lossless conversion for images with at most mMaxColors colors.
+      @return false if the image has too many colors*/
+    bool quantizeExact( const QImage& image, QImage& result ) const;
+
+    int mMaxColors;
+    bool mDithering;
+};
+
+#endif // QGSPALETTEQUANTIZER_H
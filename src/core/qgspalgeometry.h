@@ -18,6 +18,7 @@ class QgsPalGeometry : public PalGeometry
         , mIsDiagram( false )
         , mIsPinned( false )
         , mFontMetrics( NULL )
+        , mOwnsFontMetrics( false )
         , mLetterSpacing( ltrSpacing )
         , mWordSpacing( wordSpacing )
         , mCurvedLabeling( curvedLabeling )
@@ -31,7 +32,8 @@ class QgsPalGeometry : public PalGeometry
       if ( mG )
         GEOSGeom_destroy( mG );
       delete mInfo;
-      delete mFontMetrics;
+      if ( mOwnsFontMetrics )
+        delete mFontMetrics;
     }
 
     // getGeosGeometry + releaseGeosGeometry is called twice: once when adding, second time when labeling
@@ -48,12 +50,16 @@ class QgsPalGeometry : public PalGeometry
     const char* strId() { return mStrId.data(); }
     QString text() { return mText; }
 
-    pal::LabelInfo* info( QFontMetricsF* fm, const QgsMapToPixel* xform, double fontScale, double maxinangle, double maxoutangle )
+    /** @param fm metrics of the label font, kept for when drawing label
+     *  @param ownsMetrics whether the geometry takes ownership of fm, otherwise fm has to stay valid
+     *  until the label is drawn (e.g. metrics shared by a QgsLabelTextCache) */
+    pal::LabelInfo* info( QFontMetricsF* fm, const QgsMapToPixel* xform, double fontScale, double maxinangle, double maxoutangle, bool ownsMetrics = false )
     {
       if ( mInfo )
         return mInfo;
 
-      mFontMetrics = new QFontMetricsF( *fm ); // duplicate metrics for when drawing label
+      mFontMetrics = fm;
+      mOwnsFontMetrics = ownsMetrics;
 
       // max angle between curved label characters (20.0/-20.0 was default in QGIS <= 1.8)
       if ( maxinangle < 20.0 )
@@ -139,6 +145,7 @@ class QgsPalGeometry : public PalGeometry
     bool mIsPinned;
     QFont mDefinedFont;
     QFontMetricsF* mFontMetrics;
+    bool mOwnsFontMetrics;
     qreal mLetterSpacing; // for use with curved labels
     qreal mWordSpacing; // for use with curved labels
     bool mCurvedLabeling; // whether the geometry is to be used for curved labeling placement
@@ -36,12 +36,14 @@
 #include <QByteArray>
 #include <QString>
 #include <QFontMetrics>
+#include <QImage>
 #include <QTime>
 #include <QPainter>
 
 #include "diagram/qgsdiagram.h"
 #include "qgsdiagramrendererv2.h"
 #include "qgsfontutils.h"
+#include "qgslabelplacementcache.h"
 #include "qgslabelsearchtree.h"
 #include "qgsexpression.h"
 #include "qgsdatadefined.h"
@@ -208,6 +210,82 @@ class QgsPalGeometry : public PalGeometry
 
 // -------------
 
+QgsLabelTextCache::QgsLabelTextCache()
+    : mPaths( 1000000 )
+    , mMetricsHits( 0 )
+    , mPathHits( 0 )
+{
+}
+
+QgsLabelTextCache::~QgsLabelTextCache()
+{
+  clear();
+}
+
+QFontMetricsF* QgsLabelTextCache::fontMetrics( const QFont& font )
+{
+  QString key = fontKey( font );
+  QHash<QString, QFontMetricsF*>::const_iterator it = mMetrics.constFind( key );
+  if ( it != mMetrics.constEnd() )
+  {
+    mMetricsHits++;
+    return it.value();
+  }
+
+  QFontMetricsF* fm = new QFontMetricsF( font );
+  mMetrics.insert( key, fm );
+  return fm;
+}
+
+QPainterPath QgsLabelTextCache::textPath( const QFont& font, const QString& text )
+{
+  QPair<QString, QString> key( fontKey( font ), text );
+  QPainterPath* cached = mPaths.object( key );
+  if ( cached )
+  {
+    mPathHits++;
+    return *cached;
+  }
+
+  QPainterPath path;
+  path.addText( 0, 0, font, text );
+  mPaths.insert( key, new QPainterPath( path ), path.elementCount() + 1 );
+  return path;
+}
+
+void QgsLabelTextCache::clear()
+{
+  qDeleteAll( mMetrics );
+  mMetrics.clear();
+  mPaths.clear();
+  mMetricsHits = 0;
+  mPathHits = 0;
+}
+
+QString QgsLabelTextCache::fontKey( const QFont& font )
+{
+  // QFont::key() misses the spacing and capitalization settings
+  QString key = font.key() + QString( ",%1,%2,%3,%4,%5,%6" )
+                .arg( font.letterSpacingType() ).arg( font.letterSpacing() ).arg( font.wordSpacing() )
+                .arg( font.capitalization() ).arg( font.kerning() ).arg( font.styleStrategy() );
+#if QT_VERSION >= 0x040800
+  key += "," + font.styleName();
+#endif
+  return key;
+}
+
+static QPainterPath _labelTextPath( const QgsPalLayerSettings& tmpLyr, const QString& text )
+{
+  if ( tmpLyr.textCache )
+    return tmpLyr.textCache->textPath( tmpLyr.textFont, text );
+
+  QPainterPath path;
+  path.addText( 0, 0, tmpLyr.textFont, text );
+  return path;
+}
+
+// -------------
+
 QgsPalLayerSettings::QgsPalLayerSettings()
     : palLayer( NULL )
     , mCurFeat( 0 )
@@ -434,6 +512,7 @@ QgsPalLayerSettings::QgsPalLayerSettings()
 
   // temp stuff for when drawing label components (don't copy)
   showingShadowRects = false;
+  textCache = NULL;
 }
 
 QgsPalLayerSettings::QgsPalLayerSettings( const QgsPalLayerSettings& s )
@@ -559,6 +638,7 @@ QgsPalLayerSettings::QgsPalLayerSettings( const QgsPalLayerSettings& s )
   ct = NULL;
   extentGeom = NULL;
   expression = NULL;
+  textCache = NULL;
 }
 
 
@@ -1736,7 +1816,8 @@ void QgsPalLayerSettings::registerFeature( QgsVectorLayer* layer,  QgsFeature& f
 
 
   // NOTE: this should come AFTER any option that affects font metrics
-  QFontMetricsF* labelFontMetrics = new QFontMetricsF( labelFont );
+  // metrics of the text cache are shared by the labels, otherwise the label geometry takes ownership
+  QFontMetricsF* labelFontMetrics = textCache ? textCache->fontMetrics( labelFont ) : new QFontMetricsF( labelFont );
   double labelX, labelY; // will receive label size
   calculateLabelSize( labelFontMetrics, labelText, labelX, labelY, mCurFeat );
 
@@ -2152,8 +2233,7 @@ void QgsPalLayerSettings::registerFeature( QgsVectorLayer* layer,  QgsFeature& f
   // TODO: only for placement which needs character info
   pal::Feature* feat = palLayer->getFeature( lbl->strId() );
   // account for any data defined font metrics adjustments
-  feat->setLabelInfo( lbl->info( labelFontMetrics, xform, rasterCompressFactor, maxcharanglein, maxcharangleout ) );
-  delete labelFontMetrics;
+  feat->setLabelInfo( lbl->info( labelFontMetrics, xform, rasterCompressFactor, maxcharanglein, maxcharangleout, !textCache ) );
 
   // TODO: allow layer-wide feature dist in PAL...?
 
@@ -3059,8 +3139,14 @@ QgsPalLabeling::QgsPalLabeling()
   mShowingShadowRects = false;
   mShowingAllLabels = false;
   mShowingPartialsLabels = p.getShowPartial();
+  mUsingTextCache = true;
+  mUsingPlacementCache = true;
+  mThreadCount = p.getThreadCount();
 
   mLabelSearchTree = new QgsLabelSearchTree();
+  mTextCache = new QgsLabelTextCache();
+  mPlacementCache = new QgsLabelPlacementCache();
+  mPlacementCacheHit = false;
 }
 
 QgsPalLabeling::~QgsPalLabeling()
@@ -3072,6 +3158,12 @@ QgsPalLabeling::~QgsPalLabeling()
 
   delete mLabelSearchTree;
   mLabelSearchTree = NULL;
+
+  delete mTextCache;
+  mTextCache = NULL;
+
+  delete mPlacementCache;
+  mPlacementCache = NULL;
 }
 
 bool QgsPalLabeling::willUseLayer( QgsVectorLayer* layer )
@@ -3128,6 +3220,17 @@ int QgsPalLabeling::prepareLayer( QgsVectorLayer* layer, QSet<int>& attrIndices,
     return 0;
   }
 
+  // opacity requested for this rendering only (e.g. by a WMS request)
+  if ( ctx.hasLayerOverride( layer->id() ) )
+  {
+    double opacity = ctx.layerOverride( layer->id() ).opacity;
+    if ( opacity < 1.0 )
+    {
+      lyrTmp.textTransp += ( 100 - lyrTmp.textTransp ) * ( 1.0 - opacity );
+      lyrTmp.bufferTransp += ( 100 - lyrTmp.bufferTransp ) * ( 1.0 - opacity );
+    }
+  }
+
   int fldIndex = -1;
   if ( lyrTmp.isExpression )
   {
@@ -3150,6 +3253,13 @@ int QgsPalLabeling::prepareLayer( QgsVectorLayer* layer, QSet<int>& attrIndices,
 
   // add layer settings to the pallabeling hashtable: <QgsVectorLayer*, QgsPalLayerSettings>
   mActiveLayers.insert( layer, lyrTmp );
+
+  // the labels of the last render are reused, no need to register features
+  // (the settings are kept for the label map tools)
+  if ( mPlacementCacheHit )
+  {
+    return 0;
+  }
   // start using the reference to the layer in hashtable instead of local instance
   QgsPalLayerSettings& lyr = mActiveLayers[layer];
 
@@ -3304,6 +3414,8 @@ int QgsPalLabeling::prepareLayer( QgsVectorLayer* layer, QSet<int>& attrIndices,
   lyr.ptZero = lyr.xform->toMapCoordinates( 0, 0 );
   lyr.ptOne = lyr.xform->toMapCoordinates( 1, 0 );
 
+  lyr.textCache = mUsingTextCache ? mTextCache : NULL;
+
   // rect for clipping
   lyr.extentGeom = QgsGeometry::fromRect( mMapRenderer->extent() );
 
@@ -3455,9 +3567,146 @@ void QgsPalLabeling::init( QgsMapRenderer* mr )
   mPal->setPolyP( mCandPolygon );
 
   mPal->setShowPartial( mShowingPartialsLabels );
+  mPal->setThreadCount( mThreadCount );
 
   clearActiveLayers(); // free any previous QgsDataDefined objects
   mActiveDiagramLayers.clear();
+
+  // metrics and outlines are only shared during one render
+  mTextCache->clear();
+
+  mPlacementKey = mUsingPlacementCache ? placementCacheKey( mr ) : QString();
+  mPlacementCacheHit = mPlacementCache->contains( mPlacementKey );
+  QgsDebugMsgLevel( QString( "LABELING placement cache %1" ).arg( mPlacementCacheHit ? "hit" : "miss" ), 4 );
+}
+
+void QgsPalLabeling::setUsingPlacementCache( bool use )
+{
+  mUsingPlacementCache = use;
+  if ( !use )
+  {
+    mPlacementCache->clear();
+  }
+}
+
+void QgsPalLabeling::clearPlacementCache()
+{
+  mPlacementCache->clear();
+}
+
+QString QgsPalLabeling::placementCacheKey( QgsMapRenderer* mr )
+{
+  // the cached image is composited at 0,0 and covers the whole device
+  QPainter* painter = mr->rendererContext()->painter();
+  if ( !painter || !painter->device() || painter->device()->devType() != QInternal::Image
+       || painter->transform().type() != QTransform::TxNone )
+  {
+    return QString();
+  }
+
+  const QgsRenderContext* ctx = mr->rendererContext();
+  QStringList key;
+
+  // map and output device
+  QgsRectangle extent = mr->extent();
+  key << QString::number( extent.xMinimum(), 'g', 17 ) << QString::number( extent.yMinimum(), 'g', 17 )
+  << QString::number( extent.xMaximum(), 'g', 17 ) << QString::number( extent.yMaximum(), 'g', 17 )
+  << QString::number( mr->scale(), 'g', 17 ) << QString::number( mr->mapUnits() )
+  << ( mr->hasCrsTransformEnabled() ? mr->destinationCrs().toProj4() : QString() )
+  << QString::number( painter->device()->width() ) << QString::number( painter->device()->height() )
+  << QString::number( painter->device()->logicalDpiX() ) << QString::number( painter->device()->logicalDpiY() )
+  << QString::number( painter->renderHints() )
+  << QString::number( ctx->scaleFactor(), 'g', 17 ) << QString::number( ctx->rasterScaleFactor(), 'g', 17 )
+  << QString::number( mr->outputUnits() ) << QString::number( ctx->useAdvancedEffects() );
+
+  // engine
+  key << QString::number( mSearch ) << QString::number( mCandPoint ) << QString::number( mCandLine )
+  << QString::number( mCandPolygon ) << QString::number( mShowingCandidates ) << QString::number( mShowingAllLabels )
+  << QString::number( mShowingShadowRects ) << QString::number( mShowingPartialsLabels );
+
+  // labelled layers in drawing order
+  QStringList::const_iterator li = mr->layerSet().constBegin();
+  for ( ; li != mr->layerSet().constEnd(); ++li )
+  {
+    QgsVectorLayer* vl = qobject_cast<QgsVectorLayer*>( QgsMapLayerRegistry::instance()->mapLayer( *li ) );
+    if ( !vl )
+    {
+      continue;
+    }
+
+    // diagrams are registered with the labeling engine as well
+    if ( vl->diagramRenderer() )
+    {
+      return QString();
+    }
+
+    if ( !willUseLayer( vl ) )
+    {
+      continue;
+    }
+
+    // edits do not always emit a signal before the next render
+    if ( vl->isEditable() )
+    {
+      return QString();
+    }
+
+    // everything a layer override changes for this render only
+    QgsRenderContext::LayerOverride layerOverride = ctx->layerOverride( vl->id() );
+    key << vl->id() << vl->subsetString() << QString::number( layerOverride.opacity, 'g', 17 )
+    << layerOverride.filterExpression << QString::number( layerOverride.overrideSelection );
+    if ( layerOverride.overrideSelection )
+    {
+      QList<QgsFeatureId> selectedIds = layerOverride.selectedFeatureIds.toList();
+      qSort( selectedIds );
+      QStringList selectedIdStrings;
+      for ( int i = 0; i < selectedIds.size(); ++i )
+      {
+        selectedIdStrings << QString::number( selectedIds.at( i ) );
+      }
+      key << selectedIdStrings.join( "," );
+    }
+    QStringList propertyKeys = vl->customPropertyKeys();
+    for ( int i = 0; i < propertyKeys.size(); ++i )
+    {
+      if ( propertyKeys.at( i ).startsWith( "labeling" ) )
+      {
+        key << propertyKeys.at( i ) << vl->customProperty( propertyKeys.at( i ) ).toString();
+      }
+    }
+
+    // changes of features, fields or symbology invalidate the cache
+    mPlacementCache->watchLayer( vl );
+  }
+
+  return key.join( "\n" );
+}
+
+bool QgsPalLabeling::canDrawLabelsSeparately() const
+{
+  if ( !mActiveDiagramLayers.isEmpty() )
+  {
+    return false;
+  }
+
+  // blending with the map below the labels is lost when compositing
+  QHash<QgsVectorLayer*, QgsPalLayerSettings>::const_iterator lit = mActiveLayers.constBegin();
+  for ( ; lit != mActiveLayers.constEnd(); ++lit )
+  {
+    const QgsPalLayerSettings& lyr = lit.value();
+    if ( lyr.blendMode != QPainter::CompositionMode_SourceOver
+         || ( lyr.bufferDraw && lyr.bufferBlendMode != QPainter::CompositionMode_SourceOver )
+         || ( lyr.shapeDraw && lyr.shapeBlendMode != QPainter::CompositionMode_SourceOver )
+         || ( lyr.shadowDraw && lyr.shadowBlendMode != QPainter::CompositionMode_SourceOver )
+         || lyr.dataDefinedIsActive( QgsPalLayerSettings::FontBlendMode )
+         || lyr.dataDefinedIsActive( QgsPalLayerSettings::BufferBlendMode )
+         || lyr.dataDefinedIsActive( QgsPalLayerSettings::ShapeBlendMode )
+         || lyr.dataDefinedIsActive( QgsPalLayerSettings::ShadowBlendMode ) )
+    {
+      return false;
+    }
+  }
+  return true;
 }
 
 void QgsPalLabeling::exit()
@@ -3796,6 +4045,57 @@ void QgsPalLabeling::drawLabeling( QgsRenderContext& context )
 {
   Q_ASSERT( mMapRenderer != NULL );
   QPainter* painter = context.painter();
+
+  if ( mPlacementCacheHit )
+  {
+    // nothing has changed since the last render, the search tree and candidates are still valid
+    painter->drawImage( 0, 0, mPlacementCache->image() );
+    return;
+  }
+
+  // the search tree is rebuilt, the cached labels do not match it any more
+  mPlacementCache->clear();
+
+  // the key is only set for renders into an image
+  if ( mPlacementKey.isEmpty() || !canDrawLabelsSeparately() )
+  {
+    placeAndDrawLabels( context );
+    return;
+  }
+
+  const QImage* deviceImage = static_cast<const QImage*>( painter->device() );
+  QImage labelImage( deviceImage->width(), deviceImage->height(), QImage::Format_ARGB32_Premultiplied );
+  if ( labelImage.isNull() )
+  {
+    QgsDebugMsg( "insufficient memory for label image" );
+    placeAndDrawLabels( context );
+    return;
+  }
+
+  // draw the labels into their own image (same dpi for font sizes) and keep it for the next render
+  labelImage.setDotsPerMeterX( deviceImage->dotsPerMeterX() );
+  labelImage.setDotsPerMeterY( deviceImage->dotsPerMeterY() );
+  labelImage.fill( 0 );
+
+  QPainter labelPainter( &labelImage );
+  labelPainter.setRenderHints( painter->renderHints() );
+  context.setPainter( &labelPainter );
+  placeAndDrawLabels( context );
+  context.setPainter( painter );
+  labelPainter.end();
+
+  painter->drawImage( 0, 0, labelImage );
+
+  // labels of a stopped render are incomplete
+  if ( !context.renderingStopped() )
+  {
+    mPlacementCache->setImage( mPlacementKey, labelImage );
+  }
+}
+
+void QgsPalLabeling::placeAndDrawLabels( QgsRenderContext& context )
+{
+  QPainter* painter = context.painter();
   QgsRectangle extent = context.extent();
 
   if ( mLabelSearchTree )
@@ -3850,6 +4150,12 @@ void QgsPalLabeling::drawLabeling( QgsRenderContext& context )
   labels = mPal->solveProblem( problem, mShowingAllLabels );
 
   QgsDebugMsgLevel( QString( "LABELING work:  %1 ms ... labels# %2" ).arg( t.elapsed() ).arg( labels->size() ), 4 );
+  if ( problem )
+  {
+    QgsDebugMsgLevel( QString( "LABELING candidates: %1 ms, problem: %2 ms, search: %3 ms, independent parts# %4" )
+                      .arg( problem->getCandidatesTime() ).arg( problem->getExtractTime() )
+                      .arg( problem->getSearchTime() ).arg( problem->getNumComponents() ), 4 );
+  }
   t.restart();
 
   painter->setRenderHint( QPainter::Antialiasing );
@@ -3937,6 +4243,7 @@ void QgsPalLabeling::drawLabeling( QgsRenderContext& context )
 
 
     tmpLyr.showingShadowRects = mShowingShadowRects;
+    tmpLyr.textCache = lyr.textCache;
 
     // Render the components of a label in reverse order
     //   (backgrounds -> text)
@@ -3980,6 +4287,7 @@ void QgsPalLabeling::drawLabeling( QgsRenderContext& context )
   painter->setCompositionMode( QPainter::CompositionMode_SourceOver );
 
   QgsDebugMsgLevel( QString( "LABELING draw:  %1 ms" ).arg( t.elapsed() ), 4 );
+  QgsDebugMsgLevel( QString( "LABELING text cache: %1 metrics hits, %2 outline hits" ).arg( mTextCache->metricsHits() ).arg( mTextCache->pathHits() ), 4 );
 
   delete problem;
   delete labels;
@@ -4255,8 +4563,7 @@ void QgsPalLabeling::drawLabel( pal::LabelPosition* label, QgsRenderContext& con
       else
       {
         // draw label's text, QPainterPath method
-        QPainterPath path;
-        path.addText( 0, 0, tmpLyr.textFont, component.text() );
+        QPainterPath path = _labelTextPath( tmpLyr, component.text() );
 
         // store text's drawing in QPicture for drop shadow call
         QPicture textPict;
@@ -4313,8 +4620,7 @@ void QgsPalLabeling::drawLabelBuffer( QgsRenderContext& context,
   double penSize = tmpLyr.scaleToPixelContext( tmpLyr.bufferSize, context,
                    ( tmpLyr.bufferSizeInMapUnits ? QgsPalLayerSettings::MapUnits : QgsPalLayerSettings::MM ), true );
 
-  QPainterPath path;
-  path.addText( 0, 0, tmpLyr.textFont, component.text() );
+  QPainterPath path = _labelTextPath( tmpLyr, component.text() );
   QPen pen( tmpLyr.bufferColor );
   pen.setWidthF( penSize );
   pen.setJoinStyle( tmpLyr.bufferJoinStyle );
@@ -4859,5 +5165,8 @@ QgsLabelingEngineInterface* QgsPalLabeling::clone()
   lbl->mShowingCandidates = mShowingCandidates;
   lbl->mShowingShadowRects = mShowingShadowRects;
   lbl->mShowingPartialsLabels = mShowingPartialsLabels;
+  lbl->mUsingTextCache = mUsingTextCache;
+  lbl->mUsingPlacementCache = mUsingPlacementCache;
+  lbl->mThreadCount = mThreadCount;
   return lbl;
 }
@@ -31,11 +31,14 @@ class QgsCoordinateTransform;
 class QgsLabelSearchTree;
 
 #include <QString>
+#include <QCache>
 #include <QFont>
 #include <QFontDatabase>
 #include <QColor>
 #include <QHash>
 #include <QList>
+#include <QPainterPath>
+#include <QPair>
 #include <QRectF>
 
 namespace pal
@@ -57,6 +60,8 @@ class QgsFeature;
 
 class QgsPalGeometry;
 class QgsVectorLayer;
+class QgsLabelTextCache;
+class QgsLabelPlacementCache;
 
 class CORE_EXPORT QgsPalLayerSettings
 {
@@ -506,6 +511,8 @@ class CORE_EXPORT QgsPalLayerSettings
 
     bool showingShadowRects; // whether to show debug rectangles for drop shadows
 
+    QgsLabelTextCache* textCache; // font metrics and text outlines shared during a render, may be null
+
   private:
     void readDataDefinedPropertyMap( QgsVectorLayer* layer,
                                      QMap < QgsPalLayerSettings::DataDefinedProperties,
@@ -650,6 +657,42 @@ class CORE_EXPORT QgsLabelComponent
     double mDpiRatio;
 };
 
+/** \ingroup core
+  * Font metrics and text outlines shared by all labels of a render.
+  * Labels of the same layer use few distinct fonts and often repeat the same
+  * text (e.g. street names, house numbers), which is then shaped only once.
+  * @note not available in python bindings
+  * @note added in 2.1
+  */
+class CORE_EXPORT QgsLabelTextCache
+{
+  public:
+    QgsLabelTextCache();
+    ~QgsLabelTextCache();
+
+    /** Metrics for the font, owned by the cache and valid until clear() */
+    QFontMetricsF* fontMetrics( const QFont& font );
+
+    /** Outline of the text drawn with the font at 0,0 (as QPainterPath::addText() creates it) */
+    QPainterPath textPath( const QFont& font, const QString& text );
+
+    /** Removes all metrics and outlines */
+    void clear();
+
+    int metricsHits() const { return mMetricsHits; }
+    int pathHits() const { return mPathHits; }
+
+    /** Key identifying all font properties which influence metrics and outlines */
+    static QString fontKey( const QFont& font );
+
+  private:
+    QHash<QString, QFontMetricsF*> mMetrics;
+    // cost is the number of path elements
+    QCache< QPair<QString, QString>, QPainterPath > mPaths;
+    int mMetricsHits;
+    int mPathHits;
+};
+
 class CORE_EXPORT QgsPalLabeling : public QgsLabelingEngineInterface
 {
   public:
@@ -688,6 +731,29 @@ class CORE_EXPORT QgsPalLabeling : public QgsLabelingEngineInterface
     bool isShowingPartialsLabels() const { return mShowingPartialsLabels; }
     void setShowingPartialsLabels( bool showing ) { mShowingPartialsLabels = showing; }
 
+    //! whether font metrics and text outlines are shared among the labels of a render
+    //! @note added in 2.1
+    bool isUsingTextCache() const { return mUsingTextCache; }
+    void setUsingTextCache( bool use ) { mUsingTextCache = use; }
+
+    //! number of threads generating the label candidates and solving independent parts of the placement,
+    //! below 2 the labels are placed in the calling thread only
+    //! @note added in 2.1
+    int threadCount() const { return mThreadCount; }
+    void setThreadCount( int count ) { mThreadCount = count; }
+
+    //! whether the labels of a render are reused by the next render with the same extent, scale,
+    //! CRS and labelled layers. Only used for renders into a QImage
+    //! @note added in 2.1
+    bool isUsingPlacementCache() const { return mUsingPlacementCache; }
+    void setUsingPlacementCache( bool use );
+    //! forget the labels of the last render, e.g. after the data of layers was reloaded
+    //! @note added in 2.1
+    void clearPlacementCache();
+    //! whether the current (or last) render reuses the labels of the previous one
+    //! @note added in 2.1
+    bool isPlacementCacheHit() const { return mPlacementCacheHit; }
+
     // implemented methods from labeling engine interface
 
     //! called when we're going to start with rendering
@@ -746,6 +812,16 @@ class CORE_EXPORT QgsPalLabeling : public QgsLabelingEngineInterface
     void setStoredWithProject( bool store ) { mSavedWithProject = store; }
 
   protected:
+    // solve the labeling problem and draw the labels with the painter of the context
+    void placeAndDrawLabels( QgsRenderContext& context );
+
+    // key of the placement cache for a render, empty if the labels of the render can not be cached
+    // (starts watching the labelled layers for changes)
+    QString placementCacheKey( QgsMapRenderer* mr );
+
+    // whether the labels of the active layers can be drawn into a separate image and composited later
+    bool canDrawLabelsSeparately() const;
+
     // update temporary QgsPalLayerSettings with any data defined text style values
     void dataDefinedTextStyle( QgsPalLayerSettings& tmpLyr,
                                const QMap< QgsPalLayerSettings::DataDefinedProperties, QVariant >& ddValues );
@@ -785,8 +861,16 @@ class CORE_EXPORT QgsPalLabeling : public QgsLabelingEngineInterface
     bool mSavedWithProject; // whether engine settings have been read from project file
     bool mShowingShadowRects; // whether to show debugging rectangles for drop shadows
     bool mShowingPartialsLabels; // whether to avoid partials labels or not
+    bool mUsingTextCache; // whether to share font metrics and text outlines among labels
+    bool mUsingPlacementCache; // whether to reuse the labels of the last render
+    int mThreadCount; // threads used by PAL
 
     QgsLabelSearchTree* mLabelSearchTree;
+    QgsLabelTextCache* mTextCache;
+
+    QgsLabelPlacementCache* mPlacementCache;
+    QString mPlacementKey; // key of the current render, empty if it is not cached
+    bool mPlacementCacheHit; // whether the current render reuses the cached labels
 };
 
 #endif // QGSPALLABELING_H
@@ -24,7 +24,7 @@ QgsRenderContext::QgsRenderContext()
     mDrawEditingInformation( true ),
     mForceVectorOutput( false ),
     mUseAdvancedEffects( true ),
-    mRenderingStopped( false ),
+    mRenderingStopped( new QAtomicInt( 0 ) ),
     mScaleFactor( 1.0 ),
     mRasterScaleFactor( 1.0 ),
     mRendererScale( 1.0 ),
@@ -34,10 +34,41 @@ QgsRenderContext::QgsRenderContext()
 
 }
 
+QgsRenderContext::QgsRenderContext( const QgsRenderContext& other )
+    : mRenderingStopped( new QAtomicInt( 0 ) )
+{
+  *this = other;
+}
+
 QgsRenderContext::~QgsRenderContext()
 {
 }
 
+QgsRenderContext& QgsRenderContext::operator=( const QgsRenderContext& other )
+{
+  if ( &other == this )
+    return *this;
+
+  mPainter = other.mPainter;
+  mCoordTransform = other.mCoordTransform;
+  mDrawEditingInformation = other.mDrawEditingInformation;
+  mExtent = other.mExtent;
+  mForceVectorOutput = other.mForceVectorOutput;
+  mUseAdvancedEffects = other.mUseAdvancedEffects;
+  mMapToPixel = other.mMapToPixel;
+  // the own flag is never shared with the copied context, only its state is taken
+  *mRenderingStopped = *other.mRenderingStopped;
+  mRenderingStoppedSource = other.mRenderingStoppedSource;
+  mScaleFactor = other.mScaleFactor;
+  mRasterScaleFactor = other.mRasterScaleFactor;
+  mRendererScale = other.mRendererScale;
+  mLabelingEngine = other.mLabelingEngine;
+  mSelectionColor = other.mSelectionColor;
+  mUseRenderingOptimization = other.mUseRenderingOptimization;
+  mLayerOverrides = other.mLayerOverrides;
+  return *this;
+}
+
 void QgsRenderContext::setCoordinateTransform( const QgsCoordinateTransform* t )
 {
   mCoordTransform = t;
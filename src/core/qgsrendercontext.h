@@ -18,9 +18,13 @@
 #ifndef QGSRENDERCONTEXT_H
 #define QGSRENDERCONTEXT_H
 
+#include <QAtomicInt>
 #include <QColor>
+#include <QMap>
+#include <QSharedPointer>
 
 #include "qgscoordinatetransform.h"
+#include "qgsfeature.h"
 #include "qgsmaptopixel.h"
 #include "qgsrectangle.h"
 
@@ -38,8 +42,33 @@ class CORE_EXPORT QgsRenderContext
 {
   public:
     QgsRenderContext();
+    /**A copy has its own stop flag with the state of the other one, it follows the same source
+      @note added in 2.1*/
+    QgsRenderContext( const QgsRenderContext& other );
     ~QgsRenderContext();
 
+    QgsRenderContext& operator=( const QgsRenderContext& other );
+
+    /**Rendering state of a layer which only applies to this rendering operation
+      (e.g. the FILTER, SELECTION and OPACITIES of a WMS request).
+      The layer itself is not modified, so the same layer may be rendered with
+      different overrides at the same time.
+      @note added in 2.2*/
+    struct LayerOverride
+    {
+      LayerOverride() : opacity( 1.0 ), overrideSelection( false ) {}
+
+      /**Filter features have to match to be rendered, in the syntax of the subset string of
+        the provider (empty: no filter). The provider applies it to its query. For providers
+        without subset strings it is evaluated as an expression.*/
+      QString filterExpression;
+      /**Opacity between 0 and 1, applied to symbols, labels and rasters*/
+      double opacity;
+      /**If true, selectedFeatureIds replaces the selection of the layer*/
+      bool overrideSelection;
+      QgsFeatureIds selectedFeatureIds;
+    };
+
     //getters
 
     QPainter* painter() {return mPainter;}
@@ -55,7 +84,7 @@ class CORE_EXPORT QgsRenderContext
 
     double rasterScaleFactor() const {return mRasterScaleFactor;}
 
-    bool renderingStopped() const {return mRenderingStopped;}
+    bool renderingStopped() const {return *mRenderingStopped != 0 || ( mRenderingStoppedSource && *mRenderingStoppedSource != 0 );}
 
     bool forceVectorOutput() const {return mForceVectorOutput;}
 
@@ -83,7 +112,13 @@ class CORE_EXPORT QgsRenderContext
     void setMapToPixel( const QgsMapToPixel& mtp ) {mMapToPixel = mtp;}
     void setExtent( const QgsRectangle& extent ) {mExtent = extent;}
     void setDrawEditingInformation( bool b ) {mDrawEditingInformation = b;}
-    void setRenderingStopped( bool stopped ) {mRenderingStopped = stopped;}
+    void setRenderingStopped( bool stopped ) {*mRenderingStopped = stopped;}
+    /**Makes renderingStopped() also return true once the other context is stopped. Used for copies of
+      a context which are rendered in worker threads. The flag is shared, the other context may be
+      deleted first (0: unset)
+      @note added in 2.1
+      @note not available in python bindings*/
+    void setRenderingStoppedSource( const QgsRenderContext* context ) {mRenderingStoppedSource = context ? context->mRenderingStopped : QSharedPointer<QAtomicInt>();}
     void setScaleFactor( double factor ) {mScaleFactor = factor;}
     void setRasterScaleFactor( double factor ) {mRasterScaleFactor = factor;}
     void setRendererScale( double scale ) {mRendererScale = scale;}
@@ -99,6 +134,21 @@ class CORE_EXPORT QgsRenderContext
     bool useRenderingOptimization() const { return mUseRenderingOptimization; }
     void setUseRenderingOptimization( bool enabled ) { mUseRenderingOptimization = enabled; }
 
+    /**Returns true if there is an override for the layer
+      @note added in 2.2*/
+    bool hasLayerOverride( const QString& layerId ) const { return mLayerOverrides.contains( layerId ); }
+    /**Returns the override of the layer (a default constructed one if there is none)
+      @note added in 2.2*/
+    LayerOverride layerOverride( const QString& layerId ) const { return mLayerOverrides.value( layerId ); }
+    //! @note added in 2.2
+    void setLayerOverride( const QString& layerId, const LayerOverride& layerOverride ) { mLayerOverrides.insert( layerId, layerOverride ); }
+    //! @note added in 2.2
+    const QMap<QString, LayerOverride>& layerOverrides() const { return mLayerOverrides; }
+    //! @note added in 2.2
+    void setLayerOverrides( const QMap<QString, LayerOverride>& overrides ) { mLayerOverrides = overrides; }
+    //! @note added in 2.2
+    void clearLayerOverrides() { mLayerOverrides.clear(); }
+
   private:
 
     /**Painter for rendering operations*/
@@ -120,8 +170,11 @@ class CORE_EXPORT QgsRenderContext
 
     QgsMapToPixel mMapToPixel;
 
-    /**True if the rendering has been canceled*/
-    bool mRenderingStopped;
+    /**Not 0 if the rendering has been canceled (read from other threads). Only shared with the contexts following this one*/
+    QSharedPointer<QAtomicInt> mRenderingStopped;
+
+    /**Flag of the context this context follows (null if unset)*/
+    QSharedPointer<QAtomicInt> mRenderingStoppedSource;
 
     /**Factor to scale line widths and point marker sizes*/
     double mScaleFactor;
@@ -140,6 +193,9 @@ class CORE_EXPORT QgsRenderContext
 
     /**True if the rendering optimization (geometry simplification) can be executed*/
     bool mUseRenderingOptimization;
+
+    /**Request specific layer state, key is the layer id*/
+    QMap<QString, LayerOverride> mLayerOverrides;
 };
 
 #endif
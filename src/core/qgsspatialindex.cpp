@@ -17,13 +17,28 @@
 
 #include "qgsgeometry.h"
 #include "qgsfeature.h"
+#include "qgsfeatureiterator.h"
 #include "qgsrectangle.h"
 #include "qgslogger.h"
 
 #include "SpatialIndex.h"
 
+#include <QByteArray>
+#include <QDataStream>
+#include <QFile>
+#include <QHash>
+#include <QReadWriteLock>
+#include <QPair>
+
+#include <limits>
+
 using namespace SpatialIndex;
 
+// header of saved indexes, stored in the first page of the file
+static const quint32 SAVED_INDEX_MAGIC = 0x51475349; // "QGSI"
+static const quint32 SAVED_INDEX_VERSION = 1;
+static const uint32_t SAVED_INDEX_PAGE_SIZE = 4096;
+
 
 // custom visitor that adds found features to list
 class QgisVisitor : public SpatialIndex::IVisitor
@@ -47,29 +62,268 @@ class QgisVisitor : public SpatialIndex::IVisitor
     QList<QgsFeatureId>& mList;
 };
 
+typedef QPair<SpatialIndex::id_type, Region> QgsSpatialIndexEntry;
 
-QgsSpatialIndex::QgsSpatialIndex()
+// visitor that collects identifiers and bounding boxes of all entries
+class QgsSpatialIndexCopyVisitor : public SpatialIndex::IVisitor
 {
-  // for now only memory manager
-  mStorageManager = StorageManager::createNewMemoryStorageManager();
+  public:
+    QgsSpatialIndexCopyVisitor( QList<QgsSpatialIndexEntry>& entries )
+        : mEntries( entries ) {}
+
+    void visitNode( const INode& n )
+    { Q_UNUSED( n ); }
+
+    void visitData( const IData& d )
+    {
+      IShape* shape;
+      d.getShape( &shape );
+      Region r;
+      shape->getMBR( r );
+      delete shape;
+      mEntries.append( qMakePair( d.getIdentifier(), r ) );
+    }
+
+    void visitData( std::vector<const IData*>& v )
+    { Q_UNUSED( v ); }
+
+  private:
+    QList<QgsSpatialIndexEntry>& mEntries;
+};
+
+
+// returns identifiers and bounding boxes of all entries of the tree
+static QList<QgsSpatialIndexEntry> indexEntries( ISpatialIndex* rTree )
+{
+  QList<QgsSpatialIndexEntry> entries;
+  QgsSpatialIndexCopyVisitor visitor( entries );
+
+  double low[2], high[2];
+  low[0] = low[1] = -std::numeric_limits<double>::max();
+  high[0] = high[1] = std::numeric_limits<double>::max();
+  rTree->intersectsWithQuery( Region( low, high, 2 ), visitor );
+
+  return entries;
+}
 
-  // create buffer
 
-  unsigned int capacity = 10;
-  bool writeThrough = false;
-  mStorage = StorageManager::createNewRandomEvictionsBuffer( *mStorageManager, capacity, writeThrough );
+// comparator for nearest neighbor queries which keeps the distances of the data
+class QgsNearestNeighborComparator : public INearestNeighborComparator
+{
+  public:
+    QgsNearestNeighborComparator( const QgsPoint& point, QgsSpatialIndex::ExactDistance* exactDistance )
+        : mPoint( point ), mExactDistance( exactDistance ) {}
 
+    double getMinimumDistance( const IShape& query, const IShape& entry )
+    {
+      return query.getMinimumDistance( entry );
+    }
+
+    double getMinimumDistance( const IShape& query, const IData& data )
+    {
+      double distance;
+      if ( mExactDistance )
+      {
+        distance = mExactDistance->distance( data.getIdentifier(), mPoint );
+      }
+      else
+      {
+        IShape* shape;
+        data.getShape( &shape );
+        distance = query.getMinimumDistance( *shape );
+        delete shape;
+      }
+      mDistances.insert( data.getIdentifier(), distance );
+      return distance;
+    }
+
+    double distance( QgsFeatureId id ) const { return mDistances.value( id ); }
+
+  private:
+    QgsPoint mPoint;
+    QgsSpatialIndex::ExactDistance* mExactDistance;
+    QHash<QgsFeatureId, double> mDistances;
+};
+
+
+// data stream for bulk loading of entries collected by the copy visitor
+class QgsSpatialIndexEntryDataStream : public IDataStream
+{
+  public:
+    QgsSpatialIndexEntryDataStream( const QList<QgsSpatialIndexEntry>& entries )
+        : mEntries( entries ), mPos( 0 ) {}
+
+    IData* getNext()
+    {
+      Region r = mEntries[mPos].second;
+      return new RTree::Data( 0, 0, r, mEntries[mPos++].first );
+    }
+
+    bool hasNext() { return mPos < mEntries.count(); }
+
+    uint32_t size() { return mEntries.count(); }
+
+    void rewind() { mPos = 0; }
+
+  private:
+    const QList<QgsSpatialIndexEntry>& mEntries;
+    int mPos;
+};
+
+
+// data stream for bulk loading of features from an iterator
+class QgsFeatureIteratorDataStream : public IDataStream
+{
+  public:
+    QgsFeatureIteratorDataStream( const QgsFeatureIterator& fi )
+        : mFi( fi ), mNextData( 0 )
+    {
+      readNextEntry();
+    }
+
+    ~QgsFeatureIteratorDataStream()
+    {
+      delete mNextData;
+    }
+
+    // the bulk loader takes ownership of the returned data
+    IData* getNext()
+    {
+      RTree::Data* ret = mNextData;
+      mNextData = 0;
+      readNextEntry();
+      return ret;
+    }
+
+    bool hasNext() { return mNextData != 0; }
+
+    // not used by the bulk loader, the number of features is not known in advance
+    uint32_t size() { Q_ASSERT( 0 && "not available" ); return 0; }
+
+    void rewind() { Q_ASSERT( 0 && "not available" ); }
+
+  protected:
+    void readNextEntry()
+    {
+      QgsFeature f;
+      Region r;
+      QgsFeatureId id;
+      while ( mFi.nextFeature( f ) )
+      {
+        if ( QgsSpatialIndex::featureInfo( f, r, id ) )
+        {
+          mNextData = new RTree::Data( 0, 0, r, FID_TO_NUMBER( id ) );
+          return;
+        }
+      }
+    }
+
+  private:
+    QgsFeatureIterator mFi;
+    RTree::Data* mNextData;
+};
+
+
+// creates a new R-tree in the storage, bulk loaded with the data of the stream if there is any
+static ISpatialIndex* createRTree( IStorageManager& storage, IDataStream* inputStream, SpatialIndex::id_type& indexId )
+{
   // R-Tree parameters
-  double fillFactor = 0.7;
-  unsigned long indexCapacity = 10;
-  unsigned long leafCapacity = 10;
-  unsigned long dimension = 2;
-  RTree::RTreeVariant variant = RTree::RV_RSTAR;
+  Tools::PropertySet ps;
+  Tools::Variant var;
+
+  var.m_varType = Tools::VT_DOUBLE;
+  var.m_val.dblVal = 0.7;
+  ps.setProperty( "FillFactor", var );
+
+  var.m_varType = Tools::VT_ULONG;
+  var.m_val.ulVal = 10;
+  ps.setProperty( "IndexCapacity", var );
+  ps.setProperty( "LeafCapacity", var );
+  var.m_val.ulVal = 2;
+  ps.setProperty( "Dimension", var );
+
+  var.m_varType = Tools::VT_LONG;
+  var.m_val.lVal = RTree::RV_RSTAR;
+  ps.setProperty( "TreeVariant", var );
+
+  // no node pools: the nodes read by a query are not kept with the tree
+  var.m_varType = Tools::VT_ULONG;
+  var.m_val.ulVal = 0;
+  ps.setProperty( "IndexPoolCapacity", var );
+  ps.setProperty( "LeafPoolCapacity", var );
+  ps.setProperty( "RegionPoolCapacity", var );
+  ps.setProperty( "PointPoolCapacity", var );
+
+  // the bulk loader refuses empty streams
+  if ( inputStream && inputStream->hasNext() )
+    return RTree::createAndBulkLoadNewRTree( RTree::BLM_STR, *inputStream, storage, ps, indexId );
+
+  // the tree stores its identifier in the properties
+  ISpatialIndex* rTree = RTree::returnRTree( storage, ps );
+  indexId = ps.getProperty( "IndexIdentifier" ).m_val.llVal;
+  return rTree;
+}
+
+
+QgsSpatialIndex::QgsSpatialIndex()
+    : mLock( QReadWriteLock::Recursive )
+{
+  initTree();
+}
+
+QgsSpatialIndex::QgsSpatialIndex( const QgsFeatureIterator& fi )
+    : mLock( QReadWriteLock::Recursive )
+{
+  QgsFeatureIteratorDataStream stream( fi );
+  initTree( &stream );
+}
+
+QgsSpatialIndex::QgsSpatialIndex( const QgsSpatialIndex& other )
+    : mLock( QReadWriteLock::Recursive )
+{
+  QList<QgsSpatialIndexEntry> entries;
+  {
+    QWriteLocker locker( &other.mLock );
+    entries = indexEntries( other.mRTree );
+  }
+
+  QgsSpatialIndexEntryDataStream stream( entries );
+  initTree( &stream );
+}
+
+QgsSpatialIndex::QgsSpatialIndex( IStorageManager* storageManager, StorageManager::IBuffer* storage, ISpatialIndex* rTree )
+    : mStorageManager( storageManager )
+    , mStorage( storage )
+    , mRTree( rTree )
+    , mLock( QReadWriteLock::Recursive )
+{
+}
+
+QgsSpatialIndex& QgsSpatialIndex::operator=( const QgsSpatialIndex& other )
+{
+  if ( this == &other )
+    return *this;
+
+  // build the snapshot without holding both locks
+  QgsSpatialIndex copy( other );
+
+  QWriteLocker locker( &mLock );
+  qSwap( mStorageManager, copy.mStorageManager );
+  qSwap( mStorage, copy.mStorage );
+  qSwap( mRTree, copy.mRTree );
+  return *this;
+}
+
+void QgsSpatialIndex::initTree( IDataStream* inputStream )
+{
+  // for now only memory manager. No buffer in front of it: the memory manager is as fast
+  // and, unlike the buffer, not modified when pages are read
+  mStorageManager = StorageManager::createNewMemoryStorageManager();
+  mStorage = 0;
 
   // create R-tree
   SpatialIndex::id_type indexId;
-  mRTree = RTree::createNewRTree( *mStorage, fillFactor, indexCapacity,
-                                  leafCapacity, dimension, variant, indexId );
+  mRTree = createRTree( *mStorageManager, inputStream, indexId );
 }
 
 QgsSpatialIndex:: ~QgsSpatialIndex()
@@ -107,6 +361,8 @@ bool QgsSpatialIndex::insertFeature( QgsFeature& f )
   if ( !featureInfo( f, r, id ) )
     return false;
 
+  QWriteLocker locker( &mLock );
+
   // TODO: handle possible exceptions correctly
   try
   {
@@ -138,6 +394,8 @@ bool QgsSpatialIndex::deleteFeature( QgsFeature& f )
   if ( !featureInfo( f, r, id ) )
     return false;
 
+  QWriteLocker locker( &mLock );
+
   // TODO: handle exceptions
   return mRTree->deleteData( r, FID_TO_NUMBER( id ) );
 }
@@ -149,6 +407,7 @@ QList<QgsFeatureId> QgsSpatialIndex::intersects( QgsRectangle rect )
 
   Region r = rectToRegion( rect );
 
+  QWriteLocker locker( &mLock );
   mRTree->intersectsWithQuery( r, visitor );
 
   return list;
@@ -164,7 +423,151 @@ QList<QgsFeatureId> QgsSpatialIndex::nearestNeighbor( QgsPoint point, int neighb
   pt[1] = point.y();
   Point p( pt, 2 );
 
+  QWriteLocker locker( &mLock );
   mRTree->nearestNeighborQuery( neighbors, p, visitor );
 
   return list;
 }
+
+QList< QPair<QgsFeatureId, double> > QgsSpatialIndex::nearestNeighborDistances( QgsPoint point, int neighbors, ExactDistance* exactDistance )
+{
+  QList<QgsFeatureId> ids;
+  QgisVisitor visitor( ids );
+  QgsNearestNeighborComparator comparator( point, exactDistance );
+
+  double pt[2];
+  pt[0] = point.x();
+  pt[1] = point.y();
+  Point p( pt, 2 );
+
+  {
+    QWriteLocker locker( &mLock );
+    mRTree->nearestNeighborQuery( neighbors, p, visitor, comparator );
+  }
+
+  // the visitor gets the data in the order of the distance
+  QList< QPair<QgsFeatureId, double> > list;
+  foreach ( QgsFeatureId id, ids )
+  {
+    list << qMakePair( id, comparator.distance( id ) );
+  }
+  return list;
+}
+
+static QByteArray savedIndexHeader( SpatialIndex::id_type indexId )
+{
+  QByteArray header;
+  QDataStream ds( &header, QIODevice::WriteOnly );
+  ds << SAVED_INDEX_MAGIC << SAVED_INDEX_VERSION << ( qint64 ) indexId;
+  return header;
+}
+
+bool QgsSpatialIndex::save( const QString& fileName ) const
+{
+  // collect all entries and pack them again - the saved tree is better
+  // balanced than the one built by inserting features one by one
+  QList<QgsSpatialIndexEntry> entries;
+  {
+    QWriteLocker locker( &mLock );
+    entries = indexEntries( mRTree );
+  }
+
+  IStorageManager* storageManager = 0;
+  ISpatialIndex* rTree = 0;
+  try
+  {
+    std::string baseName = QFile::encodeName( fileName ).constData();
+    storageManager = StorageManager::createNewDiskStorageManager( baseName, SAVED_INDEX_PAGE_SIZE );
+
+    // the header goes to the first page of the new file, it is completed
+    // with the identifier of the tree afterwards
+    QByteArray header = savedIndexHeader( 0 );
+    SpatialIndex::id_type headerPage = StorageManager::NewPage;
+    storageManager->storeByteArray( headerPage, header.size(), ( const byte* ) header.constData() );
+    Q_ASSERT( headerPage == 0 );
+
+    QgsSpatialIndexEntryDataStream stream( entries );
+    SpatialIndex::id_type indexId;
+    rTree = createRTree( *storageManager, &stream, indexId );
+
+    header = savedIndexHeader( indexId );
+    storageManager->storeByteArray( headerPage, header.size(), ( const byte* ) header.constData() );
+
+    // flush everything to disk
+    delete rTree;
+    delete storageManager;
+    return true;
+  }
+  catch ( Tools::Exception &e )
+  {
+    Q_UNUSED( e );
+    QgsDebugMsg( QString( "Tools::Exception caught: %1" ).arg( e.what().c_str() ) );
+  }
+  catch ( const std::exception &e )
+  {
+    Q_UNUSED( e );
+    QgsDebugMsg( QString( "std::exception caught: %1" ).arg( e.what() ) );
+  }
+  catch ( ... )
+  {
+    QgsDebugMsg( "unknown spatial index exception caught" );
+  }
+
+  delete rTree;
+  delete storageManager;
+  return false;
+}
+
+QgsSpatialIndex* QgsSpatialIndex::load( const QString& fileName )
+{
+  if ( !QFile::exists( fileName + ".idx" ) || !QFile::exists( fileName + ".dat" ) )
+    return 0;
+
+  IStorageManager* storageManager = 0;
+  StorageManager::IBuffer* storage = 0;
+  try
+  {
+    std::string baseName = QFile::encodeName( fileName ).constData();
+    storageManager = StorageManager::loadDiskStorageManager( baseName );
+
+    byte* data = 0;
+    uint32_t length = 0;
+    storageManager->loadByteArray( 0, length, &data );
+    QByteArray header(( const char* ) data, length );
+    delete [] data;
+
+    quint32 magic, version;
+    qint64 indexId;
+    QDataStream ds( header );
+    ds >> magic >> version >> indexId;
+    if ( ds.status() != QDataStream::Ok || magic != SAVED_INDEX_MAGIC || version != SAVED_INDEX_VERSION )
+    {
+      QgsDebugMsg( QString( "%1 is not a saved spatial index" ).arg( fileName ) );
+      delete storageManager;
+      return 0;
+    }
+
+    // same buffer as for the indexes built in memory
+    storage = StorageManager::createNewRandomEvictionsBuffer( *storageManager, 10, false );
+    ISpatialIndex* rTree = RTree::loadRTree( *storage, indexId );
+    return new QgsSpatialIndex( storageManager, storage, rTree );
+  }
+  catch ( Tools::Exception &e )
+  {
+    Q_UNUSED( e );
+    QgsDebugMsg( QString( "Tools::Exception caught: %1" ).arg( e.what().c_str() ) );
+  }
+  catch ( const std::exception &e )
+  {
+    Q_UNUSED( e );
+    QgsDebugMsg( QString( "std::exception caught: %1" ).arg( e.what() ) );
+  }
+  catch ( ... )
+  {
+    QgsDebugMsg( "unknown spatial index exception caught" );
+  }
+
+  delete storage;
+  delete storageManager;
+  return 0;
+}
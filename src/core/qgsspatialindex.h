@@ -23,6 +23,7 @@ namespace SpatialIndex
   class ISpatialIndex;
   class Region;
   class Point;
+  class IDataStream;
 
   namespace StorageManager
   {
@@ -31,23 +32,65 @@ namespace SpatialIndex
 }
 
 class QgsFeature;
+class QgsFeatureIterator;
 class QgsRectangle;
 class QgsPoint;
 
 #include <QList>
+#include <QReadWriteLock>
+#include <QPair>
 
 #include "qgsfeature.h"
 
+/** \ingroup core
+ * Spatial index of feature bounding boxes based on an R-tree.
+ *
+ * An index can be shared by several threads. Queries and changes are serialized,
+ * as libspatialindex updates the statistics of the tree in every query.
+ */
 class CORE_EXPORT QgsSpatialIndex
 {
 
   public:
 
+    /** Interface for exact distances of features used to refine nearest neighbor queries.
+     * @note added in 2.1
+     */
+    class CORE_EXPORT ExactDistance
+    {
+      public:
+        virtual ~ExactDistance() {}
+
+        /** returns the distance of the feature from the point. It must not be smaller
+         * than the distance of the bounding box of the feature.
+         */
+        virtual double distance( QgsFeatureId fid, const QgsPoint& point ) = 0;
+    };
+
     /* creation of spatial index */
 
     /** constructor - creates R-tree */
     QgsSpatialIndex();
 
+    /** constructor - creates R-tree and bulk loads it with features from the iterator.
+     * The index is packed with the STR method, which is much faster than inserting
+     * the features one by one and gives a better balanced tree.
+     * Features without geometry are skipped.
+     *
+     * @note added in 2.1
+     */
+    explicit QgsSpatialIndex( const QgsFeatureIterator& fi );
+
+    /** copy constructor - creates a packed snapshot of the other index
+     * @note added in 2.1
+     */
+    QgsSpatialIndex( const QgsSpatialIndex& other );
+
+    /** replaces the content of the index by a packed snapshot of the other index
+     * @note added in 2.1
+     */
+    QgsSpatialIndex& operator=( const QgsSpatialIndex& other );
+
     /** destructor finalizes work with spatial index */
     ~QgsSpatialIndex();
 
@@ -69,15 +112,52 @@ class CORE_EXPORT QgsSpatialIndex
     /** returns nearest neighbors (their count is specified by second parameter) */
     QList<QgsFeatureId> nearestNeighbor( QgsPoint point, int neighbors );
 
+    /** returns nearest neighbors with their distances from the point, ordered by the distance.
+     * Without exact distances the distances of the bounding boxes are used. With exact
+     * distances, the features are ordered by these and the exact distance is computed only
+     * for the features whose bounding boxes are close enough.
+     * There may be more than the requested number of neighbors if the last ones have equal distances.
+     * @note added in 2.1
+     */
+    QList< QPair<QgsFeatureId, double> > nearestNeighborDistances( QgsPoint point, int neighbors, ExactDistance* exactDistance = 0 );
+
+
+    /* persistence */
+
+    /** writes a packed copy of the index to disk. The spatial index library
+     * appends the extensions .idx and .dat to the given base file name.
+     * @return false if the files could not be written
+     * @note added in 2.1
+     */
+    bool save( const QString& fileName ) const;
+
+    /** opens an index written by save(). The index pages are read from the file
+     * on demand, changes of the index are written back to the file.
+     * @return new index or 0 if the files are missing or not a saved index
+     * @note added in 2.1
+     */
+    static QgsSpatialIndex* load( const QString& fileName );
+
 
   protected:
     // @note not available in python bindings
-    SpatialIndex::Region rectToRegion( QgsRectangle rect );
+    static SpatialIndex::Region rectToRegion( QgsRectangle rect );
     // @note not available in python bindings
-    bool featureInfo( QgsFeature& f, SpatialIndex::Region& r, QgsFeatureId &id );
+    static bool featureInfo( QgsFeature& f, SpatialIndex::Region& r, QgsFeatureId &id );
+
+    friend class QgsFeatureIteratorDataStream; // for access to featureInfo()
 
   private:
 
+    /** constructor for an index opened from disk */
+    QgsSpatialIndex( SpatialIndex::IStorageManager* storageManager,
+                     SpatialIndex::StorageManager::IBuffer* storage,
+                     SpatialIndex::ISpatialIndex* rTree );
+
+    /** creates the storage and the R-tree, bulk loading the data of the stream if there is any */
+    void initTree( SpatialIndex::IDataStream* inputStream = 0 );
+
+
     /** storage manager */
     SpatialIndex::IStorageManager* mStorageManager;
 
@@ -87,6 +167,9 @@ class CORE_EXPORT QgsSpatialIndex
     /** R-tree containing spatial index */
     SpatialIndex::ISpatialIndex* mRTree;
 
+    /** write lock for queries and changes - recursive for the exact distance callbacks */
+    mutable QReadWriteLock mLock;
+
 };
 
 #endif
@@ -0,0 +1,496 @@
+/***************************************************************************
+    qgssqlexpressioncompiler.cpp
+    ----------------------------
+    begin                : January 2014
+    copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include "qgssqlexpressioncompiler.h"
+
+#include "qgslogger.h"
+
+#include <QSettings>
+
+static bool isIntegerLiteral( const QgsExpression::Node* node )
+{
+  return node->nodeType() == QgsExpression::ntLiteral &&
+         static_cast<const QgsExpression::NodeLiteral*>( node )->value().type() == QVariant::Int;
+}
+
+QgsSqlExpressionCompiler::QgsSqlExpressionCompiler( const QgsFields& fields, Flags flags )
+    : mFields( fields )
+    , mFlags( flags )
+{
+}
+
+QgsSqlExpressionCompiler::~QgsSqlExpressionCompiler()
+{
+}
+
+bool QgsSqlExpressionCompiler::compilationEnabled()
+{
+  return QSettings().value( "/qgis/compileExpressions", true ).toBool();
+}
+
+QgsSqlExpressionCompiler::Result QgsSqlExpressionCompiler::compile( const QgsExpression* exp )
+{
+  mResult.clear();
+
+  if ( !exp || !exp->rootNode() )
+    return Fail;
+
+  QStringList parts;
+  bool failed = false;
+  compileConjunction( exp->rootNode(), parts, failed );
+
+  if ( parts.isEmpty() )
+    return Fail;
+
+  mResult = parts.join( " AND " );
+  QgsDebugMsgLevel( QString( "compiled '%1' to '%2'%3" ).arg( exp->expression() ).arg( mResult ).arg( failed ? " (partially)" : "" ), 3 );
+  return failed ? Partial : Complete;
+}
+
+QgsSqlExpressionCompiler::Result QgsSqlExpressionCompiler::compileOrderBy( const QgsFeatureRequest::OrderBy& orderBy )
+{
+  mResult.clear();
+
+  if ( orderBy.isEmpty() )
+    return Fail;
+
+  // a partially translated order is useless - either all the clauses or nothing
+  QStringList parts;
+  foreach ( const QgsFeatureRequest::OrderByClause& clause, orderBy )
+  {
+    QgsExpression exp( clause.expression() );
+    if ( exp.hasParserError() || !exp.rootNode() )
+      return Fail;
+
+    ValueType type = nodeValueType( exp.rootNode() );
+    if ( type == String && ( mFlags & CaseInsensitiveStringMatch ) )
+      return Fail;
+
+    QString str;
+    if (( type != Numeric && type != LongInteger && type != String ) || !compileNode( exp.rootNode(), str ) )
+      return Fail;
+
+    parts << orderByClause( str, clause.ascending(), clause.nullsFirst() );
+  }
+
+  mResult = parts.join( "," );
+  QgsDebugMsgLevel( QString( "compiled order to '%1'" ).arg( mResult ), 3 );
+  return Complete;
+}
+
+QString QgsSqlExpressionCompiler::orderByClause( const QString& sql, bool ascending, bool nullsFirst )
+{
+  QString direction = ascending ? "ASC" : "DESC";
+
+  if ( !( mFlags & NullsSortFirst ) )
+    return QString( "%1 %2 %3" ).arg( sql, direction, nullsFirst ? "NULLS FIRST" : "NULLS LAST" );
+
+  if ( nullsFirst == ascending )
+    return QString( "%1 %2" ).arg( sql, direction );
+
+  // move the NULLs to the other end with an extra sort key
+  return QString( "CASE WHEN %1 IS NULL THEN 1 ELSE 0 END %2,%1 %3" ).arg( sql, nullsFirst ? "DESC" : "ASC", direction );
+}
+
+void QgsSqlExpressionCompiler::compileConjunction( const QgsExpression::Node* node, QStringList& parts, bool& failed )
+{
+  // operands of top level AND operators are independent: the ones that can't be
+  // translated are left for the local evaluation
+  if ( node->nodeType() == QgsExpression::ntBinaryOperator )
+  {
+    const QgsExpression::NodeBinaryOperator* n = static_cast<const QgsExpression::NodeBinaryOperator*>( node );
+    if ( n->op() == QgsExpression::boAnd )
+    {
+      compileConjunction( n->opLeft(), parts, failed );
+      compileConjunction( n->opRight(), parts, failed );
+      return;
+    }
+  }
+
+  QString str;
+  if ( nodeValueType( node ) == Boolean && compileNode( node, str ) )
+    parts << str;
+  else
+    failed = true;
+}
+
+QString QgsSqlExpressionCompiler::quotedIdentifier( const QString& identifier )
+{
+  return QgsExpression::quotedColumnRef( identifier );
+}
+
+QString QgsSqlExpressionCompiler::quotedValue( const QVariant& value )
+{
+  if ( value.isNull() )
+    return "NULL";
+
+  switch ( value.type() )
+  {
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+    case QVariant::ULongLong:
+      return value.toString();
+
+    case QVariant::Double:
+    {
+      // shortest representation that gives back the same number
+      double d = value.toDouble();
+      QString str = QString::number( d, 'g', 15 );
+      return str.toDouble() == d ? str : QString::number( d, 'g', 17 );
+    }
+
+    default:
+      return QgsExpression::quotedString( value.toString() );
+  }
+}
+
+QString QgsSqlExpressionCompiler::sqlFunctionFromFunctionName( const QString& fnName ) const
+{
+  Q_UNUSED( fnName );
+  return QString();
+}
+
+QgsSqlExpressionCompiler::ValueType QgsSqlExpressionCompiler::nodeValueType( const QgsExpression::Node* node ) const
+{
+  switch ( node->nodeType() )
+  {
+    case QgsExpression::ntLiteral:
+    {
+      QVariant value = static_cast<const QgsExpression::NodeLiteral*>( node )->value();
+      if ( value.isNull() )
+        return Null;
+
+      switch ( value.type() )
+      {
+        case QVariant::Int:
+        case QVariant::UInt:
+        case QVariant::LongLong:
+        case QVariant::ULongLong:
+        case QVariant::Double:
+          return Numeric;
+
+        case QVariant::String:
+        {
+          // strings that look like numbers are compared numerically by QgsExpression
+          bool ok;
+          value.toDouble( &ok );
+          return ok ? Unknown : String;
+        }
+
+        default:
+          return Unknown;
+      }
+    }
+
+    case QgsExpression::ntColumnRef:
+    {
+      int idx = mFields.indexFromName( static_cast<const QgsExpression::NodeColumnRef*>( node )->name() );
+      if ( idx < 0 )
+        return Unknown;
+
+      switch ( mFields[idx].type() )
+      {
+        case QVariant::Int:
+        case QVariant::Double:
+          return Numeric;
+
+        case QVariant::UInt:
+        case QVariant::LongLong:
+        case QVariant::ULongLong:
+          return LongInteger;
+
+        case QVariant::String:
+          return String;
+
+        default:
+          return Unknown;
+      }
+    }
+
+    case QgsExpression::ntUnaryOperator:
+    {
+      const QgsExpression::NodeUnaryOperator* n = static_cast<const QgsExpression::NodeUnaryOperator*>( node );
+      if ( n->op() == QgsExpression::uoNot )
+        return Boolean;
+      return nodeValueType( n->operand() ) == Numeric ? Numeric : Unknown;
+    }
+
+    case QgsExpression::ntBinaryOperator:
+      switch ( static_cast<const QgsExpression::NodeBinaryOperator*>( node )->op() )
+      {
+        case QgsExpression::boOr:
+        case QgsExpression::boAnd:
+        case QgsExpression::boEQ:
+        case QgsExpression::boNE:
+        case QgsExpression::boLE:
+        case QgsExpression::boGE:
+        case QgsExpression::boLT:
+        case QgsExpression::boGT:
+        case QgsExpression::boRegexp:
+        case QgsExpression::boLike:
+        case QgsExpression::boNotLike:
+        case QgsExpression::boILike:
+        case QgsExpression::boNotILike:
+        case QgsExpression::boIs:
+        case QgsExpression::boIsNot:
+          return Boolean;
+
+        default:
+          return Unknown;
+      }
+
+    case QgsExpression::ntInOperator:
+      return Boolean;
+
+    case QgsExpression::ntFunction:
+    {
+      // only case conversion of strings is known to give the same results
+      const QgsExpression::NodeFunction* n = static_cast<const QgsExpression::NodeFunction*>( node );
+      QString name = QgsExpression::Functions()[n->fnIndex()]->name();
+      if (( name == "lower" || name == "upper" ) && n->args() && n->args()->count() == 1 &&
+          nodeValueType( n->args()->list().at( 0 ) ) == String )
+        return String;
+      return Unknown;
+    }
+
+    case QgsExpression::ntCondition:
+      return Unknown;
+  }
+
+  return Unknown;
+}
+
+bool QgsSqlExpressionCompiler::compileNode( const QgsExpression::Node* node, QString& str )
+{
+  switch ( node->nodeType() )
+  {
+    case QgsExpression::ntUnaryOperator:
+    {
+      const QgsExpression::NodeUnaryOperator* n = static_cast<const QgsExpression::NodeUnaryOperator*>( node );
+      QString operand;
+
+      switch ( n->op() )
+      {
+        case QgsExpression::uoNot:
+          if ( nodeValueType( n->operand() ) != Boolean || !compileNode( n->operand(), operand ) )
+            return false;
+          str = QString( "(NOT %1)" ).arg( operand );
+          return true;
+
+        case QgsExpression::uoMinus:
+          if ( nodeValueType( n->operand() ) != Numeric || !compileNode( n->operand(), operand ) )
+            return false;
+          str = QString( "(-%1)" ).arg( operand );
+          return true;
+      }
+      return false;
+    }
+
+    case QgsExpression::ntBinaryOperator:
+    {
+      const QgsExpression::NodeBinaryOperator* n = static_cast<const QgsExpression::NodeBinaryOperator*>( node );
+      ValueType typeLeft = nodeValueType( n->opLeft() );
+      ValueType typeRight = nodeValueType( n->opRight() );
+      QString left, right, op;
+
+      switch ( n->op() )
+      {
+        case QgsExpression::boOr:
+        case QgsExpression::boAnd:
+          if ( typeLeft != Boolean || typeRight != Boolean )
+            return false;
+          op = n->op() == QgsExpression::boOr ? "OR" : "AND";
+          break;
+
+        case QgsExpression::boEQ:
+        case QgsExpression::boNE:
+          if ( typeLeft == String && typeRight == String )
+          {
+            // a string compared with a non-numeric literal is always compared as string
+            if ( mFlags & CaseInsensitiveStringMatch )
+              return false;
+            if ( n->opLeft()->nodeType() != QgsExpression::ntLiteral && n->opRight()->nodeType() != QgsExpression::ntLiteral )
+              return false;
+          }
+          else if ( typeLeft == LongInteger || typeRight == LongInteger )
+          {
+            // QgsExpression compares their string representation - same as numeric equality for integers only
+            if (( typeLeft != LongInteger && !isIntegerLiteral( n->opLeft() ) ) || ( typeRight != LongInteger && !isIntegerLiteral( n->opRight() ) ) )
+              return false;
+          }
+          else if ( typeLeft != Numeric || typeRight != Numeric )
+            return false;
+          op = n->op() == QgsExpression::boEQ ? "=" : "<>";
+          break;
+
+        case QgsExpression::boLE:
+        case QgsExpression::boGE:
+        case QgsExpression::boLT:
+        case QgsExpression::boGT:
+          // string ordering depends on database collation
+          if ( typeLeft != Numeric || typeRight != Numeric )
+            return false;
+          op = QgsExpression::BinaryOperatorText[n->op()];
+          break;
+
+        case QgsExpression::boIs:
+        case QgsExpression::boIsNot:
+          if ( typeRight != Null || ( typeLeft != Numeric && typeLeft != LongInteger && typeLeft != String ) || !compileNode( n->opLeft(), left ) )
+            return false;
+          str = QString( n->op() == QgsExpression::boIs ? "(%1 IS NULL)" : "(%1 IS NOT NULL)" ).arg( left );
+          return true;
+
+        case QgsExpression::boLike:
+        case QgsExpression::boNotLike:
+        case QgsExpression::boILike:
+        case QgsExpression::boNotILike:
+        {
+          if ( mFlags & CaseInsensitiveStringMatch )
+            return false;
+          if ( typeLeft != String || n->opRight()->nodeType() != QgsExpression::ntLiteral )
+            return false;
+
+          QVariant pattern = static_cast<const QgsExpression::NodeLiteral*>( n->opRight() )->value();
+          // QgsExpression has no escape character in LIKE patterns
+          if ( pattern.type() != QVariant::String || pattern.toString().contains( '\\' ) )
+            return false;
+
+          if ( !compileNode( n->opLeft(), left ) )
+            return false;
+          return compileLike( n, left, pattern.toString(), str );
+        }
+
+        default:
+          return false;
+      }
+
+      if ( !compileNode( n->opLeft(), left ) || !compileNode( n->opRight(), right ) )
+        return false;
+
+      str = QString( "(%1 %2 %3)" ).arg( left ).arg( op ).arg( right );
+      return true;
+    }
+
+    case QgsExpression::ntInOperator:
+    {
+      const QgsExpression::NodeInOperator* n = static_cast<const QgsExpression::NodeInOperator*>( node );
+      ValueType type = nodeValueType( n->node() );
+      if ( type != Numeric && type != LongInteger && type != String )
+        return false;
+      if ( type == String && ( mFlags & CaseInsensitiveStringMatch ) )
+        return false;
+
+      QString value;
+      if ( !compileNode( n->node(), value ) )
+        return false;
+
+      QStringList list;
+      foreach ( const QgsExpression::Node* item, n->list()->list() )
+      {
+        ValueType itemType = nodeValueType( item );
+        if ( item->nodeType() != QgsExpression::ntLiteral )
+          return false;
+        if ( type == LongInteger ? itemType != Null && !isIntegerLiteral( item ) : itemType != type && itemType != Null )
+          return false;
+
+        QString itemStr;
+        if ( !compileNode( item, itemStr ) )
+          return false;
+        list << itemStr;
+      }
+
+      str = QString( "(%1 %2IN (%3))" ).arg( value ).arg( n->isNotIn() ? "NOT " : "" ).arg( list.join( "," ) );
+      return true;
+    }
+
+    case QgsExpression::ntFunction:
+    {
+      const QgsExpression::NodeFunction* n = static_cast<const QgsExpression::NodeFunction*>( node );
+      if ( nodeValueType( n ) == Unknown )
+        return false;
+
+      QString fnName = sqlFunctionFromFunctionName( QgsExpression::Functions()[n->fnIndex()]->name() );
+      if ( fnName.isEmpty() )
+        return false;
+
+      QStringList args;
+      foreach ( const QgsExpression::Node* arg, n->args()->list() )
+      {
+        QString argStr;
+        if ( !compileNode( arg, argStr ) )
+          return false;
+        args << argStr;
+      }
+
+      str = QString( "%1(%2)" ).arg( fnName ).arg( args.join( "," ) );
+      return true;
+    }
+
+    case QgsExpression::ntLiteral:
+    {
+      QVariant value = static_cast<const QgsExpression::NodeLiteral*>( node )->value();
+      ValueType type = nodeValueType( node );
+      if ( type == Unknown )
+        return false;
+      if ( type == String && ( mFlags & NoEmptyStrings ) && value.toString().isEmpty() )
+        return false;
+
+      str = quotedValue( value );
+      return true;
+    }
+
+    case QgsExpression::ntColumnRef:
+    {
+      QString name = static_cast<const QgsExpression::NodeColumnRef*>( node )->name();
+      if ( mFields.indexFromName( name ) < 0 )
+        return false;
+
+      str = quotedIdentifier( name );
+      return true;
+    }
+
+    case QgsExpression::ntCondition:
+      return false;
+  }
+
+  return false;
+}
+
+bool QgsSqlExpressionCompiler::compileLike( const QgsExpression::NodeBinaryOperator* n, const QString& left, const QString& pattern, QString& str )
+{
+  bool caseInsensitive = n->op() == QgsExpression::boILike || n->op() == QgsExpression::boNotILike;
+  bool negated = n->op() == QgsExpression::boNotLike || n->op() == QgsExpression::boNotILike;
+  QString op;
+
+  if ( mFlags & LikeIsCaseInsensitive )
+  {
+    if ( !caseInsensitive )
+      return false;
+
+    // the database only folds the case of ASCII characters
+    for ( int i = 0; i < pattern.length(); i++ )
+    {
+      if ( pattern.at( i ).unicode() > 127 )
+        return false;
+    }
+    op = "LIKE";
+  }
+  else
+  {
+    op = caseInsensitive ? "ILIKE" : "LIKE";
+  }
+
+  str = QString( "(%1 %2%3 %4)" ).arg( left ).arg( negated ? "NOT " : "" ).arg( op ).arg( quotedValue( pattern ) );
+  return true;
+}
@@ -0,0 +1,122 @@
+/***************************************************************************
+    qgssqlexpressioncompiler.h
+    --------------------------
+    begin                : January 2014
+    copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#ifndef QGSSQLEXPRESSIONCOMPILER_H
+#define QGSSQLEXPRESSIONCOMPILER_H
+
+#include "qgsexpression.h"
+#include "qgsfeaturerequest.h"
+#include "qgsfield.h"
+
+/** \ingroup core
+ * Translation of a QgsExpression filter into an SQL WHERE clause, so that
+ * database providers can do the filtering on the server side.
+ *
+ * Only the constructs with the very same semantics on both sides are translated:
+ * AND / OR / NOT, comparisons of numeric columns with numbers and of string columns
+ * with (non-numeric) strings, IN with a list of literals, IS [NOT] NULL, LIKE / ILIKE
+ * with a literal pattern and the functions the dialect maps with sqlFunctionFromFunctionName().
+ *
+ * If the whole expression can be translated, the result is Complete and the provider
+ * does not need to evaluate the expression locally. If only some of the top level
+ * AND operands can be translated, the result is Partial: the SQL clause restricts
+ * the number of fetched rows, but the expression still has to be evaluated
+ * for each feature.
+ *
+ * The order of a feature request can be translated with compileOrderBy() into an SQL
+ * ORDER BY clause. Only numeric and string columns and expressions are accepted.
+ *
+ * Subclasses adapt quoting and dialect differences of the individual databases.
+ *
+ * @note added in 2.1
+ */
+class CORE_EXPORT QgsSqlExpressionCompiler
+{
+  public:
+    enum Result
+    {
+      None,     //!< compile() has not been called yet
+      Complete, //!< the whole expression was translated
+      Partial,  //!< some AND operands were translated, the rest must be evaluated locally
+      Fail      //!< nothing could be translated
+    };
+
+    enum Flag
+    {
+      CaseInsensitiveStringMatch = 1,  //!< string comparisons and LIKE of the database ignore case
+      LikeIsCaseInsensitive = 1 << 1,  //!< LIKE of the database ignores case (ILIKE is then translated to LIKE)
+      NoEmptyStrings = 1 << 2,         //!< empty strings are NULLs in the database
+      NullsSortFirst = 1 << 3          //!< no NULLS FIRST / LAST in ORDER BY, NULLs sort before any other value
+    };
+    Q_DECLARE_FLAGS( Flags, Flag )
+
+    //! @param fields provider's fields - only columns among them are translated
+    //! @param flags differences of the SQL dialect
+    QgsSqlExpressionCompiler( const QgsFields& fields, Flags flags = 0 );
+    virtual ~QgsSqlExpressionCompiler();
+
+    //! Translate the expression. The SQL clause is available with result()
+    virtual Result compile( const QgsExpression* exp );
+
+    //! Translate the order of a feature request (without the ORDER BY keyword).
+    //! The result is either Complete or Fail, the SQL clause is available with result()
+    //! @note added in 2.1
+    virtual Result compileOrderBy( const QgsFeatureRequest::OrderBy& orderBy );
+
+    //! SQL clause of the last compile() or compileOrderBy() call (empty if it failed)
+    QString result() const { return mResult; }
+
+    //! Returns true if the setting to compile expressions to provider's SQL is enabled
+    static bool compilationEnabled();
+
+  protected:
+    //! kind of value a node evaluates to
+    enum ValueType
+    {
+      Unknown,
+      Boolean,
+      Numeric,
+      LongInteger,  //!< 64bit integers - compared as strings by QgsExpression, so only equality is safe
+      String,
+      Null
+    };
+
+    virtual QString quotedIdentifier( const QString& identifier );
+    virtual QString quotedValue( const QVariant& value );
+
+    //! Returns the SQL function for an expression function or empty string if it is not supported
+    virtual QString sqlFunctionFromFunctionName( const QString& fnName ) const;
+
+    //! Translate one node. Returns false if the node (or any of its children) is not supported
+    virtual bool compileNode( const QgsExpression::Node* node, QString& str );
+
+    //! Translate a LIKE / ILIKE / NOT LIKE / NOT ILIKE operator with a literal pattern
+    virtual bool compileLike( const QgsExpression::NodeBinaryOperator* n, const QString& left, const QString& pattern, QString& str );
+
+    //! SQL for one clause of ORDER BY
+    virtual QString orderByClause( const QString& sql, bool ascending, bool nullsFirst );
+
+    //! Determine the kind of value the node returns (without evaluating it)
+    ValueType nodeValueType( const QgsExpression::Node* node ) const;
+
+    QgsFields mFields;
+    Flags mFlags;
+    QString mResult;
+
+  private:
+    void compileConjunction( const QgsExpression::Node* node, QStringList& parts, bool& failed );
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS( QgsSqlExpressionCompiler::Flags )
+
+#endif // QGSSQLEXPRESSIONCOMPILER_H
@@ -0,0 +1,89 @@
+/***************************************************************************
+    qgstilecache.cpp
+    ---------------------
+    begin                : January 2014
+    copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgstilecache.h"
+#include "qgslogger.h"
+#include "qgsnetworkaccessmanager.h"
+
+#include <QAbstractNetworkCache>
+#include <QDateTime>
+#include <QImage>
+
+// 64 MiB of decoded tiles (about 256 tiles of 256x256 pixels)
+QCache<QUrl, QImage> QgsTileCache::sTileCache( 64 * 1024 );
+QMutex QgsTileCache::sTileCacheMutex;
+
+static int imageCost( const QImage& image )
+{
+  return qMax( 1, image.byteCount() / 1024 );
+}
+
+void QgsTileCache::insertTile( const QUrl& url, const QImage& image )
+{
+  QMutexLocker locker( &sTileCacheMutex );
+  sTileCache.insert( url, new QImage( image ), imageCost( image ) );
+}
+
+bool QgsTileCache::tile( const QUrl& url, QImage& image )
+{
+  QMutexLocker locker( &sTileCacheMutex );
+  if ( QImage* i = sTileCache.object( url ) )
+  {
+    image = *i;
+    return true;
+  }
+
+  QAbstractNetworkCache* diskCache = QgsNetworkAccessManager::instance()->cache();
+  if ( !diskCache )
+  {
+    return false;
+  }
+
+  QNetworkCacheMetaData metaData = diskCache->metaData( url );
+  if ( !metaData.isValid() ||
+       ( metaData.expirationDate().isValid() && metaData.expirationDate() < QDateTime::currentDateTime() ) )
+  {
+    return false;
+  }
+
+  QIODevice* data = diskCache->data( url );
+  if ( !data )
+  {
+    return false;
+  }
+
+  image = QImage::fromData( data->readAll() );
+  delete data;
+  if ( image.isNull() )
+  {
+    QgsDebugMsg( QString( "cached tile could not be decoded: %1" ).arg( url.toString() ) );
+    return false;
+  }
+
+  // keep it in memory for the next redraw
+  sTileCache.insert( url, new QImage( image ), imageCost( image ) );
+  return true;
+}
+
+int QgsTileCache::totalCost()
+{
+  QMutexLocker locker( &sTileCacheMutex );
+  return sTileCache.totalCost();
+}
+
+int QgsTileCache::maxCost()
+{
+  QMutexLocker locker( &sTileCacheMutex );
+  return sTileCache.maxCost();
+}
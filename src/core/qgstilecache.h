@@ -0,0 +1,59 @@
+/***************************************************************************
+    qgstilecache.h
+    ---------------------
+    begin                : January 2014
+    copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSTILECACHE_H
+#define QGSTILECACHE_H
+
+#include <QCache>
+#include <QMutex>
+#include <QUrl>
+
+class QImage;
+
+/** \ingroup core
+ * Cache of decoded map tiles (e.g. WMTS or WMS-C), shared by all the layers.
+ *
+ * Tiles are identified by their URL, which contains the layer, the tile matrix
+ * and the tile coordinates. The decoded images are kept in a size limited
+ * in-memory cache with least recently used eviction. Tiles which are not in
+ * memory any more are looked up in the disk cache of QgsNetworkAccessManager
+ * (if one is set), where the network replies of the tiles are stored.
+ *
+ * \note not available in Python bindings
+ * \note added in 2.2
+ */
+class CORE_EXPORT QgsTileCache
+{
+  public:
+    /**Adds a decoded tile to the in-memory cache. The disk cache is filled by
+     * the network access manager when the tile is downloaded*/
+    static void insertTile( const QUrl& url, const QImage& image );
+
+    /**Looks up a tile, first in memory and then in the disk cache.
+     * Expired tiles of the disk cache are not returned.
+     * @return false if the tile is not cached*/
+    static bool tile( const QUrl& url, QImage& image );
+
+    /**Size of the tiles in memory in KiB*/
+    static int totalCost();
+
+    /**Maximum size of the tiles in memory in KiB*/
+    static int maxCost();
+
+  private:
+    static QCache<QUrl, QImage> sTileCache;
+    static QMutex sTileCacheMutex;
+};
+
+#endif // QGSTILECACHE_H
@@ -1877,7 +1877,7 @@ QgsVectorFileWriter::WriterError QgsVectorFileWriter::writeAsVectorFormat( QgsVe
   }
 
   QgsAttributeList allAttr = skipAttributeCreation ? QgsAttributeList() : layer->pendingAllAttributesList();
-  QgsFeature fet;
+  QgsFeatureList features;
 
   //add possible attributes needed by renderer
   writer->addRendererAttributes( layer, allAttr );
@@ -1932,64 +1932,70 @@ QgsVectorFileWriter::WriterError QgsVectorFileWriter::writeAsVectorFormat( QgsVe
   }
 
   // write all features
-  while ( fit.nextFeature( fet ) )
+  bool stopped = false;
+  while ( !stopped && fit.nextFeatures( features ) )
   {
-    if ( onlySelected && !ids.contains( fet.id() ) )
-      continue;
-
-    if ( shallTransform )
+    for ( QgsFeatureList::iterator it = features.begin(); it != features.end(); ++it )
     {
-      try
+      QgsFeature& fet = *it;
+      if ( onlySelected && !ids.contains( fet.id() ) )
+        continue;
+
+      if ( shallTransform )
       {
-        if ( fet.geometry() )
+        try
         {
-          fet.geometry()->transform( *ct );
+          if ( fet.geometry() )
+          {
+            fet.geometry()->transform( *ct );
+          }
         }
-      }
-      catch ( QgsCsException &e )
-      {
-        delete ct;
-        delete writer;
+        catch ( QgsCsException &e )
+        {
+          delete ct;
+          delete writer;
 
-        QString msg = QObject::tr( "Failed to transform a point while drawing a feature with ID '%1'. Writing stopped. (Exception: %2)" )
-                      .arg( fet.id() ).arg( e.what() );
-        QgsLogger::warning( msg );
-        if ( errorMessage )
-          *errorMessage = msg;
+          QString msg = QObject::tr( "Failed to transform a point while drawing a feature with ID '%1'. Writing stopped. (Exception: %2)" )
+                        .arg( fet.id() ).arg( e.what() );
+          QgsLogger::warning( msg );
+          if ( errorMessage )
+            *errorMessage = msg;
 
-        return ErrProjection;
+          return ErrProjection;
+        }
       }
-    }
-    if ( allAttr.size() < 1 && skipAttributeCreation )
-    {
-      fet.initAttributes( 0 );
-    }
-
-    if ( !writer->addFeature( fet, layer->rendererV2(), mapUnits ) )
-    {
-      WriterError err = writer->hasError();
-      if ( err != NoError && errorMessage )
+      if ( allAttr.size() < 1 && skipAttributeCreation )
       {
-        if ( errorMessage->isEmpty() )
-        {
-          *errorMessage = QObject::tr( "Feature write errors:" );
-        }
-        *errorMessage += "\n" + writer->errorMessage();
+        fet.initAttributes( 0 );
       }
-      errors++;
 
-      if ( errors > 1000 )
+      if ( !writer->addFeature( fet, layer->rendererV2(), mapUnits ) )
       {
-        if ( errorMessage )
+        WriterError err = writer->hasError();
+        if ( err != NoError && errorMessage )
         {
-          *errorMessage += QObject::tr( "Stopping after %1 errors" ).arg( errors );
+          if ( errorMessage->isEmpty() )
+          {
+            *errorMessage = QObject::tr( "Feature write errors:" );
+          }
+          *errorMessage += "\n" + writer->errorMessage();
         }
+        errors++;
 
-        n = -1;
-        break;
+        if ( errors > 1000 )
+        {
+          if ( errorMessage )
+          {
+            *errorMessage += QObject::tr( "Stopping after %1 errors" ).arg( errors );
+          }
+
+          n = -1;
+          stopped = true;
+          break;
+        }
       }
+      n++;
     }
-    n++;
   }
 
   if ( transactionsEnabled )
@@ -61,6 +61,7 @@
 #include "qgsvectorlayereditutils.h"
 #include "qgsvectorlayerfeatureiterator.h"
 #include "qgsvectorlayerjoinbuffer.h"
+#include "qgsvectorlayerrenderer.h"
 #include "qgsvectorlayerundocommand.h"
 #include "qgsmaplayerregistry.h"
 #include "qgsclipper.h"
@@ -413,74 +414,80 @@ void QgsVectorLayer::drawRendererV2( QgsFeatureIterator &fit, QgsRenderContext&
   int featureCount = 0;
 #endif //Q_WS_MAC
 
-  QgsFeature fet;
-  while ( fit.nextFeature( fet ) )
+  QgsFeatureList features;
+  bool stopped = false;
+  while ( !stopped && fit.nextFeatures( features ) )
   {
-    try
+    for ( QgsFeatureList::iterator it = features.begin(); it != features.end(); ++it )
     {
-      if ( !fet.geometry() )
-        continue; // skip features without geometry
+      QgsFeature& fet = *it;
+      try
+      {
+        if ( !fet.geometry() )
+          continue; // skip features without geometry
 
 #ifndef Q_WS_MAC //MH: disable this on Mac for now to avoid problems with resizing
 #ifdef Q_WS_X11
-      if ( !mEnableBackbuffer ) // do not handle events, as we're already inside a paint event
-      {
-#endif // Q_WS_X11
-        if ( mUpdateThreshold > 0 && 0 == featureCount % mUpdateThreshold )
+        if ( !mEnableBackbuffer ) // do not handle events, as we're already inside a paint event
         {
-          emit screenUpdateRequested();
-          // emit drawingProgress( featureCount, totalFeatures );
-          qApp->processEvents();
-        }
-        else if ( featureCount % 1000 == 0 )
-        {
-          // emit drawingProgress( featureCount, totalFeatures );
-          qApp->processEvents();
-        }
+#endif // Q_WS_X11
+          if ( mUpdateThreshold > 0 && 0 == featureCount % mUpdateThreshold )
+          {
+            emit screenUpdateRequested();
+            // emit drawingProgress( featureCount, totalFeatures );
+            qApp->processEvents();
+          }
+          else if ( featureCount % 1000 == 0 )
+          {
+            // emit drawingProgress( featureCount, totalFeatures );
+            qApp->processEvents();
+          }
 #ifdef Q_WS_X11
-      }
+        }
 #endif // Q_WS_X11
 #endif // Q_WS_MAC
 
-      if ( rendererContext.renderingStopped() )
-      {
-        break;
-      }
-
-      bool sel = mSelectedFeatureIds.contains( fet.id() );
-      bool drawMarker = ( mEditBuffer && ( !vertexMarkerOnlyForSelection || sel ) );
+        if ( rendererContext.renderingStopped() )
+        {
+          stopped = true;
+          break;
+        }
 
-      // render feature
-      bool rendered = mRendererV2->renderFeature( fet, rendererContext, -1, sel, drawMarker );
+        bool sel = mSelectedFeatureIds.contains( fet.id() );
+        bool drawMarker = ( mEditBuffer && ( !vertexMarkerOnlyForSelection || sel ) );
 
-      if ( mEditBuffer )
-      {
-        // Cache this for the use of (e.g.) modifying the feature's uncommitted geometry.
-        mCache->cacheGeometry( fet.id(), *fet.geometry() );
-      }
+        // render feature
+        bool rendered = mRendererV2->renderFeature( fet, rendererContext, -1, sel, drawMarker );
 
-      // labeling - register feature
-      if ( rendered && rendererContext.labelingEngine() )
-      {
-        if ( labeling )
+        if ( mEditBuffer )
         {
-          rendererContext.labelingEngine()->registerFeature( this, fet, rendererContext );
+          // Cache this for the use of (e.g.) modifying the feature's uncommitted geometry.
+          mCache->cacheGeometry( fet.id(), *fet.geometry() );
         }
-        if ( mDiagramRenderer )
+
+        // labeling - register feature
+        if ( rendered && rendererContext.labelingEngine() )
         {
-          rendererContext.labelingEngine()->registerDiagramFeature( this, fet, rendererContext );
+          if ( labeling )
+          {
+            rendererContext.labelingEngine()->registerFeature( this, fet, rendererContext );
+          }
+          if ( mDiagramRenderer )
+          {
+            rendererContext.labelingEngine()->registerDiagramFeature( this, fet, rendererContext );
+          }
         }
       }
-    }
-    catch ( const QgsCsException &cse )
-    {
-      Q_UNUSED( cse );
-      QgsDebugMsg( QString( "Failed to transform a point while drawing a feature with ID '%1'. Ignoring this feature. %2" )
-                   .arg( fet.id() ).arg( cse.what() ) );
-    }
+      catch ( const QgsCsException &cse )
+      {
+        Q_UNUSED( cse );
+        QgsDebugMsg( QString( "Failed to transform a point while drawing a feature with ID '%1'. Ignoring this feature. %2" )
+                     .arg( fet.id() ).arg( cse.what() ) );
+      }
 #ifndef Q_WS_MAC
-    ++featureCount;
+      ++featureCount;
 #endif //Q_WS_MAC
+    }
   }
 
   stopRendererV2( rendererContext, NULL );
@@ -697,9 +704,21 @@ bool QgsVectorLayer::draw( QgsRenderContext& rendererContext )
   //do startRender before getFeatures to give renderers the possibility of querying features in the startRender method
   mRendererV2->startRender( rendererContext, this );
 
-  QgsFeatureRequest& featureRequest = QgsFeatureRequest()
-                                      .setFilterRect( rendererContext.extent() )
-                                      .setSubsetOfAttributes( attributes );
+  QgsFeatureIterator fit = getFeatures( renderingFeatureRequest( rendererContext, attributes ) );
+
+  if (( mRendererV2->capabilities() & QgsFeatureRendererV2::SymbolLevels ) && mRendererV2->usingSymbolLevels() )
+    drawRendererV2Levels( fit, rendererContext, labeling );
+  else
+    drawRendererV2( fit, rendererContext, labeling );
+
+  return true;
+}
+
+QgsFeatureRequest QgsVectorLayer::renderingFeatureRequest( QgsRenderContext& rendererContext, const QgsAttributeList& attributes ) const
+{
+  QgsFeatureRequest featureRequest = QgsFeatureRequest()
+                                     .setFilterRect( rendererContext.extent() )
+                                     .setSubsetOfAttributes( attributes );
 
   // enable the simplification of the geometries (Using the current map2pixel context) before send it to renderer engine.
   if ( simplifyDrawingCanbeApplied( rendererContext, QgsVectorLayer::GeometrySimplification ) )
@@ -741,14 +760,25 @@ bool QgsVectorLayer::draw( QgsRenderContext& rendererContext )
     featureRequest.setSimplifyMethod( simplifyMethod );
   }
 
-  QgsFeatureIterator fit = getFeatures( featureRequest );
+  return featureRequest;
+}
 
-  if (( mRendererV2->capabilities() & QgsFeatureRendererV2::SymbolLevels ) && mRendererV2->usingSymbolLevels() )
-    drawRendererV2Levels( fit, rendererContext, labeling );
-  else
-    drawRendererV2( fit, rendererContext, labeling );
+QgsMapLayerRenderer* QgsVectorLayer::createMapRenderer( QgsRenderContext& rendererContext )
+{
+  if ( !hasGeometryType() || !mRendererV2 || !mDataProvider )
+    return 0;
 
-  return true;
+  // the edit buffer and geometry cache are modified during editing - keep
+  // editable layers in the main thread
+  if ( mEditBuffer )
+    return 0;
+
+  // providers whose iterators may be consumed from a thread other than the one that created them
+  static QStringList threadSafeProviders = QStringList() << "ogr" << "memory" << "delimitedtext" << "gpx" << "postgres" << "spatialite";
+  if ( !threadSafeProviders.contains( mProviderKey ) )
+    return 0;
+
+  return new QgsVectorLayerRenderer( this, rendererContext );
 }
 
 void QgsVectorLayer::drawVertexMarker( double x, double y, QPainter& p, QgsVectorLayer::VertexMarkerType type, int m )
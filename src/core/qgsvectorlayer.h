@@ -1035,6 +1035,13 @@ class CORE_EXPORT QgsVectorLayer : public QgsMapLayer
      */
     bool draw( QgsRenderContext& rendererContext );
 
+    /** Returns a snapshot of the layer's rendering state that can be drawn
+     *  in a worker thread, or 0 if the layer has to be drawn with draw()
+     *  (e.g. while it is being edited)
+     *  @note added in 2.1
+     */
+    QgsMapLayerRenderer* createMapRenderer( QgsRenderContext& rendererContext );
+
     /** Draws the layer labels using coordinate transformation */
     void drawLabels( QgsRenderContext& rendererContext );
 
@@ -1596,6 +1603,10 @@ class CORE_EXPORT QgsVectorLayer : public QgsMapLayer
       @param labeling out: true if there will be labeling (ng) for this layer*/
     void prepareLabelingAndDiagrams( QgsRenderContext& rendererContext, QgsAttributeList& attributes, bool& labeling );
 
+    /**Returns the feature request for drawing the layer with the given context
+      (filter rectangle, attributes and geometry simplification)*/
+    QgsFeatureRequest renderingFeatureRequest( QgsRenderContext& rendererContext, const QgsAttributeList& attributes ) const;
+
   private:                       // Private attributes
 
     /** Update threshold for drawing features as they are read. A value of zero indicates
@@ -1739,6 +1750,7 @@ class CORE_EXPORT QgsVectorLayer : public QgsMapLayer
     QgsRenderContext *mCurrentRendererContext;
 
     friend class QgsVectorLayerFeatureIterator;
+    friend class QgsVectorLayerRenderer;
 };
 
 #endif
@@ -27,7 +27,33 @@ QgsVectorLayerFeatureIterator::QgsVectorLayerFeatureIterator( QgsVectorLayer* la
 {
   QgsVectorLayerJoinBuffer* joinBuffer = L->mJoinBuffer;
 
+  // the attributes and the geometry needed for sorting have to be fetched too
+  bool orderByProviderFields = true;
+  if ( !mRequest.orderBy().isEmpty() )
+  {
+    QgsAttributeList subset = mRequest.subsetOfAttributes();
+    foreach ( const QgsFeatureRequest::OrderByClause& clause, mRequest.orderBy() )
+    {
+      QgsExpression exp( clause.expression() );
+      foreach ( const QString& column, exp.referencedColumns() )
+      {
+        int idx = L->pendingFields().indexFromName( column );
+        if ( idx < 0 || L->pendingFields().fieldOrigin( idx ) != QgsFields::OriginProvider )
+          orderByProviderFields = false;
+        if ( idx >= 0 && !subset.contains( idx ) )
+          subset << idx;
+      }
+
+      if ( exp.needsGeometry() && ( mRequest.flags() & QgsFeatureRequest::NoGeometry ) )
+        mRequest.setFlags( mRequest.flags() & ~QgsFeatureRequest::NoGeometry );
+    }
+
+    if ( mRequest.flags() & QgsFeatureRequest::SubsetOfAttributes )
+      mRequest.setSubsetOfAttributes( subset );
+  }
+
   mChangedFeaturesRequest = mRequest;
+  mChangedFeaturesRequest.setOrderBy( QgsFeatureRequest::OrderBy() ).setLimit( -1 );
 
   if ( L->editBuffer() )
   {
@@ -47,6 +73,17 @@ QgsVectorLayerFeatureIterator::QgsVectorLayerFeatureIterator( QgsVectorLayer* la
   // by default provider's request is the same
   mProviderRequest = mRequest;
 
+  if ( !L->editBuffer() && mFetchJoinInfo.isEmpty() && orderByProviderFields )
+  {
+    // the provider returns the features in the right order and only as many as requested
+    mOrderByCompiled = true;
+  }
+  else
+  {
+    // edited and joined features are sorted and counted here
+    mProviderRequest.setOrderBy( QgsFeatureRequest::OrderBy() ).setLimit( -1 );
+  }
+
   if ( mProviderRequest.flags() & QgsFeatureRequest::SubsetOfAttributes )
   {
     // prepare list of attributes to match provider fields
@@ -171,6 +208,26 @@ bool QgsVectorLayerFeatureIterator::fetchFeature( QgsFeature& f )
 }
 
 
+int QgsVectorLayerFeatureIterator::fetchFeatures( QgsFeatureList& features, int n )
+{
+  // provider features need to be merged with the edit buffer and joins one by one
+  if ( mClosed || mRequest.filterType() == QgsFeatureRequest::FilterFid || mProviderIterator.isClosed() ||
+       !mAddedFeatures.isEmpty() || !mChangedGeometries.isEmpty() || !mDeletedFeatureIds.isEmpty() ||
+       !mChangedAttributeValues.isEmpty() || !mAddedAttributes.isEmpty() || !mDeletedAttributeIds.isEmpty() ||
+       !mFetchJoinInfo.isEmpty() )
+    return QgsAbstractFeatureIterator::fetchFeatures( features, n );
+
+  int count = mProviderIterator.nextFeatures( features, n );
+  for ( int i = 0; i < count; ++i )
+    features[i].setFields( &L->mUpdatedFields );
+
+  if ( count < n )
+    close();
+
+  return count;
+}
+
+
 
 bool QgsVectorLayerFeatureIterator::rewind()
 {
@@ -0,0 +1,332 @@
+/***************************************************************************
+    qgsvectorlayerrenderer.cpp
+    ---------------------
+    begin                : January 2014
+    copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include "qgsvectorlayerrenderer.h"
+
+#include "qgscsexception.h"
+#include "qgsexpression.h"
+#include "qgsgeometry.h"
+#include "qgslogger.h"
+#include "qgsmaprenderer.h"
+#include "qgsrendercontext.h"
+#include "qgsrendererv2.h"
+#include "qgssymbollayerv2.h"
+#include "qgssymbolv2.h"
+#include "qgsvectorlayer.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+
+// the labeling engine is not thread-safe: feature registration from all
+// vector layer renderers goes through this lock
+static QMutex sLabelingMutex;
+
+// postgres and spatialite providers share one connection between all layers
+// of a database - fetching from such iterators is done one layer at a time
+static QMutex sSharedConnectionMutex;
+
+QgsVectorLayerRenderer::QgsVectorLayerRenderer( QgsVectorLayer* layer, QgsRenderContext& context )
+    : QgsMapLayerRenderer( layer->id() )
+    , mContext( context )
+    , mLayer( layer )
+    , mRendererV2( 0 )
+    , mRendering( false )
+    , mFilterExpression( 0 )
+    , mLabeling( false )
+    , mDiagrams( false )
+    , mSharedConnection( false )
+{
+  mRendererV2 = layer->mRendererV2->clone();
+  mRendererV2->setUsingSymbolLevels( layer->mRendererV2->usingSymbolLevels() );
+
+  mSelectedFeatureIds = layer->mSelectedFeatureIds;
+
+  QString providerKey = layer->providerType();
+  mSharedConnection = providerKey == "postgres" || providerKey == "spatialite";
+
+  QString nativeFilter;
+  QgsAttributeList attributes;
+  foreach ( QString attrName, mRendererV2->usedAttributes() )
+  {
+    attributes.append( layer->fieldNameIndex( attrName ) );
+  }
+
+  if ( mContext.hasLayerOverride( layer->id() ) )
+  {
+    QgsRenderContext::LayerOverride layerOverride = mContext.layerOverride( layer->id() );
+
+    if ( layerOverride.overrideSelection )
+    {
+      mSelectedFeatureIds = layerOverride.selectedFeatureIds;
+    }
+
+    if ( layerOverride.opacity < 1.0 )
+    {
+      QgsSymbolV2List symbols = mRendererV2->symbols();
+      for ( QgsSymbolV2List::iterator symbolIt = symbols.begin(); symbolIt != symbols.end(); ++symbolIt )
+      {
+        ( *symbolIt )->setAlpha(( *symbolIt )->alpha() * layerOverride.opacity );
+      }
+    }
+
+    // the filter is in the syntax of the subset string and the provider applies it
+    // to its query. Providers without subset strings and layers with an edit buffer
+    // (whose features the provider doesn't see) evaluate it here as an expression.
+    if ( !layerOverride.filterExpression.isEmpty() && layer->dataProvider()->supportsSubsetString() && !layer->isEditable() )
+    {
+      nativeFilter = layerOverride.filterExpression;
+    }
+    else if ( !layerOverride.filterExpression.isEmpty() )
+    {
+      mFilterExpression = new QgsExpression( layerOverride.filterExpression );
+      if ( mFilterExpression->hasParserError() )
+      {
+        QgsDebugMsg( "filter expression parser error: " + mFilterExpression->parserErrorString() );
+      }
+      mFilterExpression->prepare( layer->pendingFields() );
+      foreach ( QString attrName, mFilterExpression->referencedColumns() )
+      {
+        int attrNum = layer->fieldNameIndex( attrName );
+        if ( attrNum >= 0 && !attributes.contains( attrNum ) )
+        {
+          attributes.append( attrNum );
+        }
+      }
+    }
+  }
+
+  //register label and diagram layer to the labeling engine
+  layer->prepareLabelingAndDiagrams( mContext, attributes, mLabeling );
+  mDiagrams = layer->mDiagramRenderer && mContext.labelingEngine();
+
+  //do startRender before getFeatures to give renderers the possibility of querying features in the startRender method
+  mRendererV2->startRender( mContext, layer );
+  mRendering = true;
+
+  QgsFeatureRequest featureRequest = layer->renderingFeatureRequest( mContext, attributes );
+  featureRequest.setFilterNativeExpression( nativeFilter );
+  mFit = layer->getFeatures( featureRequest );
+}
+
+QgsVectorLayerRenderer::~QgsVectorLayerRenderer()
+{
+  if ( mRendering )
+    stopRender();
+
+  mFit.close();
+  delete mRendererV2;
+  delete mFilterExpression;
+}
+
+bool QgsVectorLayerRenderer::render()
+{
+  if ( !mRendering )
+    return false;
+
+  QgsDebugMsg( "rendering v2:\n" + mRendererV2->dump() );
+
+  if (( mRendererV2->capabilities() & QgsFeatureRendererV2::SymbolLevels ) && mRendererV2->usingSymbolLevels() )
+    drawRendererV2Levels();
+  else
+    drawRendererV2();
+
+  stopRender();
+  return true;
+}
+
+void QgsVectorLayerRenderer::stopRender()
+{
+  mRendererV2->stopRender( mContext );
+  mRendering = false;
+}
+
+bool QgsVectorLayerRenderer::nextFeature( QgsFeature& f )
+{
+  if ( mSharedConnection )
+  {
+    QMutexLocker locker( &sSharedConnectionMutex );
+    return mFit.nextFeature( f );
+  }
+
+  return mFit.nextFeature( f );
+}
+
+int QgsVectorLayerRenderer::nextFeatures( QgsFeatureList& features )
+{
+  if ( mSharedConnection )
+  {
+    QMutexLocker locker( &sSharedConnectionMutex );
+    return mFit.nextFeatures( features );
+  }
+
+  return mFit.nextFeatures( features );
+}
+
+bool QgsVectorLayerRenderer::acceptFeature( QgsFeature& f )
+{
+  if ( !mFilterExpression )
+    return true;
+
+  // an invalid filter does not match any feature
+  if ( mFilterExpression->hasParserError() )
+    return false;
+
+  return mFilterExpression->evaluate( &f ).toBool();
+}
+
+void QgsVectorLayerRenderer::registerLabelFeature( QgsFeature& f )
+{
+  if ( !mLabeling && !mDiagrams )
+    return;
+
+  QMutexLocker locker( &sLabelingMutex );
+  if ( mLabeling )
+  {
+    mContext.labelingEngine()->registerFeature( mLayer, f, mContext );
+  }
+  if ( mDiagrams )
+  {
+    mContext.labelingEngine()->registerDiagramFeature( mLayer, f, mContext );
+  }
+}
+
+void QgsVectorLayerRenderer::drawRendererV2()
+{
+  QgsFeatureList features;
+  bool stopped = false;
+  while ( !stopped && nextFeatures( features ) )
+  {
+    for ( QgsFeatureList::iterator it = features.begin(); it != features.end(); ++it )
+    {
+      QgsFeature& fet = *it;
+      try
+      {
+        if ( !fet.geometry() )
+          continue; // skip features without geometry
+
+        if ( mContext.renderingStopped() )
+        {
+          stopped = true;
+          break;
+        }
+
+        if ( !acceptFeature( fet ) )
+          continue;
+
+        bool sel = mSelectedFeatureIds.contains( fet.id() );
+
+        // render feature
+        bool rendered = mRendererV2->renderFeature( fet, mContext, -1, sel, false );
+
+        // labeling - register feature
+        if ( rendered )
+        {
+          registerLabelFeature( fet );
+        }
+      }
+      catch ( const QgsCsException &cse )
+      {
+        Q_UNUSED( cse );
+        QgsDebugMsg( QString( "Failed to transform a point while drawing a feature with ID '%1'. Ignoring this feature. %2" )
+                     .arg( fet.id() ).arg( cse.what() ) );
+      }
+    }
+  }
+}
+
+void QgsVectorLayerRenderer::drawRendererV2Levels()
+{
+  QHash< QgsSymbolV2*, QList<QgsFeature> > features; // key = symbol, value = array of features
+
+  // 1. fetch features
+  QgsFeature fet;
+  while ( nextFeature( fet ) )
+  {
+    if ( !fet.geometry() )
+      continue; // skip features without geometry
+
+    if ( mContext.renderingStopped() )
+    {
+      return;
+    }
+
+    if ( !acceptFeature( fet ) )
+      continue;
+
+    QgsSymbolV2* sym = mRendererV2->symbolForFeature( fet );
+    if ( !sym )
+    {
+      continue;
+    }
+
+    features[sym].append( fet );
+
+    registerLabelFeature( fet );
+  }
+
+  // find out the order
+  QgsSymbolV2LevelOrder levels;
+  QgsSymbolV2List symbols = mRendererV2->symbols();
+  for ( int i = 0; i < symbols.count(); i++ )
+  {
+    QgsSymbolV2* sym = symbols[i];
+    for ( int j = 0; j < sym->symbolLayerCount(); j++ )
+    {
+      int level = sym->symbolLayer( j )->renderingPass();
+      if ( level < 0 || level >= 1000 ) // ignore invalid levels
+        continue;
+      QgsSymbolV2LevelItem item( sym, j );
+      while ( level >= levels.count() ) // append new empty levels
+        levels.append( QgsSymbolV2Level() );
+      levels[level].append( item );
+    }
+  }
+
+  // 2. draw features in correct order
+  for ( int l = 0; l < levels.count(); l++ )
+  {
+    QgsSymbolV2Level& level = levels[l];
+    for ( int i = 0; i < level.count(); i++ )
+    {
+      QgsSymbolV2LevelItem& item = level[i];
+      if ( !features.contains( item.symbol() ) )
+      {
+        QgsDebugMsg( "level item's symbol not found!" );
+        continue;
+      }
+      int layer = item.layer();
+      QList<QgsFeature>& lst = features[item.symbol()];
+      QList<QgsFeature>::iterator fit;
+      for ( fit = lst.begin(); fit != lst.end(); ++fit )
+      {
+        if ( mContext.renderingStopped() )
+        {
+          return;
+        }
+
+        bool sel = mSelectedFeatureIds.contains( fit->id() );
+
+        try
+        {
+          mRendererV2->renderFeature( *fit, mContext, layer, sel, false );
+        }
+        catch ( const QgsCsException &cse )
+        {
+          Q_UNUSED( cse );
+          QgsDebugMsg( QString( "Failed to transform a point while drawing a feature with ID '%1'. Ignoring this feature. %2" )
+                       .arg( fit->id() ).arg( cse.what() ) );
+        }
+      }
+    }
+  }
+}
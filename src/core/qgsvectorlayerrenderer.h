@@ -0,0 +1,86 @@
+/***************************************************************************
+    qgsvectorlayerrenderer.h
+    ---------------------
+    begin                : January 2014
+    copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#ifndef QGSVECTORLAYERRENDERER_H
+#define QGSVECTORLAYERRENDERER_H
+
+#include "qgsmaplayerrenderer.h"
+#include "qgsfeatureiterator.h"
+#include "qgsfeature.h"
+
+class QgsExpression;
+class QgsFeatureRendererV2;
+class QgsRenderContext;
+class QgsVectorLayer;
+
+/** \ingroup core
+ * Snapshot of a vector layer for rendering outside of the main thread.
+ *
+ * The constructor (main thread) registers the layer with the labeling engine,
+ * clones the feature renderer, copies the selection and opens the feature
+ * iterator. render() then only works with those copies - calls to the
+ * labeling engine are serialized between all vector layer renderers.
+ *
+ * A layer override of the render context (filter, selection, opacity) is
+ * applied to the copies, the layer is not modified.
+ *
+ * @note added in 2.1
+ */
+class CORE_EXPORT QgsVectorLayerRenderer : public QgsMapLayerRenderer
+{
+  public:
+    QgsVectorLayerRenderer( QgsVectorLayer* layer, QgsRenderContext& context );
+    ~QgsVectorLayerRenderer();
+
+    virtual bool render();
+
+  protected:
+    void drawRendererV2();
+    void drawRendererV2Levels();
+
+    //! fetch next feature, serialized for providers with connections shared between layers
+    bool nextFeature( QgsFeature& f );
+    //! fetch next batch of features, serialized like nextFeature()
+    int nextFeatures( QgsFeatureList& features );
+
+    //! check the filter of the layer override if the provider doesn't apply it
+    bool acceptFeature( QgsFeature& f );
+
+    //! pass the feature to the labeling engine (labels and diagrams)
+    void registerLabelFeature( QgsFeature& f );
+
+    //! stop the cloned renderer
+    void stopRender();
+
+    QgsRenderContext& mContext;
+
+    //! read by the constructor in the main thread. render() only passes it to the labeling
+    //! engine, which uses it as a key and reads the labeling properties of the layer - the
+    //! map renderer does not process events, so the layer is not changed meanwhile
+    QgsVectorLayer* mLayer;
+
+    QgsFeatureRendererV2* mRendererV2;
+    bool mRendering;
+
+    QgsFeatureIterator mFit;
+    QgsFeatureIds mSelectedFeatureIds;
+
+    //! filter of the layer override evaluated locally (0 if there is none or the provider applies it)
+    QgsExpression* mFilterExpression;
+
+    bool mLabeling;
+    bool mDiagrams;
+    bool mSharedConnection;
+};
+
+#endif // QGSVECTORLAYERRENDERER_H
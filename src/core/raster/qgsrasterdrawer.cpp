@@ -17,14 +17,94 @@
 
 #include "qgslogger.h"
 #include "qgsrasterdrawer.h"
+#include "qgsrasterdataprovider.h"
 #include "qgsrasteriterator.h"
+#include "qgsrasterpipe.h"
 #include "qgsrasterviewport.h"
 #include "qgsmaptopixel.h"
 #include <QImage>
 #include <QPainter>
 #include <QPrinter>
+#include <QThread>
+#include <QtConcurrentMap>
 
-QgsRasterDrawer::QgsRasterDrawer( QgsRasterIterator* iterator ): mIterator( iterator )
+//minimum number of rows of a raster part read in parallel
+static const int MIN_PARALLEL_PART_ROWS = 64;
+
+/**Raster parts read by one thread with its own copy of the pipe*/
+struct RasterPartJob
+{
+  QgsRasterPipe* pipe;
+  QgsRectangle extent; //extent of the whole view port
+  int nCols; //columns of the whole view port
+  int nRows; //rows of the whole view port
+  QList<QRect> parts;
+  QList<QImage> images;
+};
+
+static void readRasterParts( RasterPartJob& job )
+{
+  QgsRasterInterface* input = job.pipe->last();
+  foreach ( const QRect& part, job.parts )
+  {
+    double xmin = job.extent.xMinimum() + part.left() / ( double )job.nCols * job.extent.width();
+    double xmax = job.extent.xMinimum() + ( part.left() + part.width() ) / ( double )job.nCols * job.extent.width();
+    double ymin = job.extent.yMaximum() - ( part.top() + part.height() ) / ( double )job.nRows * job.extent.height();
+    double ymax = job.extent.yMaximum() - part.top() / ( double )job.nRows * job.extent.height();
+
+    QgsRasterBlock* block = input ? input->block( 1, QgsRectangle( xmin, ymin, xmax, ymax ), part.width(), part.height() ) : 0;
+    job.images.append( block ? block->image() : QImage() );
+    delete block;
+  }
+}
+
+/**Copies a pipe including the provider settings which are not copied by clone()*/
+static QgsRasterPipe* clonePipe( const QgsRasterPipe* pipe )
+{
+  QgsRasterPipe* clonedPipe = new QgsRasterPipe( *pipe );
+  QgsRasterDataProvider* provider = pipe->provider();
+  QgsRasterDataProvider* clonedProvider = clonedPipe->provider();
+  if ( provider && clonedProvider )
+  {
+    for ( int bandNo = 1; bandNo <= provider->bandCount(); bandNo++ )
+    {
+      clonedProvider->setUseSrcNoDataValue( bandNo, provider->useSrcNoDataValue( bandNo ) );
+      clonedProvider->setUserNoDataValue( bandNo, provider->userNoDataValues( bandNo ) );
+    }
+    clonedProvider->setDpi( provider->dpi() );
+  }
+  return clonedPipe;
+}
+
+/**Because of bug in Acrobat Reader we must use "white" transparent color instead
+  of "black" for PDF. See #9101.*/
+static QImage imageForDevice( QPainter* p, const QImage& image )
+{
+  QPrinter *printer = dynamic_cast<QPrinter *>( p->device() );
+  if ( !printer || printer->outputFormat() != QPrinter::PdfFormat )
+  {
+    return image;
+  }
+
+  QgsDebugMsg( "PdfFormat" );
+
+  QImage img = image.convertToFormat( QImage::Format_ARGB32 );
+  QRgb transparentBlack = qRgba( 0, 0, 0, 0 );
+  QRgb transparentWhite = qRgba( 255, 255, 255, 0 );
+  for ( int x = 0; x < img.width(); x++ )
+  {
+    for ( int y = 0; y < img.height(); y++ )
+    {
+      if ( img.pixel( x, y ) == transparentBlack )
+      {
+        img.setPixel( x, y, transparentWhite );
+      }
+    }
+  }
+  return img;
+}
+
+QgsRasterDrawer::QgsRasterDrawer( QgsRasterIterator* iterator ): mIterator( iterator ), mParallelPipe( 0 ), mThreadCount( 0 )
 {
 }
 
@@ -40,6 +120,11 @@ void QgsRasterDrawer::draw( QPainter* p, QgsRasterViewPort* viewPort, const QgsM
     return;
   }
 
+  if ( mParallelPipe && drawParallel( p, viewPort ) )
+  {
+    return;
+  }
+
   // last pipe filter has only 1 band
   int bandNumber = 1;
   mIterator->startRasterRead( bandNumber, viewPort->mWidth, viewPort->mHeight, viewPort->mDrawnExtent );
@@ -65,34 +150,77 @@ void QgsRasterDrawer::draw( QPainter* p, QgsRasterViewPort* viewPort, const QgsM
       continue;
     }
 
-    QImage img = block->image();
+    QImage img = imageForDevice( p, block->image() );
+    drawImage( p, viewPort, img, topLeftCol, topLeftRow );
+
+    delete block;
+  }
+}
+
+void QgsRasterDrawer::setParallelPipe( const QgsRasterPipe* pipe, int threadCount )
+{
+  mParallelPipe = pipe;
+  mThreadCount = threadCount;
+}
+
+bool QgsRasterDrawer::drawParallel( QPainter* p, QgsRasterViewPort* viewPort )
+{
+  int nCols = viewPort->mWidth;
+  int nRows = viewPort->mHeight;
+  int threadCount = mThreadCount > 0 ? mThreadCount : QThread::idealThreadCount();
+  if ( threadCount < 2 || nCols < 1 || nRows < 2 * MIN_PARALLEL_PART_ROWS || mParallelPipe->last() != mIterator->input() )
+  {
+    return false;
+  }
 
-    // Because of bug in Acrobat Reader we must use "white" transparent color instead
-    // of "black" for PDF. See #9101.
-    QPrinter *printer = dynamic_cast<QPrinter *>( p->device() );
-    if ( printer && printer->outputFormat() == QPrinter::PdfFormat )
+  //strips of the view port (split again if wider than the maximum tile width),
+  //four per thread to balance differences in the reading time
+  int partRows = qBound( MIN_PARALLEL_PART_ROWS, ( nRows + 4 * threadCount - 1 ) / ( 4 * threadCount ), mIterator->maximumTileHeight() );
+  int partCols = qMax( 1, mIterator->maximumTileWidth() );
+  QList<QRect> parts;
+  for ( int row = 0; row < nRows; row += partRows )
+  {
+    for ( int col = 0; col < nCols; col += partCols )
     {
-      QgsDebugMsg( "PdfFormat" );
+      parts.append( QRect( col, row, qMin( partCols, nCols - col ), qMin( partRows, nRows - row ) ) );
+    }
+  }
+  threadCount = qMin( threadCount, parts.size() );
+
+  QList<RasterPartJob> jobs;
+  for ( int i = 0; i < threadCount; ++i )
+  {
+    RasterPartJob job;
+    job.pipe = clonePipe( mParallelPipe );
+    job.extent = viewPort->mDrawnExtent;
+    job.nCols = nCols;
+    job.nRows = nRows;
+    jobs.append( job );
+  }
+  for ( int i = 0; i < parts.size(); ++i )
+  {
+    jobs[i % threadCount].parts.append( parts.at( i ) );
+  }
 
-      img = img.convertToFormat( QImage::Format_ARGB32 );
-      QRgb transparentBlack = qRgba( 0, 0, 0, 0 );
-      QRgb transparentWhite = qRgba( 255, 255, 255, 0 );
-      for ( int x = 0; x < img.width(); x++ )
+  QgsDebugMsg( QString( "Reading %1 raster parts with %2 threads" ).arg( parts.size() ).arg( threadCount ) );
+  QtConcurrent::blockingMap( jobs, readRasterParts );
+
+  for ( int i = 0; i < jobs.size(); ++i )
+  {
+    const RasterPartJob& job = jobs.at( i );
+    for ( int j = 0; j < job.parts.size(); ++j )
+    {
+      const QImage& img = job.images.at( j );
+      if ( img.isNull() )
       {
-        for ( int y = 0; y < img.height(); y++ )
-        {
-          if ( img.pixel( x, y ) == transparentBlack )
-          {
-            img.setPixel( x, y, transparentWhite );
-          }
-        }
+        QgsDebugMsg( "Cannot get block" );
+        continue;
       }
+      drawImage( p, viewPort, imageForDevice( p, img ), job.parts.at( j ).left(), job.parts.at( j ).top() );
     }
-
-    drawImage( p, viewPort, img, topLeftCol, topLeftRow );
-
-    delete block;
+    delete job.pipe;
   }
+  return true;
 }
 
 void QgsRasterDrawer::drawImage( QPainter* p, QgsRasterViewPort* viewPort, const QImage& img, int topLeftCol, int topLeftRow ) const
@@ -26,6 +26,7 @@ class QImage;
 class QgsMapToPixel;
 struct QgsRasterViewPort;
 class QgsRasterIterator;
+class QgsRasterPipe;
 
 /** \ingroup core
  * The drawing pipe for raster layers.
@@ -38,6 +39,13 @@ class CORE_EXPORT QgsRasterDrawer
 
     void draw( QPainter* p, QgsRasterViewPort* viewPort, const QgsMapToPixel* theQgsMapToPixel );
 
+    /**Enables reading the raster parts in parallel. Every thread reads its parts through an own copy of the pipe,
+      so the data provider has to open an own data source handle in clone() (e.g. GDAL).
+      The last interface of the pipe has to be the input of the iterator
+      @param pipe pipe to copy for the threads (does not take ownership) or 0 to read sequentially
+      @param threadCount maximum number of threads (0: number of processor cores)*/
+    void setParallelPipe( const QgsRasterPipe* pipe, int threadCount = 0 );
+
   protected:
     /**Draws raster part
       @param p the painter to draw to
@@ -47,8 +55,14 @@ class CORE_EXPORT QgsRasterDrawer
       @param topLeftRow Top position relative to top border of viewport*/
     void drawImage( QPainter* p, QgsRasterViewPort* viewPort, const QImage& img, int topLeftCol, int topLeftRow ) const;
 
+    /**Reads the raster parts with copies of the parallel pipe and draws them
+      @return false if the view port is too small to be split*/
+    bool drawParallel( QPainter* p, QgsRasterViewPort* viewPort );
+
   private:
     QgsRasterIterator* mIterator;
+    const QgsRasterPipe* mParallelPipe;
+    int mThreadCount;
 };
 
 #endif // QGSRASTERDRAWER_H
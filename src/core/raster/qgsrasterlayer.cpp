@@ -31,6 +31,7 @@ email                : tim at linfiniti.com
 #include "qgsrasterdrawer.h"
 #include "qgsrasteriterator.h"
 #include "qgsrasterlayer.h"
+#include "qgsrasterlayerrenderer.h"
 #include "qgsrasterprojector.h"
 #include "qgsrasterrange.h"
 #include "qgsrasterrendererregistry.h"
@@ -263,6 +264,36 @@ bool QgsRasterLayer::draw( QgsRenderContext& rendererContext )
     return false;
   }
 
+  QPainter* theQPainter = rendererContext.painter();
+
+  if ( !theQPainter )
+  {
+    return false;
+  }
+
+  QgsRasterViewPort *myRasterViewPort = createRasterViewPort( rendererContext );
+  if ( !myRasterViewPort )
+  {
+    // nothing to do
+    return true;
+  }
+
+  mLastViewPort = *myRasterViewPort;
+
+  // TODO: is it necessary? Probably WMS only?
+  mDataProvider->setDpi( rendererContext.rasterScaleFactor() * 25.4 * rendererContext.scaleFactor() );
+
+  draw( theQPainter, myRasterViewPort, &rendererContext.mapToPixel() );
+
+  delete myRasterViewPort;
+  QgsDebugMsg( "exiting." );
+
+  return true;
+
+}
+
+QgsRasterViewPort* QgsRasterLayer::createRasterViewPort( QgsRenderContext& rendererContext )
+{
   const QgsMapToPixel& theQgsMapToPixel = rendererContext.mapToPixel();
 
   QgsRectangle myProjectedViewExtent;
@@ -298,20 +329,13 @@ bool QgsRasterLayer::draw( QgsRenderContext& rendererContext )
     myProjectedLayerExtent = extent();
   }
 
-  QPainter* theQPainter = rendererContext.painter();
-
-  if ( !theQPainter )
-  {
-    return false;
-  }
-
   // clip raster extent to view extent
   QgsRectangle myRasterExtent = myProjectedViewExtent.intersect( &myProjectedLayerExtent );
   if ( myRasterExtent.isEmpty() )
   {
     QgsDebugMsg( "draw request outside view extent." );
     // nothing to do
-    return true;
+    return 0;
   }
 
   QgsDebugMsg( "theViewExtent is " + rendererContext.extent().toString() );
@@ -391,20 +415,25 @@ bool QgsRasterLayer::draw( QgsRenderContext& rendererContext )
   QgsDebugMsgLevel( QString( "mWidth = %1" ).arg( myRasterViewPort->mWidth ), 3 );
   QgsDebugMsgLevel( QString( "mHeight = %1" ).arg( myRasterViewPort->mHeight ), 3 );
 
-  // /\/\/\ - added to handle zoomed-in rasters
-
-  mLastViewPort = *myRasterViewPort;
-
-  // TODO: is it necessary? Probably WMS only?
-  mDataProvider->setDpi( rendererContext.rasterScaleFactor() * 25.4 * rendererContext.scaleFactor() );
-
-  draw( theQPainter, myRasterViewPort, &theQgsMapToPixel );
+  return myRasterViewPort;
+}
 
-  delete myRasterViewPort;
-  QgsDebugMsg( "exiting." );
+QgsMapLayerRenderer* QgsRasterLayer::createMapRenderer( QgsRenderContext& rendererContext )
+{
+  // only the GDAL provider is cheap to clone and does not depend on
+  // the main thread's event loop (unlike the network based providers)
+  if ( !mDataProvider || mProviderKey != "gdal" )
+  {
+    return 0;
+  }
 
-  return true;
+  // Check timestamp
+  if ( !update() )
+  {
+    return 0;
+  }
 
+  return new QgsRasterLayerRenderer( this, rendererContext );
 }
 
 void QgsRasterLayer::draw( QPainter * theQPainter,
@@ -433,6 +462,13 @@ void QgsRasterLayer::draw( QPainter * theQPainter,
   // Drawer to pipe?
   QgsRasterIterator iterator( mPipe.last() );
   QgsRasterDrawer drawer( &iterator );
+
+  // the parts are read with copies of the pipe, which needs an own dataset handle per provider copy
+  QSettings settings;
+  if ( mProviderKey == "gdal" && settings.value( "/qgis/parallel_raster_parts", false ).toBool() )
+  {
+    drawer.setParallelPipe( &mPipe );
+  }
   drawer.draw( theQPainter, theRasterViewPort, theQgsMapToPixel );
 
   QgsDebugMsg( QString( "total raster draw time (ms):     %1" ).arg( time.elapsed(), 5 ) );
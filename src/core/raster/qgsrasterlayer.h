@@ -291,6 +291,12 @@ class CORE_EXPORT QgsRasterLayer : public QgsMapLayer
     /** \brief This is called when the view on the raster layer needs to be redrawn */
     bool draw( QgsRenderContext& rendererContext );
 
+    /** \brief Returns a snapshot of the layer with its own copy of the raster pipe
+     *  that can be drawn in a worker thread, or 0 if the provider does not support it
+     *  @note added in 2.1
+     */
+    QgsMapLayerRenderer* createMapRenderer( QgsRenderContext& rendererContext );
+
     /** \brief This is an overloaded version of the draw() function that is called by both draw() and thumbnailAsPixmap */
     void draw( QPainter * theQPainter,
                QgsRasterViewPort * myRasterViewPort,
@@ -414,6 +420,10 @@ class CORE_EXPORT QgsRasterLayer : public QgsMapLayer
     /** \brief Update the layer if it is outdated */
     bool update();
 
+    /** \brief Set up the view port of the visible part of the raster for the given context.
+     *  Returns 0 if the raster is outside the view extent. Caller takes ownership */
+    QgsRasterViewPort* createRasterViewPort( QgsRenderContext& rendererContext );
+
     /**Sets corresponding renderer for style*/
     void setRendererForDrawingStyle( const QgsRaster::DrawingStyle &  theDrawingStyle );
 
@@ -443,6 +453,8 @@ class CORE_EXPORT QgsRasterLayer : public QgsMapLayer
     LayerType mRasterType;
 
     QgsRasterPipe mPipe;
+
+    friend class QgsRasterLayerRenderer;
 };
 
 #endif
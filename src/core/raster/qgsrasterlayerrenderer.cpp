@@ -0,0 +1,111 @@
+/***************************************************************************
+                         qgsrasterlayerrenderer.cpp
+                         -------------------
+    begin                : January 2014
+    copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgsrasterlayerrenderer.h"
+
+#include "qgslogger.h"
+#include "qgsrasterdataprovider.h"
+#include "qgsrasterdrawer.h"
+#include "qgsrasteriterator.h"
+#include "qgsrasterlayer.h"
+#include "qgsrasterpipe.h"
+#include "qgsrasterprojector.h"
+#include "qgsrasterrenderer.h"
+#include "qgsrasterviewport.h"
+#include "qgsrendercontext.h"
+
+#include <QSettings>
+#include <QTime>
+
+QgsRasterLayerRenderer::QgsRasterLayerRenderer( QgsRasterLayer* layer, QgsRenderContext& rendererContext )
+    : QgsMapLayerRenderer( layer->id() )
+    , mContext( rendererContext )
+    , mRasterViewPort( 0 )
+    , mPipe( 0 )
+    , mParallelParts( false )
+{
+  mRasterViewPort = layer->createRasterViewPort( rendererContext );
+  if ( !mRasterViewPort )
+  {
+    // outside of the view extent - nothing to do
+    return;
+  }
+
+  layer->mLastViewPort = *mRasterViewPort;
+
+  // the parts are read with copies of the pipe, which needs an own dataset handle per provider copy
+  QSettings settings;
+  mParallelParts = layer->providerType() == "gdal" && settings.value( "/qgis/parallel_raster_parts", false ).toBool();
+
+  // the pipe is cloned together with the provider, so each renderer works with its own dataset handle
+  mPipe = new QgsRasterPipe( layer->mPipe );
+
+  // clone() only takes the data source, copy the settings the user may have changed
+  QgsRasterDataProvider* provider = layer->mDataProvider;
+  QgsRasterDataProvider* clonedProvider = mPipe->provider();
+  if ( clonedProvider )
+  {
+    for ( int bandNo = 1; bandNo <= provider->bandCount(); bandNo++ )
+    {
+      clonedProvider->setUseSrcNoDataValue( bandNo, provider->useSrcNoDataValue( bandNo ) );
+      clonedProvider->setUserNoDataValue( bandNo, provider->userNoDataValues( bandNo ) );
+    }
+    clonedProvider->setDpi( rendererContext.rasterScaleFactor() * 25.4 * rendererContext.scaleFactor() );
+  }
+
+  // opacity requested for this rendering only, the layer's renderer is left untouched
+  QgsRasterRenderer* renderer = mPipe->renderer();
+  if ( renderer && rendererContext.hasLayerOverride( layer->id() ) )
+  {
+    renderer->setOpacity( renderer->opacity() * rendererContext.layerOverride( layer->id() ).opacity );
+  }
+}
+
+QgsRasterLayerRenderer::~QgsRasterLayerRenderer()
+{
+  delete mRasterViewPort;
+  delete mPipe;
+}
+
+bool QgsRasterLayerRenderer::render()
+{
+  if ( !mRasterViewPort )
+    return true; // nothing to draw
+
+  if ( !mPipe || !mPipe->provider() || !mContext.painter() )
+    return false;
+
+  QTime time;
+  time.start();
+
+  QgsRasterProjector *projector = mPipe->projector();
+  if ( projector )
+  {
+    projector->setCRS( mRasterViewPort->mSrcCRS, mRasterViewPort->mDestCRS, mRasterViewPort->mSrcDatumTransform, mRasterViewPort->mDestDatumTransform );
+  }
+
+  QgsRasterIterator iterator( mPipe->last() );
+  QgsRasterDrawer drawer( &iterator );
+  if ( mParallelParts )
+  {
+    drawer.setParallelPipe( mPipe );
+  }
+  drawer.draw( mContext.painter(), mRasterViewPort, &mContext.mapToPixel() );
+
+  QgsDebugMsg( QString( "total raster draw time (ms):     %1" ).arg( time.elapsed(), 5 ) );
+
+  return true;
+}
@@ -0,0 +1,53 @@
+/***************************************************************************
+                         qgsrasterlayerrenderer.h
+                         -------------------
+    begin                : January 2014
+    copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSRASTERLAYERRENDERER_H
+#define QGSRASTERLAYERRENDERER_H
+
+#include "qgsmaplayerrenderer.h"
+
+class QgsRasterLayer;
+class QgsRasterPipe;
+class QgsRenderContext;
+struct QgsRasterViewPort;
+
+/** \ingroup core
+ * Snapshot of a raster layer for rendering outside of the main thread.
+ * The constructor computes the view port and clones the layer's pipe
+ * (including the data provider), render() only uses the cloned pipe.
+ * @note added in 2.1
+ */
+class CORE_EXPORT QgsRasterLayerRenderer : public QgsMapLayerRenderer
+{
+  public:
+    QgsRasterLayerRenderer( QgsRasterLayer* layer, QgsRenderContext& rendererContext );
+    ~QgsRasterLayerRenderer();
+
+    virtual bool render();
+
+  protected:
+    QgsRenderContext& mContext;
+
+    //! 0 if the layer is outside the view extent
+    QgsRasterViewPort* mRasterViewPort;
+
+    QgsRasterPipe* mPipe;
+
+    //! read the raster parts in parallel (setting /qgis/parallel_raster_parts)
+    bool mParallelParts;
+};
+
+#endif // QGSRASTERLAYERRENDERER_H
@@ -21,6 +21,45 @@
 #include "qgsrasterprojector.h"
 #include "qgscoordinatetransform.h"
 
+#include <QCache>
+#include <QMutex>
+#include <QMutexLocker>
+
+/** Calculated matrix and source extent of a destination grid */
+struct QgsRasterProjectorGrid
+{
+  QList< QList<QgsPoint> > cpMatrix;
+  QList< QList<bool> > cpLegalMatrix;
+  int cpRows;
+  int cpCols;
+  bool approximate;
+  QgsRectangle srcExtent;
+  int srcRows;
+  int srcCols;
+  //source indexes of the destination pixels (only if requested with setPrecomputeIndexMap)
+  QVector<qgssize> srcIndexes;
+};
+
+//source index of destination pixels outside of the source
+static const qgssize OUTSIDE_SOURCE_INDEX = ( qgssize ) - 1;
+
+//grids of all projectors, the cost is the size in KiB
+static QCache<QString, QgsRasterProjectorGrid> sProjectorGrids( 32 * 1024 );
+static QMutex sProjectorGridsMutex;
+static int sProjectorGridHits = 0;
+static int sProjectorGridMisses = 0;
+
+static int gridCost( const QgsRasterProjectorGrid* grid )
+{
+  return qMax( 1, ( int )(( grid->cpRows * grid->cpCols * ( sizeof( QgsPoint ) + sizeof( bool ) ) + grid->srcIndexes.size() * sizeof( qgssize ) ) / 1024 ) );
+}
+
+static QString rectangleKey( const QgsRectangle& rect )
+{
+  return QString( "%1,%2,%3,%4" ).arg( rect.xMinimum(), 0, 'g', 17 ).arg( rect.yMinimum(), 0, 'g', 17 )
+         .arg( rect.xMaximum(), 0, 'g', 17 ).arg( rect.yMaximum(), 0, 'g', 17 );
+}
+
 QgsRasterProjector::QgsRasterProjector(
   QgsCoordinateReferenceSystem theSrcCRS,
   QgsCoordinateReferenceSystem theDestCRS,
@@ -40,6 +79,7 @@ QgsRasterProjector::QgsRasterProjector(
     , mDestRows( theDestRows ), mDestCols( theDestCols )
     , pHelperTop( 0 ), pHelperBottom( 0 )
     , mMaxSrcXRes( theMaxSrcXRes ), mMaxSrcYRes( theMaxSrcYRes )
+    , mPrecomputeIndexMap( false )
 {
   QgsDebugMsg( "Entered" );
   QgsDebugMsg( "theDestExtent = " + theDestExtent.toString() );
@@ -64,6 +104,7 @@ QgsRasterProjector::QgsRasterProjector(
     , mDestRows( theDestRows ), mDestCols( theDestCols )
     , pHelperTop( 0 ), pHelperBottom( 0 )
     , mMaxSrcXRes( theMaxSrcXRes ), mMaxSrcYRes( theMaxSrcYRes )
+    , mPrecomputeIndexMap( false )
 {
   QgsDebugMsg( "Entered" );
   QgsDebugMsg( "theDestExtent = " + theDestExtent.toString() );
@@ -84,12 +125,13 @@ QgsRasterProjector::QgsRasterProjector(
     , mExtent( theExtent )
     , pHelperTop( 0 ), pHelperBottom( 0 )
     , mMaxSrcXRes( theMaxSrcXRes ), mMaxSrcYRes( theMaxSrcYRes )
+    , mPrecomputeIndexMap( false )
 {
   QgsDebugMsg( "Entered" );
 }
 
 QgsRasterProjector::QgsRasterProjector()
-    : QgsRasterInterface( 0 ), mSrcDatumTransform( -1 ), mDestDatumTransform( -1 ) , pHelperTop( 0 ), pHelperBottom( 0 )
+    : QgsRasterInterface( 0 ), mSrcDatumTransform( -1 ), mDestDatumTransform( -1 ) , pHelperTop( 0 ), pHelperBottom( 0 ), mPrecomputeIndexMap( false )
 {
   QgsDebugMsg( "Entered" );
 }
@@ -104,6 +146,7 @@ QgsRasterProjector::QgsRasterProjector( const QgsRasterProjector &projector )
   mMaxSrcXRes = projector.mMaxSrcXRes;
   mMaxSrcYRes = projector.mMaxSrcYRes;
   mExtent = projector.mExtent;
+  mPrecomputeIndexMap = projector.mPrecomputeIndexMap;
 }
 
 QgsRasterProjector & QgsRasterProjector::operator=( const QgsRasterProjector & projector )
@@ -117,6 +160,7 @@ QgsRasterProjector & QgsRasterProjector::operator=( const QgsRasterProjector & p
     mMaxSrcXRes = projector.mMaxSrcXRes;
     mMaxSrcYRes = projector.mMaxSrcYRes;
     mExtent = projector.mExtent;
+    mPrecomputeIndexMap = projector.mPrecomputeIndexMap;
   }
   return *this;
 }
@@ -127,6 +171,7 @@ QgsRasterInterface * QgsRasterProjector::clone() const
   QgsRasterProjector * projector = new QgsRasterProjector( mSrcCRS, mDestCRS, mMaxSrcXRes, mMaxSrcYRes, mExtent );
   projector->mSrcDatumTransform = mSrcDatumTransform;
   projector->mDestDatumTransform = mDestDatumTransform;
+  projector->mPrecomputeIndexMap = mPrecomputeIndexMap;
   return projector;
 }
 
@@ -196,6 +241,15 @@ void QgsRasterProjector::calc()
   double myDestRes = mDestXRes < mDestYRes ? mDestXRes : mDestYRes;
   mSqrTolerance = myDestRes * myDestRes;
 
+  // Panning and tile requests often repeat the same destination grid
+  mGridKey = gridKey();
+  if ( loadGrid( mGridKey ) )
+  {
+    QgsDebugMsg( QString( "CPMatrix from cache: mCPRows = %1 mCPCols = %2" ).arg( mCPRows ).arg( mCPCols ) );
+    initHelpers();
+    return;
+  }
+
   const QgsCoordinateTransform* ct = QgsCoordinateTransformCache::instance()->transform( mDestCRS.authid(), mSrcCRS.authid(), mDestDatumTransform, mSrcDatumTransform );
 
   // Initialize the matrix by corners and middle points
@@ -247,8 +301,6 @@ void QgsRasterProjector::calc()
     }
   }
   QgsDebugMsg( QString( "CPMatrix size: mCPRows = %1 mCPCols = %2" ).arg( mCPRows ).arg( mCPCols ) );
-  mDestRowsPerMatrixRow = ( float )mDestRows / ( mCPRows - 1 );
-  mDestColsPerMatrixCol = ( float )mDestCols / ( mCPCols - 1 );
 
   QgsDebugMsgLevel( "CPMatrix:", 5 );
   QgsDebugMsgLevel( cpToString(), 5 );
@@ -256,6 +308,15 @@ void QgsRasterProjector::calc()
   // Calculate source dimensions
   calcSrcExtent();
   calcSrcRowsCols();
+  storeGrid( mGridKey );
+
+  initHelpers();
+}
+
+void QgsRasterProjector::initHelpers()
+{
+  mDestRowsPerMatrixRow = ( float )mDestRows / ( mCPRows - 1 );
+  mDestColsPerMatrixCol = ( float )mDestCols / ( mCPCols - 1 );
   mSrcYRes = mSrcExtent.height() / mSrcRows;
   mSrcXRes = mSrcExtent.width() / mSrcCols;
 
@@ -267,6 +328,97 @@ void QgsRasterProjector::calc()
   mHelperTopRow = 0;
 }
 
+QString QgsRasterProjector::gridKey() const
+{
+  return QString( "%1|%2|%3|%4|%5|%6|%7|%8|%9" ).arg( mSrcCRS.authid() ).arg( mDestCRS.authid() )
+         .arg( mSrcDatumTransform ).arg( mDestDatumTransform )
+         .arg( rectangleKey( mDestExtent ) ).arg( mDestCols ).arg( mDestRows )
+         .arg( rectangleKey( mExtent ) )
+         .arg( QString( "%1,%2" ).arg( mMaxSrcXRes, 0, 'g', 17 ).arg( mMaxSrcYRes, 0, 'g', 17 ) );
+}
+
+bool QgsRasterProjector::loadGrid( const QString& key )
+{
+  QMutexLocker locker( &sProjectorGridsMutex );
+  QgsRasterProjectorGrid* grid = sProjectorGrids.object( key );
+  if ( !grid )
+  {
+    ++sProjectorGridMisses;
+    return false;
+  }
+  ++sProjectorGridHits;
+
+  mCPMatrix = grid->cpMatrix;
+  mCPLegalMatrix = grid->cpLegalMatrix;
+  mCPRows = grid->cpRows;
+  mCPCols = grid->cpCols;
+  mApproximate = grid->approximate;
+  mSrcExtent = grid->srcExtent;
+  mSrcRows = grid->srcRows;
+  mSrcCols = grid->srcCols;
+  return true;
+}
+
+void QgsRasterProjector::storeGrid( const QString& key ) const
+{
+  QgsRasterProjectorGrid* grid = new QgsRasterProjectorGrid;
+  grid->cpMatrix = mCPMatrix;
+  grid->cpLegalMatrix = mCPLegalMatrix;
+  grid->cpRows = mCPRows;
+  grid->cpCols = mCPCols;
+  grid->approximate = mApproximate;
+  grid->srcExtent = mSrcExtent;
+  grid->srcRows = mSrcRows;
+  grid->srcCols = mSrcCols;
+
+  QMutexLocker locker( &sProjectorGridsMutex );
+  sProjectorGrids.insert( key, grid, gridCost( grid ) );
+}
+
+void QgsRasterProjector::gridCacheStatistics( int& hits, int& misses )
+{
+  QMutexLocker locker( &sProjectorGridsMutex );
+  hits = sProjectorGridHits;
+  misses = sProjectorGridMisses;
+}
+
+QVector<qgssize> QgsRasterProjector::sourceIndexMap()
+{
+  {
+    QMutexLocker locker( &sProjectorGridsMutex );
+    QgsRasterProjectorGrid* grid = sProjectorGrids.object( mGridKey );
+    if ( grid && !grid->srcIndexes.isEmpty() )
+    {
+      return grid->srcIndexes;
+    }
+  }
+
+  const QgsCoordinateTransform* ct = QgsCoordinateTransformCache::instance()->transform( mDestCRS.authid(), mSrcCRS.authid(), mDestDatumTransform, mSrcDatumTransform );
+  QVector<qgssize> srcIndexes( mDestRows * mDestCols, OUTSIDE_SOURCE_INDEX );
+  int srcRow, srcCol;
+  for ( int i = 0; i < mDestRows; ++i )
+  {
+    for ( int j = 0; j < mDestCols; ++j )
+    {
+      if ( preciseSrcRowCol( i, j, &srcRow, &srcCol, ct ) )
+      {
+        srcIndexes[i * mDestCols + j] = ( qgssize )srcRow * mSrcCols + srcCol;
+      }
+    }
+  }
+
+  // keep the map with the grid (which may have been removed from the cache in the meantime)
+  QMutexLocker locker( &sProjectorGridsMutex );
+  QgsRasterProjectorGrid* grid = sProjectorGrids.object( mGridKey );
+  if ( grid )
+  {
+    QgsRasterProjectorGrid* indexGrid = new QgsRasterProjectorGrid( *grid );
+    indexGrid->srcIndexes = srcIndexes;
+    sProjectorGrids.insert( mGridKey, indexGrid, gridCost( indexGrid ) );
+  }
+  return srcIndexes;
+}
+
 void QgsRasterProjector::calcSrcExtent()
 {
   /* Run around the mCPMatrix and find source extent */
@@ -844,15 +996,32 @@ QgsRasterBlock * QgsRasterProjector::block( int bandNo, QgsRectangle  const & ex
 
   outputBlock->setIsNoData();
 
+  QVector<qgssize> srcIndexes;
+  if ( mPrecomputeIndexMap )
+  {
+    srcIndexes = sourceIndexMap();
+  }
+
   int srcRow, srcCol;
   for ( int i = 0; i < height; ++i )
   {
     for ( int j = 0; j < width; ++j )
     {
-      bool inside = srcRowCol( i, j, &srcRow, &srcCol, ct );
-      if ( !inside ) continue; // we have everything set to no data
+      qgssize srcIndex;
+      if ( mPrecomputeIndexMap )
+      {
+        srcIndex = srcIndexes.at( i * width + j );
+        if ( srcIndex == OUTSIDE_SOURCE_INDEX ) continue; // we have everything set to no data
+        srcRow = ( int )( srcIndex / mSrcCols );
+        srcCol = ( int )( srcIndex % mSrcCols );
+      }
+      else
+      {
+        bool inside = srcRowCol( i, j, &srcRow, &srcCol, ct );
+        if ( !inside ) continue; // we have everything set to no data
 
-      qgssize srcIndex = ( qgssize )srcRow * mSrcCols + srcCol;
+        srcIndex = ( qgssize )srcRow * mSrcCols + srcCol;
+      }
       QgsDebugMsgLevel( QString( "row = %1 col = %2 srcRow = %3 srcCol = %4" ).arg( i ).arg( j ).arg( srcRow ).arg( srcCol ), 5 );
 
       // isNoData() may be slow so we check doNoData first
@@ -101,6 +101,19 @@ class CORE_EXPORT QgsRasterProjector : public QgsRasterInterface
       mMaxSrcXRes = theMaxSrcXRes; mMaxSrcYRes = theMaxSrcYRes;
     }
 
+    /** \brief Calculate the source pixel of every destination pixel with the exact transformation.
+     * The index maps are cached together with the approximation grids, repeated requests
+     * for the same destination grid (e.g. tiles) skip all projection calculations.
+     * Needs 8 bytes (a qgssize source index) per destination pixel
+     * @note added in 2.1 */
+    void setPrecomputeIndexMap( bool precompute ) { mPrecomputeIndexMap = precompute; }
+    bool precomputeIndexMap() const { return mPrecomputeIndexMap; }
+
+    /** \brief Number of destination grids found in the grid cache (hits) or calculated (misses)
+     * by all projectors of the process
+     * @note added in 2.1 */
+    static void gridCacheStatistics( int& hits, int& misses );
+
     QgsRasterBlock *block( int bandNo, const QgsRectangle & extent, int width, int height );
 
   private:
@@ -141,6 +154,23 @@ class CORE_EXPORT QgsRasterProjector : public QgsRasterInterface
     /** \brief Calculate matrix */
     void calc();
 
+    /** \brief Key of the current grid in the cache of calculated matrices */
+    QString gridKey() const;
+
+    /** \brief Copy matrix and source extent from the cache
+      * returns false if the grid is not cached */
+    bool loadGrid( const QString& key );
+
+    /** \brief Insert matrix and source extent into the cache */
+    void storeGrid( const QString& key ) const;
+
+    /** \brief Calculate matrix row/col sizes, source resolution and helper points */
+    void initHelpers();
+
+    /** \brief Source indexes (row * source cols + col, the maximum qgssize if outside) of all destination pixels,
+      * calculated with the exact transformation or taken from the cache */
+    QVector<qgssize> sourceIndexMap();
+
     /** \brief insert rows to matrix */
     void insertRows( const QgsCoordinateTransform* ct );
 
@@ -262,6 +292,12 @@ class CORE_EXPORT QgsRasterProjector : public QgsRasterInterface
 
     /** Use approximation */
     bool mApproximate;
+
+    /** Key of the current grid in the cache */
+    QString mGridKey;
+
+    /** Calculate exact source indexes of all destination pixels */
+    bool mPrecomputeIndexMap;
 };
 
 #endif
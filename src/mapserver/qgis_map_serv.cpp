@@ -245,7 +245,10 @@ int main( int argc, char * argv[] )
 
   //creating QgsMapRenderer is expensive (access to srs.db), so we do it here before the fcgi loop
   QgsMapRenderer* theMapRenderer = new QgsMapRenderer();
-  theMapRenderer->setLabelingEngine( new QgsPalLabeling() );
+  //every request renders other layers, styles or parameters. Keeping the labels of the last request is not worth the key
+  QgsPalLabeling* labelingEngine = new QgsPalLabeling();
+  labelingEngine->setUsingPlacementCache( false );
+  theMapRenderer->setLabelingEngine( labelingEngine );
 
 #ifdef QGSMSDEBUG
   // load standard test font from testdata.qrc (for unit tests)
@@ -426,21 +429,13 @@ int main( int argc, char * argv[] )
       }
       else if ( request.compare( "GetCoverage", Qt::CaseInsensitive ) == 0 )
       {
-        QByteArray* coverageOutput;
         try
         {
-          coverageOutput = theServer->getCoverage();
+          theServer->getCoverage( *theRequestHandler );
         }
         catch ( QgsMapServiceException& ex )
         {
           theRequestHandler->sendServiceException( ex );
-          delete theRequestHandler;
-          delete theServer;
-          continue;
-        }
-        if ( coverageOutput )
-        {
-          theRequestHandler->sendGetCoverageResponse( coverageOutput );
         }
         delete theRequestHandler;
         delete theServer;
@@ -569,6 +564,7 @@ int main( int argc, char * argv[] )
 
     adminConfigParser->loadLabelSettings( theMapRenderer->labelingEngine() );
     theServer->setAdminConfigParser( adminConfigParser );
+    theServer->setConfigFilePath( configFilePath );
 
 
     //request type
@@ -21,7 +21,9 @@
 #include "qgsprojectfiletransform.h"
 #include "qgsprojectparser.h"
 #include "qgssldparser.h"
+#include "qgswmstilecache.h"
 #include <QCoreApplication>
+#include <QMutexLocker>
 
 
 QgsConfigCache* QgsConfigCache::instance()
@@ -31,6 +33,7 @@ QgsConfigCache* QgsConfigCache::instance()
 }
 
 QgsConfigCache::QgsConfigCache()
+    : mMutex( QMutex::Recursive )
 {
   QObject::connect( &mFileSystemWatcher, SIGNAL( fileChanged( const QString& ) ), this, SLOT( removeChangedEntry( const QString& ) ) );
 }
@@ -46,6 +49,7 @@ QgsConfigCache::~QgsConfigCache()
 QgsConfigParser* QgsConfigCache::searchConfiguration( const QString& filePath )
 {
   QCoreApplication::processEvents(); //check for updates from file system watcher
+  QMutexLocker locker( &mMutex );
   QgsConfigParser* p = mCachedConfigurations.value( filePath, 0 );
 
   if ( p )
@@ -76,6 +80,7 @@ QgsConfigParser* QgsConfigCache::insertConfiguration( const QString& filePath )
     if ( configIt != mCachedConfigurations.end() )
     {
       mFileSystemWatcher.removePath( configIt.key() );
+      QgsWMSTileCache::instance()->removeProjectTiles( configIt.key() );
       delete configIt.value();
       mCachedConfigurations.erase( configIt );
     }
@@ -133,11 +138,14 @@ QgsConfigParser* QgsConfigCache::insertConfiguration( const QString& filePath )
 void QgsConfigCache::removeChangedEntry( const QString& path )
 {
   QgsDebugMsg( "Remove config cache entry because file changed" );
+  QMutexLocker locker( &mMutex );
   QHash<QString, QgsConfigParser*>::iterator configIt = mCachedConfigurations.find( path );
   if ( configIt != mCachedConfigurations.end() )
   {
     delete configIt.value();
     mCachedConfigurations.erase( configIt );
   }
+  //tiles rendered from the old project are outdated
+  QgsWMSTileCache::instance()->removeProjectTiles( path );
   mFileSystemWatcher.removePath( path );
 }
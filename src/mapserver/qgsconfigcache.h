@@ -20,6 +20,7 @@
 
 #include <QFileSystemWatcher>
 #include <QHash>
+#include <QMutex>
 #include <QObject>
 #include <QString>
 
@@ -50,6 +51,8 @@ class QgsConfigCache: public QObject
     QHash<QString, QgsConfigParser*> mCachedConfigurations;
     /**Check for configuration file updates (remove entry from cache if file changes)*/
     QFileSystemWatcher mFileSystemWatcher;
+    /**Protects the cached configurations (recursive, project parsers look up embedded projects)*/
+    QMutex mMutex;
 
   private slots:
     /**Removes changed entry from this cache*/
@@ -124,6 +124,8 @@ class QgsConfigParser
     virtual QStringList wfstUpdateLayers() const { return QStringList(); }
     virtual QStringList wfstInsertLayers() const { return QStringList(); }
     virtual QStringList wfstDeleteLayers() const { return QStringList(); }
+    /**Returns the number of decimal places of the coordinates in WFS responses for a layer (default 8)*/
+    virtual int wfsLayerPrecision( const QString& layerId ) const { Q_UNUSED( layerId ); return 8; }
 
     /**Returns an ID-list of layers which queryable in WCS service*/
     virtual QStringList wcsLayers() const { return QStringList(); }
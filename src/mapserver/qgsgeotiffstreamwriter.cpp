@@ -0,0 +1,424 @@
+/***************************************************************************
+                              qgsgeotiffstreamwriter.cpp
+                              --------------------------
+  begin                : January 2014
+  copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgsgeotiffstreamwriter.h"
+#include "qgscoordinatereferencesystem.h"
+#include "qgscoordinatetransform.h"
+#include "qgscsexception.h"
+#include "qgslogger.h"
+#include "qgsrasterblock.h"
+#include "qgsrasterdataprovider.h"
+#include "qgsrasterpipe.h"
+#include "qgsrasterprojector.h"
+#include "qgsrequesthandler.h"
+#include <QList>
+#include <QSysInfo>
+#include <string.h>
+
+//TIFF field types
+static const quint16 TIFF_ASCII = 2;
+static const quint16 TIFF_SHORT = 3;
+static const quint16 TIFF_LONG = 4;
+static const quint16 TIFF_DOUBLE = 12;
+
+/**Preferred number of bytes per strip*/
+static const int STRIP_SIZE = 262144;
+
+struct TiffEntry
+{
+  quint16 tag;
+  quint16 type;
+  quint32 count;
+  QByteArray data;
+};
+
+//values are written in native byte order (the header says which one)
+static void appendShort( QByteArray& ba, quint16 value )
+{
+  ba.append(( const char* ) &value, sizeof( quint16 ) );
+}
+
+static void appendLong( QByteArray& ba, quint32 value )
+{
+  ba.append(( const char* ) &value, sizeof( quint32 ) );
+}
+
+static void appendDouble( QByteArray& ba, double value )
+{
+  ba.append(( const char* ) &value, sizeof( double ) );
+}
+
+static TiffEntry tiffEntry( quint16 tag, quint16 type, quint32 count, const QByteArray& data )
+{
+  TiffEntry entry;
+  entry.tag = tag;
+  entry.type = type;
+  entry.count = count;
+  entry.data = data;
+  return entry;
+}
+
+static TiffEntry shortEntry( quint16 tag, quint16 value, int count = 1 )
+{
+  QByteArray data;
+  for ( int i = 0; i < count; ++i )
+  {
+    appendShort( data, value );
+  }
+  return tiffEntry( tag, TIFF_SHORT, count, data );
+}
+
+static TiffEntry longEntry( quint16 tag, quint32 value )
+{
+  QByteArray data;
+  appendLong( data, value );
+  return tiffEntry( tag, TIFF_LONG, 1, data );
+}
+
+QgsGeoTiffStreamWriter::QgsGeoTiffStreamWriter( QgsRasterPipe* pipe, int width, int height, const QgsRectangle& extent, const QgsCoordinateReferenceSystem& crs )
+    : mPipe( pipe )
+    , mWidth( width )
+    , mHeight( height )
+    , mExtent( extent )
+    , mBandCount( 0 )
+    , mDataType( QGis::UnknownDataType )
+    , mHasNoDataValue( false )
+    , mNoDataValue( 0 )
+    , mRowsPerStrip( 1 )
+    , mStreamable( false )
+{
+  QgsRasterDataProvider* provider = pipe ? pipe->provider() : 0;
+  QgsRasterInterface* iface = pipe ? pipe->last() : 0;
+  if ( !provider || !iface || width <= 0 || height <= 0 || extent.isEmpty() )
+  {
+    return;
+  }
+
+  mBandCount = iface->bandCount();
+  if ( mBandCount < 1 )
+  {
+    return;
+  }
+
+  //all bands need the same data type
+  mDataType = provider->srcDataType( 1 );
+  for ( int i = 2; i <= mBandCount; ++i )
+  {
+    if ( provider->srcDataType( i ) != mDataType )
+    {
+      QgsDebugMsg( "Band data types differ, coverage is not streamed" );
+      return;
+    }
+  }
+
+  switch ( mDataType )
+  {
+    case QGis::Byte:
+    case QGis::UInt16:
+    case QGis::Int16:
+    case QGis::UInt32:
+    case QGis::Int32:
+    case QGis::Float32:
+    case QGis::Float64:
+      break;
+    default:
+      QgsDebugMsg( "Unsupported data type, coverage is not streamed" );
+      return;
+  }
+
+  //no data value: the one of the source. Without it, the output extent has to be inside the source extent,
+  //otherwise QgsRasterFileWriter chooses a free value
+  if ( provider->srcHasNoDataValue( 1 ) )
+  {
+    mHasNoDataValue = true;
+    mNoDataValue = provider->srcNoDataValue( 1 );
+    for ( int i = 2; i <= mBandCount; ++i )
+    {
+      if ( !provider->srcHasNoDataValue( i ) || provider->srcNoDataValue( i ) != mNoDataValue )
+      {
+        QgsDebugMsg( "Band no data values differ, coverage is not streamed" );
+        return;
+      }
+    }
+  }
+  else
+  {
+    QgsRectangle srcExtent = extent;
+    QgsRasterProjector* projector = pipe->projector();
+    if ( projector && projector->srcCrs() != projector->destCrs() )
+    {
+      try
+      {
+        QgsCoordinateTransform ct( projector->destCrs(), projector->srcCrs() );
+        srcExtent = ct.transformBoundingBox( extent );
+      }
+      catch ( QgsCsException &cse )
+      {
+        Q_UNUSED( cse );
+        return;
+      }
+    }
+    if ( !provider->extent().contains( srcExtent ) )
+    {
+      QgsDebugMsg( "Output needs a no data value, coverage is not streamed" );
+      return;
+    }
+  }
+
+  //only EPSG codes can be written as GeoKey
+  QString authId = crs.authid();
+  if ( !authId.startsWith( "EPSG:", Qt::CaseInsensitive ) )
+  {
+    return;
+  }
+  bool conversionOk = false;
+  int epsg = authId.mid( 5 ).toInt( &conversionOk );
+  if ( !conversionOk || epsg <= 0 || epsg > 65535 )
+  {
+    return;
+  }
+
+  int rowBytes = mWidth * mBandCount * QgsRasterBlock::typeSize( mDataType );
+  mRowsPerStrip = qBound( 1, STRIP_SIZE / qMax( 1, rowBytes ), mHeight );
+
+  //classic TIFF uses 32 bit offsets
+  if ( dataSize() > Q_INT64_C( 4000000000 ) )
+  {
+    QgsDebugMsg( "Coverage too large for classic TIFF, coverage is not streamed" );
+    return;
+  }
+
+  mStreamable = createHeader( epsg, crs.geographicFlag() );
+}
+
+qint64 QgsGeoTiffStreamWriter::dataSize() const
+{
+  if ( mWidth <= 0 || mHeight <= 0 )
+  {
+    return 0;
+  }
+  return ( qint64 ) mWidth * mHeight * qMax( 1, mBandCount ) * QgsRasterBlock::typeSize( mDataType );
+}
+
+bool QgsGeoTiffStreamWriter::createHeader( int epsg, bool geographic )
+{
+  int typeSize = QgsRasterBlock::typeSize( mDataType );
+  if ( typeSize < 1 )
+  {
+    return false;
+  }
+
+  quint16 sampleFormat = 1; //unsigned integer
+  if ( mDataType == QGis::Int16 || mDataType == QGis::Int32 )
+  {
+    sampleFormat = 2;
+  }
+  else if ( mDataType == QGis::Float32 || mDataType == QGis::Float64 )
+  {
+    sampleFormat = 3;
+  }
+
+  int nStrips = ( mHeight + mRowsPerStrip - 1 ) / mRowsPerStrip;
+  quint32 rowBytes = ( quint32 ) mWidth * mBandCount * typeSize;
+
+  QByteArray stripByteCounts;
+  for ( int i = 0; i < nStrips; ++i )
+  {
+    int rows = qMin( mRowsPerStrip, mHeight - i * mRowsPerStrip );
+    appendLong( stripByteCounts, rows * rowBytes );
+  }
+
+  //entries sorted by tag. The strip offsets are filled in once the header size is known
+  QList<TiffEntry> entries;
+  entries << longEntry( 256, mWidth ); //ImageWidth
+  entries << longEntry( 257, mHeight ); //ImageLength
+  entries << shortEntry( 258, typeSize * 8, mBandCount ); //BitsPerSample
+  entries << shortEntry( 259, 1 ); //Compression: none
+  entries << shortEntry( 262, 1 ); //PhotometricInterpretation: min is black
+  entries << tiffEntry( 273, TIFF_LONG, nStrips, QByteArray( nStrips * 4, 0 ) ); //StripOffsets
+  entries << shortEntry( 277, mBandCount ); //SamplesPerPixel
+  entries << longEntry( 278, mRowsPerStrip ); //RowsPerStrip
+  entries << tiffEntry( 279, TIFF_LONG, nStrips, stripByteCounts ); //StripByteCounts
+  entries << shortEntry( 284, 1 ); //PlanarConfiguration: chunky
+  if ( mBandCount > 1 )
+  {
+    entries << shortEntry( 338, 0, mBandCount - 1 ); //ExtraSamples: unspecified
+  }
+  entries << shortEntry( 339, sampleFormat, mBandCount ); //SampleFormat
+
+  QByteArray pixelScale;
+  appendDouble( pixelScale, mExtent.width() / mWidth );
+  appendDouble( pixelScale, mExtent.height() / mHeight );
+  appendDouble( pixelScale, 0.0 );
+  entries << tiffEntry( 33550, TIFF_DOUBLE, 3, pixelScale ); //ModelPixelScaleTag
+
+  QByteArray tiePoint;
+  appendDouble( tiePoint, 0.0 );
+  appendDouble( tiePoint, 0.0 );
+  appendDouble( tiePoint, 0.0 );
+  appendDouble( tiePoint, mExtent.xMinimum() );
+  appendDouble( tiePoint, mExtent.yMaximum() );
+  appendDouble( tiePoint, 0.0 );
+  entries << tiffEntry( 33922, TIFF_DOUBLE, 6, tiePoint ); //ModelTiepointTag
+
+  //GeoKeyDirectory: version 1.1.0 with three keys
+  QByteArray geoKeys;
+  appendShort( geoKeys, 1 ); appendShort( geoKeys, 1 ); appendShort( geoKeys, 0 ); appendShort( geoKeys, 3 );
+  appendShort( geoKeys, 1024 ); appendShort( geoKeys, 0 ); appendShort( geoKeys, 1 ); appendShort( geoKeys, geographic ? 2 : 1 ); //GTModelTypeGeoKey
+  appendShort( geoKeys, 1025 ); appendShort( geoKeys, 0 ); appendShort( geoKeys, 1 ); appendShort( geoKeys, 1 ); //GTRasterTypeGeoKey: pixel is area
+  appendShort( geoKeys, geographic ? 2048 : 3072 ); appendShort( geoKeys, 0 ); appendShort( geoKeys, 1 ); appendShort( geoKeys, epsg ); //GeographicTypeGeoKey / ProjectedCSTypeGeoKey
+  entries << tiffEntry( 34735, TIFF_SHORT, 16, geoKeys );
+
+  if ( mHasNoDataValue )
+  {
+    QByteArray noData = QByteArray::number( mNoDataValue, 'g', 17 );
+    noData.append( '\0' );
+    entries << tiffEntry( 42113, TIFF_ASCII, noData.size(), noData ); //GDAL_NODATA
+  }
+
+  //values not fitting into the entry follow the image file directory (word aligned)
+  int ifdSize = 2 + entries.size() * 12 + 4;
+  quint32 headerSize = 8 + ifdSize;
+  for ( int i = 0; i < entries.size(); ++i )
+  {
+    int dataSize = entries.at( i ).data.size();
+    if ( dataSize > 4 )
+    {
+      headerSize += dataSize + ( dataSize % 2 );
+    }
+  }
+
+  QByteArray stripOffsets;
+  quint32 offset = headerSize;
+  for ( int i = 0; i < nStrips; ++i )
+  {
+    appendLong( stripOffsets, offset );
+    offset += qMin( mRowsPerStrip, mHeight - i * mRowsPerStrip ) * rowBytes;
+  }
+  for ( int i = 0; i < entries.size(); ++i )
+  {
+    if ( entries.at( i ).tag == 273 )
+    {
+      entries[i].data = stripOffsets;
+    }
+  }
+
+  mHeader.clear();
+  mHeader.reserve( headerSize );
+  mHeader.append( QSysInfo::ByteOrder == QSysInfo::LittleEndian ? "II" : "MM" );
+  appendShort( mHeader, 42 );
+  appendLong( mHeader, 8 );
+
+  QByteArray values;
+  quint32 valueOffset = 8 + ifdSize;
+  appendShort( mHeader, entries.size() );
+  for ( int i = 0; i < entries.size(); ++i )
+  {
+    const TiffEntry& entry = entries.at( i );
+    appendShort( mHeader, entry.tag );
+    appendShort( mHeader, entry.type );
+    appendLong( mHeader, entry.count );
+    if ( entry.data.size() <= 4 )
+    {
+      QByteArray inlineValue = entry.data;
+      inlineValue.append( QByteArray( 4 - inlineValue.size(), 0 ) );
+      mHeader.append( inlineValue );
+    }
+    else
+    {
+      appendLong( mHeader, valueOffset + values.size() );
+      values.append( entry.data );
+      if ( entry.data.size() % 2 != 0 )
+      {
+        values.append( '\0' );
+      }
+    }
+  }
+  appendLong( mHeader, 0 ); //no further image file directory
+  mHeader.append( values );
+
+  return ( quint32 ) mHeader.size() == headerSize;
+}
+
+void QgsGeoTiffStreamWriter::write( QgsRequestHandler& request )
+{
+  if ( !mStreamable )
+  {
+    return;
+  }
+
+  QgsRasterInterface* iface = mPipe->last();
+  int typeSize = QgsRasterBlock::typeSize( mDataType );
+  int pixelSize = typeSize * mBandCount;
+  double resY = mExtent.height() / mHeight;
+  QByteArray noDataBytes = QgsRasterBlock::valueBytes( mDataType, mNoDataValue );
+
+  QByteArray header = mHeader;
+  request.startGetCoverageResponse( &header, size() );
+
+  QByteArray strip;
+  for ( int row = 0; row < mHeight; row += mRowsPerStrip )
+  {
+    int rows = qMin( mRowsPerStrip, mHeight - row );
+    qgssize nPixels = ( qgssize ) rows * mWidth;
+    QgsRectangle stripExtent( mExtent.xMinimum(), mExtent.yMaximum() - ( row + rows ) * resY,
+                              mExtent.xMaximum(), mExtent.yMaximum() - row * resY );
+    strip.fill( 0, nPixels * pixelSize );
+
+    for ( int band = 0; band < mBandCount; ++band )
+    {
+      char* dest = strip.data() + band * typeSize;
+      QgsRasterBlock* block = iface->block( band + 1, stripExtent, mWidth, rows );
+      if ( block && block->isValid() && !block->isEmpty() && ( block->dataType() == mDataType || block->convert( mDataType ) ) )
+      {
+        //replace no data of the block (bitmap or other value) with the output value
+        if ( mHasNoDataValue && block->hasNoData() && !( block->hasNoDataValue() && block->noDataValue() == mNoDataValue ) )
+        {
+          for ( qgssize i = 0; i < nPixels; ++i )
+          {
+            if ( block->isNoData( i ) )
+            {
+              block->setValue( i, mNoDataValue );
+            }
+          }
+        }
+
+        const char* src = ( const char* ) block->bits();
+        if ( mBandCount == 1 )
+        {
+          memcpy( dest, src, nPixels * typeSize );
+        }
+        else
+        {
+          for ( qgssize i = 0; i < nPixels; ++i )
+          {
+            memcpy( dest + i * pixelSize, src + i * typeSize, typeSize );
+          }
+        }
+      }
+      else if ( mHasNoDataValue )
+      {
+        for ( qgssize i = 0; i < nPixels; ++i )
+        {
+          memcpy( dest + i * pixelSize, noDataBytes.constData(), typeSize );
+        }
+      }
+      delete block;
+    }
+
+    request.sendGetCoverageResponsePart( &strip );
+  }
+}
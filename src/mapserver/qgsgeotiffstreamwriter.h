@@ -0,0 +1,71 @@
+/***************************************************************************
+                              qgsgeotiffstreamwriter.h
+                              ------------------------
+  begin                : January 2014
+  copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSGEOTIFFSTREAMWRITER_H
+#define QGSGEOTIFFSTREAMWRITER_H
+
+#include "qgis.h"
+#include "qgsrectangle.h"
+#include <QByteArray>
+
+class QgsCoordinateReferenceSystem;
+class QgsRasterPipe;
+class QgsRequestHandler;
+
+/**Writes the output of a raster pipe as uncompressed, stripped GeoTIFF through a request handler.
+The header is computed in advance (the size of the strips is known), so the file is sent strip by strip
+while it is read from the pipe. Only data which can be expressed without GDAL is supported: equal numeric data
+types for all bands, an EPSG coordinate reference system and, if the output needs one, the no data value of the source.
+Otherwise QgsRasterFileWriter has to be used*/
+class QgsGeoTiffStreamWriter
+{
+  public:
+    /**Constructor
+      @param pipe the raster pipe (provider and projector). Does not take ownership
+      @param width output width in pixels
+      @param height output height in pixels
+      @param extent output extent in crs
+      @param crs output coordinate reference system*/
+    QgsGeoTiffStreamWriter( QgsRasterPipe* pipe, int width, int height, const QgsRectangle& extent, const QgsCoordinateReferenceSystem& crs );
+
+    /**Returns true if the coverage can be written as stream*/
+    bool isStreamable() const { return mStreamable; }
+    /**Number of bytes of the raster data (also an estimate for files written by GDAL)*/
+    qint64 dataSize() const;
+    /**Number of bytes of the GeoTIFF*/
+    qint64 size() const { return mHeader.size() + dataSize(); }
+
+    /**Sends the GeoTIFF (only call if isStreamable() is true)*/
+    void write( QgsRequestHandler& request );
+
+  private:
+    /**Creates the TIFF header with the image file directory*/
+    bool createHeader( int epsg, bool geographic );
+
+    QgsRasterPipe* mPipe;
+    int mWidth;
+    int mHeight;
+    QgsRectangle mExtent;
+    int mBandCount;
+    QGis::DataType mDataType;
+    bool mHasNoDataValue;
+    double mNoDataValue;
+    int mRowsPerStrip;
+    bool mStreamable;
+    QByteArray mHeader;
+};
+
+#endif // QGSGEOTIFFSTREAMWRITER_H
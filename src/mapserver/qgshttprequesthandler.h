@@ -19,11 +19,8 @@
 #define QGSHTTPREQUESTHANDLER_H
 
 #include "qgsrequesthandler.h"
-#include <QColor>
-#include <QPair>
 
-typedef QList< QPair<QRgb, int> > QgsColorBox; //Color / number of pixels
-typedef QMultiMap< int, QgsColorBox > QgsColorBoxMap; // sum of pixels / color box
+class QBuffer;
 
 /**Base class for request handler using HTTP.
 It provides a method to send data to the client*/
@@ -43,6 +40,8 @@ class QgsHttpRequestHandler: public QgsRequestHandler
     virtual void sendGetFeatureResponse( QByteArray* ba ) const;
     virtual void endGetFeatureResponse( QByteArray* ba ) const;
     virtual void sendGetCoverageResponse( QByteArray* ba ) const;
+    virtual bool startGetCoverageResponse( QByteArray* ba, qint64 size ) const;
+    virtual void sendGetCoverageResponsePart( QByteArray* ba ) const;
 
   protected:
     void sendHttpResponse( QByteArray* ba, const QString& format ) const;
@@ -55,17 +54,8 @@ class QgsHttpRequestHandler: public QgsRequestHandler
     QString readPostBody() const;
 
   private:
-    static void medianCut( QVector<QRgb>& colorTable, QHash<QRgb, int>& colorIndexHash, int nColors, const QImage& inputImage );
-    static void imageColors( QHash<QRgb, int>& colors, const QImage& image );
-    static void splitColorBox( QgsColorBox& colorBox, QgsColorBoxMap& colorBoxMap,
-                               QMap<int, QgsColorBox>::iterator colorBoxMapIt );
-    static bool minMaxRange( const QgsColorBox& colorBox, int& redRange, int& greenRange, int& blueRange, int& alphaRange );
-    static bool redCompare( const QPair<QRgb, int>& c1, const QPair<QRgb, int>& c2 );
-    static bool greenCompare( const QPair<QRgb, int>& c1, const QPair<QRgb, int>& c2 );
-    static bool blueCompare( const QPair<QRgb, int>& c1, const QPair<QRgb, int>& c2 );
-    static bool alphaCompare( const QPair<QRgb, int>& c1, const QPair<QRgb, int>& c2 );
-    /**Calculates a representative color for a box (pixel weighted average)*/
-    static QRgb boxColor( const QgsColorBox& box, int boxPixels, int colorMapIndex, QHash<QRgb, int>& colorIndexHash );
+    /**Saves a PNG image with the compression level from the environment variable PNG_COMPRESSION_LEVEL (0-9, zlib default if not set)*/
+    static void savePng( const QImage& image, QBuffer* buffer );
 };
 
 #endif
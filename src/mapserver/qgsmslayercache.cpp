@@ -17,8 +17,12 @@
 
 #include "qgsmslayercache.h"
 #include "qgsvectorlayer.h"
+#include "qgswmstilecache.h"
 #include "qgslogger.h"
 #include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QUrl>
 
 QgsMSLayerCache* QgsMSLayerCache::instance()
 {
@@ -55,6 +59,7 @@ QgsMSLayerCache::~QgsMSLayerCache()
 void QgsMSLayerCache::insertLayer( const QString& url, const QString& layerName, QgsMapLayer* layer, const QString& configFile, const QList<QString>& tempFiles )
 {
   QgsDebugMsg( "inserting layer" );
+  QMutexLocker locker( &mMutex );
   if ( mEntries.size() > std::max( mDefaultMaxLayers, mProjectMaxLayers ) ) //force cache layer examination after 10 inserted layers
   {
     updateEntries();
@@ -77,6 +82,17 @@ void QgsMSLayerCache::insertLayer( const QString& url, const QString& layerName,
 
   mEntries.insert( urlLayerPair, newEntry );
 
+  //tiles rendered from the layer are outdated if its data changes
+  if ( layer && !configFile.isEmpty() )
+  {
+    QObject::connect( layer, SIGNAL( dataChanged() ), this, SLOT( layerDataChanged() ) );
+    QObject::connect( layer, SIGNAL( repaintRequested() ), this, SLOT( layerDataChanged() ) );
+    if ( qobject_cast<QgsVectorLayer*>( layer ) )
+    {
+      QObject::connect( layer, SIGNAL( layerModified() ), this, SLOT( layerDataChanged() ) );
+    }
+  }
+
   //update config file map
   if ( !configFile.isEmpty() )
   {
@@ -95,6 +111,7 @@ void QgsMSLayerCache::insertLayer( const QString& url, const QString& layerName,
 
 QgsMapLayer* QgsMSLayerCache::searchLayer( const QString& url, const QString& layerName )
 {
+  QMutexLocker locker( &mMutex );
   QPair<QString, QString> urlNamePair = qMakePair( url, layerName );
   if ( !mEntries.contains( urlNamePair ) )
   {
@@ -112,6 +129,7 @@ QgsMapLayer* QgsMSLayerCache::searchLayer( const QString& url, const QString& la
 
 void QgsMSLayerCache::removeProjectFileLayers( const QString& project )
 {
+  QMutexLocker locker( &mMutex );
   QList< QPair< QString, QString > > removeEntries;
 
   QHash<QPair<QString, QString>, QgsMSLayerCacheEntry>::iterator entryIt = mEntries.begin();
@@ -202,3 +220,49 @@ void QgsMSLayerCache::freeEntryRessources( QgsMSLayerCacheEntry& entry )
     }
   }
 }
+
+QDateTime QgsMSLayerCache::projectDataTimestamp( const QString& configFile )
+{
+  QMutexLocker locker( &mMutex );
+  QDateTime timestamp;
+  foreach ( const QgsMSLayerCacheEntry& entry, mEntries )
+  {
+    if ( entry.configFile != configFile || !entry.layerPointer )
+    {
+      continue;
+    }
+
+    //delimited text sources are urls, file based sources are paths with options after '|'
+    QString source = entry.layerPointer->source();
+    QgsVectorLayer* vl = qobject_cast<QgsVectorLayer*>( entry.layerPointer );
+    QString path = vl && vl->providerType() == "delimitedtext" ? QUrl::fromEncoded( source.toAscii() ).toLocalFile() : source.split( "|" ).first();
+    QFileInfo fileInfo( path );
+    if ( !path.isEmpty() && fileInfo.exists() && ( !timestamp.isValid() || fileInfo.lastModified() > timestamp ) )
+    {
+      timestamp = fileInfo.lastModified();
+    }
+  }
+  return timestamp;
+}
+
+void QgsMSLayerCache::layerDataChanged()
+{
+  QString configFile;
+  {
+    QMutexLocker locker( &mMutex );
+    foreach ( const QgsMSLayerCacheEntry& entry, mEntries )
+    {
+      if ( entry.layerPointer == sender() )
+      {
+        configFile = entry.configFile;
+        break;
+      }
+    }
+  }
+
+  if ( !configFile.isEmpty() )
+  {
+    QgsDebugMsg( "Remove tiles of " + configFile + " because layer data changed" );
+    QgsWMSTileCache::instance()->removeProjectTiles( configFile );
+  }
+}
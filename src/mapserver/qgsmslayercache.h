@@ -19,8 +19,10 @@
 #define QGSMSLAYERCACHE_H
 
 #include <time.h>
+#include <QDateTime>
 #include <QFileSystemWatcher>
 #include <QHash>
+#include <QMutex>
 #include <QObject>
 #include <QPair>
 #include <QString>
@@ -38,7 +40,9 @@ struct QgsMSLayerCacheEntry
 };
 
 /**A singleton class that caches layer objects for the
-QGIS mapserver*/
+QGIS mapserver. Access to the entries is serialized, request specific
+layer state is kept in the render context (see QgsRenderContext::LayerOverride)
+instead of the cached layers*/
 class QgsMSLayerCache: public QObject
 {
     Q_OBJECT
@@ -60,6 +64,10 @@ class QgsMSLayerCache: public QObject
 
     void setProjectMaxLayers( int n ) { mProjectMaxLayers = n; }
 
+    /**Latest modification time of the files used as data source by the cached layers of a project
+     (invalid if there are none). Changes of database tables are not detected*/
+    QDateTime projectDataTimestamp( const QString& configFile );
+
   protected:
     /**Protected singleton constructor*/
     QgsMSLayerCache();
@@ -90,10 +98,16 @@ class QgsMSLayerCache: public QObject
     /**Maximum number of layers in the cache, overrides DEFAULT_MAX_N_LAYERS if larger*/
     int mProjectMaxLayers;
 
+    /**Protects the entries and the config file map*/
+    QMutex mMutex;
+
   private slots:
 
     /**Removes entries from a project (e.g. if a project file has changed)*/
     void removeProjectFileLayers( const QString& project );
+
+    /**Removes the rendered tiles of the project of the sending layer*/
+    void layerDataChanged();
 };
 
 #endif
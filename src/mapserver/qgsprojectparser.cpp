@@ -47,7 +47,13 @@
 #include <QUrl>
 
 
-QgsProjectParser::QgsProjectParser( QDomDocument* xmlDoc, const QString& filePath ): QgsConfigParser(), mXMLDoc( xmlDoc ), mProjectPath( filePath )
+QgsProjectParser::QgsProjectParser( QDomDocument* xmlDoc, const QString& filePath )
+    : QgsConfigParser()
+    , mXMLDoc( xmlDoc )
+    , mProjectPath( filePath )
+    , mFeatureInfoWithWktGeometry( false )
+    , mFeatureInfoFormatSIA2045( false )
+    , mHasFeatureInfoDocumentElement( false )
 {
   mOutputUnits = QgsMapRenderer::Millimeters;
   setLegendParametersFromProject();
@@ -74,17 +80,35 @@ QgsProjectParser::QgsProjectParser( QDomDocument* xmlDoc, const QString& filePat
       QDomNodeList groupNodeList = legendElement.elementsByTagName( "legendgroup" );
       for ( int i = 0; i < groupNodeList.size(); ++i )
       {
-        mLegendGroupElements.push_back( groupNodeList.at( i ).toElement() );
+        currentElement = groupNodeList.at( i ).toElement();
+        mLegendGroupElements.push_back( currentElement );
+        QString groupName = currentElement.attribute( "name" );
+        if ( !mLegendGroupElementsByName.contains( groupName ) )
+        {
+          mLegendGroupElementsByName.insert( groupName, currentElement );
+        }
+      }
+
+      QDomNodeList legendLayerNodeList = legendElement.elementsByTagName( "legendlayer" );
+      for ( int i = 0; i < legendLayerNodeList.size(); ++i )
+      {
+        currentElement = legendLayerNodeList.at( i ).toElement();
+        mLegendLayerElementsByName[ currentElement.attribute( "name" )].append( currentElement );
       }
     }
 
+    readProjectProperties();
     mRestrictedLayers = restrictedLayers();
     createTextAnnotationItems();
     createSvgAnnotationItems();
   }
 }
 
-QgsProjectParser::QgsProjectParser(): mXMLDoc( 0 )
+QgsProjectParser::QgsProjectParser()
+    : mXMLDoc( 0 )
+    , mFeatureInfoWithWktGeometry( false )
+    , mFeatureInfoFormatSIA2045( false )
+    , mHasFeatureInfoDocumentElement( false )
 {
 }
 
@@ -840,30 +864,13 @@ QList<QgsMapLayer*> QgsProjectParser::mapLayerFromTypeName( const QString& tName
 {
   QList<QgsMapLayer*> layerList;
 
-  if ( mProjectLayerElements.size() < 1 )
-  {
-    return layerList;
-  }
-
-  QStringList wfsLayersId = wfsLayers();
-
-  foreach ( const QDomElement &elem, mProjectLayerElements )
+  QHash< QString, QDomElement >::const_iterator layerElemIt = mWfsLayerElementsByTypeName.find( tName );
+  if ( layerElemIt != mWfsLayerElementsByTypeName.constEnd() )
   {
-    QString type = elem.attribute( "type" );
-    if ( type == "vector" )
+    QgsMapLayer* layer = createLayerFromElement( layerElemIt.value(), useCache );
+    if ( layer )
     {
-      QgsMapLayer *mLayer = createLayerFromElement( elem, useCache );
-      QgsVectorLayer* layer = dynamic_cast<QgsVectorLayer*>( mLayer );
-      if ( !layer || !wfsLayersId.contains( layer->id() ) )
-        return layerList;
-
-      QString typeName = layer->name();
-      typeName = typeName.replace( " ", "_" );
-      if ( tName == typeName )
-      {
-        layerList.push_back( mLayer );
-        return layerList;
-      }
+      layerList.push_back( layer );
     }
   }
   return layerList;
@@ -873,30 +880,13 @@ QList<QgsMapLayer*> QgsProjectParser::mapLayerFromCoverage( const QString& cName
 {
   QList<QgsMapLayer*> layerList;
 
-  if ( mProjectLayerElements.size() < 1 )
-  {
-    return layerList;
-  }
-
-  QStringList wcsLayersId = wcsLayers();
-
-  foreach ( const QDomElement &elem, mProjectLayerElements )
+  QHash< QString, QDomElement >::const_iterator layerElemIt = mWcsLayerElementsByCoverageName.find( cName );
+  if ( layerElemIt != mWcsLayerElementsByCoverageName.constEnd() )
   {
-    QString type = elem.attribute( "type" );
-    if ( type == "raster" )
+    QgsMapLayer* layer = createLayerFromElement( layerElemIt.value(), useCache );
+    if ( layer )
     {
-      QgsMapLayer *mLayer = createLayerFromElement( elem, useCache );
-      QgsRasterLayer* layer = dynamic_cast<QgsRasterLayer*>( mLayer );
-      if ( !layer || !wcsLayersId.contains( layer->id() ) )
-        return layerList;
-
-      QString coveName = layer->name();
-      coveName = coveName.replace( " ", "_" );
-      if ( cName == coveName )
-      {
-        layerList.push_back( mLayer );
-        return layerList;
-      }
+      layerList.push_back( layer );
     }
   }
   return layerList;
@@ -948,18 +938,8 @@ void QgsProjectParser::addLayers( QDomDocument &doc,
         QgsProjectParser* p = dynamic_cast<QgsProjectParser*>( QgsConfigCache::instance()->searchConfiguration( project ) );
         if ( p )
         {
-          QList<QDomElement> embeddedGroupElements = p->mLegendGroupElements;
           QStringList pIdDisabled = p->identifyDisabledLayers();
-
-          QDomElement embeddedGroupElem;
-          foreach ( const QDomElement &elem, embeddedGroupElements )
-          {
-            if ( elem.attribute( "name" ) == embeddedGroupName )
-            {
-              embeddedGroupElem = elem;
-              break;
-            }
-          }
+          QDomElement embeddedGroupElem = p->mLegendGroupElementsByName.value( embeddedGroupName );
 
           QMap<QString, QgsMapLayer *> pLayerMap;
           QList<QDomElement> embeddedProjectLayerElements = p->mProjectLayerElements;
@@ -1298,18 +1278,8 @@ void QgsProjectParser::addOWSLayers( QDomDocument &doc,
         QgsProjectParser* p = dynamic_cast<QgsProjectParser*>( QgsConfigCache::instance()->searchConfiguration( project ) );
         if ( p )
         {
-          QList<QDomElement> embeddedGroupElements = p->mLegendGroupElements;
           QStringList pIdDisabled = p->identifyDisabledLayers();
-
-          QDomElement embeddedGroupElem;
-          foreach ( const QDomElement &elem, embeddedGroupElements )
-          {
-            if ( elem.attribute( "name" ) == embeddedGroupName )
-            {
-              embeddedGroupElem = elem;
-              break;
-            }
-          }
+          QDomElement embeddedGroupElem = p->mLegendGroupElementsByName.value( embeddedGroupName );
 
           QMap<QString, QgsMapLayer *> pLayerMap;
           QList<QDomElement> embeddedProjectLayerElements = p->mProjectLayerElements;
@@ -1717,15 +1687,7 @@ QList<QgsMapLayer*> QgsProjectParser::mapLayerFromStyle( const QString& lName, c
   }
   else
   {
-    QList<QDomElement>::const_iterator groupIt = mLegendGroupElements.constBegin();
-    for ( ; groupIt != mLegendGroupElements.constEnd(); ++groupIt )
-    {
-      if ( groupIt->attribute( "name" ) == lName )
-      {
-        groupElement = *groupIt;
-        break;
-      }
-    }
+    groupElement = mLegendGroupElementsByName.value( lName );
   }
 
   if ( !groupElement.isNull() )
@@ -1755,15 +1717,9 @@ QList<QgsMapLayer*> QgsProjectParser::mapLayerFromStyle( const QString& lName, c
   }
 
   //still not found. Check if it is a single embedded layer (embedded layers are not contained in mProjectLayerElementsByName)
-  QDomElement legendElement = mXMLDoc->documentElement().firstChildElement( "legend" );
-  QDomNodeList legendLayerList = legendElement.elementsByTagName( "legendlayer" );
-  for ( int i = 0; i < legendLayerList.size(); ++i )
+  foreach ( const QDomElement& legendLayerElem, mLegendLayerElementsByName.value( lName ) )
   {
-    QDomElement legendLayerElem = legendLayerList.at( i ).toElement();
-    if ( legendLayerElem.attribute( "name" ) == lName )
-    {
-      addLayerFromLegendLayer( legendLayerElem, layerList, useCache );
-    }
+    addLayerFromLegendLayer( legendLayerElem, layerList, useCache );
   }
 
   //Still not found. Probably it is a layer or a subgroup in an embedded group
@@ -1787,14 +1743,10 @@ QList<QgsMapLayer*> QgsProjectParser::mapLayerFromStyle( const QString& lName, c
           break;
         }
 
-        QList<QDomElement>::const_iterator pLegendGroupIt = p->mLegendGroupElements.constBegin();
-        for ( ; pLegendGroupIt != p->mLegendGroupElements.constEnd(); ++pLegendGroupIt )
+        QHash< QString, QDomElement >::const_iterator pLegendGroupIt = p->mLegendGroupElementsByName.find( lName );
+        if ( pLegendGroupIt != p->mLegendGroupElementsByName.constEnd() )
         {
-          if ( pLegendGroupIt->attribute( "name" ) == lName )
-          {
-            p->addLayersFromGroup( *pLegendGroupIt, layerList, useCache );
-            break;
-          }
+          p->addLayersFromGroup( pLegendGroupIt.value(), layerList, useCache );
         }
       }
     }
@@ -1828,15 +1780,10 @@ void QgsProjectParser::addLayersFromGroup( const QDomElement& legendGroupElem, Q
       return;
     }
 
-    QList<QDomElement>  pLegendGroupElems = p->mLegendGroupElements;
-    QList<QDomElement>::const_iterator pGroupIt = pLegendGroupElems.constBegin();
-    for ( ; pGroupIt != pLegendGroupElems.constEnd(); ++pGroupIt )
+    QHash< QString, QDomElement >::const_iterator pGroupIt = p->mLegendGroupElementsByName.find( groupName );
+    if ( pGroupIt != p->mLegendGroupElementsByName.constEnd() )
     {
-      if ( pGroupIt->attribute( "name" ) == groupName )
-      {
-        p->addLayersFromGroup( *pGroupIt, layerList, useCache );
-        return;
-      }
+      p->addLayersFromGroup( pGroupIt.value(), layerList, useCache );
     }
   }
   else //normal group
@@ -1961,331 +1908,52 @@ QgsMapRenderer::OutputUnits QgsProjectParser::outputUnits() const
 
 QStringList QgsProjectParser::identifyDisabledLayers() const
 {
-  QStringList disabledList;
-  if ( !mXMLDoc )
-  {
-    return disabledList;
-  }
-
-  QDomElement qgisElem = mXMLDoc->documentElement();
-  if ( qgisElem.isNull() )
-  {
-    return disabledList;
-  }
-  QDomElement propertiesElem = qgisElem.firstChildElement( "properties" );
-  if ( propertiesElem.isNull() )
-  {
-    return disabledList;
-  }
-  QDomElement identifyElem = propertiesElem.firstChildElement( "Identify" );
-  if ( identifyElem.isNull() )
-  {
-    return disabledList;
-  }
-  QDomElement disabledLayersElem = identifyElem.firstChildElement( "disabledLayers" );
-  if ( disabledLayersElem.isNull() )
-  {
-    return disabledList;
-  }
-  QDomNodeList valueList = disabledLayersElem.elementsByTagName( "value" );
-  for ( int i = 0; i < valueList.size(); ++i )
-  {
-    disabledList << valueList.at( i ).toElement().text();
-  }
-  return disabledList;
+  return mIdentifyDisabledLayers;
 }
 
 QStringList QgsProjectParser::wfsLayers() const
 {
-  QStringList wfsList;
-  if ( !mXMLDoc )
-  {
-    return wfsList;
-  }
-
-  QDomElement qgisElem = mXMLDoc->documentElement();
-  if ( qgisElem.isNull() )
-  {
-    return wfsList;
-  }
-  QDomElement propertiesElem = qgisElem.firstChildElement( "properties" );
-  if ( propertiesElem.isNull() )
-  {
-    return wfsList;
-  }
-  QDomElement wfsLayersElem = propertiesElem.firstChildElement( "WFSLayers" );
-  if ( wfsLayersElem.isNull() )
-  {
-    return wfsList;
-  }
-  QDomNodeList valueList = wfsLayersElem.elementsByTagName( "value" );
-  for ( int i = 0; i < valueList.size(); ++i )
-  {
-    wfsList << valueList.at( i ).toElement().text();
-  }
-  return wfsList;
+  return mWfsLayers;
 }
 
 QStringList QgsProjectParser::wfstUpdateLayers() const
 {
-  QStringList publiedIds = wfsLayers();
-  QStringList wfsList;
-  if ( !mXMLDoc )
-  {
-    return wfsList;
-  }
-
-  QDomElement qgisElem = mXMLDoc->documentElement();
-  if ( qgisElem.isNull() )
-  {
-    return wfsList;
-  }
-  QDomElement propertiesElem = qgisElem.firstChildElement( "properties" );
-  if ( propertiesElem.isNull() )
-  {
-    return wfsList;
-  }
-  QDomElement wfstLayersElem = propertiesElem.firstChildElement( "WFSTLayers" );
-  if ( wfstLayersElem.isNull() )
-  {
-    return wfsList;
-  }
-  QDomElement wfstUpdateLayersElem = wfstLayersElem.firstChildElement( "Update" );
-  if ( wfstUpdateLayersElem.isNull() )
-  {
-    return wfsList;
-  }
-  QDomNodeList valueList = wfstUpdateLayersElem.elementsByTagName( "value" );
-  for ( int i = 0; i < valueList.size(); ++i )
-  {
-    QString id = valueList.at( i ).toElement().text();
-    if ( publiedIds.contains( id ) )
-      wfsList << id;
-  }
-  return wfsList;
+  return mWfstUpdateLayers;
 }
 
 QStringList QgsProjectParser::wfstInsertLayers() const
 {
-  QStringList updateIds = wfstUpdateLayers();
-  QStringList wfsList;
-  if ( !mXMLDoc )
-  {
-    return wfsList;
-  }
-
-  QDomElement qgisElem = mXMLDoc->documentElement();
-  if ( qgisElem.isNull() )
-  {
-    return wfsList;
-  }
-  QDomElement propertiesElem = qgisElem.firstChildElement( "properties" );
-  if ( propertiesElem.isNull() )
-  {
-    return wfsList;
-  }
-  QDomElement wfstLayersElem = propertiesElem.firstChildElement( "WFSTLayers" );
-  if ( wfstLayersElem.isNull() )
-  {
-    return wfsList;
-  }
-  QDomElement wfstInsertLayersElem = wfstLayersElem.firstChildElement( "Insert" );
-  if ( wfstInsertLayersElem.isNull() )
-  {
-    return wfsList;
-  }
-  QDomNodeList valueList = wfstInsertLayersElem.elementsByTagName( "value" );
-  for ( int i = 0; i < valueList.size(); ++i )
-  {
-    QString id = valueList.at( i ).toElement().text();
-    if ( updateIds.contains( id ) )
-      wfsList << id;
-  }
-  return wfsList;
+  return mWfstInsertLayers;
 }
 
 QStringList QgsProjectParser::wfstDeleteLayers() const
 {
-  QStringList insertIds = wfstInsertLayers();
-  QStringList wfsList;
-  if ( !mXMLDoc )
-  {
-    return wfsList;
-  }
+  return mWfstDeleteLayers;
+}
 
-  QDomElement qgisElem = mXMLDoc->documentElement();
-  if ( qgisElem.isNull() )
-  {
-    return wfsList;
-  }
-  QDomElement propertiesElem = qgisElem.firstChildElement( "properties" );
-  if ( propertiesElem.isNull() )
-  {
-    return wfsList;
-  }
-  QDomElement wfstLayersElem = propertiesElem.firstChildElement( "WFSTLayers" );
-  if ( wfstLayersElem.isNull() )
-  {
-    return wfsList;
-  }
-  QDomElement wfstDeleteLayersElem = wfstLayersElem.firstChildElement( "Delete" );
-  if ( wfstDeleteLayersElem.isNull() )
-  {
-    return wfsList;
-  }
-  QDomNodeList valueList = wfstDeleteLayersElem.elementsByTagName( "value" );
-  for ( int i = 0; i < valueList.size(); ++i )
-  {
-    QString id = valueList.at( i ).toElement().text();
-    if ( insertIds.contains( id ) )
-      wfsList << id;
-  }
-  return wfsList;
+int QgsProjectParser::wfsLayerPrecision( const QString& layerId ) const
+{
+  return mWfsLayerPrecisions.value( layerId, QgsConfigParser::wfsLayerPrecision( layerId ) );
 }
 
 QStringList QgsProjectParser::wcsLayers() const
 {
-  QStringList wcsList;
-  if ( !mXMLDoc )
-  {
-    return wcsList;
-  }
-
-  QDomElement qgisElem = mXMLDoc->documentElement();
-  if ( qgisElem.isNull() )
-  {
-    return wcsList;
-  }
-  QDomElement propertiesElem = qgisElem.firstChildElement( "properties" );
-  if ( propertiesElem.isNull() )
-  {
-    return wcsList;
-  }
-  QDomElement wcsLayersElem = propertiesElem.firstChildElement( "WCSLayers" );
-  if ( wcsLayersElem.isNull() )
-  {
-    return wcsList;
-  }
-  QDomNodeList valueList = wcsLayersElem.elementsByTagName( "value" );
-  for ( int i = 0; i < valueList.size(); ++i )
-  {
-    wcsList << valueList.at( i ).toElement().text();
-  }
-  return wcsList;
+  return mWcsLayers;
 }
 
 QStringList QgsProjectParser::supportedOutputCrsList() const
 {
-  QStringList crsList;
-  if ( !mXMLDoc )
-  {
-    return crsList;
-  }
-
-  QDomElement qgisElem = mXMLDoc->documentElement();
-  if ( qgisElem.isNull() )
-  {
-    return crsList;
-  }
-  QDomElement propertiesElem = qgisElem.firstChildElement( "properties" );
-  if ( propertiesElem.isNull() )
-  {
-    return crsList;
-  }
-  QDomElement wmsCrsElem = propertiesElem.firstChildElement( "WMSCrsList" );
-  if ( !wmsCrsElem.isNull() )
-  {
-    QDomNodeList valueList = wmsCrsElem.elementsByTagName( "value" );
-    for ( int i = 0; i < valueList.size(); ++i )
-    {
-      crsList.append( valueList.at( i ).toElement().text() );
-    }
-  }
-  else
-  {
-    QDomElement wmsEpsgElem = propertiesElem.firstChildElement( "WMSEpsgList" );
-    if ( wmsEpsgElem.isNull() )
-    {
-      return crsList;
-    }
-    QDomNodeList valueList = wmsEpsgElem.elementsByTagName( "value" );
-    bool conversionOk;
-    for ( int i = 0; i < valueList.size(); ++i )
-    {
-      int epsgNr = valueList.at( i ).toElement().text().toInt( &conversionOk );
-      if ( conversionOk )
-      {
-        crsList.append( QString( "EPSG:%1" ).arg( epsgNr ) );
-      }
-    }
-  }
-
-  return crsList;
+  return mSupportedOutputCrsList;
 }
 
 bool QgsProjectParser::featureInfoWithWktGeometry() const
 {
-  if ( !mXMLDoc )
-  {
-    return false;
-  }
-
-  QDomElement qgisElem = mXMLDoc->documentElement();
-  if ( qgisElem.isNull() )
-  {
-    return false;
-  }
-  QDomElement propertiesElem = qgisElem.firstChildElement( "properties" );
-  if ( propertiesElem.isNull() )
-  {
-    return false;
-  }
-  QDomElement wktElem = propertiesElem.firstChildElement( "WMSAddWktGeometry" );
-  if ( wktElem.isNull() )
-  {
-    return false;
-  }
-
-  return ( wktElem.text().compare( "true", Qt::CaseInsensitive ) == 0 );
+  return mFeatureInfoWithWktGeometry;
 }
 
 QgsRectangle QgsProjectParser::mapRectangle() const
 {
-  if ( !mXMLDoc )
-  {
-    return QgsRectangle();
-  }
-
-  QDomElement qgisElem = mXMLDoc->documentElement();
-  if ( qgisElem.isNull() )
-  {
-    return QgsRectangle();
-  }
-
-  QDomElement propertiesElem = qgisElem.firstChildElement( "properties" );
-  if ( propertiesElem.isNull() )
-  {
-    return QgsRectangle();
-  }
-
-  QDomElement extentElem = propertiesElem.firstChildElement( "WMSExtent" );
-  if ( extentElem.isNull() )
-  {
-    return QgsRectangle();
-  }
-
-  QDomNodeList valueNodeList = extentElem.elementsByTagName( "value" );
-  if ( valueNodeList.size() < 4 )
-  {
-    return QgsRectangle();
-  }
-
-  //order of value elements must be xmin, ymin, xmax, ymax
-  double xmin = valueNodeList.at( 0 ).toElement().text().toDouble();
-  double ymin = valueNodeList.at( 1 ).toElement().text().toDouble();
-  double xmax = valueNodeList.at( 2 ).toElement().text().toDouble();
-  double ymax = valueNodeList.at( 3 ).toElement().text().toDouble();
-  return QgsRectangle( xmin, ymin, xmax, ymax );
+  return mMapRectangle;
 }
 
 QString QgsProjectParser::mapAuthid() const
@@ -2324,30 +1992,7 @@ QString QgsProjectParser::mapAuthid() const
 
 QString QgsProjectParser::projectTitle() const
 {
-  if ( !mXMLDoc )
-  {
-    return QString();
-  }
-
-  QDomElement qgisElem = mXMLDoc->documentElement();
-  if ( qgisElem.isNull() )
-  {
-    return QString();
-  }
-
-  QDomElement titleElem = qgisElem.firstChildElement( "title" );
-  if ( !titleElem.isNull() )
-  {
-    QString title = titleElem.text();
-    if ( !title.isEmpty() )
-    {
-      return title;
-    }
-  }
-
-  //no title element or not project title set. Use project filename without extension
-  QFileInfo projectFileInfo( mProjectPath );
-  return projectFileInfo.baseName();
+  return mProjectTitle;
 }
 
 QgsMapLayer* QgsProjectParser::createLayerFromElement( const QDomElement& elem, bool useCache ) const
@@ -3196,233 +2841,70 @@ void QgsProjectParser::serviceWCSCapabilities( QDomElement& parentElement, QDomD
 
 QString QgsProjectParser::serviceUrl() const
 {
-  QString url;
-
-  if ( !mXMLDoc )
-  {
-    return url;
-  }
-
-  QDomElement propertiesElem = mXMLDoc->documentElement().firstChildElement( "properties" );
-  if ( !propertiesElem.isNull() )
-  {
-    QDomElement wmsUrlElem = propertiesElem.firstChildElement( "WMSUrl" );
-    if ( !wmsUrlElem.isNull() )
-    {
-      url = wmsUrlElem.text();
-    }
-  }
-  return url;
+  return mServiceUrl;
 }
 
 QString QgsProjectParser::wfsServiceUrl() const
 {
-  QString url;
-
-  if ( !mXMLDoc )
-  {
-    return url;
-  }
-
-  QDomElement propertiesElem = mXMLDoc->documentElement().firstChildElement( "properties" );
-  if ( !propertiesElem.isNull() )
-  {
-    QDomElement wfsUrlElem = propertiesElem.firstChildElement( "WFSUrl" );
-    if ( !wfsUrlElem.isNull() )
-    {
-      url = wfsUrlElem.text();
-    }
-  }
-  return url;
+  return mWfsServiceUrl;
 }
 
 QStringList QgsProjectParser::wfsLayerNames() const
 {
   QStringList layerNameList;
-
-  QMap<QString, QgsMapLayer*> layerMap;
-  projectLayerMap( layerMap );
-
-  QgsMapLayer* currentLayer = 0;
-  QStringList wfsIdList = wfsLayers();
-  QStringList::const_iterator wfsIdIt = wfsIdList.constBegin();
-  for ( ; wfsIdIt != wfsIdList.constEnd(); ++wfsIdIt )
+  foreach ( const QString& id, mWfsLayers )
   {
-    QMap<QString, QgsMapLayer*>::const_iterator layerMapIt = layerMap.find( *wfsIdIt );
-    if ( layerMapIt != layerMap.constEnd() )
+    QHash< QString, QDomElement >::const_iterator layerElemIt = mProjectLayerElementsById.find( id );
+    if ( layerElemIt != mProjectLayerElementsById.constEnd() )
     {
-      currentLayer = layerMapIt.value();
-      if ( currentLayer )
-      {
-        layerNameList.append( currentLayer->name() );
-      }
+      layerNameList.append( layerElemIt.value().firstChildElement( "layername" ).text() );
     }
   }
-
   return layerNameList;
 }
 
 QString QgsProjectParser::wcsServiceUrl() const
 {
-  QString url;
-
-  if ( !mXMLDoc )
-  {
-    return url;
-  }
-
-  QDomElement propertiesElem = mXMLDoc->documentElement().firstChildElement( "properties" );
-  if ( !propertiesElem.isNull() )
-  {
-    QDomElement wcsUrlElem = propertiesElem.firstChildElement( "WCSUrl" );
-    if ( !wcsUrlElem.isNull() )
-    {
-      url = wcsUrlElem.text();
-    }
-  }
-  return url;
+  return mWcsServiceUrl;
 }
 
 QStringList QgsProjectParser::wcsLayerNames() const
 {
   QStringList layerNameList;
-
-  QMap<QString, QgsMapLayer*> layerMap;
-  projectLayerMap( layerMap );
-
-  QgsMapLayer* currentLayer = 0;
-  QStringList wcsIdList = wcsLayers();
-  QStringList::const_iterator wcsIdIt = wcsIdList.constBegin();
-  for ( ; wcsIdIt != wcsIdList.constEnd(); ++wcsIdIt )
+  foreach ( const QString& id, mWcsLayers )
   {
-    QMap<QString, QgsMapLayer*>::const_iterator layerMapIt = layerMap.find( *wcsIdIt );
-    if ( layerMapIt != layerMap.constEnd() )
+    QHash< QString, QDomElement >::const_iterator layerElemIt = mProjectLayerElementsById.find( id );
+    if ( layerElemIt != mProjectLayerElementsById.constEnd() )
     {
-      currentLayer = layerMapIt.value();
-      if ( currentLayer )
-      {
-        layerNameList.append( currentLayer->name() );
-      }
+      layerNameList.append( layerElemIt.value().firstChildElement( "layername" ).text() );
     }
   }
-
   return layerNameList;
 }
 
 QHash<QString, QString> QgsProjectParser::featureInfoLayerAliasMap() const
 {
-  QHash<QString, QString> aliasMap;
-  QDomElement propertiesElem = mXMLDoc->documentElement().firstChildElement( "properties" );
-  if ( propertiesElem.isNull() )
-  {
-    return aliasMap;
-  }
-
-  //WMSFeatureInfoAliasLayers
-  QStringList aliasLayerStringList;
-  QDomElement featureInfoAliasLayersElem = propertiesElem.firstChildElement( "WMSFeatureInfoAliasLayers" );
-  if ( featureInfoAliasLayersElem.isNull() )
-  {
-    return aliasMap;
-  }
-  QDomNodeList aliasLayerValueList = featureInfoAliasLayersElem.elementsByTagName( "value" );
-  for ( int i = 0; i < aliasLayerValueList.size(); ++i )
-  {
-    aliasLayerStringList << aliasLayerValueList.at( i ).toElement().text();
-  }
-
-  //WMSFeatureInfoLayerAliases
-  QStringList layerAliasStringList;
-  QDomElement featureInfoLayerAliasesElem = propertiesElem.firstChildElement( "WMSFeatureInfoLayerAliases" );
-  if ( featureInfoLayerAliasesElem.isNull() )
-  {
-    return aliasMap;
-  }
-  QDomNodeList layerAliasesValueList = featureInfoLayerAliasesElem.elementsByTagName( "value" );
-  for ( int i = 0; i < layerAliasesValueList.size(); ++i )
-  {
-    layerAliasStringList << layerAliasesValueList.at( i ).toElement().text();
-  }
-
-  int nMapEntries = qMin( aliasLayerStringList.size(), layerAliasStringList.size() );
-  for ( int i = 0; i < nMapEntries; ++i )
-  {
-    aliasMap.insert( aliasLayerStringList.at( i ), layerAliasStringList.at( i ) );
-  }
-
-  return aliasMap;
+  return mFeatureInfoLayerAliasMap;
 }
 
 QString QgsProjectParser::featureInfoDocumentElement( const QString& defaultValue ) const
 {
-  QDomElement propertiesElem = mXMLDoc->documentElement().firstChildElement( "properties" );
-  if ( propertiesElem.isNull() )
-  {
-    return defaultValue;
-  }
-  QDomElement featureInfoDocumentElem = propertiesElem.firstChildElement( "WMSFeatureInfoDocumentElement" );
-  if ( featureInfoDocumentElem.isNull() )
-  {
-    return defaultValue;
-  }
-  return featureInfoDocumentElem.text();
+  return mHasFeatureInfoDocumentElement ? mFeatureInfoDocumentElement : defaultValue;
 }
 
 QString QgsProjectParser::featureInfoDocumentElementNS() const
 {
-  QDomElement propertiesElem = mXMLDoc->documentElement().firstChildElement( "properties" );
-  if ( propertiesElem.isNull() )
-  {
-    return "";
-  }
-  QDomElement featureInfoDocumentNSElem = propertiesElem.firstChildElement( "WMSFeatureInfoDocumentElementNS" );
-  if ( featureInfoDocumentNSElem.isNull() )
-  {
-    return "";
-  }
-  return featureInfoDocumentNSElem.text();
+  return mFeatureInfoDocumentElementNS;
 }
 
 QString QgsProjectParser::featureInfoSchema() const
 {
-  QDomElement propertiesElem = mXMLDoc->documentElement().firstChildElement( "properties" );
-  if ( propertiesElem.isNull() )
-  {
-    return "";
-  }
-  QDomElement featureInfoSchemaElem = propertiesElem.firstChildElement( "WMSFeatureInfoSchema" );
-  if ( featureInfoSchemaElem.isNull() )
-  {
-    return "";
-  }
-  return featureInfoSchemaElem.text();
+  return mFeatureInfoSchema;
 }
 
 bool QgsProjectParser::featureInfoFormatSIA2045() const
 {
-  if ( !mXMLDoc )
-  {
-    return false;
-  }
-
-  QDomElement propertiesElem = mXMLDoc->documentElement().firstChildElement( "properties" );
-  if ( propertiesElem.isNull() )
-  {
-    return false;
-  }
-
-  QDomElement sia2045Elem = propertiesElem.firstChildElement( "WMSInfoFormatSIA2045" );
-  if ( sia2045Elem.isNull() )
-  {
-    return false;
-  }
-
-  if ( sia2045Elem.text().compare( "enabled", Qt::CaseInsensitive ) == 0
-       || sia2045Elem.text().compare( "true", Qt::CaseInsensitive ) == 0 )
-  {
-    return true;
-  }
-  return false;
+  return mFeatureInfoFormatSIA2045;
 }
 
 QString QgsProjectParser::convertToAbsolutePath( const QString& file ) const
@@ -3549,6 +3031,139 @@ void QgsProjectParser::setMaxWidthHeight()
   }
 }
 
+static QStringList propertyValues( const QDomElement& propertyElem )
+{
+  QStringList values;
+  QDomNodeList valueList = propertyElem.elementsByTagName( "value" );
+  for ( int i = 0; i < valueList.size(); ++i )
+  {
+    values << valueList.at( i ).toElement().text();
+  }
+  return values;
+}
+
+static QStringList containedValues( const QStringList& values, const QStringList& allowedValues )
+{
+  QStringList containedList;
+  foreach ( const QString& value, values )
+  {
+    if ( allowedValues.contains( value ) )
+    {
+      containedList << value;
+    }
+  }
+  return containedList;
+}
+
+void QgsProjectParser::readProjectProperties()
+{
+  QDomElement qgisElem = mXMLDoc->documentElement();
+
+  //no title element or not project title set. Use project filename without extension
+  mProjectTitle = qgisElem.firstChildElement( "title" ).text();
+  if ( mProjectTitle.isEmpty() )
+  {
+    mProjectTitle = QFileInfo( mProjectPath ).baseName();
+  }
+
+  QDomElement propertiesElem = qgisElem.firstChildElement( "properties" );
+  mIdentifyDisabledLayers = propertyValues( propertiesElem.firstChildElement( "Identify" ).firstChildElement( "disabledLayers" ) );
+  mWfsLayers = propertyValues( propertiesElem.firstChildElement( "WFSLayers" ) );
+  mWcsLayers = propertyValues( propertiesElem.firstChildElement( "WCSLayers" ) );
+
+  //WFS-T: update needs WFS, insert needs update and delete needs insert
+  QDomElement wfstLayersElem = propertiesElem.firstChildElement( "WFSTLayers" );
+  mWfstUpdateLayers = containedValues( propertyValues( wfstLayersElem.firstChildElement( "Update" ) ), mWfsLayers );
+  mWfstInsertLayers = containedValues( propertyValues( wfstLayersElem.firstChildElement( "Insert" ) ), mWfstUpdateLayers );
+  mWfstDeleteLayers = containedValues( propertyValues( wfstLayersElem.firstChildElement( "Delete" ) ), mWfstInsertLayers );
+
+  QDomElement precisionElem = propertiesElem.firstChildElement( "WFSLayersPrecision" ).firstChildElement();
+  for ( ; !precisionElem.isNull(); precisionElem = precisionElem.nextSiblingElement() )
+  {
+    bool conversionOk = false;
+    int precision = precisionElem.text().toInt( &conversionOk );
+    if ( conversionOk && !mWfsLayerPrecisions.contains( precisionElem.tagName() ) )
+    {
+      mWfsLayerPrecisions.insert( precisionElem.tagName(), precision );
+    }
+  }
+
+  QDomElement wmsCrsElem = propertiesElem.firstChildElement( "WMSCrsList" );
+  if ( !wmsCrsElem.isNull() )
+  {
+    mSupportedOutputCrsList = propertyValues( wmsCrsElem );
+  }
+  else
+  {
+    QStringList epsgList = propertyValues( propertiesElem.firstChildElement( "WMSEpsgList" ) );
+    bool conversionOk;
+    foreach ( const QString& epsg, epsgList )
+    {
+      int epsgNr = epsg.toInt( &conversionOk );
+      if ( conversionOk )
+      {
+        mSupportedOutputCrsList.append( QString( "EPSG:%1" ).arg( epsgNr ) );
+      }
+    }
+  }
+
+  //order of value elements must be xmin, ymin, xmax, ymax
+  QDomNodeList extentValueList = propertiesElem.firstChildElement( "WMSExtent" ).elementsByTagName( "value" );
+  if ( extentValueList.size() >= 4 )
+  {
+    mMapRectangle = QgsRectangle( extentValueList.at( 0 ).toElement().text().toDouble(), extentValueList.at( 1 ).toElement().text().toDouble(),
+                                  extentValueList.at( 2 ).toElement().text().toDouble(), extentValueList.at( 3 ).toElement().text().toDouble() );
+  }
+
+  mServiceUrl = propertiesElem.firstChildElement( "WMSUrl" ).text();
+  mWfsServiceUrl = propertiesElem.firstChildElement( "WFSUrl" ).text();
+  mWcsServiceUrl = propertiesElem.firstChildElement( "WCSUrl" ).text();
+
+  //GetFeatureInfo settings
+  mFeatureInfoWithWktGeometry = propertiesElem.firstChildElement( "WMSAddWktGeometry" ).text().compare( "true", Qt::CaseInsensitive ) == 0;
+  QString sia2045 = propertiesElem.firstChildElement( "WMSInfoFormatSIA2045" ).text();
+  mFeatureInfoFormatSIA2045 = sia2045.compare( "enabled", Qt::CaseInsensitive ) == 0 || sia2045.compare( "true", Qt::CaseInsensitive ) == 0;
+  QDomElement featureInfoDocumentElem = propertiesElem.firstChildElement( "WMSFeatureInfoDocumentElement" );
+  mHasFeatureInfoDocumentElement = !featureInfoDocumentElem.isNull();
+  mFeatureInfoDocumentElement = featureInfoDocumentElem.text();
+  mFeatureInfoDocumentElementNS = propertiesElem.firstChildElement( "WMSFeatureInfoDocumentElementNS" ).text();
+  mFeatureInfoSchema = propertiesElem.firstChildElement( "WMSFeatureInfoSchema" ).text();
+
+  //both lists are needed for the alias map
+  QDomElement aliasLayersElem = propertiesElem.firstChildElement( "WMSFeatureInfoAliasLayers" );
+  QDomElement layerAliasesElem = propertiesElem.firstChildElement( "WMSFeatureInfoLayerAliases" );
+  if ( !aliasLayersElem.isNull() && !layerAliasesElem.isNull() )
+  {
+    QDomNodeList aliasLayerValueList = aliasLayersElem.elementsByTagName( "value" );
+    QDomNodeList layerAliasValueList = layerAliasesElem.elementsByTagName( "value" );
+    int nMapEntries = qMin( aliasLayerValueList.size(), layerAliasValueList.size() );
+    for ( int i = 0; i < nMapEntries; ++i )
+    {
+      mFeatureInfoLayerAliasMap.insert( aliasLayerValueList.at( i ).toElement().text(), layerAliasValueList.at( i ).toElement().text() );
+    }
+  }
+
+  //type names of the published vector layers and coverage names of the published raster layers (spaces replaced by '_')
+  foreach ( const QString& id, mWfsLayers )
+  {
+    QDomElement layerElem = mProjectLayerElementsById.value( id );
+    QString typeName = layerElem.firstChildElement( "layername" ).text().replace( " ", "_" );
+    if ( layerElem.attribute( "type" ) == "vector" && !mWfsLayerElementsByTypeName.contains( typeName ) )
+    {
+      mWfsLayerElementsByTypeName.insert( typeName, layerElem );
+    }
+  }
+  foreach ( const QString& id, mWcsLayers )
+  {
+    QDomElement layerElem = mProjectLayerElementsById.value( id );
+    QString coverageName = layerElem.firstChildElement( "layername" ).text().replace( " ", "_" );
+    if ( layerElem.attribute( "type" ) == "raster" && !mWcsLayerElementsByCoverageName.contains( coverageName ) )
+    {
+      mWcsLayerElementsByCoverageName.insert( coverageName, layerElem );
+    }
+  }
+}
+
 const QgsCoordinateReferenceSystem& QgsProjectParser::projectCRS() const
 {
   //mapcanvas->destinationsrs->spatialrefsys->authid
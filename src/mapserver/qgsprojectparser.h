@@ -89,6 +89,8 @@ class QgsProjectParser: public QgsConfigParser
     virtual QStringList wfstUpdateLayers() const;
     virtual QStringList wfstInsertLayers() const;
     virtual QStringList wfstDeleteLayers() const;
+    /**Returns the WFS coordinate precision of a layer (comes from <properties> -> <WFSLayersPrecision> -> <layer id> in the project file)*/
+    virtual int wfsLayerPrecision( const QString& layerId ) const;
 
     /**Returns an ID-list of layers queryable for WCS service (comes from <properties> -> <WCSLayers> in the project file*/
     virtual QStringList wcsLayers() const;
@@ -179,6 +181,38 @@ class QgsProjectParser: public QgsConfigParser
     QHash< QString, QDomElement > mProjectLayerElementsById;
     /**Project layer elements, accessible by layer name*/
     QHash< QString, QDomElement > mProjectLayerElementsByName;
+    /**Legend group elements, accessible by group name*/
+    QHash< QString, QDomElement > mLegendGroupElementsByName;
+    /**Legend layer elements (also of embedded layers), accessible by name*/
+    QHash< QString, QList<QDomElement> > mLegendLayerElementsByName;
+    /**Layer elements of the published WFS layers, accessible by type name*/
+    QHash< QString, QDomElement > mWfsLayerElementsByTypeName;
+    /**Layer elements of the published WCS layers, accessible by coverage name*/
+    QHash< QString, QDomElement > mWcsLayerElementsByCoverageName;
+
+    //project properties read once by readProjectProperties(). QgsConfigCache creates a new parser if the file changes
+    QString mProjectTitle;
+    QStringList mIdentifyDisabledLayers;
+    QStringList mWfsLayers;
+    QStringList mWfstUpdateLayers;
+    QStringList mWfstInsertLayers;
+    QStringList mWfstDeleteLayers;
+    /**WFS coordinate precision by layer id*/
+    QHash< QString, int > mWfsLayerPrecisions;
+    QStringList mWcsLayers;
+    QStringList mSupportedOutputCrsList;
+    QgsRectangle mMapRectangle;
+    QString mServiceUrl;
+    QString mWfsServiceUrl;
+    QString mWcsServiceUrl;
+    bool mFeatureInfoWithWktGeometry;
+    bool mFeatureInfoFormatSIA2045;
+    /**False if the project has no WMSFeatureInfoDocumentElement (the caller's default is used)*/
+    bool mHasFeatureInfoDocumentElement;
+    QString mFeatureInfoDocumentElement;
+    QString mFeatureInfoDocumentElementNS;
+    QString mFeatureInfoSchema;
+    QHash<QString, QString> mFeatureInfoLayerAliasMap;
     /**Names of layers and groups which should not be published*/
     QSet<QString> mRestrictedLayers;
     /**Watermark text items*/
@@ -246,6 +280,9 @@ class QgsProjectParser: public QgsConfigParser
     void setSelectionColor();
     /**Reads maxWidth / maxHeight from project and sets it to QgsConfigParser::mMaxWidth / mMaxHeight*/
     void setMaxWidthHeight();
+    /**Reads the project title, the published layers, the output CRS list, the service URLs and the
+      GetFeatureInfo settings from the project file*/
+    void readProjectProperties();
     /**Reads layer drawing order from the legend section of the project file and appends it to the parent elemen (usually the <Capability> element)*/
     void addDrawingOrder( QDomElement& parentElem, QDomDocument& doc ) const;
     /**Adds drawing order info from layer element or group element (recursive)*/
@@ -45,6 +45,9 @@ class QgsRequestHandler
     virtual void sendGetFeatureResponse( QByteArray* ba ) const = 0;
     virtual void endGetFeatureResponse( QByteArray* ba ) const = 0;
     virtual void sendGetCoverageResponse( QByteArray* ba ) const = 0;
+    /**Starts a coverage response of known size. The data follows with sendGetCoverageResponsePart*/
+    virtual bool startGetCoverageResponse( QByteArray* ba, qint64 size ) const = 0;
+    virtual void sendGetCoverageResponsePart( QByteArray* ba ) const = 0;
     QString format() const { return mFormat; }
   protected:
     /**This is set by the parseInput methods of the subclasses (parameter FORMAT, e.g. 'FORMAT=PNG')*/
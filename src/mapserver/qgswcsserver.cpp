@@ -16,6 +16,7 @@
  ***************************************************************************/
 #include "qgswcsserver.h"
 #include "qgsconfigparser.h"
+#include "qgsgeotiffstreamwriter.h"
 #include "qgscrscache.h"
 #include "qgsrasterlayer.h"
 #include "qgsrasterpipe.h"
@@ -23,6 +24,7 @@
 #include "qgsrasterfilewriter.h"
 #include "qgslogger.h"
 #include "qgsmapserviceexception.h"
+#include "qgsrequesthandler.h"
 
 #include <QUrl>
 
@@ -170,7 +172,7 @@ QDomDocument QgsWCSServer::describeCoverage()
   return doc;
 }
 
-QByteArray* QgsWCSServer::getCoverage()
+int QgsWCSServer::getCoverage( QgsRequestHandler& request )
 {
   QStringList wcsLayersId = mConfigParser->wcsLayers();
 
@@ -275,45 +277,76 @@ QByteArray* QgsWCSServer::getCoverage()
 
   QgsMapLayer* layer = layerList.at( 0 );
   QgsRasterLayer* rLayer = dynamic_cast<QgsRasterLayer*>( layer );
-  if ( rLayer && wcsLayersId.contains( rLayer->id() ) )
+  if ( !rLayer || !wcsLayersId.contains( rLayer->id() ) )
   {
-    QTemporaryFile tempFile;
-    tempFile.open();
-    QgsRasterFileWriter fileWriter( tempFile.fileName() );
+    mErrors << QString( "The layer for the COVERAGE '%1' is not published as WCS" ).arg( coveName );
+    throw QgsMapServiceException( "RequestNotWellFormed", mErrors.join( ". " ) );
+  }
+
+  // clone pipe/provider
+  QgsRasterPipe* pipe = new QgsRasterPipe();
+  if ( !pipe->set( rLayer->dataProvider()->clone() ) )
+  {
+    delete pipe;
+    mErrors << QString( "Cannot set pipe provider" );
+    throw QgsMapServiceException( "RequestNotWellFormed", mErrors.join( ". " ) );
+  }
 
-    // clone pipe/provider
-    QgsRasterPipe* pipe = new QgsRasterPipe();
-    if ( !pipe->set( rLayer->dataProvider()->clone() ) )
+  // add projector if necessary
+  if ( outputCRS != rLayer->crs() )
+  {
+    QgsRasterProjector * projector = new QgsRasterProjector;
+    projector->setCRS( rLayer->crs(), outputCRS );
+    if ( !pipe->insert( 2, projector ) )
     {
-      mErrors << QString( "Cannot set pipe provider" );
+      delete pipe;
+      mErrors << QString( "Cannot set pipe projector" );
       throw QgsMapServiceException( "RequestNotWellFormed", mErrors.join( ". " ) );
     }
+  }
 
-    // add projector if necessary
-    if ( outputCRS != rLayer->crs() )
-    {
-      QgsRasterProjector * projector = new QgsRasterProjector;
-      projector->setCRS( rLayer->crs(), outputCRS );
-      if ( !pipe->insert( 2, projector ) )
-      {
-        mErrors << QString( "Cannot set pipe projector" );
-        throw QgsMapServiceException( "RequestNotWellFormed", mErrors.join( ". " ) );
-      }
-    }
+  QgsGeoTiffStreamWriter streamWriter( pipe, width, height, rect, outputCRS );
 
-    QgsRasterFileWriter::WriterError err = fileWriter.writeRaster( pipe, width, height, rect, outputCRS );
-    if ( err != QgsRasterFileWriter::NoError )
+  //maximum coverage size in MiB
+  qint64 maxCoverageSize = 1024;
+  char* maxSizeEnv = getenv( "WCS_MAX_COVERAGE_SIZE" );
+  if ( maxSizeEnv )
+  {
+    bool conversionOk = false;
+    int maxSize = QString( maxSizeEnv ).toInt( &conversionOk );
+    if ( conversionOk && maxSize > 0 )
     {
-      mErrors << QString( "Cannot write raster error code: %1" ).arg( err );
-      throw QgsMapServiceException( "RequestNotWellFormed", mErrors.join( ". " ) );
+      maxCoverageSize = maxSize;
     }
+  }
+  if ( streamWriter.dataSize() > maxCoverageSize * 1024 * 1024 )
+  {
     delete pipe;
-    QByteArray* ba = 0;
-    ba = new QByteArray();
-    *ba = tempFile.readAll();
+    mErrors << QString( "The requested coverage is larger than %1 MiB" ).arg( maxCoverageSize );
+    throw QgsMapServiceException( "RequestNotWellFormed", mErrors.join( ". " ) );
+  }
 
-    return ba;
+  if ( streamWriter.isStreamable() )
+  {
+    QgsDebugMsg( "Streaming coverage" );
+    streamWriter.write( request );
+    delete pipe;
+    return 0;
+  }
+
+  QTemporaryFile tempFile;
+  tempFile.open();
+  QgsRasterFileWriter fileWriter( tempFile.fileName() );
+  QgsRasterFileWriter::WriterError err = fileWriter.writeRaster( pipe, width, height, rect, outputCRS );
+  delete pipe;
+  if ( err != QgsRasterFileWriter::NoError )
+  {
+    mErrors << QString( "Cannot write raster error code: %1" ).arg( err );
+    throw QgsMapServiceException( "RequestNotWellFormed", mErrors.join( ". " ) );
   }
+
+  QByteArray ba = tempFile.readAll();
+  request.sendGetCoverageResponse( &ba );
   return 0;
 }
 
@@ -43,8 +43,10 @@ class QgsWCSServer
     /**Returns an XML file with the describe Coverage (as described in the WCS specs)*/
     QDomDocument describeCoverage();
 
-    /**Creates a file which is the result of the getCoverage request.*/
-    QByteArray* getCoverage();
+    /**Sends the GeoTIFF which is the result of the getCoverage request through the request handler.
+      The file is streamed if possible, otherwise it is written to a temporary file first
+      @return 0 in case of success*/
+    int getCoverage( QgsRequestHandler& request );
 
     /**Sets configuration parser for administration settings. Does not take ownership*/
     void setAdminConfigParser( QgsConfigParser* parser ) { mConfigParser = parser; }
@@ -0,0 +1,674 @@
+/***************************************************************************
+                              qgswfsfeaturewriter.cpp
+                              -----------------------
+  begin                : January 2014
+  copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgswfsfeaturewriter.h"
+#include "qgscoordinatereferencesystem.h"
+#include "qgsfield.h"
+#include "qgsgeometry.h"
+#include "qgsrequesthandler.h"
+
+QgsWFSFeatureWriter::QgsWFSFeatureWriter( QgsRequestHandler& request, Format format, int bufferSize )
+    : mRequest( request )
+    , mFormat( format )
+    , mBufferSize( bufferSize )
+    , mFeatureCount( 0 )
+    , mWithGeometry( true )
+    , mPrecision( 8 )
+{
+  mBuffer.reserve( mBufferSize + 4096 );
+}
+
+QgsWFSFeatureWriter::~QgsWFSFeatureWriter()
+{
+  flush();
+}
+
+void QgsWFSFeatureWriter::setLayer( const QString& typeName, const QgsCoordinateReferenceSystem& crs, const QgsFields* fields,
+                                    const QgsAttributeList& attrIndexes, const QSet<QString>& excludedAttributes, bool withGeometry, int precision )
+{
+  mTypeName = typeName;
+  mTypeNameUtf8 = typeName.toUtf8();
+  mSrsName.clear();
+  if ( crs.isValid() )
+  {
+    appendXmlEscaped( mSrsName, crs.authid() );
+  }
+  mWithGeometry = withGeometry;
+  mPrecision = qBound( 0, precision, 17 );
+
+  mAttributeIndexes.clear();
+  mAttributeNames.clear();
+  if ( !fields )
+  {
+    return;
+  }
+
+  for ( int i = 0; i < attrIndexes.size(); ++i )
+  {
+    int idx = attrIndexes.at( i );
+    if ( idx < 0 || idx >= fields->count() )
+    {
+      continue;
+    }
+
+    QString attributeName = fields->at( idx ).name();
+    //skip attribute if it is excluded from WFS publication
+    if ( excludedAttributes.contains( attributeName ) )
+    {
+      continue;
+    }
+
+    QByteArray name;
+    if ( mFormat == GeoJSON )
+    {
+      appendJsonEscaped( name, attributeName );
+    }
+    else
+    {
+      name = "qgs:" + attributeName.replace( QString( " " ), QString( "_" ) ).toUtf8();
+    }
+    mAttributeIndexes << idx;
+    mAttributeNames << name;
+  }
+}
+
+void QgsWFSFeatureWriter::writeFeature( const QgsFeature& feature )
+{
+  if ( mFormat == GeoJSON )
+  {
+    writeFeatureGeoJSON( feature );
+  }
+  else
+  {
+    writeFeatureGML( feature );
+  }
+  ++mFeatureCount;
+  flushIfFull();
+}
+
+void QgsWFSFeatureWriter::flush()
+{
+  if ( mBuffer.isEmpty() )
+  {
+    return;
+  }
+  mRequest.sendGetFeatureResponse( &mBuffer );
+  mBuffer.clear();
+  mBuffer.reserve( mBufferSize + 4096 );
+}
+
+void QgsWFSFeatureWriter::writeFeatureGML( const QgsFeature& feature )
+{
+  write( "<gml:featureMember><qgs:" );
+  write( mTypeNameUtf8 );
+  write( mFormat == GML3 ? " gml:id=\"" : " fid=\"" );
+  write( mTypeNameUtf8 );
+  write( "." );
+  write( QByteArray::number( feature.id() ) );
+  write( "\">" );
+
+  if ( mWithGeometry )
+  {
+    QgsGeometry* geom = feature.geometry();
+    if ( geom && geom->asWkb() && isSupportedGeometry( geom->asWkb() ) )
+    {
+      write( "<gml:boundedBy>" );
+      writeBoundingBoxGML( geom->boundingBox() );
+      write( "</gml:boundedBy><qgs:geometry>" );
+      writeGeometryGML( geom->asWkb() );
+      write( "</qgs:geometry>" );
+    }
+  }
+
+  const QgsAttributes& attributes = feature.attributes();
+  for ( int i = 0; i < mAttributeIndexes.size(); ++i )
+  {
+    write( "<" );
+    write( mAttributeNames.at( i ) );
+    write( ">" );
+    appendXmlEscaped( mBuffer, attributes.value( mAttributeIndexes.at( i ) ).toString() );
+    write( "</" );
+    write( mAttributeNames.at( i ) );
+    write( ">" );
+  }
+
+  write( "</qgs:" );
+  write( mTypeNameUtf8 );
+  write( "></gml:featureMember>\n" );
+}
+
+void QgsWFSFeatureWriter::writeFeatureGeoJSON( const QgsFeature& feature )
+{
+  write( mFeatureCount == 0 ? "  " : " ," );
+  write( "{\"type\": \"Feature\",\n   \"id\": \"" );
+  appendJsonEscaped( mBuffer, mTypeName );
+  write( "." );
+  write( QByteArray::number( feature.id() ) );
+  write( "\",\n" );
+
+  if ( mWithGeometry )
+  {
+    QgsGeometry* geom = feature.geometry();
+    if ( geom && geom->asWkb() && isSupportedGeometry( geom->asWkb() ) )
+    {
+      QgsRectangle box = geom->boundingBox();
+      write( " \"bbox\": [ " );
+      writeDouble( box.xMinimum() );
+      write( ", " );
+      writeDouble( box.yMinimum() );
+      write( ", " );
+      writeDouble( box.xMaximum() );
+      write( ", " );
+      writeDouble( box.yMaximum() );
+      write( "],\n  \"geometry\": " );
+      writeGeometryGeoJSON( geom->asWkb() );
+      write( ",\n" );
+    }
+  }
+
+  write( "   \"properties\": {\n" );
+  const QgsAttributes& attributes = feature.attributes();
+  for ( int i = 0; i < mAttributeIndexes.size(); ++i )
+  {
+    write( i == 0 ? "    \"" : "   ,\"" );
+    write( mAttributeNames.at( i ) );
+    write( "\": " );
+
+    QVariant val = attributes.value( mAttributeIndexes.at( i ) );
+    switch ( val.type() )
+    {
+      case QVariant::Int:
+      case QVariant::UInt:
+      case QVariant::LongLong:
+      case QVariant::ULongLong:
+      case QVariant::Double:
+        write( val.isNull() ? QByteArray( "null" ) : val.toString().toLatin1() );
+        break;
+      default:
+        write( "\"" );
+        appendJsonEscaped( mBuffer, val.toString() );
+        write( "\"" );
+        break;
+    }
+    write( "\n" );
+  }
+  write( "   }\n  }\n" );
+}
+
+void QgsWFSFeatureWriter::writeSrsName()
+{
+  if ( !mSrsName.isEmpty() )
+  {
+    write( " srsName=\"" );
+    write( mSrsName );
+    write( "\"" );
+  }
+}
+
+void QgsWFSFeatureWriter::writeBoundingBoxGML( const QgsRectangle& box )
+{
+  if ( mFormat == GML3 )
+  {
+    write( "<gml:Envelope" );
+    writeSrsName();
+    write( "><gml:lowerCorner>" );
+    writeDouble( box.xMinimum() );
+    write( " " );
+    writeDouble( box.yMinimum() );
+    write( "</gml:lowerCorner><gml:upperCorner>" );
+    writeDouble( box.xMaximum() );
+    write( " " );
+    writeDouble( box.yMaximum() );
+    write( "</gml:upperCorner></gml:Envelope>" );
+  }
+  else
+  {
+    write( "<gml:Box" );
+    writeSrsName();
+    write( "><gml:coordinates cs=\",\" ts=\" \">" );
+    writeDouble( box.xMinimum() );
+    write( "," );
+    writeDouble( box.yMinimum() );
+    write( " " );
+    writeDouble( box.xMaximum() );
+    write( "," );
+    writeDouble( box.yMaximum() );
+    write( "</gml:coordinates></gml:Box>" );
+  }
+}
+
+void QgsWFSFeatureWriter::writeGeometryGML( const unsigned char* wkb )
+{
+  QgsConstWkbPtr wkbPtr( wkb + 1 );
+  QGis::WkbType wkbType;
+  wkbPtr >> wkbType;
+  bool hasZValue = false;
+
+  switch ( wkbType )
+  {
+    case QGis::WKBPoint25D:
+    case QGis::WKBPoint:
+    {
+      write( "<gml:Point" );
+      writeSrsName();
+      write( ">" );
+      writePointsGML( wkbPtr, 1, false, true );
+      write( "</gml:Point>" );
+      break;
+    }
+    case QGis::WKBMultiPoint25D:
+      hasZValue = true;
+    case QGis::WKBMultiPoint:
+    {
+      write( "<gml:MultiPoint" );
+      writeSrsName();
+      write( ">" );
+      int nPoints;
+      wkbPtr >> nPoints;
+      for ( int idx = 0; idx < nPoints; ++idx )
+      {
+        wkbPtr += 1 + sizeof( int );
+        write( "<gml:pointMember><gml:Point>" );
+        writePointsGML( wkbPtr, 1, hasZValue, true );
+        write( "</gml:Point></gml:pointMember>" );
+      }
+      write( "</gml:MultiPoint>" );
+      break;
+    }
+    case QGis::WKBLineString25D:
+      hasZValue = true;
+    case QGis::WKBLineString:
+    {
+      write( "<gml:LineString" );
+      writeSrsName();
+      write( ">" );
+      int nPoints;
+      wkbPtr >> nPoints;
+      writePointsGML( wkbPtr, nPoints, hasZValue, false );
+      write( "</gml:LineString>" );
+      break;
+    }
+    case QGis::WKBMultiLineString25D:
+      hasZValue = true;
+    case QGis::WKBMultiLineString:
+    {
+      write( "<gml:MultiLineString" );
+      writeSrsName();
+      write( ">" );
+      int nLines;
+      wkbPtr >> nLines;
+      for ( int jdx = 0; jdx < nLines; ++jdx )
+      {
+        wkbPtr += 1 + sizeof( int );
+        int nPoints;
+        wkbPtr >> nPoints;
+        write( "<gml:lineStringMember><gml:LineString>" );
+        writePointsGML( wkbPtr, nPoints, hasZValue, false );
+        write( "</gml:LineString></gml:lineStringMember>" );
+      }
+      write( "</gml:MultiLineString>" );
+      break;
+    }
+    case QGis::WKBPolygon25D:
+      hasZValue = true;
+    case QGis::WKBPolygon:
+    {
+      write( "<gml:Polygon" );
+      writeSrsName();
+      write( ">" );
+      writePolygonGML( wkbPtr, hasZValue );
+      write( "</gml:Polygon>" );
+      break;
+    }
+    case QGis::WKBMultiPolygon25D:
+      hasZValue = true;
+    case QGis::WKBMultiPolygon:
+    {
+      write( "<gml:MultiPolygon" );
+      writeSrsName();
+      write( ">" );
+      int nPolygons;
+      wkbPtr >> nPolygons;
+      for ( int kdx = 0; kdx < nPolygons; ++kdx )
+      {
+        wkbPtr += 1 + sizeof( int );
+        write( "<gml:polygonMember><gml:Polygon>" );
+        writePolygonGML( wkbPtr, hasZValue );
+        write( "</gml:Polygon></gml:polygonMember>" );
+      }
+      write( "</gml:MultiPolygon>" );
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+void QgsWFSFeatureWriter::writePolygonGML( QgsConstWkbPtr& wkbPtr, bool hasZValue )
+{
+  int nRings;
+  wkbPtr >> nRings;
+  for ( int idx = 0; idx < nRings; ++idx )
+  {
+    int nPoints;
+    wkbPtr >> nPoints;
+    write( idx == 0 ? "<gml:outerBoundaryIs><gml:LinearRing>" : "<gml:innerBoundaryIs><gml:LinearRing>" );
+    writePointsGML( wkbPtr, nPoints, hasZValue, false );
+    write( idx == 0 ? "</gml:LinearRing></gml:outerBoundaryIs>" : "</gml:LinearRing></gml:innerBoundaryIs>" );
+  }
+}
+
+void QgsWFSFeatureWriter::writePointsGML( QgsConstWkbPtr& wkbPtr, int nPoints, bool hasZValue, bool isPoint )
+{
+  const char* cs = ",";
+  if ( mFormat == GML3 )
+  {
+    write( isPoint ? "<gml:pos srsDimension=\"2\">" : "<gml:posList srsDimension=\"2\">" );
+    cs = " ";
+  }
+  else
+  {
+    write( "<gml:coordinates cs=\",\" ts=\" \">" );
+  }
+
+  for ( int idx = 0; idx < nPoints; ++idx )
+  {
+    if ( idx != 0 )
+    {
+      write( " " );
+    }
+
+    double x, y;
+    wkbPtr >> x >> y;
+    if ( hasZValue )
+    {
+      wkbPtr += sizeof( double );
+    }
+    writeDouble( x );
+    write( cs );
+    writeDouble( y );
+  }
+
+  if ( mFormat == GML3 )
+  {
+    write( isPoint ? "</gml:pos>" : "</gml:posList>" );
+  }
+  else
+  {
+    write( "</gml:coordinates>" );
+  }
+}
+
+void QgsWFSFeatureWriter::writeGeometryGeoJSON( const unsigned char* wkb )
+{
+  QgsConstWkbPtr wkbPtr( wkb + 1 );
+  QGis::WkbType wkbType;
+  wkbPtr >> wkbType;
+  bool hasZValue = false;
+
+  switch ( wkbType )
+  {
+    case QGis::WKBPoint25D:
+    case QGis::WKBPoint:
+    {
+      write( "{ \"type\": \"Point\", \"coordinates\": " );
+      writePointsGeoJSON( wkbPtr, 1, false );
+      write( " }" );
+      break;
+    }
+    case QGis::WKBMultiPoint25D:
+      hasZValue = true;
+    case QGis::WKBMultiPoint:
+    {
+      write( "{ \"type\": \"MultiPoint\", \"coordinates\": [ " );
+      int nPoints;
+      wkbPtr >> nPoints;
+      for ( int idx = 0; idx < nPoints; ++idx )
+      {
+        if ( idx != 0 )
+        {
+          write( ", " );
+        }
+        wkbPtr += 1 + sizeof( int );
+        writePointsGeoJSON( wkbPtr, 1, hasZValue );
+      }
+      write( " ] }" );
+      break;
+    }
+    case QGis::WKBLineString25D:
+      hasZValue = true;
+    case QGis::WKBLineString:
+    {
+      write( "{ \"type\": \"LineString\", \"coordinates\": [ " );
+      int nPoints;
+      wkbPtr >> nPoints;
+      writePointsGeoJSON( wkbPtr, nPoints, hasZValue );
+      write( " ] }" );
+      break;
+    }
+    case QGis::WKBMultiLineString25D:
+      hasZValue = true;
+    case QGis::WKBMultiLineString:
+    {
+      write( "{ \"type\": \"MultiLineString\", \"coordinates\": [ " );
+      int nLines;
+      wkbPtr >> nLines;
+      for ( int jdx = 0; jdx < nLines; ++jdx )
+      {
+        if ( jdx != 0 )
+        {
+          write( ", " );
+        }
+        wkbPtr += 1 + sizeof( int );
+        int nPoints;
+        wkbPtr >> nPoints;
+        write( "[ " );
+        writePointsGeoJSON( wkbPtr, nPoints, hasZValue );
+        write( " ]" );
+      }
+      write( " ] }" );
+      break;
+    }
+    case QGis::WKBPolygon25D:
+      hasZValue = true;
+    case QGis::WKBPolygon:
+    {
+      write( "{ \"type\": \"Polygon\", \"coordinates\": " );
+      writePolygonGeoJSON( wkbPtr, hasZValue );
+      write( " }" );
+      break;
+    }
+    case QGis::WKBMultiPolygon25D:
+      hasZValue = true;
+    case QGis::WKBMultiPolygon:
+    {
+      write( "{ \"type\": \"MultiPolygon\", \"coordinates\": [ " );
+      int nPolygons;
+      wkbPtr >> nPolygons;
+      for ( int kdx = 0; kdx < nPolygons; ++kdx )
+      {
+        if ( kdx != 0 )
+        {
+          write( ", " );
+        }
+        wkbPtr += 1 + sizeof( int );
+        writePolygonGeoJSON( wkbPtr, hasZValue );
+      }
+      write( " ] }" );
+      break;
+    }
+    default:
+      write( "null" );
+      break;
+  }
+}
+
+void QgsWFSFeatureWriter::writePolygonGeoJSON( QgsConstWkbPtr& wkbPtr, bool hasZValue )
+{
+  write( "[ " );
+  int nRings;
+  wkbPtr >> nRings;
+  for ( int idx = 0; idx < nRings; ++idx )
+  {
+    if ( idx != 0 )
+    {
+      write( ", " );
+    }
+    int nPoints;
+    wkbPtr >> nPoints;
+    write( "[ " );
+    writePointsGeoJSON( wkbPtr, nPoints, hasZValue );
+    write( " ]" );
+  }
+  write( " ]" );
+}
+
+void QgsWFSFeatureWriter::writePointsGeoJSON( QgsConstWkbPtr& wkbPtr, int nPoints, bool hasZValue )
+{
+  for ( int idx = 0; idx < nPoints; ++idx )
+  {
+    if ( idx != 0 )
+    {
+      write( ", " );
+    }
+
+    double x, y;
+    wkbPtr >> x >> y;
+    if ( hasZValue )
+    {
+      wkbPtr += sizeof( double );
+    }
+    write( "[" );
+    writeDouble( x );
+    write( ", " );
+    writeDouble( y );
+    write( "]" );
+  }
+}
+
+void QgsWFSFeatureWriter::writeDouble( double value )
+{
+  //QByteArray::number does not depend on the locale (unlike printf)
+  QByteArray number = QByteArray::number( value, 'f', mPrecision );
+  if ( mPrecision > 0 )
+  {
+    int length = number.size();
+    while ( length > 1 && number.at( length - 1 ) == '0' )
+    {
+      --length;
+    }
+    if ( number.at( length - 1 ) == '.' )
+    {
+      --length;
+    }
+    number.truncate( length );
+  }
+  if ( number == "-0" )
+  {
+    number = "0";
+  }
+  mBuffer.append( number );
+}
+
+void QgsWFSFeatureWriter::appendXmlEscaped( QByteArray& out, const QString& text )
+{
+  QByteArray utf8 = text.toUtf8();
+  const char* c = utf8.constData();
+  for ( int i = 0; i < utf8.size(); ++i )
+  {
+    switch ( c[i] )
+    {
+      case '&':
+        out.append( "&amp;" );
+        break;
+      case '<':
+        out.append( "&lt;" );
+        break;
+      case '>':
+        out.append( "&gt;" );
+        break;
+      case '"':
+        out.append( "&quot;" );
+        break;
+      default:
+        out.append( c[i] );
+        break;
+    }
+  }
+}
+
+void QgsWFSFeatureWriter::appendJsonEscaped( QByteArray& out, const QString& text )
+{
+  QByteArray utf8 = text.toUtf8();
+  const char* c = utf8.constData();
+  for ( int i = 0; i < utf8.size(); ++i )
+  {
+    switch ( c[i] )
+    {
+      case '"':
+        out.append( "\\\"" );
+        break;
+      case '\\':
+        out.append( "\\\\" );
+        break;
+      case '\n':
+        out.append( "\\n" );
+        break;
+      case '\r':
+        out.append( "\\r" );
+        break;
+      case '\t':
+        out.append( "\\t" );
+        break;
+      default:
+        if (( unsigned char ) c[i] < 0x20 )
+        {
+          out.append( QString( "\\u%1" ).arg(( int )( unsigned char ) c[i], 4, 16, QChar( '0' ) ).toLatin1() );
+        }
+        else
+        {
+          out.append( c[i] );
+        }
+        break;
+    }
+  }
+}
+
+bool QgsWFSFeatureWriter::isSupportedGeometry( const unsigned char* wkb )
+{
+  QgsConstWkbPtr wkbPtr( wkb + 1 );
+  QGis::WkbType wkbType;
+  wkbPtr >> wkbType;
+
+  switch ( wkbType )
+  {
+    case QGis::WKBPoint:
+    case QGis::WKBPoint25D:
+    case QGis::WKBMultiPoint:
+    case QGis::WKBMultiPoint25D:
+    case QGis::WKBLineString:
+    case QGis::WKBLineString25D:
+    case QGis::WKBMultiLineString:
+    case QGis::WKBMultiLineString25D:
+    case QGis::WKBPolygon:
+    case QGis::WKBPolygon25D:
+    case QGis::WKBMultiPolygon:
+    case QGis::WKBMultiPolygon25D:
+      return true;
+    default:
+      return false;
+  }
+}
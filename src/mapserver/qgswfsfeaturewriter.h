@@ -0,0 +1,121 @@
+/***************************************************************************
+                              qgswfsfeaturewriter.h
+                              ---------------------
+  begin                : January 2014
+  copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSWFSFEATUREWRITER_H
+#define QGSWFSFEATUREWRITER_H
+
+#include "qgsfeature.h"
+#include "qgsfeaturerequest.h"
+#include <QByteArray>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+class QgsConstWkbPtr;
+class QgsCoordinateReferenceSystem;
+class QgsFields;
+class QgsRectangle;
+class QgsRequestHandler;
+
+/**Writes the features of a WFS GetFeature response as GML2, GML3 or GeoJSON.
+The output is generated directly from the feature attributes and the WKB of the geometry
+into a buffer which is sent through the request handler whenever it is full. The memory
+use does not depend on the number of features*/
+class QgsWFSFeatureWriter
+{
+  public:
+    enum Format
+    {
+      GML2,
+      GML3,
+      GeoJSON
+    };
+
+    /**Constructor
+      @param request handler to send the output (the response has to be started already)
+      @param format output format
+      @param bufferSize number of bytes collected before they are sent*/
+    QgsWFSFeatureWriter( QgsRequestHandler& request, Format format, int bufferSize = 65536 );
+    /**Sends the remaining output*/
+    ~QgsWFSFeatureWriter();
+
+    /**Sets the layer of the following features
+      @param typeName WFS type name
+      @param crs the srsName of the geometries (omitted if invalid)
+      @param fields fields of the features
+      @param attrIndexes attributes to write
+      @param excludedAttributes names of attributes not published by WFS
+      @param withGeometry write geometries and bounding boxes
+      @param precision number of decimal places of the coordinates*/
+    void setLayer( const QString& typeName, const QgsCoordinateReferenceSystem& crs, const QgsFields* fields,
+                   const QgsAttributeList& attrIndexes, const QSet<QString>& excludedAttributes, bool withGeometry, int precision );
+    /**Type name set with setLayer()*/
+    const QString& typeName() const { return mTypeName; }
+
+    void writeFeature( const QgsFeature& feature );
+
+    /**Number of features written*/
+    int featureCount() const { return mFeatureCount; }
+
+    /**Sends the buffered output*/
+    void flush();
+
+  private:
+    void writeFeatureGML( const QgsFeature& feature );
+    void writeFeatureGeoJSON( const QgsFeature& feature );
+
+    void writeGeometryGML( const unsigned char* wkb );
+    void writePolygonGML( QgsConstWkbPtr& wkbPtr, bool hasZValue );
+    void writeGeometryGeoJSON( const unsigned char* wkb );
+    void writePolygonGeoJSON( QgsConstWkbPtr& wkbPtr, bool hasZValue );
+    void writeBoundingBoxGML( const QgsRectangle& box );
+    void writeSrsName();
+
+    /**Writes the coordinates of a point list and advances the pointer
+      @param isPoint true for point geometries (gml:pos instead of gml:posList in GML3)*/
+    void writePointsGML( QgsConstWkbPtr& wkbPtr, int nPoints, bool hasZValue, bool isPoint );
+    void writePointsGeoJSON( QgsConstWkbPtr& wkbPtr, int nPoints, bool hasZValue );
+
+    /**Writes a coordinate with mPrecision decimal places (without trailing zeros)*/
+    void writeDouble( double value );
+    static void appendXmlEscaped( QByteArray& out, const QString& text );
+    static void appendJsonEscaped( QByteArray& out, const QString& text );
+
+    /**Returns true if the geometry type can be written*/
+    static bool isSupportedGeometry( const unsigned char* wkb );
+
+    inline void write( const char* text ) { mBuffer.append( text ); }
+    inline void write( const QByteArray& text ) { mBuffer.append( text ); }
+    inline void flushIfFull() { if ( mBuffer.size() >= mBufferSize ) flush(); }
+
+    QgsRequestHandler& mRequest;
+    Format mFormat;
+    int mBufferSize;
+    QByteArray mBuffer;
+    int mFeatureCount;
+
+    //layer settings
+    QString mTypeName;
+    QByteArray mTypeNameUtf8;
+    QByteArray mSrsName;
+    bool mWithGeometry;
+    int mPrecision;
+    /**Indexes and (escaped) element or property names of the written attributes*/
+    QVector<int> mAttributeIndexes;
+    QVector<QByteArray> mAttributeNames;
+};
+
+#endif // QGSWFSFEATUREWRITER_H
@@ -39,6 +39,7 @@
 #include "qgslegendmodel.h"
 #include "qgscomposerlegenditem.h"
 #include "qgsrequesthandler.h"
+#include "qgswfsfeaturewriter.h"
 #include "qgsogcutils.h"
 
 #include <QImage>
@@ -69,14 +70,20 @@ static const QString QGS_NAMESPACE = "http://www.qgis.org/gml";
 QgsWFSServer::QgsWFSServer( QMap<QString, QString> parameters )
     : mParameterMap( parameters )
     , mConfigParser( 0 )
+    , mPrecision( 8 )
+    , mFeatureWriter( 0 )
 {
 }
 
 QgsWFSServer::~QgsWFSServer()
 {
+  delete mFeatureWriter;
 }
 
 QgsWFSServer::QgsWFSServer()
+    : mConfigParser( 0 )
+    , mPrecision( 8 )
+    , mFeatureWriter( 0 )
 {
 }
 
@@ -425,6 +432,7 @@ int QgsWFSServer::getFeature( QgsRequestHandler& request, const QString& format
                         , searchRect.xMaximum() + 0.000001
                         , searchRect.yMaximum() + 0.000001 );
         layerCrs = layer->crs();
+        mPrecision = mConfigParser->wfsLayerPrecision( layer->id() );
 
         if ( maxFeatures == -1 )
           maxFeat += layer->featureCount();
@@ -782,6 +790,7 @@ int QgsWFSServer::getFeature( QgsRequestHandler& request, const QString& format
                         searchRect.xMaximum() + 0.000001,
                         searchRect.yMaximum() + 0.000001 );
       layerCrs = layer->crs();
+      mPrecision = mConfigParser->wfsLayerPrecision( layer->id() );
 
       long featCounter = 0;
       if ( featureIdOk )
@@ -1152,51 +1161,41 @@ void QgsWFSServer::startGetFeature( QgsRequestHandler& request, const QString& f
     request.sendGetFeatureResponse( &result );
   }
   fcString = "";
+
+  delete mFeatureWriter;
+  QgsWFSFeatureWriter::Format writerFormat = QgsWFSFeatureWriter::GML2;
+  if ( format == "GeoJSON" )
+  {
+    writerFormat = QgsWFSFeatureWriter::GeoJSON;
+  }
+  else if ( format == "GML3" )
+  {
+    writerFormat = QgsWFSFeatureWriter::GML3;
+  }
+  mFeatureWriter = new QgsWFSFeatureWriter( request, writerFormat );
 }
 
 void QgsWFSServer::sendGetFeature( QgsRequestHandler& request, const QString& format, QgsFeature* feat, int featIdx, QgsCoordinateReferenceSystem& crs, QgsAttributeList attrIndexes, QSet<QString> excludedAttributes ) /*const*/
 {
-  if ( !feat->isValid() )
+  Q_UNUSED( request );
+  Q_UNUSED( format );
+  if ( !feat->isValid() || !mFeatureWriter )
     return;
 
-  QByteArray result;
-  if ( format == "GeoJSON" )
-  {
-    QString fcString;
-    if ( featIdx == 0 )
-      fcString += "  ";
-    else
-      fcString += " ,";
-    fcString += createFeatureGeoJSON( feat, crs, attrIndexes, excludedAttributes );
-    fcString += "\n";
-
-    result = fcString.toUtf8();
-    request.sendGetFeatureResponse( &result );
-    fcString = "";
-  }
-  else
+  //first feature of a layer
+  if ( featIdx == 0 || mFeatureWriter->typeName() != mTypeName )
   {
-    QDomDocument gmlDoc;
-    QDomElement featureElement;
-    if ( format == "GML3" )
-    {
-      featureElement = createFeatureGML3( feat, gmlDoc, crs, attrIndexes, excludedAttributes );
-      gmlDoc.appendChild( featureElement );
-    }
-    else
-    {
-      featureElement = createFeatureGML2( feat, gmlDoc, crs, attrIndexes, excludedAttributes );
-      gmlDoc.appendChild( featureElement );
-    }
-
-    result = gmlDoc.toByteArray();
-    request.sendGetFeatureResponse( &result );
-    gmlDoc.removeChild( featureElement );
+    mFeatureWriter->setLayer( mTypeName, crs, feat->fields(), attrIndexes, excludedAttributes, mWithGeom, mPrecision );
   }
+  mFeatureWriter->writeFeature( *feat );
 }
 
 void QgsWFSServer::endGetFeature( QgsRequestHandler& request, const QString& format )
 {
+  //send the buffered features
+  delete mFeatureWriter;
+  mFeatureWriter = 0;
+
   QByteArray result;
   QString fcString;
   if ( format == "GeoJSON" )
@@ -1634,187 +1633,6 @@ QgsFeatureIds QgsWFSServer::getFeatureIdsFromFilter( QDomElement filterElem, Qgs
   return fids;
 }
 
-QString QgsWFSServer::createFeatureGeoJSON( QgsFeature* feat, QgsCoordinateReferenceSystem &, QgsAttributeList attrIndexes, QSet<QString> excludedAttributes ) /*const*/
-{
-  QString fStr = "{\"type\": \"Feature\",\n";
-
-  fStr += "   \"id\": ";
-  fStr += "\"" + mTypeName + "." + QString::number( feat->id() ) + "\"";
-  fStr += ",\n";
-
-  QgsGeometry* geom = feat->geometry();
-  if ( geom && mWithGeom )
-  {
-    QgsRectangle box = geom->boundingBox();
-
-    fStr += " \"bbox\": [ " + QString::number( box.xMinimum(), 'f', 8 ).remove( QRegExp( "[0]{1,7}$" ) ) + ", " + QString::number( box.yMinimum(), 'f', 8 ).remove( QRegExp( "[0]{1,7}$" ) ) + ", " + QString::number( box.xMaximum(), 'f', 8 ).remove( QRegExp( "[0]{1,7}$" ) ) + ", " + QString::number( box.yMaximum(), 'f', 8 ).remove( QRegExp( "[0]{1,7}$" ) ) + "],\n";
-
-    fStr += "  \"geometry\": ";
-    fStr += geom->exportToGeoJSON();
-    fStr += ",\n";
-  }
-
-  //read all attribute values from the feature
-  fStr += "   \"properties\": {\n";
-  QgsAttributes featureAttributes = feat->attributes();
-  const QgsFields* fields = feat->fields();
-  int attributeCounter = 0;
-  for ( int i = 0; i < attrIndexes.count(); ++i )
-  {
-    int idx = attrIndexes[i];
-    QString attributeName = fields->at( idx ).name();
-    //skip attribute if it is excluded from WFS publication
-    if ( excludedAttributes.contains( attributeName ) )
-    {
-      continue;
-    }
-    QVariant val = featureAttributes[idx];
-
-    if ( attributeCounter == 0 )
-      fStr += "    \"";
-    else
-      fStr += "   ,\"";
-    fStr += attributeName;
-    fStr += "\": ";
-    if ( val.type() == 6 || val.type() == 2 )
-    {
-      fStr +=  val.toString();
-    }
-    else
-    {
-      fStr += "\"";
-      fStr +=  val.toString().replace( QString( "\"" ), QString( "\\\"" ) );
-      fStr += "\"";
-    }
-    fStr += "\n";
-    ++attributeCounter;
-  }
-
-  fStr += "   }\n";
-
-  fStr += "  }";
-
-  return fStr;
-}
-
-QDomElement QgsWFSServer::createFeatureGML2( QgsFeature* feat, QDomDocument& doc, QgsCoordinateReferenceSystem& crs, QgsAttributeList attrIndexes, QSet<QString> excludedAttributes ) /*const*/
-{
-  //gml:FeatureMember
-  QDomElement featureElement = doc.createElement( "gml:featureMember"/*wfs:FeatureMember*/ );
-
-  //qgs:%TYPENAME%
-  QDomElement typeNameElement = doc.createElement( "qgs:" + mTypeName /*qgs:%TYPENAME%*/ );
-  typeNameElement.setAttribute( "fid", mTypeName + "." + QString::number( feat->id() ) );
-  featureElement.appendChild( typeNameElement );
-
-  if ( mWithGeom )
-  {
-    //add geometry column (as gml)
-    QgsGeometry* geom = feat->geometry();
-
-    QDomElement geomElem = doc.createElement( "qgs:geometry" );
-    QDomElement gmlElem = QgsOgcUtils::geometryToGML( geom, doc );
-    if ( !gmlElem.isNull() )
-    {
-      QgsRectangle box = geom->boundingBox();
-      QDomElement bbElem = doc.createElement( "gml:boundedBy" );
-      QDomElement boxElem = QgsOgcUtils::rectangleToGMLBox( &box, doc );
-
-      if ( crs.isValid() )
-      {
-        boxElem.setAttribute( "srsName", crs.authid() );
-        gmlElem.setAttribute( "srsName", crs.authid() );
-      }
-
-      bbElem.appendChild( boxElem );
-      typeNameElement.appendChild( bbElem );
-
-      geomElem.appendChild( gmlElem );
-      typeNameElement.appendChild( geomElem );
-    }
-  }
-
-  //read all attribute values from the feature
-  QgsAttributes featureAttributes = feat->attributes();
-  const QgsFields* fields = feat->fields();
-  for ( int i = 0; i < attrIndexes.count(); ++i )
-  {
-    int idx = attrIndexes[i];
-    QString attributeName = fields->at( idx ).name();
-    //skip attribute if it is excluded from WFS publication
-    if ( excludedAttributes.contains( attributeName ) )
-    {
-      continue;
-    }
-
-    QDomElement fieldElem = doc.createElement( "qgs:" + attributeName.replace( QString( " " ), QString( "_" ) ) );
-    QDomText fieldText = doc.createTextNode( featureAttributes[idx].toString() );
-    fieldElem.appendChild( fieldText );
-    typeNameElement.appendChild( fieldElem );
-  }
-
-  return featureElement;
-}
-
-QDomElement QgsWFSServer::createFeatureGML3( QgsFeature* feat, QDomDocument& doc, QgsCoordinateReferenceSystem& crs, QgsAttributeList attrIndexes, QSet<QString> excludedAttributes ) /*const*/
-{
-  //gml:FeatureMember
-  QDomElement featureElement = doc.createElement( "gml:featureMember"/*wfs:FeatureMember*/ );
-
-  //qgs:%TYPENAME%
-  QDomElement typeNameElement = doc.createElement( "qgs:" + mTypeName /*qgs:%TYPENAME%*/ );
-  typeNameElement.setAttribute( "gml:id", mTypeName + "." + QString::number( feat->id() ) );
-  featureElement.appendChild( typeNameElement );
-
-  if ( mWithGeom )
-  {
-    //add geometry column (as gml)
-    QgsGeometry* geom = feat->geometry();
-
-    QDomElement geomElem = doc.createElement( "qgs:geometry" );
-    QDomElement gmlElem = QgsOgcUtils::geometryToGML( geom, doc, "GML3" );
-    if ( !gmlElem.isNull() )
-    {
-      QgsRectangle box = geom->boundingBox();
-      QDomElement bbElem = doc.createElement( "gml:boundedBy" );
-      QDomElement boxElem = QgsOgcUtils::rectangleToGMLEnvelope( &box, doc );
-
-      if ( crs.isValid() )
-      {
-        boxElem.setAttribute( "srsName", crs.authid() );
-        gmlElem.setAttribute( "srsName", crs.authid() );
-      }
-
-      bbElem.appendChild( boxElem );
-      typeNameElement.appendChild( bbElem );
-
-      geomElem.appendChild( gmlElem );
-      typeNameElement.appendChild( geomElem );
-    }
-  }
-
-  //read all attribute values from the feature
-  QgsAttributes featureAttributes = feat->attributes();
-  const QgsFields* fields = feat->fields();
-  for ( int i = 0; i < attrIndexes.count(); ++i )
-  {
-    int idx = attrIndexes[i];
-    QString attributeName = fields->at( idx ).name();
-    //skip attribute if it is excluded from WFS publication
-    if ( excludedAttributes.contains( attributeName ) )
-    {
-      continue;
-    }
-
-    QDomElement fieldElem = doc.createElement( "qgs:" + attributeName.replace( QString( " " ), QString( "_" ) ) );
-    QDomText fieldText = doc.createTextNode( featureAttributes[idx].toString() );
-    fieldElem.appendChild( fieldText );
-    typeNameElement.appendChild( fieldElem );
-  }
-
-  return featureElement;
-}
-
 QString QgsWFSServer::serviceUrl() const
 {
   QUrl mapUrl( getenv( "REQUEST_URI" ) );
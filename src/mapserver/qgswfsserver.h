@@ -43,6 +43,7 @@ class QgsRectangle;
 class QgsGeometry;
 class QgsSymbol;
 class QgsRequestHandler;
+class QgsWFSFeatureWriter;
 class QFile;
 class QFont;
 class QImage;
@@ -93,6 +94,10 @@ class QgsWFSServer
     QStringList mTypeNames;
     QString mPropertyName;
     bool mWithGeom;
+    /* Number of decimal places of the coordinates of the current layer */
+    int mPrecision;
+    /* Writes the features of the GetFeature response (between startGetFeature and endGetFeature) */
+    QgsWFSFeatureWriter* mFeatureWriter;
     /* Error messages */
     QStringList mErrors;
 
@@ -104,15 +109,6 @@ class QgsWFSServer
 
     //method for transaction
     QgsFeatureIds getFeatureIdsFromFilter( QDomElement filter, QgsVectorLayer* layer );
-
-    //methods to write GeoJSON
-    QString createFeatureGeoJSON( QgsFeature* feat, QgsCoordinateReferenceSystem& crs, QgsAttributeList attrIndexes, QSet<QString> excludedAttributes ) /*const*/;
-
-    //methods to write GML2
-    QDomElement createFeatureGML2( QgsFeature* feat, QDomDocument& doc, QgsCoordinateReferenceSystem& crs, QgsAttributeList attrIndexes, QSet<QString> excludedAttributes ) /*const*/;
-
-    //methods to write GML3
-    QDomElement createFeatureGML3( QgsFeature* feat, QDomDocument& doc, QgsCoordinateReferenceSystem& crs, QgsAttributeList attrIndexes, QSet<QString> excludedAttributes ) /*const*/;
 };
 
 #endif
@@ -18,6 +18,7 @@
 #include "qgswmsserver.h"
 #include "qgsconfigparser.h"
 #include "qgscrscache.h"
+#include "qgsexpression.h"
 #include "qgsfield.h"
 #include "qgsgeometry.h"
 #include "qgsmaplayer.h"
@@ -27,6 +28,8 @@
 #include "qgsproject.h"
 #include "qgsrasteridentifyresult.h"
 #include "qgsrasterlayer.h"
+#include "qgsrasterpipe.h"
+#include "qgsrasterprojector.h"
 #include "qgsscalecalculator.h"
 #include "qgscoordinatereferencesystem.h"
 #include "qgsvectordataprovider.h"
@@ -41,6 +44,8 @@
 #include "qgspaintenginehack.h"
 #include "qgsogcutils.h"
 #include "qgsfeature.h"
+#include "qgswmstilecache.h"
+#include "qgsmslayercache.h"
 
 #include <QImage>
 #include <QPainter>
@@ -48,6 +53,8 @@
 #include <QTextStream>
 #include <QDir>
 
+#include <cmath>
+
 //for printing
 #include "qgscomposition.h"
 #include <QBuffer>
@@ -630,28 +637,22 @@ QByteArray* QgsWMSServer::getPrint( const QString& formatString )
   }
   delete theImage;
 
-  QMap<QString, QString> originalLayerFilters = applyRequestedLayerFilters( layersList );
-  QStringList selectedLayerIdList = applyFeatureSelections( layersList );
-
   //GetPrint request needs a template parameter
   if ( !mParameterMap.contains( "TEMPLATE" ) )
   {
     throw QgsMapServiceException( "ParameterMissing", "The TEMPLATE parameter is required for the GetPrint request" );
   }
 
-  QList< QPair< QgsVectorLayer*, QgsFeatureRendererV2*> > bkVectorRenderers;
-  QList< QPair< QgsRasterLayer*, QgsRasterRenderer* > > bkRasterRenderers;
-  QList< QPair< QgsVectorLayer*, double > > labelTransparencies;
-  QList< QPair< QgsVectorLayer*, double > > labelBufferTransparencies;
-
-  applyOpacities( layersList, bkVectorRenderers, bkRasterRenderers, labelTransparencies, labelBufferTransparencies );
-
+  //the composer maps take the layer overrides from the map renderer
+  QgsRenderContext* context = mMapRenderer->rendererContext();
+  setRequestedLayerFilters( layersList, *context );
+  setFeatureSelections( layersList, *context );
+  setOpacities( layersList, *context );
 
   QgsComposition* c = mConfigParser->createPrintComposition( mParameterMap[ "TEMPLATE" ], mMapRenderer, QMap<QString, QString>( mParameterMap ) );
   if ( !c )
   {
-    restoreLayerFilters( originalLayerFilters );
-    clearFeatureSelections( selectedLayerIdList );
+    context->clearLayerOverrides();
     return 0;
   }
 
@@ -699,8 +700,7 @@ QByteArray* QgsWMSServer::getPrint( const QString& formatString )
     if ( !tempFile.open() )
     {
       delete c;
-      restoreLayerFilters( originalLayerFilters );
-      clearFeatureSelections( selectedLayerIdList );
+      context->clearLayerOverrides();
       return 0;
     }
 
@@ -713,9 +713,7 @@ QByteArray* QgsWMSServer::getPrint( const QString& formatString )
     throw QgsMapServiceException( "InvalidFormat", "Output format '" + formatString + "' is not supported in the GetPrint request" );
   }
 
-  restoreOpacities( bkVectorRenderers, bkRasterRenderers, labelTransparencies, labelBufferTransparencies );
-  restoreLayerFilters( originalLayerFilters );
-  clearFeatureSelections( selectedLayerIdList );
+  context->clearLayerOverrides();
 
   delete c;
   return ba;
@@ -745,21 +743,50 @@ QImage* QgsWMSServer::getMap()
   {
     throw QgsMapServiceException( "Size error", "The requested map size is too large" );
   }
+
+  QImage* theImage = tiledMap();
+  if ( !theImage )
+  {
+    theImage = renderMap();
+  }
+
+#ifdef QGISDEBUG
+  if ( theImage )
+  {
+    theImage->save( QDir::tempPath() + QDir::separator() + "lastrender.png" );
+  }
+#endif
+  return theImage;
+}
+
+QImage* QgsWMSServer::renderMap( bool metaTile )
+{
   QStringList layersList, stylesList, layerIdList;
   QImage* theImage = initializeRendering( layersList, stylesList, layerIdList );
+  if ( !theImage )
+  {
+    return 0;
+  }
+
+  //only metatile grids are requested again (after the tiles are dropped from the tile cache), the index maps
+  //of arbitrary GetMap sizes would never be used twice. Set it every time as the layers are cached
+  foreach ( QString layerId, layerIdList )
+  {
+    QgsRasterLayer* rl = qobject_cast<QgsRasterLayer*>( QgsMapLayerRegistry::instance()->mapLayer( layerId ) );
+    if ( rl && rl->pipe()->projector() )
+    {
+      rl->pipe()->projector()->setPrecomputeIndexMap( metaTile );
+    }
+  }
 
   QPainter thePainter( theImage );
   thePainter.setRenderHint( QPainter::Antialiasing ); //make it look nicer
 
-  QMap<QString, QString> originalLayerFilters = applyRequestedLayerFilters( layersList );
-  QStringList selectedLayerIdList = applyFeatureSelections( layersList );
-
-  QList< QPair< QgsVectorLayer*, QgsFeatureRendererV2*> > bkVectorRenderers;
-  QList< QPair< QgsRasterLayer*, QgsRasterRenderer* > > bkRasterRenderers;
-  QList< QPair< QgsVectorLayer*, double > > labelTransparencies;
-  QList< QPair< QgsVectorLayer*, double > > labelBufferTransparencies;
-
-  applyOpacities( layersList, bkVectorRenderers, bkRasterRenderers, labelTransparencies, labelBufferTransparencies );
+  //request specific layer state is passed to the renderer, the cached layers are not modified
+  QgsRenderContext* context = mMapRenderer->rendererContext();
+  setRequestedLayerFilters( layersList, *context );
+  setFeatureSelections( layersList, *context );
+  setOpacities( layersList, *context );
 
   mMapRenderer->render( &thePainter );
   if ( mConfigParser )
@@ -768,19 +795,147 @@ QImage* QgsWMSServer::getMap()
     mConfigParser->drawOverlays( &thePainter, theImage->dotsPerMeterX() / 1000.0 * 25.4, theImage->width(), theImage->height() );
   }
 
-  restoreOpacities( bkVectorRenderers, bkRasterRenderers, labelTransparencies, labelBufferTransparencies );
-  restoreLayerFilters( originalLayerFilters );
-  clearFeatureSelections( selectedLayerIdList );
-
   QgsDebugMsg( "clearing filters" );
+  context->clearLayerOverrides();
   QgsMapLayerRegistry::instance()->removeAllMapLayers();
-
-#ifdef QGISDEBUG
-  theImage->save( QDir::tempPath() + QDir::separator() + "lastrender.png" );
-#endif
   return theImage;
 }
 
+static QString tileKey( const QString& requestKey, const QDateTime& dataTimestamp, double column, double row )
+{
+  //tiles rendered before a data file of the project changed are not used anymore
+  return requestKey + QString( "|%1|%2|%3" ).arg( dataTimestamp.isValid() ? dataTimestamp.toTime_t() : 0 )
+         .arg( column, 0, 'f', 0 ).arg( row, 0, 'f', 0 );
+}
+
+QImage* QgsWMSServer::tiledMap()
+{
+  QgsWMSTileCache* tileCache = QgsWMSTileCache::instance();
+  //requests with external styles or data are not cached
+  if ( !mConfigParser || tileCache->metaTileSize() < 1 || mConfigFilePath.isEmpty()
+       || mParameterMap.contains( "SLD" ) || mParameterMap.contains( "GML" ) )
+  {
+    return 0;
+  }
+
+  //the metatile has to respect the maximum image size of the project
+  int metaTileSize = tileCache->metaTileSize( mConfigParser->maxWidth(), mConfigParser->maxHeight() );
+  int tileSize = tileCache->tileSize();
+  if ( mParameterMap.value( "WIDTH" ).toInt() != tileSize || mParameterMap.value( "HEIGHT" ).toInt() != tileSize )
+  {
+    return 0;
+  }
+
+  QStringList bbox = mParameterMap.value( "BBOX" ).split( "," );
+  if ( bbox.size() != 4 )
+  {
+    return 0;
+  }
+  double coords[4];
+  for ( int i = 0; i < 4; ++i )
+  {
+    bool conversionSuccess;
+    coords[i] = bbox.at( i ).toDouble( &conversionSuccess );
+    if ( !conversionSuccess )
+    {
+      return 0;
+    }
+  }
+
+  //the grid is applied in BBOX axis order. For WMS 1.3.0 with inverted axis, the first coordinate is y
+  QString crs = mParameterMap.value( "CRS", mParameterMap.value( "SRS" ) );
+  bool inverted = mParameterMap.value( "VERSION", "1.3.0" ) != "1.1.1" && !crs.isEmpty()
+                  && QgsCRSCache::instance()->crsByAuthId( crs ).axisInverted();
+  double originA = inverted ? tileCache->originY() : tileCache->originX();
+  double originB = inverted ? tileCache->originX() : tileCache->originY();
+
+  double tileWidth = coords[2] - coords[0];
+  double tileHeight = coords[3] - coords[1];
+  if ( tileWidth <= 0 || tileHeight <= 0 )
+  {
+    return 0;
+  }
+
+  double column = ( coords[0] - originA ) / tileWidth;
+  double row = ( coords[1] - originB ) / tileHeight;
+  double tileColumn = floor( column + 0.5 );
+  double tileRow = floor( row + 0.5 );
+  if ( qAbs( column - tileColumn ) > 0.001 || qAbs( row - tileRow ) > 0.001 )
+  {
+    return 0; //not aligned to the tile grid
+  }
+
+  //all the parameters except the position identify the tile set (layers, styles, crs, size, format, filters, ...)
+  QString requestKey = QgsWMSTileCache::requestKey( mParameterMap );
+  requestKey += QString::number( tileWidth, 'g', 10 ) + "," + QString::number( tileHeight, 'g', 10 );
+
+  QImage tile;
+  QDateTime dataTimestamp = QgsMSLayerCache::instance()->projectDataTimestamp( mConfigFilePath );
+  if ( tileCache->tile( mConfigFilePath, tileKey( requestKey, dataTimestamp, tileColumn, tileRow ), tile ) )
+  {
+    QgsDebugMsg( "Tile found in cache" );
+    return new QImage( tile );
+  }
+
+  //render the metatile containing the requested tile
+  double metaColumn = floor( tileColumn / metaTileSize ) * metaTileSize;
+  double metaRow = floor( tileRow / metaTileSize ) * metaTileSize;
+  double metaMinA = originA + metaColumn * tileWidth;
+  double metaMinB = originB + metaRow * tileHeight;
+
+  QMap<QString, QString> tileParameters = mParameterMap;
+  mParameterMap.insert( "WIDTH", QString::number( metaTileSize * tileSize ) );
+  mParameterMap.insert( "HEIGHT", QString::number( metaTileSize * tileSize ) );
+  mParameterMap.insert( "BBOX", QString( "%1,%2,%3,%4" )
+                        .arg( metaMinA, 0, 'g', 17 ).arg( metaMinB, 0, 'g', 17 )
+                        .arg( metaMinA + metaTileSize * tileWidth, 0, 'g', 17 ).arg( metaMinB + metaTileSize * tileHeight, 0, 'g', 17 ) );
+  if ( !checkMaximumWidthHeight() )
+  {
+    //render the tile alone
+    mParameterMap = tileParameters;
+    return 0;
+  }
+
+  QImage* metaTile = 0;
+  try
+  {
+    metaTile = renderMap( true );
+  }
+  catch ( QgsMapServiceException& )
+  {
+    mParameterMap = tileParameters;
+    throw;
+  }
+  mParameterMap = tileParameters;
+
+  if ( !metaTile )
+  {
+    return 0;
+  }
+
+  QgsDebugMsg( QString( "Slicing metatile %1/%2" ).arg( metaColumn ).arg( metaRow ) );
+  //the layers of the project are in the layer cache now, so the key includes the time of their data files
+  dataTimestamp = QgsMSLayerCache::instance()->projectDataTimestamp( mConfigFilePath );
+  for ( int i = 0; i < metaTileSize; ++i )
+  {
+    for ( int j = 0; j < metaTileSize; ++j )
+    {
+      //i runs along the first BBOX axis, j along the second one. Image rows go from north to south
+      int x = inverted ? j * tileSize : i * tileSize;
+      int y = inverted ? ( metaTileSize - 1 - i ) * tileSize : ( metaTileSize - 1 - j ) * tileSize;
+      QImage metaTilePart = metaTile->copy( x, y, tileSize, tileSize );
+      tileCache->insertTile( mConfigFilePath, tileKey( requestKey, dataTimestamp, metaColumn + i, metaRow + j ), metaTilePart );
+      if ( metaColumn + i == tileColumn && metaRow + j == tileRow )
+      {
+        tile = metaTilePart;
+      }
+    }
+  }
+  delete metaTile;
+
+  return new QImage( tile );
+}
+
 int QgsWMSServer::getFeatureInfo( QDomDocument& result, QString version )
 {
   if ( !mMapRenderer || !mConfigParser )
@@ -890,7 +1045,7 @@ int QgsWMSServer::getFeatureInfo( QDomDocument& result, QString version )
 
   //get the layer registered in QgsMapLayerRegistry and apply possible filters
   QStringList layerIds = layerSet( layersList, stylesList, mMapRenderer->destinationCrs() );
-  QMap<QString, QString> originalLayerFilters = applyRequestedLayerFilters( layersList );
+  setRequestedLayerFilters( layersList, *mMapRenderer->rendererContext() );
 
   QDomElement getFeatureInfoElement;
   QString infoFormat = mParameterMap.value( "INFO_FORMAT" );
@@ -940,6 +1095,7 @@ int QgsWMSServer::getFeatureInfo( QDomDocument& result, QString version )
     renderContext.setRendererScale( mMapRenderer->scale() );
     renderContext.setScaleFactor( mMapRenderer->outputDpi() / 25.4 );
     renderContext.setPainter( 0 );
+    renderContext.setLayerOverrides( mMapRenderer->rendererContext()->layerOverrides() );
   }
 
   bool sia2045 = mConfigParser->featureInfoFormatSIA2045();
@@ -1066,7 +1222,7 @@ int QgsWMSServer::getFeatureInfo( QDomDocument& result, QString version )
     convertFeatureInfoToSIA2045( result );
   }
 
-  restoreLayerFilters( originalLayerFilters );
+  mMapRenderer->rendererContext()->clearLayerOverrides();
   QgsMapLayerRegistry::instance()->removeAllMapLayers();
   delete featuresRect;
   delete infoPoint;
@@ -1219,6 +1375,7 @@ int QgsWMSServer::configureMapRender( const QPaintDevice* paintDevice ) const
   }
 
   mMapRenderer->clearLayerCoordinateTransforms();
+  mMapRenderer->rendererContext()->clearLayerOverrides();
   mMapRenderer->setOutputSize( QSize( paintDevice->width(), paintDevice->height() ), paintDevice->logicalDpiX() );
 
   //map extent
@@ -1465,10 +1622,26 @@ int QgsWMSServer::featureInfoFromVectorLayer( QgsVectorLayer* layer,
   {
     fReq.setFilterRect( searchRect );
   }
-  QgsFeatureIterator fit = layer->getFeatures( fReq );
 
+  //filter of the request (see setRequestedLayerFilters). It is passed to the provider
+  //like the subset string, only providers without subset strings evaluate it here
+  QString filterString = renderContext.layerOverride( layer->id() ).filterExpression;
+  bool localFilter = !filterString.isEmpty() && !layer->dataProvider()->supportsSubsetString();
+  if ( !localFilter )
+  {
+    fReq.setFilterNativeExpression( filterString );
+  }
+  QgsExpression filterExpression( localFilter ? filterString : QString() );
+  filterExpression.prepare( fields );
+
+  QgsFeatureIterator fit = layer->getFeatures( fReq );
   while ( fit.nextFeature( feature ) )
   {
+    if ( localFilter && !filterExpression.evaluate( &feature ).toBool() )
+    {
+      continue;
+    }
+
     ++featureCounter;
     if ( featureCounter > nFeatures )
     {
@@ -1871,18 +2044,18 @@ void QgsWMSServer::drawRasterSymbol( QgsComposerLegendItem* item, QPainter* p, d
   p->drawRect( QRectF( boxSpace, currentY + yDownShift, symbolWidth, symbolHeight ) );
 }
 
-QMap<QString, QString> QgsWMSServer::applyRequestedLayerFilters( const QStringList& layerList ) const
+void QgsWMSServer::setRequestedLayerFilters( const QStringList& layerList, QgsRenderContext& context ) const
 {
-  QMap<QString, QString> filterMap;
-
   if ( layerList.isEmpty() )
   {
-    return filterMap;
+    return;
   }
 
   QString filterParameter = mParameterMap.value( "FILTER" );
   if ( !filterParameter.isEmpty() )
   {
+    QStringList filteredLayerIds;
+
     QStringList layerSplit = filterParameter.split( ";" );
     QStringList::const_iterator layerIt = layerSplit.constBegin();
     for ( ; layerIt != layerSplit.constEnd(); ++layerIt )
@@ -1918,61 +2091,67 @@ QMap<QString, QString> QgsWMSServer::applyRequestedLayerFilters( const QStringLi
         QgsVectorLayer* filteredLayer = dynamic_cast<QgsVectorLayer*>( filter );
         if ( filteredLayer )
         {
-          filterMap.insert( filteredLayer->id(), filteredLayer->subsetString() );
-          QString newSubsetString = eqSplit.at( 1 );
-          if ( !filteredLayer->subsetString().isEmpty() )
+          //the provider combines the filter with the subset string of the layer in its query
+          QgsRenderContext::LayerOverride layerOverride = context.layerOverride( filteredLayer->id() );
+          if ( layerOverride.filterExpression.isEmpty() )
           {
-            newSubsetString.prepend( " AND " );
-            newSubsetString.prepend( filteredLayer->subsetString() );
+            layerOverride.filterExpression = eqSplit.at( 1 );
           }
-          filteredLayer->setSubsetString( newSubsetString );
+          else
+          {
+            layerOverride.filterExpression = "(" + layerOverride.filterExpression + ") AND (" + eqSplit.at( 1 ) + ")";
+          }
+          context.setLayerOverride( filteredLayer->id(), layerOverride );
+          filteredLayerIds.append( filteredLayer->id() );
         }
       }
     }
 
-    //No BBOX parameter in request. We use the union of the filtered layer
+    //No BBOX parameter in request. We use the union of the filtered features
     //to provide the functionality of zooming to selected records via (enhanced) WMS.
     if ( mMapRenderer && mMapRenderer->extent().isEmpty() )
     {
       QgsRectangle filterExtent;
-      QMap<QString, QString>::const_iterator filterIt = filterMap.constBegin();
-      for ( ; filterIt != filterMap.constEnd(); ++filterIt )
+      foreach ( QString layerId, filteredLayerIds )
       {
-        QgsMapLayer* mapLayer = QgsMapLayerRegistry::instance()->mapLayer( filterIt.key() );
-        if ( !mapLayer )
+        QgsVectorLayer* filteredLayer = qobject_cast<QgsVectorLayer*>( QgsMapLayerRegistry::instance()->mapLayer( layerId ) );
+        if ( !filteredLayer )
         {
           continue;
         }
 
-        QgsRectangle layerExtent = mapLayer->extent();
-        if ( filterExtent.isEmpty() )
+        QString filterString = context.layerOverride( layerId ).filterExpression;
+        QgsFeatureRequest request;
+        if ( filteredLayer->dataProvider()->supportsSubsetString() )
         {
-          filterExtent = layerExtent;
+          request.setFilterNativeExpression( filterString );
         }
         else
         {
-          filterExtent.combineExtentWith( &layerExtent );
+          request.setFilterExpression( filterString );
         }
-      }
-      mMapRenderer->setExtent( filterExtent );
-    }
-  }
-  return filterMap;
-}
 
-void QgsWMSServer::restoreLayerFilters( const QMap < QString, QString >& filterMap ) const
-{
-  QMap < QString, QString >::const_iterator filterIt = filterMap.constBegin();
-  for ( ; filterIt != filterMap.constEnd(); ++filterIt )
-  {
-    QgsVectorLayer* filteredLayer = dynamic_cast<QgsVectorLayer*>( QgsMapLayerRegistry::instance()->mapLayer( filterIt.key() ) );
-    if ( filteredLayer )
-    {
-      QgsVectorDataProvider* dp = filteredLayer->dataProvider();
-      if ( dp )
-      {
-        dp->setSubsetString( filterIt.value() );
+        QgsFeature feature;
+        QgsFeatureIterator fit = filteredLayer->getFeatures( request );
+        while ( fit.nextFeature( feature ) )
+        {
+          if ( !feature.geometry() )
+          {
+            continue;
+          }
+
+          QgsRectangle featureExtent = feature.geometry()->boundingBox();
+          if ( filterExtent.isEmpty() )
+          {
+            filterExtent = featureExtent;
+          }
+          else
+          {
+            filterExtent.combineExtentWith( &featureExtent );
+          }
+        }
       }
+      mMapRenderer->setExtent( filterExtent );
     }
   }
 }
@@ -2102,18 +2281,17 @@ void QgsWMSServer::groupStringList( QStringList& list, const QString& groupStrin
   }
 }
 
-QStringList QgsWMSServer::applyFeatureSelections( const QStringList& layerList ) const
+void QgsWMSServer::setFeatureSelections( const QStringList& layerList, QgsRenderContext& context ) const
 {
-  QStringList layersWithSelections;
   if ( layerList.isEmpty() )
   {
-    return layersWithSelections;
+    return;
   }
 
   QString selectionString = mParameterMap.value( "SELECTION" );
   if ( selectionString.isEmpty() )
   {
-    return layersWithSelections;
+    return;
   }
 
   foreach ( QString selectionLayer, selectionString.split( ";" ) )
@@ -2134,7 +2312,6 @@ QStringList QgsWMSServer::applyFeatureSelections( const QStringList& layerList )
       if ( layer && layer->name() == layerName )
       {
         vLayer = qobject_cast<QgsVectorLayer*>( layer );
-        layersWithSelections.push_back( vLayer->id() );
         break;
       }
     }
@@ -2145,40 +2322,20 @@ QStringList QgsWMSServer::applyFeatureSelections( const QStringList& layerList )
     }
 
     QStringList idList = layerIdSplit.at( 1 ).split( "," );
-    QgsFeatureIds selectedIds;
+    QgsRenderContext::LayerOverride layerOverride = context.layerOverride( vLayer->id() );
+    layerOverride.overrideSelection = true;
+    layerOverride.selectedFeatureIds.clear();
 
     foreach ( QString id, idList )
     {
-      selectedIds.insert( STRING_TO_FID( id ) );
+      layerOverride.selectedFeatureIds.insert( STRING_TO_FID( id ) );
     }
 
-    vLayer->setSelectedFeatures( selectedIds );
+    context.setLayerOverride( vLayer->id(), layerOverride );
   }
-
-
-  return layersWithSelections;
-}
-
-void QgsWMSServer::clearFeatureSelections( const QStringList& layerIds ) const
-{
-  const QMap<QString, QgsMapLayer*>& layerMap = QgsMapLayerRegistry::instance()->mapLayers();
-
-  foreach ( QString id, layerIds )
-  {
-    QgsVectorLayer *layer = qobject_cast< QgsVectorLayer * >( layerMap.value( id, 0 ) );
-    if ( !layer )
-      continue;
-
-    layer->setSelectedFeatures( QgsFeatureIds() );
-  }
-
-  return;
 }
 
-void QgsWMSServer::applyOpacities( const QStringList& layerList, QList< QPair< QgsVectorLayer*, QgsFeatureRendererV2*> >& vectorRenderers,
-                                   QList< QPair< QgsRasterLayer*, QgsRasterRenderer* > >& rasterRenderers,
-                                   QList< QPair< QgsVectorLayer*, double > >& labelTransparencies,
-                                   QList< QPair< QgsVectorLayer*, double > >& labelBufferTransparencies )
+void QgsWMSServer::setOpacities( const QStringList& layerList, QgsRenderContext& context ) const
 {
   //get opacity list
   QMap<QString, QString>::const_iterator opIt = mParameterMap.find( "OPACITIES" );
@@ -2211,90 +2368,18 @@ void QgsWMSServer::applyOpacities( const QStringList& layerList, QList< QPair< Q
   QList< QPair< QgsMapLayer*, int > >::const_iterator lOpIt = layerOpacityList.constBegin();
   for ( ; lOpIt != layerOpacityList.constEnd(); ++lOpIt )
   {
-    //vector or raster?
     QgsMapLayer* ml = lOpIt->first;
     int opacity = lOpIt->second;
-    double opacityRatio = opacity / 255.0; //opacity value between 0 and 1
 
     if ( !ml || opacity == 255 )
     {
       continue;
     }
 
-    if ( ml->type() == QgsMapLayer::VectorLayer )
-    {
-      QgsVectorLayer* vl = qobject_cast<QgsVectorLayer*>( ml );
-
-      QgsFeatureRendererV2* rendererV2 = vl->rendererV2();
-      //backup old renderer
-      vectorRenderers.push_back( qMakePair( vl, rendererV2->clone() ) );
-      //modify symbols of current renderer
-      QgsSymbolV2List symbolList = rendererV2->symbols();
-      QgsSymbolV2List::iterator symbolIt = symbolList.begin();
-      for ( ; symbolIt != symbolList.end(); ++symbolIt )
-      {
-        ( *symbolIt )->setAlpha(( *symbolIt )->alpha() * opacityRatio );
-      }
-
-      //labeling
-      if ( vl->customProperty( "labeling/enabled" ).toString() == "true" )
-      {
-        double labelTransparency = vl->customProperty( "labeling/textTransp" ).toDouble();
-        labelTransparencies.push_back( qMakePair( vl, labelTransparency ) );
-        vl->setCustomProperty( "labeling/textTransp", labelTransparency + ( 100 - labelTransparency ) * ( 1.0 - opacityRatio ) );
-        double bufferTransparency = vl->customProperty( "labeling/bufferTransp" ).toDouble();
-        labelBufferTransparencies.push_back( qMakePair( vl, bufferTransparency ) );
-        vl->setCustomProperty( "labeling/bufferTransp", bufferTransparency + ( 100 - bufferTransparency )* ( 1.0 - opacityRatio ) );
-      }
-    }
-    else if ( ml->type() == QgsMapLayer::RasterLayer )
-    {
-      QgsRasterLayer* rl = qobject_cast<QgsRasterLayer*>( ml );
-      if ( rl )
-      {
-        QgsRasterRenderer* rasterRenderer = rl->renderer();
-        if ( rasterRenderer )
-        {
-          rasterRenderers.push_back( qMakePair( rl, dynamic_cast<QgsRasterRenderer*>( rasterRenderer->clone() ) ) );
-          rasterRenderer->setOpacity( rasterRenderer->opacity() * opacityRatio );
-        }
-      }
-    }
-  }
-}
-
-void QgsWMSServer::restoreOpacities( QList< QPair< QgsVectorLayer*, QgsFeatureRendererV2*> >& vectorRenderers,
-                                     QList < QPair< QgsRasterLayer*, QgsRasterRenderer* > >& rasterRenderers,
-                                     QList< QPair< QgsVectorLayer*, double > >& labelOpacities,
-                                     QList< QPair< QgsVectorLayer*, double > >& labelBufferOpacities )
-{
-  if ( vectorRenderers.isEmpty() && rasterRenderers.isEmpty() )
-  {
-    return;
-  }
-
-  QList< QPair< QgsVectorLayer*, QgsFeatureRendererV2*> >::iterator vIt = vectorRenderers.begin();
-  for ( ; vIt != vectorRenderers.end(); ++vIt )
-  {
-    ( *vIt ).first->setRendererV2(( *vIt ).second );
-  }
-
-  QList< QPair< QgsRasterLayer*, QgsRasterRenderer* > >::iterator rIt = rasterRenderers.begin();
-  for ( ; rIt != rasterRenderers.end(); ++rIt )
-  {
-    ( *rIt ).first->setRenderer(( *rIt ).second );
-  }
-
-  QList< QPair< QgsVectorLayer*, double > >::iterator loIt = labelOpacities.begin();
-  for ( ; loIt != labelOpacities.end(); ++loIt )
-  {
-    ( *loIt ).first->setCustomProperty( "labeling/textTransp", ( *loIt ).second );
-  }
-
-  QList< QPair< QgsVectorLayer*, double > >::iterator lboIt = labelBufferOpacities.begin();
-  for ( ; lboIt != labelBufferOpacities.end(); ++lboIt )
-  {
-    ( *lboIt ).first->setCustomProperty( "labeling/bufferTransp", ( *lboIt ).second );
+    //symbols, labels (vector layers) and raster renderers apply the opacity while rendering
+    QgsRenderContext::LayerOverride layerOverride = context.layerOverride( ml->id() );
+    layerOverride.opacity *= opacity / 255.0; //opacity value between 0 and 1
+    context.setLayerOverride( ml->id(), layerOverride );
   }
 }
 
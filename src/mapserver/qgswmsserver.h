@@ -30,12 +30,10 @@ class QgsComposerLegendItem;
 class QgsComposition;
 class QgsConfigParser;
 class QgsFeature;
-class QgsFeatureRendererV2;
 class QgsMapLayer;
 class QgsMapRenderer;
 class QgsPoint;
 class QgsRasterLayer;
-class QgsRasterRenderer;
 class QgsRectangle;
 class QgsRenderContext;
 class QgsVectorLayer;
@@ -86,6 +84,8 @@ class QgsWMSServer
 
     /**Sets configuration parser for administration settings. Does not take ownership*/
     void setAdminConfigParser( QgsConfigParser* parser ) { mConfigParser = parser; }
+    /**Sets the path of the configuration file (used to invalidate cached tiles if the file changes)*/
+    void setConfigFilePath( const QString& path ) { mConfigFilePath = path; }
 
   private:
     /**Don't use the default constructor*/
@@ -98,6 +98,15 @@ class QgsWMSServer
       @return image configured together with mMapRenderer (or 0 in case of error). The calling function takes ownership of the image*/
     QImage* initializeRendering( QStringList& layersList, QStringList& stylesList, QStringList& layerIdList );
 
+    /**Renders the map for the current parameters. The caller takes ownership of the image
+      @param metaTile true if the image is a metatile of the tile grid. Reprojected raster layers then keep
+      the exact source indexes of the grid (see QgsRasterProjector::setPrecomputeIndexMap)*/
+    QImage* renderMap( bool metaTile = false );
+    /**If metatiling is enabled and the request matches the tile grid (see QgsWMSTileCache), the tile is
+      taken from the cache or the surrounding metatile is rendered and sliced into the cache.
+      @return the tile (the caller takes ownership) or 0 if the request does not match the tile grid*/
+    QImage* tiledMap();
+
     /**Creates a QImage from the HEIGHT and WIDTH parameters
      @param width image width (or -1 if width should be taken from WIDTH wms parameter)
      @param height image height (or -1 if height should be taken from HEIGHT wms parameter)
@@ -174,35 +183,20 @@ class QgsWMSServer
     QImage* printCompositionToImage( QgsComposition* c ) const;
 #endif
 
-    /**Apply filter (subset) strings from the request to the layers. Example: '&FILTER=<layer1>:"AND property > 100",<layer2>:"AND bla = 'hallo!'" '
-       @return a map with the original filters ( layer id / filter string )*/
-    QMap<QString, QString> applyRequestedLayerFilters( const QStringList& layerList ) const;
-    /**Restores the original layer filters*/
-    void restoreLayerFilters( const QMap < QString, QString >& filterMap ) const;
+    /**Sets the filter strings from the request as layer overrides of the render context. Example: '&FILTER=<layer1>:"AND property > 100",<layer2>:"AND bla = 'hallo!'" '
+       The filters are evaluated as expressions while rendering, the layers are not modified*/
+    void setRequestedLayerFilters( const QStringList& layerList, QgsRenderContext& context ) const;
     /**Tests if a filter sql string is allowed (safe)
       @return true in case of success, false if string seems unsafe*/
     bool testFilterStringSafety( const QString& filter ) const;
     /**Helper function for filter safety test. Groups stringlist to merge entries starting/ending with quotes*/
     static void groupStringList( QStringList& list, const QString& groupString );
 
-    /**Select vector features with ids specified in parameter SELECTED, e.g. ...&SELECTED=layer1:1,2,9;layer2:3,5,10&...
-      @return list with layer ids where selections have been created*/
-    QStringList applyFeatureSelections( const QStringList& layerList ) const;
-    /**Clear all feature selections in the given layers*/
-    void clearFeatureSelections( const QStringList& layerIds ) const;
-
-    /**Applies opacity on layer/group level*/
-    void applyOpacities( const QStringList& layerList, QList< QPair< QgsVectorLayer*, QgsFeatureRendererV2*> >& vectorRenderers,
-                         QList< QPair< QgsRasterLayer*, QgsRasterRenderer* > >& rasterRenderers,
-                         QList< QPair< QgsVectorLayer*, double > >& labelTransparencies,
-                         QList< QPair< QgsVectorLayer*, double > >& labelBufferTransparencies
-                       );
-
-    /**Restore original opacities*/
-    void restoreOpacities( QList< QPair <QgsVectorLayer*, QgsFeatureRendererV2*> >& vectorRenderers,
-                           QList< QPair < QgsRasterLayer*, QgsRasterRenderer* > >& rasterRenderers,
-                           QList< QPair< QgsVectorLayer*, double > >& labelTransparencies,
-                           QList< QPair< QgsVectorLayer*, double > >& labelBufferTransparencies );
+    /**Sets the vector features with ids specified in parameter SELECTION as selection overrides of the render context, e.g. ...&SELECTION=layer1:1,2,9;layer2:3,5,10&...*/
+    void setFeatureSelections( const QStringList& layerList, QgsRenderContext& context ) const;
+
+    /**Sets the opacities on layer/group level as layer overrides of the render context*/
+    void setOpacities( const QStringList& layerList, QgsRenderContext& context ) const;
 
     void appendFormats( QDomDocument &doc, QDomElement &elem, const QStringList &formats );
 
@@ -223,6 +217,8 @@ class QgsWMSServer
     QMap<QString, QString> mParameterMap;
     QgsConfigParser* mConfigParser;
     QgsMapRenderer* mMapRenderer;
+    /**Path of the configuration file (empty if unknown)*/
+    QString mConfigFilePath;
 
     QDomElement createFeatureGML(
       QgsFeature* feat,
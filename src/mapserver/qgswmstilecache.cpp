@@ -0,0 +1,141 @@
+/***************************************************************************
+                              qgswmstilecache.cpp
+                              -------------------
+  begin                : January 2014
+  copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgswmstilecache.h"
+#include "qgslogger.h"
+#include <QMutexLocker>
+#include <QStringList>
+#include <QUrl>
+
+static int intFromEnvironment( const char* name, int defaultValue )
+{
+  char* env = getenv( name );
+  if ( env )
+  {
+    bool conversionOk = false;
+    int value = QString( env ).toInt( &conversionOk );
+    if ( conversionOk )
+    {
+      return value;
+    }
+  }
+  return defaultValue;
+}
+
+static QString cacheKey( const QString& configFile, const QString& key )
+{
+  return configFile + "|" + key;
+}
+
+QgsWMSTileCache* QgsWMSTileCache::instance()
+{
+  static QgsWMSTileCache mInstance;
+  return &mInstance;
+}
+
+QgsWMSTileCache::QgsWMSTileCache()
+    : mOriginX( 0 )
+    , mOriginY( 0 )
+{
+  mMetaTileSize = qMax( 0, intFromEnvironment( "WMS_METATILE_SIZE", 0 ) );
+  mTileSize = intFromEnvironment( "WMS_TILE_SIZE", 256 );
+  if ( mTileSize <= 0 )
+  {
+    mMetaTileSize = 0;
+  }
+  mTiles.setMaxCost( qMax( 1, intFromEnvironment( "WMS_TILE_CACHE_SIZE", 64 ) ) * 1024 );
+
+  char* originEnv = getenv( "WMS_TILE_ORIGIN" );
+  if ( originEnv )
+  {
+    QStringList origin = QString( originEnv ).split( "," );
+    bool xOk = false;
+    bool yOk = false;
+    double x = origin.value( 0 ).toDouble( &xOk );
+    double y = origin.value( 1 ).toDouble( &yOk );
+    if ( origin.size() == 2 && xOk && yOk )
+    {
+      mOriginX = x;
+      mOriginY = y;
+    }
+  }
+
+  QgsDebugMsg( QString( "metatile size: %1, tile size: %2" ).arg( mMetaTileSize ).arg( mTileSize ) );
+}
+
+QgsWMSTileCache::~QgsWMSTileCache()
+{
+}
+
+int QgsWMSTileCache::metaTileSize( int maxWidth, int maxHeight ) const
+{
+  int size = mMetaTileSize;
+  if ( maxWidth != -1 )
+  {
+    size = qMin( size, maxWidth / mTileSize );
+  }
+  if ( maxHeight != -1 )
+  {
+    size = qMin( size, maxHeight / mTileSize );
+  }
+  return mMetaTileSize > 0 ? qMax( size, 1 ) : 0;
+}
+
+bool QgsWMSTileCache::tile( const QString& configFile, const QString& key, QImage& image )
+{
+  QMutexLocker locker( &mMutex );
+  QImage* cachedImage = mTiles.object( cacheKey( configFile, key ) );
+  if ( !cachedImage )
+  {
+    return false;
+  }
+  image = *cachedImage;
+  return true;
+}
+
+void QgsWMSTileCache::insertTile( const QString& configFile, const QString& key, const QImage& image )
+{
+  QMutexLocker locker( &mMutex );
+  mTiles.insert( cacheKey( configFile, key ), new QImage( image ), qMax( 1, image.byteCount() / 1024 ) );
+}
+
+void QgsWMSTileCache::removeProjectTiles( const QString& configFile )
+{
+  QMutexLocker locker( &mMutex );
+  QString prefix = cacheKey( configFile, QString() );
+  foreach ( const QString& key, mTiles.keys() )
+  {
+    if ( key.startsWith( prefix ) )
+    {
+      mTiles.remove( key );
+    }
+  }
+}
+
+QString QgsWMSTileCache::requestKey( const QMap<QString, QString>& parameters )
+{
+  //the map is sorted by key. Encoding keeps '&', '=' and '|' in values from mixing up distinct requests
+  QString key;
+  QMap<QString, QString>::const_iterator paramIt = parameters.constBegin();
+  for ( ; paramIt != parameters.constEnd(); ++paramIt )
+  {
+    if ( paramIt.key() != "BBOX" )
+    {
+      key += QUrl::toPercentEncoding( paramIt.key() ) + "=" + QUrl::toPercentEncoding( paramIt.value() ) + "&";
+    }
+  }
+  return key;
+}
@@ -0,0 +1,79 @@
+/***************************************************************************
+                              qgswmstilecache.h
+                              -----------------
+  begin                : January 2014
+  copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSWMSTILECACHE_H
+#define QGSWMSTILECACHE_H
+
+#include <QCache>
+#include <QImage>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+
+/**A singleton class that caches rendered GetMap tiles for the QGIS mapserver.
+Metatiling is enabled with the environment variable WMS_METATILE_SIZE (number of tiles per metatile side).
+GetMap requests with WIDTH and HEIGHT equal to WMS_TILE_SIZE (default 256) and a BBOX aligned to the tile grid
+with origin WMS_TILE_ORIGIN (x,y, default 0,0) are rendered as metatile and sliced into tiles.
+WMS_TILE_CACHE_SIZE sets the memory used for the tiles in MiB (default 64).
+Entries of a project are removed by QgsConfigCache if the project file changes and by QgsMSLayerCache
+if the data of one of its layers changes*/
+class QgsWMSTileCache
+{
+  public:
+    static QgsWMSTileCache* instance();
+    ~QgsWMSTileCache();
+
+    /**Number of tiles per metatile side (0 if metatiling is disabled)*/
+    int metaTileSize() const { return mMetaTileSize; }
+    /**Number of tiles per metatile side for a project with maximum image width and height (-1 for no limit).
+     Smaller than metaTileSize() if the metatile would exceed the limits, at least 1 if metatiling is enabled*/
+    int metaTileSize( int maxWidth, int maxHeight ) const;
+    /**Tile width and height in pixels*/
+    int tileSize() const { return mTileSize; }
+    double originX() const { return mOriginX; }
+    double originY() const { return mOriginY; }
+
+    /**Searches for the tile with the given key
+     @return true if the tile is in the cache*/
+    bool tile( const QString& configFile, const QString& key, QImage& image );
+    /**Inserts a tile
+     @param configFile path of the project file (to invalidate entries if the file changes)
+     @param key request parameters and tile position*/
+    void insertTile( const QString& configFile, const QString& key, const QImage& image );
+    /**Removes all tiles rendered from a project*/
+    void removeProjectTiles( const QString& configFile );
+
+    /**Key of the tile set of a request: all parameters except BBOX, percent encoded*/
+    static QString requestKey( const QMap<QString, QString>& parameters );
+
+  protected:
+    /**Protected singleton constructor*/
+    QgsWMSTileCache();
+
+  private:
+    /**Tiles with project file path and key as cache key. The cost is the image size in KiB*/
+    QCache<QString, QImage> mTiles;
+
+    int mMetaTileSize;
+    int mTileSize;
+    double mOriginX;
+    double mOriginY;
+
+    /**Protects the tiles*/
+    QMutex mMutex;
+};
+
+#endif // QGSWMSTILECACHE_H
@@ -28,6 +28,7 @@
 QgsDelimitedTextFeatureIterator::QgsDelimitedTextFeatureIterator( QgsDelimitedTextProvider* p, const QgsFeatureRequest& request )
     : QgsAbstractFeatureIterator( request )
     , P( p )
+    , mNativeFilter( 0 )
 {
   P->mActiveIterators << this;
 
@@ -44,6 +45,23 @@ QgsDelimitedTextFeatureIterator::QgsDelimitedTextFeatureIterator( QgsDelimitedTe
   mTestSubset = P->mSubsetExpression;
   mTestGeometry = false;
 
+  // The filter of the request is tested like the subset string, which is an expression
+  // as well. Unlike the subset string it is not accounted for by the indexes.
+  // An invalid filter fails to evaluate, so it doesn't match any record.
+
+  if ( ! request.filterNativeExpression().isEmpty() )
+  {
+    mNativeFilter = new QgsExpression( request.filterNativeExpression() );
+    if ( ! mNativeFilter->hasParserError() )
+    {
+      mNativeFilter->prepare( P->fields() );
+    }
+    if ( mNativeFilter->hasParserError() || mNativeFilter->hasEvalError() )
+    {
+      QgsMessageLog::logMessage( QObject::tr( "Invalid filter %1 for %2" ).arg( request.filterNativeExpression() ).arg( P->mFile->fileName() ), "DelimitedText" );
+    }
+  }
+
   mMode = FileScan;
   if ( request.filterType() == QgsFeatureRequest::FilterFid )
   {
@@ -122,6 +140,7 @@ QgsDelimitedTextFeatureIterator::QgsDelimitedTextFeatureIterator( QgsDelimitedTe
          !( mRequest.flags() & QgsFeatureRequest::NoGeometry )
          || mTestGeometry
          || ( mTestSubset && P->mSubsetExpression->needsGeometry() )
+         || ( mNativeFilter && mNativeFilter->needsGeometry() )
        )
      )
   {
@@ -144,6 +163,7 @@ QgsDelimitedTextFeatureIterator::QgsDelimitedTextFeatureIterator( QgsDelimitedTe
 QgsDelimitedTextFeatureIterator::~QgsDelimitedTextFeatureIterator()
 {
   close();
+  delete mNativeFilter;
 }
 
 bool QgsDelimitedTextFeatureIterator::fetchFeature( QgsFeature& feature )
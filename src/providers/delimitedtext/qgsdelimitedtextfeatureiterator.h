@@ -20,6 +20,7 @@
 #include "qgsfeature.h"
 
 class QgsDelimitedTextProvider;
+class QgsExpression;
 
 class QgsDelimitedTextFeatureIterator : public QgsAbstractFeatureIterator
 {
@@ -44,8 +45,10 @@ class QgsDelimitedTextFeatureIterator : public QgsAbstractFeatureIterator
     bool testSubset() const { return mTestSubset; }
     bool testGeometry() const { return mTestGeometry; }
     bool loadGeometry() const { return mLoadGeometry; }
-    bool loadSubsetOfAttributes() const { return ! mTestSubset && mRequest.flags() & QgsFeatureRequest::SubsetOfAttributes;}
+    bool loadSubsetOfAttributes() const { return ! mTestSubset && ! mNativeFilter && mRequest.flags() & QgsFeatureRequest::SubsetOfAttributes;}
     bool scanningFile() const { return mMode == FileScan; }
+    // Filter of the request, in the syntax of the subset string (0 if there is none)
+    QgsExpression *nativeFilter() const { return mNativeFilter; }
 
     // Pass through attribute subset
     const QgsAttributeList &subsetOfAttributes() const { return mRequest.subsetOfAttributes(); }
@@ -66,6 +69,7 @@ class QgsDelimitedTextFeatureIterator : public QgsAbstractFeatureIterator
     bool mTestGeometry;
     bool mTestGeometryExact;
     bool mLoadGeometry;
+    QgsExpression *mNativeFilter;
 };
 
 
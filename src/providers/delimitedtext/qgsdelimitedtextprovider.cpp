@@ -18,6 +18,9 @@
 #include "qgsdelimitedtextprovider.h"
 
 #include <QtGlobal>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
 #include <QFile>
 #include <QFileInfo>
 #include <QDataStream>
@@ -53,6 +56,11 @@ static const QString TEXT_PROVIDER_DESCRIPTION = "Delimited text data provider";
 
 static const int SUBSET_ID_THRESHOLD_FACTOR = 10;
 
+// Spatial indexes of files with at least this number of features are saved next to
+// the file, so that they need not be rebuilt when the file is opened again.
+
+static const long SPATIAL_INDEX_FILE_MIN_FEATURES = 50000;
+
 QRegExp QgsDelimitedTextProvider::WktPrefixRegexp( "^\\s*(?:\\d+\\s+|SRID\\=\\d+\\;)", Qt::CaseInsensitive );
 QRegExp QgsDelimitedTextProvider::WktZMRegexp( "\\s*(?:z|m|zm)(?=\\s*\\()", Qt::CaseInsensitive );
 QRegExp QgsDelimitedTextProvider::WktCrdRegexp( "(\\-?\\d+(?:\\.\\d*)?\\s+\\-?\\d+(?:\\.\\d*)?)\\s[\\s\\d\\.\\-]+" );
@@ -285,7 +293,6 @@ void QgsDelimitedTextProvider::resetIndexes()
   mSubsetIndex.clear();
   if ( mSpatialIndex ) delete mSpatialIndex;
   mSpatialIndex = 0;
-  if ( mBuildSpatialIndex && mGeomRep != GeomNone ) mSpatialIndex = new QgsSpatialIndex();
 }
 
 bool QgsDelimitedTextProvider::createSpatialIndex()
@@ -327,7 +334,7 @@ void QgsDelimitedTextProvider::scanFile( bool buildIndexes )
   // Initiallize indexes
 
   resetIndexes();
-  bool buildSpatialIndex = buildIndexes && mSpatialIndex != 0;
+  bool buildSpatialIndex = buildIndexes && mBuildSpatialIndex && mGeomRep != GeomNone;
 
   // No point building a subset index if there is no geometry, as all
   // records will be included.
@@ -459,16 +466,6 @@ void QgsDelimitedTextProvider::scanFile( bool buildIndexes )
                 QgsRectangle bbox( geom->boundingBox() );
                 mExtent.combineExtentWith( &bbox );
               }
-              if ( buildSpatialIndex )
-              {
-                QgsFeature f;
-                f.setFeatureId( mFile->recordId() );
-                f.setGeometry( geom );
-                mSpatialIndex->insertFeature( f );
-                // Feature now has ownership of geometry, so set to null
-                // here to avoid deleting twice.
-                geom = 0;
-              }
             }
             else
             {
@@ -517,13 +514,6 @@ void QgsDelimitedTextProvider::scanFile( bool buildIndexes )
             mGeometryType = QGis::Point;
           }
           mNumberFeatures++;
-          if ( buildSpatialIndex )
-          {
-            QgsFeature f;
-            f.setFeatureId( mFile->recordId() );
-            f.setGeometry( QgsGeometry::fromPoint( pt ) );
-            mSpatialIndex->insertFeature( f );
-          }
         }
         else
         {
@@ -661,11 +651,14 @@ void QgsDelimitedTextProvider::scanFile( bool buildIndexes )
     if ( ! mUseSubsetIndex ) mSubsetIndex = QList<quintptr>();
   }
 
-  mUseSpatialIndex = buildSpatialIndex;
-
   mValid = mGeometryType != QGis::UnknownGeometry;
   mLayerValid = mValid;
 
+  // The spatial index is bulk loaded once the layer is valid, as it is built from
+  // the features of the layer
+
+  if ( buildSpatialIndex && mValid ) loadSpatialIndex( true );
+
   // If it is valid, then watch for changes to the file
   connect( mFile, SIGNAL( fileUpdated() ), this, SLOT( onFileUpdated() ) );
 
@@ -680,7 +673,7 @@ void QgsDelimitedTextProvider::rescanFile()
   mRescanRequired = false;
   resetIndexes();
 
-  bool buildSpatialIndex = mSpatialIndex != 0;
+  bool buildSpatialIndex = mBuildSpatialIndex && mGeomRep != GeomNone;
   bool buildSubsetIndex = mBuildSubsetIndex && ( mSubsetExpression || mGeomRep != GeomNone );
 
   // In case file has been rewritten check that it is still valid
@@ -751,7 +744,6 @@ void QgsDelimitedTextProvider::rescanFile()
         QgsRectangle bbox( f.geometry()->boundingBox() );
         mExtent.combineExtentWith( &bbox );
       }
-      if ( buildSpatialIndex ) mSpatialIndex->insertFeature( f );
     }
     if ( buildSubsetIndex ) mSubsetIndex.append(( quintptr ) f.id() );
     mNumberFeatures++;
@@ -764,7 +756,65 @@ void QgsDelimitedTextProvider::rescanFile()
     if ( ! mUseSubsetIndex ) mSubsetIndex.clear();
   }
 
-  mUseSpatialIndex = buildSpatialIndex;
+  // Only the index of the whole file is saved, an index of a subset is rebuilt
+  // whenever the subset changes.
+
+  if ( buildSpatialIndex ) loadSpatialIndex( ! mSubsetExpression );
+}
+
+// Load the spatial index, either from the index file saved in the spatial index cache
+// directory or by bulk loading it with the features of the layer.  The index file is only
+// used for large files and if it is more recent than the data file, otherwise it is rewritten.
+
+void QgsDelimitedTextProvider::loadSpatialIndex( bool useIndexFile )
+{
+  mUseSpatialIndex = false;
+  delete mSpatialIndex;
+  mSpatialIndex = 0;
+
+  useIndexFile = useIndexFile && mNumberFeatures >= SPATIAL_INDEX_FILE_MIN_FEATURES;
+  QString indexFile = spatialIndexFileName();
+  if ( useIndexFile )
+  {
+    QFileInfo dataInfo( mFile->fileName() );
+    QFileInfo indexInfo( indexFile + ".dat" );
+    if ( indexInfo.exists() && indexInfo.lastModified() > dataInfo.lastModified() )
+    {
+      mSpatialIndex = QgsSpatialIndex::load( indexFile );
+      QgsDebugMsg( QString( "DelimitedText: Spatial index %1 %2" ).arg( indexFile ).arg( mSpatialIndex ? "loaded" : "could not be loaded" ) );
+    }
+  }
+
+  if ( ! mSpatialIndex )
+  {
+    mSpatialIndex = new QgsSpatialIndex( getFeatures( QgsFeatureRequest().setSubsetOfAttributes( QgsAttributeList() ) ) );
+    // Not being able to write the index file is not an error
+    if ( useIndexFile && ( ! QDir().mkpath( QFileInfo( indexFile ).absolutePath() ) || ! mSpatialIndex->save( indexFile ) ) )
+    {
+      QgsDebugMsg( QString( "DelimitedText: Could not save spatial index to %1" ).arg( indexFile ) );
+    }
+  }
+
+  mUseSpatialIndex = true;
+}
+
+// Base name of the spatial index file in the spatial index cache directory of the user
+// settings, so that nothing is written next to the data.  It is a hash of the absolute
+// path and the modification time of the data file and of the layer definition, as the
+// definition decides which records are features and how their geometries are read.
+
+QString QgsDelimitedTextProvider::spatialIndexFileName() const
+{
+  QUrl url = QUrl::fromEncoded( dataSourceUri().toAscii() );
+  url.removeAllQueryItems( "subset" );
+  url.removeAllQueryItems( "spatialIndex" );
+
+  QFileInfo dataInfo( mFile->fileName() );
+  QCryptographicHash hash( QCryptographicHash::Md5 );
+  hash.addData( dataInfo.absoluteFilePath().toUtf8() );
+  hash.addData( QByteArray::number( dataInfo.lastModified().toTime_t() ) );
+  hash.addData( url.toEncoded() );
+  return QString( "%1spatialindex/%2.qsi" ).arg( QgsApplication::qgisSettingsDirPath() ).arg( QString( hash.result().toHex() ) );
 }
 
 QgsGeometry *QgsDelimitedTextProvider::geomFromWkt( QString &sWkt )
@@ -1164,6 +1214,13 @@ bool QgsDelimitedTextProvider::nextFeature( QgsFeature& feature, QgsDelimitedTex
       if ( ! isOk.toBool() ) continue;
     }
 
+    if ( iterator->nativeFilter() )
+    {
+      QVariant isOk = iterator->nativeFilter()->evaluate( &feature );
+      if ( iterator->nativeFilter()->hasEvalError() ) continue;
+      if ( ! isOk.toBool() ) continue;
+    }
+
     // We have a good record, so return
     return true;
 
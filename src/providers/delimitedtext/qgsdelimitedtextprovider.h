@@ -222,6 +222,8 @@ class QgsDelimitedTextProvider : public QgsVectorDataProvider
     void rescanFile();
     void resetCachedSubset();
     void resetIndexes();
+    void loadSpatialIndex( bool useIndexFile );
+    QString spatialIndexFileName() const;
     void clearInvalidLines();
     void recordInvalidLine( QString message );
     void reportErrors( QStringList messages = QStringList(), bool showDialog = true );
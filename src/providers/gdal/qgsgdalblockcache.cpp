@@ -0,0 +1,86 @@
+/***************************************************************************
+      qgsgdalblockcache.cpp  -  Cache of decoded GDAL raster blocks
+                             -------------------
+    begin                : January 2014
+    copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgsgdalblockcache.h"
+#include "qgslogger.h"
+#include <QMutexLocker>
+#include <QSettings>
+
+QgsGdalBlockCache* QgsGdalBlockCache::instance()
+{
+  static QgsGdalBlockCache mInstance;
+  return &mInstance;
+}
+
+QgsGdalBlockCache::QgsGdalBlockCache()
+    : mHits( 0 )
+    , mMisses( 0 )
+{
+  QSettings settings;
+  int cacheSize = qMax( 1, settings.value( "/Raster/blockCacheSize", 64 ).toInt() );
+  mBlocks.setMaxCost( cacheSize * 1024 );
+  QgsDebugMsg( QString( "block cache size: %1 MiB" ).arg( cacheSize ) );
+}
+
+QgsGdalBlockCache::~QgsGdalBlockCache()
+{
+}
+
+bool QgsGdalBlockCache::block( const QString& datasetKey, int band, int overview, int xBlock, int yBlock, QByteArray& data )
+{
+  QMutexLocker locker( &mMutex );
+  QByteArray* cachedData = mBlocks.object( blockKey( datasetKey, band, overview, xBlock, yBlock ) );
+  if ( !cachedData )
+  {
+    ++mMisses;
+    return false;
+  }
+  ++mHits;
+  data = *cachedData;
+  return true;
+}
+
+void QgsGdalBlockCache::insertBlock( const QString& datasetKey, int band, int overview, int xBlock, int yBlock, const QByteArray& data )
+{
+  QMutexLocker locker( &mMutex );
+  mBlocks.insert( blockKey( datasetKey, band, overview, xBlock, yBlock ), new QByteArray( data ), qMax( 1, data.size() / 1024 ) );
+}
+
+void QgsGdalBlockCache::removeDataSource( const QString& dataSource )
+{
+  QMutexLocker locker( &mMutex );
+  // the dataset keys start with the data source
+  QString prefix = dataSource + "|";
+  foreach ( const QString& key, mBlocks.keys() )
+  {
+    if ( key.startsWith( prefix ) )
+    {
+      mBlocks.remove( key );
+    }
+  }
+}
+
+void QgsGdalBlockCache::statistics( int& hits, int& misses )
+{
+  QMutexLocker locker( &mMutex );
+  hits = mHits;
+  misses = mMisses;
+}
+
+QString QgsGdalBlockCache::blockKey( const QString& datasetKey, int band, int overview, int xBlock, int yBlock )
+{
+  return QString( "%1|%2|%3|%4|%5" ).arg( datasetKey ).arg( band ).arg( overview ).arg( xBlock ).arg( yBlock );
+}
@@ -0,0 +1,68 @@
+/***************************************************************************
+      qgsgdalblockcache.h  -  Cache of decoded GDAL raster blocks
+                             -------------------
+    begin                : January 2014
+    copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSGDALBLOCKCACHE_H
+#define QGSGDALBLOCKCACHE_H
+
+#include <QByteArray>
+#include <QCache>
+#include <QMutex>
+#include <QString>
+
+/**A singleton cache of decoded raster blocks, shared by all GDAL provider instances (also by the clones
+  used in other threads). The blocks are aligned to the native blocks of a band or overview and contain
+  the data type read by the provider. The least recently used blocks are removed if the memory limit
+  (setting /Raster/blockCacheSize in MiB, default 64) is reached*/
+class QgsGdalBlockCache
+{
+  public:
+    static QgsGdalBlockCache* instance();
+    ~QgsGdalBlockCache();
+
+    /**Searches for a block
+      @param datasetKey key of the dataset (data source, modification time and size separated by "|")
+      @param band band number
+      @param overview overview index (-1 for full resolution)
+      @param xBlock block column
+      @param yBlock block row
+      @param data out: the block data (implicitly shared)
+      @return true if the block is in the cache*/
+    bool block( const QString& datasetKey, int band, int overview, int xBlock, int yBlock, QByteArray& data );
+    void insertBlock( const QString& datasetKey, int band, int overview, int xBlock, int yBlock, const QByteArray& data );
+    /**Removes the blocks of all datasets of a data source, whatever modification time they
+      were read with (e.g. after writing or building pyramids)*/
+    void removeDataSource( const QString& dataSource );
+    /**Number of block searches which found the block and which didn't since the cache was created*/
+    void statistics( int& hits, int& misses );
+
+  protected:
+    /**Protected singleton constructor*/
+    QgsGdalBlockCache();
+
+  private:
+    static QString blockKey( const QString& datasetKey, int band, int overview, int xBlock, int yBlock );
+
+    /**Blocks with cost in KiB*/
+    QCache<QString, QByteArray> mBlocks;
+
+    int mHits;
+    int mMisses;
+
+    /**Protects the blocks and the statistics*/
+    QMutex mMutex;
+};
+
+#endif // QGSGDALBLOCKCACHE_H
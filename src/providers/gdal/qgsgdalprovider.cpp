@@ -19,6 +19,7 @@
 #include "qgslogger.h"
 #include "qgsgdalproviderbase.h"
 #include "qgsgdalprovider.h"
+#include "qgsgdalblockcache.h"
 #include "qgsconfig.h"
 
 #include "qgsapplication.h"
@@ -59,6 +60,9 @@
 static QString PROVIDER_KEY = "gdal";
 static QString PROVIDER_DESCRIPTION = "GDAL provider";
 
+// largest strip of whole rows kept in the block cache
+static const int MAX_CACHED_STRIP_PIXELS = 256 * 256;
+
 struct QgsGdalProgress
 {
   int type;
@@ -150,6 +154,17 @@ QgsGdalProvider::QgsGdalProvider( const QString &uri, bool update )
 
   QgsDebugMsg( "GdalDataset opened" );
   initBaseDataset();
+
+  // blocks are shared with other instances of the same file (e.g. clones for rendering threads)
+  if ( mValid && !mUpdate )
+  {
+    QFileInfo fileInfo( dataSourceUri() );
+    mBlockCacheKey = dataSourceUri();
+    if ( fileInfo.exists() )
+    {
+      mBlockCacheKey += "|" + fileInfo.lastModified().toString( Qt::ISODate ) + "|" + QString::number( fileInfo.size() );
+    }
+  }
 }
 
 QgsRasterInterface * QgsGdalProvider::clone() const
@@ -527,6 +542,32 @@ void QgsGdalProvider::readBlock( int theBandNo, QgsRectangle  const & theExtent,
   // Because of problems mentioned above we read to another temporary block and do i
   // another resampling here which appeares to be quite fast
 
+  // Read from the coarsest overview which is still at least as fine as the requested resolution,
+  // the src grid below is the grid of that overview
+  GDALRasterBandH gdalBand = GDALGetRasterBand( mGdalDataset, theBandNo );
+  int overview = -1; // full resolution
+  int levelXSize = xSize();
+  int levelYSize = ySize();
+  for ( int i = 0; i < GDALGetOverviewCount( gdalBand ); i++ )
+  {
+    GDALRasterBandH overviewBand = GDALGetOverview( gdalBand, i );
+    int overviewXSize = overviewBand ? GDALGetRasterBandXSize( overviewBand ) : 0;
+    int overviewYSize = overviewBand ? GDALGetRasterBandYSize( overviewBand ) : 0;
+    if ( overviewXSize > 0 && overviewYSize > 0 && overviewXSize < levelXSize
+         && srcXRes * xSize() / overviewXSize <= xRes && fabs( srcYRes ) * ySize() / overviewYSize <= yRes )
+    {
+      overview = i;
+      levelXSize = overviewXSize;
+      levelYSize = overviewYSize;
+    }
+  }
+  GDALRasterBandH levelBand = overview < 0 ? gdalBand : GDALGetOverview( gdalBand, overview );
+  srcXRes = srcXRes * xSize() / levelXSize;
+  srcYRes = srcYRes * ySize() / levelYSize;
+  srcBottom = levelYSize - 1;
+  srcRight = levelXSize - 1;
+  QgsDebugMsg( QString( "overview = %1 srcXRes = %2 srcYRes = %3" ).arg( overview ).arg( srcXRes ).arg( srcYRes ) );
+
   // Get necessary src extent aligned to src resolution
   if ( mExtent.xMinimum() < myRasterExtent.xMinimum() )
   {
@@ -534,7 +575,7 @@ void QgsGdalProvider::readBlock( int theBandNo, QgsRectangle  const & theExtent,
   }
   if ( mExtent.xMaximum() > myRasterExtent.xMaximum() )
   {
-    srcRight = static_cast<int>( floor(( myRasterExtent.xMaximum() - mExtent.xMinimum() ) / srcXRes ) );
+    srcRight = qMin( levelXSize - 1, static_cast<int>( floor(( myRasterExtent.xMaximum() - mExtent.xMinimum() ) / srcXRes ) ) );
   }
 
   // GDAL states that mGeoTransform[3] is top, may it also be bottom and mGeoTransform[5] positive?
@@ -544,7 +585,7 @@ void QgsGdalProvider::readBlock( int theBandNo, QgsRectangle  const & theExtent,
   }
   if ( mExtent.yMinimum() < myRasterExtent.yMinimum() )
   {
-    srcBottom = static_cast<int>( floor( -1. * ( mExtent.yMaximum() - myRasterExtent.yMinimum() ) / srcYRes ) );
+    srcBottom = qMin( levelYSize - 1, static_cast<int>( floor( -1. * ( mExtent.yMaximum() - myRasterExtent.yMinimum() ) / srcYRes ) ) );
   }
 
   QgsDebugMsg( QString( "srcTop = %1 srcBottom = %2 srcLeft = %3 srcRight = %4" ).arg( srcTop ).arg( srcBottom ).arg( srcLeft ).arg( srcRight ) );
@@ -557,11 +598,21 @@ void QgsGdalProvider::readBlock( int theBandNo, QgsRectangle  const & theExtent,
   int tmpWidth = srcWidth;
   int tmpHeight = srcHeight;
 
-  if ( xRes > srcXRes )
+  // Native blocks are cached if the src window is not much larger than the output (otherwise
+  // GDAL reads directly into a smaller buffer, e.g. if there are no overviews). Strips of whole rows
+  // are only cached if they are small, a window would otherwise read far more than it needs
+  int blockXSize = 0;
+  int blockYSize = 0;
+  GDALGetBlockSize( levelBand, &blockXSize, &blockYSize );
+  bool cacheableBlocks = blockXSize > 0 && blockYSize > 0
+                         && ( blockXSize < levelXSize || ( qgssize )blockXSize * blockYSize <= MAX_CACHED_STRIP_PIXELS );
+  bool useBlockCache = !mBlockCacheKey.isEmpty() && cacheableBlocks && ( qint64 )srcWidth * srcHeight <= 4 * ( qint64 )width * height;
+
+  if ( !useBlockCache && xRes > srcXRes )
   {
     tmpWidth = static_cast<int>( qRound( srcWidth * srcXRes / xRes ) ) ;
   }
-  if ( yRes > fabs( srcYRes ) )
+  if ( !useBlockCache && yRes > fabs( srcYRes ) )
   {
     tmpHeight = static_cast<int>( qRound( -1.*srcHeight * srcYRes / yRes ) ) ;
   }
@@ -577,20 +628,30 @@ void QgsGdalProvider::readBlock( int theBandNo, QgsRectangle  const & theExtent,
     QgsDebugMsg( QString( "Coudn't allocate temporary buffer of %1 bytes" ).arg( dataSize * tmpWidth * tmpHeight ) );
     return;
   }
-  GDALRasterBandH gdalBand = GDALGetRasterBand( mGdalDataset, theBandNo );
-  GDALDataType type = ( GDALDataType )mGdalDataType[theBandNo-1];
-  CPLErrorReset();
-  CPLErr err = gdalRasterIO( gdalBand, GF_Read,
-                             srcLeft, srcTop, srcWidth, srcHeight,
-                             ( void * )tmpBlock,
-                             tmpWidth, tmpHeight, type,
-                             0, 0 );
-
-  if ( err != CPLE_None )
+  if ( useBlockCache )
   {
-    QgsLogger::warning( "RasterIO error: " + QString::fromUtf8( CPLGetLastErrorMsg() ) );
-    qgsFree( tmpBlock );
-    return;
+    if ( !readCachedBlocks( theBandNo, overview, levelBand, srcLeft, srcTop, srcWidth, srcHeight, tmpBlock ) )
+    {
+      qgsFree( tmpBlock );
+      return;
+    }
+  }
+  else
+  {
+    GDALDataType type = ( GDALDataType )mGdalDataType[theBandNo-1];
+    CPLErrorReset();
+    CPLErr err = gdalRasterIO( levelBand, GF_Read,
+                               srcLeft, srcTop, srcWidth, srcHeight,
+                               ( void * )tmpBlock,
+                               tmpWidth, tmpHeight, type,
+                               0, 0 );
+
+    if ( err != CPLE_None )
+    {
+      QgsLogger::warning( "RasterIO error: " + QString::fromUtf8( CPLGetLastErrorMsg() ) );
+      qgsFree( tmpBlock );
+      return;
+    }
   }
 
   double tmpXRes = srcWidth * srcXRes / tmpWidth;
@@ -631,6 +692,62 @@ void QgsGdalProvider::readBlock( int theBandNo, QgsRectangle  const & theExtent,
   return;
 }
 
+bool QgsGdalProvider::readCachedBlocks( int theBandNo, int overview, GDALRasterBandH gdalBand, int left, int top, int width, int height, char* buffer )
+{
+  int dataSize = dataTypeSize( theBandNo );
+  GDALDataType type = ( GDALDataType )mGdalDataType[theBandNo-1];
+  int bandXSize = GDALGetRasterBandXSize( gdalBand );
+  int bandYSize = GDALGetRasterBandYSize( gdalBand );
+  int blockXSize = 0;
+  int blockYSize = 0;
+  GDALGetBlockSize( gdalBand, &blockXSize, &blockYSize );
+  if ( blockXSize < 1 || blockYSize < 1 )
+  {
+    return false;
+  }
+
+  QgsGdalBlockCache* cache = QgsGdalBlockCache::instance();
+  for ( int yBlock = top / blockYSize; yBlock <= ( top + height - 1 ) / blockYSize; yBlock++ )
+  {
+    for ( int xBlock = left / blockXSize; xBlock <= ( left + width - 1 ) / blockXSize; xBlock++ )
+    {
+      // blocks at the right and bottom edges are smaller
+      int blockLeft = xBlock * blockXSize;
+      int blockTop = yBlock * blockYSize;
+      int blockWidth = qMin( blockXSize, bandXSize - blockLeft );
+      int blockHeight = qMin( blockYSize, bandYSize - blockTop );
+
+      QByteArray data;
+      if ( !cache->block( mBlockCacheKey, theBandNo, overview, xBlock, yBlock, data ) )
+      {
+        data.resize( dataSize * blockWidth * blockHeight );
+        CPLErrorReset();
+        CPLErr err = gdalRasterIO( gdalBand, GF_Read, blockLeft, blockTop, blockWidth, blockHeight,
+                                   data.data(), blockWidth, blockHeight, type, 0, 0 );
+        if ( err != CPLE_None )
+        {
+          QgsLogger::warning( "RasterIO error: " + QString::fromUtf8( CPLGetLastErrorMsg() ) );
+          return false;
+        }
+        cache->insertBlock( mBlockCacheKey, theBandNo, overview, xBlock, yBlock, data );
+      }
+
+      // copy the part of the block inside the window
+      int xMin = qMax( left, blockLeft );
+      int xMax = qMin( left + width, blockLeft + blockWidth );
+      int yMin = qMax( top, blockTop );
+      int yMax = qMin( top + height, blockTop + blockHeight );
+      for ( int row = yMin; row < yMax; row++ )
+      {
+        memcpy( buffer + dataSize * (( qgssize )( row - top ) * width + xMin - left ),
+                data.constData() + dataSize * (( qgssize )( row - blockTop ) * blockWidth + xMin - blockLeft ),
+                dataSize * ( xMax - xMin ) );
+      }
+    }
+  }
+  return true;
+}
+
 //void * QgsGdalProvider::readBlock( int bandNo, QgsRectangle  const & extent, int width, int height )
 //{
 //  return 0;
@@ -1581,6 +1698,9 @@ QString QgsGdalProvider::buildPyramids( const QList<QgsRasterPyramid> & theRaste
     mGdalDataset = mGdalBaseDataset;
   }
 
+  // the cached blocks of the overviews are outdated, also those read by other instances of the file
+  QgsGdalBlockCache::instance()->removeDataSource( dataSourceUri() );
+
   //emit drawingProgress( 0, 0 );
   return NULL; // returning null on success
 }
@@ -2537,6 +2657,8 @@ bool QgsGdalProvider::write( void* data, int band, int width, int height, int xO
   {
     return false;
   }
+  // update mode providers do not cache, but the file may have been read by other instances before
+  QgsGdalBlockCache::instance()->removeDataSource( dataSourceUri() );
   return gdalRasterIO( rasterBand, GF_Write, xOffset, yOffset, width, height, data, width, height, GDALGetRasterDataType( rasterBand ), 0, 0 ) == CE_None;
 }
 
@@ -2772,6 +2894,14 @@ QGISEXTERN QList<QPair<QString, QString> > *pyramidResamplingMethods()
   return &methods;
 }
 
+/**
+  Returns the number of hits and misses of the block cache shared by the GDAL providers
+*/
+QGISEXTERN void blockCacheStatistics( int& hits, int& misses )
+{
+  QgsGdalBlockCache::instance()->statistics( hits, misses );
+}
+
 QGISEXTERN void cleanupProvider()
 {
   GDALDestroyDriverManager();
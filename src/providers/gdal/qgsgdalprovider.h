@@ -253,6 +253,15 @@ class QgsGdalProvider : public QgsRasterDataProvider, QgsGdalProviderBase
     /**Do some initialisation on the dataset (e.g. handling of south-up datasets)*/
     void initBaseDataset();
 
+    /**Reads a window of a band or overview through QgsGdalBlockCache
+      @param theBandNo band number
+      @param overview overview index (-1 for the full resolution band)
+      @param gdalBand the band or overview to read
+      @param left, top, width, height window in pixels of the band or overview
+      @param buffer output buffer (width * height values of the provider data type)
+      @return true in case of success*/
+    bool readCachedBlocks( int theBandNo, int overview, GDALRasterBandH gdalBand, int left, int top, int width, int height, char* buffer );
+
     /**
     * Flag indicating if the layer data source is a valid layer
     */
@@ -287,6 +296,9 @@ class QgsGdalProvider : public QgsRasterDataProvider, QgsGdalProviderBase
     /** \brief Pointer to the gdaldataset (possibly warped vrt) */
     GDALDatasetH mGdalDataset;
 
+    /** \brief Key of the dataset in QgsGdalBlockCache (empty if the blocks are not cached, e.g. in update mode) */
+    QString mBlockCacheKey;
+
     /** \brief Values for mapping pixel to world coordinates. Contents of this array are the same as the GDAL adfGeoTransform */
     double mGeoTransform[6];
 
@@ -76,6 +76,28 @@ bool QgsMemoryFeatureIterator::fetchFeature( QgsFeature& feature )
 }
 
 
+int QgsMemoryFeatureIterator::fetchFeatures( QgsFeatureList& features, int n )
+{
+  if ( mClosed )
+    return 0;
+
+  // the features of the list are assigned to - their geometries are reused
+  int count = 0;
+  if ( mUsingFeatureIdList )
+  {
+    while ( count < n && nextFeatureUsingList( features[count] ) )
+      count++;
+  }
+  else
+  {
+    while ( count < n && nextFeatureTraverseAll( features[count] ) )
+      count++;
+  }
+
+  return count;
+}
+
+
 bool QgsMemoryFeatureIterator::nextFeatureUsingList( QgsFeature& feature )
 {
   bool hasFeature = false;
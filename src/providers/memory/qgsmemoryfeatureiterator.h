@@ -40,6 +40,9 @@ class QgsMemoryFeatureIterator : public QgsAbstractFeatureIterator
     //! fetch next feature, return true on success
     virtual bool fetchFeature( QgsFeature& feature );
 
+    //! fetch a batch of features without the per feature dispatch of fetchFeature()
+    virtual int fetchFeatures( QgsFeatureList& features, int n );
+
     bool nextFeatureUsingList( QgsFeature& feature );
     bool nextFeatureTraverseAll( QgsFeature& feature );
 
@@ -409,13 +409,8 @@ bool QgsMemoryProvider::createSpatialIndex()
 {
   if ( !mSpatialIndex )
   {
-    mSpatialIndex = new QgsSpatialIndex();
-
-    // add existing features to index
-    for ( QgsFeatureMap::iterator it = mFeatures.begin(); it != mFeatures.end(); ++it )
-    {
-      mSpatialIndex->insertFeature( *it );
-    }
+    // bulk load the index with the existing features
+    mSpatialIndex = new QgsSpatialIndex( getFeatures( QgsFeatureRequest().setSubsetOfAttributes( QgsAttributeList() ) ) );
   }
   return true;
 }
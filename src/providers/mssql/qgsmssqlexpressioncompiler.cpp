@@ -0,0 +1,56 @@
+/***************************************************************************
+                         qgsmssqlexpressioncompiler.cpp  -  description
+                         -------------------
+    begin                : January 2014
+    copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgsmssqlexpressioncompiler.h"
+#include "qgsmssqlprovider.h"
+
+QgsMssqlExpressionCompiler::QgsMssqlExpressionCompiler( QgsMssqlProvider* provider )
+    : QgsSqlExpressionCompiler( compilableFields( provider->fields() ), CaseInsensitiveStringMatch | NullsSortFirst )
+{
+}
+
+QgsFields QgsMssqlExpressionCompiler::compilableFields( const QgsFields& fields )
+{
+  // real is compared with less precision, bit converts any number to 0/1,
+  // text and ntext can't be compared at all
+  QgsFields result;
+  for ( int i = 0; i < fields.count(); ++i )
+  {
+    QString type = fields[i].typeName().toLower();
+    if ( type.startsWith( "decimal" ) || type.startsWith( "numeric" ) || type.startsWith( "float" ) ||
+         type.startsWith( "tinyint" ) || type.startsWith( "smallint" ) || type.startsWith( "int" ) || type.startsWith( "bigint" ) ||
+         type.startsWith( "char" ) || type.startsWith( "nchar" ) || type.startsWith( "varchar" ) || type.startsWith( "nvarchar" ) )
+      result.append( fields[i] );
+  }
+  return result;
+}
+
+QString QgsMssqlExpressionCompiler::quotedIdentifier( const QString& identifier )
+{
+  QString id( identifier );
+  id.replace( "]", "]]" );
+  return id.prepend( "[" ).append( "]" );
+}
+
+QString QgsMssqlExpressionCompiler::quotedValue( const QVariant& value )
+{
+  if ( value.type() != QVariant::String )
+    return QgsSqlExpressionCompiler::quotedValue( value );
+
+  QString v = value.toString();
+  v.replace( "'", "''" );
+  return v.prepend( "N'" ).append( "'" );
+}
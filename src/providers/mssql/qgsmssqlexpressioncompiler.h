@@ -0,0 +1,43 @@
+/***************************************************************************
+                         qgsmssqlexpressioncompiler.h  -  description
+                         -------------------
+    begin                : January 2014
+    copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSMSSQLEXPRESSIONCOMPILER_H
+#define QGSMSSQLEXPRESSIONCOMPILER_H
+
+#include "qgssqlexpressioncompiler.h"
+
+class QgsMssqlProvider;
+
+/**
+ * Translation of feature request expressions to SQL Server WHERE clauses.
+ * String comparisons depend on the collation of the column (often case insensitive)
+ * and are therefore left for the local evaluation.
+ */
+class QgsMssqlExpressionCompiler : public QgsSqlExpressionCompiler
+{
+  public:
+    QgsMssqlExpressionCompiler( QgsMssqlProvider* provider );
+
+  protected:
+    virtual QString quotedIdentifier( const QString& identifier );
+    virtual QString quotedValue( const QVariant& value );
+
+  private:
+    //! only columns whose values compare the same way in SQL Server and in QgsExpression
+    static QgsFields compilableFields( const QgsFields& fields );
+};
+
+#endif // QGSMSSQLEXPRESSIONCOMPILER_H
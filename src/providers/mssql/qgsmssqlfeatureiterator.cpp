@@ -16,6 +16,7 @@
  ***************************************************************************/
 
 #include "qgsmssqlfeatureiterator.h"
+#include "qgsmssqlexpressioncompiler.h"
 #include "qgsmssqlprovider.h"
 #include "qgslogger.h"
 
@@ -24,7 +25,7 @@
 
 
 QgsMssqlFeatureIterator::QgsMssqlFeatureIterator( QgsMssqlProvider* provider, const QgsFeatureRequest& request )
-    : QgsAbstractFeatureIterator( request ), mProvider( provider )
+    : QgsAbstractFeatureIterator( request ), mProvider( provider ), mExpressionCompiled( false )
 {
   mIsOpen = false;
   BuildStatement( request );
@@ -175,12 +176,56 @@ void QgsMssqlFeatureIterator::BuildStatement( const QgsFeatureRequest& request )
       mStatement += " where (" + mProvider->mSqlWhereClause + ")";
     else
       mStatement += " and (" + mProvider->mSqlWhereClause + ")";
+    filterAdded = true;
+  }
+
+  if ( !request.filterNativeExpression().isEmpty() )
+  {
+    if ( !filterAdded )
+      mStatement += " where (" + request.filterNativeExpression() + ")";
+    else
+      mStatement += " and (" + request.filterNativeExpression() + ")";
+    filterAdded = true;
+  }
+
+  // translate the filter expression
+  mFallbackStatement.clear();
+  if ( request.filterType() == QgsFeatureRequest::FilterExpression && QgsSqlExpressionCompiler::compilationEnabled() )
+  {
+    QgsMssqlExpressionCompiler compiler( mProvider );
+    QgsSqlExpressionCompiler::Result result = compiler.compile( request.filterExpression() );
+    if ( result == QgsSqlExpressionCompiler::Complete || result == QgsSqlExpressionCompiler::Partial )
+    {
+      mFallbackStatement = mStatement;
+      mStatement += QString( filterAdded ? " and " : " where " ) + compiler.result();
+      mExpressionCompiled = result == QgsSqlExpressionCompiler::Complete;
+    }
+  }
+
+  // translate the order - the fallback statement is sorted locally
+  if ( !request.orderBy().isEmpty() && QgsSqlExpressionCompiler::compilationEnabled() )
+  {
+    QgsMssqlExpressionCompiler compiler( mProvider );
+    if ( compiler.compileOrderBy( request.orderBy() ) == QgsSqlExpressionCompiler::Complete )
+    {
+      if ( mFallbackStatement.isEmpty() )
+        mFallbackStatement = mStatement;
+      mStatement += " order by " + compiler.result();
+      mOrderByCompiled = true;
+    }
   }
 
+  // feature ids are filtered locally
+  bool localFiltering = request.filterType() == QgsFeatureRequest::FilterExpression || request.filterType() == QgsFeatureRequest::FilterFids;
+  long limit = providerLimit( localFiltering && !mExpressionCompiled );
+  if ( limit >= 0 )
+    mStatement.replace( 0, 7, QString( "select top %1 " ).arg( limit ) );
+
   if ( fieldCount == 0 )
   {
     QgsDebugMsg( "QgsMssqlProvider::select no fields have been requested" );
     mStatement.clear();
+    mFallbackStatement.clear();
   }
 }
 
@@ -231,6 +276,14 @@ bool QgsMssqlFeatureIterator::fetchFeature( QgsFeature& feature )
 }
 
 
+bool QgsMssqlFeatureIterator::nextFeatureFilterExpression( QgsFeature& f )
+{
+  if ( mExpressionCompiled )
+    return fetchFeature( f );
+
+  return QgsAbstractFeatureIterator::nextFeatureFilterExpression( f );
+}
+
 bool QgsMssqlFeatureIterator::rewind()
 {
   if ( mStatement.isEmpty() )
@@ -244,7 +297,20 @@ bool QgsMssqlFeatureIterator::rewind()
 
   mQuery->clear();
   mQuery->setForwardOnly( true );
-  if ( !mQuery->exec( mStatement ) )
+  if ( !mQuery->exec( mStatement ) && !mFallbackStatement.isEmpty() )
+  {
+    // fall back to local evaluation of the expression
+    QgsDebugMsg( "query with compiled expression failed - retrying without it: " + mQuery->lastError().text() );
+    mStatement = mFallbackStatement;
+    mFallbackStatement.clear();
+    mExpressionCompiled = false;
+    mOrderByCompiled = false;
+    mQuery->clear();
+    mQuery->setForwardOnly( true );
+    mQuery->exec( mStatement );
+  }
+
+  if ( !mQuery->isActive() )
   {
     QString msg = mQuery->lastError().text();
     QgsDebugMsg( msg );
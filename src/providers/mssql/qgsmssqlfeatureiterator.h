@@ -48,6 +48,9 @@ class QgsMssqlFeatureIterator : public QgsAbstractFeatureIterator
     //! fetch next feature, return true on success
     virtual bool fetchFeature( QgsFeature& feature );
 
+    //! skips the local evaluation if the whole expression is part of the query
+    virtual bool nextFeatureFilterExpression( QgsFeature& f );
+
     // The current database
     QSqlDatabase mDatabase;
 
@@ -60,6 +63,12 @@ class QgsMssqlFeatureIterator : public QgsAbstractFeatureIterator
     // The current sql statement
     QString mStatement;
 
+    // The sql statement without the compiled filter expression and order
+    QString mFallbackStatement;
+
+    // Set to true, if the filter expression was completely translated to SQL
+    bool mExpressionCompiled;
+
     // Open connection flag
     bool mIsOpen;
 
@@ -25,6 +25,8 @@
 #include <QTextCodec>
 #include <QFile>
 
+#include <cpl_error.h>
+
 // using from provider:
 // - setRelevantFields(), mRelevantFieldsForNextFeature
 // - ogrLayer
@@ -59,6 +61,17 @@ QgsOgrFeatureIterator::QgsOgrFeatureIterator( QgsOgrProvider* p, const QgsFeatur
     ogrLayer = P->setSubsetString( ogrLayer, ogrDataSource );
     mSubsetStringSet = true;
   }
+  else if ( !mRequest.orderBy().isEmpty() && mRequest.filterType() != QgsFeatureRequest::FilterFid )
+  {
+    // feature ids of a sorted result set are positions in it, so the single feature is fetched unsorted
+    OGRLayerH orderedLayer = P->setOrderBy( ogrLayer, ogrDataSource, mRequest.orderBy() );
+    if ( orderedLayer )
+    {
+      ogrLayer = orderedLayer;
+      mSubsetStringSet = true;
+      mOrderByCompiled = true;
+    }
+  }
 
   ensureRelevantFields();
 
@@ -80,6 +93,19 @@ QgsOgrFeatureIterator::QgsOgrFeatureIterator( QgsOgrProvider* p, const QgsFeatur
     OGR_L_SetSpatialFilter( ogrLayer, 0 );
   }
 
+  // the layer belongs to the data source of this iterator, so the filter of the request
+  // doesn't affect other iterators. It applies on top of the subset string result set.
+  if ( !mRequest.filterNativeExpression().isEmpty() )
+  {
+    QgsDebugMsg( "Setting attribute filter using " + mRequest.filterNativeExpression() );
+    if ( OGR_L_SetAttributeFilter( ogrLayer, P->mEncoding->fromUnicode( mRequest.filterNativeExpression() ).constData() ) != OGRERR_NONE )
+    {
+      QgsMessageLog::logMessage( QObject::tr( "Attribute filter %1 is invalid (%2)" ).arg( mRequest.filterNativeExpression() ).arg( QString::fromUtf8( CPLGetLastErrorMsg() ) ), QObject::tr( "OGR" ) );
+      close();
+      return;
+    }
+  }
+
   //start with first feature
   rewind();
 }
@@ -201,6 +227,34 @@ bool QgsOgrFeatureIterator::fetchFeature( QgsFeature& feature )
   return false;
 }
 
+int QgsOgrFeatureIterator::fetchFeatures( QgsFeatureList& features, int n )
+{
+  if ( mClosed || mRequest.filterType() == QgsFeatureRequest::FilterFid )
+    return QgsAbstractFeatureIterator::fetchFeatures( features, n );
+
+  if ( !P->mRelevantFieldsForNextFeature )
+    ensureRelevantFields();
+
+  int count = 0;
+  OGRFeatureH fet;
+
+  while ( count < n && ( fet = OGR_L_GetNextFeature( ogrLayer ) ) )
+  {
+    QgsFeature& feature = features[count];
+    if ( !readFeature( fet, feature ) )
+      continue;
+
+    feature.setValid( true );
+    OGR_F_Destroy( fet );
+    count++;
+  }
+
+  if ( count < n )
+    close();
+
+  return count;
+}
+
 
 bool QgsOgrFeatureIterator::rewind()
 {
@@ -302,6 +356,11 @@ bool QgsOgrFeatureIterator::readFeature( OGRFeatureH fet, QgsFeature& feature )
       QgsGeometry* geometry = feature.geometry();
       if ( !geometry ) feature.setGeometryAndOwnership( wkb, memorySize ); else geometry->fromWkb( wkb, memorySize );
     }
+    else
+    {
+      // the feature may be reused: do not keep the previous geometry
+      feature.setGeometry( 0 );
+    }
     if (( useIntersect && ( !feature.geometry() || !feature.geometry()->intersects( mRequest.filterRect() ) ) )
         || ( geometryTypeFilter && ( !feature.geometry() || QgsOgrProvider::ogrWkbSingleFlatten(( OGRwkbGeometryType )feature.geometry()->wkbType() ) != P->mOgrGeometryTypeFilter ) ) )
     {
@@ -39,6 +39,9 @@ class QgsOgrFeatureIterator : public QgsAbstractFeatureIterator
     //! fetch next feature, return true on success
     virtual bool fetchFeature( QgsFeature& feature );
 
+    //! fetch a batch of features, without the per feature overhead of fetchFeature()
+    virtual int fetchFeatures( QgsFeatureList& features, int n );
+
     //! Setup the simplification of geometries to fetch using the specified simplify method
     virtual bool prepareSimplification( const QgsSimplifyMethod& simplifyMethod );
 
@@ -56,6 +59,7 @@ class QgsOgrFeatureIterator : public QgsAbstractFeatureIterator
     OGRDataSourceH ogrDataSource;
     OGRLayerH ogrLayer;
 
+    //! Set to true, if ogrLayer is a result set of a subset string or of a sorted query
     bool mSubsetStringSet;
 
     //! Set to true, if geometry is in the requested columns
@@ -2456,6 +2456,40 @@ OGRLayerH QgsOgrProvider::setSubsetString( OGRLayerH layer, OGRDataSourceH ds )
   return OGR_DS_ExecuteSQL( ds, sql.constData(), NULL, NULL );
 }
 
+OGRLayerH QgsOgrProvider::setOrderBy( OGRLayerH layer, OGRDataSourceH ds, const QgsFeatureRequest::OrderBy& orderBy )
+{
+  // identifiers are quoted differently for the MySQL driver
+  if ( ogrDriverName == "MySQL" )
+    return 0;
+
+  // OGR SQL sorts NULLs before any other value and compares strings bytewise,
+  // so only numeric columns with the matching position of NULLs are translated
+  QByteArray sql;
+  foreach ( const QgsFeatureRequest::OrderByClause& clause, orderBy )
+  {
+    QgsExpression exp( clause.expression() );
+    if ( exp.hasParserError() || !exp.rootNode() || exp.rootNode()->nodeType() != QgsExpression::ntColumnRef ||
+         clause.nullsFirst() != clause.ascending() )
+      return 0;
+
+    int idx = mAttributeFields.indexFromName( static_cast<const QgsExpression::NodeColumnRef*>( exp.rootNode() )->name() );
+    if ( idx < 0 || ( mAttributeFields[idx].type() != QVariant::Int && mAttributeFields[idx].type() != QVariant::Double ) )
+      return 0;
+
+    sql += sql.isEmpty() ? " ORDER BY " : ",";
+    sql += quotedIdentifier( mEncoding->fromUnicode( mAttributeFields[idx].name() ) );
+    sql += clause.ascending() ? " ASC" : " DESC";
+  }
+
+  if ( sql.isEmpty() )
+    return 0;
+
+  sql.prepend( "SELECT * FROM " + quotedIdentifier( OGR_FD_GetName( OGR_L_GetLayerDefn( layer ) ) ) );
+
+  QgsDebugMsg( QString( "SQL: %1" ).arg( mEncoding->toUnicode( sql ) ) );
+  return OGR_DS_ExecuteSQL( ds, sql.constData(), NULL, "OGRSQL" );
+}
+
 // ---------------------------------------------------------------------------
 
 QGISEXTERN QgsVectorLayerImport::ImportError createEmptyLayer(
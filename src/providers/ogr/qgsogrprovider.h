@@ -346,6 +346,10 @@ class QgsOgrProvider : public QgsVectorDataProvider
 
     OGRLayerH setSubsetString( OGRLayerH layer, OGRDataSourceH ds );
 
+    /**Returns a result set of the layer sorted with OGR SQL or 0 if the order can't be translated.
+       The result set has to be released with OGR_DS_ReleaseResultSet */
+    OGRLayerH setOrderBy( OGRLayerH layer, OGRDataSourceH ds, const QgsFeatureRequest::OrderBy& orderBy );
+
     friend class QgsOgrFeatureIterator;
     QSet< QgsOgrFeatureIterator* > mActiveIterators;
 };
@@ -0,0 +1,61 @@
+/***************************************************************************
+    qgsoracleexpressioncompiler.cpp
+    ---------------------
+    begin                : January 2014
+    copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include "qgsoracleexpressioncompiler.h"
+#include "qgsoracleconn.h"
+#include "qgsoracleprovider.h"
+
+QgsOracleExpressionCompiler::QgsOracleExpressionCompiler( QgsOracleProvider* provider )
+    : QgsSqlExpressionCompiler( compilableFields( provider->fields() ), NoEmptyStrings )
+{
+}
+
+QgsFields QgsOracleExpressionCompiler::compilableFields( const QgsFields& fields )
+{
+  // CHAR is blank-padded, BINARY_FLOAT is compared with less precision,
+  // LONG and LOBs can't be compared at all
+  QgsFields result;
+  for ( int i = 0; i < fields.count(); ++i )
+  {
+    const QString& type = fields[i].typeName();
+    if ( type.startsWith( "NUMBER" ) || type.startsWith( "VARCHAR" ) || type.startsWith( "NVARCHAR" ) ||
+         type == "FLOAT" || type == "BINARY_DOUBLE" )
+      result.append( fields[i] );
+  }
+  return result;
+}
+
+QString QgsOracleExpressionCompiler::quotedIdentifier( const QString& identifier )
+{
+  return QgsOracleConn::quotedIdentifier( identifier );
+}
+
+QString QgsOracleExpressionCompiler::sqlFunctionFromFunctionName( const QString& fnName ) const
+{
+  if ( fnName == "lower" || fnName == "upper" )
+    return fnName.toUpper();
+
+  return QString();
+}
+
+bool QgsOracleExpressionCompiler::compileLike( const QgsExpression::NodeBinaryOperator* n, const QString& left, const QString& pattern, QString& str )
+{
+  if ( n->op() == QgsExpression::boLike || n->op() == QgsExpression::boNotLike )
+    return QgsSqlExpressionCompiler::compileLike( n, left, pattern, str );
+
+  str = QString( "(UPPER(%1) %2LIKE UPPER(%3))" )
+        .arg( left )
+        .arg( n->op() == QgsExpression::boNotILike ? "NOT " : "" )
+        .arg( quotedValue( pattern ) );
+  return true;
+}
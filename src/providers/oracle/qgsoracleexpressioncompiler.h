@@ -0,0 +1,41 @@
+/***************************************************************************
+    qgsoracleexpressioncompiler.h
+    ---------------------
+    begin                : January 2014
+    copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#ifndef QGSORACLEEXPRESSIONCOMPILER_H
+#define QGSORACLEEXPRESSIONCOMPILER_H
+
+#include "qgssqlexpressioncompiler.h"
+
+class QgsOracleProvider;
+
+/**
+ * Translation of feature request expressions to Oracle WHERE clauses.
+ */
+class QgsOracleExpressionCompiler : public QgsSqlExpressionCompiler
+{
+  public:
+    QgsOracleExpressionCompiler( QgsOracleProvider* provider );
+
+  protected:
+    virtual QString quotedIdentifier( const QString& identifier );
+    virtual QString sqlFunctionFromFunctionName( const QString& fnName ) const;
+
+    //! Oracle has no ILIKE - both sides are converted to upper case
+    virtual bool compileLike( const QgsExpression::NodeBinaryOperator* n, const QString& left, const QString& pattern, QString& str );
+
+  private:
+    //! only columns whose values compare the same way in Oracle and in QgsExpression
+    static QgsFields compilableFields( const QgsFields& fields );
+};
+
+#endif // QGSORACLEEXPRESSIONCOMPILER_H
@@ -14,6 +14,7 @@
  ***************************************************************************/
 
 #include "qgsoraclefeatureiterator.h"
+#include "qgsoracleexpressioncompiler.h"
 #include "qgsoracleprovider.h"
 
 #include "qgslogger.h"
@@ -26,6 +27,7 @@ QgsOracleFeatureIterator::QgsOracleFeatureIterator( QgsOracleProvider *p, const
     : QgsAbstractFeatureIterator( request )
     , P( p )
     , mRewind( false )
+    , mExpressionCompiled( false )
 {
   P->mActiveIterators << this;
 
@@ -103,7 +105,58 @@ QgsOracleFeatureIterator::QgsOracleFeatureIterator( QgsOracleProvider *p, const
     whereClause += "(" + P->mSqlWhereClause + ")";
   }
 
-  if ( !openQuery( whereClause ) )
+  if ( !request.filterNativeExpression().isEmpty() )
+  {
+    if ( !whereClause.isEmpty() )
+      whereClause += " AND ";
+    whereClause += "(" + request.filterNativeExpression() + ")";
+  }
+
+  QString compiledWhereClause;
+  if ( request.filterType() == QgsFeatureRequest::FilterExpression && QgsSqlExpressionCompiler::compilationEnabled() )
+  {
+    QgsOracleExpressionCompiler compiler( P );
+    QgsSqlExpressionCompiler::Result result = compiler.compile( request.filterExpression() );
+    if ( result == QgsSqlExpressionCompiler::Complete || result == QgsSqlExpressionCompiler::Partial )
+    {
+      compiledWhereClause = whereClause;
+      if ( !compiledWhereClause.isEmpty() )
+        compiledWhereClause += " AND ";
+      compiledWhereClause += compiler.result();
+
+      mExpressionCompiled = result == QgsSqlExpressionCompiler::Complete;
+    }
+  }
+
+  QString orderBy;
+  if ( !request.orderBy().isEmpty() && QgsSqlExpressionCompiler::compilationEnabled() )
+  {
+    QgsOracleExpressionCompiler compiler( P );
+    if ( compiler.compileOrderBy( request.orderBy() ) == QgsSqlExpressionCompiler::Complete )
+    {
+      orderBy = compiler.result();
+      mOrderByCompiled = true;
+    }
+  }
+
+  // without spatial support the exact intersection is tested locally
+  bool localFiltering = request.filterType() == QgsFeatureRequest::FilterExpression ||
+                        ( request.filterType() == QgsFeatureRequest::FilterRect &&
+                          ( mRequest.flags() & QgsFeatureRequest::ExactIntersect ) != 0 &&
+                          !P->mConnection->hasSpatial() );
+  bool compiled = !compiledWhereClause.isEmpty() || !orderBy.isEmpty();
+
+  if ( compiled && !openQuery( compiledWhereClause.isEmpty() ? whereClause : compiledWhereClause, orderBy,
+                               providerLimit( localFiltering && !mExpressionCompiled ) ) )
+  {
+    // fall back to local evaluation of the expression and local sorting
+    QgsDebugMsg( "query with compiled expression or order failed - retrying without them" );
+    compiled = false;
+    mExpressionCompiled = false;
+    mOrderByCompiled = false;
+  }
+
+  if ( !compiled && !openQuery( whereClause, QString(), providerLimit( localFiltering ) ) )
     return;
 }
 
@@ -232,6 +285,14 @@ bool QgsOracleFeatureIterator::fetchFeature( QgsFeature& feature )
   }
 }
 
+bool QgsOracleFeatureIterator::nextFeatureFilterExpression( QgsFeature& f )
+{
+  if ( mExpressionCompiled )
+    return fetchFeature( f );
+
+  return QgsAbstractFeatureIterator::nextFeatureFilterExpression( f );
+}
+
 bool QgsOracleFeatureIterator::rewind()
 {
   if ( !mQry.isActive() )
@@ -254,7 +315,7 @@ bool QgsOracleFeatureIterator::close()
   return true;
 }
 
-bool QgsOracleFeatureIterator::openQuery( QString whereClause )
+bool QgsOracleFeatureIterator::openQuery( QString whereClause, QString orderBy, long limit )
 {
   if (( mRequest.flags() & QgsFeatureRequest::NoGeometry ) == 0 && P->mGeometryColumn.isNull() )
   {
@@ -310,6 +371,13 @@ bool QgsOracleFeatureIterator::openQuery( QString whereClause )
     if ( !whereClause.isEmpty() )
       query += QString( " WHERE %1" ).arg( whereClause );
 
+    if ( !orderBy.isEmpty() )
+      query += QString( " ORDER BY %1" ).arg( orderBy );
+
+    // no LIMIT in Oracle - ROWNUM is assigned before sorting, hence the subquery
+    if ( limit >= 0 )
+      query = QString( "SELECT * FROM (%1) WHERE rownum<=%2" ).arg( query ).arg( limit );
+
     QgsDebugMsg( QString( "Fetch features: %1" ).arg( query ) );
     if ( !P->exec( mQry, query ) )
     {
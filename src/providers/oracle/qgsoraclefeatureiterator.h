@@ -42,12 +42,16 @@ class QgsOracleFeatureIterator : public QgsAbstractFeatureIterator
     //! fetch next feature, return true on success
     virtual bool fetchFeature( QgsFeature& feature );
 
+    //! skips the local evaluation if the whole expression is part of the query
+    virtual bool nextFeatureFilterExpression( QgsFeature& f );
+
     QgsOracleProvider *P;
 
-    bool openQuery( QString whereClause );
+    bool openQuery( QString whereClause, QString orderBy = QString(), long limit = -1 );
 
     QSqlQuery mQry;
     bool mRewind;
+    bool mExpressionCompiled;
     QgsAttributeList mAttributeList;
 };
 
@@ -818,7 +818,7 @@ PGresult *QgsPostgresConn::PQexec( QString query, bool logError )
   return res;
 }
 
-bool QgsPostgresConn::openCursor( QString cursorName, QString sql )
+bool QgsPostgresConn::openCursor( QString cursorName, QString sql, bool mayFail )
 {
   if ( mOpenCursors++ == 0 )
   {
@@ -826,7 +826,34 @@ bool QgsPostgresConn::openCursor( QString cursorName, QString sql )
     PQexecNR( "BEGIN READ ONLY" );
   }
   QgsDebugMsgLevel( QString( "Binary cursor %1 for %2" ).arg( cursorName ).arg( sql ), 3 );
-  return PQexecNR( QString( "DECLARE %1 BINARY CURSOR FOR %2" ).arg( cursorName ).arg( sql ) );
+  QString declare = QString( "DECLARE %1 BINARY CURSOR FOR %2" ).arg( cursorName ).arg( sql );
+  if ( !mayFail )
+  {
+    return PQexecNR( declare );
+  }
+
+  // PQexecNR() would roll back the whole transaction on error
+  if ( !PQexecNR( "SAVEPOINT qgis_declare" ) )
+  {
+    return false;
+  }
+
+  QgsPostgresResult res = PQexec( declare, false );
+  if ( res.PQresultStatus() == PGRES_COMMAND_OK )
+  {
+    PQexecNR( "RELEASE SAVEPOINT qgis_declare" );
+    return true;
+  }
+
+  QgsDebugMsg( QString( "Declaring cursor %1 failed: %2" ).arg( cursorName ).arg( res.PQresultErrorMessage() ) );
+  PQexecNR( "ROLLBACK TO SAVEPOINT qgis_declare" );
+  PQexecNR( "RELEASE SAVEPOINT qgis_declare" );
+  if ( --mOpenCursors == 0 )
+  {
+    QgsDebugMsg( "Committing read-only transaction" );
+    PQexecNR( "COMMIT" );
+  }
+  return false;
 }
 
 bool QgsPostgresConn::closeCursor( QString cursorName )
@@ -183,8 +183,9 @@ class QgsPostgresConn : public QObject
     //! run a query and free result buffer
     bool PQexecNR( QString query, bool retry = true );
 
-    //! cursor handling
-    bool openCursor( QString cursorName, QString declare );
+    //! cursor handling. If mayFail is set, a failing declaration only rolls
+    //! back to a savepoint, the transaction of the other open cursors goes on
+    bool openCursor( QString cursorName, QString declare, bool mayFail = false );
     bool closeCursor( QString cursorName );
 
 #if 0
@@ -0,0 +1,62 @@
+/***************************************************************************
+    qgspostgresexpressioncompiler.cpp
+    ---------------------
+    begin                : January 2014
+    copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include "qgspostgresexpressioncompiler.h"
+#include "qgspostgresconn.h"
+#include "qgspostgresprovider.h"
+
+QgsPostgresExpressionCompiler::QgsPostgresExpressionCompiler( QgsPostgresProvider* provider )
+    : QgsSqlExpressionCompiler( compilableFields( provider->fields() ) )
+{
+}
+
+QgsFields QgsPostgresExpressionCompiler::compilableFields( const QgsFields& fields )
+{
+  // float4 is compared as double by QgsExpression but not by PostgreSQL, bpchar is blank-padded,
+  // other types mapped to strings (uuid, inet, ...) fail on invalid literals
+  QStringList types;
+  types << "int2" << "int4" << "oid" << "serial" << "float8" << "double precision" << "numeric" << "varchar" << "text";
+
+  QgsFields result;
+  for ( int i = 0; i < fields.count(); ++i )
+  {
+    if ( types.contains( fields[i].typeName() ) )
+      result.append( fields[i] );
+  }
+  return result;
+}
+
+QString QgsPostgresExpressionCompiler::quotedIdentifier( const QString& identifier )
+{
+  return QgsPostgresConn::quotedIdentifier( identifier );
+}
+
+QString QgsPostgresExpressionCompiler::quotedValue( const QVariant& value )
+{
+  if ( value.type() != QVariant::String )
+    return QgsSqlExpressionCompiler::quotedValue( value );
+
+  // escape string syntax is independent of standard_conforming_strings
+  QString v = value.toString();
+  v.replace( "\\", "\\\\" );
+  v.replace( "'", "''" );
+  return v.prepend( "E'" ).append( "'" );
+}
+
+QString QgsPostgresExpressionCompiler::sqlFunctionFromFunctionName( const QString& fnName ) const
+{
+  if ( fnName == "lower" || fnName == "upper" )
+    return fnName;
+
+  return QString();
+}
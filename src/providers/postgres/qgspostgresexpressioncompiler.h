@@ -0,0 +1,39 @@
+/***************************************************************************
+    qgspostgresexpressioncompiler.h
+    ---------------------
+    begin                : January 2014
+    copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#ifndef QGSPOSTGRESEXPRESSIONCOMPILER_H
+#define QGSPOSTGRESEXPRESSIONCOMPILER_H
+
+#include "qgssqlexpressioncompiler.h"
+
+class QgsPostgresProvider;
+
+/**
+ * Translation of feature request expressions to PostgreSQL WHERE clauses.
+ */
+class QgsPostgresExpressionCompiler : public QgsSqlExpressionCompiler
+{
+  public:
+    QgsPostgresExpressionCompiler( QgsPostgresProvider* provider );
+
+  protected:
+    virtual QString quotedIdentifier( const QString& identifier );
+    virtual QString quotedValue( const QVariant& value );
+    virtual QString sqlFunctionFromFunctionName( const QString& fnName ) const;
+
+  private:
+    //! only columns whose values compare the same way in PostgreSQL and in QgsExpression
+    static QgsFields compilableFields( const QgsFields& fields );
+};
+
+#endif // QGSPOSTGRESEXPRESSIONCOMPILER_H
@@ -13,6 +13,7 @@
  *                                                                         *
  ***************************************************************************/
 #include "qgspostgresfeatureiterator.h"
+#include "qgspostgresexpressioncompiler.h"
 #include "qgspostgresprovider.h"
 #include "qgsgeometry.h"
 
@@ -47,6 +48,7 @@ const int QgsPostgresFeatureIterator::sFeatureQueueSize = 2000;
 QgsPostgresFeatureIterator::QgsPostgresFeatureIterator( QgsPostgresProvider* p, const QgsFeatureRequest& request )
     : QgsAbstractFeatureIterator( request ), P( p )
     , mFeatureQueueSize( sFeatureQueueSize )
+    , mExpressionCompiled( false )
 {
   mCursorName = QString( "qgisf%1_%2" ).arg( P->mProviderId ).arg( P->mIteratorCounter++ );
 
@@ -75,7 +77,56 @@ QgsPostgresFeatureIterator::QgsPostgresFeatureIterator( QgsPostgresProvider* p,
     whereClause += "(" + P->mSqlWhereClause + ")";
   }
 
-  if ( !declareCursor( whereClause ) )
+  if ( !request.filterNativeExpression().isEmpty() )
+  {
+    if ( !whereClause.isEmpty() )
+      whereClause += " AND ";
+
+    whereClause += "(" + request.filterNativeExpression() + ")";
+  }
+
+  QString compiledWhereClause;
+  if ( request.filterType() == QgsFeatureRequest::FilterExpression && QgsSqlExpressionCompiler::compilationEnabled() )
+  {
+    QgsPostgresExpressionCompiler compiler( P );
+    QgsSqlExpressionCompiler::Result result = compiler.compile( request.filterExpression() );
+    if ( result == QgsSqlExpressionCompiler::Complete || result == QgsSqlExpressionCompiler::Partial )
+    {
+      compiledWhereClause = whereClause;
+      if ( !compiledWhereClause.isEmpty() )
+        compiledWhereClause += " AND ";
+      compiledWhereClause += compiler.result();
+
+      mExpressionCompiled = result == QgsSqlExpressionCompiler::Complete;
+    }
+  }
+
+  QString orderBy;
+  if ( !request.orderBy().isEmpty() && QgsSqlExpressionCompiler::compilationEnabled() )
+  {
+    QgsPostgresExpressionCompiler compiler( P );
+    if ( compiler.compileOrderBy( request.orderBy() ) == QgsSqlExpressionCompiler::Complete )
+    {
+      orderBy = compiler.result();
+      mOrderByCompiled = true;
+    }
+  }
+
+  bool localFiltering = request.filterType() == QgsFeatureRequest::FilterExpression;
+  bool compiled = !compiledWhereClause.isEmpty() || !orderBy.isEmpty();
+
+  // the connection and its transaction are shared with other iterators, so the
+  // attempt with the compiled clauses must not roll back the transaction if it fails
+  if ( compiled && !declareCursor( compiledWhereClause.isEmpty() ? whereClause : compiledWhereClause, orderBy, providerLimit( localFiltering && !mExpressionCompiled ), true ) )
+  {
+    // fall back to local evaluation of the expression and local sorting
+    QgsDebugMsg( QString( "declaring cursor with compiled expression or order failed - retrying without them" ) );
+    compiled = false;
+    mExpressionCompiled = false;
+    mOrderByCompiled = false;
+  }
+
+  if ( !compiled && !declareCursor( whereClause, QString(), providerLimit( localFiltering ) ) )
   {
     mClosed = true;
     return;
@@ -100,52 +151,14 @@ bool QgsPostgresFeatureIterator::fetchFeature( QgsFeature& feature )
 
   if ( mFeatureQueue.empty() )
   {
-    QString fetch = QString( "FETCH FORWARD %1 FROM %2" ).arg( mFeatureQueueSize ).arg( mCursorName );
-    QgsDebugMsgLevel( QString( "fetching %1 features." ).arg( mFeatureQueueSize ), 4 );
-    if ( P->mConnectionRO->PQsendQuery( fetch ) == 0 ) // fetch features asynchronously
-    {
-      QgsMessageLog::logMessage( QObject::tr( "Fetching from cursor %1 failed\nDatabase error: %2" ).arg( mCursorName ).arg( P->mConnectionRO->PQerrorMessage() ), QObject::tr( "PostGIS" ) );
-    }
-
-    QgsPostgresResult queryResult;
-    for ( ;; )
-    {
-      queryResult = P->mConnectionRO->PQgetResult();
-      if ( !queryResult.result() )
-        break;
-
-      if ( queryResult.PQresultStatus() != PGRES_TUPLES_OK )
-      {
-        QgsMessageLog::logMessage( QObject::tr( "Fetching from cursor %1 failed\nDatabase error: %2" ).arg( mCursorName ).arg( P->mConnectionRO->PQerrorMessage() ), QObject::tr( "PostGIS" ) );
-        break;
-      }
-
-      int rows = queryResult.PQntuples();
-      if ( rows == 0 )
-        continue;
-
-      for ( int row = 0; row < rows; row++ )
-      {
-        mFeatureQueue.enqueue( QgsFeature() );
-        getFeature( queryResult, row, mFeatureQueue.back() );
-      } // for each row in queue
-    }
+    QgsFeatureList none;
+    int count = 0;
+    fetchFromCursor( none, count, 0 );
   }
 
   if ( mFeatureQueue.empty() )
   {
-    QgsDebugMsg( QString( "Finished after %1 features" ).arg( mFetched ) );
-    close();
-
-    /* only updates the feature count if it was already once.
-     * Otherwise, this would lead to false feature count if
-     * an existing project is open at a restrictive extent.
-     */
-    if ( P->mFeaturesCounted > 0 && P->mFeaturesCounted < mFetched )
-    {
-      QgsDebugMsg( QString( "feature count adjusted from %1 to %2" ).arg( P->mFeaturesCounted ).arg( mFetched ) );
-      P->mFeaturesCounted = mFetched;
-    }
+    finishFetching();
     return false;
   }
 
@@ -171,6 +184,91 @@ bool QgsPostgresFeatureIterator::fetchFeature( QgsFeature& feature )
   return true;
 }
 
+int QgsPostgresFeatureIterator::fetchFeatures( QgsFeatureList& features, int n )
+{
+  int count = 0;
+
+  // features left in the queue first
+  while ( count < n && !mFeatureQueue.empty() && fetchFeature( features[count] ) )
+    count++;
+
+  while ( count < n && !mClosed )
+  {
+    int fetched = count;
+    fetchFromCursor( features, count, n );
+
+    if ( count == fetched )
+      finishFetching();
+  }
+
+  return count;
+}
+
+void QgsPostgresFeatureIterator::fetchFromCursor( QgsFeatureList& features, int& count, int n )
+{
+  int fetchSize = qMax( mFeatureQueueSize, n - count );
+  QString fetch = QString( "FETCH FORWARD %1 FROM %2" ).arg( fetchSize ).arg( mCursorName );
+  QgsDebugMsgLevel( QString( "fetching %1 features." ).arg( fetchSize ), 4 );
+  if ( P->mConnectionRO->PQsendQuery( fetch ) == 0 ) // fetch features asynchronously
+  {
+    QgsMessageLog::logMessage( QObject::tr( "Fetching from cursor %1 failed\nDatabase error: %2" ).arg( mCursorName ).arg( P->mConnectionRO->PQerrorMessage() ), QObject::tr( "PostGIS" ) );
+  }
+
+  QgsPostgresResult queryResult;
+  for ( ;; )
+  {
+    queryResult = P->mConnectionRO->PQgetResult();
+    if ( !queryResult.result() )
+      break;
+
+    if ( queryResult.PQresultStatus() != PGRES_TUPLES_OK )
+    {
+      QgsMessageLog::logMessage( QObject::tr( "Fetching from cursor %1 failed\nDatabase error: %2" ).arg( mCursorName ).arg( P->mConnectionRO->PQerrorMessage() ), QObject::tr( "PostGIS" ) );
+      break;
+    }
+
+    int rows = queryResult.PQntuples();
+    if ( rows == 0 )
+      continue;
+
+    for ( int row = 0; row < rows; row++ )
+    {
+      if ( count < n )
+      {
+        // decode directly into the caller's feature, reusing its geometry
+        QgsFeature& feature = features[count++];
+        getFeature( queryResult, row, feature );
+        if ( !mFetchGeometry )
+          feature.setGeometryAndOwnership( 0, 0 );
+        feature.setValid( true );
+        feature.setFields( &P->mAttributeFields ); // allow name-based attribute lookups
+        mFetched++;
+      }
+      else
+      {
+        mFeatureQueue.enqueue( QgsFeature() );
+        getFeature( queryResult, row, mFeatureQueue.back() );
+      }
+    } // for each row in queue
+  }
+}
+
+void QgsPostgresFeatureIterator::finishFetching()
+{
+  QgsDebugMsg( QString( "Finished after %1 features" ).arg( mFetched ) );
+  close();
+
+  /* only updates the feature count if it was already once.
+   * Otherwise, this would lead to false feature count if
+   * an existing project is open at a restrictive extent.
+   */
+  if ( P->mFeaturesCounted > 0 && P->mFeaturesCounted < mFetched )
+  {
+    QgsDebugMsg( QString( "feature count adjusted from %1 to %2" ).arg( P->mFeaturesCounted ).arg( mFetched ) );
+    P->mFeaturesCounted = mFetched;
+  }
+}
+
 bool QgsPostgresFeatureIterator::prepareSimplification( const QgsSimplifyMethod& simplifyMethod )
 {
   // setup simplification of geometries to fetch
@@ -195,6 +293,15 @@ bool QgsPostgresFeatureIterator::providerCanSimplify( QgsSimplifyMethod::MethodT
   return methodType == QgsSimplifyMethod::OptimizeForRendering || methodType == QgsSimplifyMethod::PreserveTopology;
 }
 
+bool QgsPostgresFeatureIterator::nextFeatureFilterExpression( QgsFeature& f )
+{
+  if ( mExpressionCompiled )
+    return fetchFeature( f );
+
+  return QgsAbstractFeatureIterator::nextFeatureFilterExpression( f );
+}
+
+
 bool QgsPostgresFeatureIterator::rewind()
 {
   if ( mClosed )
@@ -290,7 +397,7 @@ QString QgsPostgresFeatureIterator::whereClauseRect()
 
 
 
-bool QgsPostgresFeatureIterator::declareCursor( const QString& whereClause )
+bool QgsPostgresFeatureIterator::declareCursor( const QString& whereClause, const QString& orderBy, long limit, bool mayFail )
 {
   mFetchGeometry = !( mRequest.flags() & QgsFeatureRequest::NoGeometry ) && !P->mGeometryColumn.isNull();
   bool simplifyGeometry = false;
@@ -385,8 +492,20 @@ bool QgsPostgresFeatureIterator::declareCursor( const QString& whereClause )
     if ( !whereClause.isEmpty() )
       query += QString( " WHERE %1" ).arg( whereClause );
 
-    if ( !P->mConnectionRO->openCursor( mCursorName, query ) )
+    if ( !orderBy.isEmpty() )
+      query += QString( " ORDER BY %1" ).arg( orderBy );
+
+    if ( limit >= 0 )
+      query += QString( " LIMIT %1" ).arg( limit );
+
+    if ( !P->mConnectionRO->openCursor( mCursorName, query, mayFail ) )
     {
+      if ( mayFail )
+      {
+        // there is no cursor to rewind - the caller retries without the compiled clauses
+        return false;
+      }
+
       // reloading the fields might help next time around
       rewind();
       P->loadFields();
@@ -40,6 +40,12 @@ class QgsPostgresFeatureIterator : public QgsAbstractFeatureIterator
     //! fetch next feature, return true on success
     virtual bool fetchFeature( QgsFeature& feature );
 
+    //! fetch a batch of features, decoding the rows directly into the features of the list
+    virtual int fetchFeatures( QgsFeatureList& features, int n );
+
+    //! skips the local evaluation if the whole expression is part of the query
+    virtual bool nextFeatureFilterExpression( QgsFeature& f );
+
     //! Setup the simplification of geometries to fetch using the specified simplify method
     virtual bool prepareSimplification( const QgsSimplifyMethod& simplifyMethod );
 
@@ -48,7 +54,14 @@ class QgsPostgresFeatureIterator : public QgsAbstractFeatureIterator
     QString whereClauseRect();
     bool getFeature( QgsPostgresResult &queryResult, int row, QgsFeature &feature );
     void getFeatureAttribute( int idx, QgsPostgresResult& queryResult, int row, int& col, QgsFeature& feature );
-    bool declareCursor( const QString& whereClause );
+    //! declare the cursor - the query is sorted if orderBy is not empty and limited if limit is not negative.
+    //! If mayFail is set, a failure does not abort the transaction of the connection (see QgsPostgresConn::openCursor())
+    bool declareCursor( const QString& whereClause, const QString& orderBy = QString(), long limit = -1, bool mayFail = false );
+
+    //! fetch the next rows from the cursor: into features[count] .. features[n-1], the rest to the feature queue
+    void fetchFromCursor( QgsFeatureList& features, int& count, int n );
+    //! close the iterator at the end of data and update the provider's feature count
+    void finishFetching();
 
     QString mCursorName;
 
@@ -67,6 +80,9 @@ class QgsPostgresFeatureIterator : public QgsAbstractFeatureIterator
     //! Set to true, if geometry is in the requested columns
     bool mFetchGeometry;
 
+    //! Set to true, if the filter expression was completely translated to SQL
+    bool mExpressionCompiled;
+
     static const int sFeatureQueueSize;
 
   private:
@@ -0,0 +1,48 @@
+/***************************************************************************
+    qgsspatialiteexpressioncompiler.cpp
+    ---------------------
+    begin                : January 2014
+    copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include "qgsspatialiteexpressioncompiler.h"
+#include "qgsspatialiteprovider.h"
+
+QgsSpatiaLiteExpressionCompiler::QgsSpatiaLiteExpressionCompiler( QgsSpatiaLiteProvider* provider )
+    : QgsSqlExpressionCompiler( provider->fields(), LikeIsCaseInsensitive | NullsSortFirst )
+{
+}
+
+QString QgsSpatiaLiteExpressionCompiler::quotedIdentifier( const QString& identifier )
+{
+  return QgsSpatiaLiteProvider::quotedIdentifier( identifier );
+}
+
+bool QgsSpatiaLiteExpressionCompiler::compileLike( const QgsExpression::NodeBinaryOperator* n, const QString& left, const QString& pattern, QString& str )
+{
+  if ( n->op() == QgsExpression::boILike || n->op() == QgsExpression::boNotILike )
+    return QgsSqlExpressionCompiler::compileLike( n, left, pattern, str );
+
+  QString glob;
+  for ( int i = 0; i < pattern.length(); i++ )
+  {
+    QChar c = pattern.at( i );
+    if ( c == '%' )
+      glob += '*';
+    else if ( c == '_' )
+      glob += '?';
+    else if ( c == '*' || c == '?' || c == '[' )
+      glob += QString( "[%1]" ).arg( c );
+    else
+      glob += c;
+  }
+
+  str = QString( "(%1 %2GLOB %3)" ).arg( left ).arg( n->op() == QgsExpression::boNotLike ? "NOT " : "" ).arg( quotedValue( glob ) );
+  return true;
+}
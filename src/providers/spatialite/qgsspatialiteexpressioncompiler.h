@@ -0,0 +1,36 @@
+/***************************************************************************
+    qgsspatialiteexpressioncompiler.h
+    ---------------------
+    begin                : January 2014
+    copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#ifndef QGSSPATIALITEEXPRESSIONCOMPILER_H
+#define QGSSPATIALITEEXPRESSIONCOMPILER_H
+
+#include "qgssqlexpressioncompiler.h"
+
+class QgsSpatiaLiteProvider;
+
+/**
+ * Translation of feature request expressions to SQLite WHERE clauses.
+ */
+class QgsSpatiaLiteExpressionCompiler : public QgsSqlExpressionCompiler
+{
+  public:
+    QgsSpatiaLiteExpressionCompiler( QgsSpatiaLiteProvider* provider );
+
+  protected:
+    virtual QString quotedIdentifier( const QString& identifier );
+
+    //! LIKE of SQLite ignores case - case sensitive patterns are translated to GLOB
+    virtual bool compileLike( const QgsExpression::NodeBinaryOperator* n, const QString& left, const QString& pattern, QString& str );
+};
+
+#endif // QGSSPATIALITEEXPRESSIONCOMPILER_H
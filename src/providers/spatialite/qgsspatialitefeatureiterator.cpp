@@ -14,6 +14,7 @@
  ***************************************************************************/
 #include "qgsspatialitefeatureiterator.h"
 
+#include "qgsspatialiteexpressioncompiler.h"
 #include "qgsspatialiteprovider.h"
 
 #include "qgslogger.h"
@@ -41,6 +42,7 @@ QgsSpatiaLiteFeatureIterator::QgsSpatiaLiteFeatureIterator( QgsSpatiaLiteProvide
     : QgsAbstractFeatureIterator( request )
     , P( p )
     , sqliteStatement( NULL )
+    , mExpressionCompiled( false )
 {
   P->mActiveIterators << this;
 
@@ -67,8 +69,59 @@ QgsSpatiaLiteFeatureIterator::QgsSpatiaLiteFeatureIterator( QgsSpatiaLiteProvide
     whereClause += "( " + P->mSubsetString + ")";
   }
 
+  if ( !request.filterNativeExpression().isEmpty() )
+  {
+    if ( !whereClause.isEmpty() )
+    {
+      whereClause += " AND ";
+    }
+    whereClause += "( " + request.filterNativeExpression() + ")";
+  }
+
+  QString compiledWhereClause;
+  if ( request.filterType() == QgsFeatureRequest::FilterExpression && QgsSqlExpressionCompiler::compilationEnabled() )
+  {
+    QgsSpatiaLiteExpressionCompiler compiler( P );
+    QgsSqlExpressionCompiler::Result result = compiler.compile( request.filterExpression() );
+    if ( result == QgsSqlExpressionCompiler::Complete || result == QgsSqlExpressionCompiler::Partial )
+    {
+      compiledWhereClause = whereClause;
+      if ( !compiledWhereClause.isEmpty() )
+        compiledWhereClause += " AND ";
+      compiledWhereClause += compiler.result();
+
+      mExpressionCompiled = result == QgsSqlExpressionCompiler::Complete;
+    }
+  }
+
+  QString orderBy;
+  if ( !request.orderBy().isEmpty() && QgsSqlExpressionCompiler::compilationEnabled() )
+  {
+    QgsSpatiaLiteExpressionCompiler compiler( P );
+    if ( compiler.compileOrderBy( request.orderBy() ) == QgsSqlExpressionCompiler::Complete )
+    {
+      orderBy = compiler.result();
+      mOrderByCompiled = true;
+    }
+  }
+
+  // feature ids are filtered locally
+  bool localFiltering = request.filterType() == QgsFeatureRequest::FilterExpression || request.filterType() == QgsFeatureRequest::FilterFids;
+  bool compiled = !compiledWhereClause.isEmpty() || !orderBy.isEmpty();
+
+  if ( compiled && !prepareStatement( compiledWhereClause.isEmpty() ? whereClause : compiledWhereClause, orderBy,
+                                      providerLimit( localFiltering && !mExpressionCompiled ) ) )
+  {
+    // fall back to local evaluation of the expression and local sorting
+    QgsDebugMsg( "preparing statement with compiled expression or order failed - retrying without them" );
+    sqliteStatement = NULL;
+    compiled = false;
+    mExpressionCompiled = false;
+    mOrderByCompiled = false;
+  }
+
   // preparing the SQL statement
-  if ( !prepareStatement( whereClause ) )
+  if ( !compiled && !prepareStatement( whereClause, QString(), providerLimit( localFiltering ) ) )
   {
     // some error occurred
     sqliteStatement = NULL;
@@ -109,6 +162,15 @@ bool QgsSpatiaLiteFeatureIterator::fetchFeature( QgsFeature& feature )
 }
 
 
+bool QgsSpatiaLiteFeatureIterator::nextFeatureFilterExpression( QgsFeature& f )
+{
+  if ( mExpressionCompiled )
+    return fetchFeature( f );
+
+  return QgsAbstractFeatureIterator::nextFeatureFilterExpression( f );
+}
+
+
 bool QgsSpatiaLiteFeatureIterator::rewind()
 {
   if ( mClosed )
@@ -144,7 +206,7 @@ bool QgsSpatiaLiteFeatureIterator::close()
 ////
 
 
-bool QgsSpatiaLiteFeatureIterator::prepareStatement( QString whereClause )
+bool QgsSpatiaLiteFeatureIterator::prepareStatement( QString whereClause, QString orderBy, long limit )
 {
   try
   {
@@ -180,6 +242,12 @@ bool QgsSpatiaLiteFeatureIterator::prepareStatement( QString whereClause )
     if ( !whereClause.isEmpty() )
       sql += QString( " WHERE %1" ).arg( whereClause );
 
+    if ( !orderBy.isEmpty() )
+      sql += QString( " ORDER BY %1" ).arg( orderBy );
+
+    if ( limit >= 0 )
+      sql += QString( " LIMIT %1" ).arg( limit );
+
     if ( sqlite3_prepare_v2( P->sqliteHandle, sql.toUtf8().constData(), -1, &sqliteStatement, NULL ) != SQLITE_OK )
     {
       // some error occurred
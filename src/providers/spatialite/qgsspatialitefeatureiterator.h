@@ -43,12 +43,15 @@ class QgsSpatiaLiteFeatureIterator : public QgsAbstractFeatureIterator
     //! fetch next feature, return true on success
     virtual bool fetchFeature( QgsFeature& feature );
 
+    //! skips the local evaluation if the whole expression is part of the query
+    virtual bool nextFeatureFilterExpression( QgsFeature& f );
+
     QgsSpatiaLiteProvider* P;
 
     QString whereClauseRect();
     QString whereClauseFid();
     QString mbr( const QgsRectangle& rect );
-    bool prepareStatement( QString whereClause );
+    bool prepareStatement( QString whereClause, QString orderBy = QString(), long limit = -1 );
     QString quotedPrimaryKey();
     bool getFeature( sqlite3_stmt *stmt, QgsFeature &feature );
     QString fieldName( const QgsField& fld );
@@ -65,6 +68,9 @@ class QgsSpatiaLiteFeatureIterator : public QgsAbstractFeatureIterator
 
     //! Set to true, if geometry is in the requested columns
     bool mFetchGeometry;
+
+    //! Set to true, if the filter expression was completely translated to SQL
+    bool mExpressionCompiled;
 };
 
 #endif // QGSSPATIALITEFEATUREITERATOR_H
@@ -50,6 +50,11 @@ QgsSqlAnywhereFeatureIterator::QgsSqlAnywhereFeatureIterator( QgsSqlAnywhereProv
   mClosed = false;
   QString whereClause = P->getWhereClause();
 
+  if ( !request.filterNativeExpression().isEmpty() )
+  {
+    whereClause += " AND ( " + request.filterNativeExpression() + ") ";
+  }
+
   if ( request.filterType() == QgsFeatureRequest::FilterRect && !P->mGeometryColumn.isNull() )
   {
     mStmtRect = mRequest.filterRect();
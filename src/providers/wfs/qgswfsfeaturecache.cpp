@@ -0,0 +1,354 @@
+/***************************************************************************
+    qgswfsfeaturecache.cpp
+    ---------------------
+    begin                : January 2014
+    copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include "qgswfsfeaturecache.h"
+#include "qgsgeometry.h"
+#include "qgslogger.h"
+#include "qgsspatialindex.h"
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QTemporaryFile>
+
+#include <sqlite3.h>
+
+#include <cmath>
+
+// features without geometry have a minimal box, points have an empty one
+static bool hasBox( const QgsRectangle& box )
+{
+  return box.xMinimum() <= box.xMaximum();
+}
+
+static QgsRectangle noBox()
+{
+  QgsRectangle box;
+  box.setMinimal();
+  return box;
+}
+
+static QString tileKey( int level, qint64 column, qint64 row )
+{
+  return QString( "%1/%2/%3" ).arg( level ).arg( column ).arg( row );
+}
+
+//division rounding towards negative infinity, tiles left of / below the origin have negative indices
+static qint64 parentIndex( qint64 index )
+{
+  return index >= 0 ? index / 2 : -(( -index + 1 ) / 2 );
+}
+
+QgsRectangle QgsWFSFeatureCache::Tile::extent() const
+{
+  double size = pow( 2.0, level );
+  return QgsRectangle( column * size, row * size, ( column + 1 ) * size, ( row + 1 ) * size );
+}
+
+QgsWFSFeatureCache::QgsWFSFeatureCache()
+    : mFile( 0 )
+    , mDb( 0 )
+    , mInsertStmt( 0 )
+    , mSelectStmt( 0 )
+    , mDeleteStmt( 0 )
+    , mInBatch( false )
+    , mSpatialIndex( new QgsSpatialIndex() )
+{
+  // the temporary file only reserves a unique name, SQLite opens the file itself
+  mFile = new QTemporaryFile( QDir::tempPath() + "/qgis_wfs_XXXXXX.sqlite" );
+  if ( !mFile->open() )
+  {
+    QgsDebugMsg( "could not create the file of the WFS feature cache" );
+    return;
+  }
+  mFile->close();
+
+  if ( sqlite3_open( QFile::encodeName( mFile->fileName() ).constData(), &mDb ) != SQLITE_OK )
+  {
+    QgsDebugMsg( QString( "could not open the WFS feature cache: %1" ).arg( sqlite3_errmsg( mDb ) ) );
+    sqlite3_close( mDb );
+    mDb = 0;
+    return;
+  }
+
+  // the cache is thrown away with the provider, no need to survive crashes
+  if ( !execute( "PRAGMA synchronous=OFF" ) ||
+       !execute( "PRAGMA journal_mode=OFF" ) ||
+       !execute( "CREATE TABLE features (fid INTEGER PRIMARY KEY, attributes BLOB, geometry BLOB)" ) ||
+       !prepare( &mInsertStmt, "INSERT OR REPLACE INTO features (fid, attributes, geometry) VALUES (?, ?, ?)" ) ||
+       !prepare( &mSelectStmt, "SELECT attributes, geometry FROM features WHERE fid=?" ) ||
+       !prepare( &mDeleteStmt, "DELETE FROM features WHERE fid=?" ) )
+  {
+    finalizeStatements();
+    sqlite3_close( mDb );
+    mDb = 0;
+  }
+}
+
+QgsWFSFeatureCache::~QgsWFSFeatureCache()
+{
+  if ( mDb )
+  {
+    finalizeStatements();
+    sqlite3_close( mDb );
+  }
+  delete mFile;
+  delete mSpatialIndex;
+}
+
+bool QgsWFSFeatureCache::execute( const char* sql )
+{
+  char* errMsg = 0;
+  if ( sqlite3_exec( mDb, sql, 0, 0, &errMsg ) != SQLITE_OK )
+  {
+    QgsDebugMsg( QString( "%1 failed: %2" ).arg( sql ).arg( errMsg ) );
+    sqlite3_free( errMsg );
+    return false;
+  }
+  return true;
+}
+
+bool QgsWFSFeatureCache::prepare( sqlite3_stmt** stmt, const char* sql )
+{
+  if ( sqlite3_prepare_v2( mDb, sql, -1, stmt, 0 ) != SQLITE_OK )
+  {
+    QgsDebugMsg( QString( "%1 failed: %2" ).arg( sql ).arg( sqlite3_errmsg( mDb ) ) );
+    *stmt = 0;
+    return false;
+  }
+  return true;
+}
+
+void QgsWFSFeatureCache::finalizeStatements()
+{
+  sqlite3_finalize( mInsertStmt );
+  sqlite3_finalize( mSelectStmt );
+  sqlite3_finalize( mDeleteStmt );
+  mInsertStmt = mSelectStmt = mDeleteStmt = 0;
+}
+
+void QgsWFSFeatureCache::clear()
+{
+  mBoxes.clear();
+  mWfsIds.clear();
+  mFetchedTiles.clear();
+  delete mSpatialIndex;
+  mSpatialIndex = new QgsSpatialIndex();
+
+  if ( mDb )
+    execute( "DELETE FROM features" );
+}
+
+void QgsWFSFeatureCache::indexFeature( QgsFeatureId fid, const QgsRectangle& box, bool add )
+{
+  if ( !hasBox( box ) )
+    return;
+
+  QgsFeature f( fid );
+  f.setGeometry( QgsGeometry::fromRect( box ) );
+  if ( add )
+    mSpatialIndex->insertFeature( f );
+  else
+    mSpatialIndex->deleteFeature( f );
+}
+
+bool QgsWFSFeatureCache::storeFeature( const QgsFeature& feature, const QString& wfsId )
+{
+  if ( !mDb )
+    return false;
+
+  QByteArray attributes;
+  QDataStream ds( &attributes, QIODevice::WriteOnly );
+  ds << feature.attributes();
+
+  QgsGeometry* geom = feature.geometry();
+
+  sqlite3_bind_int64( mInsertStmt, 1, feature.id() );
+  sqlite3_bind_blob( mInsertStmt, 2, attributes.constData(), attributes.size(), SQLITE_STATIC );
+  if ( geom )
+    sqlite3_bind_blob( mInsertStmt, 3, geom->asWkb(), geom->wkbSize(), SQLITE_STATIC );
+  else
+    sqlite3_bind_null( mInsertStmt, 3 );
+
+  int res = sqlite3_step( mInsertStmt );
+  sqlite3_reset( mInsertStmt );
+  sqlite3_clear_bindings( mInsertStmt );
+  if ( res != SQLITE_DONE )
+  {
+    QgsDebugMsg( QString( "could not store feature %1: %2" ).arg( feature.id() ).arg( sqlite3_errmsg( mDb ) ) );
+    return false;
+  }
+
+  QMap<QgsFeatureId, QgsRectangle>::iterator it = mBoxes.find( feature.id() );
+  if ( it != mBoxes.end() )
+    indexFeature( it.key(), it.value(), false );
+
+  QgsRectangle box = geom ? geom->boundingBox() : noBox();
+  mBoxes.insert( feature.id(), box );
+  indexFeature( feature.id(), box, true );
+
+  if ( !wfsId.isEmpty() )
+    mWfsIds.insert( wfsId );
+  return true;
+}
+
+bool QgsWFSFeatureCache::feature( QgsFeatureId fid, QgsFeature& feature, bool fetchGeometry )
+{
+  if ( !mDb || !mBoxes.contains( fid ) )
+    return false;
+
+  sqlite3_bind_int64( mSelectStmt, 1, fid );
+  bool found = sqlite3_step( mSelectStmt ) == SQLITE_ROW;
+  if ( found )
+  {
+    QByteArray attributes = QByteArray::fromRawData(( const char* ) sqlite3_column_blob( mSelectStmt, 0 ), sqlite3_column_bytes( mSelectStmt, 0 ) );
+    QgsAttributes attrs;
+    QDataStream ds( attributes );
+    ds >> attrs;
+    feature.setAttributes( attrs );
+
+    int wkbSize = sqlite3_column_bytes( mSelectStmt, 1 );
+    if ( fetchGeometry && wkbSize > 0 )
+    {
+      unsigned char* wkb = new unsigned char[wkbSize];
+      memcpy( wkb, sqlite3_column_blob( mSelectStmt, 1 ), wkbSize );
+      feature.setGeometryAndOwnership( wkb, wkbSize );
+    }
+    else
+    {
+      feature.setGeometry( 0 );
+    }
+
+    feature.setFeatureId( fid );
+    feature.setValid( true );
+  }
+  sqlite3_reset( mSelectStmt );
+  return found;
+}
+
+bool QgsWFSFeatureCache::removeFeature( QgsFeatureId fid )
+{
+  QMap<QgsFeatureId, QgsRectangle>::iterator it = mBoxes.find( fid );
+  if ( !mDb || it == mBoxes.end() )
+    return false;
+
+  sqlite3_bind_int64( mDeleteStmt, 1, fid );
+  sqlite3_step( mDeleteStmt );
+  sqlite3_reset( mDeleteStmt );
+
+  indexFeature( fid, it.value(), false );
+  mBoxes.erase( it );
+  return true;
+}
+
+QgsFeatureId QgsWFSFeatureCache::maximumId() const
+{
+  if ( mBoxes.isEmpty() )
+    return -1;
+
+  return ( mBoxes.constEnd() - 1 ).key();
+}
+
+QList<QgsFeatureId> QgsWFSFeatureCache::intersects( const QgsRectangle& rect )
+{
+  return mSpatialIndex->intersects( rect );
+}
+
+QgsRectangle QgsWFSFeatureCache::extent() const
+{
+  QgsRectangle extent = noBox();
+  QMap<QgsFeatureId, QgsRectangle>::const_iterator it = mBoxes.constBegin();
+  for ( ; it != mBoxes.constEnd(); ++it )
+  {
+    QgsRectangle box = it.value();
+    if ( hasBox( box ) )
+      extent.combineExtentWith( &box );
+  }
+  return hasBox( extent ) ? extent : QgsRectangle();
+}
+
+void QgsWFSFeatureCache::beginBatch()
+{
+  if ( mDb && !mInBatch )
+    mInBatch = execute( "BEGIN" );
+}
+
+void QgsWFSFeatureCache::endBatch()
+{
+  if ( mDb && mInBatch )
+  {
+    execute( "COMMIT" );
+    mInBatch = false;
+  }
+}
+
+QList<QgsWFSFeatureCache::Tile> QgsWFSFeatureCache::missingTiles( const QgsRectangle& rect, int tilesPerSide ) const
+{
+  //tiles with a size of a power of two, so that panning and zooming mostly hit
+  //tiles which are already in the cache
+  QList<Tile> tiles;
+  double size = qMax( rect.width(), rect.height() ) / tilesPerSide;
+  if ( size <= 0 )
+    return tiles;
+
+  int level = ( int ) ceil( log( size ) / log( 2.0 ) );
+  double tileSize = pow( 2.0, level );
+
+  qint64 columnMin = ( qint64 ) floor( rect.xMinimum() / tileSize );
+  qint64 columnMax = ( qint64 ) floor( rect.xMaximum() / tileSize );
+  qint64 rowMin = ( qint64 ) floor( rect.yMinimum() / tileSize );
+  qint64 rowMax = ( qint64 ) floor( rect.yMaximum() / tileSize );
+
+  for ( qint64 row = rowMin; row <= rowMax; ++row )
+  {
+    for ( qint64 column = columnMin; column <= columnMax; ++column )
+    {
+      Tile tile( level, column, row );
+      if ( !tileFetched( tile ) )
+        tiles << tile;
+    }
+  }
+  return tiles;
+}
+
+void QgsWFSFeatureCache::addFetchedTile( const Tile& tile )
+{
+  mFetchedTiles.insert( tileKey( tile.level, tile.column, tile.row ) );
+}
+
+bool QgsWFSFeatureCache::tileFetched( const Tile& tile, int depth ) const
+{
+  //the tile itself or one of the larger tiles containing it
+  qint64 c = tile.column;
+  qint64 r = tile.row;
+  for ( int l = tile.level; l < tile.level + 32; ++l )
+  {
+    if ( mFetchedTiles.contains( tileKey( l, c, r ) ) )
+      return true;
+
+    c = parentIndex( c );
+    r = parentIndex( r );
+  }
+
+  //all the sub tiles (e.g. after zooming out)
+  if ( depth <= 0 )
+    return false;
+
+  for ( int i = 0; i < 4; ++i )
+  {
+    if ( !tileFetched( Tile( tile.level - 1, 2 * tile.column + i % 2, 2 * tile.row + i / 2 ), depth - 1 ) )
+      return false;
+  }
+  return true;
+}
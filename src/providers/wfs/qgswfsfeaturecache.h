@@ -0,0 +1,115 @@
+/***************************************************************************
+    qgswfsfeaturecache.h
+    ---------------------
+    begin                : January 2014
+    copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#ifndef QGSWFSFEATURECACHE_H
+#define QGSWFSFEATURECACHE_H
+
+#include "qgsfeature.h"
+#include "qgsrectangle.h"
+
+#include <QMap>
+#include <QSet>
+
+class QgsSpatialIndex;
+class QTemporaryFile;
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+/**On-disk cache of the features downloaded by the WFS provider. Attributes and
+ * geometries are kept in a temporary SQLite database, only the bounding boxes of
+ * the features stay in memory (together with a spatial index of them).
+ * In GetRenderedOnly mode the cache also records which tiles have been fetched.
+ * The cache is removed with the provider.
+ * The cache is not thread safe. It is only used in the thread of its provider,
+ * which refuses requests from other threads (WFS layers are not rendered in parallel).*/
+class QgsWFSFeatureCache
+{
+  public:
+    /**GetRenderedOnly: square tile of the quadtree aligned at the origin, with a side of 2^level*/
+    struct Tile
+    {
+      Tile( int l = 0, qint64 c = 0, qint64 r = 0 ): level( l ), column( c ), row( r ) {}
+      QgsRectangle extent() const;
+
+      int level;
+      qint64 column;
+      qint64 row;
+    };
+
+    QgsWFSFeatureCache();
+    ~QgsWFSFeatureCache();
+
+    /**False if the database could not be created*/
+    bool isValid() const { return mDb != 0; }
+
+    /**Removes all the features*/
+    void clear();
+
+    /**Stores the feature or replaces the feature with the same id. A non empty WFS server id is remembered*/
+    bool storeFeature( const QgsFeature& feature, const QString& wfsId = QString() );
+    /**Reads the feature with the id into feature, the geometry only if fetchGeometry is set*/
+    bool feature( QgsFeatureId fid, QgsFeature& feature, bool fetchGeometry );
+    bool removeFeature( QgsFeatureId fid );
+
+    bool contains( QgsFeatureId fid ) const { return mBoxes.contains( fid ); }
+    /**True if a feature with the WFS server id has been stored (even if it has been removed since).
+      Features received with several tiles are only stored once*/
+    bool containsWfsId( const QString& wfsId ) const { return mWfsIds.contains( wfsId ); }
+    int count() const { return mBoxes.size(); }
+    /**Ids of all the features in ascending order*/
+    QList<QgsFeatureId> ids() const { return mBoxes.keys(); }
+    /**Largest id in the cache or -1 if it is empty*/
+    QgsFeatureId maximumId() const;
+    /**Ids of the features whose bounding boxes intersect the rectangle*/
+    QList<QgsFeatureId> intersects( const QgsRectangle& rect );
+    /**Combined bounding box of all the features*/
+    QgsRectangle extent() const;
+
+    /**Groups the following changes into one transaction, much faster for many features*/
+    void beginBatch();
+    void endBatch();
+
+    /**GetRenderedOnly: the tiles covering rect, about tilesPerSide of them across it, which are
+      not covered by fetched tiles*/
+    QList<Tile> missingTiles( const QgsRectangle& rect, int tilesPerSide ) const;
+    /**GetRenderedOnly: records that the features of the tile have been stored*/
+    void addFetchedTile( const Tile& tile );
+    /**GetRenderedOnly: true if the tile or a larger tile containing it has been fetched, or
+      (up to depth levels deeper) all its sub tiles*/
+    bool tileFetched( const Tile& tile, int depth = 2 ) const;
+
+  private:
+    bool execute( const char* sql );
+    bool prepare( sqlite3_stmt** stmt, const char* sql );
+    void finalizeStatements();
+    void indexFeature( QgsFeatureId fid, const QgsRectangle& box, bool add );
+
+    QTemporaryFile* mFile;
+    sqlite3* mDb;
+    sqlite3_stmt* mInsertStmt;
+    sqlite3_stmt* mSelectStmt;
+    sqlite3_stmt* mDeleteStmt;
+    bool mInBatch;
+
+    /**Bounding boxes of the features, minimal for features without geometry*/
+    QMap<QgsFeatureId, QgsRectangle> mBoxes;
+    QgsSpatialIndex* mSpatialIndex;
+
+    /**WFS server ids of the stored features*/
+    QSet<QString> mWfsIds;
+    /**GetRenderedOnly: tiles which have already been fetched ("level/column/row")*/
+    QSet<QString> mFetchedTiles;
+};
+
+#endif // QGSWFSFEATURECACHE_H
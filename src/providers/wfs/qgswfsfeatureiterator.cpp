@@ -13,7 +13,7 @@
  *                                                                         *
  ***************************************************************************/
 #include "qgswfsfeatureiterator.h"
-#include "qgsspatialindex.h"
+#include "qgswfsfeaturecache.h"
 #include "qgswfsprovider.h"
 #include "qgsmessagelog.h"
 #include "qgsgeometry.h"
@@ -31,21 +31,25 @@ QgsWFSFeatureIterator::QgsWFSFeatureIterator( QgsWFSProvider* provider, const Qg
 
   mProvider->mActiveIterators << this;
 
+  if ( !mProvider->mCache )
+  {
+    //invalid provider, nothing to iterate
+    mFeatureIterator = mSelectedFeatures.constBegin();
+    return;
+  }
+
   switch ( request.filterType() )
   {
     case QgsFeatureRequest::FilterRect:
-      if ( mProvider->mSpatialIndex )
-      {
-        mSelectedFeatures = mProvider->mSpatialIndex->intersects( request.filterRect() );
-      }
+      mSelectedFeatures = mProvider->mCache->intersects( request.filterRect() );
       break;
     case QgsFeatureRequest::FilterFid:
       mSelectedFeatures.push_back( request.filterFid() );
       break;
     case QgsFeatureRequest::FilterNone:
-      mSelectedFeatures = mProvider->mFeatures.keys();
-    default: //QgsFeatureRequest::FilterNone
-      mSelectedFeatures = mProvider->mFeatures.keys();
+    default:
+      mSelectedFeatures = mProvider->mCache->ids();
+      break;
   }
 
   mFeatureIterator = mSelectedFeatures.constBegin();
@@ -68,28 +72,30 @@ bool QgsWFSFeatureIterator::fetchFeature( QgsFeature& f )
     return false;
   }
 
-  QgsFeature *fet = 0;
+  bool fetchGeometry = !( mRequest.flags() & QgsFeatureRequest::NoGeometry ) ||
+                       ( mRequest.flags() & QgsFeatureRequest::ExactIntersect );
 
-  for ( ;; )
+  for ( ; mFeatureIterator != mSelectedFeatures.constEnd(); ++mFeatureIterator )
   {
-    QMap<QgsFeatureId, QgsFeature* >::iterator it = mProvider->mFeatures.find( *mFeatureIterator );
-    if ( it == mProvider->mFeatures.end() )
-      return false;
+    //the feature may have been deleted since the iterator was created
+    if ( !mProvider->mCache->feature( *mFeatureIterator, f, fetchGeometry ) )
+      continue;
 
-    fet = it.value();
-    if (( mRequest.flags() & QgsFeatureRequest::ExactIntersect ) == 0 )
-      break;
+    if ( mRequest.flags() & QgsFeatureRequest::ExactIntersect )
+    {
+      if ( !f.geometry() || !f.geometry()->intersects( mRequest.filterRect() ) )
+        continue;
 
-    if ( fet->geometry() && fet->geometry()->intersects( mRequest.filterRect() ) )
-      break;
+      if ( mRequest.flags() & QgsFeatureRequest::NoGeometry )
+        f.setGeometry( 0 );
+    }
 
+    f.setFields( &mProvider->mFields ); // allow name-based attribute lookups
     ++mFeatureIterator;
+    return true;
   }
 
-
-  mProvider->copyFeature( fet, f, !( mRequest.flags() & QgsFeatureRequest::NoGeometry ) );
-  ++mFeatureIterator;
-  return true;
+  return false;
 }
 
 bool QgsWFSFeatureIterator::rewind()
@@ -25,15 +25,16 @@
 #include "qgsgeometry.h"
 #include "qgsgml.h"
 #include "qgscoordinatereferencesystem.h"
+#include "qgswfsfeaturecache.h"
 #include "qgswfsfeatureiterator.h"
 #include "qgswfsprovider.h"
-#include "qgsspatialindex.h"
 #include "qgslogger.h"
 #include "qgsmessagelog.h"
 #include "qgsnetworkaccessmanager.h"
 #include "qgsogcutils.h"
 
 #include <QDomDocument>
+#include <QEventLoop>
 #include <QMessageBox>
 #include <QDomNodeList>
 #include <QNetworkRequest>
@@ -42,7 +43,9 @@
 #include <QUrl>
 #include <QWidget>
 #include <QPair>
+#include <QThread>
 #include <cfloat>
+#include <cmath>
 
 static const QString TEXT_PROVIDER_KEY = "WFS";
 static const QString TEXT_PROVIDER_DESCRIPTION = "WFS data provider";
@@ -52,6 +55,9 @@ static const QString GML_NAMESPACE = "http://www.opengis.net/gml";
 static const QString OGC_NAMESPACE = "http://www.opengis.net/ogc";
 static const QString OWS_NAMESPACE = "http://www.opengis.net/ows";
 
+// GetRenderedOnly: maximal number of tiles per side of the rendered extent
+static const int WFS_TILES_PER_EXTENT = 3;
+
 QgsWFSProvider::QgsWFSProvider( const QString& uri )
     : QgsVectorDataProvider( uri )
     , mNetworkRequestFinished( true )
@@ -65,13 +71,21 @@ QgsWFSProvider::QgsWFSProvider( const QString& uri )
     , mGetRenderedOnly( false )
     , mInitGro( false )
 {
-  mSpatialIndex = 0;
+  mCache = 0;
   if ( uri.isEmpty() )
   {
     mValid = false;
     return;
   }
 
+  mCache = new QgsWFSFeatureCache();
+  if ( !mCache->isValid() )
+  {
+    mValid = false;
+    QgsMessageLog::logMessage( tr( "Could not create the feature cache for url %1" ).arg( uri ), tr( "WFS" ) );
+    return;
+  }
+
   //Local url or HTTP?  [WBC 111221] refactored from getFeature()
   if ( uri.startsWith( "http" ) )
   {
@@ -131,67 +145,65 @@ QgsWFSProvider::~QgsWFSProvider()
     it->close();
   }
 
-  deleteData();
-  delete mSpatialIndex;
+  delete mCache;
 }
 
 void QgsWFSProvider::reloadData()
 {
   deleteData();
-  delete mSpatialIndex;
-  mSpatialIndex = new QgsSpatialIndex();
+  if ( mGetRenderedOnly )
+  {
+    //the tiles are fetched again when they are rendered
+    return;
+  }
   mValid = !getFeature( dataSourceUri() );
 }
 
 void QgsWFSProvider::deleteData()
 {
   mSelectedFeatures.clear();
-  for ( int i = 0; i < mFeatures.size(); i++ )
+  if ( mCache )
   {
-    delete mFeatures[i];
+    mCache->clear();
   }
-  mFeatures.clear();
+  mIdMap.clear();
+  mFeatureCount = 0;
 }
 
-void QgsWFSProvider::copyFeature( QgsFeature* f, QgsFeature& feature, bool fetchGeometry )
+void QgsWFSProvider::cacheFeature( QgsFeature* f, const QString& wfsId )
 {
-  Q_UNUSED( fetchGeometry );
-
-  if ( !f )
+  if ( !wfsId.isEmpty() && mCache->containsWfsId( wfsId ) )
   {
+    //already fetched with another tile
+    delete f;
     return;
   }
 
-  //copy the geometry
-  QgsGeometry* geometry = f->geometry();
-  if ( geometry && fetchGeometry )
-  {
-    const unsigned char *geom = geometry->asWkb();
-    int geomSize = geometry->wkbSize();
-    unsigned char* copiedGeom = new unsigned char[geomSize];
-    memcpy( copiedGeom, geom, geomSize );
-    feature.setGeometryAndOwnership( copiedGeom, geomSize );
-  }
-  else
-  {
-    feature.setGeometry( 0 );
-  }
-
-  //and the attributes
-  feature.initAttributes( mFields.size() );
+  //the attributes are stored with the types of the fields
+  QgsAttributes attributes( mFields.size() );
   for ( int i = 0; i < mFields.size(); i++ )
   {
     const QVariant &v = f->attributes().value( i );
     if ( v.type() != mFields[i].type() )
-      feature.setAttribute( i, convertValue( mFields[i].type(), v.toString() ) );
+      attributes[i] = convertValue( mFields[i].type(), v.toString() );
     else
-      feature.setAttribute( i, v );
+      attributes[i] = v;
+  }
+  f->setAttributes( attributes );
+
+  QgsFeatureId fid = findNewKey();
+  f->setFeatureId( fid );
+  if ( mCache->storeFeature( *f, wfsId ) && !wfsId.isEmpty() )
+  {
+    mIdMap.insert( fid, wfsId );
   }
+  mFeatureCount = mCache->count();
+  delete f;
+}
 
-  //id and valid
-  feature.setValid( true );
-  feature.setFeatureId( f->id() );
-  feature.setFields( &mFields ); // allow name-based attribute lookups
+void QgsWFSProvider::featureParsed( QgsFeature* feature, const QString& featureId )
+{
+  cacheFeature( feature, featureId );
 }
 
 QGis::WkbType QgsWFSProvider::geometryType() const
@@ -231,6 +243,13 @@ bool QgsWFSProvider::isValid()
 
 QgsFeatureIterator QgsWFSProvider::getFeatures( const QgsFeatureRequest& request )
 {
+  if ( QThread::currentThread() != thread() )
+  {
+    //neither the feature cache nor the network requests may be used from another thread
+    QgsMessageLog::logMessage( tr( "Features of WFS layers can only be read in the thread of the layer" ), tr( "WFS" ) );
+    return QgsFeatureIterator();
+  }
+
   if ( !( request.flags() & QgsFeatureRequest::NoGeometry ) )
   {
     QgsRectangle rect = request.filterRect();
@@ -260,41 +279,8 @@ QgsFeatureIterator QgsWFSProvider::getFeatures( const QgsFeatureRequest& request
 
       if ( mGetRenderedOnly )
       { //"Cache Features" was not selected for this layer
-        //has rendered extent expanded beyond last-retrieved WFS extent?
-        //NB: "intersect" instead of "contains" tolerates rounding errors;
-        //    avoids unnecessary second fetch on zoom-in/zoom-out sequences
-        QgsRectangle olap( rect );
-        olap = olap.intersect( &mGetExtent );
-        if ( qgsDoubleNear( rect.width(), olap.width() ) && qgsDoubleNear( rect.height(), olap.height() ) )
-        { //difference between canvas and layer extents is within rounding error: do not re-fetch
-          QgsDebugMsg( QString( "Layer %1 GetRenderedOnly: no fetch required" ).arg( mLayer->name() ) );
-        }
-        else
-        { //combined old and new extents might speed up local panning & zooming
-          mGetExtent.combineExtentWith( &rect );
-          //but see if the combination is useless or too big
-          double pArea = mGetExtent.width() * mGetExtent.height();
-          double cArea = rect.width() * rect.height();
-          if ( olap.isEmpty() || pArea > ( cArea * 4.0 ) )
-          { //new canvas extent does not overlap or combining old and new extents would
-            //fetch > 4 times the area to be rendered; get only what will be rendered
-            mGetExtent = rect;
-          }
-          QgsDebugMsg( QString( "Layer %1 GetRenderedOnly: fetching extent %2" )
-                       .arg( mLayer->name(), mGetExtent.asWktCoordinates() ) );
-          dsURI = dsURI.replace( QRegExp( "BBOX=[^&]*" ),
-                                 QString( "BBOX=%1,%2,%3,%4" )
-                                 .arg( qgsDoubleToString( mGetExtent.xMinimum() ) )
-                                 .arg( qgsDoubleToString( mGetExtent.yMinimum() ) )
-                                 .arg( qgsDoubleToString( mGetExtent.xMaximum() ) )
-                                 .arg( qgsDoubleToString( mGetExtent.yMaximum() ) ) );
-          //TODO: BBOX may not be combined with FILTER. WFS spec v. 1.1.0, sec. 14.7.3 ff.
-          //      if a FILTER is present, the BBOX must be merged into it, capabilities permitting.
-          //      Else one criterion must be abandoned and the user warned.  [WBC 111221]
-          setDataSourceUri( dsURI );
-          reloadData();
-          mLayer->updateExtents();
-        }
+        //fetch the parts of the rendered extent which have not been fetched before
+        fetchTiles( rect );
       }
     }
 
@@ -382,23 +368,19 @@ bool QgsWFSProvider::addFeatures( QgsFeatureList &flist )
 
   if ( transactionSuccess( serverResponse ) )
   {
-    //transaction successful. Add the features to mSpatialIndex
-    if ( mSpatialIndex )
-    {
-      QStringList idList = insertedFeatureIds( serverResponse );
-      QStringList::const_iterator idIt = idList.constBegin();
-      featureIt = flist.begin();
+    //transaction successful. Add the features to the cache
+    QStringList idList = insertedFeatureIds( serverResponse );
+    QStringList::const_iterator idIt = idList.constBegin();
+    featureIt = flist.begin();
 
-      for ( ; idIt != idList.constEnd() && featureIt != flist.end(); ++idIt, ++featureIt )
-      {
-        QgsFeatureId newId = findNewKey();
-        featureIt->setFeatureId( newId );
-        mFeatures.insert( newId, new QgsFeature( *featureIt ) );
-        mIdMap.insert( newId, *idIt );
-        mSpatialIndex->insertFeature( *featureIt );
-        mFeatureCount = mFeatures.size();
-      }
+    for ( ; idIt != idList.constEnd() && featureIt != flist.end(); ++idIt, ++featureIt )
+    {
+      QgsFeatureId newId = findNewKey();
+      featureIt->setFeatureId( newId );
+      mCache->storeFeature( *featureIt, *idIt );
+      mIdMap.insert( newId, *idIt );
     }
+    mFeatureCount = mCache->count();
     return true;
   }
   else
@@ -461,17 +443,11 @@ bool QgsWFSProvider::deleteFeatures( const QgsFeatureIds &id )
     idIt = id.constBegin();
     for ( ; idIt != id.constEnd(); ++idIt )
     {
-      QMap<QgsFeatureId, QgsFeature* >::iterator fIt = mFeatures.find( *idIt );
-      if ( fIt != mFeatures.end() )
-      {
-        if ( mSpatialIndex )
-        {
-          mSpatialIndex->deleteFeature( *fIt.value() );
-        }
-        delete fIt.value();
-        mFeatures.remove( *idIt );
-      }
+      mCache->removeFeature( *idIt );
+      //the cache keeps the WFS id, so that the feature is not fetched again with another tile
+      mIdMap.remove( *idIt );
     }
+    mFeatureCount = mCache->count();
     return true;
   }
   else
@@ -542,23 +518,14 @@ bool QgsWFSProvider::changeGeometryValues( QgsGeometryMap & geometry_map )
     geomIt = geometry_map.begin();
     for ( ; geomIt != geometry_map.end(); ++geomIt )
     {
-      QMap<QgsFeatureId, QgsFeature* >::iterator fIt = mFeatures.find( geomIt.key() );
-      if ( fIt == mFeatures.end() )
-      {
-        continue;
-      }
-      QgsFeature* currentFeature = fIt.value();
-      if ( !currentFeature )
+      QgsFeature currentFeature;
+      if ( !mCache->feature( geomIt.key(), currentFeature, false ) )
       {
         continue;
       }
 
-      if ( mSpatialIndex )
-      {
-        mSpatialIndex->deleteFeature( *currentFeature );
-        fIt.value()->setGeometry( geomIt.value() );
-        mSpatialIndex->insertFeature( *currentFeature );
-      }
+      currentFeature.setGeometry( geomIt.value() );
+      mCache->storeFeature( currentFeature );
     }
     return true;
   }
@@ -634,18 +601,12 @@ bool QgsWFSProvider::changeAttributeValues( const QgsChangedAttributesMap &attr_
 
   if ( transactionSuccess( serverResponse ) )
   {
-    //change attributes in mFeatures
+    //change attributes in the cache
     attIt = attr_map.constBegin();
     for ( ; attIt != attr_map.constEnd(); ++attIt )
     {
-      QMap<QgsFeatureId, QgsFeature*>::iterator fIt = mFeatures.find( attIt.key() );
-      if ( fIt == mFeatures.end() )
-      {
-        continue;
-      }
-
-      QgsFeature* currentFeature = fIt.value();
-      if ( !currentFeature )
+      QgsFeature currentFeature;
+      if ( !mCache->feature( attIt.key(), currentFeature, true ) )
       {
         continue;
       }
@@ -653,8 +614,9 @@ bool QgsWFSProvider::changeAttributeValues( const QgsChangedAttributesMap &attr_
       QgsAttributeMap::const_iterator attMapIt = attIt.value().constBegin();
       for ( ; attMapIt != attIt.value().constEnd(); ++attMapIt )
       {
-        currentFeature->setAttribute( attMapIt.key(), attMapIt.value() );
+        currentFeature.setAttribute( attMapIt.key(), attMapIt.value() );
       }
+      mCache->storeFeature( currentFeature );
     }
     return true;
   }
@@ -703,6 +665,9 @@ int QgsWFSProvider::getFeatureGET( const QString& uri, const QString& geometryAt
   QString typeName = parameterFromUrl( "typename" );
   QgsGml dataReader( typeName, geometryAttribute, mFields );
 
+  //the features go to the cache while they are downloaded
+  dataReader.setStreaming( true );
+  QObject::connect( &dataReader, SIGNAL( featureParsed( QgsFeature*, const QString& ) ), this, SLOT( featureParsed( QgsFeature*, const QString& ) ) );
   QObject::connect( &dataReader, SIGNAL( dataProgressAndSteps( int , int ) ), this, SLOT( handleWFSProgressMessage( int, int ) ) );
 
   //also connect to statusChanged signal of qgisapp (if it exists)
@@ -724,26 +689,28 @@ int QgsWFSProvider::getFeatureGET( const QString& uri, const QString& geometryAt
   }
 
   //if ( dataReader.getWFSData() != 0 )
-  if ( dataReader.getFeatures( uri, &mWKBType, &mExtent ) != 0 )
+  QgsRectangle extent;
+  mCache->beginBatch();
+  int result = dataReader.getFeatures( uri, &mWKBType, &extent );
+  mCache->endBatch();
+  if ( result != 0 )
   {
     QgsDebugMsg( "getWFSData returned with error" );
     return 1;
   }
-  mFeatures = dataReader.featuresMap();
-  mIdMap = dataReader.idsMap();
-
-  QgsDebugMsg( QString( "feature count after request is: %1" ).arg( mFeatures.size() ) );
-  QgsDebugMsg( QString( "mExtent after request is: %1" ).arg( mExtent.toString() ) );
 
-  if ( mWKBType != QGis::WKBNoGeometry )
+  //streamed features do not contribute to the extent of the reader
+  if ( mGetRenderedOnly || extent.isEmpty() )
   {
-    for ( QMap<QgsFeatureId, QgsFeature*>::iterator it = mFeatures.begin(); it != mFeatures.end(); ++it )
-    {
-      QgsDebugMsg( "feature " + FID_TO_STRING(( *it )->id() ) );
-      mSpatialIndex->insertFeature( *( it.value() ) );
-    }
+    mExtent = mCache->extent();
+  }
+  else
+  {
+    mExtent = extent;
   }
-  mFeatureCount = mFeatures.size();
+
+  QgsDebugMsg( QString( "feature count after request is: %1" ).arg( mFeatureCount ) );
+  QgsDebugMsg( QString( "mExtent after request is: %1" ).arg( mExtent.toString() ) );
 
   return 0;
 }
@@ -1198,13 +1165,10 @@ int QgsWFSProvider::getFeaturesFromGML2( const QDomElement& wfsCollectionElement
   QDomNode currentAttributeChild;
   QDomElement currentAttributeElement;
   QgsFeature* f = 0;
-  unsigned char* wkb = 0;
-  int wkbSize = 0;
-  mFeatureCount = 0;
 
   for ( int i = 0; i < featureTypeNodeList.size(); ++i )
   {
-    f = new QgsFeature( fields(), mFeatureCount );
+    f = new QgsFeature( fields() );
     currentFeatureMemberElem = featureTypeNodeList.at( i ).toElement();
     //the first child element is always <namespace:layer>
     layerNameElem = currentFeatureMemberElem.firstChild().toElement();
@@ -1238,14 +1202,7 @@ int QgsWFSProvider::getFeaturesFromGML2( const QDomElement& wfsCollectionElement
       }
       currentAttributeChild = currentAttributeChild.nextSibling();
     }
-    if ( wkb && wkbSize > 0 )
-    {
-      //insert bbox and pointer to feature into search tree
-      mSpatialIndex->insertFeature( *f );
-    }
-
-    mFeatures.insert( f->id(), f );
-    ++mFeatureCount;
+    cacheFeature( f, QString() );
   }
   return 0;
 }
@@ -1493,16 +1450,8 @@ QStringList QgsWFSProvider::insertedFeatureIds( const QDomDocument& serverRespon
 
 QgsFeatureId QgsWFSProvider::findNewKey() const
 {
-  if ( mFeatures.isEmpty() )
-  {
-    return 0;
-  }
-
-  //else return highest key + 1
-  QMap<QgsFeatureId, QgsFeature*>::const_iterator lastIt = mFeatures.end();
-  --lastIt;
-  QgsFeatureId id = lastIt.key();
-  return ++id;
+  //highest key + 1 (0 for an empty cache)
+  return mCache->maximumId() + 1;
 }
 
 void QgsWFSProvider::getLayerCapabilities()
@@ -1618,6 +1567,99 @@ bool QgsWFSProvider::initGetRenderedOnly( const QgsRectangle &rect )
   return true;
 }
 
+void QgsWFSProvider::fetchTiles( const QgsRectangle& rect )
+{
+  //about WFS_TILES_PER_EXTENT tiles across the rendered extent
+  QList<QgsWFSFeatureCache::Tile> tiles = mCache->missingTiles( rect, WFS_TILES_PER_EXTENT );
+  if ( tiles.isEmpty() )
+  {
+    return;
+  }
+
+  //all the tiles are requested at once, the server delivers them in parallel
+  bool fetched = false;
+  QList<QNetworkReply*> replies;
+  QList<QgsWFSFeatureCache::Tile>::const_iterator tileIt = tiles.constBegin();
+  for ( ; tileIt != tiles.constEnd(); ++tileIt )
+  {
+    QgsRectangle tile = tileIt->extent();
+    QgsDebugMsg( QString( "Layer %1 GetRenderedOnly: fetching tile %2" )
+                 .arg( mLayer->name(), tile.asWktCoordinates() ) );
+    QString dsURI = dataSourceUri();
+    dsURI = dsURI.replace( QRegExp( "BBOX=[^&]*" ),
+                           QString( "BBOX=%1,%2,%3,%4" )
+                           .arg( qgsDoubleToString( tile.xMinimum() ) )
+                           .arg( qgsDoubleToString( tile.yMinimum() ) )
+                           .arg( qgsDoubleToString( tile.xMaximum() ) )
+                           .arg( qgsDoubleToString( tile.yMaximum() ) ) );
+    //TODO: BBOX may not be combined with FILTER. WFS spec v. 1.1.0, sec. 14.7.3 ff.
+    //      if a FILTER is present, the BBOX must be merged into it, capabilities permitting.
+    //      Else one criterion must be abandoned and the user warned.  [WBC 111221]
+    if ( mRequestEncoding != QgsWFSProvider::GET )
+    {
+      //local file
+      if ( getFeature( dsURI ) == 0 )
+      {
+        mCache->addFetchedTile( *tileIt );
+        fetched = true;
+      }
+      continue;
+    }
+    QNetworkRequest request( dsURI );
+    replies << QgsNetworkAccessManager::instance()->get( request );
+  }
+
+  //wait for the last reply, the event loop keeps the application responsive
+  QEventLoop loop;
+  QList<QNetworkReply*>::const_iterator replyIt = replies.constBegin();
+  for ( ; replyIt != replies.constEnd(); ++replyIt )
+  {
+    QObject::connect( *replyIt, SIGNAL( finished() ), &loop, SLOT( quit() ) );
+  }
+  for ( replyIt = replies.constBegin(); replyIt != replies.constEnd(); )
+  {
+    if (( *replyIt )->isFinished() )
+    {
+      ++replyIt;
+    }
+    else
+    {
+      loop.exec();
+    }
+  }
+
+  //the features of all the tiles go to the cache, features of several tiles are stored once
+  QString typeName = parameterFromUrl( "typename" );
+  mCache->beginBatch();
+  for ( int i = 0; i < replies.size(); ++i )
+  {
+    QNetworkReply* reply = replies[i];
+    if ( reply->error() == QNetworkReply::NoError )
+    {
+      QgsGml dataReader( typeName, mGeometryAttribute, mFields );
+      dataReader.setStreaming( true );
+      QObject::connect( &dataReader, SIGNAL( featureParsed( QgsFeature*, const QString& ) ), this, SLOT( featureParsed( QgsFeature*, const QString& ) ) );
+      if ( dataReader.getFeatures( reply->readAll(), &mWKBType ) == 0 )
+      {
+        mCache->addFetchedTile( tiles[i] );
+        fetched = true;
+      }
+    }
+    else
+    {
+      QgsMessageLog::logMessage( tr( "GetRenderedOnly tile request failed with error: %1" ).arg( reply->errorString() ), tr( "WFS" ) );
+    }
+    reply->deleteLater();
+  }
+  mCache->endBatch();
+
+  if ( fetched )
+  {
+    mExtent = mCache->extent();
+    mLayer->updateExtents();
+  }
+}
+
 QGis::WkbType QgsWFSProvider::geomTypeFromPropertyType( QString attName, QString propType )
 {
   Q_UNUSED( attName );
@@ -19,6 +19,7 @@
 #define QGSWFSPROVIDER_H
 
 #include <QDomElement>
+#include <QSet>
 #include "qgis.h"
 #include "qgsrectangle.h"
 #include "qgscoordinatereferencesystem.h"
@@ -28,7 +29,7 @@
 #include "qgswfsfeatureiterator.h"
 
 class QgsRectangle;
-class QgsSpatialIndex;
+class QgsWFSFeatureCache;
 
 /**A provider reading features from a WFS server*/
 class QgsWFSProvider: public QgsVectorDataProvider
@@ -125,6 +126,9 @@ class QgsWFSProvider: public QgsVectorDataProvider
     /**Sets mNetworkRequestFinished flag to true*/
     void networkRequestFinished();
 
+    /**Stores a feature streamed by QgsGml in the feature cache*/
+    void featureParsed( QgsFeature* feature, const QString& featureId );
+
   private:
     bool mNetworkRequestFinished;
     friend class QgsWFSFeatureIterator;
@@ -143,14 +147,12 @@ class QgsWFSProvider: public QgsVectorDataProvider
     QgsRectangle mSpatialFilter;
     /**Flag if precise intersection test is needed. Otherwise, every feature is returned (even if a filter is set)*/
     bool mUseIntersect;
-    /**A spatial index for fast access to a feature subset*/
-    QgsSpatialIndex *mSpatialIndex;
+    /**On-disk cache of the downloaded features with a spatial index*/
+    QgsWFSFeatureCache *mCache;
     /**Vector where the ids of the selected features are inserted*/
     QList<QgsFeatureId> mSelectedFeatures;
     /**Iterator on the feature vector for use in rewind(), nextFeature(), etc...*/
     QList<QgsFeatureId>::iterator mFeatureIterator;
-    /**Map <feature Id / feature> */
-    QMap<QgsFeatureId, QgsFeature* > mFeatures;
     /**Stores the relation between provider ids and WFS server ids*/
     QMap<QgsFeatureId, QString > mIdMap;
     /**Geometry type of the features in this layer*/
@@ -170,8 +172,6 @@ class QgsWFSProvider: public QgsVectorDataProvider
     bool mGetRenderedOnly;
     /**GetRenderedOnly initializaiton flat*/
     bool mInitGro;
-    /**if GetRenderedOnly, extent specified in WFS getFeatures; else empty (no constraint)*/
-    QgsRectangle mGetExtent;
 
     //encoding specific methods of getFeature
     int getFeatureGET( const QString& uri, const QString& geometryAttribute );
@@ -189,8 +189,13 @@ class QgsWFSProvider: public QgsVectorDataProvider
     /**This method tries to guess the geometry attribute and the other attribute names from the .gml file if no schema is present. Returns 0 in case of success*/
     int guessAttributesFromFile( const QString& uri, QString& geometryAttribute, std::list<QString>& thematicAttributes, QGis::WkbType& geomType ) const;
 
-    /**Copies feature attributes / geometry from f to feature*/
-    void copyFeature( QgsFeature* f, QgsFeature& feature, bool fetchGeometry );
+    /**Gives the feature a new id, converts its attributes to the field types, stores it
+      in the feature cache and deletes it. Features which are already cached are only deleted*/
+    void cacheFeature( QgsFeature* f, const QString& wfsId );
+
+    /**GetRenderedOnly: fetches the features of the tiles covering rect which have not been fetched yet.
+      The tiles are requested in parallel, the method returns when all of them are in the cache*/
+    void fetchTiles( const QgsRectangle& rect );
 
     //GML2 specific methods
     int getExtentFromGML2( QgsRectangle* extent, const QDomElement& wfsCollectionElement ) const;
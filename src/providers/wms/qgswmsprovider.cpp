@@ -41,6 +41,7 @@
 #include "qgsmessagelog.h"
 #include "qgsnetworkaccessmanager.h"
 #include "qgsnetworkreplyparser.h"
+#include "qgstilecache.h"
 #include "qgsgml.h"
 #include "qgsgmlschema.h"
 
@@ -63,6 +64,7 @@
 #include <QCoreApplication>
 #include <QTextCodec>
 #include <QTime>
+#include <QTimer>
 
 #ifdef QGISDEBUG
 #include <QFile>
@@ -268,6 +270,11 @@ QgsWmsProvider::~QgsWmsProvider()
   {
     mTileReplies.takeFirst()->deleteLater();
   }
+
+  while ( !mPrefetchReplies.isEmpty() )
+  {
+    mPrefetchReplies.takeFirst()->deleteLater();
+  }
 }
 
 QgsRasterInterface * QgsWmsProvider::clone() const
@@ -879,44 +886,170 @@ QImage *QgsWmsProvider::draw( QgsRectangle  const &viewExtent, int pixelWidth, i
     }
 #endif
 
-    switch ( tileMode )
+    TileRequests requests;
+    createTileRequests( tm, tres, tileMode, col0, row0, col1, row1, changeXY, crsKey, requests );
+
+    // draw the tiles which are already cached right away and request only the missing ones
+    TileRequests missing;
+    foreach ( const TileRequest &r, requests )
     {
-      case WMSC:
+      QImage image;
+      if ( QgsTileCache::tile( r.url, image ) )
       {
-        // add WMS request
-        QUrl url( mIgnoreGetMapUrl ? mBaseUrl : getMapUrl() );
-        setQueryItem( url, "SERVICE", "WMS" );
-        setQueryItem( url, "VERSION", mCapabilities.version );
-        setQueryItem( url, "REQUEST", "GetMap" );
-        setQueryItem( url, "WIDTH", QString::number( tm->tileWidth ) );
-        setQueryItem( url, "HEIGHT", QString::number( tm->tileHeight ) );
-        setQueryItem( url, "LAYERS", mActiveSubLayers.join( "," ) );
-        setQueryItem( url, "STYLES", mActiveSubStyles.join( "," ) );
-        setQueryItem( url, "FORMAT", mImageMimeType );
-        setQueryItem( url, crsKey, mImageCrs );
+        drawTile( r.rect, image );
+      }
+      else
+      {
+        missing << r;
+      }
+    }
 
-        if ( mTiled )
-        {
-          setQueryItem( url, "TILED", "true" );
-        }
+    // until they arrive, fill the areas of the missing tiles from cached tiles of lower resolutions
+    if ( mTiled && !missing.isEmpty() )
+    {
+      drawOtherResTiles( tres, tileMode, changeXY, crsKey, missing );
+    }
+
+    sendTileRequests( missing, false );
+
+    // remember the surrounding tiles, they are requested once the view is complete
+    mPrefetchRequests.clear();
+    if ( s.value( "/qgis/prefetchTiles", true ).toBool() )
+    {
+      int pcol0 = qMax( minTileCol, col0 - 1 );
+      int pcol1 = qMin( maxTileCol, col1 + 1 );
+      if ( row0 > minTileRow )
+        createTileRequests( tm, tres, tileMode, pcol0, row0 - 1, pcol1, row0 - 1, changeXY, crsKey, mPrefetchRequests );
+      if ( row1 < maxTileRow )
+        createTileRequests( tm, tres, tileMode, pcol0, row1 + 1, pcol1, row1 + 1, changeXY, crsKey, mPrefetchRequests );
+      if ( col0 > minTileCol )
+        createTileRequests( tm, tres, tileMode, col0 - 1, row0, col0 - 1, row1, changeXY, crsKey, mPrefetchRequests );
+      if ( col1 < maxTileCol )
+        createTileRequests( tm, tres, tileMode, col1 + 1, row0, col1 + 1, row1, changeXY, crsKey, mPrefetchRequests );
+    }
+
+    emit statusChanged( tr( "Getting tiles." ) );
+
+    mWaiting = true;
+
+    QTime t;
+    t.start();
+
+    // draw everything that is retrieved within a second
+    // and the rest asynchronously
+    while ( !mTileReplies.isEmpty() && ( !bkLayerCaching || t.elapsed() < WMS_THRESHOLD ) )
+    {
+      QCoreApplication::processEvents( QEventLoop::ExcludeUserInputEvents, WMS_THRESHOLD );
+    }
+
+    mWaiting = false;
+
+    if ( mTileReplies.isEmpty() && !mPrefetchRequests.isEmpty() )
+    {
+      QTimer::singleShot( 0, this, SLOT( prefetchTiles() ) );
+    }
+
+#ifdef QGISDEBUG
+    emit statusChanged( tr( "%n tile requests in background", "tile request count", mTileReplies.count() )
+                        + tr( ", %n cache hits", "tile cache hits", mCacheHits )
+                        + tr( ", %n cache misses.", "tile cache missed", mCacheMisses )
+                        + tr( ", %n errors.", "errors", mErrors )
+                      );
+#endif
+  }
+
+  return mCachedImage;
+}
+
+void QgsWmsProvider::createTileRequests( const QgsWmtsTileMatrix *tm, double tres, enum QgsTileMode tileMode,
+    int col0, int row0, int col1, int row1,
+    bool changeXY, const QString &crsKey, TileRequests &requests )
+{
+  double twMap = tm->tileWidth * tres;
+  double thMap = tm->tileHeight * tres;
+
+  switch ( tileMode )
+  {
+    case WMSC:
+    {
+      // add WMS request
+      QUrl url( mIgnoreGetMapUrl ? mBaseUrl : getMapUrl() );
+      setQueryItem( url, "SERVICE", "WMS" );
+      setQueryItem( url, "VERSION", mCapabilities.version );
+      setQueryItem( url, "REQUEST", "GetMap" );
+      setQueryItem( url, "WIDTH", QString::number( tm->tileWidth ) );
+      setQueryItem( url, "HEIGHT", QString::number( tm->tileHeight ) );
+      setQueryItem( url, "LAYERS", mActiveSubLayers.join( "," ) );
+      setQueryItem( url, "STYLES", mActiveSubStyles.join( "," ) );
+      setQueryItem( url, "FORMAT", mImageMimeType );
+      setQueryItem( url, crsKey, mImageCrs );
 
-        if ( mDpi != -1 )
+      if ( mTiled )
+      {
+        setQueryItem( url, "TILED", "true" );
+      }
+
+      if ( mDpi != -1 )
+      {
+        if ( mDpiMode & dpiQGIS )
+          setQueryItem( url, "DPI", QString::number( mDpi ) );
+        if ( mDpiMode & dpiUMN )
+          setQueryItem( url, "MAP_RESOLUTION", QString::number( mDpi ) );
+        if ( mDpiMode & dpiGeoServer )
+          setQueryItem( url, "FORMAT_OPTIONS", QString( "dpi:%1" ).arg( mDpi ) );
+      }
+
+      if ( mImageMimeType == "image/x-jpegorpng" ||
+           ( !mImageMimeType.contains( "jpeg", Qt::CaseInsensitive ) &&
+             !mImageMimeType.contains( "jpg", Qt::CaseInsensitive ) ) )
+      {
+        setQueryItem( url, "TRANSPARENT", "TRUE" );  // some servers giving error for 'true' (lowercase)
+      }
+
+      int i = 0;
+      for ( int row = row0; row <= row1; row++ )
+      {
+        for ( int col = col0; col <= col1; col++ )
         {
-          if ( mDpiMode & dpiQGIS )
-            setQueryItem( url, "DPI", QString::number( mDpi ) );
-          if ( mDpiMode & dpiUMN )
-            setQueryItem( url, "MAP_RESOLUTION", QString::number( mDpi ) );
-          if ( mDpiMode & dpiGeoServer )
-            setQueryItem( url, "FORMAT_OPTIONS", QString( "dpi:%1" ).arg( mDpi ) );
+          QString turl;
+          turl += url.toString();
+          turl += QString( changeXY ? "&BBOX=%2,%1,%4,%3" : "&BBOX=%1,%2,%3,%4" )
+                  .arg( qgsDoubleToString( tm->topLeft.x() +         col * twMap /* + twMap * 0.001 */ ) )
+                  .arg( qgsDoubleToString( tm->topLeft.y() - ( row + 1 ) * thMap /* - thMap * 0.001 */ ) )
+                  .arg( qgsDoubleToString( tm->topLeft.x() + ( col + 1 ) * twMap /* - twMap * 0.001 */ ) )
+                  .arg( qgsDoubleToString( tm->topLeft.y() -         row * thMap /* + thMap * 0.001 */ ) );
+
+          requests << TileRequest( turl, QRectF( tm->topLeft.x() + col * twMap, tm->topLeft.y() - ( row + 1 ) * thMap, twMap, thMap ), i++ );
         }
+      }
+    }
+    break;
+
+    case WMTS:
+    {
+      if ( !getTileUrl().isNull() )
+      {
+        // KVP
+        QUrl url( mIgnoreGetMapUrl ? mBaseUrl : getTileUrl() );
 
-        if ( mImageMimeType == "image/x-jpegorpng" ||
-             ( !mImageMimeType.contains( "jpeg", Qt::CaseInsensitive ) &&
-               !mImageMimeType.contains( "jpg", Qt::CaseInsensitive ) ) )
+        // compose static request arguments.
+        setQueryItem( url, "SERVICE", "WMTS" );
+        setQueryItem( url, "REQUEST", "GetTile" );
+        setQueryItem( url, "VERSION", mCapabilities.version );
+        setQueryItem( url, "LAYER", mActiveSubLayers[0] );
+        setQueryItem( url, "STYLE", mActiveSubStyles[0] );
+        setQueryItem( url, "FORMAT", mImageMimeType );
+        setQueryItem( url, "TILEMATRIXSET", mTileMatrixSet->identifier );
+        setQueryItem( url, "TILEMATRIX", tm->identifier );
+
+        for ( QHash<QString, QString>::const_iterator it = mTileDimensionValues.constBegin(); it != mTileDimensionValues.constEnd(); ++it )
         {
-          setQueryItem( url, "TRANSPARENT", "TRUE" );  // some servers giving error for 'true' (lowercase)
+          setQueryItem( url, it.key(), it.value() );
         }
 
+        url.removeQueryItem( "TILEROW" );
+        url.removeQueryItem( "TILECOL" );
+
         int i = 0;
         for ( int row = row0; row <= row1; row++ )
         {
@@ -924,160 +1057,170 @@ QImage *QgsWmsProvider::draw( QgsRectangle  const &viewExtent, int pixelWidth, i
           {
             QString turl;
             turl += url.toString();
-            turl += QString( changeXY ? "&BBOX=%2,%1,%4,%3" : "&BBOX=%1,%2,%3,%4" )
-                    .arg( qgsDoubleToString( tm->topLeft.x() +         col * twMap /* + twMap * 0.001 */ ) )
-                    .arg( qgsDoubleToString( tm->topLeft.y() - ( row + 1 ) * thMap /* - thMap * 0.001 */ ) )
-                    .arg( qgsDoubleToString( tm->topLeft.x() + ( col + 1 ) * twMap /* - twMap * 0.001 */ ) )
-                    .arg( qgsDoubleToString( tm->topLeft.y() -         row * thMap /* + thMap * 0.001 */ ) );
-
-            QNetworkRequest request( turl );
-            setAuthorization( request );
-            QgsDebugMsg( QString( "tileRequest %1 %2/%3 (%4,%5): %6" ).arg( mTileReqNo ).arg( i++ ).arg( n ).arg( row ).arg( col ).arg( turl ) );
-            request.setAttribute( QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferCache );
-            request.setAttribute( QNetworkRequest::CacheSaveControlAttribute, true );
-            request.setAttribute( static_cast<QNetworkRequest::Attribute>( TileReqNo ), mTileReqNo );
-            request.setAttribute( static_cast<QNetworkRequest::Attribute>( TileIndex ), i );
-            request.setAttribute( static_cast<QNetworkRequest::Attribute>( TileRect ),
-                                  QRectF( tm->topLeft.x() + col * twMap, tm->topLeft.y() - ( row + 1 ) * thMap, twMap, thMap ) );
-            request.setAttribute( static_cast<QNetworkRequest::Attribute>( TileRetry ), 0 );
-
-            QgsDebugMsg( QString( "gettile: %1" ).arg( turl ) );
-            QNetworkReply *reply = QgsNetworkAccessManager::instance()->get( request );
-            mTileReplies << reply;
-            connect( reply, SIGNAL( finished() ), this, SLOT( tileReplyFinished() ) );
+            turl += QString( "&TILEROW=%1&TILECOL=%2" ).arg( row ).arg( col );
+
+            requests << TileRequest( turl, QRectF( tm->topLeft.x() + col * twMap, tm->topLeft.y() - ( row + 1 ) * thMap, twMap, thMap ), i++ );
           }
         }
       }
-      break;
-
-      case WMTS:
+      else
       {
-        if ( !getTileUrl().isNull() )
-        {
-          // KVP
-          QUrl url( mIgnoreGetMapUrl ? mBaseUrl : getTileUrl() );
-
-          // compose static request arguments.
-          setQueryItem( url, "SERVICE", "WMTS" );
-          setQueryItem( url, "REQUEST", "GetTile" );
-          setQueryItem( url, "VERSION", mCapabilities.version );
-          setQueryItem( url, "LAYER", mActiveSubLayers[0] );
-          setQueryItem( url, "STYLE", mActiveSubStyles[0] );
-          setQueryItem( url, "FORMAT", mImageMimeType );
-          setQueryItem( url, "TILEMATRIXSET", mTileMatrixSet->identifier );
-          setQueryItem( url, "TILEMATRIX", tm->identifier );
-
-          for ( QHash<QString, QString>::const_iterator it = mTileDimensionValues.constBegin(); it != mTileDimensionValues.constEnd(); ++it )
-          {
-            setQueryItem( url, it.key(), it.value() );
-          }
+        // REST
+        QString url = mTileLayer->getTileURLs[ mImageMimeType ];
 
-          url.removeQueryItem( "TILEROW" );
-          url.removeQueryItem( "TILECOL" );
+        url.replace( "{style}", mActiveSubStyles[0], Qt::CaseInsensitive );
+        url.replace( "{tilematrixset}", mTileMatrixSet->identifier, Qt::CaseInsensitive );
+        url.replace( "{tilematrix}", tm->identifier, Qt::CaseInsensitive );
 
-          int i = 0;
-          for ( int row = row0; row <= row1; row++ )
-          {
-            for ( int col = col0; col <= col1; col++ )
-            {
-              QString turl;
-              turl += url.toString();
-              turl += QString( "&TILEROW=%1&TILECOL=%2" ).arg( row ).arg( col );
-
-              QNetworkRequest request( turl );
-              setAuthorization( request );
-              QgsDebugMsg( QString( "tileRequest %1 %2/%3 (%4,%5): %6" ).arg( mTileReqNo ).arg( i++ ).arg( n ).arg( row ).arg( col ).arg( turl ) );
-              request.setAttribute( QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferCache );
-              request.setAttribute( QNetworkRequest::CacheSaveControlAttribute, true );
-              request.setAttribute( static_cast<QNetworkRequest::Attribute>( TileReqNo ), mTileReqNo );
-              request.setAttribute( static_cast<QNetworkRequest::Attribute>( TileIndex ), i );
-              request.setAttribute( static_cast<QNetworkRequest::Attribute>( TileRect ),
-                                    QRectF( tm->topLeft.x() + col * twMap, tm->topLeft.y() - ( row + 1 ) * thMap, twMap, thMap ) );
-              request.setAttribute( static_cast<QNetworkRequest::Attribute>( TileRetry ), 0 );
-
-              QgsDebugMsg( QString( "gettile: %1" ).arg( turl ) );
-              QNetworkReply *reply = QgsNetworkAccessManager::instance()->get( request );
-              mTileReplies << reply;
-              connect( reply, SIGNAL( finished() ), this, SLOT( tileReplyFinished() ) );
-            }
-          }
-        }
-        else
+        for ( QHash<QString, QString>::const_iterator it = mTileDimensionValues.constBegin(); it != mTileDimensionValues.constEnd(); ++it )
         {
-          // REST
-          QString url = mTileLayer->getTileURLs[ mImageMimeType ];
-
-          url.replace( "{style}", mActiveSubStyles[0], Qt::CaseInsensitive );
-          url.replace( "{tilematrixset}", mTileMatrixSet->identifier, Qt::CaseInsensitive );
-          url.replace( "{tilematrix}", tm->identifier, Qt::CaseInsensitive );
+          url.replace( "{" + it.key() + "}", it.value(), Qt::CaseInsensitive );
+        }
 
-          for ( QHash<QString, QString>::const_iterator it = mTileDimensionValues.constBegin(); it != mTileDimensionValues.constEnd(); ++it )
+        int i = 0;
+        for ( int row = row0; row <= row1; row++ )
+        {
+          for ( int col = col0; col <= col1; col++ )
           {
-            url.replace( "{" + it.key() + "}", it.value(), Qt::CaseInsensitive );
-          }
+            QString turl( url );
+            turl.replace( "{tilerow}", QString::number( row ), Qt::CaseInsensitive );
+            turl.replace( "{tilecol}", QString::number( col ), Qt::CaseInsensitive );
 
-          int i = 0;
-          for ( int row = row0; row <= row1; row++ )
-          {
-            for ( int col = col0; col <= col1; col++ )
-            {
-              QString turl( url );
-              turl.replace( "{tilerow}", QString::number( row ), Qt::CaseInsensitive );
-              turl.replace( "{tilecol}", QString::number( col ), Qt::CaseInsensitive );
-
-              QNetworkRequest request( turl );
-              setAuthorization( request );
-              QgsDebugMsg( QString( "tileRequest %1 %2/%3 (%4,%5): %6" ).arg( mTileReqNo ).arg( i++ ).arg( n ).arg( row ).arg( col ).arg( turl ) );
-              request.setAttribute( QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferCache );
-              request.setAttribute( QNetworkRequest::CacheSaveControlAttribute, true );
-              request.setAttribute( static_cast<QNetworkRequest::Attribute>( TileReqNo ), mTileReqNo );
-              request.setAttribute( static_cast<QNetworkRequest::Attribute>( TileIndex ), i );
-              request.setAttribute( static_cast<QNetworkRequest::Attribute>( TileRect ),
-                                    QRectF( tm->topLeft.x() + col * twMap, tm->topLeft.y() - ( row + 1 ) * thMap, twMap, thMap ) );
-              request.setAttribute( static_cast<QNetworkRequest::Attribute>( TileRetry ), 0 );
-
-              QgsDebugMsg( QString( "gettile: %1" ).arg( turl ) );
-              QNetworkReply *reply = QgsNetworkAccessManager::instance()->get( request );
-              mTileReplies << reply;
-              connect( reply, SIGNAL( finished() ), this, SLOT( tileReplyFinished() ) );
-            }
+            requests << TileRequest( turl, QRectF( tm->topLeft.x() + col * twMap, tm->topLeft.y() - ( row + 1 ) * thMap, twMap, thMap ), i++ );
           }
         }
       }
+    }
+    break;
+
+    default:
+      QgsDebugMsg( QString( "unexpected tile mode %1" ).arg( tileMode ) );
       break;
+  }
+}
+
+void QgsWmsProvider::sendTileRequests( const TileRequests &requests, bool prefetch )
+{
+  foreach ( const TileRequest &r, requests )
+  {
+    QNetworkRequest request( r.url );
+    setAuthorization( request );
+    request.setAttribute( QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferCache );
+    request.setAttribute( QNetworkRequest::CacheSaveControlAttribute, true );
+    request.setAttribute( static_cast<QNetworkRequest::Attribute>( TileReqNo ), mTileReqNo );
+    request.setAttribute( static_cast<QNetworkRequest::Attribute>( TileIndex ), r.index );
+    request.setAttribute( static_cast<QNetworkRequest::Attribute>( TileRect ), r.rect );
+    request.setAttribute( static_cast<QNetworkRequest::Attribute>( TileRetry ), 0 );
+    request.setAttribute( static_cast<QNetworkRequest::Attribute>( TilePrefetch ), prefetch );
+
+    QgsDebugMsg( QString( "%1tileRequest %2 %3/%4: %5" )
+                 .arg( prefetch ? "prefetch " : "" )
+                 .arg( mTileReqNo ).arg( r.index ).arg( requests.size() )
+                 .arg( r.url.toString() ) );
+    QNetworkReply *reply = QgsNetworkAccessManager::instance()->get( request );
+    if ( prefetch )
+      mPrefetchReplies << reply;
+    else
+      mTileReplies << reply;
+    connect( reply, SIGNAL( finished() ), this, SLOT( tileReplyFinished() ) );
+  }
+}
 
-      default:
-        QgsDebugMsg( QString( "unexpected tile mode %1" ).arg( mTileLayer->tileMode ) );
-        return mCachedImage;
-        break;
+void QgsWmsProvider::prefetchTiles()
+{
+  TileRequests requests;
+  foreach ( const TileRequest &r, mPrefetchRequests )
+  {
+    QImage image;
+    if ( !QgsTileCache::tile( r.url, image ) )
+    {
+      requests << r;
     }
+  }
+  mPrefetchRequests.clear();
 
-    emit statusChanged( tr( "Getting tiles." ) );
+  sendTileRequests( requests, true );
+}
 
-    mWaiting = true;
+void QgsWmsProvider::drawTile( const QRectF &tileRect, const QImage &image, const QRectF &clipRect )
+{
+  double cr = mCachedViewExtent.width() / mCachedViewWidth;
 
-    QTime t;
-    t.start();
+  QRectF dst(( tileRect.left() - mCachedViewExtent.xMinimum() ) / cr,
+             ( mCachedViewExtent.yMaximum() - tileRect.bottom() ) / cr,
+             tileRect.width() / cr,
+             tileRect.height() / cr );
 
-    // draw everything that is retrieved within a second
-    // and the rest asynchronously
-    while ( !mTileReplies.isEmpty() && ( !bkLayerCaching || t.elapsed() < WMS_THRESHOLD ) )
-    {
-      QCoreApplication::processEvents( QEventLoop::ExcludeUserInputEvents, WMS_THRESHOLD );
-    }
+  QPainter p( mCachedImage );
+  if ( mSmoothPixmapTransform )
+    p.setRenderHint( QPainter::SmoothPixmapTransform, true );
 
-    mWaiting = false;
+  if ( !clipRect.isNull() )
+  {
+    p.setClipRect( QRectF(( clipRect.left() - mCachedViewExtent.xMinimum() ) / cr,
+                          ( mCachedViewExtent.yMaximum() - clipRect.bottom() ) / cr,
+                          clipRect.width() / cr,
+                          clipRect.height() / cr ) );
+  }
 
-#ifdef QGISDEBUG
-    emit statusChanged( tr( "%n tile requests in background", "tile request count", mTileReplies.count() )
-                        + tr( ", %n cache hits", "tile cache hits", mCacheHits )
-                        + tr( ", %n cache misses.", "tile cache missed", mCacheMisses )
-                        + tr( ", %n errors.", "errors", mErrors )
-                      );
-#endif
+  p.drawImage( dst, image );
+}
+
+void QgsWmsProvider::drawOtherResTiles( double tres, enum QgsTileMode tileMode, bool changeXY, const QString &crsKey, const TileRequests &missing )
+{
+  QMap<double, QgsWmtsTileMatrix> &m = mTileMatrixSet->tileMatrices;
+
+  QList<QRectF> uncovered;
+  foreach ( const TileRequest &r, missing )
+  {
+    uncovered << r.rect;
   }
 
-  return mCachedImage;
+  // walk up to the lower resolutions (larger tiles)
+  QMap<double, QgsWmtsTileMatrix>::const_iterator it = m.upperBound( tres );
+  for ( ; it != m.constEnd() && !uncovered.isEmpty(); ++it )
+  {
+    const QgsWmtsTileMatrix *tm = &it.value();
+    double twMap = tm->tileWidth * it.key();
+    double thMap = tm->tileHeight * it.key();
+
+    QList<QRectF>::iterator rIt = uncovered.begin();
+    while ( rIt != uncovered.end() )
+    {
+      // the tiles of this resolution covering the missing tile (shrunk a bit to not pick the neighbours)
+      double dx = rIt->width() * 0.01;
+      double dy = rIt->height() * 0.01;
+      int col0 = qBound( 0, ( int ) floor(( rIt->left() + dx - tm->topLeft.x() ) / twMap ), tm->matrixWidth - 1 );
+      int col1 = qBound( 0, ( int ) floor(( rIt->right() - dx - tm->topLeft.x() ) / twMap ), tm->matrixWidth - 1 );
+      int row0 = qBound( 0, ( int ) floor(( tm->topLeft.y() - rIt->bottom() + dy ) / thMap ), tm->matrixHeight - 1 );
+      int row1 = qBound( 0, ( int ) floor(( tm->topLeft.y() - rIt->top() - dy ) / thMap ), tm->matrixHeight - 1 );
+
+      TileRequests requests;
+      createTileRequests( tm, it.key(), tileMode, col0, row0, col1, row1, changeXY, crsKey, requests );
+
+      QList<QImage> images;
+      foreach ( const TileRequest &r, requests )
+      {
+        QImage image;
+        if ( !QgsTileCache::tile( r.url, image ) )
+          break;
+        images << image;
+      }
+
+      if ( !requests.isEmpty() && images.size() == requests.size() )
+      {
+        for ( int i = 0; i < requests.size(); ++i )
+        {
+          drawTile( requests[i].rect, images[i], *rIt );
+        }
+        rIt = uncovered.erase( rIt );
+      }
+      else
+      {
+        ++rIt;
+      }
+    }
+  }
 }
 
 void QgsWmsProvider::readBlock( int bandNo, QgsRectangle  const & viewExtent, int pixelWidth, int pixelHeight, void *block )
@@ -1148,7 +1291,10 @@ void QgsWmsProvider::repeatTileRequest( QNetworkRequest const &oldRequest )
   request.setAttribute( static_cast<QNetworkRequest::Attribute>( TileRetry ), retry );
 
   QNetworkReply *reply = QgsNetworkAccessManager::instance()->get( request );
-  mTileReplies << reply;
+  if ( request.attribute( static_cast<QNetworkRequest::Attribute>( TilePrefetch ) ).toBool() )
+    mPrefetchReplies << reply;
+  else
+    mTileReplies << reply;
   connect( reply, SIGNAL( finished() ), this, SLOT( tileReplyFinished() ) );
 }
 
@@ -1198,6 +1344,8 @@ void QgsWmsProvider::tileReplyFinished()
   int tileReqNo = reply->request().attribute( static_cast<QNetworkRequest::Attribute>( TileReqNo ) ).toInt();
   int tileNo = reply->request().attribute( static_cast<QNetworkRequest::Attribute>( TileIndex ) ).toInt();
   QRectF r = reply->request().attribute( static_cast<QNetworkRequest::Attribute>( TileRect ) ).toRectF();
+  bool prefetch = reply->request().attribute( static_cast<QNetworkRequest::Attribute>( TilePrefetch ) ).toBool();
+  QList<QNetworkReply*> &replies = prefetch ? mPrefetchReplies : mTileReplies;
 
 #ifdef QGISDEBUG
   int retry = reply->request().attribute( static_cast<QNetworkRequest::Attribute>( TileRetry ) ).toInt();
@@ -1224,13 +1372,14 @@ void QgsWmsProvider::tileReplyFinished()
       request.setAttribute( static_cast<QNetworkRequest::Attribute>( TileIndex ), tileNo );
       request.setAttribute( static_cast<QNetworkRequest::Attribute>( TileRect ), r );
       request.setAttribute( static_cast<QNetworkRequest::Attribute>( TileRetry ), 0 );
+      request.setAttribute( static_cast<QNetworkRequest::Attribute>( TilePrefetch ), prefetch );
 
-      mTileReplies.removeOne( reply );
+      replies.removeOne( reply );
       reply->deleteLater();
 
       QgsDebugMsg( QString( "redirected gettile: %1" ).arg( redirect.toString() ) );
       reply = QgsNetworkAccessManager::instance()->get( request );
-      mTileReplies << reply;
+      replies << reply;
 
       connect( reply, SIGNAL( finished() ), this, SLOT( tileReplyFinished() ) );
 
@@ -1244,7 +1393,7 @@ void QgsWmsProvider::tileReplyFinished()
 
       showMessageBox( tr( "Tile request error" ), tr( "Status: %1\nReason phrase: %2" ).arg( status.toInt() ).arg( phrase.toString() ) );
 
-      mTileReplies.removeOne( reply );
+      replies.removeOne( reply );
       reply->deleteLater();
 
       return;
@@ -1279,33 +1428,36 @@ void QgsWmsProvider::tileReplyFinished()
 #endif
       }
 
-      mTileReplies.removeOne( reply );
+      replies.removeOne( reply );
       reply->deleteLater();
 
       return;
     }
 
-    // only take results from current request number
-    if ( mTileReqNo == tileReqNo )
-    {
-      double cr = mCachedViewExtent.width() / mCachedViewWidth;
+    QgsDebugMsg( QString( "tile reply: length %1" ).arg( reply->bytesAvailable() ) );
 
-      QRectF dst(( r.left() - mCachedViewExtent.xMinimum() ) / cr,
-                 ( mCachedViewExtent.yMaximum() - r.bottom() ) / cr,
-                 r.width() / cr,
-                 r.height() / cr );
+    QImage myLocalImage = QImage::fromData( reply->readAll() );
 
-      QgsDebugMsg( QString( "tile reply: length %1" ).arg( reply->bytesAvailable() ) );
-
-      QImage myLocalImage = QImage::fromData( reply->readAll() );
+    if ( !myLocalImage.isNull() )
+    {
+      // late and prefetched tiles are not drawn, but kept for the next redraw
+      QgsTileCache::insertTile( reply->request().url(), myLocalImage );
 
-      if ( !myLocalImage.isNull() )
+      // only take results from current request number
+      if ( prefetch )
       {
-        QPainter p( mCachedImage );
-        if ( mSmoothPixmapTransform )
-          p.setRenderHint( QPainter::SmoothPixmapTransform, true );
-        p.drawImage( dst, myLocalImage );
+        QgsDebugMsg( QString( "Prefetched [%1]" ).arg( reply->url().toString() ) );
+      }
+      else if ( mTileReqNo == tileReqNo )
+      {
+        drawTile( r, myLocalImage );
 #if 0
+        double cr = mCachedViewExtent.width() / mCachedViewWidth;
+        QRectF dst(( r.left() - mCachedViewExtent.xMinimum() ) / cr,
+                   ( mCachedViewExtent.yMaximum() - r.bottom() ) / cr,
+                   r.width() / cr,
+                   r.height() / cr );
+        QPainter p( mCachedImage );
         myLocalImage.save( QString( "%1/%2-tile-%3.png" ).arg( QDir::tempPath() ).arg( mTileReqNo ).arg( tileNo ) );
         p.drawRect( dst ); // show tile bounds
         p.drawText( dst, Qt::AlignCenter, QString( "(%1)\n%2,%3\n%4,%5\n%6x%7" )
@@ -1317,20 +1469,31 @@ void QgsWmsProvider::tileReplyFinished()
       }
       else
       {
-        QgsMessageLog::logMessage( tr( "Returned image is flawed [Content-Type:%1; URL: %2]" )
-                                   .arg( contentType ).arg( reply->url().toString() ), tr( "WMS" ) );
-
-        repeatTileRequest( reply->request() );
+        QgsDebugMsg( QString( "Reply too late [%1]" ).arg( reply->url().toString() ) );
       }
     }
     else
     {
-      QgsDebugMsg( QString( "Reply too late [%1]" ).arg( reply->url().toString() ) );
+      QgsMessageLog::logMessage( tr( "Returned image is flawed [Content-Type:%1; URL: %2]" )
+                                 .arg( contentType ).arg( reply->url().toString() ), tr( "WMS" ) );
+
+      repeatTileRequest( reply->request() );
     }
 
-    mTileReplies.removeOne( reply );
+    replies.removeOne( reply );
     reply->deleteLater();
 
+    if ( prefetch )
+    {
+      return;
+    }
+
+    if ( mTileReplies.isEmpty() && !mPrefetchRequests.isEmpty() )
+    {
+      // the view is complete, use the idle time to fetch the surrounding tiles
+      QTimer::singleShot( 0, this, SLOT( prefetchTiles() ) );
+    }
+
     if ( !mWaiting )
     {
       QgsDebugMsg( "emit dataChanged()" );
@@ -1343,7 +1506,7 @@ void QgsWmsProvider::tileReplyFinished()
 
     repeatTileRequest( reply->request() );
 
-    mTileReplies.removeOne( reply );
+    replies.removeOne( reply );
     reply->deleteLater();
   }
 
@@ -29,6 +29,7 @@
 #include <QDomElement>
 #include <QHash>
 #include <QMap>
+#include <QRectF>
 #include <QVector>
 #include <QUrl>
 
@@ -441,6 +442,7 @@ enum QgsWmsTileAttribute
   TileIndex = QNetworkRequest::User + 1,
   TileRect  = QNetworkRequest::User + 2,
   TileRetry = QNetworkRequest::User + 3,
+  TilePrefetch = QNetworkRequest::User + 4,
 };
 
 enum QgsWmsDpiMode
@@ -772,6 +774,8 @@ class QgsWmsProvider : public QgsRasterDataProvider
     void capabilitiesReplyProgress( qint64, qint64 );
     void identifyReplyFinished();
     void tileReplyFinished();
+    //! request the tiles around the last view (when it is complete)
+    void prefetchTiles();
     void getLegendGraphicReplyFinished();
     void getLegendGraphicReplyProgress( qint64, qint64 );
 
@@ -792,6 +796,34 @@ class QgsWmsProvider : public QgsRasterDataProvider
      */
     void repeatTileRequest( QNetworkRequest const &oldRequest );
 
+    //! a tile of the current tile matrix
+    struct TileRequest
+    {
+      TileRequest( const QUrl &u, const QRectF &r, int i ) : url( u ), rect( r ), index( i ) {}
+      QUrl url;   //!< also the key of the tile in QgsTileCache
+      QRectF rect;
+      int index;
+    };
+    typedef QList<TileRequest> TileRequests;
+
+    //! append the requests for the tiles from col0/row0 to col1/row1 of the tile matrix with resolution tres
+    void createTileRequests( const QgsWmtsTileMatrix *tm, double tres, enum QgsTileMode tileMode,
+                             int col0, int row0, int col1, int row1,
+                             bool changeXY, const QString &crsKey, TileRequests &requests );
+
+    //! start the network requests for the tiles, prefetched tiles are cached but not drawn
+    void sendTileRequests( const TileRequests &requests, bool prefetch );
+
+    //! draw a tile with map coordinates tileRect into mCachedImage, optionally clipped to clipRect
+    void drawTile( const QRectF &tileRect, const QImage &image, const QRectF &clipRect = QRectF() );
+
+    /**
+     * \brief fill the areas of missing tiles with cached tiles of lower resolutions
+     *
+     * The missing tiles are still requested, but the view is not empty until they arrive.
+     */
+    void drawOtherResTiles( double tres, enum QgsTileMode tileMode, bool changeXY, const QString &crsKey, const TileRequests &missing );
+
     /**
      * \brief Retrieve and parse the (cached) Capabilities document from the server
      *
@@ -1051,6 +1083,12 @@ class QgsWmsProvider : public QgsRasterDataProvider
      */
     QList<QNetworkReply*> mTileReplies;
 
+    /**
+     * Running prefetch requests and the tiles to prefetch once the view is complete
+     */
+    QList<QNetworkReply*> mPrefetchReplies;
+    TileRequests mPrefetchRequests;
+
     /**
      * The reply to the capabilities request
      */
@@ -81,6 +81,7 @@ void usage( std::string const & appName )
             << "\t[--configpath path]\tuse the given path for all user configuration\n"
             << "\t[--prefix path]\tpath to a different build of qgis, may be used to test old versions\n"
             << "\t[--quality]\trenderer hint(s), comma separated, possible values: Antialiasing,TextAntialiasing,SmoothPixmapTransform,NonCosmeticDefaultPen\n"
+            << "\t[--labelcache on|off]\tshare font metrics and text outlines among labels, default on\n"
             << "\t[--help]\t\tthis text\n\n"
             << "  FILES:\n"
             << "    Files specified on the command line can include rasters,\n"
@@ -135,6 +136,7 @@ int main( int argc, char *argv[] )
   int mySnapshotWidth = 800;
   int mySnapshotHeight = 600;
   QString myQuality = "";
+  bool myLabelTextCache = true;
 
   // This behaviour will set initial extent of map canvas, but only if
   // there are no command line arguments. This gives a usable map
@@ -173,13 +175,14 @@ int main( int argc, char *argv[] )
       {"configpath", required_argument, 0, 'c'},
       {"prefix", required_argument, 0, 'r'},
       {"quality", required_argument, 0, 'q'},
+      {"labelcache", required_argument, 0, 'b'},
       {0, 0, 0, 0}
     };
 
     /* getopt_long stores the option index here. */
     int option_index = 0;
 
-    optionChar = getopt_long( argc, argv, "islwhpeocrq",
+    optionChar = getopt_long( argc, argv, "islwhpeocrqb",
                               long_options, &option_index );
 
     /* Detect the end of the options. */
@@ -242,6 +245,10 @@ int main( int argc, char *argv[] )
         myQuality = optarg;
         break;
 
+      case 'b':
+        myLabelTextCache = QString( optarg ) != "off";
+        break;
+
       case '?':
         usage( argv[0] );
         return 2;   // XXX need standard exit codes
@@ -322,6 +329,10 @@ int main( int argc, char *argv[] )
     {
       myQuality = argv[++i];
     }
+    else if ( i + 1 < argc && ( arg == "--labelcache" || arg == "-b" ) )
+    {
+      myLabelTextCache = QString( argv[++i] ) != "off";
+    }
     else
     {
       myFileList.append( QDir::convertSeparators( QFileInfo( QFile::decodeName( argv[i] ) ).absoluteFilePath() ) );
@@ -476,6 +487,8 @@ int main( int argc, char *argv[] )
     qbench->setRenderHints( hints );
   }
 
+  qbench->setLabelTextCache( myLabelTextCache );
+
   /////////////////////////////////////////////////////////////////////
   // autoload any file names that were passed in on the command line
   /////////////////////////////////////////////////////////////////////
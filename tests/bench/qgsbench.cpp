@@ -117,7 +117,7 @@ int getrusage( int who, struct rusage * rusage )
 #endif
 
 QgsBench::QgsBench( int theWidth, int theHeight, int theIterations )
-    : QObject(), mWidth( theWidth ), mHeight( theHeight ), mIterations( theIterations ), mSetExtent( false )
+    : QObject(), mWidth( theWidth ), mHeight( theHeight ), mIterations( theIterations ), mSetExtent( false ), mLabelTextCache( true )
 {
   QgsDebugMsg( "entered" );
 
@@ -193,7 +193,11 @@ void QgsBench::render()
   mMapRenderer->setProjectionsEnabled( true );
 
   // Enable labeling
-  mMapRenderer->setLabelingEngine( new QgsPalLabeling() );
+  QgsPalLabeling *labeling = new QgsPalLabeling();
+  labeling->setUsingTextCache( mLabelTextCache );
+  // every iteration renders the same extent, labels have to be placed each time
+  labeling->setUsingPlacementCache( false );
+  mMapRenderer->setLabelingEngine( labeling );
 
   mImage = new QImage( mWidth, mHeight, QImage::Format_ARGB32_Premultiplied );
   mImage->fill( 0 );
@@ -213,6 +217,7 @@ void QgsBench::render()
 
   mLogMap.insert( "iterations", mTimes.size() );
   mLogMap.insert( "revision", QGSVERSION );
+  mLogMap.insert( "labelcache", QString( mLabelTextCache ? "on" : "off" ) );
 
   // Calc stats: user, sys, total
   double min[4], max[4];
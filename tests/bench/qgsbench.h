@@ -58,6 +58,9 @@ class QgsBench :  public QObject
 
     void  setRenderHints( QPainter::RenderHints hints ) { mRendererHints = hints; }
 
+    // share font metrics and text outlines among labels
+    void setLabelTextCache( bool use ) { mLabelTextCache = use; }
+
   public slots:
     void readProject( const QDomDocument &doc );
 
@@ -77,6 +80,8 @@ class QgsBench :  public QObject
 
     QPainter::RenderHints mRendererHints;
 
+    bool mLabelTextCache;
+
     // log map
     QMap<QString, QVariant> mLogMap;
 
@@ -0,0 +1,158 @@
+/***************************************************************************
+     testqgsninecellfilter.cpp
+     --------------------------------------
+    Date                 : January 2014
+    Copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <QDir>
+#include <QFile>
+#include <QtTest>
+
+#include <cmath>
+
+#include "qgsapplication.h"
+#include "qgsaspectfilter.h"
+#include "qgshillshadefilter.h"
+#include "qgsrasterblock.h"
+#include "qgsslopefilter.h"
+
+#include <gdal.h>
+
+static const int DEM_WIDTH = 41;
+static const int DEM_HEIGHT = 29;
+static const float DEM_NODATA = -32768;
+
+/** \ingroup UnitTests
+ * This is a unit test for the line and strip processing of the nine cell filters
+ */
+class TestQgsNineCellFilter: public QObject
+{
+    Q_OBJECT;
+  private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void init() {};
+    void cleanup() {};
+
+    void slope();
+    void aspect();
+    void hillshade();
+
+  private:
+    /**Compares the strips processed in parallel with a single thread and with processNineCellWindow for each cell*/
+    void compareWithCells( QgsNineCellFilter& filter );
+
+    QString mDemPath;
+    QVector<float> mDem;
+};
+
+void TestQgsNineCellFilter::initTestCase()
+{
+  QgsApplication::init();
+  QgsApplication::initQgis();
+  GDALAllRegister();
+
+  //a hill with a few nodata cells, also on the border
+  mDem.resize( DEM_WIDTH * DEM_HEIGHT );
+  for ( int i = 0; i < DEM_HEIGHT; ++i )
+  {
+    for ( int j = 0; j < DEM_WIDTH; ++j )
+    {
+      mDem[i * DEM_WIDTH + j] = 500 + 120 * sin( j / 7.0 ) * cos( i / 5.0 ) + 3 * i;
+    }
+  }
+  mDem[0] = DEM_NODATA;
+  mDem[5 * DEM_WIDTH + 17] = DEM_NODATA;
+  mDem[6 * DEM_WIDTH + 18] = DEM_NODATA;
+  mDem[14 * DEM_WIDTH + DEM_WIDTH - 1] = DEM_NODATA;
+  mDem[( DEM_HEIGHT - 1 ) * DEM_WIDTH + 9] = DEM_NODATA;
+
+  mDemPath = QDir::tempPath() + QDir::separator() + "qgis_test_ninecellfilter_dem.tif";
+  GDALDriverH driver = GDALGetDriverByName( "GTiff" );
+  QVERIFY( driver );
+  GDALDatasetH dataset = GDALCreate( driver, mDemPath.toLocal8Bit().constData(), DEM_WIDTH, DEM_HEIGHT, 1, GDT_Float32, NULL );
+  QVERIFY( dataset );
+  double geotransform[6] = { 600000, 25, 0, 200000, 0, -25 };
+  GDALSetGeoTransform( dataset, geotransform );
+  GDALRasterBandH band = GDALGetRasterBand( dataset, 1 );
+  GDALSetRasterNoDataValue( band, DEM_NODATA );
+  QCOMPARE( GDALRasterIO( band, GF_Write, 0, 0, DEM_WIDTH, DEM_HEIGHT, mDem.data(), DEM_WIDTH, DEM_HEIGHT, GDT_Float32, 0, 0 ), CE_None );
+  GDALClose( dataset );
+}
+
+void TestQgsNineCellFilter::cleanupTestCase()
+{
+  QFile::remove( mDemPath );
+}
+
+void TestQgsNineCellFilter::compareWithCells( QgsNineCellFilter& filter )
+{
+  filter.setThreadCount( 1 );
+  QgsRasterBlock* single = filter.processRasterToBlock( 0 );
+  QVERIFY( single );
+  filter.setThreadCount( 4 );
+  QgsRasterBlock* parallel = filter.processRasterToBlock( 0 );
+  QVERIFY( parallel );
+  QCOMPARE( parallel->width(), DEM_WIDTH );
+  QCOMPARE( parallel->height(), DEM_HEIGHT );
+
+  //the dem padded with one nodata cell on each side, like outside of the border
+  int paddedWidth = DEM_WIDTH + 2;
+  QVector<float> padded( paddedWidth * ( DEM_HEIGHT + 2 ), filter.inputNodataValue() );
+  for ( int i = 0; i < DEM_HEIGHT; ++i )
+  {
+    for ( int j = 0; j < DEM_WIDTH; ++j )
+    {
+      padded[( i + 1 ) * paddedWidth + j + 1] = mDem[i * DEM_WIDTH + j];
+    }
+  }
+
+  for ( int i = 0; i < DEM_HEIGHT; ++i )
+  {
+    float* above = padded.data() + i * paddedWidth + 1;
+    float* line = above + paddedWidth;
+    float* below = line + paddedWidth;
+    for ( int j = 0; j < DEM_WIDTH; ++j )
+    {
+      float expected = filter.processNineCellWindow( &above[j-1], &above[j], &above[j+1], &line[j-1], &line[j],
+                       &line[j+1], &below[j-1], &below[j], &below[j+1] );
+      double value = parallel->value( i, j );
+      QCOMPARE( value, single->value( i, j ) );
+      if ( qAbs( value - expected ) > 1e-4 * qMax( 1.0, qAbs( ( double )expected ) ) )
+      {
+        QFAIL( QString( "row %1 col %2: %3 instead of %4" ).arg( i ).arg( j ).arg( value ).arg( expected ).toLocal8Bit().constData() );
+      }
+    }
+  }
+  delete single;
+  delete parallel;
+}
+
+void TestQgsNineCellFilter::slope()
+{
+  QgsSlopeFilter filter( mDemPath, QString(), "GTiff" );
+  compareWithCells( filter );
+}
+
+void TestQgsNineCellFilter::aspect()
+{
+  QgsAspectFilter filter( mDemPath, QString(), "GTiff" );
+  compareWithCells( filter );
+}
+
+void TestQgsNineCellFilter::hillshade()
+{
+  QgsHillshadeFilter filter( mDemPath, QString(), "GTiff", 300, 40 );
+  compareWithCells( filter );
+}
+
+QTEST_MAIN( TestQgsNineCellFilter )
+#include "moc_testqgsninecellfilter.cxx"
@@ -0,0 +1,174 @@
+/***************************************************************************
+     testqgsrastercalculator.cpp
+     --------------------------------------
+    Date                 : January 2014
+    Copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <QDir>
+#include <QFile>
+#include <QtTest>
+
+#include <cfloat>
+#include <cmath>
+
+#include "qgsapplication.h"
+#include "qgsrastercalckernel.h"
+#include "qgsrastercalcnode.h"
+#include "qgsrastercalculator.h"
+#include "qgsrasterlayer.h"
+#include "qgsrastermatrix.h"
+
+static const int COUNT = 600;
+static const double NODATA_A = -9999;
+static const double NODATA_B = 255;
+
+/** \ingroup UnitTests
+ * This is a unit test for the raster calculator and its per pixel kernel
+ */
+class TestQgsRasterCalculator: public QObject
+{
+    Q_OBJECT;
+  private slots:
+    void initTestCase();
+    void cleanupTestCase() {};
+    void init() {};
+    void cleanup() {};
+
+    void kernelAndMatrix_data();
+    void kernelAndMatrix();
+    void unknownRaster();
+
+  private:
+    QVector<float> mA;
+    QVector<float> mB;
+};
+
+void TestQgsRasterCalculator::initTestCase()
+{
+  QgsApplication::init();
+  QgsApplication::initQgis();
+
+  //values with nodata, zeros, negative and fractional values. More than one run of the kernel
+  mA.resize( COUNT );
+  mB.resize( COUNT );
+  for ( int i = 0; i < COUNT; ++i )
+  {
+    mA[i] = ( i % 37 ) - 12.5f;
+    mB[i] = ( i % 11 ) - 3;
+  }
+  for ( int i = 0; i < COUNT; i += 29 )
+  {
+    mA[i] = NODATA_A;
+  }
+  for ( int i = 5; i < COUNT; i += 31 )
+  {
+    mB[i] = NODATA_B;
+  }
+}
+
+void TestQgsRasterCalculator::kernelAndMatrix_data()
+{
+  QTest::addColumn<QString>( "formula" );
+
+  QTest::newRow( "plus" ) << "a@1 + b@1";
+  QTest::newRow( "minus number" ) << "a@1 - 2.5";
+  QTest::newRow( "number minus" ) << "2.5 - b@1";
+  QTest::newRow( "mul" ) << "a@1 * b@1 * 3";
+  QTest::newRow( "div by zero" ) << "a@1 / b@1";
+  QTest::newRow( "number div" ) << "10 / b@1";
+  QTest::newRow( "pow" ) << "b@1 ^ 2 + a@1 ^ 0.5";
+  QTest::newRow( "negative pow" ) << "b@1 ^ -1";
+  QTest::newRow( "sqrt" ) << "sqrt( a@1 )";
+  QTest::newRow( "trigonometry" ) << "sin( a@1 ) * cos( b@1 ) + tan( a@1 / 10 ) - atan( b@1 )";
+  QTest::newRow( "inverse trigonometry" ) << "asin( b@1 / 10 ) + acos( b@1 / 10 )";
+  QTest::newRow( "sign" ) << "-( a@1 ) + -( b@1 * 2 )";
+  QTest::newRow( "comparisons" ) << "( a@1 > b@1 ) + ( a@1 < 0 ) * 2 + ( b@1 >= 1 ) * 4 + ( b@1 <= -1 ) * 8 + ( a@1 = -12.5 ) * 16 + ( b@1 != 0 ) * 32";
+  QTest::newRow( "logical" ) << "( a@1 > 0 AND b@1 > 0 ) OR b@1 = -3";
+  QTest::newRow( "numbers only" ) << "2 * 3 + 1";
+  QTest::newRow( "nested" ) << "( ( a@1 + 1 ) * ( b@1 - 1 ) ) / ( ( a@1 - 1 ) * ( b@1 + 2 ) ) + sqrt( b@1 * b@1 )";
+}
+
+void TestQgsRasterCalculator::kernelAndMatrix()
+{
+  QFETCH( QString, formula );
+
+  QString errorString;
+  QgsRasterCalcNode* node = QgsRasterCalcNode::parseRasterCalcString( formula, errorString );
+  QVERIFY2( node, errorString.toLocal8Bit().constData() );
+
+  //the fused kernel
+  QgsRasterCalcKernel kernel( node, QStringList() << "a@1" << "b@1", QVector<double>() << NODATA_A << NODATA_B );
+  QVERIFY( kernel.isValid() );
+  QVector<float> result( COUNT );
+  float outputNodata = -FLT_MAX;
+  kernel.calculate( QVector<const float*>() << mA.constData() << mB.constData(), result.data(), COUNT, outputNodata );
+
+  //the matrices
+  float* aData = new float[COUNT];
+  float* bData = new float[COUNT];
+  memcpy( aData, mA.constData(), COUNT * sizeof( float ) );
+  memcpy( bData, mB.constData(), COUNT * sizeof( float ) );
+  QgsRasterMatrix aMatrix( COUNT, 1, aData, NODATA_A );
+  QgsRasterMatrix bMatrix( COUNT, 1, bData, NODATA_B );
+  QMap<QString, QgsRasterMatrix*> matrices;
+  matrices.insert( "a@1", &aMatrix );
+  matrices.insert( "b@1", &bMatrix );
+  QgsRasterMatrix matrixResult;
+  QVERIFY( node->calculate( matrices, matrixResult ) );
+  delete node;
+
+  for ( int i = 0; i < COUNT; ++i )
+  {
+    float expected = matrixResult.isNumber() ? matrixResult.number() : matrixResult.data()[i];
+    if ( expected == matrixResult.nodataValue() )
+    {
+      expected = outputNodata;
+    }
+
+    bool equal = ( expected != expected && result[i] != result[i] ) // both NaN
+                 || qAbs( result[i] - expected ) <= 1e-5 * qMax( 1.0f, qAbs( expected ) );
+    if ( !equal )
+    {
+      QFAIL( QString( "pixel %1 (a = %2, b = %3): %4 instead of %5" ).arg( i ).arg( mA[i] ).arg( mB[i] )
+             .arg( result[i] ).arg( expected ).toLocal8Bit().constData() );
+    }
+  }
+}
+
+void TestQgsRasterCalculator::unknownRaster()
+{
+  QString rasterPath = QString( TEST_DATA_DIR ) + QDir::separator() + "raster" + QDir::separator() + "band1_float32_noct_epsg4326.tif";
+  QgsRasterLayer layer( rasterPath, "float32", "gdal" );
+  QVERIFY( layer.isValid() );
+
+  QgsRasterCalculatorEntry entry;
+  entry.ref = "a@1";
+  entry.raster = &layer;
+  entry.bandNumber = 1;
+  QVector<QgsRasterCalculatorEntry> entries;
+  entries << entry;
+
+  QString outputPath = QDir::tempPath() + QDir::separator() + "qgis_test_rastercalculator.tif";
+  QgsRasterCalculator valid( "a@1 * 2", outputPath, "GTiff", layer.extent(), layer.width(), layer.height(), entries );
+  QCOMPARE( valid.processCalculation(), 0 );
+
+  //a reference which is not in the entries is an input error, nothing is written
+  QFile::remove( outputPath );
+  QgsRasterCalculator unknown( "a@1 * b@1", outputPath, "GTiff", layer.extent(), layer.width(), layer.height(), entries );
+  QCOMPARE( unknown.processCalculation(), 2 );
+  QVERIFY( !QFile::exists( outputPath ) );
+
+  QgsRasterCalculator unparsable( "a@1 * (", outputPath, "GTiff", layer.extent(), layer.width(), layer.height(), entries );
+  QCOMPARE( unparsable.processCalculation(), 4 );
+}
+
+QTEST_MAIN( TestQgsRasterCalculator )
+#include "moc_testqgsrastercalculator.cxx"
@@ -14,9 +14,14 @@
  ***************************************************************************/
 
 #include <QDir>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
 #include <QtTest>
 
 #include "qgsapplication.h"
+#include "qgsgeometry.h"
+#include "qgsvectordataprovider.h"
 #include "qgsvectorlayer.h"
 #include "qgszonalstatistics.h"
 
@@ -33,6 +38,8 @@ class TestQgsZonalStatistics: public QObject
     void cleanup() {};
 
     void testStatistics();
+    void testAllStatistics();
+    void testStrips();
 
   private:
     QgsVectorLayer* mVectorLayer;
@@ -116,5 +123,116 @@ void TestQgsZonalStatistics::testStatistics()
   QCOMPARE( f.attribute( "myqgis2_me" ).toDouble(), 0.833333333333333 );
 }
 
+void TestQgsZonalStatistics::testAllStatistics()
+{
+  QgsZonalStatistics zs( mVectorLayer, mRasterPath, "s_", 1, QgsZonalStatistics::All );
+  QCOMPARE( zs.calculateStatistics( NULL ), 0 );
+
+  QgsFeature f;
+  QgsFeatureRequest request;
+  request.setFilterFid( 0 );
+  bool fetched = mVectorLayer->getFeatures( request ).nextFeature( f );
+  QVERIFY( fetched );
+  QCOMPARE( f.attribute( "s_count" ).toDouble(), 12.0 );
+  QCOMPARE( f.attribute( "s_sum" ).toDouble(), 8.0 );
+  QCOMPARE( f.attribute( "s_mean" ).toDouble(), 0.666666666666667 );
+  QCOMPARE( f.attribute( "s_median" ).toDouble(), 1.0 );
+  QCOMPARE( f.attribute( "s_stdev" ).toDouble(), 0.471404520791032 );
+  QCOMPARE( f.attribute( "s_min" ).toDouble(), 0.0 );
+  QCOMPARE( f.attribute( "s_max" ).toDouble(), 1.0 );
+  QCOMPARE( f.attribute( "s_majority" ).toDouble(), 1.0 );
+  QCOMPARE( f.attribute( "s_variety" ).toDouble(), 2.0 );
+
+  request.setFilterFid( 1 );
+  fetched = mVectorLayer->getFeatures( request ).nextFeature( f );
+  QVERIFY( fetched );
+  QCOMPARE( f.attribute( "s_count" ).toDouble(), 9.0 );
+  QCOMPARE( f.attribute( "s_sum" ).toDouble(), 5.0 );
+  QCOMPARE( f.attribute( "s_median" ).toDouble(), 1.0 );
+  QCOMPARE( f.attribute( "s_stdev" ).toDouble(), 0.496903994999953 );
+  QCOMPARE( f.attribute( "s_min" ).toDouble(), 0.0 );
+  QCOMPARE( f.attribute( "s_max" ).toDouble(), 1.0 );
+  QCOMPARE( f.attribute( "s_majority" ).toDouble(), 1.0 );
+  QCOMPARE( f.attribute( "s_variety" ).toDouble(), 2.0 );
+
+  request.setFilterFid( 2 );
+  fetched = mVectorLayer->getFeatures( request ).nextFeature( f );
+  QVERIFY( fetched );
+  QCOMPARE( f.attribute( "s_count" ).toDouble(), 6.0 );
+  QCOMPARE( f.attribute( "s_sum" ).toDouble(), 5.0 );
+  QCOMPARE( f.attribute( "s_median" ).toDouble(), 1.0 );
+  QCOMPARE( f.attribute( "s_stdev" ).toDouble(), 0.372677996249965 );
+  QCOMPARE( f.attribute( "s_min" ).toDouble(), 0.0 );
+  QCOMPARE( f.attribute( "s_max" ).toDouble(), 1.0 );
+  QCOMPARE( f.attribute( "s_majority" ).toDouble(), 1.0 );
+  QCOMPARE( f.attribute( "s_variety" ).toDouble(), 2.0 );
+}
+
+void TestQgsZonalStatistics::testStrips()
+{
+  //a raster of 40 rows with nodata cells, the default strip covers all of them
+  QString rasterPath = QDir::tempPath() + QDir::separator() + "zonal_strips.asc";
+  QFile rasterFile( rasterPath );
+  QVERIFY( rasterFile.open( QIODevice::WriteOnly | QIODevice::Truncate ) );
+  QTextStream rasterStream( &rasterFile );
+  rasterStream << "ncols 50\nnrows 40\nxllcorner 0\nyllcorner 0\ncellsize 1\nNODATA_value -9999\n";
+  for ( int row = 0; row < 40; ++row )
+  {
+    for ( int col = 0; col < 50; ++col )
+    {
+      rasterStream << (( row + col ) % 13 == 0 ? -9999 : ( row * 7 + col * 3 ) % 11 ) << " ";
+    }
+    rasterStream << "\n";
+  }
+  rasterFile.close();
+
+  //zones over several strips, with a hole and a zone smaller than a cell
+  QgsVectorLayer layer( "Polygon?field=id:integer", "zones", "memory" );
+  QVERIFY( layer.isValid() );
+  QStringList wkts;
+  wkts << "POLYGON((2.3 3.1, 20.7 5.2, 11.4 30.6, 2.3 3.1))"
+  << "POLYGON((15 15, 45 15, 45 38, 15 38, 15 15),(25 20, 35 20, 35 30, 25 30, 25 20))"
+  << "POLYGON((30.5 1.5, 48.2 2.5, 40.1 12.9, 30.5 1.5))"
+  << "POLYGON((0 0, 50 0, 50 40, 0 40, 0 0))"
+  << "POLYGON((8.2 7.2, 8.4 7.2, 8.4 7.4, 8.2 7.2))";
+  QgsFeatureList features;
+  for ( int i = 0; i < wkts.size(); ++i )
+  {
+    QgsFeature f( layer.pendingFields() );
+    f.setAttribute( 0, i );
+    f.setGeometry( QgsGeometry::fromWkt( wkts.at( i ) ) );
+    features << f;
+  }
+  QVERIFY( layer.dataProvider()->addFeatures( features ) );
+
+  //serial: one strip in one thread
+  QThreadPool::globalInstance()->setMaxThreadCount( 1 );
+  QgsZonalStatistics serial( &layer, rasterPath, "s_", 1, QgsZonalStatistics::All );
+  QCOMPARE( serial.calculateStatistics( NULL ), 0 );
+
+  //strips of three rows, the zones of a strip in parallel
+  QThreadPool::globalInstance()->setMaxThreadCount( qMax( 4, QThread::idealThreadCount() ) );
+  QgsZonalStatistics strips( &layer, rasterPath, "p_", 1, QgsZonalStatistics::All );
+  strips.setStripRows( 3 );
+  QCOMPARE( strips.calculateStatistics( NULL ), 0 );
+  QThreadPool::globalInstance()->setMaxThreadCount( QThread::idealThreadCount() );
+
+  QStringList names;
+  names << "count" << "sum" << "mean" << "median" << "stdev" << "min" << "max" << "majority" << "variety";
+  QgsFeatureIterator fit = layer.getFeatures();
+  QgsFeature f;
+  int nFeatures = 0;
+  while ( fit.nextFeature( f ) )
+  {
+    QVERIFY( f.attribute( "s_count" ).toDouble() > 0 );
+    for ( int i = 0; i < names.size(); ++i )
+    {
+      QCOMPARE( f.attribute( "p_" + names.at( i ) ), f.attribute( "s_" + names.at( i ) ) );
+    }
+    ++nFeatures;
+  }
+  QCOMPARE( nFeatures, wkts.size() );
+}
+
 QTEST_MAIN( TestQgsZonalStatistics )
 #include "moc_testqgszonalstatistics.cxx"
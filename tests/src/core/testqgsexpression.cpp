@@ -425,6 +425,130 @@ class TestQgsExpression: public QObject
         default:
           Q_ASSERT( false ); // should never happen
       }
+
+      // the compiled expression must give the very same result
+      QgsExpression compiled( string );
+      compiled.prepare( QgsFields() );
+      QVariant compiledRes = compiled.evaluate();
+      QCOMPARE( compiled.hasEvalError(), evalError );
+      QCOMPARE( compiledRes.type(), res.type() );
+      QCOMPARE( compiledRes.toString(), res.toString() );
+    }
+
+    void eval_compiled_data()
+    {
+      QTest::addColumn<QString>( "string" );
+      QTest::addColumn<bool>( "isCompiled" );
+
+      QTest::newRow( "column" ) << "num" << false;
+      QTest::newRow( "arithmetic" ) << "num * 2 + dbl / 3 - num % 3" << true;
+      QTest::newRow( "division" ) << "10 / num + dbl / num" << true;
+      QTest::newRow( "power" ) << "num ^ 2 + -dbl" << true;
+      QTest::newRow( "string arithmetic" ) << "name + 1" << true;
+      QTest::newRow( "comparison" ) << "num > 2 and dbl <= 1.5 or name = 'abc'" << true;
+      QTest::newRow( "string comparison" ) << "name < 'b' or name >= '2'" << true;
+      QTest::newRow( "mixed comparison" ) << "name = num or big > 3" << true;
+      QTest::newRow( "not" ) << "not ( num = 1 ) and not dbl" << true;
+      QTest::newRow( "string as boolean" ) << "name and num" << true;
+      QTest::newRow( "is" ) << "name is null or num is not 3" << true;
+      QTest::newRow( "in" ) << "num in ( 1, 2.5, '3', null ) or name not in ( 'abc', num )" << true;
+      QTest::newRow( "like" ) << "name like 'a%' or name ~ '^[0-9]' or name || num = 'abc1'" << true;
+      QTest::newRow( "function" ) << "sqrt( num ) + length( name ) + coalesce( dbl, num )" << true;
+      QTest::newRow( "function with error" ) << "toint( name ) + 1" << true;
+      QTest::newRow( "lazy function" ) << "round( dbl, toint( name ) )" << false;
+      QTest::newRow( "case" ) << "case when num > 2 then 'big' else name end || 'x'" << true;
+      QTest::newRow( "constant" ) << "2 * 3 + 1 in ( 7, 8 )" << true;
+      QTest::newRow( "constant with error" ) << "num + ( 'a' * 2 )" << true;
+    }
+
+    void eval_compiled()
+    {
+      QFETCH( QString, string );
+      QFETCH( bool, isCompiled );
+
+      QgsFields fields;
+      fields.append( QgsField( "num", QVariant::Int ) );
+      fields.append( QgsField( "dbl", QVariant::Double ) );
+      fields.append( QgsField( "name", QVariant::String ) );
+      fields.append( QgsField( "big", QVariant::LongLong ) );
+
+      QList<QgsFeature> features;
+      for ( int i = 0; i < 5; ++i )
+      {
+        QgsFeature f;
+        f.initAttributes( 4 );
+        features << f;
+      }
+      features[0].setAttributes( QgsAttributes() << QVariant( 1 ) << QVariant( 1.5 ) << QVariant( "abc" ) << QVariant(( qlonglong ) 3 ) );
+      features[1].setAttributes( QgsAttributes() << QVariant( 0 ) << QVariant( 0.0 ) << QVariant( "2" ) << QVariant(( qlonglong ) 10 ) );
+      features[2].setAttributes( QgsAttributes() << QVariant( 3 ) << QVariant( -2.25 ) << QVariant( "" ) << QVariant( QVariant::LongLong ) );
+      features[3].setAttributes( QgsAttributes() << QVariant( QVariant::Int ) << QVariant( QVariant::Double ) << QVariant( QVariant::String ) << QVariant( QVariant::LongLong ) );
+      // values of other types than announced by the fields
+      features[4].setAttributes( QgsAttributes() << QVariant( "4" ) << QVariant( 7 ) << QVariant( 2.5 ) << QVariant( "x" ) );
+
+      QgsExpression tree( string );
+      tree.setCompilationEnabled( false );
+      QVERIFY( tree.prepare( fields ) );
+      QVERIFY( !tree.isCompiled() );
+
+      QgsExpression compiled( string );
+      QVERIFY( compiled.prepare( fields ) );
+      QCOMPARE( compiled.isCompiled(), isCompiled );
+
+      foreach ( const QgsFeature& f, features )
+      {
+        QVariant treeRes = tree.evaluate( &f );
+        QVariant compiledRes = compiled.evaluate( &f );
+        QCOMPARE( compiled.hasEvalError(), tree.hasEvalError() );
+        QCOMPARE( compiled.evalErrorString(), tree.evalErrorString() );
+        QCOMPARE( compiledRes.type(), treeRes.type() );
+        QCOMPARE( compiledRes.isNull(), treeRes.isNull() );
+        QCOMPARE( compiledRes.toString(), treeRes.toString() );
+      }
+    }
+
+    void benchmark_evaluation_data()
+    {
+      QTest::addColumn<bool>( "compiled" );
+
+      QTest::newRow( "tree walker" ) << false;
+      QTest::newRow( "compiled" ) << true;
+    }
+
+    void benchmark_evaluation()
+    {
+      // takes a while, not part of the regular test run
+      if ( qgetenv( "QGIS_RUN_BENCHMARKS" ).isEmpty() )
+      {
+        QSKIP( "set QGIS_RUN_BENCHMARKS to run the evaluation benchmark", SkipAll );
+      }
+
+      QFETCH( bool, compiled );
+
+      QgsFields fields;
+      fields.append( QgsField( "num", QVariant::Int ) );
+      fields.append( QgsField( "dbl", QVariant::Double ) );
+      fields.append( QgsField( "name", QVariant::String ) );
+
+      QgsFeature features[4];
+      for ( int i = 0; i < 4; ++i )
+      {
+        features[i].setAttributes( QgsAttributes() << QVariant( i * 5 ) << QVariant( i * 1.5 ) << QVariant( QString( "name%1" ).arg( i ) ) );
+      }
+
+      QgsExpression exp( "num > 5 and dbl * 2.5 < 10 - 2 or name = 'name1' or num % 3 in (1, 2)" );
+      exp.setCompilationEnabled( compiled );
+      QVERIFY( exp.prepare( fields ) );
+      QCOMPARE( exp.isCompiled(), compiled );
+
+      // 10M evaluations
+      QBENCHMARK_ONCE
+      {
+        for ( int i = 0; i < 10000000; ++i )
+        {
+          exp.evaluate( &features[i % 4] );
+        }
+      }
     }
 
     void eval_columns()
@@ -456,6 +580,32 @@ class TestQgsExpression: public QObject
       QCOMPARE( res2.type(), QVariant::Invalid );
     }
 
+    void eval_regexp_cache()
+    {
+      QgsFields fields;
+      fields.append( QgsField( "pattern", QVariant::String ) );
+
+      QgsExpression exp( "regexp_replace( 'a1b22c333', pattern, '-' ) || ('abc' ilike 'A%') || ('abc' ~ 'b.$')" );
+      QVERIFY( exp.prepare( fields ) );
+
+      // more dynamic patterns than the cache holds, each used repeatedly
+      QgsFeature f;
+      f.initAttributes( 1 );
+      for ( int round = 0; round < 3; ++round )
+      {
+        for ( int i = 1; i <= 40; ++i )
+        {
+          f.setAttribute( 0, QString( "\\d{%1}" ).arg( i ) );
+          QString expected = QString( "a1b22c333" ).replace( QRegExp( QString( "\\d{%1}" ).arg( i ) ), "-" ) + "11";
+          QCOMPARE( exp.evaluate( &f ).toString(), expected );
+        }
+      }
+
+      f.setAttribute( 0, "[[[" );
+      exp.evaluate( &f );
+      QVERIFY( exp.hasEvalError() );
+    }
+
     void eval_rownum()
     {
       QgsExpression exp( "$rownum + 1" );
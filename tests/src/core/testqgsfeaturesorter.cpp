@@ -0,0 +1,196 @@
+/***************************************************************************
+     testqgsfeaturesorter.cpp
+     --------------------------------------
+    Date                 : January 2014
+    Copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include <QtTest>
+#include <QObject>
+#include <QString>
+#include <qgsapplication.h>
+#include <qgsgeometry.h>
+//header for class being tested
+#include <qgsfeaturesorter.h>
+
+class TestQgsFeatureSorter: public QObject
+{
+    Q_OBJECT;
+  private slots:
+
+    void initTestCase()
+    {
+      QgsApplication::init();
+      QgsApplication::initQgis();
+
+      mFields.append( QgsField( "num", QVariant::Int ) );
+      mFields.append( QgsField( "name", QVariant::String ) );
+    }
+
+    void nulls()
+    {
+      QList<QVariant> values;
+      values << 3 << QVariant() << 1 << 2 << QVariant();
+
+      QCOMPARE( sortedIds( values, QgsFeatureRequest().addOrderBy( "num" ) ), QString( "2,3,0,1,4" ) );
+      QCOMPARE( sortedIds( values, QgsFeatureRequest().addOrderBy( "num", false ) ), QString( "1,4,0,3,2" ) );
+      QCOMPARE( sortedIds( values, QgsFeatureRequest().addOrderBy( "num", true, true ) ), QString( "1,4,2,3,0" ) );
+      QCOMPARE( sortedIds( values, QgsFeatureRequest().addOrderBy( "num", false, false ) ), QString( "0,3,2,1,4" ) );
+    }
+
+    void ties()
+    {
+      QList<QVariant> values;
+      values << 2 << 1 << 2 << 1 << 2;
+
+      // equal features keep their order in both directions
+      QCOMPARE( sortedIds( values, QgsFeatureRequest().addOrderBy( "num" ) ), QString( "1,3,0,2,4" ) );
+      QCOMPARE( sortedIds( values, QgsFeatureRequest().addOrderBy( "num", false ) ), QString( "0,2,4,1,3" ) );
+
+      // the second clause decides
+      QCOMPARE( sortedIds( values, QgsFeatureRequest().addOrderBy( "num" ).addOrderBy( "$id", false ) ), QString( "3,1,4,2,0" ) );
+    }
+
+    void compareValues()
+    {
+      QVERIFY( QgsFeatureSorter::compareValues( 2, 10 ) < 0 );
+      QVERIFY( QgsFeatureSorter::compareValues( 2.5, 2 ) > 0 );
+      QVERIFY( QgsFeatureSorter::compareValues( QVariant( 3LL ), 3.0 ) == 0 );
+      QVERIFY( QgsFeatureSorter::compareValues( "10", "9" ) < 0 );
+      QVERIFY( QgsFeatureSorter::compareValues( QDate( 2014, 1, 2 ), QDate( 2013, 12, 31 ) ) > 0 );
+    }
+
+    void limit()
+    {
+      QList<QVariant> values;
+      for ( int i = 0; i < 100; ++i )
+        values << ( i * 37 ) % 100;
+
+      // 0 is the value of the first feature, 1 of the feature 73 etc.
+      QCOMPARE( sortedIds( values, QgsFeatureRequest().addOrderBy( "num" ).setLimit( 3 ), 10 ), QString( "0,73,46" ) );
+      QCOMPARE( sortedIds( values, QgsFeatureRequest().addOrderBy( "num", false ).setLimit( 2 ), 10 ), QString( "27,54" ) );
+      QCOMPARE( sortedIds( values, QgsFeatureRequest().addOrderBy( "num" ).setLimit( 0 ), 10 ), QString() );
+    }
+
+    void externalMerge()
+    {
+      QgsFeatureRequest::OrderBy orderBy;
+      orderBy << QgsFeatureRequest::OrderByClause( "name" ) << QgsFeatureRequest::OrderByClause( "num", false );
+      QgsFeatureSorter sorter( orderBy, -1, 16 );
+
+      for ( int i = 0; i < 1000; ++i )
+      {
+        QgsFeature f( mFields, i );
+        f.setAttribute( 0, i % 7 == 0 ? QVariant() : QVariant( i ) );
+        f.setAttribute( 1, QString( "name %1" ).arg( i % 10 ) );
+        f.setGeometry( QgsGeometry::fromPoint( QgsPoint( i, -i ) ) );
+        sorter.addFeature( f );
+      }
+      sorter.sort();
+
+      // sorted runs are merged from the temporary files
+      QVERIFY( sorter.runCount() > 1 );
+
+      QgsFeature previous;
+      QgsFeature f;
+      int count = 0;
+      while ( sorter.nextFeature( f ) )
+      {
+        QVERIFY( f.isValid() );
+        QVERIFY( f.fields() == &mFields );
+        QVERIFY( f.geometry() );
+        QCOMPARE( f.geometry()->asPoint(), QgsPoint( f.id(), -f.id() ) );
+        QCOMPARE( f.attribute( "name" ).toString(), QString( "name %1" ).arg( f.id() % 10 ) );
+
+        if ( count > 0 )
+        {
+          QString name = f.attribute( "name" ).toString();
+          QString previousName = previous.attribute( "name" ).toString();
+          QVERIFY( previousName <= name );
+
+          // NULLs are the largest values, so they come first in the descending order
+          if ( previousName == name && f.attribute( "num" ).isNull() )
+            QVERIFY( previous.attribute( "num" ).isNull() );
+          else if ( previousName == name )
+            QVERIFY( previous.attribute( "num" ).isNull() || previous.attribute( "num" ).toInt() > f.attribute( "num" ).toInt() );
+        }
+
+        previous = f;
+        count++;
+      }
+
+      QCOMPARE( count, 1000 );
+      QVERIFY( sorter.atEnd() );
+    }
+
+    void multiPassMerge()
+    {
+      // 50 runs, merged three at a time in several passes
+      QgsFeatureRequest::OrderBy orderBy;
+      orderBy << QgsFeatureRequest::OrderByClause( "num" );
+      QgsFeatureSorter sorter( orderBy, -1, 10, 3 );
+
+      for ( int i = 0; i < 500; ++i )
+      {
+        QgsFeature f( mFields, i );
+        f.setAttribute( 0, ( i * 37 ) % 50 );
+        sorter.addFeature( f );
+      }
+      sorter.sort();
+
+      QVERIFY( sorter.runCount() > 1 );
+      QVERIFY( sorter.runCount() <= 3 );
+
+      QgsFeature previous;
+      QgsFeature f;
+      int count = 0;
+      while ( sorter.nextFeature( f ) )
+      {
+        if ( count > 0 )
+        {
+          int num = f.attribute( "num" ).toInt();
+          int previousNum = previous.attribute( "num" ).toInt();
+          QVERIFY( previousNum <= num );
+          // equal features keep their order through all the passes
+          if ( previousNum == num )
+            QVERIFY( previous.id() < f.id() );
+        }
+        previous = f;
+        count++;
+      }
+
+      QCOMPARE( count, 500 );
+      QVERIFY( sorter.atEnd() );
+    }
+
+  private:
+    QString sortedIds( const QList<QVariant>& values, const QgsFeatureRequest& request, int runSize = 50000 )
+    {
+      QgsFeatureSorter sorter( request.orderBy(), request.limit(), runSize );
+      for ( int i = 0; i < values.count(); ++i )
+      {
+        QgsFeature f( mFields, i );
+        f.setAttribute( 0, values[i] );
+        sorter.addFeature( f );
+      }
+      sorter.sort();
+
+      QStringList ids;
+      QgsFeature f;
+      while ( sorter.nextFeature( f ) )
+        ids << QString::number( f.id() );
+      return ids.join( "," );
+    }
+
+    QgsFields mFields;
+};
+
+QTEST_MAIN( TestQgsFeatureSorter )
+
+#include "moc_testqgsfeaturesorter.cxx"
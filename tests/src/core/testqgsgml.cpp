@@ -0,0 +1,108 @@
+/***************************************************************************
+     testqgsgml.cpp
+     --------------------------------------
+    Date                 : January 2014
+    Copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include <QtTest>
+#include <QObject>
+#include <QString>
+#include <qgsapplication.h>
+#include <qgsgeometry.h>
+//header for class being tested
+#include <qgsgml.h>
+
+static const char* TEST_GML =
+  "<wfs:FeatureCollection xmlns:wfs=\"http://www.opengis.net/wfs\" "
+  "xmlns:gml=\"http://www.opengis.net/gml\" xmlns:myns=\"http://myns\">"
+  "<gml:featureMember><myns:mytypename fid=\"mytypename.1\">"
+  "<myns:mygeom><gml:Point><gml:coordinates>10,20</gml:coordinates></gml:Point></myns:mygeom>"
+  "<myns:name>first</myns:name>"
+  "</myns:mytypename></gml:featureMember>"
+  "<gml:featureMember><myns:mytypename fid=\"mytypename.2\">"
+  "<myns:mygeom><gml:Point><gml:coordinates>30,40</gml:coordinates></gml:Point></myns:mygeom>"
+  "<myns:name>second</myns:name>"
+  "</myns:mytypename></gml:featureMember>"
+  "</wfs:FeatureCollection>";
+
+class TestQgsGml: public QObject
+{
+    Q_OBJECT;
+  public slots:
+    void featureParsed( QgsFeature* feature, const QString& featureId )
+    {
+      mParsedIds << featureId;
+      mParsedNames << feature->attribute( 0 ).toString();
+      mParsedPoints << feature->geometry()->asPoint();
+      delete feature;
+    }
+
+  private slots:
+
+    void initTestCase()
+    {
+      QgsApplication::init();
+      QgsApplication::initQgis();
+
+      mFields.append( QgsField( "name", QVariant::String ) );
+    }
+
+    void init()
+    {
+      mParsedIds.clear();
+      mParsedNames.clear();
+      mParsedPoints.clear();
+    }
+
+    void collected()
+    {
+      QgsGml gml( "mytypename", "mygeom", mFields );
+      QVERIFY( !gml.isStreaming() );
+
+      QGis::WkbType wkbType = QGis::WKBUnknown;
+      QCOMPARE( gml.getFeatures( QByteArray( TEST_GML ), &wkbType ), 0 );
+      QCOMPARE( wkbType, QGis::WKBPoint );
+
+      QMap<QgsFeatureId, QgsFeature* > features = gml.featuresMap();
+      QCOMPARE( features.size(), 2 );
+      QCOMPARE( features[0]->attribute( 0 ).toString(), QString( "first" ) );
+      QCOMPARE( gml.idsMap()[1], QString( "mytypename.2" ) );
+      qDeleteAll( features );
+    }
+
+    void streamed()
+    {
+      QgsGml gml( "mytypename", "mygeom", mFields );
+      gml.setStreaming( true );
+      QVERIFY( gml.isStreaming() );
+      connect( &gml, SIGNAL( featureParsed( QgsFeature*, const QString& ) ), this, SLOT( featureParsed( QgsFeature*, const QString& ) ) );
+
+      QGis::WkbType wkbType = QGis::WKBUnknown;
+      QCOMPARE( gml.getFeatures( QByteArray( TEST_GML ), &wkbType ), 0 );
+
+      // every feature is handed over while parsing, nothing is kept by the reader
+      QCOMPARE( mParsedIds, QStringList() << "mytypename.1" << "mytypename.2" );
+      QCOMPARE( mParsedNames, QStringList() << "first" << "second" );
+      QCOMPARE( mParsedPoints.size(), 2 );
+      QCOMPARE( mParsedPoints[1], QgsPoint( 30, 40 ) );
+      QVERIFY( gml.featuresMap().isEmpty() );
+      QVERIFY( gml.idsMap().isEmpty() );
+    }
+
+  private:
+    QgsFields mFields;
+    QStringList mParsedIds;
+    QStringList mParsedNames;
+    QList<QgsPoint> mParsedPoints;
+};
+
+QTEST_MAIN( TestQgsGml )
+
+#include "moc_testqgsgml.cxx"
@@ -0,0 +1,205 @@
+/***************************************************************************
+     testqgslabelplacementcache.cpp
+     --------------------------------------
+    Date                 : January 2014
+    Copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include <QtTest>
+#include <QObject>
+#include <QImage>
+#include <QPainter>
+#include <QString>
+#include <QStringList>
+
+#include <qgsapplication.h>
+#include <qgsfeature.h>
+#include <qgsgeometry.h>
+#include <qgsmaplayerregistry.h>
+#include <qgsmaprenderer.h>
+#include <qgspallabeling.h>
+#include <qgsrendercontext.h>
+#include <qgsvectordataprovider.h>
+#include <qgsvectorlayer.h>
+
+/** \ingroup UnitTests
+ * This is a unit test for the reuse of the labels of the last render by QgsPalLabeling.
+ */
+class TestQgsLabelPlacementCache: public QObject
+{
+    Q_OBJECT;
+  private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+
+    void cacheHit();
+    void filterChange();
+    void selectionChange();
+    void dataChange();
+    void disabled();
+
+  private:
+    QImage render();
+
+    QgsVectorLayer* mLayer;
+    QgsMapRenderer* mMapRenderer;
+    QgsPalLabeling* mLabeling;
+};
+
+void TestQgsLabelPlacementCache::initTestCase()
+{
+  QgsApplication::init();
+  QgsApplication::initQgis();
+
+  mLayer = new QgsVectorLayer( "Point?crs=epsg:4326&field=name:string(20)", "points", "memory" );
+  QVERIFY( mLayer->isValid() );
+  QgsFeatureList features;
+  QStringList names = QStringList() << "first" << "second" << "third";
+  for ( int i = 0; i < names.size(); ++i )
+  {
+    QgsFeature f( mLayer->pendingFields() );
+    f.setAttribute( 0, names.at( i ) );
+    f.setGeometry( QgsGeometry::fromPoint( QgsPoint( i * 3, i * 2 ) ) );
+    features << f;
+  }
+  QVERIFY( mLayer->dataProvider()->addFeatures( features ) );
+  mLayer->updateExtents();
+  QgsMapLayerRegistry::instance()->addMapLayers( QList<QgsMapLayer*>() << mLayer );
+
+  QgsPalLayerSettings settings;
+  settings.enabled = true;
+  settings.fieldName = "name";
+  settings.writeToLayer( mLayer );
+
+  mMapRenderer = new QgsMapRenderer();
+  mLabeling = new QgsPalLabeling();
+  mMapRenderer->setLabelingEngine( mLabeling );
+  mMapRenderer->setLayerSet( QStringList() << mLayer->id() );
+  mMapRenderer->setOutputSize( QSize( 256, 256 ), 96 );
+  mMapRenderer->setExtent( QgsRectangle( -2, -2, 8, 6 ) );
+}
+
+void TestQgsLabelPlacementCache::cleanupTestCase()
+{
+  delete mMapRenderer;
+  QgsMapLayerRegistry::instance()->removeAllMapLayers();
+}
+
+void TestQgsLabelPlacementCache::init()
+{
+  mMapRenderer->rendererContext()->clearLayerOverrides();
+  mLabeling->setUsingPlacementCache( true );
+  mLabeling->clearPlacementCache();
+}
+
+QImage TestQgsLabelPlacementCache::render()
+{
+  QImage image( 256, 256, QImage::Format_ARGB32_Premultiplied );
+  image.fill( QColor( Qt::white ).rgba() );
+  QPainter painter( &image );
+  mMapRenderer->render( &painter );
+  painter.end();
+  return image;
+}
+
+void TestQgsLabelPlacementCache::cacheHit()
+{
+  QImage first = render();
+  QVERIFY( !mLabeling->isPlacementCacheHit() );
+  QImage second = render();
+  QVERIFY( mLabeling->isPlacementCacheHit() );
+  QCOMPARE( second, first );
+
+  // another extent is placed again
+  mMapRenderer->setExtent( QgsRectangle( -3, -2, 7, 6 ) );
+  render();
+  QVERIFY( !mLabeling->isPlacementCacheHit() );
+  mMapRenderer->setExtent( QgsRectangle( -2, -2, 8, 6 ) );
+}
+
+void TestQgsLabelPlacementCache::filterChange()
+{
+  render();
+  render();
+  QVERIFY( mLabeling->isPlacementCacheHit() );
+
+  QgsRenderContext::LayerOverride layerOverride;
+  layerOverride.filterExpression = "name = 'first'";
+  mMapRenderer->rendererContext()->setLayerOverride( mLayer->id(), layerOverride );
+  render();
+  QVERIFY( !mLabeling->isPlacementCacheHit() );
+  render();
+  QVERIFY( mLabeling->isPlacementCacheHit() );
+
+  layerOverride.filterExpression = "name = 'second'";
+  mMapRenderer->rendererContext()->setLayerOverride( mLayer->id(), layerOverride );
+  render();
+  QVERIFY( !mLabeling->isPlacementCacheHit() );
+}
+
+void TestQgsLabelPlacementCache::selectionChange()
+{
+  QgsRenderContext::LayerOverride layerOverride;
+  layerOverride.overrideSelection = true;
+  mMapRenderer->rendererContext()->setLayerOverride( mLayer->id(), layerOverride );
+  render();
+  render();
+  QVERIFY( mLabeling->isPlacementCacheHit() );
+
+  layerOverride.selectedFeatureIds << mLayer->allFeatureIds().toList().first();
+  mMapRenderer->rendererContext()->setLayerOverride( mLayer->id(), layerOverride );
+  render();
+  QVERIFY( !mLabeling->isPlacementCacheHit() );
+  render();
+  QVERIFY( mLabeling->isPlacementCacheHit() );
+
+  // the selection of the layer is used again
+  layerOverride.overrideSelection = false;
+  mMapRenderer->rendererContext()->setLayerOverride( mLayer->id(), layerOverride );
+  render();
+  QVERIFY( !mLabeling->isPlacementCacheHit() );
+}
+
+void TestQgsLabelPlacementCache::dataChange()
+{
+  QImage before = render();
+  render();
+  QVERIFY( mLabeling->isPlacementCacheHit() );
+
+  // the edit signals empty the cache, there is no render in between
+  QgsFeatureId fid = mLayer->allFeatureIds().toList().first();
+  QVERIFY( mLayer->startEditing() );
+  QVERIFY( mLayer->changeAttributeValue( fid, 0, QString( "changed label" ) ) );
+  QVERIFY( mLayer->commitChanges() );
+
+  QImage after = render();
+  QVERIFY( !mLabeling->isPlacementCacheHit() );
+  QVERIFY( after != before );
+  render();
+  QVERIFY( mLabeling->isPlacementCacheHit() );
+
+  // a repaint request (e.g. after the data source was reloaded) empties it as well
+  mLayer->triggerRepaint();
+  render();
+  QVERIFY( !mLabeling->isPlacementCacheHit() );
+}
+
+void TestQgsLabelPlacementCache::disabled()
+{
+  // as in the server
+  mLabeling->setUsingPlacementCache( false );
+  render();
+  render();
+  QVERIFY( !mLabeling->isPlacementCacheHit() );
+}
+
+QTEST_MAIN( TestQgsLabelPlacementCache )
+
+#include "moc_testqgslabelplacementcache.cxx"
@@ -18,6 +18,8 @@
 #include <QStringList>
 #include <QObject>
 #include <QPainter>
+#include <QSettings>
+#include <QThread>
 #include <QTime>
 #include <iostream>
 
@@ -37,13 +39,57 @@
 #include <qgsmaprenderer.h>
 #include <qgsmaplayer.h>
 #include <qgsvectorlayer.h>
+#include <qgsvectordataprovider.h>
 #include <qgsapplication.h>
 #include <qgsproviderregistry.h>
 #include <qgsmaplayerregistry.h>
+#include <qgspallabeling.h>
 
 //qgs unit test utility class
 #include "qgsrenderchecker.h"
 
+/** Labeling engine which stops the rendering when the first feature of a layer
+ * is registered, i.e. while the layer is rendered */
+class StoppingLabelingEngine : public QgsLabelingEngineInterface
+{
+  public:
+    StoppingLabelingEngine( const QString& layerId )
+        : mLayerId( layerId ), mMapRenderer( 0 ), mRegistered( 0 ), mStoppedInWorker( false ) {}
+
+    void init( QgsMapRenderer* mp ) { mMapRenderer = mp; }
+    bool willUseLayer( QgsVectorLayer* layer ) { return layer->id() == mLayerId; }
+    void clearActiveLayers() {}
+    void clearActiveLayer( QgsVectorLayer* layer ) { Q_UNUSED( layer ); }
+    int prepareLayer( QgsVectorLayer* layer, QSet<int>& attrIndices, QgsRenderContext& ctx )
+    { Q_UNUSED( attrIndices ); Q_UNUSED( ctx ); return willUseLayer( layer ) ? 1 : 0; }
+    QgsPalLayerSettings& layer( const QString& layerName ) { Q_UNUSED( layerName ); return mSettings; }
+    void registerFeature( QgsVectorLayer* layer, QgsFeature& feat, const QgsRenderContext& context = QgsRenderContext() )
+    {
+      Q_UNUSED( layer ); Q_UNUSED( feat ); Q_UNUSED( context );
+      if ( mRegistered++ == 0 )
+      {
+        mStoppedInWorker = QThread::currentThread() != qApp->thread();
+        mMapRenderer->rendererContext()->setRenderingStopped( true );
+      }
+    }
+    void drawLabeling( QgsRenderContext& context ) { Q_UNUSED( context ); }
+    void exit() {}
+    QList<QgsLabelPosition> labelsAtPosition( const QgsPoint& p ) { Q_UNUSED( p ); return QList<QgsLabelPosition>(); }
+    QList<QgsLabelPosition> labelsWithinRect( const QgsRectangle& r ) { Q_UNUSED( r ); return QList<QgsLabelPosition>(); }
+    QgsLabelingEngineInterface* clone() { return new StoppingLabelingEngine( mLayerId ); }
+
+    //! number of registered features, the one which stopped the rendering included
+    int registered() const { return mRegistered; }
+    bool stoppedInWorker() const { return mStoppedInWorker; }
+
+  private:
+    QString mLayerId;
+    QgsMapRenderer* mMapRenderer;
+    QgsPalLayerSettings mSettings;
+    int mRegistered;
+    bool mStoppedInWorker;
+};
+
 /** \ingroup UnitTests
  * This is a unit test for the QgsMapRenderer class.
  * It will do some performance testing too
@@ -61,7 +107,24 @@ class TestQgsMapRenderer: public QObject
     /** This method tests render perfomance */
     void performanceTest();
 
+    /** Rendering layers in worker threads must give the same image */
+    void parallelRenderTest();
+
+    /** Several layers rendered in worker threads are composited like drawn in sequence */
+    void parallelRenderLayersTest();
+
+    /** Stopping the rendering reaches the worker threads and nothing is composited */
+    void parallelRenderStopTest();
+
+    /** Layer overrides of the render context are applied without modifying the layer */
+    void layerOverrideTest();
+
   private:
+    /** Renders the layer set into a new image of the given size */
+    QImage renderImage( int width, int height, bool parallel );
+    /** Memory layer with a grid of points, count*count features */
+    QgsVectorLayer* createPointLayer( int count );
+
     QString mEncoding;
     QgsVectorFileWriter::WriterError mError;
     QgsCoordinateReferenceSystem mCRS;
@@ -194,6 +257,175 @@ void TestQgsMapRenderer::performanceTest()
   QVERIFY( myResultFlag );
 }
 
+void TestQgsMapRenderer::parallelRenderTest()
+{
+  QSettings settings;
+  bool bkParallel = settings.value( "/qgis/parallel_rendering", false ).toBool();
+  settings.setValue( "/qgis/parallel_rendering", true );
+
+  mpMapRenderer->setExtent( mpPolysLayer->extent() );
+  QgsRenderChecker myChecker;
+  myChecker.setControlName( "expected_maprender" );
+  myChecker.setMapRenderer( mpMapRenderer );
+  bool myResultFlag = myChecker.runTest( "maprender_parallel" );
+  mReport += myChecker.report();
+
+  settings.setValue( "/qgis/parallel_rendering", bkParallel );
+  QVERIFY( myResultFlag );
+}
+
+QImage TestQgsMapRenderer::renderImage( int width, int height, bool parallel )
+{
+  QSettings settings;
+  bool bkParallel = settings.value( "/qgis/parallel_rendering", false ).toBool();
+  settings.setValue( "/qgis/parallel_rendering", parallel );
+
+  QImage image( width, height, QImage::Format_ARGB32_Premultiplied );
+  image.fill( 0 );
+  mpMapRenderer->setOutputSize( image.size(), image.logicalDpiX() );
+  QPainter painter( &image );
+  painter.setRenderHint( QPainter::Antialiasing );
+  mpMapRenderer->render( &painter );
+  painter.end();
+
+  settings.setValue( "/qgis/parallel_rendering", bkParallel );
+  return image;
+}
+
+QgsVectorLayer* TestQgsMapRenderer::createPointLayer( int count )
+{
+  QgsVectorLayer* layer = new QgsVectorLayer( "Point?crs=epsg:4326", "points", "memory" );
+  if ( !layer->isValid() )
+  {
+    delete layer;
+    return 0;
+  }
+
+  QgsFeatureList features;
+  for ( int i = 0; i < count; ++i )
+  {
+    for ( int j = 0; j < count; ++j )
+    {
+      QgsFeature feature;
+      feature.setGeometry( QgsGeometry::fromPoint( QgsPoint( -180.0 + 360.0 * i / count, -90.0 + 180.0 * j / count ) ) );
+      features << feature;
+    }
+  }
+  layer->dataProvider()->addFeatures( features );
+  layer->updateExtents();
+  return layer;
+}
+
+void TestQgsMapRenderer::parallelRenderLayersTest()
+{
+  QgsVectorLayer* pointLayer = createPointLayer( 50 );
+  QVERIFY( pointLayer );
+  QgsMapLayerRegistry::instance()->addMapLayers( QList<QgsMapLayer *>() << pointLayer );
+  mpMapRenderer->setLayerSet( QStringList() << pointLayer->id() << mpPolysLayer->id() );
+  mpMapRenderer->setExtent( mpPolysLayer->extent() );
+
+  QImage sequentialImage = renderImage( 400, 200, false );
+  QImage parallelImage = renderImage( 400, 200, true );
+
+  mpMapRenderer->setLayerSet( QStringList( mpPolysLayer->id() ) );
+  QgsMapLayerRegistry::instance()->removeMapLayers( QStringList( pointLayer->id() ) );
+
+  QImage emptyImage( 400, 200, QImage::Format_ARGB32_Premultiplied );
+  emptyImage.fill( 0 );
+  QVERIFY( sequentialImage != emptyImage );
+  //compositing the layer images may round differently where antialiased edges overlap
+  int mismatches = 0;
+  for ( int y = 0; y < sequentialImage.height(); ++y )
+  {
+    for ( int x = 0; x < sequentialImage.width(); ++x )
+    {
+      QRgb s = sequentialImage.pixel( x, y );
+      QRgb p = parallelImage.pixel( x, y );
+      if ( qAbs( qRed( s ) - qRed( p ) ) > 2 || qAbs( qGreen( s ) - qGreen( p ) ) > 2
+           || qAbs( qBlue( s ) - qBlue( p ) ) > 2 || qAbs( qAlpha( s ) - qAlpha( p ) ) > 2 )
+      {
+        ++mismatches;
+      }
+    }
+  }
+  QCOMPARE( mismatches, 0 );
+}
+
+void TestQgsMapRenderer::parallelRenderStopTest()
+{
+  QgsVectorLayer* pointLayer = createPointLayer( 100 );
+  QVERIFY( pointLayer );
+  QgsMapLayerRegistry::instance()->addMapLayers( QList<QgsMapLayer *>() << pointLayer );
+  mpMapRenderer->setLayerSet( QStringList() << pointLayer->id() << mpPolysLayer->id() );
+  mpMapRenderer->setExtent( mpPolysLayer->extent() );
+
+  //stopped by the first feature of the point layer, i.e. while its worker runs
+  StoppingLabelingEngine* engine = new StoppingLabelingEngine( pointLayer->id() );
+  mpMapRenderer->setLabelingEngine( engine );
+  QImage image = renderImage( 400, 200, true );
+  bool stoppedInWorker = engine->stoppedInWorker();
+  int registered = engine->registered();
+  mpMapRenderer->setLabelingEngine( 0 );
+
+  QVERIFY( stoppedInWorker );
+  //the worker checks the flag before each feature
+  QCOMPARE( registered, 1 );
+
+  //no layer is composited, the polygons were rendered or not
+  QImage emptyImage( 400, 200, QImage::Format_ARGB32_Premultiplied );
+  emptyImage.fill( 0 );
+  QVERIFY( image == emptyImage );
+
+  //the next rendering starts again
+  image = renderImage( 400, 200, true );
+
+  mpMapRenderer->setLayerSet( QStringList( mpPolysLayer->id() ) );
+  QgsMapLayerRegistry::instance()->removeMapLayers( QStringList( pointLayer->id() ) );
+
+  QVERIFY( image != emptyImage );
+}
+
+void TestQgsMapRenderer::layerOverrideTest()
+{
+  QgsVectorLayer* layer = qobject_cast<QgsVectorLayer *>( mpPolysLayer );
+  mpMapRenderer->setExtent( mpPolysLayer->extent() );
+
+  //a filter matching all features gives the same image as without override
+  QgsRenderContext::LayerOverride layerOverride;
+  layerOverride.filterExpression = "\"Value\" >= -180";
+  mpMapRenderer->rendererContext()->setLayerOverride( mpPolysLayer->id(), layerOverride );
+
+  QgsRenderChecker myChecker;
+  myChecker.setControlName( "expected_maprender" );
+  myChecker.setMapRenderer( mpMapRenderer );
+  bool myResultFlag = myChecker.runTest( "maprender_override" );
+  mReport += myChecker.report();
+  QVERIFY( myResultFlag );
+
+  //the provider applies the filter, so it is in the SQL dialect of OGR (no BETWEEN in expressions)
+  layerOverride.filterExpression = "\"Value\" BETWEEN -180 AND 180";
+  mpMapRenderer->rendererContext()->setLayerOverride( mpPolysLayer->id(), layerOverride );
+  myResultFlag = myChecker.runTest( "maprender_override_sql" );
+  mReport += myChecker.report();
+  QVERIFY( myResultFlag );
+
+  //a filter matching no feature gives an empty image
+  layerOverride.filterExpression = "\"Value\" > 1000";
+  mpMapRenderer->rendererContext()->setLayerOverride( mpPolysLayer->id(), layerOverride );
+
+  QImage image( 100, 100, QImage::Format_ARGB32 );
+  image.fill( 0 );
+  QImage emptyImage = image;
+  mpMapRenderer->setOutputSize( image.size(), image.logicalDpiX() );
+  QPainter painter( &image );
+  mpMapRenderer->render( &painter );
+  painter.end();
+  mpMapRenderer->rendererContext()->clearLayerOverrides();
+
+  QVERIFY( image == emptyImage );
+  QVERIFY( layer->subsetString().isEmpty() );
+}
+
 QTEST_MAIN( TestQgsMapRenderer )
 #include "moc_testqgsmaprenderer.cxx"
 
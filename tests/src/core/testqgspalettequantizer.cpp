@@ -0,0 +1,510 @@
+/***************************************************************************
+     testqgspalettequantizer.cpp
+     --------------------------------------
+    Date                 : January 2014
+    Copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include <QtTest>
+#include <QObject>
+#include <QHash>
+#include <QImage>
+#include <QLinearGradient>
+#include <QMap>
+#include <QPair>
+#include <QPainter>
+#include <QRadialGradient>
+#include <QVector>
+#include <qgsapplication.h>
+//header for class being tested
+#include <qgspalettequantizer.h>
+
+#include <climits>
+
+//
+// Median cut over all the image colors, the former quantizer of the map server
+// kept as reference for the benchmark
+//
+
+typedef QList< QPair<QRgb, int> > QgsColorBox; //Color / number of pixels
+typedef QMultiMap< int, QgsColorBox > QgsColorBoxMap; // sum of pixels / color box
+
+static void imageColors( QHash<QRgb, int>& colors, const QImage& image )
+{
+  colors.clear();
+  int width = image.width();
+  int height = image.height();
+
+  const QRgb* currentScanLine = 0;
+  QHash<QRgb, int>::iterator colorIt;
+  for ( int i = 0; i < height; ++i )
+  {
+    currentScanLine = ( const QRgb* )( image.scanLine( i ) );
+    for ( int j = 0; j < width; ++j )
+    {
+      colorIt = colors.find( currentScanLine[j] );
+      if ( colorIt == colors.end() )
+      {
+        colors.insert( currentScanLine[j], 1 );
+      }
+      else
+      {
+        colorIt.value()++;
+      }
+    }
+  }
+}
+
+static bool minMaxRange( const QgsColorBox& colorBox, int& redRange, int& greenRange, int& blueRange, int& alphaRange )
+{
+  if ( colorBox.size() < 1 )
+  {
+    return false;
+  }
+
+  int rMin = INT_MAX;
+  int gMin = INT_MAX;
+  int bMin = INT_MAX;
+  int aMin = INT_MAX;
+  int rMax = INT_MIN;
+  int gMax = INT_MIN;
+  int bMax = INT_MIN;
+  int aMax = INT_MIN;
+
+  int currentRed = 0; int currentGreen = 0; int currentBlue = 0; int currentAlpha = 0;
+
+  QgsColorBox::const_iterator colorBoxIt = colorBox.constBegin();
+  for ( ; colorBoxIt != colorBox.constEnd(); ++colorBoxIt )
+  {
+    currentRed = qRed( colorBoxIt->first );
+    if ( currentRed > rMax )
+    {
+      rMax = currentRed;
+    }
+    if ( currentRed < rMin )
+    {
+      rMin = currentRed;
+    }
+
+    currentGreen = qGreen( colorBoxIt->first );
+    if ( currentGreen > gMax )
+    {
+      gMax = currentGreen;
+    }
+    if ( currentGreen < gMin )
+    {
+      gMin = currentGreen;
+    }
+
+    currentBlue = qBlue( colorBoxIt->first );
+    if ( currentBlue > bMax )
+    {
+      bMax = currentBlue;
+    }
+    if ( currentBlue < bMin )
+    {
+      bMin = currentBlue;
+    }
+
+    currentAlpha = qAlpha( colorBoxIt->first );
+    if ( currentAlpha > aMax )
+    {
+      aMax = currentAlpha;
+    }
+    if ( currentAlpha < aMin )
+    {
+      aMin = currentAlpha;
+    }
+  }
+
+  redRange = rMax - rMin;
+  greenRange = gMax - gMin;
+  blueRange = bMax - bMin;
+  alphaRange = aMax - aMin;
+  return true;
+}
+
+static bool redCompare( const QPair<QRgb, int>& c1, const QPair<QRgb, int>& c2 )
+{
+  return qRed( c1.first ) < qRed( c2.first );
+}
+
+static bool greenCompare( const QPair<QRgb, int>& c1, const QPair<QRgb, int>& c2 )
+{
+  return qGreen( c1.first ) < qGreen( c2.first );
+}
+
+static bool blueCompare( const QPair<QRgb, int>& c1, const QPair<QRgb, int>& c2 )
+{
+  return qBlue( c1.first ) < qBlue( c2.first );
+}
+
+static bool alphaCompare( const QPair<QRgb, int>& c1, const QPair<QRgb, int>& c2 )
+{
+  return qAlpha( c1.first ) < qAlpha( c2.first );
+}
+
+static void splitColorBox( QgsColorBox& colorBox, QgsColorBoxMap& colorBoxMap,
+                           QMap<int, QgsColorBox>::iterator colorBoxMapIt )
+{
+
+  if ( colorBox.size() < 2 )
+  {
+    return; //need at least two colors for a split
+  }
+
+  //a,r,g,b ranges
+  int redRange = 0;
+  int greenRange = 0;
+  int blueRange = 0;
+  int alphaRange = 0;
+
+  if ( !minMaxRange( colorBox, redRange, greenRange, blueRange, alphaRange ) )
+  {
+    return;
+  }
+
+  //sort color box for a/r/g/b
+  if ( redRange >= greenRange && redRange >= blueRange && redRange >= alphaRange )
+  {
+    qSort( colorBox.begin(), colorBox.end(), redCompare );
+  }
+  else if ( greenRange >= redRange && greenRange >= blueRange && greenRange >= alphaRange )
+  {
+    qSort( colorBox.begin(), colorBox.end(), greenCompare );
+  }
+  else if ( blueRange >= redRange && blueRange >= greenRange && blueRange >= alphaRange )
+  {
+    qSort( colorBox.begin(), colorBox.end(), blueCompare );
+  }
+  else
+  {
+    qSort( colorBox.begin(), colorBox.end(), alphaCompare );
+  }
+
+  //get median
+  double halfSum = colorBoxMapIt.key() / 2.0;
+  int currentSum = 0;
+  int currentListIndex = 0;
+
+  QgsColorBox::iterator colorBoxIt = colorBox.begin();
+  for ( ; colorBoxIt != colorBox.end(); ++colorBoxIt )
+  {
+    currentSum += colorBoxIt->second;
+    if ( currentSum >= halfSum )
+    {
+      break;
+    }
+    ++currentListIndex;
+  }
+
+  if ( currentListIndex > ( colorBox.size() - 2 ) ) //if the median is contained in the last color, split one item before that
+  {
+    --currentListIndex;
+    currentSum -= colorBoxIt->second;
+  }
+  else
+  {
+    ++colorBoxIt; //the iterator needs to point behind the last item to remove
+  }
+
+  //do split: replace old color box, insert new one
+  QgsColorBox newColorBox1 = colorBox.mid( 0, currentListIndex + 1 );
+  colorBoxMap.insert( currentSum, newColorBox1 );
+
+  colorBox.erase( colorBox.begin(), colorBoxIt );
+  QgsColorBox newColorBox2 = colorBox;
+  colorBoxMap.erase( colorBoxMapIt );
+  colorBoxMap.insert( halfSum * 2.0 - currentSum, newColorBox2 );
+}
+
+/**Calculates a representative color for a box (pixel weighted average)*/
+static QRgb boxColor( const QgsColorBox& box, int boxPixels, int colorMapIndex, QHash<QRgb, int>& colorIndexHash )
+{
+  double avRed = 0;
+  double avGreen = 0;
+  double avBlue = 0;
+  double avAlpha = 0;
+  QRgb currentColor;
+  int currentPixel;
+
+  double weight;
+
+  QgsColorBox::const_iterator colorBoxIt = box.constBegin();
+  for ( ; colorBoxIt != box.constEnd(); ++colorBoxIt )
+  {
+    currentColor = colorBoxIt->first;
+    currentPixel = colorBoxIt->second;
+    weight = ( double )currentPixel / boxPixels;
+    avRed += ( qRed( currentColor ) * weight );
+    avGreen += ( qGreen( currentColor ) * weight );
+    avBlue += ( qBlue( currentColor ) * weight );
+    avAlpha += ( qAlpha( currentColor ) * weight );
+    //allow faster lookup in image conversion
+    colorIndexHash.insert( currentColor, colorMapIndex );
+  }
+
+  return qRgba( avRed, avGreen, avBlue, avAlpha );
+}
+
+static void medianCutColorTable( QVector<QRgb>& colorTable, QHash<QRgb, int>& colorIndexHash, int nColors, const QImage& inputImage )
+{
+  QHash<QRgb, int> inputColors;
+  imageColors( inputColors, inputImage );
+
+  if ( inputColors.size() <= nColors ) //all the colors in the image can be mapped to one palette color
+  {
+    colorTable.resize( inputColors.size() );
+    int index = 0;
+    QHash<QRgb, int>::const_iterator inputColorIt = inputColors.constBegin();
+    for ( ; inputColorIt != inputColors.constEnd(); ++inputColorIt )
+    {
+      colorTable[index] = inputColorIt.key();
+      colorIndexHash.insert( inputColorIt.key(), index );
+      ++index;
+    }
+    return;
+  }
+
+  //create first box
+  QgsColorBox firstBox; //QList< QPair<QRgb, int> >
+  int firstBoxPixelSum = 0;
+  QHash<QRgb, int>::const_iterator inputColorIt = inputColors.constBegin();
+  for ( ; inputColorIt != inputColors.constEnd(); ++inputColorIt )
+  {
+    firstBox.push_back( qMakePair( inputColorIt.key(), inputColorIt.value() ) );
+    firstBoxPixelSum += inputColorIt.value();
+  }
+
+  QgsColorBoxMap colorBoxMap; //QMultiMap< int, ColorBox >
+  colorBoxMap.insert( firstBoxPixelSum, firstBox );
+  QMap<int, QgsColorBox>::iterator colorBoxMapIt = colorBoxMap.end();
+
+  //split boxes until number of boxes == nColors or all the boxes have color count 1
+  bool allColorsMapped = false;
+  while ( colorBoxMap.size() < nColors )
+  {
+    //start at the end of colorBoxMap and pick the first entry with number of colors < 1
+    colorBoxMapIt = colorBoxMap.end();
+    while ( true )
+    {
+      --colorBoxMapIt;
+      if ( colorBoxMapIt.value().size() > 1 )
+      {
+        splitColorBox( colorBoxMapIt.value(), colorBoxMap, colorBoxMapIt );
+        break;
+      }
+      if ( colorBoxMapIt == colorBoxMap.begin() )
+      {
+        allColorsMapped = true;
+        break;
+      }
+    }
+
+    if ( allColorsMapped )
+    {
+      break;
+    }
+    else
+    {
+      continue;
+    }
+  }
+
+  //get representative colors for the boxes
+  int index = 0;
+  colorTable.resize( colorBoxMap.size() );
+  QgsColorBoxMap::const_iterator colorBoxIt = colorBoxMap.constBegin();
+  for ( ; colorBoxIt != colorBoxMap.constEnd(); ++colorBoxIt )
+  {
+    colorTable[index] = boxColor( colorBoxIt.value(), colorBoxIt.key(), index, colorIndexHash );
+    ++index;
+  }
+}
+
+static QImage medianCut( const QImage& image, int nColors )
+{
+  QVector<QRgb> colorTable;
+  QHash<QRgb, int> colorIndexHash;
+  medianCutColorTable( colorTable, colorIndexHash, nColors, image );
+
+  QImage palettedImg( image.size(), QImage::Format_Indexed8 );
+  palettedImg.setColorTable( colorTable );
+
+  int h = image.height();
+  int w = image.width();
+
+  for ( int y = 0; y < h; ++y )
+  {
+    const QRgb* src_pixels = ( const QRgb * ) image.scanLine( y );
+    uchar* dest_pixels = ( uchar * ) palettedImg.scanLine( y );
+
+    for ( int x = 0; x < w; ++x )
+    {
+      int src_pixel = src_pixels[x];
+      int value = colorIndexHash.value( src_pixel, -1 );
+      if ( value == -1 )
+      {
+        continue;
+      }
+      dest_pixels[x] = ( uchar ) value;
+    }
+  }
+
+  return palettedImg;
+}
+
+
+class TestQgsPaletteQuantizer: public QObject
+{
+    Q_OBJECT;
+  private slots:
+
+    void initTestCase()
+    {
+      QgsApplication::init();
+      QgsApplication::initQgis();
+      mMapImage = mapImage( 1024 );
+    }
+
+    void exactColors()
+    {
+      QImage image( 64, 64, QImage::Format_ARGB32 );
+      image.fill( qRgba( 0, 0, 0, 0 ) );
+      QPainter p( &image );
+      p.fillRect( 0, 0, 32, 32, QColor( 255, 0, 0 ) );
+      p.fillRect( 32, 32, 32, 32, QColor( 0, 0, 255, 128 ) );
+      p.end();
+
+      QImage result = QgsPaletteQuantizer().quantize( image );
+      QCOMPARE( result.format(), QImage::Format_Indexed8 );
+      QCOMPARE( result.colorCount(), 3 );
+      QCOMPARE( result.pixel( 10, 10 ), image.pixel( 10, 10 ) );
+      QCOMPARE( result.pixel( 40, 40 ), image.pixel( 40, 40 ) );
+      QCOMPARE( qAlpha( result.pixel( 40, 10 ) ), 0 );
+    }
+
+    void manyColors()
+    {
+      QgsPaletteQuantizer quantizer;
+      QImage result = quantizer.quantize( mMapImage );
+      QCOMPARE( result.format(), QImage::Format_Indexed8 );
+      QVERIFY( result.colorCount() <= 256 );
+
+      // the background stays transparent
+      QCOMPARE( qAlpha( result.pixel( 0, 0 ) ), 0 );
+      QVERIFY( meanError( mMapImage, result ) < 3.0 );
+
+      quantizer.setMaxColors( 16 );
+      result = quantizer.quantize( mMapImage );
+      QVERIFY( result.colorCount() <= 16 );
+    }
+
+    void dithering()
+    {
+      QgsPaletteQuantizer quantizer;
+      quantizer.setMaxColors( 64 );
+      quantizer.setDithering( true );
+      QImage result = quantizer.quantize( mMapImage );
+      QCOMPARE( result.format(), QImage::Format_Indexed8 );
+      QVERIFY( result.colorCount() <= 64 );
+      QCOMPARE( qAlpha( result.pixel( 0, 0 ) ), 0 );
+      QVERIFY( meanError( mMapImage, result ) < 8.0 );
+    }
+
+    void pngQuality()
+    {
+      // inverse of the quality to zlib level conversion of the PNG writer
+      for ( int level = 0; level <= 9; ++level )
+      {
+        QCOMPARE(( 100 - QgsPaletteQuantizer::pngQuality( level ) ) * 9 / 91, level );
+      }
+      QCOMPARE( QgsPaletteQuantizer::pngQuality( -1 ), -1 );
+      QCOMPARE( QgsPaletteQuantizer::pngQuality( 10 ), -1 );
+    }
+
+    void benchmark_data()
+    {
+      QTest::addColumn<bool>( "medianCut" );
+      QTest::newRow( "median cut" ) << true;
+      QTest::newRow( "histogram" ) << false;
+    }
+
+    void benchmark()
+    {
+      QFETCH( bool, medianCut );
+
+      QImage result;
+      QgsPaletteQuantizer quantizer;
+      QBENCHMARK
+      {
+        result = medianCut ? ::medianCut( mMapImage, 256 ) : quantizer.quantize( mMapImage );
+      }
+    }
+
+  private:
+    //! antialiased map like image with transparent background, shading and symbols
+    static QImage mapImage( int size )
+    {
+      QImage image( size, size, QImage::Format_ARGB32 );
+      image.fill( qRgba( 0, 0, 0, 0 ) );
+
+      QPainter p( &image );
+      p.setRenderHint( QPainter::Antialiasing );
+
+      QRadialGradient shading( size / 3, size / 3, size / 2 );
+      shading.setColorAt( 0, QColor( 240, 235, 220 ) );
+      shading.setColorAt( 1, QColor( 90, 110, 80 ) );
+      p.setBrush( shading );
+      p.setPen( Qt::NoPen );
+      p.drawEllipse( size / 8, size / 8, size * 3 / 4, size * 3 / 4 );
+
+      QLinearGradient water( 0, 0, size, 0 );
+      water.setColorAt( 0, QColor( 120, 170, 230, 200 ) );
+      water.setColorAt( 1, QColor( 40, 80, 160, 200 ) );
+      p.setBrush( water );
+      p.drawRect( 0, size * 3 / 4, size, size / 4 );
+
+      for ( int i = 0; i < 40; ++i )
+      {
+        p.setPen( QPen( QColor::fromHsv(( i * 37 ) % 360, 200, 200 ), 1 + i % 4 ) );
+        p.setBrush( QColor::fromHsv(( i * 53 ) % 360, 120, 230, 120 ) );
+        QPolygonF polygon;
+        polygon << QPointF( i * size / 40, ( i * 97 ) % size )
+        << QPointF(( i * 61 ) % size, ( i * 13 ) % size )
+        << QPointF(( i * 29 ) % size, size - i * size / 50 );
+        p.drawPolygon( polygon );
+      }
+      p.end();
+      return image;
+    }
+
+    //! average difference of the color components
+    static double meanError( const QImage& image, const QImage& result )
+    {
+      double sum = 0;
+      for ( int y = 0; y < image.height(); ++y )
+      {
+        for ( int x = 0; x < image.width(); ++x )
+        {
+          QRgb c1 = image.pixel( x, y );
+          QRgb c2 = result.pixel( x, y );
+          sum += qAbs( qRed( c1 ) - qRed( c2 ) ) + qAbs( qGreen( c1 ) - qGreen( c2 ) )
+                 + qAbs( qBlue( c1 ) - qBlue( c2 ) ) + qAbs( qAlpha( c1 ) - qAlpha( c2 ) );
+        }
+      }
+      return sum / ( 4.0 * image.width() * image.height() );
+    }
+
+    QImage mMapImage;
+};
+
+QTEST_MAIN( TestQgsPaletteQuantizer )
+
+#include "moc_testqgspalettequantizer.cxx"
@@ -0,0 +1,166 @@
+/***************************************************************************
+     testqgspallabelingthreads.cpp
+     --------------------------------------
+    Date                 : January 2014
+    Copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include <QtTest>
+#include <QObject>
+#include <QImage>
+#include <QPainter>
+#include <QString>
+#include <QStringList>
+
+#include <qgsapplication.h>
+#include <qgsfeature.h>
+#include <qgsgeometry.h>
+#include <qgsmaplayerregistry.h>
+#include <qgsmaprenderer.h>
+#include <qgspallabeling.h>
+#include <qgsvectordataprovider.h>
+#include <qgsvectorlayer.h>
+
+/** \ingroup UnitTests
+ * This is a unit test for the threaded candidate generation and search of the PAL labeling.
+ */
+class TestQgsPalLabelingThreads: public QObject
+{
+    Q_OBJECT;
+  private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void chain();
+    void popmusicTabu();
+
+  private:
+    /** Labels placed by a render with the given number of threads, sorted */
+    QStringList placedLabels( int threadCount );
+    void compareThreadCounts();
+
+    QgsVectorLayer* mPointLayer;
+    QgsVectorLayer* mLineLayer;
+    QgsMapRenderer* mMapRenderer;
+    QgsPalLabeling* mLabeling;
+};
+
+void TestQgsPalLabelingThreads::initTestCase()
+{
+  QgsApplication::init();
+  QgsApplication::initQgis();
+
+  //clusters of crowded points far from each other, the conflicts split the problem in several components
+  mPointLayer = new QgsVectorLayer( "Point?crs=epsg:4326&field=name:string(20)", "points", "memory" );
+  QVERIFY( mPointLayer->isValid() );
+  QgsFeatureList features;
+  for ( int cluster = 0; cluster < 4; ++cluster )
+  {
+    double originX = ( cluster % 2 ) * 50;
+    double originY = ( cluster / 2 ) * 50;
+    for ( int i = 0; i < 10; ++i )
+    {
+      for ( int j = 0; j < 10; ++j )
+      {
+        QgsFeature f( mPointLayer->pendingFields() );
+        f.setAttribute( 0, QString( "point %1 %2 %3" ).arg( cluster ).arg( i ).arg( j ) );
+        f.setGeometry( QgsGeometry::fromPoint( QgsPoint( originX + j * 1.5, originY + i * 1.1 ) ) );
+        features << f;
+      }
+    }
+  }
+  QVERIFY( mPointLayer->dataProvider()->addFeatures( features ) );
+  mPointLayer->updateExtents();
+
+  mLineLayer = new QgsVectorLayer( "LineString?crs=epsg:4326&field=name:string(20)", "lines", "memory" );
+  QVERIFY( mLineLayer->isValid() );
+  features.clear();
+  for ( int i = 0; i < 8; ++i )
+  {
+    QgsFeature f( mLineLayer->pendingFields() );
+    f.setAttribute( 0, QString( "line %1" ).arg( i ) );
+    f.setGeometry( QgsGeometry::fromWkt( QString( "LINESTRING(%1 0, %2 60)" ).arg( i * 8 ).arg( i * 8 + 10 ) ) );
+    features << f;
+  }
+  QVERIFY( mLineLayer->dataProvider()->addFeatures( features ) );
+  mLineLayer->updateExtents();
+
+  QgsMapLayerRegistry::instance()->addMapLayers( QList<QgsMapLayer*>() << mPointLayer << mLineLayer );
+
+  QgsPalLayerSettings settings;
+  settings.enabled = true;
+  settings.fieldName = "name";
+  settings.writeToLayer( mPointLayer );
+  settings.placement = QgsPalLayerSettings::Line;
+  settings.writeToLayer( mLineLayer );
+
+  mMapRenderer = new QgsMapRenderer();
+  mLabeling = new QgsPalLabeling();
+  mLabeling->setUsingPlacementCache( false );
+  mMapRenderer->setLabelingEngine( mLabeling );
+  mMapRenderer->setLayerSet( QStringList() << mPointLayer->id() << mLineLayer->id() );
+  mMapRenderer->setOutputSize( QSize( 512, 512 ), 96 );
+  mMapRenderer->setExtent( QgsRectangle( -5, -5, 70, 70 ) );
+}
+
+void TestQgsPalLabelingThreads::cleanupTestCase()
+{
+  delete mMapRenderer;
+  QgsMapLayerRegistry::instance()->removeAllMapLayers();
+}
+
+QStringList TestQgsPalLabelingThreads::placedLabels( int threadCount )
+{
+  mLabeling->setThreadCount( threadCount );
+  QImage image( 512, 512, QImage::Format_ARGB32_Premultiplied );
+  image.fill( QColor( Qt::white ).rgba() );
+  QPainter painter( &image );
+  mMapRenderer->render( &painter );
+  painter.end();
+
+  QStringList labels;
+  QList<QgsLabelPosition> positions = mLabeling->labelsWithinRect( mMapRenderer->extent() );
+  QList<QgsLabelPosition>::const_iterator it = positions.constBegin();
+  for ( ; it != positions.constEnd(); ++it )
+  {
+    labels << QString( "%1|%2|%3,%4,%5,%6|%7" ).arg( it->layerID ).arg( it->featureId )
+    .arg( it->labelRect.xMinimum(), 0, 'g', 17 ).arg( it->labelRect.yMinimum(), 0, 'g', 17 )
+    .arg( it->labelRect.xMaximum(), 0, 'g', 17 ).arg( it->labelRect.yMaximum(), 0, 'g', 17 )
+    .arg( it->rotation, 0, 'g', 17 );
+  }
+  labels.sort();
+  return labels;
+}
+
+void TestQgsPalLabelingThreads::compareThreadCounts()
+{
+  QStringList serial = placedLabels( 1 );
+  // some labels have to be dropped because of the conflicts
+  QVERIFY( serial.size() > 10 );
+  QVERIFY( serial.size() < 408 );
+  QCOMPARE( placedLabels( 2 ), serial );
+  QCOMPARE( placedLabels( 4 ), serial );
+  QCOMPARE( placedLabels( 8 ), serial );
+}
+
+void TestQgsPalLabelingThreads::chain()
+{
+  mLabeling->setSearchMethod( QgsPalLabeling::Chain );
+  compareThreadCounts();
+}
+
+void TestQgsPalLabelingThreads::popmusicTabu()
+{
+  mLabeling->setSearchMethod( QgsPalLabeling::Popmusic_Tabu );
+  compareThreadCounts();
+}
+
+QTEST_MAIN( TestQgsPalLabelingThreads )
+
+#include "moc_testqgspallabelingthreads.cxx"
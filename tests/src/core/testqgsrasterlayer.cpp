@@ -31,6 +31,10 @@
 #include <qgsrasterlayer.h>
 #include <qgsrasterpyramid.h>
 #include <qgsrasterbandstats.h>
+#include <qgsrasterdrawer.h>
+#include <qgsrasteriterator.h>
+#include <qgsrasterviewport.h>
+#include <qgsmaptopixel.h>
 #include <qgsrasterpyramid.h>
 #include <qgsmaplayerregistry.h>
 #include <qgsapplication.h>
@@ -70,6 +74,7 @@ class TestQgsRasterLayer: public QObject
     void registry();
     void transparency();
     void setRenderer();
+    void parallelParts();
   private:
     bool render( QString theFileName );
     bool setQml( QString theType );
@@ -510,5 +515,44 @@ void TestQgsRasterLayer::setRenderer()
   delete renderer;
 }
 
+void TestQgsRasterLayer::parallelParts()
+{
+  QgsRasterViewPort viewPort;
+  viewPort.mTopLeftPoint = QgsPoint( 0, 0 );
+  viewPort.mBottomRightPoint = QgsPoint( 300, 400 );
+  viewPort.mWidth = 300;
+  viewPort.mHeight = 400;
+  viewPort.mDrawnExtent = mpLandsatRasterLayer->extent();
+  QgsMapToPixel mapToPixel;
+  QgsRasterPipe* pipe = mpLandsatRasterLayer->pipe();
+
+  QImage sequential( 300, 400, QImage::Format_ARGB32 );
+  sequential.fill( 0 );
+  QPainter sequentialPainter( &sequential );
+  QgsRasterIterator sequentialIterator( pipe->last() );
+  sequentialIterator.setMaximumTileWidth( 128 );
+  sequentialIterator.setMaximumTileHeight( 128 );
+  QgsRasterDrawer sequentialDrawer( &sequentialIterator );
+  sequentialDrawer.draw( &sequentialPainter, &viewPort, &mapToPixel );
+  sequentialPainter.end();
+
+  // parts of 64 rows split into three columns, read by four copies of the pipe
+  QImage parallel( 300, 400, QImage::Format_ARGB32 );
+  parallel.fill( 0 );
+  QPainter parallelPainter( &parallel );
+  QgsRasterIterator parallelIterator( pipe->last() );
+  parallelIterator.setMaximumTileWidth( 128 );
+  parallelIterator.setMaximumTileHeight( 128 );
+  QgsRasterDrawer parallelDrawer( &parallelIterator );
+  parallelDrawer.setParallelPipe( pipe, 4 );
+  parallelDrawer.draw( &parallelPainter, &viewPort, &mapToPixel );
+  parallelPainter.end();
+
+  QImage empty( 300, 400, QImage::Format_ARGB32 );
+  empty.fill( 0 );
+  QVERIFY( sequential != empty );
+  QCOMPARE( parallel, sequential );
+}
+
 QTEST_MAIN( TestQgsRasterLayer )
 #include "moc_testqgsrasterlayer.cxx"
@@ -0,0 +1,159 @@
+/***************************************************************************
+     testqgsrasterprojector.cpp
+     --------------------------------------
+    Date                 : January 2014
+    Copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include <QtTest>
+#include <QObject>
+
+#include <qgsapplication.h>
+#include <qgscoordinatereferencesystem.h>
+#include <qgscoordinatetransform.h>
+#include <qgsrasterblock.h>
+#include <qgsrasterinterface.h>
+//header for class being tested
+#include <qgsrasterprojector.h>
+
+/** Source raster with the position of each pixel in the requested block as value */
+class TestPixelIndexInput : public QgsRasterInterface
+{
+  public:
+    TestPixelIndexInput( const QgsRectangle& extent ) : QgsRasterInterface( 0 ), mExtent( extent ) {}
+
+    QgsRasterInterface *clone() const { return new TestPixelIndexInput( mExtent ); }
+    QGis::DataType dataType( int bandNo ) const { Q_UNUSED( bandNo ); return QGis::Int32; }
+    int bandCount() const { return 1; }
+    QgsRectangle extent() { return mExtent; }
+
+    QgsRasterBlock *block( int bandNo, const QgsRectangle &extent, int width, int height )
+    {
+      Q_UNUSED( bandNo );
+      Q_UNUSED( extent );
+      QgsRasterBlock *block = new QgsRasterBlock( QGis::Int32, width, height );
+      for ( int i = 0; i < height; ++i )
+      {
+        for ( int j = 0; j < width; ++j )
+        {
+          block->setValue( i, j, i * width + j );
+        }
+      }
+      return block;
+    }
+
+  private:
+    QgsRectangle mExtent;
+};
+
+/** \ingroup UnitTests
+ * This is a unit test for the grid cache and the precomputed index maps of QgsRasterProjector.
+ */
+class TestQgsRasterProjector: public QObject
+{
+    Q_OBJECT;
+  private slots:
+    void initTestCase();
+
+    void indexMap();
+    void gridCache();
+
+  private:
+    /** Destination extent of the given geographic rectangle */
+    QgsRectangle destExtent( const QgsRectangle& rect ) const;
+
+    QgsCoordinateReferenceSystem mSrcCrs;
+    QgsCoordinateReferenceSystem mDestCrs;
+    QgsRectangle mSrcExtent;
+};
+
+void TestQgsRasterProjector::initTestCase()
+{
+  QgsApplication::init();
+  QgsApplication::initQgis();
+
+  mSrcCrs.createFromOgcWmsCrs( "EPSG:4326" );
+  // plate carree, the approximation of the linear transformation is exact
+  mDestCrs.createFromOgcWmsCrs( "EPSG:32662" );
+  QVERIFY( mSrcCrs.isValid() );
+  QVERIFY( mDestCrs.isValid() );
+  mSrcExtent = QgsRectangle( 0, 0, 10, 10 );
+}
+
+QgsRectangle TestQgsRasterProjector::destExtent( const QgsRectangle& rect ) const
+{
+  QgsCoordinateTransform ct( mSrcCrs, mDestCrs );
+  return ct.transformBoundingBox( rect );
+}
+
+void TestQgsRasterProjector::indexMap()
+{
+  TestPixelIndexInput input( mSrcExtent );
+  // four destination pixels per source pixel, the destination centers are not on source pixel borders
+  QgsRasterProjector projector( mSrcCrs, mDestCrs, 0.5, 0.5, mSrcExtent );
+  projector.setInput( &input );
+  QgsRectangle extent = destExtent( QgsRectangle( 1, 1, 9, 9 ) );
+
+  QgsRasterBlock* calculated = projector.block( 1, extent, 64, 64 );
+  projector.setPrecomputeIndexMap( true );
+  QgsRasterBlock* precomputed = projector.block( 1, extent, 64, 64 );
+  // the second request uses the index map of the grid cache
+  QgsRasterBlock* cached = projector.block( 1, extent, 64, 64 );
+
+  QVERIFY( calculated->isValid() );
+  QVERIFY( precomputed->isValid() );
+  QVERIFY( cached->isValid() );
+  QVERIFY( calculated->value( 0, 0 ) != calculated->value( 63, 63 ) );
+  for ( int i = 0; i < 64; ++i )
+  {
+    for ( int j = 0; j < 64; ++j )
+    {
+      QCOMPARE( precomputed->value( i, j ), calculated->value( i, j ) );
+      QCOMPARE( cached->value( i, j ), calculated->value( i, j ) );
+    }
+  }
+
+  delete calculated;
+  delete precomputed;
+  delete cached;
+}
+
+void TestQgsRasterProjector::gridCache()
+{
+  TestPixelIndexInput input( mSrcExtent );
+  QgsRectangle extent = destExtent( QgsRectangle( 2, 2, 8, 8 ) );
+  int hits, misses, hitsBefore, missesBefore;
+  QgsRasterProjector::gridCacheStatistics( hitsBefore, missesBefore );
+
+  QgsRasterProjector projector( mSrcCrs, mDestCrs, 0.5, 0.5, mSrcExtent );
+  projector.setInput( &input );
+  delete projector.block( 1, extent, 32, 32 );
+  QgsRasterProjector::gridCacheStatistics( hits, misses );
+  QCOMPARE( hits, hitsBefore );
+  QCOMPARE( misses, missesBefore + 1 );
+
+  // the stored grid is shared by all projectors
+  QgsRasterProjector other( mSrcCrs, mDestCrs, 0.5, 0.5, mSrcExtent );
+  other.setInput( &input );
+  delete other.block( 1, extent, 32, 32 );
+  delete projector.block( 1, extent, 32, 32 );
+  QgsRasterProjector::gridCacheStatistics( hits, misses );
+  QCOMPARE( hits, hitsBefore + 2 );
+  QCOMPARE( misses, missesBefore + 1 );
+
+  // another destination grid is calculated again
+  delete projector.block( 1, extent, 48, 32 );
+  QgsRasterProjector::gridCacheStatistics( hits, misses );
+  QCOMPARE( hits, hitsBefore + 2 );
+  QCOMPARE( misses, missesBefore + 2 );
+}
+
+QTEST_MAIN( TestQgsRasterProjector )
+
+#include "moc_testqgsrasterprojector.cxx"
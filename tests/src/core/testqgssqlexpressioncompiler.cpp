@@ -0,0 +1,157 @@
+/***************************************************************************
+     testqgssqlexpressioncompiler.cpp
+     --------------------------------------
+    Date                 : January 2014
+    Copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include <QtTest>
+#include <QObject>
+#include <QString>
+#include <qgsapplication.h>
+//header for class being tested
+#include <qgssqlexpressioncompiler.h>
+
+class TestQgsSqlExpressionCompiler: public QObject
+{
+    Q_OBJECT;
+  private slots:
+
+    void initTestCase()
+    {
+      QgsApplication::init();
+      QgsApplication::initQgis();
+
+      mFields.append( QgsField( "num", QVariant::Int ) );
+      mFields.append( QgsField( "big", QVariant::LongLong ) );
+      mFields.append( QgsField( "dbl", QVariant::Double ) );
+      mFields.append( QgsField( "name", QVariant::String ) );
+      mFields.append( QgsField( "dt", QVariant::Date ) );
+    }
+
+    void compile_data()
+    {
+      QTest::addColumn<QString>( "expression" );
+      QTest::addColumn<int>( "result" );
+      QTest::addColumn<QString>( "sql" );
+
+      QTest::newRow( "numeric comparison" ) << "num > 5" << ( int ) QgsSqlExpressionCompiler::Complete << "(\"num\" > 5)";
+      QTest::newRow( "double literal" ) << "dbl <= 0.5" << ( int ) QgsSqlExpressionCompiler::Complete << "(\"dbl\" <= 0.5)";
+      QTest::newRow( "string equality" ) << "name = 'abc'" << ( int ) QgsSqlExpressionCompiler::Complete << "(\"name\" = 'abc')";
+      QTest::newRow( "quoted string" ) << "name <> 'it''s'" << ( int ) QgsSqlExpressionCompiler::Complete << "(\"name\" <> 'it''s')";
+      QTest::newRow( "and" ) << "num > 5 and name = 'abc'" << ( int ) QgsSqlExpressionCompiler::Complete << "(\"num\" > 5) AND (\"name\" = 'abc')";
+      QTest::newRow( "or" ) << "num > 5 or name = 'abc'" << ( int ) QgsSqlExpressionCompiler::Complete << "((\"num\" > 5) OR (\"name\" = 'abc'))";
+      QTest::newRow( "not" ) << "not num = 1" << ( int ) QgsSqlExpressionCompiler::Complete << "(NOT (\"num\" = 1))";
+      QTest::newRow( "in" ) << "num in (1,2,NULL)" << ( int ) QgsSqlExpressionCompiler::Complete << "(\"num\" IN (1,2,NULL))";
+      QTest::newRow( "not in" ) << "name not in ('a','b')" << ( int ) QgsSqlExpressionCompiler::Complete << "(\"name\" NOT IN ('a','b'))";
+      QTest::newRow( "is null" ) << "name is null" << ( int ) QgsSqlExpressionCompiler::Complete << "(\"name\" IS NULL)";
+      QTest::newRow( "is not null" ) << "num is not null" << ( int ) QgsSqlExpressionCompiler::Complete << "(\"num\" IS NOT NULL)";
+      QTest::newRow( "like" ) << "name like 'a%'" << ( int ) QgsSqlExpressionCompiler::Complete << "(\"name\" LIKE 'a%')";
+      QTest::newRow( "not ilike" ) << "name not ilike 'A_'" << ( int ) QgsSqlExpressionCompiler::Complete << "(\"name\" NOT ILIKE 'A_')";
+      QTest::newRow( "64bit equality" ) << "big = 3" << ( int ) QgsSqlExpressionCompiler::Complete << "(\"big\" = 3)";
+
+      // only the translatable AND operands
+      QTest::newRow( "partial" ) << "num > 5 and $area > 10" << ( int ) QgsSqlExpressionCompiler::Partial << "(\"num\" > 5)";
+      QTest::newRow( "partial nested" ) << "name = 'a' and (dbl < 1 and num % 2 = 0)" << ( int ) QgsSqlExpressionCompiler::Partial << "(\"name\" = 'a') AND (\"dbl\" < 1)";
+
+      // different semantics of QgsExpression and SQL
+      QTest::newRow( "numeric string" ) << "name = '5'" << ( int ) QgsSqlExpressionCompiler::Fail << "";
+      QTest::newRow( "string ordering" ) << "name < 'b'" << ( int ) QgsSqlExpressionCompiler::Fail << "";
+      QTest::newRow( "string columns" ) << "name = name" << ( int ) QgsSqlExpressionCompiler::Fail << "";
+      QTest::newRow( "string and number" ) << "name = 5" << ( int ) QgsSqlExpressionCompiler::Fail << "";
+      QTest::newRow( "64bit ordering" ) << "big > 3" << ( int ) QgsSqlExpressionCompiler::Fail << "";
+      QTest::newRow( "64bit and double" ) << "big = 3.5" << ( int ) QgsSqlExpressionCompiler::Fail << "";
+      QTest::newRow( "like escape" ) << "name like 'a\\\\%'" << ( int ) QgsSqlExpressionCompiler::Fail << "";
+      QTest::newRow( "arithmetic" ) << "num + 1 > 5" << ( int ) QgsSqlExpressionCompiler::Fail << "";
+      QTest::newRow( "or with unsupported operand" ) << "num > 5 or $area > 10" << ( int ) QgsSqlExpressionCompiler::Fail << "";
+      QTest::newRow( "unknown column" ) << "missing = 1" << ( int ) QgsSqlExpressionCompiler::Fail << "";
+      QTest::newRow( "unsupported type" ) << "dt is null" << ( int ) QgsSqlExpressionCompiler::Fail << "";
+      QTest::newRow( "not boolean" ) << "num" << ( int ) QgsSqlExpressionCompiler::Fail << "";
+      QTest::newRow( "unmapped function" ) << "lower(name) = 'a'" << ( int ) QgsSqlExpressionCompiler::Fail << "";
+      QTest::newRow( "condition" ) << "case when num > 1 then 1 else 0 end = 1" << ( int ) QgsSqlExpressionCompiler::Fail << "";
+    }
+
+    void compile()
+    {
+      QFETCH( QString, expression );
+      QFETCH( int, result );
+      QFETCH( QString, sql );
+
+      QgsExpression exp( expression );
+      QVERIFY( !exp.hasParserError() );
+
+      QgsSqlExpressionCompiler compiler( mFields );
+      QCOMPARE(( int ) compiler.compile( &exp ), result );
+      QCOMPARE( compiler.result(), sql );
+    }
+
+    void caseInsensitiveDatabase()
+    {
+      QgsExpression eq( "name = 'abc'" );
+      QgsExpression like( "name like 'a%'" );
+      QgsExpression ilike( "name ilike 'a%'" );
+      QgsExpression ilikeNonAscii( QString::fromUtf8( "name ilike '\xc3\xa4%'" ) );
+
+      QgsSqlExpressionCompiler caseInsensitiveLike( mFields, QgsSqlExpressionCompiler::LikeIsCaseInsensitive );
+      QCOMPARE( caseInsensitiveLike.compile( &eq ), QgsSqlExpressionCompiler::Complete );
+      QCOMPARE( caseInsensitiveLike.compile( &like ), QgsSqlExpressionCompiler::Fail );
+      QCOMPARE( caseInsensitiveLike.compile( &ilike ), QgsSqlExpressionCompiler::Complete );
+      QCOMPARE( caseInsensitiveLike.result(), QString( "(\"name\" LIKE 'a%')" ) );
+      QCOMPARE( caseInsensitiveLike.compile( &ilikeNonAscii ), QgsSqlExpressionCompiler::Fail );
+
+      QgsSqlExpressionCompiler caseInsensitive( mFields, QgsSqlExpressionCompiler::CaseInsensitiveStringMatch );
+      QCOMPARE( caseInsensitive.compile( &eq ), QgsSqlExpressionCompiler::Fail );
+      QCOMPARE( caseInsensitive.compile( &ilike ), QgsSqlExpressionCompiler::Fail );
+    }
+
+    void noEmptyStrings()
+    {
+      QgsExpression exp( "name = ''" );
+
+      QgsSqlExpressionCompiler compiler( mFields );
+      QCOMPARE( compiler.compile( &exp ), QgsSqlExpressionCompiler::Complete );
+
+      QgsSqlExpressionCompiler oracleLike( mFields, QgsSqlExpressionCompiler::NoEmptyStrings );
+      QCOMPARE( oracleLike.compile( &exp ), QgsSqlExpressionCompiler::Fail );
+    }
+
+    void compileOrderBy()
+    {
+      QgsSqlExpressionCompiler compiler( mFields );
+      QCOMPARE( compiler.compileOrderBy( QgsFeatureRequest().addOrderBy( "num" ).addOrderBy( "name", false ).orderBy() ), QgsSqlExpressionCompiler::Complete );
+      QCOMPARE( compiler.result(), QString( "\"num\" ASC NULLS LAST,\"name\" DESC NULLS FIRST" ) );
+      QCOMPARE( compiler.compileOrderBy( QgsFeatureRequest().addOrderBy( "big", true, true ).orderBy() ), QgsSqlExpressionCompiler::Complete );
+      QCOMPARE( compiler.result(), QString( "\"big\" ASC NULLS FIRST" ) );
+
+      // all the clauses or nothing
+      QCOMPARE( compiler.compileOrderBy( QgsFeatureRequest().addOrderBy( "num" ).addOrderBy( "dt" ).orderBy() ), QgsSqlExpressionCompiler::Fail );
+      QCOMPARE( compiler.result(), QString() );
+      QCOMPARE( compiler.compileOrderBy( QgsFeatureRequest().addOrderBy( "num > 1" ).orderBy() ), QgsSqlExpressionCompiler::Fail );
+      QCOMPARE( compiler.compileOrderBy( QgsFeatureRequest().addOrderBy( "$area" ).orderBy() ), QgsSqlExpressionCompiler::Fail );
+      QCOMPARE( compiler.compileOrderBy( QgsFeatureRequest::OrderBy() ), QgsSqlExpressionCompiler::Fail );
+
+      // databases without NULLS FIRST / LAST
+      QgsSqlExpressionCompiler nullsFirst( mFields, QgsSqlExpressionCompiler::NullsSortFirst );
+      QCOMPARE( nullsFirst.compileOrderBy( QgsFeatureRequest().addOrderBy( "num", true, true ).addOrderBy( "dbl", false, false ).orderBy() ), QgsSqlExpressionCompiler::Complete );
+      QCOMPARE( nullsFirst.result(), QString( "\"num\" ASC,\"dbl\" DESC" ) );
+      QCOMPARE( nullsFirst.compileOrderBy( QgsFeatureRequest().addOrderBy( "num" ).orderBy() ), QgsSqlExpressionCompiler::Complete );
+      QCOMPARE( nullsFirst.result(), QString( "CASE WHEN \"num\" IS NULL THEN 1 ELSE 0 END ASC,\"num\" ASC" ) );
+
+      // the collation decides the order of strings
+      QgsSqlExpressionCompiler caseInsensitive( mFields, QgsSqlExpressionCompiler::CaseInsensitiveStringMatch );
+      QCOMPARE( caseInsensitive.compileOrderBy( QgsFeatureRequest().addOrderBy( "name" ).orderBy() ), QgsSqlExpressionCompiler::Fail );
+    }
+
+  private:
+    QgsFields mFields;
+};
+
+QTEST_MAIN( TestQgsSqlExpressionCompiler )
+
+#include "moc_testqgssqlexpressioncompiler.cxx"
@@ -0,0 +1,116 @@
+/***************************************************************************
+     testqgstilecache.cpp
+     --------------------------------------
+    Date                 : January 2014
+    Copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include <QtTest>
+#include <QObject>
+#include <QString>
+#include <QBuffer>
+#include <QColor>
+#include <QDateTime>
+#include <QDir>
+#include <QImage>
+#include <QNetworkDiskCache>
+#include <qgsapplication.h>
+#include <qgsnetworkaccessmanager.h>
+//header for class being tested
+#include <qgstilecache.h>
+
+class TestQgsTileCache: public QObject
+{
+    Q_OBJECT;
+  private slots:
+
+    void initTestCase()
+    {
+      QgsApplication::init();
+      QgsApplication::initQgis();
+
+      // the disk cache the tile replies would be stored in
+      mCacheDir = QDir::tempPath() + "/qgis_test_tilecache";
+      QNetworkDiskCache *cache = new QNetworkDiskCache( this );
+      cache->setCacheDirectory( mCacheDir );
+      cache->clear();
+      QgsNetworkAccessManager::instance()->setCache( cache );
+    }
+
+    void cleanupTestCase()
+    {
+      QgsNetworkAccessManager::instance()->cache()->clear();
+    }
+
+    void memory()
+    {
+      QUrl url( "http://tiles.invalid/wmts/layer/matrix/0/1/2.png" );
+      QImage image;
+      QVERIFY( !QgsTileCache::tile( url, image ) );
+
+      QgsTileCache::insertTile( url, tileImage( Qt::red ) );
+      QVERIFY( QgsTileCache::tile( url, image ) );
+      QCOMPARE( image.pixel( 10, 10 ), QColor( Qt::red ).rgb() );
+      QVERIFY( QgsTileCache::totalCost() > 0 );
+      QVERIFY( QgsTileCache::totalCost() <= QgsTileCache::maxCost() );
+    }
+
+    void disk()
+    {
+      // a tile which was downloaded in an earlier session
+      QUrl url( "http://tiles.invalid/wmts/layer/matrix/0/1/3.png" );
+      storeReply( url, tileImage( Qt::blue ), QDateTime::currentDateTime().addSecs( 3600 ) );
+
+      QImage image;
+      QVERIFY( QgsTileCache::tile( url, image ) );
+      QCOMPARE( image.pixel( 10, 10 ), QColor( Qt::blue ).rgb() );
+    }
+
+    void expired()
+    {
+      QUrl url( "http://tiles.invalid/wmts/layer/matrix/0/1/4.png" );
+      storeReply( url, tileImage( Qt::green ), QDateTime::currentDateTime().addSecs( -3600 ) );
+
+      QImage image;
+      QVERIFY( !QgsTileCache::tile( url, image ) );
+    }
+
+  private:
+    static QImage tileImage( Qt::GlobalColor color )
+    {
+      QImage image( 256, 256, QImage::Format_ARGB32 );
+      image.fill( QColor( color ).rgb() );
+      return image;
+    }
+
+    static void storeReply( const QUrl& url, const QImage& image, const QDateTime& expirationDate )
+    {
+      QAbstractNetworkCache *cache = QgsNetworkAccessManager::instance()->cache();
+
+      QNetworkCacheMetaData metaData;
+      metaData.setUrl( url );
+      metaData.setSaveToDisk( true );
+      metaData.setExpirationDate( expirationDate );
+
+      QIODevice *device = cache->prepare( metaData );
+      QVERIFY( device );
+      QByteArray data;
+      QBuffer buffer( &data );
+      buffer.open( QIODevice::WriteOnly );
+      image.save( &buffer, "PNG" );
+      device->write( data );
+      cache->insert( device );
+    }
+
+    QString mCacheDir;
+};
+
+QTEST_MAIN( TestQgsTileCache )
+
+#include "moc_testqgstilecache.cxx"
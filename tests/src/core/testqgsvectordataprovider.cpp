@@ -48,6 +48,20 @@ class TestQgsVectorDataProvider : public QObject
 
     void featureAtId();
 
+    // test fetching of features in batches
+    void select_batched_data();
+    void select_batched();
+    void select_batchedSubset_data();
+    void select_batchedSubset();
+
+    // test sorted and limited requests
+    void select_orderBy_data();
+    void select_orderBy();
+    void select_orderBySubset();
+
+    void benchmark_nextFeatures_data();
+    void benchmark_nextFeatures();
+
   private:
 
     QgsVectorLayer* vlayerPoints;
@@ -226,6 +240,190 @@ void TestQgsVectorDataProvider::featureAtId()
   QVERIFY( !feature.isValid() );
 }
 
+void TestQgsVectorDataProvider::select_batched_data()
+{
+  select_checkContents_data();
+}
+
+void TestQgsVectorDataProvider::select_batched()
+{
+  QFETCH( QgsFeatureRequest, request );
+  QFETCH( int, count );
+  QFETCH( bool, hasGeometry );
+  QFETCH( bool, hasAttributes );
+  QFETCH( int, onlyOneAttribute );
+
+  QgsVectorDataProvider* pr = vlayerPoints->dataProvider();
+  QgsFeatureIterator fi = pr->getFeatures( request );
+
+  // batches not dividing the number of features, the features are reused
+  bool foundFid4 = false;
+  int realCount = 0;
+  int batches = 0;
+  QgsFeatureList features;
+  int n;
+  while (( n = fi.nextFeatures( features, 5 ) ) > 0 )
+  {
+    QCOMPARE( features.count(), n );
+    for ( int i = 0; i < n; ++i )
+    {
+      QVERIFY( features[i].isValid() );
+      if ( features[i].id() == 4 )
+      {
+        checkFid4( features[i], hasGeometry, hasAttributes, onlyOneAttribute );
+        foundFid4 = true;
+      }
+    }
+    realCount += n;
+    batches++;
+  }
+
+  QCOMPARE( realCount, count );
+  QCOMPARE( batches, ( count + 4 ) / 5 );
+  QVERIFY( features.isEmpty() );
+  QVERIFY( foundFid4 );
+
+  // the layer's iterator gives the same features
+  fi = vlayerPoints->getFeatures( request );
+  QCOMPARE( fi.nextFeatures( features, 100 ), count );
+  QVERIFY( fi.isClosed() );
+}
+
+void TestQgsVectorDataProvider::select_batchedSubset_data()
+{
+  select_checkSubset_data();
+
+  QTest::newRow( "expression" ) << QgsFeatureRequest().setFilterExpression( "\"Name\" = 'Highway'" ) << 2;
+  QTest::newRow( "fids" ) << QgsFeatureRequest().setFilterFids( QgsFeatureIds() << 1 << 3 << 5 << 100 ) << 3;
+  QTest::newRow( "fid" ) << QgsFeatureRequest().setFilterFid( 4 ) << 1;
+}
+
+void TestQgsVectorDataProvider::select_batchedSubset()
+{
+  QFETCH( QgsFeatureRequest, request );
+  QFETCH( int, count );
+
+  QgsVectorDataProvider* pr = vlayerLines->dataProvider();
+  QgsFeatureIterator fi = pr->getFeatures( request );
+
+  int realCount = 0;
+  QgsFeatureList features;
+  while ( int n = fi.nextFeatures( features, 2 ) )
+  {
+    realCount += n;
+  }
+
+  QCOMPARE( realCount, count );
+}
+
+static QString fetchedIds( QgsFeatureIterator fi, int batchSize )
+{
+  QStringList ids;
+  QgsFeatureList features;
+  QgsFeature f;
+  while ( batchSize > 0 ? fi.nextFeatures( features, batchSize ) > 0 : fi.nextFeature( f ) )
+  {
+    if ( batchSize == 0 )
+      features = QgsFeatureList() << f;
+
+    foreach ( const QgsFeature& feature, features )
+      ids << QString::number( feature.id() );
+  }
+  return ids.join( "," );
+}
+
+void TestQgsVectorDataProvider::select_orderBy_data()
+{
+  QTest::addColumn<QgsFeatureRequest>( "request" );
+  QTest::addColumn<QString>( "ids" );
+
+  // features with the same heading keep their order
+  QTest::newRow( "ascending" ) << QgsFeatureRequest().addOrderBy( "Heading" ).setLimit( 6 ) << "1,9,10,11,12,2";
+  QTest::newRow( "descending" ) << QgsFeatureRequest().addOrderBy( "Heading", false ).setLimit( 3 ) << "5,6,7";
+  // sorted by OGR SQL
+  QTest::newRow( "descending nulls last" ) << QgsFeatureRequest().addOrderBy( "Heading", false, false ).setLimit( 3 ) << "5,6,7";
+  QTest::newRow( "two clauses" ) << QgsFeatureRequest().addOrderBy( "Class" ).addOrderBy( "Heading", false ).setLimit( 4 ) << "12,11,10,9";
+  QTest::newRow( "expression" ) << QgsFeatureRequest().addOrderBy( "Pilots * 10 + Staff", false ).setLimit( 2 ) << "7,1";
+  QTest::newRow( "filter" ) << QgsFeatureRequest().setFilterExpression( "Class = 'B52'" ).addOrderBy( "Heading", false ) << "12,11,10,9";
+  QTest::newRow( "filter and limit" ) << QgsFeatureRequest().setFilterExpression( "Class = 'Jet'" ).setLimit( 2 ) << "0,2";
+  QTest::newRow( "no geometry" ) << QgsFeatureRequest().setFlags( QgsFeatureRequest::NoGeometry ).setLimit( 3 ) << "0,1,2";
+  QTest::newRow( "limit 0" ) << QgsFeatureRequest().addOrderBy( "Heading" ).setLimit( 0 ) << "";
+}
+
+void TestQgsVectorDataProvider::select_orderBy()
+{
+  QFETCH( QgsFeatureRequest, request );
+  QFETCH( QString, ids );
+
+  QgsVectorDataProvider* pr = vlayerPoints->dataProvider();
+  QCOMPARE( fetchedIds( pr->getFeatures( request ), 0 ), ids );
+  QCOMPARE( fetchedIds( pr->getFeatures( request ), 2 ), ids );
+  QCOMPARE( fetchedIds( vlayerPoints->getFeatures( request ), 0 ), ids );
+  QCOMPARE( fetchedIds( vlayerPoints->getFeatures( request ), 2 ), ids );
+}
+
+void TestQgsVectorDataProvider::select_orderBySubset()
+{
+  // the layer fetches the attributes needed for sorting
+  QgsFeatureRequest request;
+  request.setSubsetOfAttributes( QgsAttributeList() << 0 ).addOrderBy( "Heading", false ).setLimit( 3 );
+  QCOMPARE( fetchedIds( vlayerPoints->getFeatures( request ), 0 ), QString( "5,6,7" ) );
+
+  // sorted locally with the edit buffer
+  QVERIFY( vlayerPoints->startEditing() );
+  QVERIFY( vlayerPoints->changeAttributeValue( 3, 1, 500 ) );
+  QCOMPARE( fetchedIds( vlayerPoints->getFeatures( request ), 0 ), QString( "3,5,6" ) );
+  QVERIFY( vlayerPoints->rollBack() );
+}
+
+void TestQgsVectorDataProvider::benchmark_nextFeatures_data()
+{
+  QTest::addColumn<bool>( "batched" );
+
+  QTest::newRow( "nextFeature" ) << false;
+  QTest::newRow( "nextFeatures" ) << true;
+}
+
+void TestQgsVectorDataProvider::benchmark_nextFeatures()
+{
+  QFETCH( bool, batched );
+
+  QgsVectorLayer layer( "Point?field=id:integer&field=name:string(20)", "benchmark", "memory" );
+  QVERIFY( layer.isValid() );
+
+  QgsFeatureList newFeatures;
+  for ( int i = 0; i < 100000; ++i )
+  {
+    QgsFeature f( layer.pendingFields() );
+    f.setAttribute( 0, i );
+    f.setAttribute( 1, QString( "feature %1" ).arg( i ) );
+    f.setGeometry( QgsGeometry::fromPoint( QgsPoint( i % 1000, i / 1000 ) ) );
+    newFeatures << f;
+  }
+  QVERIFY( layer.dataProvider()->addFeatures( newFeatures ) );
+
+  int count = 0;
+  QBENCHMARK
+  {
+    count = 0;
+    QgsFeatureIterator fi = layer.getFeatures( QgsFeatureRequest().setFilterRect( QgsRectangle( 0, 0, 1000, 100 ) ) );
+    if ( batched )
+    {
+      QgsFeatureList features;
+      while ( int n = fi.nextFeatures( features ) )
+        count += n;
+    }
+    else
+    {
+      QgsFeature f;
+      while ( fi.nextFeature( f ) )
+        count++;
+    }
+  }
+
+  QCOMPARE( count, 100000 );
+}
+
 
 QTEST_MAIN( TestQgsVectorDataProvider )
 
@@ -0,0 +1,237 @@
+/***************************************************************************
+     testqgsgeotiffstreamwriter.cpp
+     --------------------------------------
+    Date                 : January 2014
+    Copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include <QtTest>
+#include <QObject>
+#include <QDir>
+#include <QString>
+#include <QTemporaryFile>
+#include <qgsapplication.h>
+#include <qgsrasterblock.h>
+#include <qgsrasterdataprovider.h>
+#include <qgsrasterlayer.h>
+#include <qgsrasterpipe.h>
+#include <qgsrequesthandler.h>
+//header for class being tested
+#include <qgsgeotiffstreamwriter.h>
+
+#include <gdal.h>
+#include <ogr_srs_api.h>
+
+/**Collects the GetCoverage output*/
+class TestRequestHandler: public QgsRequestHandler
+{
+  public:
+    TestRequestHandler(): mSize( -1 ) {}
+    QMap<QString, QString> parseInput() { return QMap<QString, QString>(); }
+    void sendGetMapResponse( const QString&, QImage* ) const {}
+    void sendGetCapabilitiesResponse( const QDomDocument& ) const {}
+    void sendGetFeatureInfoResponse( const QDomDocument&, const QString& ) const {}
+    void sendServiceException( const QgsMapServiceException& ) const {}
+    void sendGetStyleResponse( const QDomDocument& ) const {}
+    void sendGetPrintResponse( QByteArray* ) const {}
+    bool startGetFeatureResponse( QByteArray*, const QString& ) const { return true; }
+    void sendGetFeatureResponse( QByteArray* ) const {}
+    void endGetFeatureResponse( QByteArray* ) const {}
+    void sendGetCoverageResponse( QByteArray* ) const {}
+    bool startGetCoverageResponse( QByteArray* ba, qint64 size ) const { mOutput = *ba; mSize = size; return true; }
+    void sendGetCoverageResponsePart( QByteArray* ba ) const { mOutput.append( *ba ); }
+
+    mutable QByteArray mOutput;
+    mutable qint64 mSize;
+};
+
+/** \ingroup UnitTests
+ * This is a unit test for the GeoTIFF output of WCS GetCoverage without GDAL.
+ * The written files are read back with GDAL.
+ */
+class TestQgsGeoTiffStreamWriter: public QObject
+{
+    Q_OBJECT;
+  private slots:
+    void initTestCase();
+
+    void roundTrip_data();
+    void roundTrip();
+    void subset();
+
+  private:
+    /**Writes the coverage and opens it with GDAL*/
+    GDALDatasetH writeAndOpen( QgsRasterLayer* layer, int width, int height, const QgsRectangle& extent, QTemporaryFile& file );
+
+    QString mTestDataDir;
+};
+
+void TestQgsGeoTiffStreamWriter::initTestCase()
+{
+  QgsApplication::init();
+  QgsApplication::initQgis();
+  GDALAllRegister();
+  mTestDataDir = QString( TEST_DATA_DIR ) + QDir::separator() + "raster" + QDir::separator();
+}
+
+GDALDatasetH TestQgsGeoTiffStreamWriter::writeAndOpen( QgsRasterLayer* layer, int width, int height, const QgsRectangle& extent, QTemporaryFile& file )
+{
+  QgsRasterPipe pipe;
+  if ( !pipe.set( layer->dataProvider()->clone() ) )
+  {
+    return 0;
+  }
+
+  QgsGeoTiffStreamWriter writer( &pipe, width, height, extent, layer->crs() );
+  if ( !writer.isStreamable() )
+  {
+    return 0;
+  }
+
+  TestRequestHandler request;
+  writer.write( request );
+  if ( request.mSize != writer.size() || request.mOutput.size() != writer.size() )
+  {
+    return 0;
+  }
+
+  if ( !file.open() )
+  {
+    return 0;
+  }
+  file.write( request.mOutput );
+  file.close();
+  return GDALOpen( file.fileName().toLocal8Bit().constData(), GA_ReadOnly );
+}
+
+void TestQgsGeoTiffStreamWriter::roundTrip_data()
+{
+  QTest::addColumn<QString>( "fileName" );
+
+  QTest::newRow( "byte" ) << "band1_byte_noct_epsg4326.tif";
+  QTest::newRow( "int16" ) << "band1_int16_noct_epsg4326.tif";
+  QTest::newRow( "float32" ) << "band1_float32_noct_epsg4326.tif";
+  QTest::newRow( "3 bands int16" ) << "band3_int16_noct_epsg4326.tif";
+  QTest::newRow( "3 bands float32" ) << "band3_float32_noct_epsg4326.tif";
+}
+
+void TestQgsGeoTiffStreamWriter::roundTrip()
+{
+  QFETCH( QString, fileName );
+
+  QgsRasterLayer layer( mTestDataDir + fileName, fileName, "gdal" );
+  QVERIFY( layer.isValid() );
+  QgsRasterDataProvider* provider = layer.dataProvider();
+  int width = layer.width();
+  int height = layer.height();
+  QgsRectangle extent = layer.extent();
+
+  QTemporaryFile file( QDir::tempPath() + QDir::separator() + "qgis_geotiff_XXXXXX.tif" );
+  GDALDatasetH ds = writeAndOpen( &layer, width, height, extent, file );
+  QVERIFY( ds );
+
+  // size
+  QCOMPARE( GDALGetRasterXSize( ds ), width );
+  QCOMPARE( GDALGetRasterYSize( ds ), height );
+  QCOMPARE( GDALGetRasterCount( ds ), provider->bandCount() );
+
+  // geotransform
+  double gt[6];
+  QCOMPARE( GDALGetGeoTransform( ds, gt ), CE_None );
+  QVERIFY( qgsDoubleNear( gt[0], extent.xMinimum(), 1e-9 ) );
+  QVERIFY( qgsDoubleNear( gt[1], extent.width() / width, 1e-12 ) );
+  QVERIFY( qgsDoubleNear( gt[2], 0.0 ) );
+  QVERIFY( qgsDoubleNear( gt[3], extent.yMaximum(), 1e-9 ) );
+  QVERIFY( qgsDoubleNear( gt[4], 0.0 ) );
+  QVERIFY( qgsDoubleNear( gt[5], -extent.height() / height, 1e-12 ) );
+
+  // crs
+  OGRSpatialReferenceH srs = OSRNewSpatialReference( GDALGetProjectionRef( ds ) );
+  QVERIFY( srs );
+  QCOMPARE( QString( OSRGetAuthorityName( srs, NULL ) ), QString( "EPSG" ) );
+  QCOMPARE( QString( OSRGetAuthorityCode( srs, NULL ) ), QString( "4326" ) );
+  OSRDestroySpatialReference( srs );
+
+  // data type, no data value and pixel values
+  GDALDatasetH srcDs = GDALOpen( QString( mTestDataDir + fileName ).toLocal8Bit().constData(), GA_ReadOnly );
+  QVERIFY( srcDs );
+  QVector<double> values( width * height );
+  for ( int band = 1; band <= provider->bandCount(); ++band )
+  {
+    GDALRasterBandH gdalBand = GDALGetRasterBand( ds, band );
+    QCOMPARE( GDALGetRasterDataType( gdalBand ), GDALGetRasterDataType( GDALGetRasterBand( srcDs, band ) ) );
+    QCOMPARE( GDALRasterIO( gdalBand, GF_Read, 0, 0, width, height, values.data(), width, height, GDT_Float64, 0, 0 ), CE_None );
+
+    int hasNoData = 0;
+    double noData = GDALGetRasterNoDataValue( gdalBand, &hasNoData );
+    QCOMPARE( hasNoData != 0, provider->srcHasNoDataValue( band ) );
+    if ( hasNoData )
+    {
+      QCOMPARE( noData, provider->srcNoDataValue( band ) );
+    }
+
+    QgsRasterBlock* block = provider->block( band, extent, width, height );
+    QVERIFY( block && block->isValid() );
+    for ( int i = 0; i < width * height; ++i )
+    {
+      if ( !block->isNoData( i ) && values[i] != block->value( i ) )
+      {
+        QFAIL( QString( "band %1 pixel %2: %3 instead of %4" ).arg( band ).arg( i ).arg( values[i] ).arg( block->value( i ) ).toLocal8Bit().constData() );
+      }
+    }
+    delete block;
+  }
+
+  GDALClose( srcDs );
+  GDALClose( ds );
+}
+
+void TestQgsGeoTiffStreamWriter::subset()
+{
+  // a part of the source resampled to several strips, the last one is smaller
+  QgsRasterLayer layer( mTestDataDir + "band1_float32_noct_epsg4326.tif", "float32", "gdal" );
+  QVERIFY( layer.isValid() );
+  QgsRectangle layerExtent = layer.extent();
+  QgsRectangle extent( layerExtent.xMinimum() + layerExtent.width() / 4, layerExtent.yMinimum() + layerExtent.height() / 4,
+                       layerExtent.xMaximum() - layerExtent.width() / 4, layerExtent.yMaximum() - layerExtent.height() / 4 );
+  int width = 600;
+  int height = 500;
+
+  QTemporaryFile file( QDir::tempPath() + QDir::separator() + "qgis_geotiff_XXXXXX.tif" );
+  GDALDatasetH ds = writeAndOpen( &layer, width, height, extent, file );
+  QVERIFY( ds );
+  QCOMPARE( GDALGetRasterXSize( ds ), width );
+  QCOMPARE( GDALGetRasterYSize( ds ), height );
+
+  double gt[6];
+  QCOMPARE( GDALGetGeoTransform( ds, gt ), CE_None );
+  QVERIFY( qgsDoubleNear( gt[0], extent.xMinimum(), 1e-9 ) );
+  QVERIFY( qgsDoubleNear( gt[3], extent.yMaximum(), 1e-9 ) );
+
+  QVector<float> values( width * height );
+  GDALRasterBandH gdalBand = GDALGetRasterBand( ds, 1 );
+  QCOMPARE( GDALGetRasterDataType( gdalBand ), GDT_Float32 );
+  QCOMPARE( GDALRasterIO( gdalBand, GF_Read, 0, 0, width, height, values.data(), width, height, GDT_Float32, 0, 0 ), CE_None );
+
+  QgsRasterBlock* block = layer.dataProvider()->block( 1, extent, width, height );
+  QVERIFY( block && block->isValid() );
+  for ( int i = 0; i < width * height; ++i )
+  {
+    if ( !block->isNoData( i ) && values[i] != ( float ) block->value( i ) )
+    {
+      QFAIL( QString( "pixel %1: %2 instead of %3" ).arg( i ).arg( values[i] ).arg( block->value( i ) ).toLocal8Bit().constData() );
+    }
+  }
+  delete block;
+  GDALClose( ds );
+}
+
+QTEST_MAIN( TestQgsGeoTiffStreamWriter )
+
+#include "moc_testqgsgeotiffstreamwriter.cxx"
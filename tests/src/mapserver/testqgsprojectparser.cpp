@@ -0,0 +1,169 @@
+/***************************************************************************
+     testqgsprojectparser.cpp
+     --------------------------------------
+    Date                 : January 2014
+    Copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include <QtTest>
+#include <QObject>
+#include <QDomDocument>
+#include <QString>
+#include <QStringList>
+#include <qgsapplication.h>
+//header for class being tested
+#include <qgsprojectparser.h>
+
+static const char* PROJECT =
+  "<qgis projectname=\"\" version=\"2.1.0\">"
+  "<title>Test project</title>"
+  "<maplayer type=\"vector\" geometry=\"Point\"><id>points_id</id><layername>my points</layername></maplayer>"
+  "<maplayer type=\"vector\" geometry=\"Line\"><id>lines_id</id><layername>lines</layername></maplayer>"
+  "<maplayer type=\"raster\"><id>raster_id</id><layername>my raster</layername></maplayer>"
+  "<properties>"
+  "<WMSUrl type=\"QString\">http://localhost/wms</WMSUrl>"
+  "<WFSUrl type=\"QString\">http://localhost/wfs</WFSUrl>"
+  "<WCSUrl type=\"QString\">http://localhost/wcs</WCSUrl>"
+  "<WMSExtent type=\"QStringList\"><value>-10</value><value>-5</value><value>10</value><value>5</value></WMSExtent>"
+  "<WMSCrsList type=\"QStringList\"><value>EPSG:4326</value><value>EPSG:3857</value></WMSCrsList>"
+  "<WMSAddWktGeometry type=\"QString\">true</WMSAddWktGeometry>"
+  "<WMSInfoFormatSIA2045 type=\"QString\">enabled</WMSInfoFormatSIA2045>"
+  "<WMSFeatureInfoDocumentElement type=\"QString\">Features</WMSFeatureInfoDocumentElement>"
+  "<WMSFeatureInfoDocumentElementNS type=\"QString\">http://localhost/ns</WMSFeatureInfoDocumentElementNS>"
+  "<WMSFeatureInfoSchema type=\"QString\">http://localhost/schema.xsd</WMSFeatureInfoSchema>"
+  "<WMSFeatureInfoAliasLayers type=\"QStringList\"><value>my points</value><value>lines</value></WMSFeatureInfoAliasLayers>"
+  "<WMSFeatureInfoLayerAliases type=\"QStringList\"><value>Points</value><value>Lines</value></WMSFeatureInfoLayerAliases>"
+  "<Identify><disabledLayers type=\"QStringList\"><value>lines_id</value></disabledLayers></Identify>"
+  "<WFSLayers type=\"QStringList\"><value>points_id</value><value>lines_id</value></WFSLayers>"
+  "<WFSLayersPrecision><points_id type=\"int\">3</points_id></WFSLayersPrecision>"
+  "<WFSTLayers>"
+  "<Update type=\"QStringList\"><value>points_id</value><value>lines_id</value><value>raster_id</value></Update>"
+  "<Insert type=\"QStringList\"><value>points_id</value></Insert>"
+  "<Delete type=\"QStringList\"><value>points_id</value><value>lines_id</value></Delete>"
+  "</WFSTLayers>"
+  "<WCSLayers type=\"QStringList\"><value>raster_id</value></WCSLayers>"
+  "</properties>"
+  "</qgis>";
+
+/** \ingroup UnitTests
+ * This is a unit test for the project settings read by the server project parser.
+ */
+class TestQgsProjectParser: public QObject
+{
+    Q_OBJECT;
+  private slots:
+    void initTestCase();
+
+    void serviceSettings();
+    void featureInfoSettings();
+    void publishedLayers();
+    void defaults();
+
+  private:
+    static QgsProjectParser* parser( const QString& xml );
+};
+
+void TestQgsProjectParser::initTestCase()
+{
+  QgsApplication::init();
+  QgsApplication::initQgis();
+}
+
+QgsProjectParser* TestQgsProjectParser::parser( const QString& xml )
+{
+  QDomDocument* doc = new QDomDocument();
+  if ( !doc->setContent( xml ) )
+  {
+    delete doc;
+    return 0;
+  }
+  return new QgsProjectParser( doc, "/tmp/testproject.qgs" );
+}
+
+void TestQgsProjectParser::serviceSettings()
+{
+  QgsProjectParser* p = parser( PROJECT );
+  QVERIFY( p );
+
+  QCOMPARE( p->projectTitle(), QString( "Test project" ) );
+  QCOMPARE( p->serviceUrl(), QString( "http://localhost/wms" ) );
+  QCOMPARE( p->wfsServiceUrl(), QString( "http://localhost/wfs" ) );
+  QCOMPARE( p->wcsServiceUrl(), QString( "http://localhost/wcs" ) );
+  QCOMPARE( p->mapRectangle(), QgsRectangle( -10, -5, 10, 5 ) );
+  QCOMPARE( p->supportedOutputCrsList(), QStringList() << "EPSG:4326" << "EPSG:3857" );
+  delete p;
+}
+
+void TestQgsProjectParser::featureInfoSettings()
+{
+  QgsProjectParser* p = parser( PROJECT );
+  QVERIFY( p );
+
+  QVERIFY( p->featureInfoWithWktGeometry() );
+  QVERIFY( p->featureInfoFormatSIA2045() );
+  QCOMPARE( p->featureInfoDocumentElement( "GetFeatureInfoResponse" ), QString( "Features" ) );
+  QCOMPARE( p->featureInfoDocumentElementNS(), QString( "http://localhost/ns" ) );
+  QCOMPARE( p->featureInfoSchema(), QString( "http://localhost/schema.xsd" ) );
+  QCOMPARE( p->identifyDisabledLayers(), QStringList() << "lines_id" );
+
+  QHash<QString, QString> aliases = p->featureInfoLayerAliasMap();
+  QCOMPARE( aliases.size(), 2 );
+  QCOMPARE( aliases.value( "my points" ), QString( "Points" ) );
+  QCOMPARE( aliases.value( "lines" ), QString( "Lines" ) );
+  delete p;
+}
+
+void TestQgsProjectParser::publishedLayers()
+{
+  QgsProjectParser* p = parser( PROJECT );
+  QVERIFY( p );
+
+  QCOMPARE( p->wfsLayers(), QStringList() << "points_id" << "lines_id" );
+  QCOMPARE( p->wfsLayerNames(), QStringList() << "my points" << "lines" );
+  QCOMPARE( p->wfsLayerPrecision( "points_id" ), 3 );
+  QCOMPARE( p->wfsLayerPrecision( "lines_id" ), 8 );
+
+  // update needs WFS, insert needs update and delete needs insert
+  QCOMPARE( p->wfstUpdateLayers(), QStringList() << "points_id" << "lines_id" );
+  QCOMPARE( p->wfstInsertLayers(), QStringList() << "points_id" );
+  QCOMPARE( p->wfstDeleteLayers(), QStringList() << "points_id" );
+
+  QCOMPARE( p->wcsLayers(), QStringList() << "raster_id" );
+  QCOMPARE( p->wcsLayerNames(), QStringList() << "my raster" );
+
+  // unpublished names are not looked up
+  QVERIFY( p->mapLayerFromTypeName( "my_raster" ).isEmpty() );
+  QVERIFY( p->mapLayerFromCoverage( "my_points" ).isEmpty() );
+  delete p;
+}
+
+void TestQgsProjectParser::defaults()
+{
+  QgsProjectParser* p = parser( "<qgis projectname=\"\" version=\"2.1.0\"><properties/></qgis>" );
+  QVERIFY( p );
+
+  QCOMPARE( p->projectTitle(), QString( "testproject" ) );
+  QVERIFY( p->serviceUrl().isEmpty() );
+  QVERIFY( p->wfsServiceUrl().isEmpty() );
+  QVERIFY( p->wcsServiceUrl().isEmpty() );
+  QVERIFY( p->mapRectangle().isEmpty() );
+  QVERIFY( !p->featureInfoWithWktGeometry() );
+  QVERIFY( !p->featureInfoFormatSIA2045() );
+  QCOMPARE( p->featureInfoDocumentElement( "GetFeatureInfoResponse" ), QString( "GetFeatureInfoResponse" ) );
+  QVERIFY( p->featureInfoDocumentElementNS().isEmpty() );
+  QVERIFY( p->featureInfoSchema().isEmpty() );
+  QVERIFY( p->featureInfoLayerAliasMap().isEmpty() );
+  QVERIFY( p->wfsLayers().isEmpty() );
+  QVERIFY( p->wcsLayers().isEmpty() );
+  delete p;
+}
+
+QTEST_MAIN( TestQgsProjectParser )
+
+#include "moc_testqgsprojectparser.cxx"
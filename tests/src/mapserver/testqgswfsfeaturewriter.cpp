@@ -0,0 +1,479 @@
+/***************************************************************************
+     testqgswfsfeaturewriter.cpp
+     --------------------------------------
+    Date                 : January 2014
+    Copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include <QtTest>
+#include <QObject>
+#include <QDir>
+#include <QDomDocument>
+#include <QString>
+#include <QStringList>
+#include <qgsapplication.h>
+#include <qgsgeometry.h>
+#include <qgsogcutils.h>
+#include <qgsrequesthandler.h>
+#include <qgsvectordataprovider.h>
+#include <qgsvectorlayer.h>
+//header for class being tested
+#include <qgswfsfeaturewriter.h>
+
+/**Collects the GetFeature output*/
+class TestRequestHandler: public QgsRequestHandler
+{
+  public:
+    TestRequestHandler(): mSendCount( 0 ) {}
+    QMap<QString, QString> parseInput() { return QMap<QString, QString>(); }
+    void sendGetMapResponse( const QString&, QImage* ) const {}
+    void sendGetCapabilitiesResponse( const QDomDocument& ) const {}
+    void sendGetFeatureInfoResponse( const QDomDocument&, const QString& ) const {}
+    void sendServiceException( const QgsMapServiceException& ) const {}
+    void sendGetStyleResponse( const QDomDocument& ) const {}
+    void sendGetPrintResponse( QByteArray* ) const {}
+    bool startGetFeatureResponse( QByteArray*, const QString& ) const { return true; }
+    void sendGetFeatureResponse( QByteArray* ba ) const { mOutput.append( *ba ); ++mSendCount; }
+    void endGetFeatureResponse( QByteArray* ) const {}
+    void sendGetCoverageResponse( QByteArray* ) const {}
+    bool startGetCoverageResponse( QByteArray*, qint64 ) const { return true; }
+    void sendGetCoverageResponsePart( QByteArray* ) const {}
+
+    mutable QByteArray mOutput;
+    mutable int mSendCount;
+};
+
+/** \ingroup UnitTests
+ * This is a unit test for the streaming GetFeature output of the WFS server.
+ * The output is compared with the DOM based serialization used before.
+ */
+class TestQgsWFSFeatureWriter: public QObject
+{
+    Q_OBJECT;
+  private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void compareWithDom_data();
+    void compareWithDom();
+    void compareWithGeoJSON_data();
+    void compareWithGeoJSON();
+    void multiPolygonGeoJSON();
+    void smallBuffer();
+
+  private:
+    QgsVectorLayer* layer( const QString& name );
+
+    /**Features of the layer written by QgsWFSFeatureWriter*/
+    QByteArray writeLayer( QgsVectorLayer* layer, QgsWFSFeatureWriter::Format format, int bufferSize = 65536, int* sendCount = 0 );
+    /**Features of the layer written like the server did before QgsWFSFeatureWriter*/
+    QByteArray writeLayerDom( QgsVectorLayer* layer, bool gml3 );
+    QByteArray writeLayerGeoJSON( QgsVectorLayer* layer );
+
+    static bool sameElement( const QDomElement& e1, const QDomElement& e2, QString& difference );
+    static bool sameText( const QString& text1, const QString& text2 );
+    static QStringList jsonTokens( const QString& json );
+    static bool sameJson( const QString& json1, const QString& json2, QString& difference );
+
+    QString mTestDataDir;
+    QList<QgsVectorLayer*> mLayers;
+};
+
+void TestQgsWFSFeatureWriter::initTestCase()
+{
+  QgsApplication::init();
+  QgsApplication::initQgis();
+  mTestDataDir = QString( TEST_DATA_DIR ) + QDir::separator();
+}
+
+void TestQgsWFSFeatureWriter::cleanupTestCase()
+{
+  qDeleteAll( mLayers );
+}
+
+QgsVectorLayer* TestQgsWFSFeatureWriter::layer( const QString& name )
+{
+  QgsVectorLayer* vl = new QgsVectorLayer( mTestDataDir + name + ".shp", name, "ogr" );
+  mLayers << vl;
+  return vl;
+}
+
+void TestQgsWFSFeatureWriter::compareWithDom_data()
+{
+  QTest::addColumn<QString>( "layerName" );
+  QTest::addColumn<bool>( "gml3" );
+
+  QStringList layers = QStringList() << "points" << "multipoint" << "lines" << "polys";
+  foreach ( QString layerName, layers )
+  {
+    QTest::newRow( QString( layerName + " GML2" ).toLocal8Bit().constData() ) << layerName << false;
+    QTest::newRow( QString( layerName + " GML3" ).toLocal8Bit().constData() ) << layerName << true;
+  }
+}
+
+void TestQgsWFSFeatureWriter::compareWithDom()
+{
+  QFETCH( QString, layerName );
+  QFETCH( bool, gml3 );
+
+  QgsVectorLayer* vl = layer( layerName );
+  QVERIFY( vl->isValid() );
+
+  QString wrapStart = "<root xmlns:gml=\"http://www.opengis.net/gml\" xmlns:qgs=\"http://www.qgis.org/gml\">";
+  QString wrapEnd = "</root>";
+  QDomDocument doc1;
+  QDomDocument doc2;
+  QString errorMsg;
+  QVERIFY2( doc1.setContent( wrapStart + QString::fromUtf8( writeLayer( vl, gml3 ? QgsWFSFeatureWriter::GML3 : QgsWFSFeatureWriter::GML2 ) ) + wrapEnd, &errorMsg ),
+            errorMsg.toLocal8Bit().constData() );
+  QVERIFY2( doc2.setContent( wrapStart + QString::fromUtf8( writeLayerDom( vl, gml3 ) ) + wrapEnd, &errorMsg ),
+            errorMsg.toLocal8Bit().constData() );
+
+  QVERIFY( doc1.documentElement().childNodes().size() > 0 );
+  QString difference;
+  QVERIFY2( sameElement( doc1.documentElement(), doc2.documentElement(), difference ), difference.toLocal8Bit().constData() );
+}
+
+void TestQgsWFSFeatureWriter::compareWithGeoJSON_data()
+{
+  QTest::addColumn<QString>( "layerName" );
+
+  // the former output nested the rings of multi polygons (polys has one), see multiPolygonGeoJSON
+  QTest::newRow( "points" ) << "points";
+  QTest::newRow( "multipoint" ) << "multipoint";
+  QTest::newRow( "lines" ) << "lines";
+}
+
+void TestQgsWFSFeatureWriter::compareWithGeoJSON()
+{
+  QFETCH( QString, layerName );
+
+  QgsVectorLayer* vl = layer( layerName );
+  QVERIFY( vl->isValid() );
+
+  QString json1 = QString::fromUtf8( writeLayer( vl, QgsWFSFeatureWriter::GeoJSON ) );
+  QString json2 = QString::fromUtf8( writeLayerGeoJSON( vl ) );
+  QVERIFY( !json1.isEmpty() );
+
+  QString difference;
+  QVERIFY2( sameJson( json1, json2, difference ), difference.toLocal8Bit().constData() );
+}
+
+void TestQgsWFSFeatureWriter::multiPolygonGeoJSON()
+{
+  // the first feature consists of two polygons, one of them with a hole
+  QgsVectorLayer* vl = layer( "polys" );
+  QVERIFY( vl->isValid() );
+
+  QString json = QString::fromUtf8( writeLayer( vl, QgsWFSFeatureWriter::GeoJSON ) );
+  int start = json.indexOf( "\"MultiPolygon\"" );
+  QVERIFY( start >= 0 );
+  QString geometry = json.mid( start, json.indexOf( "\"properties\"", start ) - start );
+
+  // polygons, rings and points: four levels of arrays, one ring and one polygon separator
+  QVERIFY( geometry.startsWith( "\"MultiPolygon\", \"coordinates\": [ [ [ [" ) );
+  QCOMPARE( geometry.count( "] ] ], [ [ [" ), 1 );
+  QCOMPARE( geometry.count( "] ], [ [" ), 2 );
+}
+
+void TestQgsWFSFeatureWriter::smallBuffer()
+{
+  // the output does not depend on the buffer size
+  QgsVectorLayer* vl = layer( "polys" );
+  QVERIFY( vl->isValid() );
+
+  int sendCount = 0;
+  QByteArray output = writeLayer( vl, QgsWFSFeatureWriter::GML3, 100, &sendCount );
+  QCOMPARE( output, writeLayer( vl, QgsWFSFeatureWriter::GML3 ) );
+  QCOMPARE( sendCount, ( int ) vl->featureCount() );
+}
+
+QByteArray TestQgsWFSFeatureWriter::writeLayer( QgsVectorLayer* layer, QgsWFSFeatureWriter::Format format, int bufferSize, int* sendCount )
+{
+  TestRequestHandler request;
+  {
+    QgsWFSFeatureWriter writer( request, format, bufferSize );
+    writer.setLayer( layer->name(), layer->crs(), &layer->dataProvider()->fields(),
+                     layer->pendingAllAttributesList(), QSet<QString>(), true, 8 );
+
+    QgsFeatureIterator fit = layer->getFeatures();
+    QgsFeature feature;
+    while ( fit.nextFeature( feature ) )
+    {
+      writer.writeFeature( feature );
+    }
+  }
+  if ( sendCount )
+  {
+    *sendCount = request.mSendCount;
+  }
+  return request.mOutput;
+}
+
+QByteArray TestQgsWFSFeatureWriter::writeLayerDom( QgsVectorLayer* layer, bool gml3 )
+{
+  QByteArray result;
+  QString typeName = layer->name();
+  QgsCoordinateReferenceSystem crs = layer->crs();
+  const QgsFields* fields = &layer->dataProvider()->fields();
+  QgsAttributeList attrIndexes = layer->pendingAllAttributesList();
+
+  QgsFeatureIterator fit = layer->getFeatures();
+  QgsFeature feature;
+  while ( fit.nextFeature( feature ) )
+  {
+    QDomDocument doc;
+    QDomElement featureElement = doc.createElement( "gml:featureMember" );
+    QDomElement typeNameElement = doc.createElement( "qgs:" + typeName );
+    typeNameElement.setAttribute( gml3 ? "gml:id" : "fid", typeName + "." + QString::number( feature.id() ) );
+    featureElement.appendChild( typeNameElement );
+
+    QgsGeometry* geom = feature.geometry();
+    QDomElement geomElem = doc.createElement( "qgs:geometry" );
+    QDomElement gmlElem = QgsOgcUtils::geometryToGML( geom, doc, gml3 ? "GML3" : "GML2" );
+    if ( !gmlElem.isNull() )
+    {
+      QgsRectangle box = geom->boundingBox();
+      QDomElement bbElem = doc.createElement( "gml:boundedBy" );
+      QDomElement boxElem = gml3 ? QgsOgcUtils::rectangleToGMLEnvelope( &box, doc ) : QgsOgcUtils::rectangleToGMLBox( &box, doc );
+      if ( crs.isValid() )
+      {
+        boxElem.setAttribute( "srsName", crs.authid() );
+        gmlElem.setAttribute( "srsName", crs.authid() );
+      }
+      bbElem.appendChild( boxElem );
+      typeNameElement.appendChild( bbElem );
+      geomElem.appendChild( gmlElem );
+      typeNameElement.appendChild( geomElem );
+    }
+
+    QgsAttributes attributes = feature.attributes();
+    for ( int i = 0; i < attrIndexes.count(); ++i )
+    {
+      int idx = attrIndexes[i];
+      QString attributeName = fields->at( idx ).name();
+      QDomElement fieldElem = doc.createElement( "qgs:" + attributeName.replace( QString( " " ), QString( "_" ) ) );
+      fieldElem.appendChild( doc.createTextNode( attributes[idx].toString() ) );
+      typeNameElement.appendChild( fieldElem );
+    }
+
+    doc.appendChild( featureElement );
+    result += doc.toByteArray();
+  }
+  return result;
+}
+
+QByteArray TestQgsWFSFeatureWriter::writeLayerGeoJSON( QgsVectorLayer* layer )
+{
+  QString result;
+  QString typeName = layer->name();
+  const QgsFields* fields = &layer->dataProvider()->fields();
+  QgsAttributeList attrIndexes = layer->pendingAllAttributesList();
+
+  QgsFeatureIterator fit = layer->getFeatures();
+  QgsFeature feature;
+  int featIdx = 0;
+  while ( fit.nextFeature( feature ) )
+  {
+    result += featIdx == 0 ? "  " : " ,";
+    result += "{\"type\": \"Feature\",\n   \"id\": \"" + typeName + "." + QString::number( feature.id() ) + "\",\n";
+
+    QgsGeometry* geom = feature.geometry();
+    if ( geom )
+    {
+      QgsRectangle box = geom->boundingBox();
+      result += " \"bbox\": [ " + QString::number( box.xMinimum(), 'f', 8 ) + ", " + QString::number( box.yMinimum(), 'f', 8 )
+                + ", " + QString::number( box.xMaximum(), 'f', 8 ) + ", " + QString::number( box.yMaximum(), 'f', 8 ) + "],\n";
+      result += "  \"geometry\": " + geom->exportToGeoJSON() + ",\n";
+    }
+
+    result += "   \"properties\": {\n";
+    QgsAttributes attributes = feature.attributes();
+    for ( int i = 0; i < attrIndexes.count(); ++i )
+    {
+      int idx = attrIndexes[i];
+      QVariant val = attributes[idx];
+      result += i == 0 ? "    \"" : "   ,\"";
+      result += fields->at( idx ).name() + "\": ";
+      if ( val.type() == QVariant::Double || val.type() == QVariant::Int )
+      {
+        result += val.toString();
+      }
+      else
+      {
+        result += "\"" + val.toString().replace( QString( "\"" ), QString( "\\\"" ) ) + "\"";
+      }
+      result += "\n";
+    }
+    result += "   }\n  }\n";
+    ++featIdx;
+  }
+  return result.toUtf8();
+}
+
+bool TestQgsWFSFeatureWriter::sameElement( const QDomElement& e1, const QDomElement& e2, QString& difference )
+{
+  if ( e1.tagName() != e2.tagName() )
+  {
+    difference = QString( "element %1 instead of %2" ).arg( e1.tagName() ).arg( e2.tagName() );
+    return false;
+  }
+
+  QDomNamedNodeMap attributes1 = e1.attributes();
+  QDomNamedNodeMap attributes2 = e2.attributes();
+  if ( attributes1.count() != attributes2.count() )
+  {
+    difference = QString( "%1 attributes of %2 instead of %3" ).arg( attributes1.count() ).arg( e1.tagName() ).arg( attributes2.count() );
+    return false;
+  }
+  for ( int i = 0; i < attributes1.count(); ++i )
+  {
+    QDomAttr attribute = attributes1.item( i ).toAttr();
+    if ( !sameText( attribute.value(), e2.attribute( attribute.name(), QString::null ) ) )
+    {
+      difference = QString( "attribute %1 of %2: %3 instead of %4" ).arg( attribute.name() ).arg( e1.tagName() )
+                   .arg( attribute.value() ).arg( e2.attribute( attribute.name() ) );
+      return false;
+    }
+  }
+
+  QDomNodeList children1 = e1.childNodes();
+  QDomNodeList children2 = e2.childNodes();
+  if ( children1.count() != children2.count() )
+  {
+    difference = QString( "%1 children of %2 instead of %3" ).arg( children1.count() ).arg( e1.tagName() ).arg( children2.count() );
+    return false;
+  }
+  for ( int i = 0; i < children1.count(); ++i )
+  {
+    QDomNode child1 = children1.at( i );
+    QDomNode child2 = children2.at( i );
+    if ( child1.isElement() && child2.isElement() )
+    {
+      if ( !sameElement( child1.toElement(), child2.toElement(), difference ) )
+      {
+        return false;
+      }
+    }
+    else if ( child1.isText() && child2.isText() )
+    {
+      if ( !sameText( child1.nodeValue(), child2.nodeValue() ) )
+      {
+        difference = QString( "text of %1: %2 instead of %3" ).arg( e1.tagName() ).arg( child1.nodeValue() ).arg( child2.nodeValue() );
+        return false;
+      }
+    }
+    else
+    {
+      difference = QString( "different node types in %1" ).arg( e1.tagName() );
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TestQgsWFSFeatureWriter::sameText( const QString& text1, const QString& text2 )
+{
+  if ( text1 == text2 )
+  {
+    return true;
+  }
+
+  // coordinates are written with 8 instead of 17 significant digits
+  QStringList numbers1 = text1.split( QRegExp( "[ ,]" ), QString::SkipEmptyParts );
+  QStringList numbers2 = text2.split( QRegExp( "[ ,]" ), QString::SkipEmptyParts );
+  if ( numbers1.size() != numbers2.size() || numbers1.isEmpty() )
+  {
+    return false;
+  }
+  for ( int i = 0; i < numbers1.size(); ++i )
+  {
+    bool ok1, ok2;
+    double value1 = numbers1[i].toDouble( &ok1 );
+    double value2 = numbers2[i].toDouble( &ok2 );
+    if ( !ok1 || !ok2 || qAbs( value1 - value2 ) > 1e-7 )
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+QStringList TestQgsWFSFeatureWriter::jsonTokens( const QString& json )
+{
+  QStringList tokens;
+  int n = json.size();
+  for ( int i = 0; i < n; ++i )
+  {
+    QChar c = json.at( i );
+    if ( c.isSpace() )
+    {
+      continue;
+    }
+
+    int j = i + 1;
+    if ( c == '"' )
+    {
+      while ( j < n && json.at( j ) != '"' )
+      {
+        j += json.at( j ) == '\\' ? 2 : 1;
+      }
+      ++j;
+    }
+    else if ( c.isDigit() || c == '-' )
+    {
+      while ( j < n && ( json.at( j ).isDigit() || QString( ".-+eE" ).contains( json.at( j ) ) ) )
+      {
+        ++j;
+      }
+    }
+    else if ( c.isLetter() )
+    {
+      while ( j < n && json.at( j ).isLetter() )
+      {
+        ++j;
+      }
+    }
+    tokens << json.mid( i, j - i );
+    i = j - 1;
+  }
+  return tokens;
+}
+
+bool TestQgsWFSFeatureWriter::sameJson( const QString& json1, const QString& json2, QString& difference )
+{
+  QStringList tokens1 = jsonTokens( json1 );
+  QStringList tokens2 = jsonTokens( json2 );
+  for ( int i = 0; i < qMin( tokens1.size(), tokens2.size() ); ++i )
+  {
+    if ( tokens1[i] == tokens2[i] )
+    {
+      continue;
+    }
+
+    bool ok1, ok2;
+    double value1 = tokens1[i].toDouble( &ok1 );
+    double value2 = tokens2[i].toDouble( &ok2 );
+    if ( !ok1 || !ok2 || qAbs( value1 - value2 ) > 1e-7 )
+    {
+      difference = QString( "token %1: %2 instead of %3" ).arg( i ).arg( tokens1[i] ).arg( tokens2[i] );
+      return false;
+    }
+  }
+  if ( tokens1.size() != tokens2.size() )
+  {
+    difference = QString( "%1 tokens instead of %2" ).arg( tokens1.size() ).arg( tokens2.size() );
+    return false;
+  }
+  return true;
+}
+
+QTEST_MAIN( TestQgsWFSFeatureWriter )
+
+#include "moc_testqgswfsfeaturewriter.cxx"
@@ -0,0 +1,126 @@
+/***************************************************************************
+     testqgswmstilecache.cpp
+     --------------------------------------
+    Date                 : January 2014
+    Copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include <QtTest>
+#include <QObject>
+#include <QImage>
+#include <QMap>
+#include <QString>
+#include <qgsapplication.h>
+//header for class being tested
+#include <qgswmstilecache.h>
+
+/** \ingroup UnitTests
+ * This is a unit test for the rendered tile cache of the WMS server.
+ */
+class TestQgsWMSTileCache: public QObject
+{
+    Q_OBJECT;
+  private slots:
+
+    void initTestCase()
+    {
+      // read once by the singleton
+      qputenv( "WMS_METATILE_SIZE", "4" );
+      qputenv( "WMS_TILE_SIZE", "256" );
+      qputenv( "WMS_TILE_ORIGIN", "-180,-90" );
+      QgsApplication::init();
+      QgsApplication::initQgis();
+    }
+
+    void settings()
+    {
+      QgsWMSTileCache* cache = QgsWMSTileCache::instance();
+      QCOMPARE( cache->metaTileSize(), 4 );
+      QCOMPARE( cache->tileSize(), 256 );
+      QCOMPARE( cache->originX(), -180.0 );
+      QCOMPARE( cache->originY(), -90.0 );
+    }
+
+    void metaTileSizeLimits()
+    {
+      QgsWMSTileCache* cache = QgsWMSTileCache::instance();
+
+      // no limits or large enough: the full metatile
+      QCOMPARE( cache->metaTileSize( -1, -1 ), 4 );
+      QCOMPARE( cache->metaTileSize( 1024, 1024 ), 4 );
+      QCOMPARE( cache->metaTileSize( 4000, -1 ), 4 );
+
+      // the metatile shrinks to the maximum width or height
+      QCOMPARE( cache->metaTileSize( 1000, -1 ), 3 );
+      QCOMPARE( cache->metaTileSize( 2048, 600 ), 2 );
+      QCOMPARE( cache->metaTileSize( 511, 1024 ), 1 );
+
+      // the tiles themselves are rejected by the size check of GetMap
+      QCOMPARE( cache->metaTileSize( 100, 100 ), 1 );
+    }
+
+    void insertAndRemove()
+    {
+      QgsWMSTileCache* cache = QgsWMSTileCache::instance();
+      QImage image( 256, 256, QImage::Format_ARGB32 );
+      image.fill( qRgb( 255, 0, 0 ) );
+
+      cache->insertTile( "/projects/a.qgs", "LAYERS=x&|0|0", image );
+      cache->insertTile( "/projects/a.qgs", "LAYERS=x&|1|0", image );
+      cache->insertTile( "/projects/b.qgs", "LAYERS=x&|0|0", image );
+
+      QImage tile;
+      QVERIFY( cache->tile( "/projects/a.qgs", "LAYERS=x&|1|0", tile ) );
+      QCOMPARE( tile.size(), QSize( 256, 256 ) );
+      QCOMPARE( tile.pixel( 10, 10 ), qRgb( 255, 0, 0 ) );
+      QVERIFY( !cache->tile( "/projects/a.qgs", "LAYERS=x&|2|0", tile ) );
+
+      // a changed project only invalidates its own tiles
+      cache->removeProjectTiles( "/projects/a.qgs" );
+      QVERIFY( !cache->tile( "/projects/a.qgs", "LAYERS=x&|0|0", tile ) );
+      QVERIFY( !cache->tile( "/projects/a.qgs", "LAYERS=x&|1|0", tile ) );
+      QVERIFY( cache->tile( "/projects/b.qgs", "LAYERS=x&|0|0", tile ) );
+    }
+
+    void requestKey()
+    {
+      QMap<QString, QString> parameters;
+      parameters.insert( "LAYERS", "roads" );
+      parameters.insert( "FILTER", "roads:\"type\" = 'a'" );
+      parameters.insert( "BBOX", "0,0,1,1" );
+      QString key = QgsWMSTileCache::requestKey( parameters );
+
+      // the position is not part of the tile set
+      parameters.insert( "BBOX", "1,0,2,1" );
+      QCOMPARE( QgsWMSTileCache::requestKey( parameters ), key );
+      QVERIFY( !key.contains( "BBOX" ) );
+
+      // separators in values don't make distinct requests equal
+      QMap<QString, QString> first;
+      first.insert( "FILTER", "a" );
+      first.insert( "LAYERS", "b&STYLES=c" );
+      QMap<QString, QString> second;
+      second.insert( "FILTER", "a" );
+      second.insert( "LAYERS", "b" );
+      second.insert( "STYLES", "c" );
+      QVERIFY( QgsWMSTileCache::requestKey( first ) != QgsWMSTileCache::requestKey( second ) );
+
+      QMap<QString, QString> third;
+      third.insert( "FILTER", "a&LAYERS=b" );
+      QMap<QString, QString> fourth;
+      fourth.insert( "FILTER", "a" );
+      fourth.insert( "LAYERS", "b" );
+      QVERIFY( QgsWMSTileCache::requestKey( third ) != QgsWMSTileCache::requestKey( fourth ) );
+      QVERIFY( !QgsWMSTileCache::requestKey( third ).contains( "|" ) );
+    }
+};
+
+QTEST_MAIN( TestQgsWMSTileCache )
+
+#include "moc_testqgswmstilecache.cxx"
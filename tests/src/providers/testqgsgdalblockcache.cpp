@@ -0,0 +1,197 @@
+/***************************************************************************
+     testqgsgdalblockcache.cpp
+     --------------------------------------
+    Date                 : January 2014
+    Copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include <QtTest>
+#include <QObject>
+#include <QDir>
+#include <QFile>
+#include <QString>
+#include <QStringList>
+#include <qgsapplication.h>
+#include <qgscoordinatereferencesystem.h>
+#include <qgsproviderregistry.h>
+#include <qgsrasterblock.h>
+#include <qgsrasterdataprovider.h>
+#include <qgsrasterlayer.h>
+
+#include <gdal.h>
+
+// the cache is in the provider plugin, its statistics are read through the plugin function
+typedef void blockCacheStatistics_t( int& hits, int& misses );
+
+static const int WIDTH = 100;
+static const int HEIGHT = 80;
+
+/** \ingroup UnitTests
+ * This is a unit test for the block cache of the GDAL provider.
+ */
+class TestQgsGdalBlockCache: public QObject
+{
+    Q_OBJECT;
+  private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void providerRead_data();
+    void providerRead();
+    void rewrite();
+
+  private:
+    /**Writes a WIDTH x HEIGHT float32 raster with the values row * WIDTH + col + offset through the provider*/
+    static bool createRaster( const QString& fileName, const QStringList& createOptions, float offset );
+    /**Compares a window of the raster read through the provider with the written values*/
+    static bool checkWindow( QgsRasterDataProvider* provider, int left, int top, int width, int height, float offset );
+    /**Hits and misses of the block cache of the GDAL provider plugin*/
+    static void cacheStatistics( int& hits, int& misses );
+
+    QString mFileName;
+};
+
+void TestQgsGdalBlockCache::initTestCase()
+{
+  QgsApplication::init();
+  QgsApplication::initQgis();
+  GDALAllRegister();
+  mFileName = QDir::tempPath() + QDir::separator() + "qgis_test_gdalblockcache.tif";
+}
+
+void TestQgsGdalBlockCache::cleanupTestCase()
+{
+  QFile::remove( mFileName );
+}
+
+bool TestQgsGdalBlockCache::createRaster( const QString& fileName, const QStringList& createOptions, float offset )
+{
+  double geoTransform[6] = { 0, 1, 0, HEIGHT, 0, -1 };
+  QgsRasterDataProvider* provider = QgsRasterDataProvider::create( "gdal", fileName, "GTiff", 1, QGis::Float32, WIDTH, HEIGHT,
+                                    geoTransform, QgsCoordinateReferenceSystem( "EPSG:4326" ), createOptions );
+  if ( !provider || !provider->isValid() )
+  {
+    delete provider;
+    return false;
+  }
+
+  QVector<float> values( WIDTH * HEIGHT );
+  for ( int i = 0; i < WIDTH * HEIGHT; ++i )
+  {
+    values[i] = i + offset;
+  }
+  bool ok = provider->write( values.data(), 1, WIDTH, HEIGHT, 0, 0 );
+  delete provider;
+  return ok;
+}
+
+bool TestQgsGdalBlockCache::checkWindow( QgsRasterDataProvider* provider, int left, int top, int width, int height, float offset )
+{
+  QgsRectangle extent( left, HEIGHT - top - height, left + width, HEIGHT - top );
+  QgsRasterBlock* block = provider->block( 1, extent, width, height );
+  if ( !block || !block->isValid() )
+  {
+    delete block;
+    return false;
+  }
+
+  bool ok = true;
+  for ( int row = 0; ok && row < height; ++row )
+  {
+    for ( int col = 0; ok && col < width; ++col )
+    {
+      ok = block->value( row, col ) == ( top + row ) * WIDTH + left + col + offset;
+    }
+  }
+  delete block;
+  return ok;
+}
+
+void TestQgsGdalBlockCache::cacheStatistics( int& hits, int& misses )
+{
+  hits = -1;
+  misses = -1;
+  blockCacheStatistics_t* statistics = ( blockCacheStatistics_t* ) cast_to_fptr( QgsProviderRegistry::instance()->function( "gdal", "blockCacheStatistics" ) );
+  QVERIFY( statistics );
+  statistics( hits, misses );
+}
+
+void TestQgsGdalBlockCache::providerRead_data()
+{
+  QTest::addColumn<QStringList>( "createOptions" );
+
+  QTest::newRow( "tiles" ) << ( QStringList() << "TILED=YES" << "BLOCKXSIZE=16" << "BLOCKYSIZE=16" );
+  QTest::newRow( "strips" ) << ( QStringList() << "BLOCKYSIZE=4" );
+  QTest::newRow( "single row strips" ) << ( QStringList() << "BLOCKYSIZE=1" );
+}
+
+void TestQgsGdalBlockCache::providerRead()
+{
+  QFETCH( QStringList, createOptions );
+  QVERIFY( createRaster( mFileName, createOptions, 0 ) );
+
+  // the blocks of the new file are read from the file once (maybe already for the statistics of the layer)
+  int hits, misses;
+  cacheStatistics( hits, misses );
+  QgsRasterLayer layer( mFileName, "test", "gdal" );
+  QVERIFY( layer.isValid() );
+  QgsRasterDataProvider* provider = layer.dataProvider();
+  QVERIFY( checkWindow( provider, 0, 0, WIDTH, HEIGHT, 0 ) );
+  int firstHits, firstMisses;
+  cacheStatistics( firstHits, firstMisses );
+  QVERIFY( firstMisses > misses );
+
+  // then they come from the cache
+  QVERIFY( checkWindow( provider, 0, 0, WIDTH, HEIGHT, 0 ) );
+  cacheStatistics( hits, misses );
+  QVERIFY( hits > firstHits );
+  QCOMPARE( misses, firstMisses );
+
+  // windows inside the raster, also not aligned to the blocks, only use cached blocks
+  QVERIFY( checkWindow( provider, 20, 10, 40, 35, 0 ) );
+  QVERIFY( checkWindow( provider, 27, 13, 40, 35, 0 ) );
+  QVERIFY( checkWindow( provider, WIDTH - 7, HEIGHT - 5, 7, 5, 0 ) );
+  int windowHits;
+  cacheStatistics( windowHits, misses );
+  QVERIFY( windowHits > hits );
+  QCOMPARE( misses, firstMisses );
+}
+
+void TestQgsGdalBlockCache::rewrite()
+{
+  QStringList createOptions = QStringList() << "TILED=YES" << "BLOCKXSIZE=16" << "BLOCKYSIZE=16";
+  QVERIFY( createRaster( mFileName, createOptions, 0 ) );
+  QgsRasterLayer* layer = new QgsRasterLayer( mFileName, "test", "gdal" );
+  QVERIFY( layer->isValid() );
+  QVERIFY( checkWindow( layer->dataProvider(), 0, 0, WIDTH, HEIGHT, 0 ) );
+  delete layer;
+
+  // same size and possibly the same modification time, the written data must not be hidden by the cache:
+  // the write through the provider removed the blocks of the file
+  int hits, misses;
+  cacheStatistics( hits, misses );
+  QVERIFY( createRaster( mFileName, createOptions, 1000 ) );
+  layer = new QgsRasterLayer( mFileName, "test", "gdal" );
+  QVERIFY( layer->isValid() );
+  QVERIFY( checkWindow( layer->dataProvider(), 0, 0, WIDTH, HEIGHT, 1000 ) );
+  int rewrittenHits, rewrittenMisses;
+  cacheStatistics( rewrittenHits, rewrittenMisses );
+  QVERIFY( rewrittenMisses > misses );
+
+  // the blocks of the written file are cached again
+  QVERIFY( checkWindow( layer->dataProvider(), 0, 0, WIDTH, HEIGHT, 1000 ) );
+  cacheStatistics( hits, misses );
+  QVERIFY( hits > rewrittenHits );
+  QCOMPARE( misses, rewrittenMisses );
+  delete layer;
+}
+
+QTEST_MAIN( TestQgsGdalBlockCache )
+
+#include "moc_testqgsgdalblockcache.cxx"
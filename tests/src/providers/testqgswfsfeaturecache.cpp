@@ -0,0 +1,180 @@
+/***************************************************************************
+     testqgswfsfeaturecache.cpp
+     --------------------------------------
+    Date                 : January 2014
+    Copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include <QtTest>
+#include <QObject>
+#include <QString>
+#include <qgsapplication.h>
+#include <qgsgeometry.h>
+//header for class being tested
+#include <qgswfsfeaturecache.h>
+
+/** \ingroup UnitTests
+ * This is a unit test for the feature and tile cache of the WFS provider.
+ */
+class TestQgsWFSFeatureCache: public QObject
+{
+    Q_OBJECT;
+  private slots:
+
+    void initTestCase()
+    {
+      QgsApplication::init();
+      QgsApplication::initQgis();
+    }
+
+    void storeAndRead()
+    {
+      QgsWFSFeatureCache cache;
+      QVERIFY( cache.isValid() );
+
+      QVERIFY( cache.storeFeature( feature( 3, "first", 10, 20 ) ) );
+      QVERIFY( cache.storeFeature( feature( 7, "second", 30, 40 ) ) );
+      QCOMPARE( cache.count(), 2 );
+      QCOMPARE( cache.maximumId(), ( QgsFeatureId ) 7 );
+      QCOMPARE( cache.ids(), QList<QgsFeatureId>() << 3 << 7 );
+
+      QgsFeature f;
+      QVERIFY( cache.feature( 7, f, true ) );
+      QCOMPARE( f.id(), ( QgsFeatureId ) 7 );
+      QCOMPARE( f.attribute( 0 ).toString(), QString( "second" ) );
+      QVERIFY( f.geometry() );
+      QCOMPARE( f.geometry()->asPoint(), QgsPoint( 30, 40 ) );
+
+      QVERIFY( cache.feature( 3, f, false ) );
+      QVERIFY( !f.geometry() );
+      QVERIFY( !cache.feature( 5, f, true ) );
+
+      // replacing a feature moves it in the spatial index
+      QVERIFY( cache.storeFeature( feature( 3, "moved", 50, 60 ) ) );
+      QCOMPARE( cache.count(), 2 );
+      QVERIFY( cache.intersects( QgsRectangle( 0, 0, 15, 25 ) ).isEmpty() );
+      QCOMPARE( cache.intersects( QgsRectangle( 45, 55, 55, 65 ) ), QList<QgsFeatureId>() << 3 );
+      QCOMPARE( cache.extent(), QgsRectangle( 30, 40, 50, 60 ) );
+
+      QVERIFY( cache.removeFeature( 7 ) );
+      QVERIFY( !cache.removeFeature( 7 ) );
+      QVERIFY( !cache.contains( 7 ) );
+      QVERIFY( cache.intersects( QgsRectangle( 25, 35, 35, 45 ) ).isEmpty() );
+
+      cache.clear();
+      QCOMPARE( cache.count(), 0 );
+      QCOMPARE( cache.maximumId(), ( QgsFeatureId ) - 1 );
+    }
+
+    void mergeTiles()
+    {
+      // the features of two overlapping tiles, "b.2" is received with both of them
+      QgsWFSFeatureCache cache;
+      QStringList tileA = QStringList() << "b.1" << "b.2";
+      QStringList tileB = QStringList() << "b.2" << "b.3";
+
+      cache.beginBatch();
+      storeTile( cache, tileA );
+      storeTile( cache, tileB );
+      cache.endBatch();
+
+      QCOMPARE( cache.count(), 3 );
+      QVERIFY( cache.containsWfsId( "b.3" ) );
+
+      // removed features are not fetched again with the next tile
+      QVERIFY( cache.removeFeature( 0 ) );
+      storeTile( cache, tileA );
+      QCOMPARE( cache.count(), 2 );
+      QVERIFY( cache.containsWfsId( "b.1" ) );
+
+      cache.clear();
+      QVERIFY( !cache.containsWfsId( "b.1" ) );
+    }
+
+    void missingTiles()
+    {
+      QgsWFSFeatureCache cache;
+
+      // 30 units per tile -> tiles of 32 units
+      QgsRectangle rect( 0, 0, 90, 90 );
+      QList<QgsWFSFeatureCache::Tile> tiles = cache.missingTiles( rect, 3 );
+      QCOMPARE( tiles.size(), 9 );
+      QCOMPARE( tiles[0].level, 5 );
+      QCOMPARE( tiles[8].extent(), QgsRectangle( 64, 64, 96, 96 ) );
+      addTiles( cache, tiles );
+      QVERIFY( cache.missingTiles( rect, 3 ).isEmpty() );
+
+      // zooming in hits the larger tiles
+      QVERIFY( cache.missingTiles( QgsRectangle( 10, 10, 20, 20 ), 3 ).isEmpty() );
+
+      // zooming out: only the tile whose four sub tiles have all been fetched is covered
+      tiles = cache.missingTiles( QgsRectangle( 0, 0, 180, 180 ), 3 );
+      QCOMPARE( tiles.size(), 8 );
+      QCOMPARE( tiles[0].level, 6 );
+      QCOMPARE( tiles[0].column, ( qint64 ) 1 );
+      QCOMPARE( tiles[0].row, ( qint64 ) 0 );
+
+      // panning only fetches the new column
+      tiles = cache.missingTiles( QgsRectangle( 32, 0, 122, 90 ), 3 );
+      QCOMPARE( tiles.size(), 3 );
+      for ( int i = 0; i < tiles.size(); ++i )
+      {
+        QCOMPARE( tiles[i].column, ( qint64 ) 3 );
+      }
+    }
+
+    void negativeTiles()
+    {
+      QgsWFSFeatureCache cache;
+
+      QgsWFSFeatureCache::Tile tile( 5, -1, -1 );
+      QCOMPARE( tile.extent(), QgsRectangle( -32, -32, 0, 0 ) );
+      QCOMPARE( cache.missingTiles( QgsRectangle( -90, -90, 0, 0 ), 3 ).size(), 16 );
+
+      cache.addFetchedTile( tile );
+      QVERIFY( cache.tileFetched( tile ) );
+      QVERIFY( cache.missingTiles( QgsRectangle( -20, -20, -10, -10 ), 3 ).isEmpty() );
+      QCOMPARE( cache.missingTiles( QgsRectangle( -20, 10, -10, 20 ), 3 ).size(), 12 );
+    }
+
+  private:
+    QgsFeature feature( QgsFeatureId fid, const QString& name, double x, double y )
+    {
+      QgsFeature f( fid );
+      QgsAttributes attributes;
+      attributes << name;
+      f.setAttributes( attributes );
+      f.setGeometry( QgsGeometry::fromPoint( QgsPoint( x, y ) ) );
+      return f;
+    }
+
+    // stores the features of a tile like the provider does
+    void storeTile( QgsWFSFeatureCache& cache, const QStringList& wfsIds )
+    {
+      for ( int i = 0; i < wfsIds.size(); ++i )
+      {
+        if ( cache.containsWfsId( wfsIds[i] ) )
+          continue;
+
+        QVERIFY( cache.storeFeature( feature( cache.maximumId() + 1, wfsIds[i], i, i ), wfsIds[i] ) );
+      }
+    }
+
+    void addTiles( QgsWFSFeatureCache& cache, const QList<QgsWFSFeatureCache::Tile>& tiles )
+    {
+      for ( int i = 0; i < tiles.size(); ++i )
+      {
+        cache.addFetchedTile( tiles[i] );
+      }
+    }
+};
+
+QTEST_MAIN( TestQgsWFSFeatureCache )
+
+#include "moc_testqgswfsfeaturecache.cxx"
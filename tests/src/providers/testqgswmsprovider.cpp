@@ -0,0 +1,319 @@
+/***************************************************************************
+     testqgswmsprovider.cpp
+     --------------------------------------
+    Date                 : January 2014
+    Copyright            : (C) 2014 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include <QtTest>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QColor>
+#include <QDir>
+#include <QFile>
+#include <QImage>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QPointer>
+#include <QBuffer>
+#include <QSettings>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTime>
+#include <QUrl>
+
+#include <qgsapplication.h>
+#include <qgsnetworkaccessmanager.h>
+#include <qgsrasterblock.h>
+#include <qgsrasterdataprovider.h>
+#include <qgsrasterlayer.h>
+#include <qgstilecache.h>
+
+// the tiles are served by the test itself, on a local port: %1 is replaced with it
+static const char* TILE_URL = "http://127.0.0.1:%1/%2/%3/%4.png";
+
+// tile matrix "0" with 4 map units per pixel and "1" with 2, tiles of 256x256 pixels
+static const char* CAPABILITIES =
+  "<Capabilities xmlns=\"http://www.opengis.net/wmts/1.0\" xmlns:ows=\"http://www.opengis.net/ows/1.1\" version=\"1.0.0\">"
+  "<Contents>"
+  "<Layer>"
+  "<ows:Identifier>test</ows:Identifier>"
+  "<Style isDefault=\"true\"><ows:Identifier>default</ows:Identifier></Style>"
+  "<Format>image/png</Format>"
+  "<TileMatrixSetLink><TileMatrixSet>grid</TileMatrixSet></TileMatrixSetLink>"
+  "<ResourceURL format=\"image/png\" resourceType=\"tile\" template=\"http://127.0.0.1:%1/{TileMatrix}/{TileRow}/{TileCol}.png\"/>"
+  "</Layer>"
+  "<TileMatrixSet>"
+  "<ows:Identifier>grid</ows:Identifier>"
+  "<ows:SupportedCRS>EPSG:3857</ows:SupportedCRS>"
+  "<TileMatrix><ows:Identifier>0</ows:Identifier><ScaleDenominator>14285.714285714286</ScaleDenominator>"
+  "<TopLeftCorner>0 4096</TopLeftCorner><TileWidth>256</TileWidth><TileHeight>256</TileHeight>"
+  "<MatrixWidth>4</MatrixWidth><MatrixHeight>4</MatrixHeight></TileMatrix>"
+  "<TileMatrix><ows:Identifier>1</ows:Identifier><ScaleDenominator>7142.857142857143</ScaleDenominator>"
+  "<TopLeftCorner>0 4096</TopLeftCorner><TileWidth>256</TileWidth><TileHeight>256</TileHeight>"
+  "<MatrixWidth>8</MatrixWidth><MatrixHeight>8</MatrixHeight></TileMatrix>"
+  "</TileMatrixSet>"
+  "</Contents>"
+  "</Capabilities>";
+
+/** \ingroup UnitTests
+ * This is a unit test for the tile cache of the WMS provider in WMTS mode.
+ */
+class TestQgsWmsProvider: public QObject
+{
+    Q_OBJECT;
+  public slots:
+    void requestAboutToBeCreated( QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *data )
+    {
+      Q_UNUSED( op );
+      Q_UNUSED( data );
+      mRequestedUrls << request.url().toString();
+    }
+
+    void requestCreated( QNetworkReply *reply )
+    {
+      mReplies << reply;
+    }
+
+    void tileConnection();
+    void tileRequest();
+
+  private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+
+    void otherResolutionPlaceholder();
+    void prefetchHit();
+
+  private:
+    QString tileUrl( int matrix, int row, int col ) const
+    {
+      return QString( TILE_URL ).arg( mTileServer.serverPort() ).arg( matrix ).arg( row ).arg( col );
+    }
+
+    void cacheTiles( int matrix, int row0, int row1, int col0, int col1, Qt::GlobalColor color ) const
+    {
+      QImage image( 256, 256, QImage::Format_ARGB32 );
+      image.fill( QColor( color ).rgb() );
+      for ( int row = row0; row <= row1; ++row )
+      {
+        for ( int col = col0; col <= col1; ++col )
+        {
+          QgsTileCache::insertTile( QUrl( tileUrl( matrix, row, col ) ), image );
+        }
+      }
+    }
+
+    QStringList tileRequests() const
+    {
+      return mRequestedUrls.filter( QString( "127.0.0.1:%1/" ).arg( mTileServer.serverPort() ) );
+    }
+
+    // lets the background requests finish
+    void waitForReplies();
+
+    QgsRasterLayer *mLayer;
+    QString mCapabilitiesFile;
+    QStringList mRequestedUrls;
+    QList< QPointer<QNetworkReply> > mReplies;
+
+    //! local tile server: answers with blue tiles if serving, closes the connections otherwise
+    QTcpServer mTileServer;
+    bool mServingTiles;
+    QStringList mServedTiles;
+};
+
+void TestQgsWmsProvider::initTestCase()
+{
+  QgsApplication::init();
+  QgsApplication::initQgis();
+
+  QCoreApplication::setOrganizationName( "QGIS" );
+  QCoreApplication::setOrganizationDomain( "qgis.org" );
+  QCoreApplication::setApplicationName( "QGIS-TEST" );
+  QSettings settings;
+  settings.setValue( "/qgis/defaultTileMaxRetry", 0 );
+  settings.setValue( "/qgis/prefetchTiles", true );
+
+  mServingTiles = false;
+  connect( &mTileServer, SIGNAL( newConnection() ), this, SLOT( tileConnection() ) );
+  QVERIFY( mTileServer.listen( QHostAddress::LocalHost ) );
+
+  mCapabilitiesFile = QDir::tempPath() + "/qgis_test_wmts/WMTSCapabilities.xml";
+  QDir().mkpath( QDir::tempPath() + "/qgis_test_wmts" );
+  QFile file( mCapabilitiesFile );
+  QVERIFY( file.open( QIODevice::WriteOnly ) );
+  file.write( QString( CAPABILITIES ).arg( mTileServer.serverPort() ).toUtf8() );
+  file.close();
+
+  QString uri = QString( "crs=EPSG:3857&format=image/png&layers=test&styles=default&tileMatrixSet=grid&url=%1" )
+                .arg( QUrl::fromLocalFile( mCapabilitiesFile ).toString() );
+  mLayer = new QgsRasterLayer( uri, "test", "wms" );
+  QVERIFY( mLayer->isValid() );
+
+  connect( QgsNetworkAccessManager::instance(), SIGNAL( requestAboutToBeCreated( QNetworkAccessManager::Operation, const QNetworkRequest &, QIODevice * ) ),
+           this, SLOT( requestAboutToBeCreated( QNetworkAccessManager::Operation, const QNetworkRequest &, QIODevice * ) ) );
+  connect( QgsNetworkAccessManager::instance(), SIGNAL( requestCreated( QNetworkReply * ) ),
+           this, SLOT( requestCreated( QNetworkReply * ) ) );
+}
+
+void TestQgsWmsProvider::cleanupTestCase()
+{
+  delete mLayer;
+  QFile::remove( mCapabilitiesFile );
+}
+
+void TestQgsWmsProvider::init()
+{
+  waitForReplies();
+  mRequestedUrls.clear();
+  mServedTiles.clear();
+  mServingTiles = false;
+}
+
+void TestQgsWmsProvider::tileConnection()
+{
+  while ( mTileServer.hasPendingConnections() )
+  {
+    QTcpSocket *socket = mTileServer.nextPendingConnection();
+    connect( socket, SIGNAL( disconnected() ), socket, SLOT( deleteLater() ) );
+    if ( !mServingTiles )
+    {
+      // the request fails like with an unreachable server
+      socket->abort();
+      continue;
+    }
+    connect( socket, SIGNAL( readyRead() ), this, SLOT( tileRequest() ) );
+  }
+}
+
+void TestQgsWmsProvider::tileRequest()
+{
+  QTcpSocket *socket = qobject_cast<QTcpSocket *>( sender() );
+  QByteArray request = socket->property( "request" ).toByteArray() + socket->readAll();
+  socket->setProperty( "request", request );
+  if ( !request.contains( "\r\n\r\n" ) )
+    return;
+
+  // "GET /matrix/row/col.png HTTP/1.1"
+  QList<QByteArray> requestLine = request.left( request.indexOf( "\r\n" ) ).split( ' ' );
+  if ( requestLine.size() != 3 || requestLine[0] != "GET" )
+  {
+    socket->abort();
+    return;
+  }
+  mServedTiles << QString( "http://127.0.0.1:%1%2" ).arg( mTileServer.serverPort() ).arg( QString( requestLine[1] ) );
+
+  QImage image( 256, 256, QImage::Format_ARGB32 );
+  image.fill( QColor( Qt::blue ).rgb() );
+  QByteArray png;
+  QBuffer buffer( &png );
+  buffer.open( QIODevice::WriteOnly );
+  image.save( &buffer, "PNG" );
+
+  socket->write( QString( "HTTP/1.1 200 OK\r\nContent-Type: image/png\r\nContent-Length: %1\r\nConnection: close\r\n\r\n" )
+                 .arg( png.size() ).toAscii() );
+  socket->write( png );
+  socket->disconnectFromHost();
+}
+
+void TestQgsWmsProvider::waitForReplies()
+{
+  // a scheduled prefetch sends its requests first
+  QCoreApplication::processEvents();
+
+  QTime t;
+  t.start();
+  while ( t.elapsed() < 10000 )
+  {
+    bool pending = false;
+    foreach ( const QPointer<QNetworkReply> &reply, mReplies )
+    {
+      pending = pending || ( reply && !reply->isFinished() );
+    }
+    if ( !pending )
+      break;
+
+    QCoreApplication::processEvents( QEventLoop::AllEvents, 100 );
+  }
+  // the provider deletes the finished replies later
+  QCoreApplication::processEvents();
+  mReplies.clear();
+}
+
+void TestQgsWmsProvider::otherResolutionPlaceholder()
+{
+  // only the large tile of matrix "0" is cached, the tiles of matrix "1" are missing
+  cacheTiles( 0, 0, 0, 0, 0, Qt::red );
+
+  QgsRasterBlock *block = mLayer->dataProvider()->block( 1, QgsRectangle( 0, 3072, 1024, 4096 ), 512, 512 );
+  QVERIFY( block );
+
+  // the missing tiles were requested ...
+  QVERIFY( tileRequests().contains( tileUrl( 1, 0, 0 ) ) );
+  QVERIFY( tileRequests().contains( tileUrl( 1, 1, 1 ) ) );
+  QVERIFY( !tileRequests().contains( tileUrl( 0, 0, 0 ) ) );
+
+  // ... and failed, the view shows the lower resolution tile instead
+  QCOMPARE( block->color( 10, 10 ), QColor( Qt::red ).rgb() );
+  QCOMPARE( block->color( 400, 400 ), QColor( Qt::red ).rgb() );
+  delete block;
+}
+
+void TestQgsWmsProvider::prefetchHit()
+{
+  // all the tiles of the view are cached: nothing is requested while drawing
+  cacheTiles( 1, 0, 2, 4, 6, Qt::green );
+  mServingTiles = true;
+
+  QgsRasterBlock *block = mLayer->dataProvider()->block( 1, QgsRectangle( 2048, 3072, 3072, 4096 ), 512, 512 );
+  QVERIFY( block );
+  QVERIFY( tileRequests().isEmpty() );
+  QCOMPARE( block->color( 100, 100 ), QColor( Qt::green ).rgb() );
+  delete block;
+
+  // the ring of tiles around the complete view is prefetched when the application is idle
+  QCoreApplication::processEvents();
+  QStringList prefetched = tileRequests();
+  QCOMPARE( prefetched.size(), 11 );
+  for ( int col = 3; col <= 7; ++col )
+  {
+    QVERIFY( prefetched.contains( tileUrl( 1, 3, col ) ) );
+  }
+  for ( int row = 0; row <= 2; ++row )
+  {
+    QVERIFY( prefetched.contains( tileUrl( 1, row, 3 ) ) );
+    QVERIFY( prefetched.contains( tileUrl( 1, row, 7 ) ) );
+  }
+
+  // the server delivers the prefetched tiles, the provider puts them into the tile cache
+  waitForReplies();
+  mServedTiles.sort();
+  prefetched.sort();
+  QCOMPARE( mServedTiles, prefetched );
+  QImage tile;
+  QVERIFY( QgsTileCache::tile( QUrl( tileUrl( 1, 0, 7 ) ), tile ) );
+  mRequestedUrls.clear();
+  mServedTiles.clear();
+
+  // panning to them draws from the cache without requesting the tiles of the view
+  block = mLayer->dataProvider()->block( 1, QgsRectangle( 3072, 3072, 4096, 4096 ), 512, 512 );
+  QVERIFY( block );
+  QVERIFY( tileRequests().isEmpty() );
+  QVERIFY( mServedTiles.isEmpty() );
+  QCOMPARE( block->color( 100, 100 ), QColor( Qt::green ).rgb() );
+  QCOMPARE( block->color( 100, 400 ), QColor( Qt::blue ).rgb() );
+  delete block;
+}
+
+QTEST_MAIN( TestQgsWmsProvider )
+
+#include "moc_testqgswmsprovider.cxx"
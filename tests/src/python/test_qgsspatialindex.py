@@ -12,6 +12,9 @@ __copyright__ = 'Copyright 2012, The QGIS Project'
 # This will get replaced with a git SHA1 when you do a git archive
 __revision__ = '$Format:%H$'
 
+import os
+import shutil
+import tempfile
 import unittest
 import qgis
 
@@ -19,7 +22,8 @@ from qgis.core import (QgsSpatialIndex,
                        QgsFeature,
                        QgsGeometry,
                        QgsRectangle,
-                       QgsPoint)
+                       QgsPoint,
+                       QgsVectorLayer)
 
 from utilities import getQgisTestApp
 
@@ -59,3 +63,90 @@ class TestQgsSpatialIndex(unittest.TestCase):
         myMessage = ('Expected: %s\nGot: %s\n' %
                      ([0, 1, 5], fids))
         assert fids == [0, 1, 5], myMessage
+
+    def testBulkLoadAndSave(self):
+        layer = QgsVectorLayer("Point", "test", "memory")
+        assert layer.isValid(), "Failed to create memory layer"
+        features = []
+        for i in range(100):
+            ft = QgsFeature()
+            if i % 10 != 9:
+                ft.setGeometry(QgsGeometry.fromPoint(QgsPoint(i % 10, i // 10)))
+            features.append(ft)
+        assert layer.dataProvider().addFeatures(features)[0]
+
+        idx = QgsSpatialIndex(layer.getFeatures())
+
+        # features without geometry are not in the index
+        fids = idx.intersects(QgsRectangle(-1, -1, 100, 100))
+        myMessage = 'Expected: %s Got: %s' % (90, len(fids))
+        assert len(fids) == 90, myMessage
+
+        fids = idx.intersects(QgsRectangle(0.5, 0.5, 2.5, 1.5))
+        expected = [f.id() for f in layer.getFeatures()
+                    if f.geometry() and 1 <= f.geometry().asPoint().x() <= 2 and f.geometry().asPoint().y() == 1]
+        myMessage = 'Expected: %s\nGot: %s\n' % (sorted(expected), sorted(fids))
+        assert sorted(fids) == sorted(expected), myMessage
+
+        tmpdir = tempfile.mkdtemp()
+        try:
+            base = os.path.join(tmpdir, 'points')
+            assert idx.save(base), 'Could not save spatial index'
+            assert os.path.exists(base + '.idx')
+            assert os.path.exists(base + '.dat')
+
+            loaded = QgsSpatialIndex.load(base)
+            assert loaded is not None, 'Could not load spatial index'
+            myMessage = 'Expected: %s\nGot: %s\n' % (sorted(fids), sorted(loaded.intersects(QgsRectangle(0.5, 0.5, 2.5, 1.5))))
+            assert sorted(loaded.intersects(QgsRectangle(0.5, 0.5, 2.5, 1.5))) == sorted(fids), myMessage
+            assert len(loaded.nearestNeighbor(QgsPoint(4.1, 4.1), 1)) == 1
+            del loaded
+
+            assert QgsSpatialIndex.load(os.path.join(tmpdir, 'missing')) is None
+
+            # an empty index can be saved too
+            assert QgsSpatialIndex().save(base)
+            loaded = QgsSpatialIndex.load(base)
+            assert loaded is not None
+            assert loaded.intersects(QgsRectangle(-1, -1, 100, 100)) == []
+            del loaded
+        finally:
+            shutil.rmtree(tmpdir)
+
+    def testNearestNeighborDistances(self):
+        idx = QgsSpatialIndex()
+        for fid, (x, y) in enumerate([(0, 0), (3, 0), (0, 5), (10, 10)]):
+            ft = QgsFeature()
+            ft.setFeatureId(fid)
+            ft.setGeometry(QgsGeometry.fromPoint(QgsPoint(x, y)))
+            idx.insertFeature(ft)
+
+        result = idx.nearestNeighborDistances(QgsPoint(0, 1), 2)
+        myMessage = 'Expected: %s\nGot: %s\n' % ([(0, 1.0), (1, 10 ** 0.5)], result)
+        assert [r[0] for r in result] == [0, 1], myMessage
+        assert abs(result[0][1] - 1.0) < 1e-9, myMessage
+        assert abs(result[1][1] - 10 ** 0.5) < 1e-9, myMessage
+
+        # exact distances change the order of the neighbors
+        class Penalty(QgsSpatialIndex.ExactDistance):
+            def distance(self, fid, point):
+                p = [(0, 0), (3, 0), (0, 5), (10, 10)][fid]
+                d = ((p[0] - point.x()) ** 2 + (p[1] - point.y()) ** 2) ** 0.5
+                return d + 10 if fid == 0 else d
+
+        result = idx.nearestNeighborDistances(QgsPoint(0, 1), 2, Penalty())
+        myMessage = 'Expected: %s\nGot: %s\n' % ([1, 2], result)
+        assert [r[0] for r in result] == [1, 2], myMessage
+        assert abs(result[1][1] - 4.0) < 1e-9, myMessage
+
+        # a copy is an independent snapshot
+        copy = QgsSpatialIndex(idx)
+        ft = QgsFeature()
+        ft.setFeatureId(4)
+        ft.setGeometry(QgsGeometry.fromPoint(QgsPoint(0, 1)))
+        idx.insertFeature(ft)
+        assert idx.nearestNeighbor(QgsPoint(0, 1), 1) == [4]
+        assert copy.nearestNeighbor(QgsPoint(0, 1), 1) == [0]
+
+if __name__ == '__main__':
+    unittest.main()
@@ -18,6 +18,7 @@ import qgis
 import sys
 
 from qgis.core import *
+from PyQt4.QtCore import QSettings
 
 from utilities import (getQgisTestApp,
                        TestCase,
@@ -70,6 +71,17 @@ class TestQgsSpatialiteProvider(TestCase):
         sql +=    "VALUES (1, 'toto', GeomFromText('POLYGON((0 0,1 0,1 1,0 1,0 0))', 4326))"
         cur.execute(sql)
 
+        # table for comparing compiled and locally evaluated filter expressions
+        sql = "CREATE TABLE test_filter (id INTEGER NOT NULL PRIMARY KEY, num INTEGER, dbl FLOAT, name TEXT)"
+        cur.execute(sql)
+        sql = "SELECT AddGeometryColumn('test_filter', 'geometry', 4326, 'POINT', 'XY')"
+        cur.execute(sql)
+        for fid, num, dbl, name in [(1, 1, 0.5, 'Apple'), (2, 2, 1.5, 'apple'), (3, 3, None, 'Banana'),
+                                    (4, None, 2.5, None), (5, 5, -1.0, 'a_b*c'), (6, 10, 10.0, '10')]:
+            sql = "INSERT INTO test_filter (id, num, dbl, name, geometry) "
+            sql +=    "VALUES (?, ?, ?, ?, GeomFromText('POINT(%d 0)', 4326))" % fid
+            cur.execute(sql, (fid, num, dbl, name))
+
         cur.execute( "COMMIT" )
         con.close()
 
@@ -122,5 +134,37 @@ class TestQgsSpatialiteProvider(TestCase):
                 for c1, c2 in zip(p1, p2):
                     c1 == c2 or die("polygon has been altered by failed edition")
 
+    def test_ExpressionCompilation(self):
+        """Filter expressions give the same features with and without compilation to SQL"""
+        layer = QgsVectorLayer("dbname=%s table=test_filter (geometry)" % self.dbname, "test_filter", "spatialite")
+        assert(layer.isValid())
+
+        expressions = {
+            '"dbl" > 1': [2, 4, 6],
+            '"num" = 1 or "dbl" < 0': [1, 5],
+            '"num" in (1, 3, NULL)': [1, 3],
+            '"num" not in (1, 3)': [2, 5, 6],
+            '"dbl" is null': [3],
+            '"name" = \'apple\'': [2],
+            '"name" <> \'apple\'': [1, 3, 5, 6],
+            '"name" like \'a%\'': [2, 5],
+            '"name" like \'a_b*c\'': [5],
+            '"name" ilike \'a%\'': [1, 2, 5],
+            '"name" not ilike \'%an%\'': [1, 2, 5, 6],
+            '"name" = \'10\'': [6],
+            '"name" = 10': [6],
+            'not ("dbl" > 1)': [1, 5],
+            '"dbl" > 0 and "name" || \'x\' = \'applex\'': [2],
+        }
+
+        settings = QSettings()
+        for compiled in [True, False]:
+            settings.setValue("/qgis/compileExpressions", compiled)
+            for expression, expected in expressions.items():
+                request = QgsFeatureRequest().setFilterExpression(expression)
+                ids = sorted([f.id() for f in layer.getFeatures(request)])
+                assert ids == expected, "%s (compiled: %s): expected %s, got %s" % (expression, compiled, expected, ids)
+        settings.remove("/qgis/compileExpressions")
+
 if __name__ == '__main__':
     unittest.main()